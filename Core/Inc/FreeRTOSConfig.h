@@ -51,20 +51,54 @@
 #if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
   #include <stdint.h>
   extern uint32_t SystemCoreClock;
+#if defined(TICKLESS_IDLE) && (TICKLESS_IDLE == 1)
+  void PreSleepProcessing(uint32_t *ulExpectedIdleTime);
+  void PostSleepProcessing(uint32_t *ulExpectedIdleTime);
+  void PostSleepStepTick(uint32_t ulSteppedTicks);
 #endif
-#define configENABLE_FPU                         0
+#if (defined(TASK_TELEMETRY) && (TASK_TELEMETRY == 1)) || (defined(CLOCK_GOVERNOR) && (CLOCK_GOVERNOR == 1)) || \
+    (defined(ENERGY_PROFILE) && (ENERGY_PROFILE == 1))
+  void configureTimerForRunTimeStats(void);
+  unsigned long getRunTimeCounterValue(void);
+#endif
+#if defined(TASK_TELEMETRY) && (TASK_TELEMETRY == 1)
+  void task_telemetry_switched_in(void *task);
+#endif
+#if defined(HEAP_TELEMETRY) && (HEAP_TELEMETRY == 1)
+  void heap_telemetry_malloc(void *address, uint32_t size);
+#endif
+#if defined(KERNEL_TRACE) && (KERNEL_TRACE == 1)
+  #include "kernel_trace.h"
+#endif
+#endif
+/* The ARM_CM4F port always saves the FPU context and enables lazy stacking
+   (FPCCR ASPEN/LSPEN), so builds must use -mfloat-abi=hard or softfp. */
+#define configENABLE_FPU                         1
 #define configENABLE_MPU                         0
 
 #define configUSE_PREEMPTION                     1
 #define configSUPPORT_STATIC_ALLOCATION          1
+/* Application objects are static, STATIC_ALLOCATION_ONLY drops the heap */
+#if defined(STATIC_ALLOCATION_ONLY) && (STATIC_ALLOCATION_ONLY == 1)
+#define configSUPPORT_DYNAMIC_ALLOCATION         0
+#else
 #define configSUPPORT_DYNAMIC_ALLOCATION         1
+#endif
+/* The flash log erases its next sector from the idle hook, see flash_log.h */
+#if defined(FLASH_LOG_IDLE_ERASE) && (FLASH_LOG_IDLE_ERASE == 1)
+#define configUSE_IDLE_HOOK                      1
+#else
 #define configUSE_IDLE_HOOK                      0
+#endif
 #define configUSE_TICK_HOOK                      0
 #define configCPU_CLOCK_HZ                       ( SystemCoreClock )
 #define configTICK_RATE_HZ                       ((TickType_t)1000)
 #define configMAX_PRIORITIES                     ( 7 )
 #define configMINIMAL_STACK_SIZE                 ((uint16_t)128)
 #define configTOTAL_HEAP_SIZE                    ((size_t)15360)
+/* ucHeap is defined in freertos.c so the heap, and the task stacks taken from
+   it, can be placed in CCM RAM */
+#define configAPPLICATION_ALLOCATED_HEAP         1
 #define configMAX_TASK_NAME_LEN                  ( 16 )
 #define configUSE_16_BIT_TICKS                   0
 #define configUSE_MUTEXES                        1
@@ -77,11 +111,28 @@
 /* USER CODE END MESSAGE_BUFFER_LENGTH_TYPE */
 
 /* Co-routine definitions. */
+/* Off: every sensor is a row of sensor_registry run by the producer task,
+   with a few bytes of state and no stack or task of its own, see
+   sensor_registry.h. croutine.c compiles to nothing. */
 #define configUSE_CO_ROUTINES                    0
 #define configMAX_CO_ROUTINE_PRIORITIES          ( 2 )
 
 /* The following flag must be enabled only when using newlib */
+/* LEAN_RUNTIME shares one struct _reent between the tasks, nothing in the
+   pipeline reads errno, and guards malloc with the locks of sysmem.c */
+#if defined(LEAN_RUNTIME) && (LEAN_RUNTIME == 1)
+#define configUSE_NEWLIB_REENTRANT          0
+#else
 #define configUSE_NEWLIB_REENTRANT          1
+#endif
+
+/* Software timer definitions. */
+/* The timer service task runs the uart_tx flush deadline, at
+   TASK_PRIORITY_CONTROL of pipeline_priorities.h */
+#define configUSE_TIMERS                         1
+#define configTIMER_TASK_PRIORITY                ( 3 )
+#define configTIMER_QUEUE_LENGTH                 4
+#define configTIMER_TASK_STACK_DEPTH             256
 
 /* Set the following definitions to 1 to include the API function, or zero
 to exclude the API function. */
@@ -90,9 +141,10 @@ to exclude the API function. */
 #define INCLUDE_vTaskDelete                  1
 #define INCLUDE_vTaskCleanUpResources        0
 #define INCLUDE_vTaskSuspend                 1
-#define INCLUDE_vTaskDelayUntil              0
+#define INCLUDE_vTaskDelayUntil              1
 #define INCLUDE_vTaskDelay                   1
 #define INCLUDE_xTaskGetSchedulerState       1
+#define INCLUDE_xTimerPendFunctionCall       1
 
 /* Cortex-M specific definitions. */
 #ifdef __NVIC_PRIO_BITS
@@ -137,6 +189,78 @@ standard names. */
 
 /* USER CODE BEGIN Defines */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+/* Per-task CPU time on the 1 MHz TIM2 counter, stack high water marks and
+   context switch counts for the telemetry frame, see task_telemetry.h */
+#if defined(TASK_TELEMETRY) && (TASK_TELEMETRY == 1)
+#define configUSE_TRACE_FACILITY                 1
+#define INCLUDE_uxTaskGetStackHighWaterMark      1
+#define traceTASK_SWITCHED_IN()                  task_telemetry_switched_in( ( void * ) pxCurrentTCB )
+#endif
+/* The clock governor only needs the run time of the idle task, see clock_governor.h,
+   and the energy profile only a running TIM2, see energy_profile.h */
+#if (defined(TASK_TELEMETRY) && (TASK_TELEMETRY == 1)) || (defined(CLOCK_GOVERNOR) && (CLOCK_GOVERNOR == 1)) || \
+    (defined(ENERGY_PROFILE) && (ENERGY_PROFILE == 1))
+#define configGENERATE_RUN_TIME_STATS            1
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS   configureTimerForRunTimeStats
+#define portGET_RUN_TIME_COUNTER_VALUE           getRunTimeCounterValue
+#endif
+/* Stack checking on every switch out, high water marks of every task and the
+   handles of the kernel tasks for the stack profile frame, see stack_profile.h */
+#if defined(STACK_PROFILE) && (STACK_PROFILE == 1)
+#define configCHECK_FOR_STACK_OVERFLOW           2
+#ifndef INCLUDE_uxTaskGetStackHighWaterMark
+#define INCLUDE_uxTaskGetStackHighWaterMark      1
+#endif
+#define INCLUDE_xTaskGetIdleTaskHandle           1
+#define INCLUDE_xTimerGetTimerDaemonTaskHandle   1
+#endif
+/* Allocation tracing for the heap telemetry frame, see heap_telemetry.h */
+#if defined(HEAP_TELEMETRY) && (HEAP_TELEMETRY == 1)
+#define configUSE_MALLOC_FAILED_HOOK             1
+#define traceMALLOC( pvAddress, uiSize )         heap_telemetry_malloc( ( pvAddress ), ( uint32_t ) ( uiSize ) )
+#endif
+/* Context switches, queue and notification events in the kernel trace ring,
+   see kernel_trace.h. The task numbers come with the trace facility. */
+#if defined(KERNEL_TRACE) && (KERNEL_TRACE == 1)
+#ifndef configUSE_TRACE_FACILITY
+#define configUSE_TRACE_FACILITY                 1
+#endif
+#if defined(TASK_TELEMETRY) && (TASK_TELEMETRY == 1)
+#undef traceTASK_SWITCHED_IN
+#define traceTASK_SWITCHED_IN()                  \
+  do { task_telemetry_switched_in( ( void * ) pxCurrentTCB ); \
+       kernel_trace_switched_in( pxCurrentTCB->uxTCBNumber ); } while( 0 )
+#else
+#define traceTASK_SWITCHED_IN()                  kernel_trace_switched_in( pxCurrentTCB->uxTCBNumber )
+#endif
+#define traceTASK_SWITCHED_OUT()                 \
+  kernel_trace_event( KERNEL_TRACE_SWITCH_OUT, pxCurrentTCB->uxTCBNumber )
+#define traceQUEUE_SEND( pxQueue )               \
+  kernel_trace_event( KERNEL_TRACE_QUEUE_SEND, ( uint32_t ) ( uintptr_t ) ( pxQueue ) )
+#define traceQUEUE_SEND_FROM_ISR( pxQueue )      \
+  kernel_trace_event( KERNEL_TRACE_QUEUE_SEND_FROM_ISR, ( uint32_t ) ( uintptr_t ) ( pxQueue ) )
+#define traceQUEUE_RECEIVE( pxQueue )            \
+  kernel_trace_event( KERNEL_TRACE_QUEUE_RECEIVE, ( uint32_t ) ( uintptr_t ) ( pxQueue ) )
+#define traceTASK_NOTIFY()                       \
+  kernel_trace_event( KERNEL_TRACE_NOTIFY, pxTCB->uxTCBNumber )
+#define traceTASK_NOTIFY_FROM_ISR()              \
+  kernel_trace_event( KERNEL_TRACE_NOTIFY_FROM_ISR, pxTCB->uxTCBNumber )
+#define traceTASK_NOTIFY_GIVE_FROM_ISR()         \
+  kernel_trace_event( KERNEL_TRACE_NOTIFY_FROM_ISR, pxTCB->uxTCBNumber )
+#define traceTASK_NOTIFY_WAIT()                  \
+  kernel_trace_event( KERNEL_TRACE_NOTIFY_RECEIVE, pxCurrentTCB->ulNotifiedValue )
+#define traceTASK_NOTIFY_TAKE()                  \
+  kernel_trace_event( KERNEL_TRACE_NOTIFY_RECEIVE, pxCurrentTCB->ulNotifiedValue )
+#endif
+/* Tickless idle: the kernel stops the SysTick for as long as no task is due
+   and the core waits in SLEEP mode. The TIM1 HAL timebase is paused around the
+   WFI and uwTick is moved on by the ticks the kernel steps afterwards. */
+#if defined(TICKLESS_IDLE) && (TICKLESS_IDLE == 1)
+#define configUSE_TICKLESS_IDLE                  1
+#define configPRE_SLEEP_PROCESSING( x )          PreSleepProcessing( &( x ) )
+#define configPOST_SLEEP_PROCESSING( x )         PostSleepProcessing( &( x ) )
+#define traceINCREASE_TICK_COUNT( x )            PostSleepStepTick( x )
+#endif
 /* USER CODE END Defines */
 
 #endif /* FREERTOS_CONFIG_H */
@@ -0,0 +1,82 @@
+/**
+  ******************************************************************************
+  * @file    adaptive_rate.h
+  * @brief   Report rate and window size that follow the volatility of the data.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __ADAPTIVE_RATE_H
+#define __ADAPTIVE_RATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_data.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the configured batch and window are the quiet rate, busy data shortens both
+#ifndef ADAPTIVE_RATE
+#define ADAPTIVE_RATE 0
+#endif
+// Halvings of the batch and window at the busiest level, 3 reports 8 times as often
+#ifndef ADAPTIVE_RATE_LEVELS
+#define ADAPTIVE_RATE_LEVELS 3
+#endif
+// Floors of the shortened batch and window, in sampling ticks and samples
+#ifndef ADAPTIVE_RATE_BATCH_MIN
+#define ADAPTIVE_RATE_BATCH_MIN 4
+#endif
+#ifndef ADAPTIVE_RATE_WINDOW_MIN
+#define ADAPTIVE_RATE_WINDOW_MIN 16
+#endif
+// Time constants of the fast and slow moving averages, in samples
+#ifndef ADAPTIVE_RATE_FAST_SAMPLES
+#define ADAPTIVE_RATE_FAST_SAMPLES 4
+#endif
+#ifndef ADAPTIVE_RATE_SLOW_SAMPLES
+#define ADAPTIVE_RATE_SLOW_SAMPLES 64
+#endif
+// Drift of the fast average from the slow one, in standard deviations of the
+// channel: above BUSY the rate goes to the busiest level at once, a batch that
+// stays below QUIET on every channel steps back one level
+#ifndef ADAPTIVE_RATE_BUSY_SIGMA
+#define ADAPTIVE_RATE_BUSY_SIGMA 2.0f
+#endif
+#ifndef ADAPTIVE_RATE_QUIET_SIGMA
+#define ADAPTIVE_RATE_QUIET_SIGMA 0.75f
+#endif
+// Noise floor of the standard deviation, relative to the level of the channel,
+// so a flat signal does not turn its last bit into a burst
+#ifndef ADAPTIVE_RATE_NOISE_FLOOR
+#define ADAPTIVE_RATE_NOISE_FLOOR 0.002f
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Start at the quiet level with no history, before the sampling timer starts
+void adaptive_rate_init(void);
+
+// Follow one stored sample of a reported channel. A sharp change moves to the
+// busiest level at once, so the batch in progress closes early. Producer task only.
+void adaptive_rate_sample(sensor_t channel, float value);
+
+// Pick the level of the next batch from the one just closed. Producer task only.
+void adaptive_rate_batch_end(void);
+
+// Settings of the current level, derived from pipeline_config. Never larger
+// than the configured ones, so they always fit the ring and window storage.
+uint32_t adaptive_rate_samples_per_batch(void);
+uint32_t adaptive_rate_window_size(void);
+
+// Current level, 0 is the configured rate
+uint32_t adaptive_rate_level(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADAPTIVE_RATE_H */
@@ -0,0 +1,53 @@
+/**
+  ******************************************************************************
+  * @file    adc_acquisition.h
+  * @brief   Timer-triggered ADC1 scan acquisition for the analog sensors.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __ADC_ACQUISITION_H
+#define __ADC_ACQUISITION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "sensor_data.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: sample the SENSOR_SOURCE_ADC sensors with ADC1, the LDR is one of them
+#ifndef ADC_ACQUISITION
+#define ADC_ACQUISITION 0
+#endif
+// Scans of all ADC sensors per second, triggered by TIM8
+#ifndef ADC_ACQUISITION_RATE_HZ
+#define ADC_ACQUISITION_RATE_HZ 1000
+#endif
+// Scans in the circular DMA buffer, each half is summed when it is complete
+#ifndef ADC_ACQUISITION_SCANS
+#define ADC_ACQUISITION_SCANS 64
+#endif
+// Highest ADC1 input, inputs 0-15 are pins PA0-PA7, PB0-PB1, PC0-PC5
+#define ADC_ACQUISITION_INPUT_MAX 15
+// SENSOR_SOURCE_ADC sensors one ADC scan can hold
+#define ADC_ACQUISITION_CHANNELS_MAX 4
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Configure ADC1, its pins and the DMA for the SENSOR_SOURCE_ADC rows of the
+// sensor registry. Does nothing when there are none.
+void adc_acquisition_init(void);
+
+// Start the TIM8 trigger, conversions run without the CPU from here on
+void adc_acquisition_start(void);
+
+// Mean of the conversions of channel since the previous call, the previous
+// mean when no scan completed in between. Task context only.
+float adc_acquisition_sample(sensor_t channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADC_ACQUISITION_H */
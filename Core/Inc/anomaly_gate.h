@@ -0,0 +1,58 @@
+/**
+  ******************************************************************************
+  * @file    anomaly_gate.h
+  * @brief   Z-score of every statistics window against a learned baseline, gates the live reports.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __ANOMALY_GATE_H
+#define __ANOMALY_GATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "stats_frame.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: a window whose statistics all sit near their baseline is not sent, only
+// a heartbeat now and then. 0: every window is sent.
+#ifndef ANOMALY_GATE
+#define ANOMALY_GATE 0
+#endif
+// Weight of a new window in the baseline, about the last 1 / alpha windows
+#ifndef ANOMALY_GATE_ALPHA
+#define ANOMALY_GATE_ALPHA 0.05f
+#endif
+// Deviation from the baseline, in its standard deviations, of an anomalous statistic
+#ifndef ANOMALY_GATE_THRESHOLD
+#define ANOMALY_GATE_THRESHOLD 4.0f
+#endif
+// Windows between two heartbeats, a receiver that hears none knows the link is down
+#ifndef ANOMALY_GATE_HEARTBEAT
+#define ANOMALY_GATE_HEARTBEAT 20
+#endif
+// Windows still sent after an anomalous one, the way back to the baseline
+#ifndef ANOMALY_GATE_HOLD
+#define ANOMALY_GATE_HOLD 3
+#endif
+// Windows sent while the baseline is first learned
+#ifndef ANOMALY_GATE_WARMUP
+#define ANOMALY_GATE_WARMUP 8
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Score the statistics of the channels in channel_mask against their
+// baseline, learn the window into it and tell whether its report is sent.
+// Consumer task only, once per window that moved.
+bool anomaly_gate_admit(uint16_t channel_mask, const float values[SENSOR_COUNT][STATS_FIELD_COUNT]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ANOMALY_GATE_H */
@@ -0,0 +1,52 @@
+/**
+  ******************************************************************************
+  * @file    arena.h
+  * @brief   Linear region allocator, carved once per configuration and reset as a whole.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// Bytes an allocation of size takes from an arena, allocations are word
+// aligned
+#define ARENA_BYTES(size) ((((size) + 3U) / 4U) * 4U)
+
+/* Exported types ------------------------------------------------------------*/
+// The allocations are taken in order from the start of the storage and are
+// only given back all together, by arena_reset.
+typedef struct {
+    uint8_t *storage;
+    uint32_t size;     // Bytes, whole words
+    uint32_t used;     // Bytes handed out since the last reset
+    uint32_t peak;     // Highest used since arena_init
+    uint32_t resets;
+    uint32_t failures; // Allocations that did not fit
+} arena_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Hand out the size bytes of storage, word aligned, before any other call on
+// the arena
+void arena_init(arena_t *arena, uint32_t *storage, uint32_t size);
+
+// Take ARENA_BYTES(size) bytes, NULL when they do not fit. The cost does not
+// depend on what was taken before. A single owner, no lock.
+void *arena_alloc(arena_t *arena, uint32_t size);
+
+// Give every allocation back at once, the next one starts the storage again
+void arena_reset(arena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ARENA_H */
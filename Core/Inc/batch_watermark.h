@@ -0,0 +1,66 @@
+/**
+  ******************************************************************************
+  * @file    batch_watermark.h
+  * @brief   Consumer handoff driven by the fill of the rings and a latency deadline.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __BATCH_WATERMARK_H
+#define __BATCH_WATERMARK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_data.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the producer hands a batch to the consumer when the new samples of the
+// fullest ring reach the high watermark, or when its oldest new sample is
+// BATCH_WATERMARK_LATENCY_MS old and at least the low watermark arrived,
+// instead of after a fixed count of ticks
+#ifndef BATCH_WATERMARK
+#define BATCH_WATERMARK 0
+#endif
+// New samples of the fullest ring that hand the batch over at once. 0 follows
+// the samples per batch, and a larger value is held to them: the rings are
+// sized for two of them behind the window.
+#ifndef BATCH_WATERMARK_HIGH
+#define BATCH_WATERMARK_HIGH 0
+#endif
+// New samples of the fullest ring the deadline needs to hand a batch over,
+// fewer wait on for more
+#ifndef BATCH_WATERMARK_LOW
+#define BATCH_WATERMARK_LOW 1
+#endif
+#if BATCH_WATERMARK_LOW < 1 || (BATCH_WATERMARK_HIGH != 0 && BATCH_WATERMARK_LOW > BATCH_WATERMARK_HIGH)
+#error "BATCH_WATERMARK_LOW must be 1 to BATCH_WATERMARK_HIGH"
+#endif
+// Longest time in ms a new sample waits for the consumer once the low
+// watermark is reached, 0 is the samples per batch times the sampling period
+#ifndef BATCH_WATERMARK_LATENCY_MS
+#define BATCH_WATERMARK_LATENCY_MS 0
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Start with no new samples, before the producer runs
+void batch_watermark_init(void);
+
+// Count a sample that reached the ring of channel, stored or coded away, at
+// its sample time. Producer only.
+void batch_watermark_sample(sensor_t channel, uint32_t timestamp);
+
+// At the end of a tick at now, true when the batch is due for batch samples
+// per batch and period_ms between ticks. Starts the next batch when it is.
+// Producer only.
+bool batch_watermark_due(uint32_t now, uint32_t batch, uint32_t period_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BATCH_WATERMARK_H */
@@ -0,0 +1,67 @@
+/**
+  ******************************************************************************
+  * @file    ble_module.h
+  * @brief   AT command setup of the BLE module on USART2 at boot.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __BLE_MODULE_H
+#define __BLE_MODULE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the commands of ble_module_commands go to the module at boot, before
+// anything else is sent, and the outcome follows as a frame
+#ifndef BLE_MODULE
+#define BLE_MODULE 0
+#endif
+// First byte of the setup result frame
+#define BLE_MODULE_FRAME_TYPE 0xB4
+#define BLE_MODULE_FRAME_VERSION 1
+// Longest wait for the first byte of a reply
+#ifndef BLE_MODULE_REPLY_MS
+#define BLE_MODULE_REPLY_MS 300
+#endif
+// A reply ends when no byte followed for this long, modules like the HM-10
+// send no line end
+#ifndef BLE_MODULE_REPLY_GAP_MS
+#define BLE_MODULE_REPLY_GAP_MS 20
+#endif
+// Time the module takes to come back after its reset command
+#ifndef BLE_MODULE_RESET_MS
+#define BLE_MODULE_RESET_MS 1000
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+// Result of the setup, little endian, no padding
+typedef struct {
+    uint8_t type;     // BLE_MODULE_FRAME_TYPE
+    uint8_t version;  // BLE_MODULE_FRAME_VERSION
+    uint8_t commands; // Commands in the table
+    uint8_t accepted; // Commands answered as expected, in order, before the first that was not
+    uint8_t skipped;  // 1: a central was connected at boot, nothing was sent
+    uint8_t reserved[3];
+} ble_module_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Send the command table to the module and check every reply, polling
+// USART2. Before the scheduler and any kernel object: it waits with
+// HAL_Delay and HAL_GetTick, and blocks the boot for up to a second per
+// command. Stops at the first command that is not answered as expected.
+void ble_module_configure(void);
+
+// Send the result frame, from the consumer task before its first report
+void ble_module_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BLE_MODULE_H */
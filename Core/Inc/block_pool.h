@@ -0,0 +1,61 @@
+/**
+  ******************************************************************************
+  * @file    block_pool.h
+  * @brief   Fixed-size block pools with constant time allocation, ISR safe.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __BLOCK_POOL_H
+#define __BLOCK_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// Words of one block of size bytes, blocks are word aligned and hold at
+// least the free list link
+#define BLOCK_POOL_WORDS(size) (((size) + 3U) / 4U)
+
+// Static storage of a pool of count blocks of size bytes
+#define BLOCK_POOL_STORAGE(name, size, count) static uint32_t name[(count) * BLOCK_POOL_WORDS(size)]
+
+/* Exported types ------------------------------------------------------------*/
+// One size class. The free blocks form a singly linked list through their
+// first word, so allocation and free pop and push its head.
+typedef struct {
+    void *free_list;
+    uint8_t *storage;
+    uint32_t block_size;   // Bytes, rounded up to whole words
+    uint32_t block_count;
+    uint32_t free_count;
+    uint32_t min_free;     // Lowest free_count since block_pool_init
+    uint32_t failures;     // Allocations that found the pool empty
+} block_pool_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Split storage of BLOCK_POOL_STORAGE(storage, block_size, block_count) into
+// free blocks. Before any other call on the pool.
+void block_pool_init(block_pool_t *pool, uint32_t *storage, uint32_t block_size, uint32_t block_count);
+
+// Take a block, NULL when every block is in use. Never waits, the cost does
+// not depend on the number of blocks. From a task or an interrupt that may
+// call FreeRTOS, see critical_section.h, the _from_isr names are the same call.
+void *block_pool_alloc(block_pool_t *pool);
+void *block_pool_alloc_from_isr(block_pool_t *pool);
+
+// Give a block back. Returns false, and leaves the pool as it was, when
+// block is not the start of a block of this pool.
+bool block_pool_free(block_pool_t *pool, void *block);
+bool block_pool_free_from_isr(block_pool_t *pool, void *block);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BLOCK_POOL_H */
@@ -0,0 +1,74 @@
+/**
+  ******************************************************************************
+  * @file    boot_profile.h
+  * @brief   Cycle counter marks from reset to the first frame, reported once.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __BOOT_PROFILE_H
+#define __BOOT_PROFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the reset handler starts the cycle counter, each boot step leaves a mark
+// and the consumer sends the time of every mark as its first frame
+#ifndef BOOT_PROFILE
+#define BOOT_PROFILE 0
+#endif
+// First byte of the boot profile frame
+#define BOOT_PROFILE_FRAME_TYPE 0xB5
+#define BOOT_PROFILE_FRAME_VERSION 1
+
+/* Exported types ------------------------------------------------------------*/
+// Boot steps in the order they complete, the marks the startup code leaves
+// keep their values, it passes them as plain numbers
+typedef enum {
+    BOOT_MARK_RESET = 0,   // Reset handler entry, the counter starts here
+    BOOT_MARK_SYSTEM_INIT, // SystemInit returned, the memory init follows
+    BOOT_MARK_MAIN,        // .data, .ccmram and .bss ready, constructors run
+    BOOT_MARK_HAL_INIT,
+    BOOT_MARK_CLOCK,       // SystemClock_Config, HCLK on the PLL from here
+    BOOT_MARK_GPIO,        // Including the crash capture, SWO and watchdog init before it
+    BOOT_MARK_DMA,
+    BOOT_MARK_USART2,      // And USART1 with BULK_LINK
+    BOOT_MARK_I2C,         // Every configured bus
+    BOOT_MARK_TIMERS,      // TIM2, TIM3, TIM5 and TIM8 as configured
+    BOOT_MARK_SCHEDULER,   // Kernel objects and tasks created, the scheduler starts
+    BOOT_MARK_FIRST_FRAME, // The consumer runs and sends this profile
+    BOOT_MARK_COUNT
+} boot_mark_t;
+
+// Boot profile frame, little endian, no padding
+typedef struct {
+    uint8_t type;    // BOOT_PROFILE_FRAME_TYPE
+    uint8_t version; // BOOT_PROFILE_FRAME_VERSION
+    uint8_t count;   // BOOT_MARK_COUNT
+    uint8_t reserved;
+    uint32_t us[BOOT_MARK_COUNT]; // Microseconds from reset to each mark, in boot_mark_t order
+} boot_profile_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Start the cycle counter from zero, first thing in the reset handler. Runs
+// before the memory init and SystemInit, touches nothing but the debug
+// registers and the marks.
+void boot_profile_reset(void);
+
+// Record that a boot step completed, callable from the reset handler on
+void boot_profile_mark(boot_mark_t mark);
+
+// Mark the first frame and send the profile, from the consumer task before
+// anything else it sends
+void boot_profile_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BOOT_PROFILE_H */
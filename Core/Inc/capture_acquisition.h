@@ -0,0 +1,63 @@
+/**
+  ******************************************************************************
+  * @file    capture_acquisition.h
+  * @brief   TIM4 input capture acquisition for the sensors with a frequency output.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CAPTURE_ACQUISITION_H
+#define __CAPTURE_ACQUISITION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "sensor_data.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: sample the SENSOR_SOURCE_CAPTURE sensors from the edges of their output
+// on TIM4 CH3 (PB8), the LDR is one of them, a light-to-frequency converter
+#ifndef CAPTURE_ACQUISITION
+#define CAPTURE_ACQUISITION 0
+#endif
+// Counter clock of TIM4. The 16 bits wrap after 65536 counts, an output slower
+// than CAPTURE_ACQUISITION_COUNTER_HZ / 65536 (15 Hz) needs a slower clock.
+#ifndef CAPTURE_ACQUISITION_COUNTER_HZ
+#define CAPTURE_ACQUISITION_COUNTER_HZ 1000000U
+#endif
+// Rising edges per capture, 1, 2, 4 or 8, the input prescaler of the channel.
+// Raise it for outputs of some 100 kHz, each capture is a DMA transfer.
+#ifndef CAPTURE_ACQUISITION_EDGES_PER_CAPTURE
+#define CAPTURE_ACQUISITION_EDGES_PER_CAPTURE 1
+#endif
+// Captures in the circular DMA buffer, one interrupt per lap of the buffer
+#ifndef CAPTURE_ACQUISITION_CAPTURES
+#define CAPTURE_ACQUISITION_CAPTURES 256
+#endif
+// SENSOR_SOURCE_CAPTURE sensors, TIM4 CH3 is the only channel with a free DMA stream
+#define CAPTURE_ACQUISITION_CHANNELS_MAX 1
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Configure TIM4, its pin and the DMA for the SENSOR_SOURCE_CAPTURE row of the
+// sensor registry. Does nothing when there is none.
+void capture_acquisition_init(void);
+
+// Start the counter, the captures run without the CPU from here on
+void capture_acquisition_start(void);
+
+// Frequency of the output of channel in Hz, or with capture_period in its row
+// the mean period in us, over the edges since the previous call. Without a new
+// edge the value follows the time since the newest one. 0 until two calls
+// have seen an edge, producer task only.
+float capture_acquisition_sample(sensor_t channel);
+
+// TIM4 update interrupt, counts the wraps of the 16-bit counter
+void capture_acquisition_wrap_from_isr(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CAPTURE_ACQUISITION_H */
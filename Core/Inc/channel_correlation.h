@@ -0,0 +1,84 @@
+/**
+  ******************************************************************************
+  * @file    channel_correlation.h
+  * @brief   Streaming covariance and correlation between pairs of channels.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CHANNEL_CORRELATION_H
+#define __CHANNEL_CORRELATION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "sensor_data.h"
+#include "sensor_stats.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the producer keeps the co-moment of each pair in correlation_pairs over
+// the report interval and the consumer sends it after the statistics
+#ifndef STATS_CORRELATION
+#define STATS_CORRELATION 0
+#endif
+// First byte of a correlation frame
+#define CORRELATION_FRAME_TYPE 0xB0
+#define CORRELATION_FRAME_VERSION 1
+// Entries of correlation_pairs, a frame of 56 bytes
+#define CORRELATION_PAIRS_MAX 4
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    sensor_t x;
+    sensor_t y;
+} correlation_pair_t;
+
+// One pair of a correlation frame
+typedef struct {
+    uint8_t channel_x;   // sensor_t
+    uint8_t channel_y;   // sensor_t
+    int16_t correlation; // Q15 Pearson correlation of the interval, 0 when either side was constant
+    uint16_t count;      // Pairs of samples in the interval, saturated at 65535
+    uint16_t reserved;
+    float covariance;    // Population covariance, in the product of the two sensor units
+} correlation_entry_t;
+
+// Correlation frame as sent over the UART, little endian, no padding
+typedef struct {
+    uint8_t type;        // CORRELATION_FRAME_TYPE
+    uint8_t version;     // CORRELATION_FRAME_VERSION
+    uint8_t pair_count;  // Entries that follow, correlation_pair_count
+    uint8_t reserved;
+    uint32_t timestamp;  // Newest sample of the report, as in its statistics frame
+    correlation_entry_t pairs[CORRELATION_PAIRS_MAX];
+} correlation_frame_t;
+
+/* Exported variables --------------------------------------------------------*/
+extern const correlation_pair_t correlation_pairs[];
+extern const uint32_t correlation_pair_count;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Check the pairs and clear the co-moments, before the sampling timer starts
+void channel_correlation_init(void);
+
+// Take one stored sample of a channel. A pair is updated once both of its
+// channels have a sample it has not used yet, so it runs at the rate of the
+// slower one. Producer task only.
+void channel_correlation_sample(sensor_t channel, float value);
+
+// Hand the co-moments of the finished batch to the consumer and start the
+// next interval. Producer task only, before it signals the batch.
+void channel_correlation_publish(void);
+
+// Build the frame from the last published interval. Returns the number of
+// bytes to send. Consumer task only.
+uint16_t channel_correlation_build(correlation_frame_t *frame, uint32_t timestamp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CHANNEL_CORRELATION_H */
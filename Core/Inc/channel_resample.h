@@ -0,0 +1,104 @@
+/**
+  ******************************************************************************
+  * @file    channel_resample.h
+  * @brief   Streaming resampler of the channel rings onto a common timebase.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CHANNEL_RESAMPLE_H
+#define __CHANNEL_RESAMPLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sample_ring.h"
+#include "sensor_data.h"
+#include "uart_tx.h"
+#include "wire_format.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the consumer reads every ring a second time, resampled onto one
+// timebase, and sends the aligned rows in resample frames after the
+// statistics of each report
+#ifndef CHANNEL_RESAMPLE
+#define CHANNEL_RESAMPLE 0
+#endif
+// Time between two rows, the rows fall on multiples of it
+#ifndef CHANNEL_RESAMPLE_PERIOD_MS
+#define CHANNEL_RESAMPLE_PERIOD_MS 1000
+#endif
+// Value of a channel between two of its samples
+#define CHANNEL_RESAMPLE_HOLD 0   // Zero-order hold, the newest sample up to the row
+#define CHANNEL_RESAMPLE_LINEAR 1 // Linear between the samples on both sides of the row
+#ifndef CHANNEL_RESAMPLE_METHOD
+#define CHANNEL_RESAMPLE_METHOD CHANNEL_RESAMPLE_HOLD
+#endif
+#if CHANNEL_RESAMPLE_METHOD != CHANNEL_RESAMPLE_HOLD && CHANNEL_RESAMPLE_METHOD != CHANNEL_RESAMPLE_LINEAR
+#error "CHANNEL_RESAMPLE_METHOD must be CHANNEL_RESAMPLE_HOLD or CHANNEL_RESAMPLE_LINEAR"
+#endif
+// Longest a row waits for the next sample of a channel, and the oldest
+// sample that still counts as its value. Above the slowest read interval.
+#ifndef CHANNEL_RESAMPLE_WAIT_MS
+#define CHANNEL_RESAMPLE_WAIT_MS 10000
+#endif
+// First byte of a resample frame
+#define RESAMPLE_FRAME_TYPE 0xBF
+#define RESAMPLE_FRAME_VERSION 1
+#define RESAMPLE_FRAME_HEADER_SIZE 12U
+// Words of the rows that fit in one frame
+#define RESAMPLE_FRAME_WORDS ((UART_TX_FRAME_MAX - RESAMPLE_FRAME_HEADER_SIZE) / 2U)
+
+/* Exported types ------------------------------------------------------------*/
+// Resample frame as sent over the UART, little endian, no padding. Each row
+// is a valid mask and then one value per channel of channel_mask, lowest
+// channel first, encoded like the statistics. A channel is valid in a row
+// when it had a sample at most CHANNEL_RESAMPLE_WAIT_MS before it, its
+// value is 0 otherwise. The frame is 12 + 2 x row_count x (1 + channels)
+// bytes long.
+typedef struct {
+    uint8_t type;           // RESAMPLE_FRAME_TYPE
+    uint8_t version;        // RESAMPLE_FRAME_VERSION
+    uint8_t encoding;       // STATS_ENCODING_* of every value
+    uint8_t row_count;      // Rows that follow
+    uint16_t channel_mask;  // Bit n set: channel n (sensor_t) is in every row
+    uint16_t period_ms;     // CHANNEL_RESAMPLE_PERIOD_MS
+    uint32_t first_ms;      // Time of the first row, the others follow period_ms apart
+    uint16_t rows[RESAMPLE_FRAME_WORDS];
+} resample_frame_t;
+
+WIRE_ASSERT_FIELD(resample_frame_t, type, 0, 1);
+WIRE_ASSERT_FIELD(resample_frame_t, version, 1, 1);
+WIRE_ASSERT_FIELD(resample_frame_t, encoding, 2, 1);
+WIRE_ASSERT_FIELD(resample_frame_t, row_count, 3, 1);
+WIRE_ASSERT_FIELD(resample_frame_t, channel_mask, 4, 2);
+WIRE_ASSERT_FIELD(resample_frame_t, period_ms, 6, 2);
+WIRE_ASSERT_FIELD(resample_frame_t, first_ms, 8, 4);
+WIRE_ASSERT_FIELD(resample_frame_t, rows, RESAMPLE_FRAME_HEADER_SIZE, 2 * RESAMPLE_FRAME_WORDS);
+WIRE_ASSERT(RESAMPLE_FRAME_WORDS >= 1 + SENSOR_COUNT, "a row of every channel must fit in one frame");
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Attach SAMPLE_READER_RESAMPLE to the rings of every channel, without
+// gating the producer. Before the producer runs.
+void channel_resample_init(sample_ring_t *rings);
+
+// Compute the next aligned row of the channels in channel_mask, once every
+// one of them has a sample past it or waited CHANNEL_RESAMPLE_WAIT_MS.
+// values[] gets one value per channel of the mask in its sensor unit,
+// valid_mask the channels with a recent sample. Returns false while the row
+// is not ready, its time in *time_ms otherwise. Consumer task only.
+bool channel_resample_next(uint16_t channel_mask, uint32_t *time_ms, float *values, uint16_t *valid_mask);
+
+// Fill a frame with the rows that are ready, as many as it holds. Returns
+// the number of bytes to send, 0 when no row is ready. Consumer task only.
+uint16_t channel_resample_build(resample_frame_t *frame, uint16_t channel_mask);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CHANNEL_RESAMPLE_H */
@@ -0,0 +1,60 @@
+/**
+  ******************************************************************************
+  * @file    clock_governor.h
+  * @brief   Core clock scaling between two levels, driven by CPU load and transmit backlog.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CLOCK_GOVERNOR_H
+#define __CLOCK_GOVERNOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "main.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: HCLK drops from 168 MHz to 84 MHz while the pipeline has little to do and
+// comes back when it gets busy. Needs CLOCK_PROFILE_PERFORMANCE, the run-time
+// counter on TIM2 measures the load.
+#ifndef CLOCK_GOVERNOR
+#define CLOCK_GOVERNOR 0
+#endif
+#if CLOCK_GOVERNOR && CLOCK_PROFILE != CLOCK_PROFILE_PERFORMANCE
+#error "CLOCK_GOVERNOR scales the performance profile, build it with CLOCK_PROFILE_PERFORMANCE"
+#endif
+// Interval over which the load is measured and a level chosen
+#ifndef CLOCK_GOVERNOR_PERIOD_MS
+#define CLOCK_GOVERNOR_PERIOD_MS 500
+#endif
+// Busy share of an interval at 84 MHz above which the core goes back to 168 MHz
+#ifndef CLOCK_GOVERNOR_UP_PERMILLE
+#define CLOCK_GOVERNOR_UP_PERMILLE 600
+#endif
+// Busy share of an interval at 168 MHz below which it may drop to 84 MHz,
+// twice this must stay under CLOCK_GOVERNOR_UP_PERMILLE or the levels alternate
+#ifndef CLOCK_GOVERNOR_DOWN_PERMILLE
+#define CLOCK_GOVERNOR_DOWN_PERMILLE 200
+#endif
+#if 2 * CLOCK_GOVERNOR_DOWN_PERMILLE >= CLOCK_GOVERNOR_UP_PERMILLE
+#error "CLOCK_GOVERNOR_DOWN_PERMILLE must be below half of CLOCK_GOVERNOR_UP_PERMILLE"
+#endif
+// Quiet intervals in a row before the clock drops, a burst raises it at once
+#ifndef CLOCK_GOVERNOR_HOLD_PERIODS
+#define CLOCK_GOVERNOR_HOLD_PERIODS 4
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Create the governor task, before the scheduler starts. The core runs at
+// the full level until the first interval has been measured.
+void clock_governor_start(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CLOCK_GOVERNOR_H */
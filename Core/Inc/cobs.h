@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file    cobs.h
+  * @brief   Consistent Overhead Byte Stuffing for the UART frames.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __COBS_H
+#define __COBS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// Largest encoding of size bytes, without the 0x00 delimiter
+#define COBS_ENCODED_MAX(size) ((size) + (size) / 254U + 1U)
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Encode size bytes so that the output holds no 0x00, returns the encoded
+// length. dst must hold COBS_ENCODED_MAX(size) bytes. The output never
+// overtakes the input, so src may also lie in dst, starting at least
+// COBS_ENCODED_MAX(size) - size bytes after it; other overlaps are undefined.
+uint32_t cobs_encode(const uint8_t *src, uint32_t size, uint8_t *dst);
+
+// Decode one frame without its delimiter, returns the decoded length or -1
+// when the frame is malformed. dst must hold size bytes.
+int32_t cobs_decode(const uint8_t *src, uint32_t size, uint8_t *dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __COBS_H */
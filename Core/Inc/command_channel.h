@@ -0,0 +1,103 @@
+/**
+  ******************************************************************************
+  * @file    command_channel.h
+  * @brief   USART2 receive path for runtime configuration commands.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __COMMAND_CHANNEL_H
+#define __COMMAND_CHANNEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Exported constants --------------------------------------------------------*/
+// First byte of the reply to every command
+#define COMMAND_REPLY_FRAME_TYPE 0xA4
+// Circular DMA buffer, must be larger than the bytes that can arrive between
+// two reception events
+#ifndef COMMAND_RX_BUFFER_SIZE
+#define COMMAND_RX_BUFFER_SIZE 64
+#endif
+// Longest command line, longer lines are rejected
+#define COMMAND_LINE_MAX 32
+// Complete lines that can wait for the command task
+#ifndef COMMAND_QUEUE_LINES
+#define COMMAND_QUEUE_LINES 4
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    COMMAND_STATUS_OK,
+    COMMAND_STATUS_UNKNOWN,      // Not one of the commands below
+    COMMAND_STATUS_OUT_OF_RANGE  // Value missing or rejected, the setting is unchanged
+} command_status_t;
+
+// Reply with the settings after the command, little endian, no padding
+typedef struct {
+    uint8_t type;     // COMMAND_REPLY_FRAME_TYPE
+    uint8_t status;   // command_status_t
+    uint16_t window_size;
+    uint16_t samples_per_batch;
+    uint16_t sample_period_ms;
+    uint16_t channel_mask;
+} command_reply_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Start the idle-line DMA reception. Commands are ASCII lines ended by CR or
+// LF, a number may be decimal or 0x hex:
+//   window <samples>   statistics window size of each channel
+//   batch <ticks>      sampling ticks between two reports
+//   period <ms>        sampling tick, sensors run at multiples of it
+//   channels <mask>    reported channels, bit n is sensor_t n
+//   replay <sequence>  with FLASH_LOG, send the logged records from sequence on
+//   epoch <s> [<us>]   with TIME_BASE, host time at the end of the line since 1970
+//   sim <mode> [<seq>] with SENSOR_SIMULATION, 0 generate, 1 replay the flash log
+//                      from seq, 2 stream the sample commands
+//   sample <ch> <code> with SENSOR_SIMULATION streaming, the next sensor_to_fixed
+//                      code of channel ch. Out of range while its FIFO is full.
+//   trace <sink>       with KERNEL_TRACE, dump the kernel trace, 0 over the UART,
+//                      1 over SWO. Out of range while a dump runs.
+//   profile <clear>    with PC_PROFILE, dump the PC histogram, then count on from
+//                      zero with 1 or keep counting with 0. Out of range while a
+//                      dump runs.
+//   save <keep>        with CONFIG_STORE, 1 commits the settings above to flash
+//                      for the next boots, 0 commits none so they boot with
+//                      the build defaults. Out of range when the flash failed.
+//   dump <ch>          with WINDOW_DUMP, send the raw samples of the window of
+//                      channel ch as it stands at the next report. Out of range
+//                      while a dump is pending or runs.
+//   rollup <level>     with STATS_ROLLUP, send the summaries of a level held in
+//                      RAM, 0 seconds, 1 minutes, 2 hours
+//   query <ch> <from> <to> with STATS_ROLLUP and FLASH_LOG, one summary of channel
+//                      ch from the logged rollups between the two sample times in ms
+//   route <mask>       with BULK_LINK, send the traffic of bit n of mask on the
+//                      wired link and the rest on BLE, see link_route.h
+//   config             settings only
+//   stats              with STATS_SNAPSHOT, settings, then the latest statistics of
+//                      every channel at once, see stats_snapshot.h
+//   latest             with SAMPLE_MAILBOX, settings, then the newest sample of
+//                      every channel, see sample_mailbox.h
+//   ack <n> [<bits>]   with RELIABLE_LINK, statistics frame n arrived and so did
+//                      n - 1 - i for every bit i of bits, all ones by default.
+//                      The only line that is not answered.
+// Each line is answered with a command_reply_frame_t, in the order received.
+// A line that arrives while COMMAND_QUEUE_LINES lines wait is ignored.
+void command_channel_start(void);
+
+// Called from HAL_UART_ErrorCallback, restarts a reception the HAL aborted
+void command_channel_error_from_isr(void);
+
+// Number of lines ignored because the queue was full
+uint32_t command_channel_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __COMMAND_CHANNEL_H */
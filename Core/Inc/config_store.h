@@ -0,0 +1,80 @@
+/**
+  ******************************************************************************
+  * @file    config_store.h
+  * @brief   Runtime settings kept over resets in two dedicated flash sectors.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CONFIG_STORE_H
+#define __CONFIG_STORE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the "save" command commits the current settings to flash and the next
+// boots start from them instead of the compile-time defaults
+#ifndef CONFIG_STORE
+#define CONFIG_STORE 0
+#endif
+// Sectors 1 and 2, 16 KB each, left out of the FLASH regions of
+// STM32F407VGTX_FLASH.ld. A commit goes to the sector that does not hold
+// the current record.
+#define CONFIG_STORE_SECTOR_FIRST 1U
+#define CONFIG_STORE_SECTOR_COUNT 2U
+#define CONFIG_STORE_SECTOR_SIZE 0x4000U
+#define CONFIG_STORE_BASE 0x08004000U
+#define CONFIG_STORE_MAGIC 0x47464353U // "SCFG"
+// A record of another version is ignored, the build defaults stand
+#define CONFIG_STORE_VERSION 1U
+// Bits of config_store_record_t.fields
+#define CONFIG_STORE_FIELD_WINDOW 0x1U
+#define CONFIG_STORE_FIELD_BATCH 0x2U
+#define CONFIG_STORE_FIELD_PERIOD 0x4U
+#define CONFIG_STORE_FIELD_CHANNELS 0x8U
+#define CONFIG_STORE_FIELDS_ALL 0xFU
+
+/* Exported types ------------------------------------------------------------*/
+// Record at the start of a sector, read where it lies. crc covers the words
+// before it and is programmed last, so a torn commit never passes for one.
+typedef struct {
+    uint32_t magic;             // CONFIG_STORE_MAGIC
+    uint16_t version;           // CONFIG_STORE_VERSION
+    uint16_t size;              // sizeof(config_store_record_t)
+    uint32_t sequence;          // Commit count, the valid record with the higher one is current
+    uint32_t fields;            // CONFIG_STORE_FIELD_* bits of the settings it holds
+    uint32_t window_size;       // pipeline_config_t fields
+    uint32_t samples_per_batch;
+    uint32_t sample_period_ms;
+    uint32_t channel_mask;
+    uint32_t crc;
+} config_store_record_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Find the current record and apply its settings through the
+// pipeline_config setters, a setting they refuse keeps its default. After
+// pipeline_config_init, sample_timer_init and crc_unit_init, before the
+// scheduler starts. Returns the number of settings applied.
+uint32_t config_store_init(void);
+
+// Current record in flash, NULL when none is valid
+const config_store_record_t *config_store_record(void);
+
+// Commit the current settings with fields CONFIG_STORE_FIELDS_ALL, or a
+// record without settings with 0 so the next boots keep the build defaults.
+// Erases the other sector and programs the record there, the old record
+// stays current until the new one is complete. The erase stalls the CPU for
+// about half a second, the code runs from the same bank. Task context only.
+bool config_store_commit(uint32_t fields);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CONFIG_STORE_H */
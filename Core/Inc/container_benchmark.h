@@ -0,0 +1,41 @@
+/**
+  ******************************************************************************
+  * @file    container_benchmark.h
+  * @brief   On-target cycle benchmark of the fixed-capacity containers.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CONTAINER_BENCHMARK_H
+#define __CONTAINER_BENCHMARK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: time the containers of static_containers.hpp against the C code they
+// stand next to once at boot and report it over USART2
+#ifndef CONTAINER_BENCHMARK
+#define CONTAINER_BENCHMARK 0
+#endif
+// Timed runs per container, size and distribution
+#ifndef CONTAINER_BENCHMARK_RUNS
+#define CONTAINER_BENCHMARK_RUNS 32
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Create the benchmark task. It runs once after the scheduler starts, above
+// the processing stage, reports one CSV line per case over USART2 and then
+// deletes itself: kernel,size,distribution,min,avg,max (core cycles for
+// size items through the container, in the format of STATS_BENCHMARK).
+void container_benchmark_start(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CONTAINER_BENCHMARK_H */
@@ -0,0 +1,134 @@
+/**
+  ******************************************************************************
+  * @file    crash_capture.h
+  * @brief   Fault register dump and trace of the last pipeline events over a reset.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CRASH_CAPTURE_H
+#define __CRASH_CAPTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// 1: keep the last pipeline events in no-init RAM, dump the registers on a
+// fault and reset. Both are sent once after the next boot.
+#ifndef CRASH_CAPTURE
+#define CRASH_CAPTURE 0
+#endif
+// Events kept, a power of two
+#ifndef CRASH_CAPTURE_TRACE_DEPTH
+#define CRASH_CAPTURE_TRACE_DEPTH 32
+#endif
+#if (CRASH_CAPTURE_TRACE_DEPTH & (CRASH_CAPTURE_TRACE_DEPTH - 1)) != 0
+#error "CRASH_CAPTURE_TRACE_DEPTH must be a power of two"
+#endif
+// Events per trace frame, a frame stays within 64 bytes
+#define CRASH_TRACE_FRAME_EVENTS 7
+// First byte of a fault frame and of a trace frame
+#define CRASH_FAULT_FRAME_TYPE 0xAD
+#define CRASH_TRACE_FRAME_TYPE 0xAE
+#define CRASH_FRAME_VERSION 1
+
+// Fault frame flags
+#define CRASH_FLAG_THREAD 0x01U  // The fault hit a task, sp is the PSP
+#define CRASH_FLAG_STACKED 0x02U // r0 to xpsr were read from the stacked frame, zero otherwise
+#define CRASH_FLAG_FPU 0x04U     // The stacked frame holds the FPU registers
+#define CRASH_FLAG_BACKUP 0x08U  // No-init RAM was lost, the dump comes from the backup SRAM
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    CRASH_EVENT_NONE,
+    CRASH_EVENT_TICK,        // producer_task woke on a tick, arg is the low half of the tick count
+    CRASH_EVENT_READS,       // The I2C reads of the tick returned, arg is status << 8 | reads
+    CRASH_EVENT_BATCH,       // The producer signalled a batch, arg is the samples per batch
+    CRASH_EVENT_COMPUTE,     // consumer_task woke on the batch
+    CRASH_EVENT_REPORT,      // consumer_task queued its reports, arg is the free bursts left
+    CRASH_EVENT_BURST,       // The DMA started a burst, arg is its size
+    CRASH_EVENT_BURST_DONE,  // A burst completed, arg is 1 when it was sent and 0 on an error
+    CRASH_EVENT_I2C_RECOVER, // An I2C bus was recovered, arg is bus << 12 | the low 12 bits of the HAL error code
+    CRASH_EVENT_COMMAND      // A command line arrived, arg is its first two characters
+} crash_event_t;
+
+// One trace entry, as sent over the UART in a trace frame
+typedef struct {
+    uint32_t cycles;  // Cycle count of the event, relative to the other entries
+    uint16_t arg;     // See crash_event_t
+    uint8_t event;    // crash_event_t
+    uint8_t context;  // Exception number it was traced from, 0 in a task
+} crash_event_record_t;
+
+// Fault frame as sent over the UART, little endian, no padding. Sent once
+// after the boot that follows a fault.
+typedef struct {
+    uint8_t type;       // CRASH_FAULT_FRAME_TYPE
+    uint8_t version;    // CRASH_FRAME_VERSION
+    uint8_t vector;     // Exception number: 3 HardFault, 4 MemManage, 5 BusFault, 6 UsageFault
+    uint8_t flags;      // CRASH_FLAG_*
+    uint32_t r0;        // Stacked registers of the faulting context
+    uint32_t r1;
+    uint32_t r2;
+    uint32_t r3;
+    uint32_t r12;
+    uint32_t lr;
+    uint32_t pc;
+    uint32_t xpsr;
+    uint32_t cfsr;      // SCB->CFSR, MemManage, BusFault and UsageFault status
+    uint32_t hfsr;      // SCB->HFSR
+    uint32_t mmfar;     // SCB->MMFAR, valid with CFSR MMARVALID
+    uint32_t bfar;      // SCB->BFAR, valid with CFSR BFARVALID
+    uint32_t sp;        // Stack pointer at the fault, below the stacked frame
+    uint32_t uptime_ms; // HAL_GetTick at the fault
+    char task[4];       // First 4 characters of the running task, zero padded
+} crash_fault_frame_t;
+
+// Trace frame as sent over the UART, little endian, no padding. The events
+// before the last reset, oldest first, split over several frames.
+typedef struct {
+    uint8_t type;     // CRASH_TRACE_FRAME_TYPE
+    uint8_t version;  // CRASH_FRAME_VERSION
+    uint8_t part;     // Index of this frame in the trace, from 0
+    uint8_t count;    // Valid entries in events
+    crash_event_record_t events[CRASH_TRACE_FRAME_EVENTS];
+} crash_trace_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Take over the dump and the trace of the last boot and clear them, early in
+// main. Enables the MemManage, BusFault and UsageFault handlers.
+void crash_capture_init(void);
+
+// Send what crash_capture_init found, once, from a task
+void crash_capture_report(void);
+
+// Keep an event in the trace, any context
+void crash_capture_trace(crash_event_t event, uint32_t arg);
+
+// Dump the fault and reset, entered from the fault handlers with the stacked
+// frame and EXC_RETURN. Only the assembly of the handlers calls it, used keeps
+// it under LTO.
+void crash_capture_fault(const uint32_t *frame, uint32_t exc_return) __attribute__((noreturn, used));
+
+// Body of a fault handler that hands the stack of the faulting context to
+// crash_capture_fault, for stm32f4xx_it.c
+#define CRASH_CAPTURE_HANDLER(name)                \
+    __attribute__((naked)) void name(void)         \
+    {                                              \
+        __asm volatile("tst lr, #4\n"              \
+                       "ite eq\n"                  \
+                       "mrseq r0, msp\n"           \
+                       "mrsne r0, psp\n"           \
+                       "mov r1, lr\n"              \
+                       "b crash_capture_fault\n"); \
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CRASH_CAPTURE_H */
@@ -0,0 +1,33 @@
+/**
+  ******************************************************************************
+  * @file    crc_unit.h
+  * @brief   CRC-32 on the STM32F4 CRC calculation unit.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CRC_UNIT_H
+#define __CRC_UNIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Enable the CRC unit clock
+void crc_unit_init(void);
+
+// CRC-32/MPEG-2 (polynomial 0x04C11DB7, initial value 0xFFFFFFFF, no
+// reflection, no final XOR) of data as the unit sees it: little-endian
+// 32-bit words, the last one padded with zero bytes. One caller at a time,
+// the unit holds the running CRC.
+uint32_t crc_unit_calculate(const uint8_t *data, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CRC_UNIT_H */
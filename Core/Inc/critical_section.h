@@ -0,0 +1,42 @@
+/**
+  ******************************************************************************
+  * @file    critical_section.h
+  * @brief   Short BASEPRI critical sections, callable from tasks and interrupts alike.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CRITICAL_SECTION_H
+#define __CRITICAL_SECTION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "FreeRTOS.h"
+
+/* Exported functions prototypes ---------------------------------------------*/
+// A section raises BASEPRI to configMAX_SYSCALL_INTERRUPT_PRIORITY and puts
+// back the level it found, so it nests and works the same from a task and from
+// any interrupt allowed to call FreeRTOS, the DMA and timer handlers included.
+// Unlike taskENTER_CRITICAL there is no nesting count in the TCB and no
+// handler mode assert, entry and exit are about ten cycles. Keep the section
+// to a few loads and stores, an index or a pair of words, and never call the
+// kernel or block inside it. Interrupts above the kernel mask still run.
+
+// Mask the kernel-aware interrupts, returns the level to restore
+static inline uint32_t critical_section_enter(void) {
+    return portSET_INTERRUPT_MASK_FROM_ISR();
+}
+
+// Restore the level critical_section_enter returned
+static inline void critical_section_exit(uint32_t state) {
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CRITICAL_SECTION_H */
@@ -0,0 +1,41 @@
+/**
+  ******************************************************************************
+  * @file    cycle_counter.h
+  * @brief   Cortex-M4 DWT cycle counter helpers for on-target profiling.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CYCLE_COUNTER_H
+#define __CYCLE_COUNTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Exported functions --------------------------------------------------------*/
+// Enable the trace block and start CYCCNT from zero
+static inline void cycle_counter_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+// Current core cycle count, wraps after 2^32 cycles (25 s at 168 MHz)
+static inline uint32_t cycle_counter_now(void) {
+    return DWT->CYCCNT;
+}
+
+// Cycles elapsed since start, correct across one wrap
+static inline uint32_t cycle_counter_since(uint32_t start) {
+    return DWT->CYCCNT - start;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CYCLE_COUNTER_H */
@@ -0,0 +1,106 @@
+/**
+  ******************************************************************************
+  * @file    deadline_monitor.h
+  * @brief   Lateness, jitter and overrun monitor of the sampling ticks.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __DEADLINE_MONITOR_H
+#define __DEADLINE_MONITOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "sensor_data.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: time every acquisition against its tick, the consumer sends a deadline
+// frame every DEADLINE_MONITOR_PERIOD batches
+#ifndef DEADLINE_MONITOR
+#define DEADLINE_MONITOR 0
+#endif
+// 1: stop reading the slowest I2C sensor while the acquisitions keep running
+// over their budget, and read it again after DEADLINE_MONITOR_RESTORE_TICKS
+#ifndef DEADLINE_MONITOR_SHED
+#define DEADLINE_MONITOR_SHED 0
+#endif
+#if DEADLINE_MONITOR_SHED && !DEADLINE_MONITOR
+#error "DEADLINE_MONITOR_SHED needs DEADLINE_MONITOR"
+#endif
+#ifndef DEADLINE_MONITOR_PERIOD
+#define DEADLINE_MONITOR_PERIOD 4
+#endif
+// Acquisition time, tick to last sample stored, above which a tick counts as late
+#ifndef DEADLINE_MONITOR_BUDGET_PCT
+#define DEADLINE_MONITOR_BUDGET_PCT 75
+#endif
+// Late ticks within DEADLINE_MONITOR_SHED_WINDOW ticks that shed a sensor
+#ifndef DEADLINE_MONITOR_SHED_AFTER
+#define DEADLINE_MONITOR_SHED_AFTER 4
+#endif
+#ifndef DEADLINE_MONITOR_SHED_WINDOW
+#define DEADLINE_MONITOR_SHED_WINDOW 64
+#endif
+// Ticks a shed sensor stays unread, 5 minutes at the default period
+#ifndef DEADLINE_MONITOR_RESTORE_TICKS
+#define DEADLINE_MONITOR_RESTORE_TICKS 1200
+#endif
+// Histogram buckets, log2 of microseconds. Start delays from 1 us, finish
+// times from 2^DEADLINE_MONITOR_FINISH_SHIFT us, the last bucket is open ended.
+#define DEADLINE_MONITOR_BUCKETS 10
+#define DEADLINE_MONITOR_FINISH_SHIFT 6
+// First byte of a deadline frame
+#define DEADLINE_FRAME_TYPE 0xAB
+#define DEADLINE_FRAME_VERSION 1
+
+/* Exported types ------------------------------------------------------------*/
+// Deadline frame as sent over the UART, little endian, no padding.
+// Counters run since boot, the histograms cover the ticks since the last frame.
+typedef struct {
+    uint8_t type;             // DEADLINE_FRAME_TYPE
+    uint8_t version;          // DEADLINE_FRAME_VERSION
+    uint16_t shed_mask;       // Bit n set: channel n (sensor_t) is not read at the moment
+    uint32_t ticks;           // Ticks acquired
+    uint32_t missed;          // Ticks that fired during the previous acquisition and were never sampled
+    uint32_t overruns;        // Acquisitions that ended after the next tick was due
+    uint32_t worst_start_us;  // Largest delay from a tick to the start of its reads
+    uint32_t worst_finish_us; // Largest delay from a tick to its last sample stored
+    uint16_t start_buckets[DEADLINE_MONITOR_BUCKETS];  // Bucket i: [2^i, 2^(i+1)) us, saturated at 65535
+    uint16_t finish_buckets[DEADLINE_MONITOR_BUCKETS]; // Bucket i: [2^(i+6), 2^(i+7)) us
+} deadline_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Clear the counters, before the sampling timer starts
+void deadline_monitor_init(void);
+
+// Start of the acquisition of a tick, with sample_timer_tick_count and the
+// cycle count of its interrupt. A jump in the count is a missed tick.
+void deadline_monitor_start(uint32_t tick_count, uint32_t tick_cycles);
+
+// Bus time of one I2C read of the tick, in core cycles
+void deadline_monitor_read(sensor_t channel, uint32_t cycles);
+
+// End of the acquisition, the tick counts as an overrun past one period and
+// as late past DEADLINE_MONITOR_BUDGET_PCT of it
+void deadline_monitor_finish(uint32_t tick_cycles);
+
+// Channels the producer must not read at this tick, 0 without DEADLINE_MONITOR_SHED
+uint32_t deadline_monitor_shed_mask(void);
+
+// Ticks missed and acquisitions overrun since boot, any task
+uint32_t deadline_monitor_missed(void);
+uint32_t deadline_monitor_overruns(void);
+
+// Fill a frame and restart the histograms. Returns the number of bytes to
+// send. Consumer task only.
+uint16_t deadline_monitor_build(deadline_frame_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DEADLINE_MONITOR_H */
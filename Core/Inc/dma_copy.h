@@ -0,0 +1,72 @@
+/**
+  ******************************************************************************
+  * @file    dma_copy.h
+  * @brief   Asynchronous bulk copies on a DMA2 memory-to-memory stream.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __DMA_COPY_H
+#define __DMA_COPY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stddef.h>
+#include "main.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the window snapshots of the batch median and of the "dump" command are
+// copied by DMA2 Stream1 while the consumer goes on computing
+#ifndef DMA_COPY
+#define DMA_COPY 0
+#endif
+// Smaller copies run on the CPU at once, they take less than the setup and
+// the completion interrupt of a transfer
+#ifndef DMA_COPY_MIN_BYTES
+#define DMA_COPY_MIN_BYTES 256U
+#endif
+// Copies queued between two dma_copy_wait, chained by the interrupt
+#ifndef DMA_COPY_QUEUE
+#define DMA_COPY_QUEUE 4
+#endif
+// A transfer of DMA_COPY_QUEUE blocks at the largest window ends far earlier
+#define DMA_COPY_TIMEOUT_MS 10U
+
+/* Exported macro ------------------------------------------------------------*/
+// Place a buffer the copies read or write: in SRAM with DMA_COPY, where the
+// DMA reaches it, in CCM as CCMRAM_NOINIT otherwise
+#if DMA_COPY && FAST_START
+#define DMA_COPY_RAM NOINIT
+#elif DMA_COPY
+#define DMA_COPY_RAM
+#else
+#define DMA_COPY_RAM CCMRAM_NOINIT
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Configure the stream and its interrupt, before the scheduler starts
+void dma_copy_init(void);
+
+// Queue a copy of size bytes from src to dst. Below DMA_COPY_MIN_BYTES, with
+// an end in CCM or with a full queue it runs on the CPU before the return.
+// Neither buffer may be touched until dma_copy_wait. One task at a time, the
+// consumer.
+void dma_copy_submit(void *dst, const void *src, size_t size);
+
+// Block until every queued copy completed. A transfer that failed or timed
+// out is stopped and its copies are redone on the CPU, so the data is always
+// there on return.
+void dma_copy_wait(void);
+
+// DMA2 Stream1 interrupt, starts the next queued copy or wakes the waiting task
+void dma_copy_irq_from_isr(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DMA_COPY_H */
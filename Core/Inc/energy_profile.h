@@ -0,0 +1,138 @@
+/**
+  ******************************************************************************
+  * @file    energy_profile.h
+  * @brief   GPIO stage markers for a power analyzer and power-state accounting.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __ENERGY_PROFILE_H
+#define __ENERGY_PROFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "main.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: one GPIO line per pipeline stage is high while the stage runs, for a
+// power analyzer that triggers on them, and the time in every power state
+// and clock is accounted on TIM2. Every ENERGY_PROFILE_PERIOD batches an
+// energy frame gives those times and an estimate of the energy per sample.
+#ifndef ENERGY_PROFILE
+#define ENERGY_PROFILE 0
+#endif
+#ifndef ENERGY_PROFILE_PERIOD
+#define ENERGY_PROFILE_PERIOD 8
+#endif
+// First byte of an energy frame
+#define ENERGY_FRAME_TYPE 0xBE
+#define ENERGY_FRAME_VERSION 1
+// Distinct HCLK frequencies accounted, the clock governor has two and the
+// low power profile one more
+#define ENERGY_CLOCK_SLOTS 3
+
+// Supply and currents of the estimate, typical figures of the STM32F407
+// datasheet with the peripherals of the pipeline. Run and sleep grow with
+// HCLK. Calibrate them against the analyzer, the markers show which stage
+// draws what.
+#ifndef ENERGY_SUPPLY_MV
+#define ENERGY_SUPPLY_MV 3300U
+#endif
+#ifndef ENERGY_RUN_BASE_UA
+#define ENERGY_RUN_BASE_UA 2000U
+#endif
+#ifndef ENERGY_RUN_UA_PER_MHZ
+#define ENERGY_RUN_UA_PER_MHZ 250U
+#endif
+#ifndef ENERGY_SLEEP_BASE_UA
+#define ENERGY_SLEEP_BASE_UA 1000U
+#endif
+#ifndef ENERGY_SLEEP_UA_PER_MHZ
+#define ENERGY_SLEEP_UA_PER_MHZ 70U
+#endif
+#ifndef ENERGY_STOP_UA
+#define ENERGY_STOP_UA 300U
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+// Pipeline stages, each on its own marker line ENERGY_MARKER_PIN(stage)
+typedef enum {
+    ENERGY_STAGE_ACQUIRE,  // producer_task, from the tick to the last sample stored
+    ENERGY_STAGE_COMPUTE,  // consumer_task, statistics of a batch
+    ENERGY_STAGE_TRANSMIT, // USART2 DMA busy with a burst
+    ENERGY_STAGE_SLEEP,    // Idle task in WFI, SLEEP or STOP mode
+    ENERGY_STAGE_COUNT
+} energy_stage_t;
+
+// Power states of the accounting
+typedef enum {
+    ENERGY_STATE_RUN,
+    ENERGY_STATE_SLEEP, // WFI with the clocks running
+    ENERGY_STATE_STOP,  // RTC_STOP_SAMPLING, the clocks stopped
+    ENERGY_STATE_COUNT
+} energy_state_t;
+
+// Run and sleep time at one HCLK frequency
+typedef struct {
+    uint16_t mhz;     // 0: slot unused
+    uint16_t reserved;
+    uint32_t time_ms;
+} energy_clock_t;
+
+// Energy frame as sent over the UART, little endian, no padding. Times are
+// over the interval since the previous frame, in ms, which with STOP
+// sampling may last for hours.
+typedef struct {
+    uint8_t type;                          // ENERGY_FRAME_TYPE
+    uint8_t version;                       // ENERGY_FRAME_VERSION
+    uint16_t clock_mhz;                    // HCLK when the frame was built
+    uint32_t interval_ms;                  // Sum of state_ms
+    uint32_t state_ms[ENERGY_STATE_COUNT]; // Time in each energy_state_t
+    energy_clock_t clocks[ENERGY_CLOCK_SLOTS];
+    uint32_t samples;                      // Samples published, every channel
+    uint32_t energy_uj;                    // Estimate over the interval
+    uint32_t sample_nj;                    // Estimate per sample in nJ, 0 without samples
+} energy_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Set up the marker lines low and start the accounting in RUN, before the
+// scheduler starts TIM2
+void energy_profile_init(void);
+
+// The core enters state, from the idle task with interrupts masked
+void energy_profile_enter(energy_state_t state);
+
+// HCLK changed, after SystemCoreClockUpdate. The time since the last
+// transition counts at the previous clock.
+void energy_profile_clock_changed(void);
+
+// Add the time the core spent in STOP, which TIM2 does not see
+void energy_profile_stopped(uint32_t ms);
+
+// Count one published sample, producer task only
+void energy_profile_sample(void);
+
+// Fill a frame with the interval since the previous call and start the next.
+// Returns the number of bytes to send, consumer task only.
+uint16_t energy_profile_build(energy_frame_t *frame);
+
+/* Exported functions --------------------------------------------------------*/
+// Raise the marker line of a stage, one store, any context
+static inline void energy_profile_begin(energy_stage_t stage) {
+    ENERGY_MARKER_GPIO_Port->BSRR = ENERGY_MARKER_PIN(stage);
+}
+
+// Lower the marker line of a stage, one store, any context
+static inline void energy_profile_end(energy_stage_t stage) {
+    ENERGY_MARKER_GPIO_Port->BSRR = (uint32_t)ENERGY_MARKER_PIN(stage) << 16;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ENERGY_PROFILE_H */
@@ -0,0 +1,70 @@
+/**
+  ******************************************************************************
+  * @file    event_coding.h
+  * @brief   Run-length statistics of the channels that only store their level changes.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __EVENT_CODING_H
+#define __EVENT_CODING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sample_ring.h"
+#include "sensor_data.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: a channel with event_coded in its registry row stores a sample only when
+// its value changes, its statistics and its log records are taken from the
+// runs between the changes
+#ifndef SENSOR_EVENT_CODING
+#define SENSOR_EVENT_CODING 0
+#endif
+// Batches between two event frames
+#ifndef SENSOR_EVENT_CODING_PERIOD
+#define SENSOR_EVENT_CODING_PERIOD 4
+#endif
+// First byte of an event frame
+#define EVENT_CODING_FRAME_TYPE 0xB9
+#define EVENT_CODING_FRAME_VERSION 1
+
+/* Exported types ------------------------------------------------------------*/
+// The runs of one event-coded channel over its window, little endian, no
+// padding. A run is active when its value is not 0.
+typedef struct {
+    uint8_t type;               // EVENT_CODING_FRAME_TYPE
+    uint8_t version;            // EVENT_CODING_FRAME_VERSION
+    uint8_t channel;            // sensor_t
+    uint8_t active;             // 1: the newest run is still active
+    uint32_t timestamp;         // End of the window, ms on the sample time base
+    uint32_t window_ms;         // From the start of the oldest run in the window
+    uint16_t runs;              // Runs in the window, the newest one included
+    uint16_t events;            // Idle to active changes in the window
+    uint16_t duty;              // Active share of the window, in 0.01 %
+    uint16_t reserved;
+    uint32_t longest_active_ms; // Longest active run, the newest one up to timestamp
+    uint32_t longest_idle_ms;
+} event_coding_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Measure the runs of the samples the SAMPLE_READER_STATS reader of ring
+// holds, the newest one lasting until now, and overwrite the STD_DEV and
+// MEDIAN statistics in out with their values weighted by time. unit turns
+// a stored value into out's. False when the window is empty. Consumer task
+// only, after the window of the batch was updated.
+bool event_coding_update(sensor_t channel, const sample_ring_t *ring, uint32_t now, float unit, float *out);
+
+// Send the runs of every channel updated since the last call, consumer task only
+void event_coding_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __EVENT_CODING_H */
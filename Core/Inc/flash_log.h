@@ -0,0 +1,117 @@
+/**
+  ******************************************************************************
+  * @file    flash_log.h
+  * @brief   Log-structured record store in the internal flash, with replay.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __FLASH_LOG_H
+#define __FLASH_LOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "flash_log_frame.h"
+#include "uart_tx.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: raw samples and statistics are appended to the flash log and a
+// "replay <sequence>" command sends them again
+#ifndef FLASH_LOG
+#define FLASH_LOG 0
+#endif
+// 1: the raw samples are logged as FLASH_LOG_RECORD_SAMPLES_PACKED records,
+// coded by sample_codec, instead of plain codes
+#ifndef FLASH_LOG_COMPRESS
+#define FLASH_LOG_COMPRESS 0
+#endif
+// Sectors 10 and 11, 128 KB each, left out of the FLASH region of
+// STM32F407VGTX_FLASH.ld. The log rotates through them oldest first, so
+// both wear alike.
+#define FLASH_LOG_SECTOR_FIRST 10U
+#define FLASH_LOG_SECTOR_COUNT 2U
+#define FLASH_LOG_SECTOR_SIZE 0x20000U
+#define FLASH_LOG_BASE 0x080C0000U
+// Records are collected in RAM and programmed one page at a time. The first
+// page of every sector holds its header.
+#ifndef FLASH_LOG_PAGE_SIZE
+#define FLASH_LOG_PAGE_SIZE 256U
+#endif
+#define FLASH_LOG_PAGES_PER_SECTOR (FLASH_LOG_SECTOR_SIZE / FLASH_LOG_PAGE_SIZE)
+// 1: the idle hook erases the next sector once the write sector has
+// FLASH_LOG_ERASE_AHEAD_PAGES pages left, so an append never waits for an
+// erase. The oldest records go that much earlier.
+#ifndef FLASH_LOG_IDLE_ERASE
+#define FLASH_LOG_IDLE_ERASE 0
+#endif
+#ifndef FLASH_LOG_ERASE_AHEAD_PAGES
+#define FLASH_LOG_ERASE_AHEAD_PAGES 32U
+#endif
+#if FLASH_LOG_IDLE_ERASE && !FLASH_LOG
+#error "FLASH_LOG_IDLE_ERASE needs FLASH_LOG"
+#endif
+#if FLASH_LOG_ERASE_AHEAD_PAGES < 1 || FLASH_LOG_ERASE_AHEAD_PAGES >= FLASH_LOG_PAGES_PER_SECTOR
+#error "FLASH_LOG_ERASE_AHEAD_PAGES must be at least 1 and below FLASH_LOG_PAGES_PER_SECTOR"
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Find the newest sector and the end of the log, erasing the first sector
+// when no sector is formatted. Before the scheduler starts.
+void flash_log_init(void);
+
+// Create the replay task, it sleeps until flash_log_replay is called
+void flash_log_start(void);
+
+// Append a record to the page buffer, the page is programmed when the next
+// record does not fit. Programming a page takes about a millisecond; moving
+// to the next sector erases it, which stalls the CPU for one to two seconds
+// because the code runs from the same flash bank. Task context only.
+bool flash_log_append(flash_log_record_t type, uint32_t timestamp, const void *payload, uint16_t size);
+
+// Program the buffered records now
+void flash_log_flush(void);
+
+// FLASH_LOG_IDLE_ERASE: erase the next sector when it is due, from the idle
+// hook only. The erase runs from SRAM with every interrupt but the sampling
+// tick masked, see flash_log.c.
+void flash_log_idle(void);
+
+// Send every record from sequence on, oldest first, while leaving one burst
+// of the transmit queue to the live frames. The replay ends with a
+// FLASH_LOG_RECORD_END frame. A replay that is running restarts at sequence.
+void flash_log_replay(uint32_t sequence);
+
+// Copy the oldest record at or after sequence into a replay frame. Returns
+// the frame size, 0 when the log holds nothing that new. Task context only.
+uint16_t flash_log_read(uint32_t sequence, flash_log_frame_t *frame);
+
+// Sequence to read from for the records of timestamp on: the first record of
+// the newest page that starts at or before it, the oldest record when none
+// does. Timestamps count from boot, so the seek assumes the log since then;
+// records a little out of order, like samples stamped with the start of
+// their batch, need the caller to seek a margin earlier. Task context only.
+uint32_t flash_log_seek(uint32_t timestamp);
+
+// Sequence the next record will get
+uint32_t flash_log_next_sequence(void);
+
+// Pages that failed to program plus failed erases, logging stops after a
+// failed erase
+uint32_t flash_log_errors(void);
+
+// Hold off the programming and erasing of the log while another module
+// writes its own sectors of the bank, the flash control register is shared.
+// Task context only, after flash_log_init.
+void flash_log_lock(void);
+void flash_log_unlock(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FLASH_LOG_H */
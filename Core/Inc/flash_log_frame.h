@@ -0,0 +1,125 @@
+/**
+  ******************************************************************************
+  * @file    flash_log_frame.h
+  * @brief   Replayed flash log records as sent over the UART.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __FLASH_LOG_FRAME_H
+#define __FLASH_LOG_FRAME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "wire_format.h"
+
+/* Exported constants --------------------------------------------------------*/
+// Largest UART frame, the same default as uart_tx.h, so a receiver can use
+// this header without the HAL
+#ifndef UART_TX_FRAME_MAX
+#define UART_TX_FRAME_MAX 64
+#endif
+// First byte of a replayed record
+#define FLASH_LOG_FRAME_TYPE 0xA6
+#define FLASH_LOG_FRAME_VERSION 1
+// Largest record payload, a replayed record must fit one UART frame
+#define FLASH_LOG_PAYLOAD_MAX (UART_TX_FRAME_MAX - 12U)
+// Sample codes per FLASH_LOG_RECORD_SAMPLES record
+#define FLASH_LOG_SAMPLES_MAX ((FLASH_LOG_PAYLOAD_MAX - 4U) / 2U)
+// Level changes per FLASH_LOG_RECORD_EVENTS record
+#define FLASH_LOG_EVENTS_MAX ((FLASH_LOG_PAYLOAD_MAX - 4U) / 4U)
+// Most sample codes per FLASH_LOG_RECORD_SAMPLES_PACKED record, one bit each
+// when nothing changes, bounded by the 8-bit count
+#define FLASH_LOG_PACKED_MAX 255U
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    FLASH_LOG_RECORD_STATS = 1, // stats_frame_t of every channel, as stats_frame_encode fills it
+    FLASH_LOG_RECORD_SAMPLES,   // flash_log_samples_t
+    FLASH_LOG_RECORD_END,       // Replay only: no payload, sequence is the next one to be logged
+    FLASH_LOG_RECORD_SAMPLES_PACKED, // flash_log_packed_t
+    FLASH_LOG_RECORD_ROLLUP,        // rollup_record_t of stats_rollup.h
+    FLASH_LOG_RECORD_EVENTS         // flash_log_events_t
+} flash_log_record_t;
+
+// Payload of a FLASH_LOG_RECORD_SAMPLES record, timestamp of its record is
+// the one of codes[0]
+typedef struct {
+    uint8_t channel;      // sensor_t
+    uint8_t count;        // Codes that follow, oldest first
+    uint16_t interval_ms; // Nominal time between two codes
+    int16_t codes[FLASH_LOG_SAMPLES_MAX]; // sensor_to_fixed of each sample
+} flash_log_samples_t;
+
+WIRE_ASSERT_FIELD(flash_log_samples_t, channel, 0, 1);
+WIRE_ASSERT_FIELD(flash_log_samples_t, count, 1, 1);
+WIRE_ASSERT_FIELD(flash_log_samples_t, interval_ms, 2, 2);
+WIRE_ASSERT_FIELD(flash_log_samples_t, codes, 4, 2 * FLASH_LOG_SAMPLES_MAX);
+
+// Payload of a FLASH_LOG_RECORD_SAMPLES_PACKED record, the same samples as a
+// flash_log_samples_t with the codes run through sample_codec_encode. The
+// record only stores the data bytes that were used.
+typedef struct {
+    uint8_t channel;      // sensor_t
+    uint8_t count;        // Codes in data, oldest first
+    uint16_t interval_ms; // Nominal time between two codes
+    uint8_t data[FLASH_LOG_PAYLOAD_MAX - 4U];
+} flash_log_packed_t;
+
+WIRE_ASSERT_FIELD(flash_log_packed_t, channel, 0, 1);
+WIRE_ASSERT_FIELD(flash_log_packed_t, count, 1, 1);
+WIRE_ASSERT_FIELD(flash_log_packed_t, interval_ms, 2, 2);
+WIRE_ASSERT_FIELD(flash_log_packed_t, data, 4, FLASH_LOG_PAYLOAD_MAX - 4U);
+
+// One level change of an event-coded channel
+typedef struct {
+    uint16_t offset_ms; // After the timestamp of its record
+    int16_t code;       // sensor_to_fixed of the new value
+} flash_log_event_t;
+
+// Payload of a FLASH_LOG_RECORD_EVENTS record, the samples of an event-coded
+// channel: each starts a run that lasts until the next one. The timestamp of
+// its record is the one of events[0], the record only stores the events it
+// holds.
+typedef struct {
+    uint8_t channel; // sensor_t
+    uint8_t count;   // Events that follow, oldest first
+    uint16_t reserved;
+    flash_log_event_t events[FLASH_LOG_EVENTS_MAX];
+} flash_log_events_t;
+
+WIRE_ASSERT_FIELD(flash_log_event_t, offset_ms, 0, 2);
+WIRE_ASSERT_FIELD(flash_log_event_t, code, 2, 2);
+WIRE_ASSERT_FIELD(flash_log_events_t, channel, 0, 1);
+WIRE_ASSERT_FIELD(flash_log_events_t, count, 1, 1);
+WIRE_ASSERT_FIELD(flash_log_events_t, events, 4, 4 * FLASH_LOG_EVENTS_MAX);
+
+// Replayed record as sent over the UART, little endian, no padding before
+// payload[]. Sequences count every logged record, gaps are records that
+// were overwritten or lost in a torn page.
+typedef struct {
+    uint8_t type;        // FLASH_LOG_FRAME_TYPE
+    uint8_t version;     // FLASH_LOG_FRAME_VERSION
+    uint8_t record_type; // flash_log_record_t
+    uint8_t reserved;
+    uint32_t sequence;
+    uint32_t timestamp;  // ms on the sample time base
+    uint8_t payload[FLASH_LOG_PAYLOAD_MAX];
+} flash_log_frame_t;
+
+WIRE_ASSERT_FIELD(flash_log_frame_t, type, 0, 1);
+WIRE_ASSERT_FIELD(flash_log_frame_t, version, 1, 1);
+WIRE_ASSERT_FIELD(flash_log_frame_t, record_type, 2, 1);
+WIRE_ASSERT_FIELD(flash_log_frame_t, sequence, 4, 4);
+WIRE_ASSERT_FIELD(flash_log_frame_t, timestamp, 8, 4);
+WIRE_ASSERT_FIELD(flash_log_frame_t, payload, 12, FLASH_LOG_PAYLOAD_MAX);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FLASH_LOG_FRAME_H */
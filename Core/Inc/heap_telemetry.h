@@ -0,0 +1,80 @@
+/**
+  ******************************************************************************
+  * @file    heap_telemetry.h
+  * @brief   FreeRTOS heap_4 and newlib heap usage frame.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __HEAP_TELEMETRY_H
+#define __HEAP_TELEMETRY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// 1: allocations are traced and the state of both heaps is sent every
+// HEAP_TELEMETRY_PERIOD batches
+#ifndef HEAP_TELEMETRY
+#define HEAP_TELEMETRY 0
+#endif
+#ifndef HEAP_TELEMETRY_PERIOD
+#define HEAP_TELEMETRY_PERIOD 16
+#endif
+// First byte of a heap telemetry frame
+#define HEAP_TELEMETRY_FRAME_TYPE 0xA8
+
+// Bits of heap_telemetry_frame_t.flags
+#define HEAP_TELEMETRY_FLAG_NO_RTOS_HEAP 0x01U // STATIC_ALLOCATION_ONLY, the rtos_ fields are 0
+#define HEAP_TELEMETRY_FLAG_LATE_ALLOC 0x02U   // Something allocated after the scheduler started
+#define HEAP_TELEMETRY_FLAG_FAILED 0x04U       // An allocation of either heap failed
+#define HEAP_TELEMETRY_FLAG_ARENA 0x08U        // STATS_ARENA, the arena_ fields are set
+
+/* Exported types ------------------------------------------------------------*/
+// Little endian, no padding. Counts are since boot.
+typedef struct {
+    uint8_t type;                // HEAP_TELEMETRY_FRAME_TYPE
+    uint8_t flags;               // HEAP_TELEMETRY_FLAG_*
+    uint16_t rtos_free_blocks;   // Fragments of the free space
+    uint32_t rtos_free;          // Sum of the free blocks, bytes
+    uint32_t rtos_min_ever_free;
+    uint32_t rtos_largest_free;  // Largest block pvPortMalloc can return now
+    uint32_t rtos_allocs;
+    uint32_t rtos_frees;
+    uint32_t rtos_failed;        // vApplicationMallocFailedHook calls
+    uint32_t late_allocs;        // pvPortMalloc calls and newlib heap growths after vTaskStartScheduler
+    uint32_t late_size;          // Bytes asked for by the last of them
+    char late_task[4];           // First characters of the task that made it
+    uint32_t sbrk_used;          // newlib heap above _end, bytes
+    uint32_t sbrk_peak;
+    uint32_t sbrk_failed;        // _sbrk calls refused to protect the main stack
+    uint32_t arena_size;         // Window arena of stats_arena.h, bytes
+    uint32_t arena_used;         // Carved for the current window size
+    uint32_t arena_peak;         // Largest layout since boot
+} heap_telemetry_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Fill a frame with the state of both heaps and the window arena, returns the number of bytes to send
+uint16_t heap_telemetry_build(heap_telemetry_frame_t *frame);
+
+// Kernel hook, called through traceMALLOC with the block and its size
+void heap_telemetry_malloc(void *address, uint32_t size);
+
+// Called from vApplicationMallocFailedHook
+void heap_telemetry_malloc_failed(void);
+
+// Called from _sbrk with the increment it granted and the heap size after it
+void heap_telemetry_sbrk(int32_t increment, uint32_t used);
+
+// Called from _sbrk when it refuses to grow the heap
+void heap_telemetry_sbrk_failed(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HEAP_TELEMETRY_H */
@@ -0,0 +1,110 @@
+/**
+  ******************************************************************************
+  * @file    i2c_acquisition.h
+  * @brief   DMA-driven I2C acquisition engine used by the producer task.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __I2C_ACQUISITION_H
+#define __I2C_ACQUISITION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+// Bus profiles, chosen at build time through I2C_BUS_SPEED_HZ
+#define I2C_BUS_STANDARD_MODE_HZ 100000
+#define I2C_BUS_FAST_MODE_HZ 400000
+#ifndef I2C_BUS_SPEED_HZ
+#define I2C_BUS_SPEED_HZ I2C_BUS_STANDARD_MODE_HZ
+#endif
+#if I2C_BUS_SPEED_HZ == I2C_BUS_FAST_MODE_HZ
+// Tlow/Thigh = 2, exactly 400 kHz when PCLK1 is a multiple of 1.2 MHz,
+// which holds for both clock profiles (42 MHz and 24 MHz)
+#define I2C_BUS_DUTY_CYCLE I2C_DUTYCYCLE_2
+#elif I2C_BUS_SPEED_HZ == I2C_BUS_STANDARD_MODE_HZ
+// Ignored by the peripheral in standard mode
+#define I2C_BUS_DUTY_CYCLE I2C_DUTYCYCLE_2
+#else
+#error "I2C_BUS_SPEED_HZ must be I2C_BUS_STANDARD_MODE_HZ or I2C_BUS_FAST_MODE_HZ"
+#endif
+// Buses the sensors are spread over, each with its own DMA stream: 1 is I2C1
+// on PB6/PB7, 2 adds I2C2 on PB10/PB11, 3 adds I2C3 on PA8/PC9. The reads of
+// one tick run on all buses at the same time. See SENSOR_BUS_* in sensor_registry.h.
+#ifndef I2C_BUS_COUNT
+#define I2C_BUS_COUNT 1
+#endif
+#if I2C_BUS_COUNT < 1 || I2C_BUS_COUNT > 3
+#error "I2C_BUS_COUNT must be 1, 2 or 3"
+#endif
+// Upper bound for one sensor read before the transfer is aborted
+#define I2C_ACQUISITION_TIMEOUT_MS 10
+// 1: the sensors are supplied through SENSOR_POWER_Pin and the buses clocked
+// only while the producer reads them, off from the end of one tick to the next
+#ifndef SENSOR_POWER_GATING
+#define SENSOR_POWER_GATING 0
+#endif
+// Start-up time of the sensors after their supply comes up, before the first transaction
+#ifndef SENSOR_POWER_UP_MS
+#define SENSOR_POWER_UP_MS 2
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+// One read or write of a sample sequence, status and done_cycles are written when it finished
+typedef struct {
+    uint8_t device_address;
+    uint8_t bus; // 0 is I2C1, 1 I2C2, 2 I2C3, below I2C_BUS_COUNT
+    uint8_t write; // 1: send data to the device, interrupt driven, 0: read it into data with DMA
+    uint8_t *data;
+    uint16_t size;
+    volatile HAL_StatusTypeDef status;
+    volatile uint32_t done_cycles; // DWT cycle count at the end of the read
+} i2c_transaction_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Reset the acquisition state, must run before the scheduler starts
+void i2c_acquisition_init(void);
+
+// Run a list of transactions and block the calling task until the last one
+// completed. The transactions of each bus run back to back in list order,
+// each one chained from the completion interrupt of the one before, and the
+// buses run at the same time. A failing device does not stop the list.
+// Returns HAL_OK when every transaction succeeded, HAL_TIMEOUT when the whole
+// list did not finish within timeout_ms and HAL_ERROR otherwise. The data
+// buffers must stay valid until the call returns, those of reads DMA reachable.
+// One task at a time, several requesters go through i2c_arbiter_run.
+HAL_StatusTypeDef i2c_acquisition_run(i2c_transaction_t *list, uint32_t count, uint32_t timeout_ms);
+
+// Free a bus held by a slave and reinitialize its peripheral. Clocks SCL
+// until SDA is released, sends a STOP and resets the peripheral. Runs
+// automatically after a timeout, bus error or lost arbitration, task context only.
+void i2c_acquisition_recover(uint32_t bus);
+
+// SENSOR_POWER_GATING: switch the sensor supply and the buses on, then wait
+// SENSOR_POWER_UP_MS, or release the buses and switch the supply off. Task
+// context only, never while a list runs. The pins are floating inputs while
+// off, so the powered-down sensors are not fed through their I2C inputs.
+void i2c_acquisition_power(bool on);
+
+// Start a DMA read on I2C1 and block the calling task until it completes.
+// The task is woken by a notification on TASK_SIGNAL_I2C_DONE.
+// The CPU is free for other tasks while the transfer is on the bus.
+HAL_StatusTypeDef i2c_acquisition_read(uint8_t device_address, uint8_t *data, uint16_t size, uint32_t timeout_ms);
+
+// LL_FAST_PATH interrupt handlers of a bus, called in place of the HAL ones
+// from the I2Cx event and error IRQs and the IRQ of its receive DMA stream
+void i2c_acquisition_ev_from_isr(uint32_t bus);
+void i2c_acquisition_er_from_isr(uint32_t bus);
+void i2c_acquisition_dma_from_isr(uint32_t bus);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __I2C_ACQUISITION_H */
@@ -0,0 +1,56 @@
+/**
+  ******************************************************************************
+  * @file    i2c_arbiter.h
+  * @brief   Priority arbiter of the I2C buses between the tasks that run transaction lists.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __I2C_ARBITER_H
+#define __I2C_ARBITER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "i2c_acquisition.h"
+#include "cmsis_os.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the acquisition engine is shared, a task that finds it busy waits in a
+// queue ordered by class and deadline. 0: the producer is its only user.
+#ifndef I2C_ARBITER
+#define I2C_ARBITER 0
+#endif
+// Tasks that can wait for the buses at the same time
+#ifndef I2C_ARBITER_WAITERS
+#define I2C_ARBITER_WAITERS 4
+#endif
+#if I2C_ARBITER && SENSOR_POWER_GATING
+#error "I2C_ARBITER: the buses are off between the ticks of SENSOR_POWER_GATING, a second requester would find them off"
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+// A waiting list of a lower class is never granted before one of a higher class
+typedef enum {
+    I2C_ARBITER_SAMPLING = 0, // Periodic reads and FIFO drains of the producer
+    I2C_ARBITER_BACKGROUND,   // Configuration writes, calibration reads, anything on demand
+} i2c_arbiter_class_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// i2c_acquisition_run once the buses are free. A list waits for the one that
+// runs, never preempts it, then the waiting list of the highest class goes
+// first and among those the one with the earliest deadline, a tick count by
+// which it should start. The grant is a notification on TASK_SIGNAL_I2C_GRANT.
+// Returns the status of i2c_acquisition_run, or HAL_BUSY with every
+// transaction HAL_BUSY when I2C_ARBITER_WAITERS tasks already wait. Task
+// context only, never from the task that runs a list.
+HAL_StatusTypeDef i2c_arbiter_run(i2c_transaction_t *list, uint32_t count, uint32_t timeout_ms,
+                                  i2c_arbiter_class_t request_class, TickType_t deadline);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __I2C_ARBITER_H */
@@ -0,0 +1,84 @@
+/**
+  ******************************************************************************
+  * @file    i2c_telemetry.h
+  * @brief   Utilization and error counters of every I2C bus and device.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __I2C_TELEMETRY_H
+#define __I2C_TELEMETRY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the acquisition engine counts every transaction of every bus and device,
+// and a table of them is sent every I2C_TELEMETRY_PERIOD batches
+#ifndef I2C_TELEMETRY
+#define I2C_TELEMETRY 0
+#endif
+#ifndef I2C_TELEMETRY_PERIOD
+#define I2C_TELEMETRY_PERIOD 16
+#endif
+// Devices counted one by one, the transactions of any further device only count for their bus
+#ifndef I2C_TELEMETRY_DEVICES
+#define I2C_TELEMETRY_DEVICES 8
+#endif
+// First byte of an I2C telemetry frame
+#define I2C_TELEMETRY_FRAME_TYPE 0xBC
+#define I2C_TELEMETRY_FRAME_VERSION 1
+// Entries per frame, a table takes as many frames as it needs
+#define I2C_TELEMETRY_FRAME_ENTRIES 2
+// Address of the entry that sums a whole bus
+#define I2C_TELEMETRY_BUS_ENTRY 0xFF
+
+/* Exported types ------------------------------------------------------------*/
+// One bus or one device over the window, little endian, no padding
+typedef struct {
+    uint8_t bus;              // 0 is I2C1, 1 I2C2, 2 I2C3
+    uint8_t address;          // 7-bit device address, I2C_TELEMETRY_BUS_ENTRY for the whole bus
+    uint16_t utilization;     // Share of the window spent in its transactions, in 0.01 %
+    uint32_t transactions;    // Started or refused by the peripheral, good and bad
+    uint32_t bytes;           // Moved by the transactions that completed
+    uint32_t busy_us;         // From the start of each transaction to its end
+    uint16_t nacks;           // Address or data not acknowledged
+    uint16_t arbitration_lost;
+    uint16_t bus_errors;      // Misplaced START or STOP
+    uint16_t timeouts;        // Aborted when the list ran out of time
+    uint16_t other_errors;    // Overrun, DMA error, refused by the peripheral
+    uint16_t recoveries;      // Bus recoveries, 0 in the device entries
+} i2c_telemetry_entry_t;
+
+typedef struct {
+    uint8_t type;        // I2C_TELEMETRY_FRAME_TYPE
+    uint8_t version;     // I2C_TELEMETRY_FRAME_VERSION
+    uint8_t sequence;    // Frame of the table, from 0
+    uint8_t entry_count;
+    uint32_t window_ms;  // Time the table covers, since the previous one
+    i2c_telemetry_entry_t entries[I2C_TELEMETRY_FRAME_ENTRIES];
+} i2c_telemetry_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// End of one transaction of a bus with its status, the HAL_I2C_ERROR_* flags
+// seen and the cycles it held the bus, 0 when the peripheral refused it.
+// From the interrupts of the buses, or with them masked.
+void i2c_telemetry_transaction_from_isr(uint32_t bus, uint8_t address, uint16_t size, HAL_StatusTypeDef status,
+                                        uint32_t error, uint32_t cycles);
+
+// One recovery of a bus, task context
+void i2c_telemetry_recovery(uint32_t bus);
+
+// Send the buses, then the devices, used since the last call and start a new
+// window, consumer task only
+void i2c_telemetry_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __I2C_TELEMETRY_H */
@@ -0,0 +1,63 @@
+/**
+  ******************************************************************************
+  * @file    isr_pipeline.h
+  * @brief   Interrupt-only operating mode, the pipeline without the scheduler.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __ISR_PIPELINE_H
+#define __ISR_PIPELINE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the scheduler never starts. Each TIM3 tick pends a software interrupt
+// below every other one, which samples the channels that need no I2C
+// sequence (ADC, captures, hooks and derived rows) and at the end
+// of a batch computes and sends the statistics report. In between the core
+// sleeps on exit from the interrupts and never returns to main. For the
+// simple configurations only, see the checks in main.c.
+#ifndef ISR_PIPELINE
+#define ISR_PIPELINE 0
+#endif
+// Spare vector of the deferred work, the HASH and RNG units are not used
+#define ISR_PIPELINE_IRQn HASH_RNG_IRQn
+
+/* Exported types ------------------------------------------------------------*/
+// Samples one tick at its scheduled time, true when it completed a batch
+typedef bool (*isr_pipeline_acquire_t)(uint32_t timestamp);
+// Computes and sends the report of the batch just completed
+typedef void (*isr_pipeline_report_t)(void);
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Set the stages of the deferred work and enable its interrupt, before the
+// sampling timer starts. report may be NULL when acquire never completes a
+// batch, as with TT_EXECUTIVE, whose schedule holds the report.
+void isr_pipeline_init(isr_pipeline_acquire_t acquire, isr_pipeline_report_t report);
+
+// Hand a tick to the deferred work, from the TIM3 interrupt
+void isr_pipeline_tick_from_isr(uint32_t timestamp);
+
+// Deferred work, from the interrupt handler of ISR_PIPELINE_IRQn. Runs the
+// latest tick, those it could not get to in time are counted as overruns.
+void isr_pipeline_deferred_from_isr(void);
+
+// Stop the HAL tick and sleep on exit from every interrupt, in place of
+// vTaskStartScheduler. Never returns.
+void isr_pipeline_run(void) __attribute__((noreturn));
+
+// Ticks the deferred work skipped since boot
+uint32_t isr_pipeline_overruns(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ISR_PIPELINE_H */
@@ -0,0 +1,120 @@
+/**
+  ******************************************************************************
+  * @file    isr_profile.h
+  * @brief   Duration, entry latency and CPU share of the peripheral interrupts.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __ISR_PROFILE_H
+#define __ISR_PROFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// 1: every peripheral handler of stm32f4xx_it.c is timed on the cycle counter,
+// and a table of the interrupts that ran is sent every ISR_PROFILE_PERIOD batches
+#ifndef ISR_PROFILE
+#define ISR_PROFILE 0
+#endif
+#ifndef ISR_PROFILE_PERIOD
+#define ISR_PROFILE_PERIOD 16
+#endif
+// First byte of an interrupt profile frame
+#define ISR_PROFILE_FRAME_TYPE 0xB6
+#define ISR_PROFILE_FRAME_VERSION 1
+// Log2 buckets of the durations in cycles, the last one takes everything longer
+#define ISR_PROFILE_BUCKETS 16
+// Interrupts per frame, a table takes as many frames as it needs
+#define ISR_PROFILE_FRAME_ENTRIES 3
+// latency_max_us of an interrupt that has no timer counter to measure it from
+#define ISR_PROFILE_NO_LATENCY 0xFFFFU
+
+/* Exported types ------------------------------------------------------------*/
+// Timed handlers, the numbers are the same whatever the build enables
+typedef enum {
+    ISR_PROFILE_EXTI0 = 0,
+    ISR_PROFILE_EXTI1,
+    ISR_PROFILE_DMA1_STREAM0,
+    ISR_PROFILE_DMA1_STREAM2,
+    ISR_PROFILE_DMA1_STREAM3,
+    ISR_PROFILE_DMA1_STREAM5,
+    ISR_PROFILE_DMA1_STREAM6,
+    ISR_PROFILE_TIM1_UP_TIM10,
+    ISR_PROFILE_TIM2,
+    ISR_PROFILE_TIM3,
+    ISR_PROFILE_I2C1_EV,
+    ISR_PROFILE_I2C1_ER,
+    ISR_PROFILE_I2C2_EV,
+    ISR_PROFILE_I2C2_ER,
+    ISR_PROFILE_I2C3_EV,
+    ISR_PROFILE_I2C3_ER,
+    ISR_PROFILE_USART2,
+    ISR_PROFILE_TIM5,
+    ISR_PROFILE_DMA2_STREAM0,
+    ISR_PROFILE_EXTI9_5,
+    ISR_PROFILE_TIM4,
+    ISR_PROFILE_DMA1_STREAM7,
+    ISR_PROFILE_RTC_WKUP,
+    ISR_PROFILE_DMA2_STREAM1,
+    ISR_PROFILE_DMA2_STREAM7,
+    ISR_PROFILE_USART1,
+    ISR_PROFILE_IRQ_COUNT
+} isr_profile_irq_t;
+
+// Kept on the stack of a handler from its entry to its exit
+typedef struct {
+    uint32_t start;  // Cycle count at entry
+    uint32_t nested; // Cycles of the handlers that had preempted others, at entry
+} isr_profile_context_t;
+
+// One interrupt over the window, little endian, no padding
+typedef struct {
+    uint8_t irq;              // isr_profile_irq_t
+    uint8_t p50_bucket;       // Half of the runs took less than 2^(p50_bucket + 1) cycles
+    uint8_t p99_bucket;       // Same for 99 % of the runs
+    uint8_t reserved;
+    uint16_t share_permyriad; // Share of the core cycles of the window, in 0.01 %
+    uint16_t latency_max_us;  // Longest time from the timer event to the handler
+    uint32_t count;
+    uint32_t max_cycles;      // Longest run, without the handlers that preempted it
+} isr_profile_entry_t;
+
+typedef struct {
+    uint8_t type;        // ISR_PROFILE_FRAME_TYPE
+    uint8_t version;     // ISR_PROFILE_FRAME_VERSION
+    uint8_t sequence;    // Frame of the table, from 0
+    uint8_t entry_count;
+    uint32_t window_ms;  // Time the table covers, since the previous one
+    isr_profile_entry_t entries[ISR_PROFILE_FRAME_ENTRIES];
+} isr_profile_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Clear the tables and start the first window, before the scheduler starts
+void isr_profile_init(void);
+
+// First thing in a handler
+void isr_profile_enter(isr_profile_context_t *context);
+
+// Last thing in a handler, on every return path. The time of the handlers
+// that preempted it is taken out.
+void isr_profile_exit(isr_profile_irq_t irq, const isr_profile_context_t *context);
+
+// Record how long after its timer event a handler was entered, from the
+// counter of the timer, which restarts from 0 at the event
+void isr_profile_latency(isr_profile_irq_t irq, uint32_t us);
+
+// Send the interrupts that ran since the last call and start a new window,
+// consumer task only
+void isr_profile_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ISR_PROFILE_H */
@@ -0,0 +1,120 @@
+/**
+  ******************************************************************************
+  * @file    kernel_trace.h
+  * @brief   Binary trace of the scheduler and the task handoffs, from the FreeRTOS trace hooks.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __KERNEL_TRACE_H
+#define __KERNEL_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+// Included from FreeRTOSConfig.h, nothing from the kernel here
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// 1: record context switches, queue and notification events in a RAM ring,
+// the "trace" command dumps it
+#ifndef KERNEL_TRACE
+#define KERNEL_TRACE 0
+#endif
+// Records kept, a power of two, 8 bytes each
+#ifndef KERNEL_TRACE_DEPTH
+#define KERNEL_TRACE_DEPTH 256
+#endif
+#if (KERNEL_TRACE_DEPTH & (KERNEL_TRACE_DEPTH - 1)) != 0
+#error "KERNEL_TRACE_DEPTH must be a power of two"
+#endif
+// Tasks named in a dump
+#ifndef KERNEL_TRACE_MAX_TASKS
+#define KERNEL_TRACE_MAX_TASKS 16
+#endif
+// ITM stimulus port of a dump over SWO
+#ifndef KERNEL_TRACE_ITM_PORT
+#define KERNEL_TRACE_ITM_PORT 1
+#endif
+// Entries per frame, a frame stays within 64 bytes
+#define KERNEL_TRACE_FRAME_ENTRIES 7
+// First byte of a trace frame
+#define KERNEL_TRACE_FRAME_TYPE 0xAF
+#define KERNEL_TRACE_FRAME_VERSION 1
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    KERNEL_TRACE_SWITCH_IN,          // The task starts to run
+    KERNEL_TRACE_SWITCH_OUT,         // The task stops running
+    KERNEL_TRACE_QUEUE_SEND,         // Queue, semaphore or mutex given, object is its address
+    KERNEL_TRACE_QUEUE_SEND_FROM_ISR,
+    KERNEL_TRACE_QUEUE_RECEIVE,      // Queue, semaphore or mutex taken
+    KERNEL_TRACE_NOTIFY,             // Notification sent, object is the task number it went to
+    KERNEL_TRACE_NOTIFY_FROM_ISR,
+    KERNEL_TRACE_NOTIFY_RECEIVE      // The task got its notification, object is the value, task_signal.h bits
+} kernel_trace_event_t;
+
+typedef enum {
+    KERNEL_TRACE_SINK_UART,  // Frames into the transmit queue, as it drains
+    KERNEL_TRACE_SINK_SWO    // The same frames as words on the ITM stimulus port, once a probe or SWO_TRACE enabled it
+} kernel_trace_sink_t;
+
+typedef enum {
+    KERNEL_TRACE_KIND_TASKS,    // tasks holds the names of the task numbers
+    KERNEL_TRACE_KIND_RECORDS,  // records holds events, oldest first over the frames of a dump
+    KERNEL_TRACE_KIND_END       // summary closes the dump
+} kernel_trace_kind_t;
+
+// One event, as sent in a records frame
+typedef struct {
+    uint32_t cycles;  // DWT cycle count of the event
+    uint8_t event;    // kernel_trace_event_t
+    uint8_t task;     // Number of the running task, uxTaskGetTaskNumber, an ISR counts for the task it preempted
+    uint16_t object;  // Task number, notified value or SRAM word offset ((address - 0x20000000) / 4) of the queue
+} kernel_trace_record_t;
+
+typedef struct {
+    uint8_t number;  // uxTaskGetTaskNumber
+    char name[7];    // Zero padded, cut to fit
+} kernel_trace_task_t;
+
+typedef struct {
+    uint32_t recorded;  // Events since the last dump
+    uint32_t lost;      // Of those, overwritten before this dump
+} kernel_trace_summary_t;
+
+// Trace frame as sent over the UART, little endian, no padding. A dump is the
+// task frames, the records frames and one end frame.
+typedef struct {
+    uint8_t type;     // KERNEL_TRACE_FRAME_TYPE
+    uint8_t version;  // KERNEL_TRACE_FRAME_VERSION
+    uint8_t kind;     // kernel_trace_kind_t
+    uint8_t count;    // Valid entries, 1 in an end frame
+    union {
+        kernel_trace_task_t tasks[KERNEL_TRACE_FRAME_ENTRIES];
+        kernel_trace_record_t records[KERNEL_TRACE_FRAME_ENTRIES];
+        kernel_trace_summary_t summary;
+    };
+} kernel_trace_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Create the dump task, before the scheduler starts
+void kernel_trace_start(void);
+
+// Stop recording and dump the ring to sink, then record again from an empty
+// ring. False when the sink is unknown or not enabled or a dump is running.
+bool kernel_trace_dump(uint32_t sink);
+
+// Trace hooks, see FreeRTOSConfig.h. They run inside the kernel with its
+// interrupts masked.
+void kernel_trace_switched_in(uint32_t task);
+void kernel_trace_event(uint32_t event, uint32_t object);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __KERNEL_TRACE_H */
@@ -0,0 +1,72 @@
+/**
+  ******************************************************************************
+  * @file    latency_trace.h
+  * @brief   Per-stage latency histograms of the acquisition to UART pipeline.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __LATENCY_TRACE_H
+#define __LATENCY_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include "main.h"
+
+/* Exported constants --------------------------------------------------------*/
+// Bucket i counts latencies in [2^i, 2^(i+1)) us, the last one is open ended
+#define LATENCY_BUCKETS 20
+// First byte of a latency report frame
+#define LATENCY_REPORT_FRAME_TYPE 0xA1
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    LATENCY_STAGE_ACQUIRE,    // Sampling tick to sample published in the ring
+    LATENCY_STAGE_QUEUE,      // Newest sample published to consumer start
+    LATENCY_STAGE_COMPUTE,    // Statistics update of one batch
+    LATENCY_STAGE_TRANSMIT,   // Frame queued to last byte sent on USART2
+    LATENCY_STAGE_END_TO_END, // Newest sample published to its frame sent
+    LATENCY_STAGE_COUNT
+} latency_stage_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t buckets[LATENCY_BUCKETS];
+} latency_histogram_t;
+
+// Report of one stage as sent over the UART, little endian, no padding
+typedef struct {
+    uint8_t type;     // LATENCY_REPORT_FRAME_TYPE
+    uint8_t stage;    // latency_stage_t
+    uint16_t reserved;
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint16_t buckets[LATENCY_BUCKETS]; // Saturated at 65535
+} latency_report_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Clear every histogram, the DWT cycle counter must already run
+void latency_trace_init(void);
+
+// Add the latency from start_cycles to now. Every stage has a single writer
+// (a task or the USART2 interrupt), so no locking is needed.
+void latency_trace_record(latency_stage_t stage, uint32_t start_cycles);
+
+// Snapshot of one stage histogram
+const latency_histogram_t *latency_trace_histogram(latency_stage_t stage);
+
+// Fill a report frame for one stage
+void latency_trace_report(latency_stage_t stage, latency_report_frame_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LATENCY_TRACE_H */
@@ -0,0 +1,62 @@
+/**
+  ******************************************************************************
+  * @file    link_backlog.h
+  * @brief   BLE link state and store-and-forward of the statistics.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __LINK_BACKLOG_H
+#define __LINK_BACKLOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "flash_log.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the connection output of the BLE module is wired to BLE_LINK_Pin, reports
+// made while it is low are kept and sent once the link is back
+#ifndef LINK_BACKLOG
+#define LINK_BACKLOG 0
+#endif
+// Reports kept in RAM, about 8 minutes at the default schedule. With
+// FLASH_LOG older ones are read back from the flash log, without it they are
+// dropped.
+#ifndef LINK_BACKLOG_DEPTH
+#define LINK_BACKLOG_DEPTH 16
+#endif
+// Interval at which the drain task samples the link state
+#ifndef LINK_BACKLOG_POLL_MS
+#define LINK_BACKLOG_POLL_MS 100
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Reset the backlog, before the scheduler starts
+void link_backlog_init(void);
+
+// Create the drain task
+void link_backlog_start(void);
+
+// True while the BLE module reports a connection
+bool link_backlog_link_up(void);
+
+// Keep a report made while the link is down, as a FLASH_LOG_RECORD_STATS
+// frame. sequence is the log sequence of the same report with FLASH_LOG,
+// it is ignored without. Consumer task only.
+void link_backlog_store(uint32_t sequence, uint32_t timestamp, const void *frame, uint16_t size);
+
+// Reports waiting in RAM, and reports lost because RAM was full and there
+// was no flash log to fall back on
+uint32_t link_backlog_pending(void);
+uint32_t link_backlog_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LINK_BACKLOG_H */
@@ -0,0 +1,61 @@
+/**
+  ******************************************************************************
+  * @file    link_route.h
+  * @brief   Routing of the bulk traffic between the BLE link and the wired bulk link.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __LINK_ROUTE_H
+#define __LINK_ROUTE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "uart_tx.h"
+
+/* Exported types ------------------------------------------------------------*/
+// Traffic that may leave the BLE link. The statistics, alerts and replies
+// always go on BLE through uart_tx_send.
+typedef enum {
+    LINK_TRAFFIC_DUMP = 0, // Window dumps, flash log replays, rollup dumps and queries
+    LINK_TRAFFIC_BACKLOG,  // Frames held by link_backlog, once the link is back
+    LINK_TRAFFIC_TRACE,    // Kernel trace records and the task names
+    LINK_TRAFFIC_PROFILE,  // PC samples and interrupt timings
+    LINK_TRAFFIC_COUNT
+} link_traffic_t;
+
+/* Exported constants --------------------------------------------------------*/
+// Bit n set: traffic n goes on the bulk link with BULK_LINK, all of it at boot.
+// The "route" command changes it at run time.
+#ifndef LINK_ROUTE_BULK_MASK
+#define LINK_ROUTE_BULK_MASK ((1U << LINK_TRAFFIC_COUNT) - 1U)
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Link a traffic goes on, always UART_LINK_BLE without BULK_LINK
+uart_link_t link_route(link_traffic_t traffic);
+
+// Send the traffic to bulk_mask on the bulk link and the rest on BLE, from the
+// next frame on. False when the mask names traffic that does not exist, or
+// any traffic without BULK_LINK.
+bool link_route_set(uint32_t bulk_mask);
+
+// Traffic on the bulk link, LINK_ROUTE_BULK_MASK until changed
+uint32_t link_route_mask(void);
+
+// uart_tx_send, uart_tx_flush and uart_tx_free on the link of a traffic. A
+// sender that waits for room calls them for the same traffic throughout.
+bool link_route_send(link_traffic_t traffic, const uint8_t *data, uint16_t size);
+void link_route_flush(link_traffic_t traffic);
+uint32_t link_route_free(link_traffic_t traffic);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LINK_ROUTE_H */
@@ -0,0 +1,109 @@
+/**
+  ******************************************************************************
+  * @file    load_shed.h
+  * @brief   Load shedding driven by the depth of the pipeline queues.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __LOAD_SHED_H
+#define __LOAD_SHED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sample_ring.h"
+#include "uart_tx.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the producer samples the depth of the rings and of the transmit queue
+// at every tick, and the consumer raises or lowers a shedding level from it
+// at every batch. Each level sheds more before the live statistics suffer,
+// and the alerts keep bursts of their own at every level.
+#ifndef LOAD_SHEDDING
+#define LOAD_SHEDDING 0
+#endif
+// Transmit bursts only the alerts may open, the live statistics leave them free
+#ifndef LOAD_SHED_ALERT_RESERVE
+#define LOAD_SHED_ALERT_RESERVE 1
+#endif
+#if LOAD_SHED_ALERT_RESERVE < 1 || LOAD_SHED_ALERT_RESERVE + 2 > UART_TX_QUEUE_LENGTH
+#error "LOAD_SHED_ALERT_RESERVE must leave a burst to the live frames and one to the backlog"
+#endif
+// Bursts waiting for the DMA at a tick that count as pressure, and below
+// which a batch counts as calm
+#ifndef LOAD_SHED_QUEUE_HIGH
+#define LOAD_SHED_QUEUE_HIGH (UART_TX_QUEUE_LENGTH - LOAD_SHED_ALERT_RESERVE)
+#endif
+#ifndef LOAD_SHED_QUEUE_LOW
+#define LOAD_SHED_QUEUE_LOW (UART_TX_QUEUE_LENGTH / 2)
+#endif
+// Fill of a ring seen by the statistics reader, in percent of
+// SAMPLE_RING_SIZE, above which the consumer is falling behind
+#ifndef LOAD_SHED_RING_HIGH_PCT
+#define LOAD_SHED_RING_HIGH_PCT 75
+#endif
+#ifndef LOAD_SHED_RING_LOW_PCT
+#define LOAD_SHED_RING_LOW_PCT 50
+#endif
+// Calm batches in a row before the level goes down one step
+#ifndef LOAD_SHED_RECOVER_BATCHES
+#define LOAD_SHED_RECOVER_BATCHES 4
+#endif
+// A channel marked shed_low_priority in sensor_registry is read once in
+// this many of its reads while the level is LOAD_SHED_LEVEL_DECIMATE
+#ifndef LOAD_SHED_DECIMATION
+#define LOAD_SHED_DECIMATION 4
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+// What is shed, each level also sheds what the ones below it do
+typedef enum {
+    LOAD_SHED_LEVEL_NONE,     // Everything goes out
+    LOAD_SHED_LEVEL_DETAIL,   // No frames beyond the statistics, the link backlog waits
+    LOAD_SHED_LEVEL_DECIMATE, // Low-priority channels are read LOAD_SHED_DECIMATION times slower
+    LOAD_SHED_LEVEL_COUNT
+} load_shed_level_t;
+
+// Classes of frames, in the order in which they lose the transmit queue
+typedef enum {
+    LOAD_SHED_CLASS_ALERT,   // Trigger alerts and events, any burst
+    LOAD_SHED_CLASS_LIVE,    // Statistics of the batch, all but the alert reserve
+    LOAD_SHED_CLASS_DETAIL,  // Views, correlation, resampled rows, only at LOAD_SHED_LEVEL_NONE
+    LOAD_SHED_CLASS_BACKLOG  // Reports made while the link was down, behind the live ones
+} load_shed_class_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Start at LOAD_SHED_LEVEL_NONE, watching the rings of every channel.
+// Before the producer runs.
+void load_shed_init(const sample_ring_t *rings);
+
+// Sample the queue depths, producer task at every tick
+void load_shed_observe(void);
+
+// Move the level from the depths seen since the last call and the frames
+// and samples dropped meanwhile. Up one step at a batch under pressure,
+// down one after LOAD_SHED_RECOVER_BATCHES calm ones. Consumer task only.
+void load_shed_update(void);
+
+// Current level, any task
+load_shed_level_t load_shed_level(void);
+
+// Whether a frame of the class may be queued now, any task
+bool load_shed_admit(load_shed_class_t frame_class);
+
+// Low-priority channels the producer must not read at this tick
+uint32_t load_shed_mask(uint32_t tick);
+
+// Batches spent at each level since boot
+uint32_t load_shed_batches(load_shed_level_t level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LOAD_SHED_H */
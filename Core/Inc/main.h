@@ -41,12 +41,41 @@ extern "C" {
 
 /* Exported constants --------------------------------------------------------*/
 /* USER CODE BEGIN EC */
-
+// System clock profiles, selected at build time with CLOCK_PROFILE
+#define CLOCK_PROFILE_PERFORMANCE 0 // 168 MHz from the PLL, 5 flash wait states
+#define CLOCK_PROFILE_LOW_POWER   1 // 24 MHz, voltage scale 2, no wait state
+#ifndef CLOCK_PROFILE
+#define CLOCK_PROFILE CLOCK_PROFILE_PERFORMANCE
+#endif
+// 1: the sample reads and the transmit bursts are started and completed with
+// LL register accesses instead of the HAL calls and IRQ handlers. The HAL
+// still initializes the peripherals and DMA streams.
+#ifndef LL_FAST_PATH
+#define LL_FAST_PATH 0
+#endif
+// 1: the crystal is turned on first thing in the reset handler and the large
+// buffers marked CCMRAM_NOINIT are neither copied nor cleared at boot
+#ifndef FAST_START
+#define FAST_START 0
+#endif
 /* USER CODE END EC */
 
 /* Exported macro ------------------------------------------------------------*/
 /* USER CODE BEGIN EM */
-
+// Place CPU-only data in the 64 KB zero-wait-state core coupled RAM.
+// CCM is not reachable by the DMA controllers, DMA buffers must stay in SRAM.
+#define CCMRAM __attribute__((section(".ccmram")))
+// Place data that must keep its content over a reset, in SRAM. It holds
+// garbage after power on, the owner validates it before use.
+#define NOINIT __attribute__((section(".noinit")))
+// Place a large CPU-only buffer in CCM that is fully written before it is
+// read: task stacks, the heap, the sample rings. With FAST_START it holds
+// garbage at boot instead of zeros.
+#if FAST_START
+#define CCMRAM_NOINIT __attribute__((section(".ccmnoinit")))
+#else
+#define CCMRAM_NOINIT CCMRAM
+#endif
 /* USER CODE END EM */
 
 /* Exported functions prototypes ---------------------------------------------*/
@@ -59,7 +88,27 @@ void Error_Handler(void);
 /* Private defines -----------------------------------------------------------*/
 
 /* USER CODE BEGIN Private defines */
-
+// PIR motion output, captured on both edges when PIR_EVENT_CAPTURE is set
+#define PIR_OUT_Pin GPIO_PIN_1
+#define PIR_OUT_GPIO_Port GPIOA
+#define PIR_OUT_EXTI_IRQn EXTI1_IRQn
+// Connection output of the BLE module, high while connected, read when LINK_BACKLOG is set
+#define BLE_LINK_Pin GPIO_PIN_4
+#define BLE_LINK_GPIO_Port GPIOA
+// Data-ready output of the FIFO sensors, rising at the watermark, used when SENSOR_FIFO is set
+#define SENSOR_FIFO_READY_Pin GPIO_PIN_0
+#define SENSOR_FIFO_READY_GPIO_Port GPIOB
+#define SENSOR_FIFO_READY_EXTI_IRQn EXTI0_IRQn
+// Data-ready outputs of the sensors with a drdy_line, PE5 to PE9 rising on a new result, used when SENSOR_DRDY is set
+#define SENSOR_DRDY_GPIO_Port GPIOE
+#define SENSOR_DRDY_EXTI_IRQn EXTI9_5_IRQn
+// Enable of the switch feeding the sensors and the bus pull-ups, high is on, driven when SENSOR_POWER_GATING is set
+#define SENSOR_POWER_Pin GPIO_PIN_7
+#define SENSOR_POWER_GPIO_Port GPIOE
+// Stage markers of ENERGY_PROFILE, PD12 acquire, PD13 compute, PD14 transmit and PD15 sleep, high while it runs
+#define ENERGY_MARKER_GPIO_Port GPIOD
+#define ENERGY_MARKER_PIN(stage) ((uint16_t)(GPIO_PIN_12 << (stage)))
+#define ENERGY_MARKER_PINS (GPIO_PIN_12 | GPIO_PIN_13 | GPIO_PIN_14 | GPIO_PIN_15)
 /* USER CODE END Private defines */
 
 #ifdef __cplusplus
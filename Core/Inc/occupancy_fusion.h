@@ -0,0 +1,90 @@
+/**
+  ******************************************************************************
+  * @file    occupancy_fusion.h
+  * @brief   Per-sample occupancy estimate from the PIR and LDR channels.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __OCCUPANCY_FUSION_H
+#define __OCCUPANCY_FUSION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_data.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: every PIR and LDR read updates an occupancy filter in the producer. The
+// reports carry its state in one byte instead of the PIR statistics, and a
+// change of state sends a report at once.
+#ifndef SENSOR_OCCUPANCY
+#define SENSOR_OCCUPANCY 0
+#endif
+// Occupancy byte: the state in the top bit, below it the probability of that
+// state in 1/127 steps
+#define OCCUPANCY_OCCUPIED 0x80U
+#define OCCUPANCY_CONFIDENCE_MASK 0x7FU
+// A PIR read above it saw motion, the samples are 0 or 1
+#ifndef OCCUPANCY_PIR_ABOVE
+#define OCCUPANCY_PIR_ABOVE 0.5f
+#endif
+// Log-odds of occupied added by a PIR read with motion
+#ifndef OCCUPANCY_PIR_EVIDENCE
+#define OCCUPANCY_PIR_EVIDENCE 3.0f
+#endif
+// Log-odds added by a light switched on or off
+#ifndef OCCUPANCY_LIGHT_EVIDENCE
+#define OCCUPANCY_LIGHT_EVIDENCE 2.0f
+#endif
+// Log-odds lost per second without motion, an occupant who sits still is
+// less and less likely to still be there. From the top to the vacant
+// threshold in about 6 minutes.
+#ifndef OCCUPANCY_DECAY_PER_S
+#define OCCUPANCY_DECAY_PER_S 0.02f
+#endif
+// Bounds of the log-odds, so either state turns within a bounded time
+#ifndef OCCUPANCY_LOG_ODDS_MAX
+#define OCCUPANCY_LOG_ODDS_MAX 6.0f
+#endif
+// Hysteresis of the state: occupied above the threshold, vacant below minus it
+#ifndef OCCUPANCY_THRESHOLD
+#define OCCUPANCY_THRESHOLD 1.0f
+#endif
+// LDR step: a read that leaves the light baseline by this share of it, and
+// by more than the deadband of the channel, is a light switched
+#ifndef OCCUPANCY_LDR_STEP
+#define OCCUPANCY_LDR_STEP 0.3f
+#endif
+// Weight of a read in the light baseline, slow enough that daylight drifts in
+#ifndef OCCUPANCY_LDR_ALPHA
+#define OCCUPANCY_LDR_ALPHA 0.05f
+#endif
+// Change of confidence that makes a delta report of its own, in byte units
+#ifndef OCCUPANCY_CONFIDENCE_DEADBAND
+#define OCCUPANCY_CONFIDENCE_DEADBAND 13U
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Start from an unknown occupancy and no light baseline, before sampling starts
+void occupancy_fusion_init(void);
+
+// Update the filter with one read of its channel, other channels are
+// ignored. True when the state changed. O(1), producer task only.
+bool occupancy_fusion_sample(sensor_t channel, float value, uint32_t timestamp);
+
+// Occupancy byte after the latest read, any task
+uint8_t occupancy_fusion_byte(void);
+
+// Sample time of the latest change of state, any task
+uint32_t occupancy_fusion_changed_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __OCCUPANCY_FUSION_H */
@@ -0,0 +1,81 @@
+/**
+  ******************************************************************************
+  * @file    outlier_filter.h
+  * @brief   Hampel filter that drops single bad reads before they are stored.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __OUTLIER_FILTER_H
+#define __OUTLIER_FILTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_stats.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: reads far from the median of the last reads of their sensor are dropped
+#ifndef OUTLIER_FILTER
+#define OUTLIER_FILTER 0
+#endif
+// Reads the median and MAD are taken over, odd so the median is one of them
+#ifndef OUTLIER_FILTER_WINDOW
+#define OUTLIER_FILTER_WINDOW 9
+#endif
+// Rejection threshold in standard deviations, estimated as 1.4826 x MAD
+#ifndef OUTLIER_FILTER_SIGMA
+#define OUTLIER_FILTER_SIGMA 3.0f
+#endif
+// Smallest deviation from the median that is rejected, in sensor units, for
+// the current sensors, see sensor_registry. Keeps a flat signal, whose MAD is
+// 0, from losing its small steps. 0 passes every read of the sensor.
+#ifndef OUTLIER_FLOOR_PIR
+#define OUTLIER_FLOOR_PIR 0.0f
+#endif
+#ifndef OUTLIER_FLOOR_HUMIDITY_AND_HEAT
+#define OUTLIER_FLOOR_HUMIDITY_AND_HEAT 32.0f
+#endif
+#ifndef OUTLIER_FLOOR_LDR
+#define OUTLIER_FLOOR_LDR 64.0f
+#endif
+#ifndef OUTLIER_FLOOR_HEAT
+#define OUTLIER_FLOOR_HEAT 32.0f
+#endif
+#ifndef OUTLIER_FLOOR_LDR_LUX
+#define OUTLIER_FLOOR_LDR_LUX 20.0f
+#endif
+
+#if OUTLIER_FILTER_WINDOW < 3 || OUTLIER_FILTER_WINDOW > STATS_WINDOW_CAPACITY
+#error "OUTLIER_FILTER_WINDOW must be 3 to STATS_WINDOW_CAPACITY"
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    median_window_t window; // The last OUTLIER_FILTER_WINDOW reads, rejected ones included
+#if STATS_ARENA
+    uint32_t storage[MEDIAN_WINDOW_STORAGE_BYTES(OUTLIER_FILTER_WINDOW) / 4U]; // Arrays of window
+#endif
+    float floor;            // Smallest deviation rejected, 0 passes every read
+    uint32_t rejected;      // Reads dropped since outlier_filter_init
+} outlier_filter_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Clear the history, floor as in sensor_driver_t.outlier_floor
+void outlier_filter_init(outlier_filter_t *filter, float floor);
+
+// Add one read and tell whether it is kept. A read is dropped when it is
+// further than OUTLIER_FILTER_SIGMA x 1.4826 x MAD, and than floor, from the
+// median of the window. The reads of the first window are all kept. Rejected
+// reads stay in the window, so a real step is followed after half a window.
+bool outlier_filter_accept(outlier_filter_t *filter, float value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __OUTLIER_FILTER_H */
@@ -0,0 +1,127 @@
+/**
+  ******************************************************************************
+  * @file    pc_profile.h
+  * @brief   Statistical profiler, a histogram of the interrupted PC taken from a TIM7 interrupt.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __PC_PROFILE_H
+#define __PC_PROFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// 1: TIM7 interrupts the core PC_PROFILE_HZ times a second and counts the PC it
+// interrupted, the "profile" command dumps the counts, see Host/tools/pc_profile_report.py
+#ifndef PC_PROFILE
+#define PC_PROFILE 0
+#endif
+// Sampling rate, a few hundred cycles a sample at 168 MHz
+#ifndef PC_PROFILE_HZ
+#define PC_PROFILE_HZ 2000
+#endif
+#if PC_PROFILE && (PC_PROFILE_HZ < 16 || PC_PROFILE_HZ > 100000)
+#error "PC_PROFILE_HZ must be between 16 and 100000"
+#endif
+// Distinct PCs counted, a power of two, 8 bytes each in CCM
+#ifndef PC_PROFILE_SLOTS
+#define PC_PROFILE_SLOTS 512
+#endif
+#if (PC_PROFILE_SLOTS & (PC_PROFILE_SLOTS - 1)) != 0
+#error "PC_PROFILE_SLOTS must be a power of two"
+#endif
+// Slots tried for a PC before its sample is dropped
+#ifndef PC_PROFILE_PROBES
+#define PC_PROFILE_PROBES 8
+#endif
+// Tasks counted by name, the later ones count as PC_PROFILE_TASK_OTHER
+#ifndef PC_PROFILE_MAX_TASKS
+#define PC_PROFILE_MAX_TASKS 12
+#endif
+// Task index of a sample taken inside an interrupt handler
+#define PC_PROFILE_TASK_ISR PC_PROFILE_MAX_TASKS
+// Task index of a sample of a task beyond PC_PROFILE_MAX_TASKS
+#define PC_PROFILE_TASK_OTHER (PC_PROFILE_MAX_TASKS + 1)
+// First byte of a profile frame
+#define PC_PROFILE_FRAME_TYPE 0xB7
+#define PC_PROFILE_FRAME_VERSION 1
+// Entries per frame, a frame stays within 64 bytes
+#define PC_PROFILE_FRAME_TASKS 4
+#define PC_PROFILE_FRAME_PCS 7
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    PC_PROFILE_KIND_TASKS, // tasks holds the samples of each task, interrupts and others last
+    PC_PROFILE_KIND_PCS,   // pcs holds the counted PCs, in no order
+    PC_PROFILE_KIND_END    // summary closes the dump
+} pc_profile_kind_t;
+
+typedef struct {
+    uint8_t index;   // Task index, PC_PROFILE_TASK_ISR and PC_PROFILE_TASK_OTHER included
+    char name[7];    // Zero padded, cut to fit, "ISR" and "other" for the last two
+    uint32_t samples;
+} pc_profile_task_t;
+
+typedef struct {
+    uint32_t pc;     // Address of the next instruction of the interrupted code
+    uint32_t count;
+} pc_profile_pc_t;
+
+typedef struct {
+    uint32_t samples;  // Taken since the last clear
+    uint32_t dropped;  // Of those, not counted by PC, no free slot within PC_PROFILE_PROBES
+    uint32_t rate_hz;  // PC_PROFILE_HZ
+} pc_profile_summary_t;
+
+// Profile frame, little endian, no padding. A dump is the task frames, the
+// PC frames and one end frame.
+typedef struct {
+    uint8_t type;     // PC_PROFILE_FRAME_TYPE
+    uint8_t version;  // PC_PROFILE_FRAME_VERSION
+    uint8_t kind;     // pc_profile_kind_t
+    uint8_t count;    // Valid entries, 1 in an end frame
+    union {
+        pc_profile_task_t tasks[PC_PROFILE_FRAME_TASKS];
+        pc_profile_pc_t pcs[PC_PROFILE_FRAME_PCS];
+        pc_profile_summary_t summary;
+    };
+} pc_profile_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Create the dump task and start TIM7, before the scheduler starts
+void pc_profile_start(void);
+
+// Stop counting and dump the histogram, then count again, from zero when
+// clear is set. False while a dump runs.
+bool pc_profile_dump(bool clear);
+
+// Count one sample, from the TIM7 handler only. frame is the exception frame
+// of the interrupted code. Above the kernel mask: it never calls FreeRTOS
+// beyond reading the current task handle. Marked used so the branch of the
+// naked handler below still finds it under LTO.
+void pc_profile_sample(const uint32_t *frame) __attribute__((used));
+
+// Body of the TIM7 handler, hands the stack of the interrupted code to
+// pc_profile_sample, for stm32f4xx_it.c
+#define PC_PROFILE_HANDLER(name)                   \
+    __attribute__((naked)) void name(void)         \
+    {                                              \
+        __asm volatile("tst lr, #4\n"              \
+                       "ite eq\n"                  \
+                       "mrseq r0, msp\n"           \
+                       "mrsne r0, psp\n"           \
+                       "b pc_profile_sample\n");   \
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PC_PROFILE_H */
@@ -0,0 +1,52 @@
+/**
+  ******************************************************************************
+  * @file    pipeline_config.h
+  * @brief   Runtime settings of the sampling and statistics pipeline.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __PIPELINE_CONFIG_H
+#define __PIPELINE_CONFIG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include "main.h"
+
+/* Exported types ------------------------------------------------------------*/
+// Every field is a single word: readers take a consistent value without a lock
+typedef struct {
+    volatile uint32_t window_size;       // Samples in the statistics window of each channel
+    volatile uint32_t samples_per_batch; // Sampling ticks between two reports
+    volatile uint32_t sample_period_ms;  // TIM3 sampling tick, see sensor_driver_t.sample_divider
+    volatile uint32_t channel_mask;      // Bit n set: channel n (sensor_t) is reported
+} pipeline_config_t;
+
+/* Exported variables --------------------------------------------------------*/
+// Written only through the setters below, read directly by the pipeline tasks
+extern pipeline_config_t pipeline_config;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Start from the compile-time defaults, before the sampling timer starts
+void pipeline_config_init(uint32_t window_size, uint32_t samples_per_batch, uint32_t sample_period_ms);
+
+// Setters return false and change nothing when the value does not fit the
+// storage sized at compile time: the window and two batches must fit in a
+// channel ring and the window, with the one sample it holds more while it
+// slides, in STATS_WINDOW_CAPACITY_SLOTS, with STATS_ARENA the windows and
+// views of every channel in the arena as well. Single writer, the command
+// channel.
+bool pipeline_config_set_window_size(uint32_t window_size);
+bool pipeline_config_set_samples_per_batch(uint32_t samples_per_batch);
+bool pipeline_config_set_sample_period(uint32_t sample_period_ms);
+bool pipeline_config_set_channel_mask(uint32_t channel_mask);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PIPELINE_CONFIG_H */
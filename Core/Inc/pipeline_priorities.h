@@ -0,0 +1,81 @@
+/**
+  ******************************************************************************
+  * @file    pipeline_priorities.h
+  * @brief   Task and interrupt priorities of the pipeline stages.
+  *
+  *          The pipeline runs in stages, each one above the work it feeds:
+  *
+  *          supervise The watchdog task, a few microseconds every
+  *                    WATCHDOG_KICK_MS. It has to run while any stage hangs.
+  *          acquire   TIM3 tick interrupt, then producer_task reads, filters
+  *                    and stores the due sensors. Top of the pipeline, it blocks
+  *                    on the tick and on the I2C DMA and runs for a few
+  *                    hundred microseconds per tick.
+  *          control   Command channel, timer service and clock governor
+  *                    tasks, short jobs: a setting or a clock level applies
+  *                    before the next batch is built and a burst deadline is
+  *                    kept during the statistics.
+  *          process   consumer_task computes the statistics of a batch and
+  *                    serializes the frames into the transmit queue.
+  *          transmit  The USART2 DMA chain sends the bursts from its
+  *                    interrupts, the flash log, link backlog and reliable
+  *                    link tasks send old frames with what the queue leaves.
+  *
+  *          A long statistics run or a slow link only delays the stages
+  *          below acquisition. Nothing above the producer waits on the
+  *          UART: the queue drops a frame rather than block its sender.
+  *          Priority 6 is free.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __PIPELINE_PRIORITIES_H
+#define __PIPELINE_PRIORITIES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "FreeRTOS.h"
+
+/* Exported constants --------------------------------------------------------*/
+// Task priorities, higher runs first, idle is 0
+#define TASK_PRIORITY_SUPERVISE 5
+#define TASK_PRIORITY_ACQUIRE 4
+#define TASK_PRIORITY_CONTROL 3
+#define TASK_PRIORITY_PROCESS 2
+#define TASK_PRIORITY_TRANSMIT 1
+
+// NVIC priorities, lower preempts, all of them but the profiler call FreeRTOS
+// from the ISR and stay at or below configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY.
+// Interrupts that share state share a level, so they never preempt each other.
+// TIM3 sampling tick, the PIR edge clock (TIM5, EXTI) and the TIM2 wrap count:
+// they only take a timestamp and wake a task
+#define IRQ_PRIORITY_TIMER (configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY)
+// I2C1 events and errors, I2C1_RX DMA, ADC1 DMA
+#define IRQ_PRIORITY_ACQUIRE (configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY + 1)
+// USART2 and its DMA streams, the command channel and the transmit chain
+#define IRQ_PRIORITY_LINK (configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY + 2)
+// TIM7 sampling profiler, above the kernel mask so it samples the critical
+// sections and the other handlers too. It calls no FreeRTOS function.
+#define IRQ_PRIORITY_PROFILE (configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY - 1)
+// ISR_PIPELINE deferred work, the acquisition and statistics of the ticks,
+// preempted by every other interrupt
+#define IRQ_PRIORITY_DEFERRED (configLIBRARY_LOWEST_INTERRUPT_PRIORITY)
+
+#if TASK_PRIORITY_SUPERVISE >= configMAX_PRIORITIES
+#error "TASK_PRIORITY_SUPERVISE above configMAX_PRIORITIES"
+#endif
+#if configTIMER_TASK_PRIORITY != TASK_PRIORITY_CONTROL
+#error "configTIMER_TASK_PRIORITY must be TASK_PRIORITY_CONTROL"
+#endif
+#if IRQ_PRIORITY_LINK >= configLIBRARY_LOWEST_INTERRUPT_PRIORITY
+#error "IRQ_PRIORITY_LINK must stay above the kernel interrupts"
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PIPELINE_PRIORITIES_H */
@@ -0,0 +1,77 @@
+/**
+  ******************************************************************************
+  * @file    pir_event.h
+  * @brief   Interrupt-driven capture of the PIR motion output.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __PIR_EVENT_H
+#define __PIR_EVENT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the PIR output is wired to PIR_OUT_Pin and captured on EXTI, the PIR
+// channel is no longer read over I2C
+#ifndef PIR_EVENT_CAPTURE
+#define PIR_EVENT_CAPTURE 0
+#endif
+// First byte of an edge frame
+#define PIR_EVENT_FRAME_TYPE 0xA5
+#define PIR_EVENT_FRAME_VERSION 1
+// Edges kept between two reports, must be a power of two
+#ifndef PIR_EVENT_RING_SIZE
+#define PIR_EVENT_RING_SIZE 64
+#endif
+// Edges per frame, 4 + 8 per edge fits the default UART_TX_FRAME_MAX
+#define PIR_EVENT_FRAME_EDGES 7
+
+/* Exported types ------------------------------------------------------------*/
+// One edge on the sample timeline: timestamp_ms is the time base of the
+// sample timestamps, timestamp_us the microseconds within that millisecond
+typedef struct {
+    uint32_t timestamp_ms;
+    uint16_t timestamp_us;
+    uint8_t level;         // 1: rising edge, motion started
+    uint8_t reserved;
+} pir_edge_t;
+
+// Edge frame as sent over the UART, little endian, no padding before edges[]
+typedef struct {
+    uint8_t type;    // PIR_EVENT_FRAME_TYPE
+    uint8_t version; // PIR_EVENT_FRAME_VERSION
+    uint8_t count;   // Edges that follow, oldest first
+    uint8_t dropped; // Edges lost to a full ring since the last frame, saturated
+    pir_edge_t edges[PIR_EVENT_FRAME_EDGES];
+} pir_event_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Reset the edge ring, before TIM5 and the EXTI line are enabled
+void pir_event_init(void);
+
+// Called from HAL_GPIO_EXTI_Callback for PIR_OUT_Pin, stamps the edge with TIM5
+void pir_event_edge_from_isr(void);
+
+// Called from the TIM5 update interrupt, extends the microsecond clock past 32 bits
+void pir_event_timer_overflow_from_isr(void);
+
+// Move up to PIR_EVENT_FRAME_EDGES edges into a frame. Returns the number
+// of bytes to send, 0 when there is no edge and nothing was dropped.
+// Single reader, the consumer task.
+uint16_t pir_event_build(pir_event_frame_t *frame);
+
+// Sample of the PIR channel: 1 when motion was seen since the previous call
+// or the output is still high, 0 otherwise. No bus transaction.
+float pir_event_sample(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PIR_EVENT_H */
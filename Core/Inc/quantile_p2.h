@@ -0,0 +1,47 @@
+/**
+  ******************************************************************************
+  * @file    quantile_p2.h
+  * @brief   Constant-memory streaming quantile estimate (P-square algorithm).
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __QUANTILE_P2_H
+#define __QUANTILE_P2_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define QUANTILE_P2_MARKERS 5
+
+/* Exported types ------------------------------------------------------------*/
+// Five markers track the minimum, p/2, p, (1+p)/2 and the maximum of the
+// samples seen. Until five samples arrived they are the sorted samples.
+typedef struct {
+    float p;
+    uint32_t count;
+    float height[QUANTILE_P2_MARKERS];
+    int32_t position[QUANTILE_P2_MARKERS];  // 1-based ranks of the markers
+    float desired[QUANTILE_P2_MARKERS];     // Ideal ranks for the count so far
+} quantile_p2_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Start an estimate of the p-quantile, 0 < p < 1, over the samples added from now on
+void quantile_p2_init(quantile_p2_t *estimator, float p);
+
+// Add one sample, O(1) time
+void quantile_p2_add(quantile_p2_t *estimator, float value);
+
+// Current estimate, exact (nearest rank) up to five samples, 0 without samples
+float quantile_p2_value(const quantile_p2_t *estimator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __QUANTILE_P2_H */
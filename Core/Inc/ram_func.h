@@ -0,0 +1,39 @@
+/**
+  ******************************************************************************
+  * @file    ram_func.h
+  * @brief   Placement of hot functions in SRAM, copied there by the startup.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __RAM_FUNC_H
+#define __RAM_FUNC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the functions marked RAMFUNC run from SRAM, with no flash wait state and
+// no ART cache miss. They go to .RamFunc, which the linker script places with
+// .data, so the startup copies them with the initialized data. CCM is on the
+// D-bus only and cannot hold code. No HAL or kernel header here, the host
+// build compiles the statistics kernels too.
+#ifndef RAM_FUNCTIONS
+#define RAM_FUNCTIONS 0
+#endif
+
+/* Exported macro ------------------------------------------------------------*/
+// Place a function in SRAM. Calls between flash and SRAM are out of reach of
+// a BL and go through a veneer the linker adds, see Host/tools/ramfunc_report.py.
+#if RAM_FUNCTIONS
+#define RAMFUNC __attribute__((section(".RamFunc")))
+#else
+#define RAMFUNC
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RAM_FUNC_H */
@@ -0,0 +1,77 @@
+/**
+  ******************************************************************************
+  * @file    reliable_link.h
+  * @brief   Sliding-window retransmission of the statistics frames.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __RELIABLE_LINK_H
+#define __RELIABLE_LINK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "uart_tx.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: statistics frames are kept until the receiver acknowledges their
+// sequence with "ack" lines on USART2 and sent again when they are not
+#ifndef RELIABLE_LINK
+#define RELIABLE_LINK 0
+#endif
+// Frames in flight. When the window is full the oldest frame is given up
+// rather than making the consumer wait.
+#ifndef RELIABLE_LINK_WINDOW
+#define RELIABLE_LINK_WINDOW 16
+#endif
+// Time after which an unacknowledged frame is sent again
+#ifndef RELIABLE_LINK_RTO_MS
+#define RELIABLE_LINK_RTO_MS 400
+#endif
+// Sends of one frame before it is given up, the first one included
+#ifndef RELIABLE_LINK_ATTEMPTS
+#define RELIABLE_LINK_ATTEMPTS 4
+#endif
+// Frames before the newest one an "ack" line can report, covers the window
+#define RELIABLE_LINK_ACK_BITS 32
+#if RELIABLE_LINK_WINDOW > RELIABLE_LINK_ACK_BITS
+#error "RELIABLE_LINK_WINDOW must not exceed RELIABLE_LINK_ACK_BITS"
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Empty the window, before the scheduler starts
+void reliable_link_init(void);
+
+// Create the retransmission task
+void reliable_link_start(void);
+
+// Slot to build the next frame in, word aligned, UART_TX_FRAME_MAX bytes.
+// The frame must carry its 16-bit sequence at byte 2, as stats_frame_t and
+// stats_delta_frame_t do. Gives up the oldest frame when the window is full.
+// Consumer task only, reliable_link_commit follows.
+uint8_t *reliable_link_reserve(void);
+
+// Send the frame built in the slot and keep it until acknowledged, size 0
+// releases the slot unsent. origin_cycles feeds the end-to-end latency.
+void reliable_link_commit(uint16_t size, uint32_t origin_cycles);
+
+// Receiver report: sequence newest arrived, and so did newest - 1 - n for
+// every bit n set in received. A receiver without losses sends all ones,
+// which acknowledges everything up to newest. Frames sent before newest was
+// and still missing are sent again at once. Task context.
+void reliable_link_ack(uint16_t newest, uint32_t received);
+
+// Sends after the first, and frames given up without an acknowledgement
+uint32_t reliable_link_retransmits(void);
+uint32_t reliable_link_lost(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RELIABLE_LINK_H */
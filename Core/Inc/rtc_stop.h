@@ -0,0 +1,71 @@
+/**
+  ******************************************************************************
+  * @file    rtc_stop.h
+  * @brief   RTC wakeup timer sampling with STOP mode in between, calendar timestamps.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __RTC_STOP_H
+#define __RTC_STOP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the RTC wakeup timer replaces TIM3 as the sampling tick, in whole seconds,
+// the core waits in STOP mode between the ticks and the samples carry the
+// calendar time. Needs TICKLESS_IDLE.
+#ifndef RTC_STOP_SAMPLING
+#define RTC_STOP_SAMPLING 0
+#endif
+// Sampling period at boot, the "period" command takes multiples of 1000 ms
+#ifndef RTC_STOP_PERIOD_S
+#define RTC_STOP_PERIOD_S 60
+#endif
+// Longest period, 16 bits of wakeup count on the 1 Hz calendar clock
+#define RTC_STOP_PERIOD_MAX_S 65536U
+// 1: the RTC runs on the 32.768 kHz LSE crystal, 0: on the 32 kHz LSI, which
+// needs no crystal but drifts by several percent
+#ifndef RTC_STOP_LSE
+#define RTC_STOP_LSE 1
+#endif
+#if RTC_STOP_SAMPLING && !(defined(TICKLESS_IDLE) && TICKLESS_IDLE)
+#error "RTC_STOP_SAMPLING needs TICKLESS_IDLE, the idle task enters STOP in place of the tickless sleep"
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Start the RTC clock and, when the backup domain lost it, the calendar at
+// 2000-01-01. A calendar that kept running through the reset keeps its time.
+// Before sample_timer_init.
+void rtc_stop_init(void);
+
+// Start the wakeup timer at the period of the last rtc_stop_set_period, the
+// first tick comes one period later
+void rtc_stop_start(void);
+
+// Reprogram the wakeup timer, period_ms a multiple of 1000. The count restarts
+// now, the next tick comes one new period later. Task context only.
+void rtc_stop_set_period(uint32_t period_ms);
+
+// Calendar time in milliseconds since 2000-01-01, wrapping like every sample
+// time, any context
+uint32_t rtc_stop_now_ms(void);
+
+// Set the calendar to epoch_s seconds since 1970, 2000 to 2099. The sample
+// times step by the change. False out of range, task context only.
+bool rtc_stop_set_calendar(uint32_t epoch_s);
+
+// RTC wakeup interrupt, one sampling tick stamped with its calendar second
+void rtc_stop_wakeup_from_isr(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RTC_STOP_H */
@@ -0,0 +1,45 @@
+/**
+  ******************************************************************************
+  * @file    sample_codec.h
+  * @brief   Bit-packed delta coding of the sample codes in the flash log.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SAMPLE_CODEC_H
+#define __SAMPLE_CODEC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// Longest encoding of one code, prefix and zig-zag delta
+#define SAMPLE_CODEC_BITS_MAX 20U
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Each code is coded as its difference to the one before it, modulo 2^16,
+// the first one to 0. The zig-zag of the difference follows a prefix that
+// gives its width, most significant bit first:
+//   0                   no change
+//   10   + 4 bits       up to +-8
+//   110  + 8 bits       up to +-128
+//   1110 + 12 bits      up to +-2048
+//   1111 + 16 bits      anything else
+// The stream is padded with 0 bits to a byte. Encodes as many codes as fit
+// in capacity bytes, returns how many and the bytes used in *size.
+uint32_t sample_codec_encode(const int16_t *codes, uint32_t count, uint8_t *data, uint32_t capacity,
+                             uint32_t *size);
+
+// Decode count codes from size bytes, returns how many were decoded, fewer
+// when the data ends first
+uint32_t sample_codec_decode(const uint8_t *data, uint32_t size, int16_t *codes, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SAMPLE_CODEC_H */
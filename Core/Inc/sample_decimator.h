@@ -0,0 +1,75 @@
+/**
+  ******************************************************************************
+  * @file    sample_decimator.h
+  * @brief   Oversampling FIR decimation stage between acquisition and the rings.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SAMPLE_DECIMATOR_H
+#define __SAMPLE_DECIMATOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_stats.h"
+#if STATS_USE_CMSIS_DSP
+#include "arm_math.h"
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+// 1: read the sensors with an oversample factor that many times per stored
+// sample and low-pass filter the reads down to the stored rate
+#ifndef SENSOR_DECIMATION
+#define SENSOR_DECIMATION 0
+#endif
+// Largest decimation factor of a channel
+#define SAMPLE_DECIMATOR_FACTOR_MAX 8
+// Filter taps per polyphase branch, the filter has this many times the factor
+#ifndef SAMPLE_DECIMATOR_TAPS_PER_PHASE
+#define SAMPLE_DECIMATOR_TAPS_PER_PHASE 4
+#endif
+#define SAMPLE_DECIMATOR_TAPS_MAX (SAMPLE_DECIMATOR_TAPS_PER_PHASE * SAMPLE_DECIMATOR_FACTOR_MAX)
+// Oversample factor of a registry row, 1 without SENSOR_DECIMATION
+#define SAMPLE_DECIMATOR_FACTOR(factor) (SENSOR_DECIMATION ? (factor) : 1)
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    uint32_t factor;
+    uint32_t taps;
+    uint32_t phase;       // Reads since the last output
+    bool primed;          // History holds real reads, not zeros
+    float coeffs[SAMPLE_DECIMATOR_TAPS_MAX];
+#if STATS_USE_CMSIS_DSP
+    arm_fir_decimate_instance_f32 instance;
+    float state[SAMPLE_DECIMATOR_TAPS_MAX + SAMPLE_DECIMATOR_FACTOR_MAX - 1];
+    float block[SAMPLE_DECIMATOR_FACTOR_MAX];
+#else
+    // Each read is stored twice, taps apart, so the newest taps reads are
+    // always contiguous behind head
+    float history[2 * SAMPLE_DECIMATOR_TAPS_MAX];
+    uint32_t head;
+#endif
+} sample_decimator_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Design a Hamming-windowed sinc low pass with its cutoff at the output
+// Nyquist frequency and unity DC gain, and clear the history. factor 1
+// passes every read through unchanged.
+void sample_decimator_init(sample_decimator_t *decimator, uint32_t factor);
+
+// Add one read. Every factor-th call the filtered value is written to out and
+// true returned, the filter only runs then. The first read fills the history
+// so the output starts at the signal level instead of ramping up from 0. The
+// output lags the newest read by (taps - 1) / 2 reads.
+bool sample_decimator_push(sample_decimator_t *decimator, float value, float *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SAMPLE_DECIMATOR_H */
@@ -0,0 +1,96 @@
+/**
+  ******************************************************************************
+  * @file    sample_mailbox.h
+  * @brief   Triple-buffered mailbox of the newest sample of every channel.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SAMPLE_MAILBOX_H
+#define __SAMPLE_MAILBOX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_data.h"
+#include "wire_format.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the producer publishes the newest sample of every channel at the end of
+// each tick, each reader takes the newest complete row without waiting, and a
+// "latest" command answers with it at once
+#ifndef SAMPLE_MAILBOX
+#define SAMPLE_MAILBOX 0
+#endif
+// First byte of the answer to a "latest" command
+#define SAMPLE_MAILBOX_FRAME_TYPE 0xC0
+#define SAMPLE_MAILBOX_FRAME_VERSION 1
+
+/* Exported types ------------------------------------------------------------*/
+// Readers of the mailbox, each with three rows of its own
+typedef enum {
+    SAMPLE_MAILBOX_COMMAND, // Command task, the "latest" reply
+    SAMPLE_MAILBOX_READER_COUNT
+} sample_mailbox_reader_t;
+
+// The newest sample of every channel after one tick
+typedef struct {
+    uint32_t sequence;          // Ticks published since boot, the first is 1
+    uint32_t timestamp;         // Scheduled time of the tick in ms
+    uint16_t valid_mask;        // Bit n set: channel n has been stored at least once
+    uint16_t fresh_mask;        // Bit n set: channel n was stored at this tick
+    float values[SENSOR_COUNT]; // Newest stored value of every channel, in its sensor unit
+} sample_row_t;
+
+// One row, little endian, no padding
+typedef struct {
+    uint8_t type;        // SAMPLE_MAILBOX_FRAME_TYPE
+    uint8_t version;     // SAMPLE_MAILBOX_FRAME_VERSION
+    uint16_t valid_mask; // As in sample_row_t
+    uint16_t fresh_mask;
+    uint8_t encoding;    // STATS_FRAME_ENCODING of every value
+    uint8_t reserved;
+    uint32_t sequence;
+    uint32_t timestamp;
+    uint16_t values[SENSOR_COUNT]; // stats_frame_quantize of every channel, 0 when not valid
+} sample_mailbox_frame_t;
+
+WIRE_ASSERT_FIELD(sample_mailbox_frame_t, type, 0, 1);
+WIRE_ASSERT_FIELD(sample_mailbox_frame_t, version, 1, 1);
+WIRE_ASSERT_FIELD(sample_mailbox_frame_t, valid_mask, 2, 2);
+WIRE_ASSERT_FIELD(sample_mailbox_frame_t, fresh_mask, 4, 2);
+WIRE_ASSERT_FIELD(sample_mailbox_frame_t, encoding, 6, 1);
+WIRE_ASSERT_FIELD(sample_mailbox_frame_t, reserved, 7, 1);
+WIRE_ASSERT_FIELD(sample_mailbox_frame_t, sequence, 8, 4);
+WIRE_ASSERT_FIELD(sample_mailbox_frame_t, timestamp, 12, 4);
+WIRE_ASSERT_FIELD(sample_mailbox_frame_t, values, 16, 2 * SENSOR_COUNT);
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Empty every reader, before the producer runs
+void sample_mailbox_init(void);
+
+// Keep a stored value for the row of the tick in progress. Producer only,
+// the task or the ISR_PIPELINE deferred work.
+void sample_mailbox_stage(sensor_t channel, float value);
+
+// Hand the row of the tick to every reader, at the end of the tick. Producer
+// only. Never blocks, whatever the readers hold.
+void sample_mailbox_publish(uint32_t timestamp);
+
+// Newest complete row for a reader, NULL before the first tick. Valid until
+// the reader's next call, one reader per context. Never blocks and copies
+// nothing, from a task or an interrupt.
+const sample_row_t *sample_mailbox_latest(sample_mailbox_reader_t reader);
+
+// Fill the answer to a "latest" command from a row, returns its size
+uint16_t sample_mailbox_frame(sample_mailbox_frame_t *frame, const sample_row_t *row);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SAMPLE_MAILBOX_H */
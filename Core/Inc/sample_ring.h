@@ -0,0 +1,100 @@
+/**
+  ******************************************************************************
+  * @file    sample_ring.h
+  * @brief   Lock-free single-producer/multi-reader ring of one channel.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SAMPLE_RING_H
+#define __SAMPLE_RING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_data.h"
+
+/* Exported constants --------------------------------------------------------*/
+// Ring capacity per channel, must be a power of two so indices wrap with a mask
+#ifndef SAMPLE_RING_SIZE
+#define SAMPLE_RING_SIZE 512
+#endif
+#define SAMPLE_RING_MASK (SAMPLE_RING_SIZE - 1)
+
+#if (SAMPLE_RING_SIZE & SAMPLE_RING_MASK) != 0
+#error "SAMPLE_RING_SIZE must be a power of two"
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+// Readers of a ring, each with its own cursor over the same samples
+typedef enum {
+    SAMPLE_READER_STATS,    // Consumer task, keeps the statistics window
+    SAMPLE_READER_LOG,      // Consumer task, every sample once into the flash log
+    SAMPLE_READER_RESAMPLE, // Consumer task, aligned rows of CHANNEL_RESAMPLE
+    SAMPLE_READER_COUNT
+} sample_reader_t;
+
+// Every channel has its own ring, sampled at its own rate. The fields are
+// stored structure-of-arrays, so the statistics kernels read the values in
+// place. head is only written by the producer and each cursor only by its
+// reader. All are free-running counters, the slot is selected with
+// SAMPLE_RING_MASK. The ring is full when the slowest gating reader is
+// SAMPLE_RING_SIZE samples behind head.
+typedef struct {
+    uint32_t timestamps[SAMPLE_RING_SIZE];
+    uint32_t acquired_cycles[SAMPLE_RING_SIZE];
+    sample_value_t values[SAMPLE_RING_SIZE];
+    volatile uint32_t head;
+    volatile uint32_t cursors[SAMPLE_READER_COUNT]; // Oldest sample the reader still holds
+    volatile uint32_t gating;  // Bit n set: reader n holds back the producer
+    volatile uint32_t dropped; // Samples rejected because the ring was full
+} sample_ring_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Reset the ring to empty with SAMPLE_READER_STATS as its only gating reader
+void sample_ring_init(sample_ring_t *ring);
+
+// Start a reader at the newest sample. A gating reader holds back the
+// producer, nothing it has not released is overwritten. Any other reader is
+// lapped when it falls SAMPLE_RING_SIZE behind. Before the producer runs.
+void sample_ring_attach(sample_ring_t *ring, sample_reader_t reader, bool gating);
+
+// Producer side, returns false and counts a drop when the ring is full
+bool sample_ring_push(sample_ring_t *ring, const sensor_data_t *sample);
+
+// Reader side, each reader only with its own cursor. Offsets count from the
+// oldest sample the reader holds.
+bool sample_ring_pop(sample_ring_t *ring, sample_reader_t reader, sensor_data_t *sample);
+uint32_t sample_ring_count(const sample_ring_t *ring, sample_reader_t reader);
+// Value at offset from the oldest sample
+sample_value_t sample_ring_value(const sample_ring_t *ring, sample_reader_t reader, uint32_t offset);
+// Timestamp of the sample at offset from the oldest one
+uint32_t sample_ring_timestamp(const sample_ring_t *ring, sample_reader_t reader, uint32_t offset);
+// DWT cycle count at which the sample at offset was published
+uint32_t sample_ring_acquired_cycles(const sample_ring_t *ring, sample_reader_t reader, uint32_t offset);
+// Copy up to max samples starting at offset without consuming them
+uint32_t sample_ring_peek_batch(const sample_ring_t *ring, sample_reader_t reader, uint32_t offset,
+                                sensor_data_t *samples, uint32_t max);
+// Value view: up to count values starting at offset, in place, split in
+// two parts where the range wraps around the end of the storage. The view
+// is valid until the reader discards the samples.
+uint32_t sample_ring_span(const sample_ring_t *ring, sample_reader_t reader, uint32_t offset, uint32_t count,
+                          const sample_value_t **first, uint32_t *first_count,
+                          const sample_value_t **second, uint32_t *second_count);
+// Release the count oldest samples of the reader, the producer reuses a
+// slot once every gating reader released it
+void sample_ring_discard(sample_ring_t *ring, sample_reader_t reader, uint32_t count);
+// Reader that does not gate: skip the samples the producer overwrote and
+// return how many. Call it before reading and after copying, a result other
+// than 0 after the copy means it may hold overwritten slots.
+uint32_t sample_ring_catch_up(sample_ring_t *ring, sample_reader_t reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SAMPLE_RING_H */
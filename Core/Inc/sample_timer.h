@@ -0,0 +1,75 @@
+/**
+  ******************************************************************************
+  * @file    sample_timer.h
+  * @brief   TIM3 driven sampling scheduler for the producer task.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SAMPLE_TIMER_H
+#define __SAMPLE_TIMER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include "main.h"
+#include "rtc_stop.h"
+
+/* Exported constants --------------------------------------------------------*/
+// TIM3 counter clock, the 16-bit period then covers up to 6.5 s
+#define SAMPLE_TIMER_COUNTER_HZ 10000U
+#if RTC_STOP_SAMPLING
+#define SAMPLE_TIMER_PERIOD_MAX_MS (RTC_STOP_PERIOD_MAX_S * 1000U)
+#else
+#define SAMPLE_TIMER_PERIOD_MAX_MS ((65536U * 1000U) / SAMPLE_TIMER_COUNTER_HZ)
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Set the sampling period in milliseconds, must run before the timer starts
+void sample_timer_init(uint32_t period_ms);
+
+// Change the sampling period while TIM3 runs, 1 to SAMPLE_TIMER_PERIOD_MAX_MS.
+// The period in progress completes first, timestamps stay continuous.
+void sample_timer_set_period(uint32_t period_ms);
+
+// Block until the next sampling tick, returns its scheduled time in milliseconds.
+// The time is derived from the tick count, so it does not carry task latency.
+uint32_t sample_timer_wait(void);
+
+// sample_timer_wait that also returns on the other signals in bits, for the
+// producer woken between two ticks. Returns the signalled bits, with
+// TASK_SIGNAL_SAMPLE_TICK among them *timestamp is the time of the tick.
+uint32_t sample_timer_wait_or(uint32_t bits, uint32_t *timestamp);
+
+// Time now in milliseconds on the base of the tick times, from the TIM3
+// counter. From an interrupt at IRQ_PRIORITY_TIMER or a critical section.
+uint32_t sample_timer_now_from_isr(void);
+
+// DWT cycle count captured in the interrupt of the last sampling tick
+uint32_t sample_timer_tick_cycles(void);
+
+// Update events since the timer started, 1 at the first tick. Steps by more
+// than one between two waits when ticks fired while the task was busy.
+uint32_t sample_timer_tick_count(void);
+
+// Called from HAL_TIM_PeriodElapsedCallback on every TIM3 update event, or
+// straight from TIM3_IRQHandler with FLASH_LOG_IDLE_ERASE
+void sample_timer_elapsed_from_isr(void);
+
+// sample_timer_elapsed_from_isr for a tick source that knows its own time,
+// the RTC wakeup with RTC_STOP_SAMPLING
+void sample_timer_elapsed_at_from_isr(uint32_t time_ms);
+
+// While held the ticks are counted without waking the producer, whose wake-up
+// runs from flash. The release wakes it for the latest tick if any fired.
+// Task context only.
+void sample_timer_hold(bool held);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SAMPLE_TIMER_H */
@@ -0,0 +1,53 @@
+/**
+  ******************************************************************************
+  * @file    sensor_breaker.h
+  * @brief   Retry backoff and circuit breaker of the I2C sensors that stop answering.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SENSOR_BREAKER_H
+#define __SENSOR_BREAKER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_data.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: an I2C sensor that fails its reads is skipped for a growing number of
+// its due reads, and left out altogether once its breaker opens
+#ifndef SENSOR_BREAKER
+#define SENSOR_BREAKER 0
+#endif
+// Failures in a row that open the breaker
+#ifndef SENSOR_BREAKER_OPEN_AFTER
+#define SENSOR_BREAKER_OPEN_AFTER 5
+#endif
+// Longest backoff of a closed breaker, in due reads skipped
+#ifndef SENSOR_BREAKER_BACKOFF_MAX
+#define SENSOR_BREAKER_BACKOFF_MAX 16
+#endif
+// Due reads an open breaker skips before its probe, about a minute for a sensor
+// read at every tick of the default period
+#ifndef SENSOR_BREAKER_OPEN_SKIPS
+#define SENSOR_BREAKER_OPEN_SKIPS 256
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Whether a sensor due at this tick is read, called once per due read,
+// producer task only
+bool sensor_breaker_allow(sensor_t channel);
+
+// Outcome on the bus of a read the breaker allowed, producer task only
+void sensor_breaker_result(sensor_t channel, bool ok);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SENSOR_BREAKER_H */
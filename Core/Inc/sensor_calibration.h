@@ -0,0 +1,70 @@
+/**
+  ******************************************************************************
+  * @file    sensor_calibration.h
+  * @brief   Piecewise-linear sensor calibration tables, generated at compile time.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SENSOR_CALIBRATION_H
+#define __SENSOR_CALIBRATION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the LDR reports lux through sensor_calibration_ldr_lux instead of the raw word
+#ifndef SENSOR_CALIBRATION
+#define SENSOR_CALIBRATION 0
+#endif
+
+// Segments over the 16-bit raw range, a power of two so the segment is a shift
+#define SENSOR_CALIBRATION_SEGMENTS 64
+#define SENSOR_CALIBRATION_SEGMENT_SHIFT 10 // 65536 / SENSOR_CALIBRATION_SEGMENTS
+
+// LDR front end: photoresistor from the output to ground, fixed resistor to
+// the supply, resistance at 10 lux and the slope of the log(R)/log(lux) curve
+#ifndef SENSOR_CALIBRATION_LDR_FIXED_OHM
+#define SENSOR_CALIBRATION_LDR_FIXED_OHM 10000.0
+#endif
+#ifndef SENSOR_CALIBRATION_LDR_R10_OHM
+#define SENSOR_CALIBRATION_LDR_R10_OHM 15000.0
+#endif
+#ifndef SENSOR_CALIBRATION_LDR_GAMMA
+#define SENSOR_CALIBRATION_LDR_GAMMA 0.7
+#endif
+// The curve runs away near a shorted photoresistor, it is clamped here
+#define SENSOR_CALIBRATION_LDR_LUX_MAX 20000.0
+
+// FIXED16 unit and delta deadband of the calibrated LDR
+#define STATS_FIXED_SCALE_LDR_LUX 1.0f
+#define STATS_DEADBAND_LDR_LUX 5.0f
+
+/* Exported types ------------------------------------------------------------*/
+// Breakpoints at raw = n << SENSOR_CALIBRATION_SEGMENT_SHIFT, the last one at 65536
+typedef struct {
+    float values[SENSOR_CALIBRATION_SEGMENTS + 1];
+} sensor_calibration_table_t;
+
+/* Exported variables --------------------------------------------------------*/
+// Lux over the raw 16-bit divider reading, in flash
+extern const sensor_calibration_table_t sensor_calibration_ldr_table;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Interpolate a table at a raw reading on the 16-bit scale, clamped to its range
+float sensor_calibration_apply(const sensor_calibration_table_t *table, float raw);
+
+// Calibrate hooks of the registry: the LDR on its 16-bit I2C word and on a
+// 12-bit ADC1 mean
+float sensor_calibration_ldr_lux(float raw);
+float sensor_calibration_ldr_lux_adc(float raw);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SENSOR_CALIBRATION_H */
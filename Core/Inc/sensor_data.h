@@ -0,0 +1,82 @@
+/**
+  ******************************************************************************
+  * @file    sensor_data.h
+  * @brief   Sample types shared by the acquisition and processing stages.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SENSOR_DATA_H
+#define __SENSOR_DATA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// 1: samples are stored as int16 codes in units of the channel fixed_scale
+// (the STATS_ENCODING_FIXED16 unit) and the batch statistics run on integers
+#ifndef STATS_FIXED_POINT
+#define STATS_FIXED_POINT 0
+#endif
+// 1: the humidity and heat sensor returns both its words with their CRCs in
+// one read, SENSOR_HUMIDITY_AND_HEAT keeps the humidity and SENSOR_HEAT the
+// temperature, each a channel with its own statistics
+#ifndef SENSOR_HEAT_CHANNEL
+#define SENSOR_HEAT_CHANNEL 0
+#endif
+// 1: SENSOR_DEW_POINT and SENSOR_HEAT_INDEX are computed from every humidity
+// and temperature read in the producer and get the statistics of any other
+// channel, see sensor_derived.h. Needs SENSOR_HEAT_CHANNEL.
+#ifndef SENSOR_DERIVED
+#define SENSOR_DERIVED 0
+#endif
+#if SENSOR_DERIVED && !SENSOR_HEAT_CHANNEL
+#error "SENSOR_DERIVED computes from the humidity and the temperature, build it with SENSOR_HEAT_CHANNEL=1"
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+// Define the enum for different sensor types, one per sensor_registry row.
+// The frames carry a 16-bit channel mask, so up to 16 sensors.
+typedef enum {
+    SENSOR_PIR,
+    SENSOR_HUMIDITY_AND_HEAT,
+    SENSOR_LDR,
+#if SENSOR_HEAT_CHANNEL
+    SENSOR_HEAT, // Second value of the SENSOR_HUMIDITY_AND_HEAT read, last so the others keep their number
+#endif
+#if SENSOR_DERIVED
+    SENSOR_DEW_POINT,  // Of the humidity and the temperature of the same read, in degC
+    SENSOR_HEAT_INDEX, // Apparent temperature of the same read, in degC
+#endif
+    SENSOR_COUNT
+} sensor_t;
+
+// Stored value of one sample, see sensor_sample_value
+#if STATS_FIXED_POINT
+typedef int16_t sample_value_t;
+#else
+typedef float sample_value_t;
+#endif
+
+// Define the structure to hold one sample of one sensor
+typedef struct {
+    uint32_t timestamp; // Scheduled sample time in milliseconds
+    uint32_t acquired_cycles; // DWT cycle count when the sample was published
+    sample_value_t value;
+} sensor_data_t;
+
+#ifdef __cplusplus
+static_assert(SENSOR_COUNT <= 16, "channel masks are 16 bits wide");
+#else
+_Static_assert(SENSOR_COUNT <= 16, "channel masks are 16 bits wide");
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SENSOR_DATA_H */
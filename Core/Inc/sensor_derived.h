@@ -0,0 +1,36 @@
+/**
+  ******************************************************************************
+  * @file    sensor_derived.h
+  * @brief   Virtual channels computed from the reads of the physical ones.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SENSOR_DERIVED_H
+#define __SENSOR_DERIVED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "sensor_data.h"
+
+/* Exported constants --------------------------------------------------------*/
+// FIXED16 unit, delta deadband and outlier floor of both derived temperatures.
+// Their inputs went through the outlier filter already.
+#define STATS_FIXED_SCALE_DERIVED 0.01f
+#define STATS_DEADBAND_DERIVED 0.1f
+#define OUTLIER_FLOOR_DERIVED 0.0f
+
+/* Exported functions prototypes ---------------------------------------------*/
+// sensor_derive_t of the registry, from the humidity and temperature words of
+// one read of the humidity and heat sensor, both in degC
+float sensor_derived_dew_point(const float *inputs);
+float sensor_derived_heat_index(const float *inputs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SENSOR_DERIVED_H */
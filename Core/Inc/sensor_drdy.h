@@ -0,0 +1,51 @@
+/**
+  ******************************************************************************
+  * @file    sensor_drdy.h
+  * @brief   Data-ready lines of the I2C sensors that sample at their own rate.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SENSOR_DRDY_H
+#define __SENSOR_DRDY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "sensor_registry.h"
+
+/* Exported constants --------------------------------------------------------*/
+// EXTI lines a drdy_line can take, they share EXTI9_5_IRQn
+#define SENSOR_DRDY_LINE_FIRST 5U
+#define SENSOR_DRDY_LINE_LAST 9U
+// Pins of SENSOR_DRDY_GPIO_Port that are data-ready lines
+#define SENSOR_DRDY_PINS (((1U << (SENSOR_DRDY_LINE_LAST + 1U)) - 1U) & ~((1U << SENSOR_DRDY_LINE_FIRST) - 1U))
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Configure the data-ready pin of every row that has one to interrupt on its
+// rising edge, in MX_GPIO_Init
+void sensor_drdy_gpio_init(void);
+
+// Latch the edge of the data-ready pins in pins, from HAL_GPIO_EXTI_Callback.
+// Each row that rose is stamped on the sample time base and the producer is
+// woken with TASK_SIGNAL_SENSOR_READY. A row that rises again before it was
+// read keeps the newer stamp.
+void sensor_drdy_edge_from_isr(uint16_t pins);
+
+// Take the rows that rose since the last call and clear them, their edge
+// times in timestamps[channel]. Also sets the task the edges wake. Producer
+// task only.
+uint32_t sensor_drdy_take(uint32_t *timestamps);
+
+// Latch the rows whose line is already high, which raises no edge: at the
+// start, and after a read that left a newer sample behind. Producer task only.
+void sensor_drdy_rearm(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SENSOR_DRDY_H */
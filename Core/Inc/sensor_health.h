@@ -0,0 +1,91 @@
+/**
+  ******************************************************************************
+  * @file    sensor_health.h
+  * @brief   Quality of every sensor read, rolling error rate and read latency per channel.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SENSOR_HEALTH_H
+#define __SENSOR_HEALTH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "sensor_data.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the producer classifies every read, and a health table of the channels
+// is sent every SENSOR_HEALTH_PERIOD batches
+#ifndef SENSOR_HEALTH
+#define SENSOR_HEALTH 0
+#endif
+#ifndef SENSOR_HEALTH_PERIOD
+#define SENSOR_HEALTH_PERIOD 16
+#endif
+// The error rate follows the last 2^SENSOR_HEALTH_SHIFT reads or so
+#ifndef SENSOR_HEALTH_SHIFT
+#define SENSOR_HEALTH_SHIFT 6
+#endif
+// First byte of a sensor health frame
+#define SENSOR_HEALTH_FRAME_TYPE 0xB8
+#define SENSOR_HEALTH_FRAME_VERSION 1
+// Channels per frame, a table takes as many frames as it needs
+#define SENSOR_HEALTH_FRAME_ENTRIES 3
+
+/* Exported types ------------------------------------------------------------*/
+// Quality of one read, flags. Anything but SENSOR_QUALITY_OK kept the sample
+// out of its ring.
+typedef enum {
+    SENSOR_QUALITY_OK = 0,
+    SENSOR_QUALITY_TIMEOUT = 1U << 0, // The sequence ran out of time before the read
+    SENSOR_QUALITY_NACK = 1U << 1,    // NACK or another bus error
+    SENSOR_QUALITY_CRC = 1U << 2,     // The CRC of the sensor did not match
+    SENSOR_QUALITY_OUTLIER = 1U << 3, // Out of range, rejected by the outlier filter
+} sensor_quality_t;
+
+// One channel over the window, little endian, no padding
+typedef struct {
+    uint8_t channel;         // sensor_t
+    uint8_t quality;         // sensor_quality_t flags of the reads of the window
+    uint16_t score;          // Share of good reads, rolling, in 0.01 %
+    uint16_t reads;          // Reads of the window, good and bad, saturated
+    uint16_t timeouts;
+    uint16_t nacks;
+    uint16_t crc_errors;
+    uint16_t outliers;
+    uint16_t latency_avg_us; // Bus time of an I2C read, 0 for the other sources
+    uint16_t latency_max_us;
+} sensor_health_entry_t;
+
+typedef struct {
+    uint8_t type;        // SENSOR_HEALTH_FRAME_TYPE
+    uint8_t version;     // SENSOR_HEALTH_FRAME_VERSION
+    uint8_t sequence;    // Frame of the table, from 0
+    uint8_t entry_count;
+    uint32_t window_ms;  // Time the table covers, since the previous one
+    sensor_health_entry_t entries[SENSOR_HEALTH_FRAME_ENTRIES];
+} sensor_health_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Quality of one read of a channel, producer task only
+void sensor_health_record(sensor_t channel, uint32_t quality);
+
+// Bus time of one I2C read of a channel, in core cycles, producer task only
+void sensor_health_latency(sensor_t channel, uint32_t cycles);
+
+// Rolling share of good reads of a channel, in 0.01 %, any task
+uint16_t sensor_health_score(sensor_t channel);
+
+// Send the channels read since the last call and start a new window,
+// consumer task only
+void sensor_health_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SENSOR_HEALTH_H */
@@ -0,0 +1,189 @@
+/**
+  ******************************************************************************
+  * @file    sensor_registry.h
+  * @brief   Table of the sensor drivers on the I2C1 bus.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SENSOR_REGISTRY_H
+#define __SENSOR_REGISTRY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_data.h"
+#include "sensor_sim.h"
+
+/* Exported constants --------------------------------------------------------*/
+// Largest raw read of one sensor, sizes the DMA buffers
+#define SENSOR_RAW_MAX 6
+// 1: rows with a fifo_depth are sensors with an on-chip FIFO. They sample on
+// their own, raise the data-ready line SENSOR_FIFO_READY (PB0) at the
+// watermark, and the next tick drains fifo_depth reads in one burst instead
+// of reading one sample per tick.
+#ifndef SENSOR_FIFO
+#define SENSOR_FIFO 0
+#endif
+// Deepest FIFO drain, in reads of raw_size bytes
+#ifndef SENSOR_FIFO_DEPTH_MAX
+#define SENSOR_FIFO_DEPTH_MAX 16
+#endif
+// Watermark of the LDR FIFO with SENSOR_FIFO
+#ifndef SENSOR_FIFO_DEPTH_LDR
+#define SENSOR_FIFO_DEPTH_LDR 16
+#endif
+// 1: rows with a drdy_line are read as soon as their data-ready output rises,
+// stamped with the edge, and never on the tick count, see sensor_drdy.h
+#ifndef SENSOR_DRDY
+#define SENSOR_DRDY 0
+#endif
+// Data-ready line of each sensor that has one, the pin and EXTI line on
+// SENSOR_DRDY_GPIO_Port (PE), 5 to 9. PE7 is free, SENSOR_POWER_GATING
+// cannot be combined.
+#ifndef SENSOR_DRDY_LINE_HUMIDITY_AND_HEAT
+#define SENSOR_DRDY_LINE_HUMIDITY_AND_HEAT 6
+#endif
+#ifndef SENSOR_DRDY_LINE_LDR
+#define SENSOR_DRDY_LINE_LDR 5
+#endif
+// Largest transfer of one row, one read or a FIFO drain
+#if SENSOR_FIFO
+#define SENSOR_READ_MAX (SENSOR_RAW_MAX * SENSOR_FIFO_DEPTH_MAX)
+#else
+#define SENSOR_READ_MAX SENSOR_RAW_MAX
+#endif
+// I2C bus of each I2C sensor, 0 is I2C1, below I2C_BUS_COUNT (i2c_acquisition.h).
+// Sensors on different buses are read at the same time.
+#ifndef SENSOR_BUS_PIR
+#define SENSOR_BUS_PIR 0
+#endif
+#ifndef SENSOR_BUS_HUMIDITY_AND_HEAT
+#define SENSOR_BUS_HUMIDITY_AND_HEAT 0
+#endif
+#ifndef SENSOR_BUS_LDR
+#define SENSOR_BUS_LDR 0
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+// Where the value of a sensor comes from
+typedef enum {
+    SENSOR_SOURCE_I2C,  // Read in the I2C DMA sequence of the tick on its bus, then converted
+    SENSOR_SOURCE_ADC,  // Mean of the ADC1 conversions since the last sample
+    SENSOR_SOURCE_HOOK, // sample() called at the tick
+    SENSOR_SOURCE_SHARED, // Another value of the I2C read of channel parent, converted from the same bytes
+    SENSOR_SOURCE_CAPTURE, // Rate of the TIM4 input captures since the last sample
+    SENSOR_SOURCE_DERIVED, // derive() of the reads of the input_mask channels just published, no bus time
+    SENSOR_SOURCE_SIM   // sensor_sim_sample, every other sensor with SENSOR_SIMULATION, never in the table
+} sensor_source_t;
+
+// Turns the raw bytes of one read into the sample value
+typedef float (*sensor_convert_t)(const uint8_t *raw);
+// Samples a SENSOR_SOURCE_HOOK sensor
+typedef float (*sensor_sample_t)(void);
+// Turns the value of a read into the sensor unit
+typedef float (*sensor_calibrate_t)(float value);
+// Checks the raw bytes of one read, false drops the read like a NACK
+typedef bool (*sensor_check_t)(const uint8_t *raw);
+// Computes a SENSOR_SOURCE_DERIVED value from the latest read of every
+// channel, indexed by sensor_t, after calibration and the outlier filter
+typedef float (*sensor_derive_t)(const float *inputs);
+
+// One sensor, convert and sample must not block, they run in the producer
+// task. A sensor is a row, not a task: the producer steps every due row
+// through the I2C sequence of the tick, so a sensor costs the row in flash
+// and its buffers, never a TCB or a stack. A sensor whose protocol does not
+// fit trigger, conversion and read is a SENSOR_SOURCE_HOOK whose sample()
+// keeps its own static state and moves one step per tick.
+typedef struct {
+    const char *name;
+    sensor_source_t source;
+    uint8_t address;         // SENSOR_SOURCE_I2C: 7-bit I2C address
+    uint8_t bus;             // SENSOR_SOURCE_I2C: 0 is I2C1, 1 I2C2, 2 I2C3
+    uint8_t raw_size;        // SENSOR_SOURCE_I2C: bytes read per sample, at most SENSOR_RAW_MAX
+    const uint8_t *trigger;  // SENSOR_SOURCE_I2C, optional: command written to start a conversion
+    uint8_t trigger_size;    // Bytes of trigger
+    uint8_t conversion_ms;   // Time from the trigger to a result that can be read
+    const uint8_t *setup;    // SENSOR_SOURCE_I2C, optional: command written once when the producer starts
+    uint8_t setup_size;      // Bytes of setup
+    uint8_t fifo_depth;      // SENSOR_SOURCE_I2C with SENSOR_FIFO: reads per drain, trigger selects the FIFO
+    uint8_t drdy_line;       // SENSOR_SOURCE_I2C with SENSOR_DRDY: data-ready pin of PE, 0: read on the tick count
+    uint8_t adc_channel;     // SENSOR_SOURCE_ADC: ADC1 input 0 to 15
+    uint8_t capture_period;  // SENSOR_SOURCE_CAPTURE: 1: the mean period in us, 0: the frequency in Hz
+    uint8_t parent;          // SENSOR_SOURCE_SHARED: sensor_t of the I2C row read, same read divider
+    uint16_t input_mask;     // SENSOR_SOURCE_DERIVED: channels derive reads, all below it, same read divider
+    uint16_t sample_divider; // Stored every n-th sampling tick, n x sample_period_ms
+    uint8_t oversample;      // Reads per stored sample, divides sample_divider, see sample_decimator.h
+    uint8_t event_coded;     // SENSOR_EVENT_CODING: stored on a change of value only, see event_coding.h
+    uint8_t shed_low_priority; // LOAD_SHEDDING: read LOAD_SHED_DECIMATION times slower under load, see load_shed.h
+    sensor_convert_t convert; // SENSOR_SOURCE_I2C and SENSOR_SOURCE_SHARED, of the raw bytes of the read
+    sensor_check_t check;     // SENSOR_SOURCE_I2C and SENSOR_SOURCE_SHARED, optional
+    sensor_sample_t sample;   // SENSOR_SOURCE_HOOK
+    sensor_derive_t derive;   // SENSOR_SOURCE_DERIVED
+    sensor_calibrate_t calibrate; // Optional, applied to every read of any source
+    float fixed_scale;       // Unit of the STATS_ENCODING_FIXED16 statistics
+    float deadband;          // Smallest change sent by the delta reporting
+    float outlier_floor;     // Smallest deviation the outlier filter rejects, 0: never filtered
+} sensor_driver_t;
+
+// Ticks between two reads of a sensor, the decimation stage turns oversample
+// reads into one stored sample
+static inline uint32_t sensor_read_divider(const sensor_driver_t *driver) {
+    return (uint32_t)driver->sample_divider / driver->oversample;
+}
+
+// Reads one transfer of a row holds, oldest first: its FIFO depth or 1
+static inline uint32_t sensor_fifo_reads(const sensor_driver_t *driver) {
+    return driver->fifo_depth > 1 ? driver->fifo_depth : 1U;
+}
+
+// Source the producer takes a sensor from
+static inline sensor_source_t sensor_source(const sensor_driver_t *driver) {
+#if SENSOR_SIMULATION
+    // A derived row derives from the simulated values
+    return driver->source == SENSOR_SOURCE_DERIVED ? SENSOR_SOURCE_DERIVED : SENSOR_SOURCE_SIM;
+#else
+    return driver->source;
+#endif
+}
+
+// Whether a row is read on its data-ready line instead of the tick count
+static inline bool sensor_on_drdy(const sensor_driver_t *driver) {
+    return SENSOR_DRDY && driver->drdy_line != 0 && sensor_source(driver) == SENSOR_SOURCE_I2C;
+}
+
+/* Exported variables --------------------------------------------------------*/
+// One driver per sensor_t, in channel order
+extern const sensor_driver_t sensor_registry[SENSOR_COUNT];
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Big-endian 16-bit word as is, the raw reading of the current sensors
+float sensor_convert_be16(const uint8_t *raw);
+
+// count big-endian words back to back, converted like sensor_convert_be16
+// with one byte swap per two words. For the reads of a FIFO drain.
+void sensor_convert_be16_block(const uint8_t *raw, float *out, uint32_t count);
+
+// Reads of two big-endian words, each followed by its CRC-8 (polynomial
+// 0x31, initial value 0xFF) the way Sensirion sensors send them: the second
+// word, and the CRC check of the first and of the second word
+float sensor_convert_second_be16(const uint8_t *raw);
+bool sensor_check_first_crc8(const uint8_t *raw);
+bool sensor_check_second_crc8(const uint8_t *raw);
+
+// Value in fixed_scale units, rounded and saturated to int16
+int16_t sensor_to_fixed(sensor_t channel, float value);
+
+// Value as stored in the ring: as is, or with STATS_FIXED_POINT its
+// sensor_to_fixed code
+sample_value_t sensor_sample_value(sensor_t channel, float value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SENSOR_REGISTRY_H */
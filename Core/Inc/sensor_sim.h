@@ -0,0 +1,67 @@
+/**
+  ******************************************************************************
+  * @file    sensor_sim.h
+  * @brief   Simulated sensors: generated, replayed from the flash log or streamed over the UART.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SENSOR_SIM_H
+#define __SENSOR_SIM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_data.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: every sensor is simulated, no bus, ADC or hook is read. For load tests
+// on a board without sensors, with the "period" command down to 1 ms.
+#ifndef SENSOR_SIMULATION
+#define SENSOR_SIMULATION 0
+#endif
+// Codes of each channel that can wait for the producer, a power of two
+#ifndef SENSOR_SIM_FIFO_DEPTH
+#define SENSOR_SIM_FIFO_DEPTH 64
+#endif
+#if (SENSOR_SIM_FIFO_DEPTH & (SENSOR_SIM_FIFO_DEPTH - 1)) != 0
+#error "SENSOR_SIM_FIFO_DEPTH must be a power of two"
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    SENSOR_SIM_GENERATE, // Deterministic sine, noise and rare spikes per channel
+    SENSOR_SIM_REPLAY,   // The sample records of the flash log, in a loop, needs FLASH_LOG
+    SENSOR_SIM_STREAM,   // Codes sent with the "sample" command
+    SENSOR_SIM_MODE_COUNT
+} sensor_sim_mode_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Create the replay task, before the scheduler starts. Generation runs from boot.
+void sensor_sim_start(void);
+
+// Switch the source of every channel and drop the codes that wait. A replay
+// starts at the record with sequence, or the oldest one after it. False for an
+// unknown mode or a replay without FLASH_LOG. Task context.
+bool sensor_sim_select(uint32_t mode, uint32_t sequence);
+
+// Queue a sensor_to_fixed code for channel in SENSOR_SIM_STREAM. False when
+// the channel is unknown, the mode is another one or its FIFO is full. Task context.
+bool sensor_sim_inject(uint32_t channel, int16_t code);
+
+// Next value of channel in its sensor unit, producer task only. An empty FIFO
+// repeats the last value and counts an underrun.
+float sensor_sim_sample(sensor_t channel);
+
+// Samples that had no code waiting, since boot
+uint32_t sensor_sim_underruns(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SENSOR_SIM_H */
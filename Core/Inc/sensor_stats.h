@@ -0,0 +1,331 @@
+/**
+  ******************************************************************************
+  * @file    sensor_stats.h
+  * @brief   Statistics kernels for the consumer task.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SENSOR_STATS_H
+#define __SENSOR_STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_data.h"
+#include "arena.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: batch std dev/max/min use CMSIS-DSP (set by the USE_CMSIS_DSP CMake option)
+#ifndef STATS_USE_CMSIS_DSP
+#define STATS_USE_CMSIS_DSP 0
+#endif
+
+// Largest window the streaming kernels can hold
+#ifndef STATS_WINDOW_CAPACITY
+#define STATS_WINDOW_CAPACITY 128
+#endif
+// Slots of a median window or min/max deque of STATS_WINDOW_CAPACITY: the
+// consumer adds the new sample before the oldest one leaves, so a full window
+// holds one sample more for a moment
+#define STATS_WINDOW_CAPACITY_SLOTS (STATS_WINDOW_CAPACITY + 1)
+
+// 1: the sample arrays of the sliding median and min/max are not part of
+// their structs but bound to arena storage of a runtime capacity, see
+// window_stats_bind. 0: every window has STATS_WINDOW_CAPACITY_SLOTS.
+#ifndef STATS_ARENA
+#define STATS_ARENA 0
+#endif
+
+// 1: every window also keeps its time-weighted mean and variance, each sample
+// weighted by how long it held until the next one, see window_stats_hold
+#ifndef STATS_TIME_WEIGHTED
+#define STATS_TIME_WEIGHTED 0
+#endif
+
+// 1: the streaming median comes from a histogram of the int16 codes instead
+// of the two heaps, needs STATS_FIXED_POINT
+#ifndef STATS_HISTOGRAM_MEDIAN
+#define STATS_HISTOGRAM_MEDIAN 0
+#endif
+#if STATS_HISTOGRAM_MEDIAN && !STATS_FIXED_POINT
+#error "STATS_HISTOGRAM_MEDIAN needs STATS_FIXED_POINT, the histogram counts int16 codes"
+#endif
+// Coarse bins of the histogram, each 2^ORDER_HISTOGRAM_SHIFT codes wide
+#define ORDER_HISTOGRAM_BINS 256U
+#define ORDER_HISTOGRAM_SHIFT 8U
+
+// Samples a median window or a min/max deque holds
+#if STATS_ARENA
+#define STATS_WINDOW_SLOTS(window) ((window)->capacity)
+#else
+#define STATS_WINDOW_SLOTS(window) STATS_WINDOW_CAPACITY_SLOTS
+#endif
+// Arena bytes window_stats_bind takes for a window of capacity samples, the
+// median arrays and the two min/max deques
+#define MEDIAN_WINDOW_STORAGE_BYTES(capacity)                                                      \
+    (ARENA_BYTES((capacity) * 4U) + 3U * ARENA_BYTES((capacity) * 2U) + ARENA_BYTES(capacity))
+#define EXTREMUM_WINDOW_STORAGE_BYTES(capacity) (2U * 2U * ARENA_BYTES((capacity) * 4U))
+#if STATS_HISTOGRAM_MEDIAN
+#define WINDOW_STATS_STORAGE_BYTES(capacity) EXTREMUM_WINDOW_STORAGE_BYTES(capacity)
+#else
+#define WINDOW_STATS_STORAGE_BYTES(capacity)                                                       \
+    (MEDIAN_WINDOW_STORAGE_BYTES(capacity) + EXTREMUM_WINDOW_STORAGE_BYTES(capacity))
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+// Single-pass moments and extrema of one channel over a batch of samples.
+// Sums are taken relative to the first sample (shift) to limit cancellation.
+typedef struct {
+    uint32_t count;
+    float shift;
+    float sum;
+    float sum_sq;
+    float min;
+    float max;
+} batch_stats_t;
+
+// Exact integer moments and extrema of int16 samples (STATS_FIXED_POINT).
+// 64-bit sums cannot overflow for any window a ring can hold.
+typedef struct {
+    uint32_t count;
+    int64_t sum;
+    uint64_t sum_sq;
+    int16_t min;
+    int16_t max;
+} batch_stats_q15_t;
+
+// Running mean and sum of squared deviations (Welford) over a sliding window
+typedef struct {
+    uint32_t count;
+    float mean;
+    float m2;
+} running_stats_t;
+
+// Running weighted mean and sum of squared deviations (West's weighted
+// Welford) over a sliding window, weight is the sum of the sample weights
+typedef struct {
+    uint32_t count;
+    float weight;
+    float mean;
+    float m2;
+} weighted_stats_t;
+
+// Exact integer moments of the int16 codes of a sliding window
+// (STATS_FIXED_POINT). Adding and removing are exact, the sums never drift.
+typedef struct {
+    uint32_t count;
+    int64_t sum;
+    uint64_t sum_sq;
+} running_stats_q15_t;
+
+// Running means, sums of squared deviations and co-moment (Welford) of a
+// stream of (x, y) pairs
+typedef struct {
+    uint32_t count;
+    float mean_x;
+    float mean_y;
+    float m2_x;
+    float m2_y;
+    float c_xy;
+} comoment_t;
+
+// Sliding median over the last count samples, in insertion order in values[]
+typedef struct {
+#if STATS_ARENA
+    float *values;
+    uint16_t *low;
+    uint16_t *high;
+    uint16_t *position;
+    uint8_t *in_high;
+    uint16_t capacity;
+#else
+    float values[STATS_WINDOW_CAPACITY_SLOTS];
+    uint16_t low[STATS_WINDOW_CAPACITY_SLOTS];      // Max-heap of slots in the lower half
+    uint16_t high[STATS_WINDOW_CAPACITY_SLOTS];     // Min-heap of slots in the upper half
+    uint16_t position[STATS_WINDOW_CAPACITY_SLOTS]; // Heap index of each slot
+    uint8_t in_high[STATS_WINDOW_CAPACITY_SLOTS];   // Which heap each slot lives in
+#endif
+    uint16_t low_count;
+    uint16_t high_count;
+    uint16_t oldest;
+    uint16_t count;
+} median_window_t;
+
+// Counts of the window codes per coarse bin, in code order. The codes
+// themselves stay in the sample ring, a query refines the bin it lands in
+// by scanning them.
+typedef struct {
+    uint16_t bins[ORDER_HISTOGRAM_BINS];
+    uint16_t count;
+} order_histogram_t;
+
+// Deque of window samples whose values are monotonic from front to back
+typedef struct {
+#if STATS_ARENA
+    float *value;
+    uint32_t *sequence;
+    uint16_t capacity;
+#else
+    float value[STATS_WINDOW_CAPACITY_SLOTS];
+    uint32_t sequence[STATS_WINDOW_CAPACITY_SLOTS]; // Position of the sample in the stream
+#endif
+    uint16_t front;
+    uint16_t count;
+} monotonic_deque_t;
+
+// Sliding minimum and maximum, the extremum is always at the deque front
+typedef struct {
+    monotonic_deque_t max;
+    monotonic_deque_t min;
+    uint32_t next_sequence;   // Sequence number of the next sample added
+    uint32_t oldest_sequence; // Sequence number of the oldest sample in the window
+} extremum_window_t;
+
+// All streaming statistics of one channel over the same sliding window
+typedef struct {
+#if STATS_FIXED_POINT
+    running_stats_q15_t moments;
+#else
+    running_stats_t moments;
+    // Welford over the samples added since the last resync, never removed
+    // from. Once the window has turned over it holds exactly the window and
+    // replaces moments, with the rounding of every removal dropped.
+    running_stats_t shadow;
+    uint32_t resync_pending; // Samples of the window older than the shadow
+#endif
+#if STATS_TIME_WEIGHTED
+    // Samples weighted by their hold time, with a shadow of their own like
+    // moments, in the float sample unit also with STATS_FIXED_POINT
+    weighted_stats_t timed;
+    weighted_stats_t timed_shadow;
+    uint32_t timed_pending; // Held samples of the window older than the shadow
+#endif
+#if STATS_HISTOGRAM_MEDIAN
+    order_histogram_t histogram;
+#else
+    median_window_t median;
+#endif
+    extremum_window_t extremum;
+} window_stats_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Batch kernels over a contiguous array
+float calculate_std_dev(float data[], uint32_t count);
+float calculate_max(float data[], uint32_t count);
+float calculate_min(float data[], uint32_t count);
+// Selects the median with quickselect in O(n), data is reordered in place
+float calculate_median(float data[], uint32_t count);
+
+// Fused kernel, one pass over a channel gives sum, sum of squares, min and max.
+// May be called repeatedly to cover a window stored in several parts.
+void batch_stats_reset(batch_stats_t *stats);
+void batch_stats_accumulate(batch_stats_t *stats, const float *values, uint32_t count);
+float batch_stats_std_dev(const batch_stats_t *stats);
+
+// Fixed-point fused kernel, integer only until the final square root. Where
+// the core has the DSP extension it takes two samples per step (SMLALD for
+// the sums, SSUB16/SEL for the extrema). The scalar version gives the same
+// result one sample at a time and is kept as its reference.
+void batch_stats_q15_reset(batch_stats_q15_t *stats);
+void batch_stats_q15_accumulate(batch_stats_q15_t *stats, const int16_t *values, uint32_t count);
+void batch_stats_q15_accumulate_scalar(batch_stats_q15_t *stats, const int16_t *values, uint32_t count);
+float batch_stats_q15_std_dev(const batch_stats_q15_t *stats);
+// Median of int16 samples in their unit, data is reordered in place
+float calculate_median_q15(int16_t data[], uint32_t count);
+
+// Streaming kernels, O(1) per sample entering or leaving the window
+void running_stats_reset(running_stats_t *stats);
+void running_stats_add(running_stats_t *stats, float value);
+void running_stats_remove(running_stats_t *stats, float value);
+float running_stats_mean(const running_stats_t *stats);
+float running_stats_std_dev(const running_stats_t *stats);
+
+// Weighted streaming kernels, O(1) per sample. A sample removed must come
+// with the weight it was added with.
+void weighted_stats_reset(weighted_stats_t *stats);
+void weighted_stats_add(weighted_stats_t *stats, float value, float weight);
+void weighted_stats_remove(weighted_stats_t *stats, float value, float weight);
+float weighted_stats_mean(const weighted_stats_t *stats);
+float weighted_stats_std_dev(const weighted_stats_t *stats);
+
+// Exact streaming moments of int16 codes, O(1) per sample
+void running_stats_q15_reset(running_stats_q15_t *stats);
+void running_stats_q15_add(running_stats_q15_t *stats, int16_t value);
+void running_stats_q15_remove(running_stats_q15_t *stats, int16_t value);
+float running_stats_q15_std_dev(const running_stats_q15_t *stats);
+
+// Pairwise covariance, O(1) per pair of samples
+void comoment_reset(comoment_t *stats);
+void comoment_add(comoment_t *stats, float x, float y);
+float comoment_covariance(const comoment_t *stats);
+float comoment_correlation(const comoment_t *stats);
+
+// Sliding median, O(log n) per sample entering or leaving the window
+void median_window_reset(median_window_t *window);
+#if STATS_ARENA
+// Take the arrays of a window of capacity samples, MEDIAN_WINDOW_STORAGE_BYTES,
+// from arena. False when they do not fit. Reset the window before its first use.
+bool median_window_bind(median_window_t *window, arena_t *arena, uint16_t capacity);
+#endif
+// A sample added to a full window is dropped and counted, see window_stats_overflows
+void median_window_add(median_window_t *window, float value);
+void median_window_remove_oldest(median_window_t *window);
+float median_window_median(const median_window_t *window);
+
+// Histogram order statistics of int16 codes, O(1) per sample entering or
+// leaving the window. A query walks the coarse bins and refines the one it
+// lands in over the window codes, given as up to two spans, in O(bins + n).
+void order_histogram_reset(order_histogram_t *histogram);
+void order_histogram_add(order_histogram_t *histogram, int16_t code);
+void order_histogram_remove(order_histogram_t *histogram, int16_t code);
+int16_t order_histogram_select(const order_histogram_t *histogram, uint32_t rank, const int16_t *first,
+                               uint32_t first_count, const int16_t *second, uint32_t second_count);
+float order_histogram_percentile(const order_histogram_t *histogram, float p, const int16_t *first,
+                                 uint32_t first_count, const int16_t *second, uint32_t second_count);
+
+// Sliding min/max, O(1) amortized per sample entering or leaving the window
+void extremum_window_reset(extremum_window_t *window);
+void extremum_window_add(extremum_window_t *window, float value);
+void extremum_window_remove_oldest(extremum_window_t *window);
+float extremum_window_max(const extremum_window_t *window);
+float extremum_window_min(const extremum_window_t *window);
+
+// Samples a median window or a min/max deque had no slot for since boot. Not
+// 0 means a window larger than its storage, its median or extrema are wrong.
+uint32_t window_stats_overflows(void);
+
+// Per-channel window, updates every streaming kernel at once
+void window_stats_reset(window_stats_t *stats);
+#if STATS_ARENA
+// Take the arrays of every kernel of a window of capacity samples,
+// WINDOW_STATS_STORAGE_BYTES, from arena. False when they do not fit. Reset
+// the window before its first use.
+bool window_stats_bind(window_stats_t *stats, arena_t *arena, uint16_t capacity);
+#endif
+void window_stats_add(window_stats_t *stats, float value);
+void window_stats_remove_oldest(window_stats_t *stats, float oldest_value);
+// Population standard deviation of the channel window
+float window_stats_std_dev(const window_stats_t *stats);
+#if STATS_TIME_WEIGHTED
+// A window sample that is not the newest held its value for held_ms, until
+// the next sample. Each sample is held once, after the next one was added,
+// and released with the same held_ms before it is removed. A held_ms of 0
+// neither holds nor releases.
+void window_stats_hold(window_stats_t *stats, float value, float held_ms);
+void window_stats_release(window_stats_t *stats, float value, float held_ms);
+// Time-weighted mean and population standard deviation of the held samples,
+// the span from the oldest sample to the newest
+float window_stats_time_mean(const window_stats_t *stats);
+float window_stats_time_std_dev(const window_stats_t *stats);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SENSOR_STATS_H */
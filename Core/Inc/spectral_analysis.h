@@ -0,0 +1,100 @@
+/**
+  ******************************************************************************
+  * @file    spectral_analysis.h
+  * @brief   FFT of the raw ADC conversions of one channel, peaks and band energies.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SPECTRAL_ANALYSIS_H
+#define __SPECTRAL_ANALYSIS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "adc_acquisition.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: every SPECTRAL_ANALYSIS_PERIOD batches the consumer sends the spectrum
+// of the newest block of ADC conversions of SPECTRAL_ANALYSIS_CHANNEL
+#ifndef SPECTRAL_ANALYSIS
+#define SPECTRAL_ANALYSIS 0
+#endif
+#if SPECTRAL_ANALYSIS && !ADC_ACQUISITION
+#error "SPECTRAL_ANALYSIS needs ADC_ACQUISITION, the spectrum is taken at the scan rate"
+#endif
+// A SENSOR_SOURCE_ADC channel, the LDR sees lamp flicker at twice the mains frequency
+#ifndef SPECTRAL_ANALYSIS_CHANNEL
+#define SPECTRAL_ANALYSIS_CHANNEL SENSOR_LDR
+#endif
+// Conversions per FFT, a power of two from 32 to 512. Bins are
+// ADC_ACQUISITION_RATE_HZ / SPECTRAL_ANALYSIS_SIZE wide, 3.9 Hz by default.
+#ifndef SPECTRAL_ANALYSIS_SIZE
+#define SPECTRAL_ANALYSIS_SIZE 256
+#endif
+#ifndef SPECTRAL_ANALYSIS_PERIOD
+#define SPECTRAL_ANALYSIS_PERIOD 1
+#endif
+// First byte of a spectrum frame
+#define SPECTRAL_FRAME_TYPE 0xA9
+#define SPECTRAL_FRAME_VERSION 1
+// Strongest local maxima reported
+#define SPECTRAL_ANALYSIS_PEAKS 3
+// Octave bands, band b holds bins 2^b to 2^(b+1) - 1, up to the last bin
+#if SPECTRAL_ANALYSIS_SIZE == 32
+#define SPECTRAL_ANALYSIS_BANDS 4
+#elif SPECTRAL_ANALYSIS_SIZE == 64
+#define SPECTRAL_ANALYSIS_BANDS 5
+#elif SPECTRAL_ANALYSIS_SIZE == 128
+#define SPECTRAL_ANALYSIS_BANDS 6
+#elif SPECTRAL_ANALYSIS_SIZE == 256
+#define SPECTRAL_ANALYSIS_BANDS 7
+#elif SPECTRAL_ANALYSIS_SIZE == 512
+#define SPECTRAL_ANALYSIS_BANDS 8
+#else
+#error "SPECTRAL_ANALYSIS_SIZE must be a power of two from 32 to 512"
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+// One spectral peak, frequency interpolated between the bins
+typedef struct {
+    uint16_t frequency_dhz; // 0.1 Hz, 0 when there are fewer peaks
+    uint16_t amplitude;     // Half float, amplitude of the sinusoid in ADC codes,
+                            // up to 15 % low when it falls between two bins
+} spectral_peak_t;
+
+// Spectrum frame as sent over the UART, little endian, no padding
+typedef struct {
+    uint8_t type;            // SPECTRAL_FRAME_TYPE
+    uint8_t version;         // SPECTRAL_FRAME_VERSION
+    uint8_t channel;         // sensor_t of the spectrum
+    uint8_t band_count;      // SPECTRAL_ANALYSIS_BANDS
+    uint16_t sample_rate_hz; // ADC_ACQUISITION_RATE_HZ
+    uint16_t size;           // SPECTRAL_ANALYSIS_SIZE
+    uint16_t mean;           // Half float, in ADC codes
+    uint16_t rms;            // Half float, of the block minus its mean
+    spectral_peak_t peaks[SPECTRAL_ANALYSIS_PEAKS]; // Strongest first
+    uint16_t band_share[SPECTRAL_ANALYSIS_BANDS];   // Fraction of the AC energy, 65535 is all of it
+} spectral_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Check the channel and clear the blocks, before adc_acquisition_start
+void spectral_analysis_init(void);
+
+// Called from the ADC1 DMA interrupts with count completed conversions of
+// the channel, stride samples apart
+void spectral_analysis_collect_from_isr(const uint16_t *conversions, uint32_t count, uint32_t stride);
+
+// Run the FFT over the newest complete block and build the frame. Returns
+// the number of bytes to send, 0 when no block completed since the last
+// call. Consumer task only.
+uint16_t spectral_analysis_build(spectral_frame_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SPECTRAL_ANALYSIS_H */
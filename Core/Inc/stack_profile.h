@@ -0,0 +1,65 @@
+/**
+  ******************************************************************************
+  * @file    stack_profile.h
+  * @brief   Stack overflow checking and per-task stack usage frame.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STACK_PROFILE_H
+#define __STACK_PROFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "cmsis_os.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the kernel checks every task stack on each switch, and the size and
+// deepest use of each stack are sent every STACK_PROFILE_PERIOD batches
+#ifndef STACK_PROFILE
+#define STACK_PROFILE 0
+#endif
+#ifndef STACK_PROFILE_PERIOD
+#define STACK_PROFILE_PERIOD 16
+#endif
+// First byte of a stack profile frame
+#define STACK_PROFILE_FRAME_TYPE 0xA7
+// Stacks reported per frame, the interrupt stack included
+#define STACK_PROFILE_MAX_TASKS 7
+
+/* Exported types ------------------------------------------------------------*/
+// One stack, little endian, no padding. Words are StackType_t, 4 bytes.
+typedef struct {
+    char tag[4];             // First characters of the task name, "ISR" for the main stack
+    uint16_t size_words;
+    uint16_t min_free_words; // Words never written since boot
+} stack_profile_entry_t;
+
+typedef struct {
+    uint8_t type;            // STACK_PROFILE_FRAME_TYPE
+    uint8_t task_count;
+    uint16_t reserved;
+    stack_profile_entry_t tasks[STACK_PROFILE_MAX_TASKS];
+} stack_profile_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Fill the unused part of the main stack with the kernel fill byte, so the
+// deepest interrupt nesting can be measured. Before the scheduler starts.
+void stack_profile_init(void);
+
+// Report a task created from a static stack of size_words words. The idle
+// and timer tasks are added by the module itself.
+void stack_profile_track(TaskHandle_t task, uint32_t size_words);
+
+// Fill a frame with every tracked stack, returns the number of bytes to send
+uint16_t stack_profile_build(stack_profile_frame_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STACK_PROFILE_H */
@@ -0,0 +1,267 @@
+/**
+  ******************************************************************************
+  * @file    static_containers.hpp
+  * @brief   Header-only fixed-capacity containers, nothing comes from the heap.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STATIC_CONTAINERS_HPP
+#define __STATIC_CONTAINERS_HPP
+
+/* Includes ------------------------------------------------------------------*/
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+// The storage of every container is a member array of its Capacity, so an
+// instance sits in .bss, on a stack or in CCMRAM like any C struct. Nothing
+// throws: a push that does not fit returns false and leaves the container
+// unchanged, reading an empty one is the caller's error. None of them may
+// be shared between a task and an interrupt, sample_ring_t is the
+// producer-consumer handoff.
+namespace fixed {
+
+template <std::size_t Capacity>
+constexpr bool power_of_two = Capacity > 0 && (Capacity & (Capacity - 1)) == 0;
+
+/* StaticRing ----------------------------------------------------------------*/
+// FIFO of up to Capacity items. head_ and tail_ are free-running counters
+// like the cursors of sample_ring_t, the slot is selected with the mask.
+template <typename T, std::size_t Capacity>
+class StaticRing {
+public:
+    static_assert(power_of_two<Capacity>, "StaticRing capacity must be a power of two");
+    static_assert(Capacity <= (1UL << 31), "the free-running counters must not wrap into each other");
+
+    static constexpr std::size_t capacity() { return Capacity; }
+    std::size_t size() const { return head_ - tail_; }
+    bool empty() const { return head_ == tail_; }
+    bool full() const { return size() == Capacity; }
+
+    // Append at the back, false when full
+    bool push(const T &item) {
+        if (full()) {
+            return false;
+        }
+        items_[head_++ & mask] = item;
+        return true;
+    }
+    // Append at the back, dropping the oldest item when full
+    void push_overwrite(const T &item) {
+        if (full()) {
+            ++tail_;
+        }
+        items_[head_++ & mask] = item;
+    }
+    // Take the oldest item, false when empty
+    bool pop(T &item) {
+        if (empty()) {
+            return false;
+        }
+        item = items_[tail_++ & mask];
+        return true;
+    }
+    // Release the count oldest items, at most size()
+    void discard(std::size_t count) { tail_ += static_cast<std::uint32_t>(count < size() ? count : size()); }
+    void clear() { tail_ = head_; }
+
+    // Item at offset from the oldest one
+    T &operator[](std::size_t offset) { return items_[(tail_ + offset) & mask]; }
+    const T &operator[](std::size_t offset) const { return items_[(tail_ + offset) & mask]; }
+    T &front() { return items_[tail_ & mask]; }
+    T &back() { return items_[(head_ - 1U) & mask]; }
+
+private:
+    static constexpr std::uint32_t mask = Capacity - 1U;
+    T items_[Capacity];
+    std::uint32_t head_ = 0;
+    std::uint32_t tail_ = 0;
+};
+
+/* MonotonicDeque ------------------------------------------------------------*/
+// Sliding extremum of a window, the algorithm of extremum_window_t. Only the
+// items that can still become the extremum are kept: a new one evicts every
+// older one it is not worse than from the back, and the front leaves once
+// its sequence falls out of the window. Compare = std::greater<T> keeps the
+// maximum at the front, std::less<T> the minimum. Every item is pushed and
+// popped at most once, O(1) amortized. Capacity must be at least the window.
+template <typename T, std::size_t Capacity, typename Compare = std::greater<T>>
+class MonotonicDeque {
+public:
+    static_assert(power_of_two<Capacity>, "MonotonicDeque capacity must be a power of two");
+
+    static constexpr std::size_t capacity() { return Capacity; }
+    std::size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    // Add the item with the next sequence number of the stream
+    void push(const T &value, std::uint32_t sequence) {
+        while (count_ > 0 && !compare_(entries_[(front_ + count_ - 1U) & mask].value, value)) {
+            --count_;
+        }
+        // Full only when the window is larger than Capacity, the oldest goes
+        if (count_ == Capacity) {
+            front_ = (front_ + 1U) & mask;
+            --count_;
+        }
+        entries_[(front_ + count_) & mask] = Entry{value, sequence};
+        ++count_;
+    }
+    // Drop the front items older than oldest_sequence, the first sample still in the window
+    void expire(std::uint32_t oldest_sequence) {
+        while (count_ > 0 && static_cast<std::int32_t>(entries_[front_].sequence - oldest_sequence) < 0) {
+            front_ = (front_ + 1U) & mask;
+            --count_;
+        }
+    }
+    // Extremum of the window
+    const T &front() const { return entries_[front_].value; }
+    void clear() { count_ = 0; }
+
+private:
+    struct Entry {
+        T value;
+        std::uint32_t sequence;
+    };
+    static constexpr std::uint32_t mask = Capacity - 1U;
+    Entry entries_[Capacity];
+    std::uint32_t front_ = 0;
+    std::uint32_t count_ = 0;
+    [[no_unique_address]] Compare compare_{};
+};
+
+/* StaticHeap ----------------------------------------------------------------*/
+// Binary heap of up to Capacity items, the item that compares first on top.
+// Compare = std::less<T> is a max-heap like std::priority_queue, std::greater
+// a min-heap. Push and pop are O(log n), top O(1).
+template <typename T, std::size_t Capacity, typename Compare = std::less<T>>
+class StaticHeap {
+public:
+    static_assert(Capacity > 0, "StaticHeap needs room for one item");
+
+    static constexpr std::size_t capacity() { return Capacity; }
+    std::size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    bool full() const { return count_ == Capacity; }
+
+    // Insert, false when full
+    bool push(const T &item) {
+        if (full()) {
+            return false;
+        }
+        std::size_t child = count_++;
+        // Sift up with a hole, one move per level instead of a swap
+        while (child > 0) {
+            std::size_t parent = (child - 1U) / 2U;
+            if (!compare_(items_[parent], item)) {
+                break;
+            }
+            items_[child] = std::move(items_[parent]);
+            child = parent;
+        }
+        items_[child] = item;
+        return true;
+    }
+    // Take the top item, false when empty
+    bool pop(T &item) {
+        if (empty()) {
+            return false;
+        }
+        item = std::move(items_[0]);
+        if (--count_ > 0) {
+            sift_down(std::move(items_[count_]));
+        }
+        return true;
+    }
+    const T &top() const { return items_[0]; }
+    void clear() { count_ = 0; }
+
+private:
+    // Function to place last, the old back item, from the root down
+    void sift_down(T &&last) {
+        std::size_t parent = 0;
+        for (;;) {
+            std::size_t child = 2U * parent + 1U;
+            if (child >= count_) {
+                break;
+            }
+            if (child + 1U < count_ && compare_(items_[child], items_[child + 1U])) {
+                ++child;
+            }
+            if (!compare_(last, items_[child])) {
+                break;
+            }
+            items_[parent] = std::move(items_[child]);
+            parent = child;
+        }
+        items_[parent] = std::move(last);
+    }
+
+    T items_[Capacity];
+    std::size_t count_ = 0;
+    [[no_unique_address]] Compare compare_{};
+};
+
+/* StaticVector --------------------------------------------------------------*/
+// Contiguous array of up to Capacity items, the interface of a std::vector
+// that never grows
+template <typename T, std::size_t Capacity>
+class StaticVector {
+public:
+    static_assert(Capacity > 0, "StaticVector needs room for one item");
+
+    static constexpr std::size_t capacity() { return Capacity; }
+    std::size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    bool full() const { return count_ == Capacity; }
+
+    // Append, false when full
+    bool push_back(const T &item) {
+        if (full()) {
+            return false;
+        }
+        items_[count_++] = item;
+        return true;
+    }
+    // Append the count items, false and nothing appended when they do not fit
+    bool append(const T *items, std::size_t count) {
+        if (count > Capacity - count_) {
+            return false;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            items_[count_ + i] = items[i];
+        }
+        count_ += count;
+        return true;
+    }
+    void pop_back() { --count_; }
+    // Shrink to count items, or grow to it with value, clamped to Capacity
+    void resize(std::size_t count, const T &value = T{}) {
+        count = count < Capacity ? count : Capacity;
+        for (std::size_t i = count_; i < count; ++i) {
+            items_[i] = value;
+        }
+        count_ = count;
+    }
+    void clear() { count_ = 0; }
+
+    T &operator[](std::size_t index) { return items_[index]; }
+    const T &operator[](std::size_t index) const { return items_[index]; }
+    T &back() { return items_[count_ - 1U]; }
+    T *data() { return items_; }
+    const T *data() const { return items_; }
+    T *begin() { return items_; }
+    T *end() { return items_ + count_; }
+    const T *begin() const { return items_; }
+    const T *end() const { return items_ + count_; }
+
+private:
+    T items_[Capacity];
+    std::size_t count_ = 0;
+};
+
+} // namespace fixed
+
+#endif /* __STATIC_CONTAINERS_HPP */
@@ -0,0 +1,47 @@
+/**
+  ******************************************************************************
+  * @file    stats_arena.h
+  * @brief   Arena of the streaming window storage, laid out again when the window is resized.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STATS_ARENA_H
+#define __STATS_ARENA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_stats.h"
+
+/* Exported constants --------------------------------------------------------*/
+// Bytes of the arena the channel windows and views are carved from, with
+// STATS_ARENA. 0: room for every one of them at STATS_WINDOW_CAPACITY.
+#ifndef STATS_ARENA_BYTES
+#define STATS_ARENA_BYTES 0
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Whether the windows and views of every channel fit the arena for a window
+// of window_size samples. Any task, the arena is not touched.
+bool stats_arena_fits(uint32_t window_size);
+
+// Give the whole arena back and carve the arrays of windows[SENSOR_COUNT]
+// and, with STATS_VIEWS, of views[view][SENSOR_COUNT] in the order of
+// STATS_VIEW_WINDOWS, for a window of window_size samples. Every window must
+// then be reset. False, with some windows unbound, when they do not fit.
+// Consumer task only.
+bool stats_arena_layout(window_stats_t *windows, window_stats_t *views, uint32_t window_size);
+
+// The arena with its size, fill level and peak, for the heap telemetry
+const arena_t *stats_arena_state(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STATS_ARENA_H */
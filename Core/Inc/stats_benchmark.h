@@ -0,0 +1,36 @@
+/**
+  ******************************************************************************
+  * @file    stats_benchmark.h
+  * @brief   On-target cycle benchmark of the statistics kernels.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STATS_BENCHMARK_H
+#define __STATS_BENCHMARK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Exported constants --------------------------------------------------------*/
+// Timed runs per kernel, window size and distribution
+#ifndef STATS_BENCHMARK_RUNS
+#define STATS_BENCHMARK_RUNS 32
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Create the benchmark task. It runs once after the scheduler starts, above
+// the processing stage, reports one CSV line per case over USART2 and then
+// deletes itself: kernel,size,distribution,min,avg,max (core cycles). The
+// producer keeps sampling, a tick that falls into a timed call comes late.
+void stats_benchmark_start(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STATS_BENCHMARK_H */
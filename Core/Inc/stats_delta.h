@@ -0,0 +1,129 @@
+/**
+  ******************************************************************************
+  * @file    stats_delta.h
+  * @brief   Change-only reporting of the window statistics.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STATS_DELTA_H
+#define __STATS_DELTA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "stats_frame.h"
+
+/* Exported constants --------------------------------------------------------*/
+// First byte of a delta frame, keyframes are plain STATS_FRAME_TYPE frames
+#define STATS_DELTA_FRAME_TYPE 0xA3
+// Version 2 has the occupancy byte of SENSOR_OCCUPANCY after encoding
+#if SENSOR_OCCUPANCY
+#define STATS_DELTA_FRAME_VERSION 2
+#else
+#define STATS_DELTA_FRAME_VERSION 1
+#endif
+
+// A keyframe every STATS_KEYFRAME_INTERVAL reports, delta frames in between
+#ifndef STATS_KEYFRAME_INTERVAL
+#define STATS_KEYFRAME_INTERVAL 10
+#endif
+
+// Smallest change of a statistic that is reported, in sensor units, for the
+// current sensors, see sensor_registry. Smaller changes accumulate against
+// the last value sent until they cross it.
+#ifndef STATS_DEADBAND_PIR
+#define STATS_DEADBAND_PIR 0.0f
+#endif
+#ifndef STATS_DEADBAND_HUMIDITY_AND_HEAT
+#define STATS_DEADBAND_HUMIDITY_AND_HEAT 4.0f
+#endif
+#ifndef STATS_DEADBAND_LDR
+#define STATS_DEADBAND_LDR 8.0f
+#endif
+#ifndef STATS_DEADBAND_HEAT
+#define STATS_DEADBAND_HEAT 4.0f
+#endif
+
+// Longest zig-zag varint of a 16-bit delta
+#define STATS_DELTA_VARINT_MAX 3
+// One field_mask bit per statistic
+#define STATS_DELTA_MASK_BYTES ((SENSOR_COUNT * STATS_FIELD_COUNT + 7) / 8)
+
+/* Exported types ------------------------------------------------------------*/
+// Delta frame as sent over the UART, little endian, no padding before deltas[].
+// Bit (channel * STATS_FIELD_COUNT + field) of field_mask, counted from bit 0
+// of the first byte, is set for every statistic that changed. Each one follows as the zig-zag varint of its new
+// 16-bit code minus the previous one (modulo 2^16), lowest bit first.
+typedef struct {
+    uint8_t type;        // STATS_DELTA_FRAME_TYPE
+    uint8_t version;     // STATS_DELTA_FRAME_VERSION
+    uint16_t sequence;   // Shared with the keyframes
+    uint32_t timestamp;  // Scheduled time of the newest sample in ms
+    uint8_t field_mask[STATS_DELTA_MASK_BYTES];
+    uint8_t encoding;    // STATS_ENCODING_* of the codes
+#if SENSOR_OCCUPANCY
+    uint8_t occupancy;   // occupancy_fusion_byte when the frame was built
+#endif
+    uint8_t deltas[SENSOR_COUNT * STATS_FIELD_COUNT * STATS_DELTA_VARINT_MAX];
+} stats_delta_frame_t;
+
+WIRE_ASSERT_FIELD(stats_delta_frame_t, type, 0, 1);
+WIRE_ASSERT_FIELD(stats_delta_frame_t, version, 1, 1);
+WIRE_ASSERT_FIELD(stats_delta_frame_t, sequence, 2, 2);
+WIRE_ASSERT_FIELD(stats_delta_frame_t, timestamp, 4, 4);
+WIRE_ASSERT_FIELD(stats_delta_frame_t, field_mask, 8, STATS_DELTA_MASK_BYTES);
+WIRE_ASSERT_FIELD(stats_delta_frame_t, encoding, 8 + STATS_DELTA_MASK_BYTES, 1);
+#if SENSOR_OCCUPANCY
+WIRE_ASSERT_FIELD(stats_delta_frame_t, occupancy, 9 + STATS_DELTA_MASK_BYTES, 1);
+WIRE_ASSERT_FIELD(stats_delta_frame_t, deltas, 10 + STATS_DELTA_MASK_BYTES,
+                  SENSOR_COUNT * STATS_FIELD_COUNT * STATS_DELTA_VARINT_MAX);
+#else
+WIRE_ASSERT_FIELD(stats_delta_frame_t, deltas, 9 + STATS_DELTA_MASK_BYTES,
+                  SENSOR_COUNT * STATS_FIELD_COUNT * STATS_DELTA_VARINT_MAX);
+#endif
+
+// One report, either a keyframe or a delta frame
+typedef union {
+    uint8_t type;
+    stats_frame_t key;
+    stats_delta_frame_t delta;
+} stats_report_t;
+
+// What the receiver holds after the last report
+typedef struct {
+    uint16_t codes[SENSOR_COUNT][STATS_FIELD_COUNT];
+    float values[SENSOR_COUNT][STATS_FIELD_COUNT];
+    uint32_t reports_since_keyframe;
+    uint16_t channel_mask; // Channels of the last keyframe
+    uint16_t sequence;
+#if SENSOR_OCCUPANCY
+    uint8_t occupancy;     // Occupancy byte of the last report
+#endif
+} stats_delta_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Start over, the next report is a keyframe
+void stats_delta_reset(stats_delta_t *state);
+
+// Build the next report. Returns the number of bytes to send, or 0 when no
+// statistic moved beyond its deadband and nothing needs to be sent. With
+// SENSOR_OCCUPANCY a change of state, or of confidence by more than
+// OCCUPANCY_CONFIDENCE_DEADBAND, is sent as well. A receiver
+// that sees a sequence gap ignores delta frames until the next keyframe.
+// Only the channels in channel_mask are reported, keyframes included.
+uint16_t stats_delta_encode(stats_delta_t *state, stats_report_t *report, uint32_t timestamp,
+                            uint16_t channel_mask, const float values[SENSOR_COUNT][STATS_FIELD_COUNT]);
+
+// A report could not be queued: its sequence is skipped so the receiver sees
+// the gap, and the next report is a keyframe it can resume from
+void stats_delta_lost(stats_delta_t *state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STATS_DELTA_H */
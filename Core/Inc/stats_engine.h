@@ -0,0 +1,52 @@
+/**
+  ******************************************************************************
+  * @file    stats_engine.h
+  * @brief   C entry point of the templated statistics engine (stats_engine.hpp).
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STATS_ENGINE_H
+#define __STATS_ENGINE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "sample_ring.h"
+#include "stats_frame.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the batch statistics come from the stats::Stats instance of stats_engine.cpp
+#ifndef STATS_ENGINE
+#define STATS_ENGINE 0
+#endif
+// Statistics the engine computes, 0 compiles a feature out of the product.
+// The frames keep every field, a feature that is off reports 0.
+#ifndef STATS_FEATURE_STD_DEV
+#define STATS_FEATURE_STD_DEV 1
+#endif
+#ifndef STATS_FEATURE_MAX
+#define STATS_FEATURE_MAX 1
+#endif
+#ifndef STATS_FEATURE_MIN
+#define STATS_FEATURE_MIN 1
+#endif
+#ifndef STATS_FEATURE_MEDIAN
+#define STATS_FEATURE_MEDIAN 1
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Release the samples older than window_size from every ring and compute the
+// enabled statistics of each channel window. Returns the largest window.
+// Consumer task only.
+uint32_t stats_engine_update(sample_ring_t rings[SENSOR_COUNT], uint32_t window_size,
+                             float out[SENSOR_COUNT][STATS_FIELD_COUNT]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STATS_ENGINE_H */
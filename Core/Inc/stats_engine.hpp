@@ -0,0 +1,164 @@
+/**
+  ******************************************************************************
+  * @file    stats_engine.hpp
+  * @brief   Header-only statistics engine configured by template parameters.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STATS_ENGINE_HPP
+#define __STATS_ENGINE_HPP
+
+/* Includes ------------------------------------------------------------------*/
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include "sample_ring.h"
+#include "sensor_stats.h"
+#include "static_containers.hpp"
+#include "stats_frame.h"
+
+namespace stats {
+
+/* Features ------------------------------------------------------------------*/
+// Each feature names the frame field it fills
+struct StdDev { static constexpr stats_field_t field = STATS_FIELD_STD_DEV; };
+struct Max { static constexpr stats_field_t field = STATS_FIELD_MAX; };
+struct Min { static constexpr stats_field_t field = STATS_FIELD_MIN; };
+struct Median { static constexpr stats_field_t field = STATS_FIELD_MEDIAN; };
+
+// Feature when Enabled, nothing otherwise, for feature lists built from macros
+struct None {};
+template <bool Enabled, typename Feature>
+using Select = std::conditional_t<Enabled, Feature, None>;
+
+/* Engine --------------------------------------------------------------------*/
+// Statistics of Channels rings over windows of up to Window samples. Only
+// the listed features are computed: the fused pass keeps just the sums it
+// needs and the median scratch only exists with Median. The fields of
+// features that are not listed are left untouched in the output.
+template <std::size_t Channels, std::size_t Window, typename... Features>
+class Stats {
+public:
+    static_assert(Channels > 0 && Channels <= SENSOR_COUNT, "one engine channel per sensor_t");
+    static_assert(Window > 0 && Window <= STATS_WINDOW_CAPACITY, "Window beyond STATS_WINDOW_CAPACITY");
+
+    template <typename Feature>
+    static constexpr bool has = (std::is_same_v<Feature, Features> || ...);
+
+    // Release the samples older than window_size, clamped to Window, and
+    // fill the statistics of every channel. Returns the largest window.
+    std::uint32_t update(sample_ring_t (&rings)[Channels], std::uint32_t window_size,
+                         const float (&units)[Channels], float (&out)[Channels][STATS_FIELD_COUNT]) {
+        std::uint32_t largest = 0;
+
+        if (window_size > Window) {
+            window_size = Window;
+        }
+        for (std::size_t channel = 0; channel < Channels; ++channel) {
+            std::uint32_t count = channel_update(rings[channel], window_size, units[channel], out[channel]);
+            largest = count > largest ? count : largest;
+        }
+        return largest;
+    }
+
+private:
+    static constexpr bool fixed_point = std::is_same_v<sample_value_t, std::int16_t>;
+    using sum_t = std::conditional_t<fixed_point, std::int64_t, float>;
+
+    // Function to compute the statistics of one channel window
+    std::uint32_t channel_update(sample_ring_t &ring, std::uint32_t window_size, float unit, float *out) {
+        const sample_value_t *first, *second;
+        std::uint32_t first_count, second_count;
+
+        std::uint32_t count = sample_ring_count(&ring, SAMPLE_READER_STATS);
+        if (count > window_size) {
+            sample_ring_discard(&ring, SAMPLE_READER_STATS, count - window_size);
+            count = window_size;
+        }
+        if (count == 0) {
+            return 0;
+        }
+        sample_ring_span(&ring, SAMPLE_READER_STATS, 0, count, &first, &first_count, &second, &second_count);
+
+        if constexpr (has<StdDev> || has<Max> || has<Min>) {
+            Moments moments{};
+            // Float sums are taken relative to the first sample, like batch_stats_t
+            moments.shift = fixed_point ? sample_value_t{} : first[0];
+            moments.min = first[0];
+            moments.max = first[0];
+            accumulate(moments, first, first_count);
+            accumulate(moments, second, second_count);
+            if constexpr (has<StdDev>) {
+                out[STATS_FIELD_STD_DEV] = std_dev(moments, count) * unit;
+            }
+            if constexpr (has<Max>) {
+                out[STATS_FIELD_MAX] = static_cast<float>(moments.max) * unit;
+            }
+            if constexpr (has<Min>) {
+                out[STATS_FIELD_MIN] = static_cast<float>(moments.min) * unit;
+            }
+        }
+        if constexpr (has<Median>) {
+            // count is at most Window, both parts always fit
+            scratch_.clear();
+            scratch_.append(first, first_count);
+            scratch_.append(second, second_count);
+            if constexpr (fixed_point) {
+                out[STATS_FIELD_MEDIAN] = calculate_median_q15(scratch_.data(), count) * unit;
+            } else {
+                out[STATS_FIELD_MEDIAN] = calculate_median(scratch_.data(), count) * unit;
+            }
+        }
+        return count;
+    }
+
+    struct Moments {
+        sample_value_t shift;
+        sum_t sum;
+        sum_t sum_sq;
+        sample_value_t min;
+        sample_value_t max;
+    };
+
+    // Function to run the fused pass over one part of the window, with only
+    // the accumulators the features read
+    static void accumulate(Moments &moments, const sample_value_t *values, std::uint32_t count) {
+        for (std::uint32_t i = 0; i < count; ++i) {
+            sample_value_t value = values[i];
+            if constexpr (has<StdDev>) {
+                sum_t shifted = static_cast<sum_t>(value) - static_cast<sum_t>(moments.shift);
+                moments.sum += shifted;
+                moments.sum_sq += shifted * shifted;
+            }
+            if constexpr (has<Max>) {
+                moments.max = value > moments.max ? value : moments.max;
+            }
+            if constexpr (has<Min>) {
+                moments.min = value < moments.min ? value : moments.min;
+            }
+        }
+    }
+
+    // Function to turn the sums into the population standard deviation
+    static float std_dev(const Moments &moments, std::uint32_t count) {
+        if constexpr (fixed_point) {
+            // n^2 variance is exact in 64 bits, so is every step before the root
+            std::int64_t n = count;
+            std::int64_t scaled = n * moments.sum_sq - moments.sum * moments.sum;
+            return scaled > 0 ? std::sqrt(static_cast<float>(scaled)) / static_cast<float>(n) : 0.0f;
+        } else {
+            float mean = moments.sum / static_cast<float>(count);
+            float variance = moments.sum_sq / static_cast<float>(count) - mean * mean;
+            return variance > 0.0f ? std::sqrt(variance) : 0.0f;
+        }
+    }
+
+    // The median selection reorders its input, it works on a copy
+    struct NoScratch {};
+    std::conditional_t<has<Median>, fixed::StaticVector<sample_value_t, Window>, NoScratch> scratch_;
+};
+
+} // namespace stats
+
+#endif /* __STATS_ENGINE_HPP */
@@ -0,0 +1,162 @@
+/**
+  ******************************************************************************
+  * @file    stats_frame.h
+  * @brief   Compact versioned frame for the window statistics.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STATS_FRAME_H
+#define __STATS_FRAME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "occupancy_fusion.h"
+#include "sensor_data.h"
+#include "sensor_stats.h"
+#include "wire_format.h"
+
+/* Exported constants --------------------------------------------------------*/
+// First byte of a statistics frame
+#define STATS_FRAME_TYPE 0xA0
+// Bumped whenever the layout or the meaning of a field changes. Version 3
+// has the occupancy byte of SENSOR_OCCUPANCY after field_count.
+#if SENSOR_OCCUPANCY
+#define STATS_FRAME_VERSION 3
+#else
+#define STATS_FRAME_VERSION 2
+#endif
+
+// Encodings of the statistic values
+#define STATS_ENCODING_FLOAT16 0 // IEEE 754 half precision, saturated at 65504
+#define STATS_ENCODING_FIXED16 1 // int16 in units of the channel scale below
+#ifndef STATS_FRAME_ENCODING
+#define STATS_FRAME_ENCODING STATS_ENCODING_FLOAT16
+#endif
+
+// FIXED16 units of the current sensors, see sensor_registry. The sensors
+// deliver 16-bit words, a unit of 2 covers the full word range in an int16.
+#define STATS_FIXED_SCALE_PIR 2.0f
+#define STATS_FIXED_SCALE_HUMIDITY_AND_HEAT 2.0f
+#define STATS_FIXED_SCALE_LDR 2.0f
+#define STATS_FIXED_SCALE_HEAT 2.0f
+
+// 1: every channel also carries two quantiles of the samples since the
+// previous report, estimated with P-square as they are published
+#ifndef STATS_QUANTILES
+#define STATS_QUANTILES 0
+#endif
+#ifndef STATS_QUANTILE_UPPER_P
+#define STATS_QUANTILE_UPPER_P 0.90f
+#endif
+#ifndef STATS_QUANTILE_TAIL_P
+#define STATS_QUANTILE_TAIL_P 0.99f
+#endif
+// 1: every channel also carries its newest smoothed value, see trend_filter.h
+#ifndef STATS_TREND
+#define STATS_TREND 0
+#endif
+// 1: every channel also keeps shorter windows over the newest samples of its
+// window, one per length in STATS_VIEW_WINDOWS, each view sent in its own frame
+#ifndef STATS_VIEWS
+#define STATS_VIEWS 0
+#endif
+// Lengths of the views in samples, comma separated, shorter than the window
+#ifndef STATS_VIEW_WINDOWS
+#define STATS_VIEW_WINDOWS 40
+#endif
+// First byte of a view frame
+#define STATS_VIEW_FRAME_TYPE 0xBA
+
+/* Exported types ------------------------------------------------------------*/
+// Statistics sent per channel, in frame order
+typedef enum {
+    STATS_FIELD_STD_DEV,
+    STATS_FIELD_MAX,
+    STATS_FIELD_MIN,
+    STATS_FIELD_MEDIAN,
+#if STATS_TIME_WEIGHTED
+    STATS_FIELD_TIME_MEAN,      // Mean of the window, each sample weighted by its hold time
+    STATS_FIELD_TIME_STD_DEV,   // Standard deviation with the same weights
+#endif
+#if STATS_QUANTILES
+    STATS_FIELD_QUANTILE_UPPER, // STATS_QUANTILE_UPPER_P quantile of the last report interval
+    STATS_FIELD_QUANTILE_TAIL,  // STATS_QUANTILE_TAIL_P quantile of the last report interval
+#endif
+#if STATS_TREND
+    STATS_FIELD_TREND,          // Output of the trend filter after the newest sample
+#endif
+    STATS_FIELD_COUNT
+} stats_field_t;
+
+// Frame as sent over the UART, little endian, no padding before values[].
+// Only the channels set in channel_mask are present, lowest channel first,
+// each with field_count values, so the frame is 12 + 2 x field_count bytes per
+// channel long, 14 + with SENSOR_OCCUPANCY.
+typedef struct {
+    uint8_t type;          // STATS_FRAME_TYPE
+    uint8_t version;       // STATS_FRAME_VERSION
+    uint16_t sequence;     // Incremented per frame, gaps are lost frames
+    uint32_t timestamp;    // Scheduled time of the newest sample in ms
+    uint16_t channel_mask; // Bit n set: channel n (sensor_t) is present
+    uint8_t encoding;      // STATS_ENCODING_* of every value
+    uint8_t field_count;   // STATS_FIELD_COUNT
+#if SENSOR_OCCUPANCY
+    uint8_t occupancy;     // occupancy_fusion_byte when the frame was built
+    uint8_t reserved;
+#endif
+    uint16_t values[SENSOR_COUNT * STATS_FIELD_COUNT];
+} stats_frame_t;
+
+WIRE_ASSERT_FIELD(stats_frame_t, type, 0, 1);
+WIRE_ASSERT_FIELD(stats_frame_t, version, 1, 1);
+WIRE_ASSERT_FIELD(stats_frame_t, sequence, 2, 2);
+WIRE_ASSERT_FIELD(stats_frame_t, timestamp, 4, 4);
+WIRE_ASSERT_FIELD(stats_frame_t, channel_mask, 8, 2);
+WIRE_ASSERT_FIELD(stats_frame_t, encoding, 10, 1);
+WIRE_ASSERT_FIELD(stats_frame_t, field_count, 11, 1);
+#if SENSOR_OCCUPANCY
+WIRE_ASSERT_FIELD(stats_frame_t, occupancy, 12, 1);
+WIRE_ASSERT_FIELD(stats_frame_t, reserved, 13, 1);
+WIRE_ASSERT_FIELD(stats_frame_t, values, 14, 2 * SENSOR_COUNT * STATS_FIELD_COUNT);
+#else
+WIRE_ASSERT_FIELD(stats_frame_t, values, 12, 2 * SENSOR_COUNT * STATS_FIELD_COUNT);
+#endif
+
+// The statistics of one view, the same fields as the window's, over the
+// newest samples only. Only the channels in the channel_mask of stats are
+// present, so the frame is 4 bytes longer than its stats frame.
+typedef struct {
+    uint8_t type;        // STATS_VIEW_FRAME_TYPE
+    uint8_t view;        // Position of its length in STATS_VIEW_WINDOWS
+    uint16_t window;     // Length of the view in samples, at most the window
+    stats_frame_t stats; // As stats_frame_encode fills it, sequenced per view
+} stats_view_frame_t;
+
+WIRE_ASSERT_FIELD(stats_view_frame_t, type, 0, 1);
+WIRE_ASSERT_FIELD(stats_view_frame_t, view, 1, 1);
+WIRE_ASSERT_FIELD(stats_view_frame_t, window, 2, 2);
+WIRE_ASSERT_FIELD(stats_view_frame_t, stats, 4, sizeof(stats_frame_t));
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Fill a frame with the statistics of the channels in channel_mask.
+// Returns the number of bytes to send.
+uint16_t stats_frame_encode(stats_frame_t *frame, uint16_t sequence, uint32_t timestamp,
+                            uint16_t channel_mask, const float values[SENSOR_COUNT][STATS_FIELD_COUNT]);
+
+// Encode one value of a channel with STATS_FRAME_ENCODING
+uint16_t stats_frame_quantize(sensor_t channel, float value);
+
+// IEEE 754 half precision of value, rounded to nearest even.
+// Values beyond the half range saturate to the largest finite half.
+uint16_t stats_frame_float_to_half(float value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STATS_FRAME_H */
@@ -0,0 +1,162 @@
+/**
+  ******************************************************************************
+  * @file    stats_rollup.h
+  * @brief   Mergeable summaries of every channel per second, minute and hour.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STATS_ROLLUP_H
+#define __STATS_ROLLUP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_data.h"
+#include "wire_format.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the producer folds every stored sample into per-second summaries, the
+// seconds into minutes and the minutes into hours, and the consumer sends
+// and logs each closed minute and hour
+#ifndef STATS_ROLLUP
+#define STATS_ROLLUP 0
+#endif
+// Levels of the pyramid, level 0 lasts ROLLUP_BASE_PERIOD_MS and every next
+// one ROLLUP_FOLD periods of the level below
+#define ROLLUP_LEVELS 3
+#define ROLLUP_BASE_PERIOD_MS 1000U
+#define ROLLUP_FOLD 60U
+// Closed summaries kept in RAM per channel and level, 52 bytes each
+#ifndef ROLLUP_DEPTH_SECONDS
+#define ROLLUP_DEPTH_SECONDS 10
+#endif
+#ifndef ROLLUP_DEPTH_MINUTES
+#define ROLLUP_DEPTH_MINUTES 15
+#endif
+#ifndef ROLLUP_DEPTH_HOURS
+#define ROLLUP_DEPTH_HOURS 24
+#endif
+// Lowest level that is sent and logged as it closes, the seconds stay in RAM
+#ifndef ROLLUP_REPORT_LEVEL
+#define ROLLUP_REPORT_LEVEL 1
+#endif
+// Equal slices of the int16 code range in the quantile sketch
+#define ROLLUP_SKETCH_BINS 16U
+#define ROLLUP_SKETCH_SHIFT 12U
+// First byte of a rollup frame
+#define ROLLUP_FRAME_TYPE 0xB1
+#define ROLLUP_FRAME_VERSION 1
+// First byte of the answer to a query command
+#define ROLLUP_QUERY_FRAME_TYPE 0xB2
+#define ROLLUP_QUERY_FRAME_VERSION 1
+// Longest a closed summary takes to reach the log, one report after its
+// period ends. A query reads this much past its range, and from this much
+// before it for the samples stamped with the start of their batch.
+#ifndef ROLLUP_QUERY_LAG_MS
+#define ROLLUP_QUERY_LAG_MS 60000U
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+// Summary of one channel over one period, in sensor_to_fixed codes. Two
+// summaries merge into the summary of both periods.
+typedef struct {
+    uint32_t count; // Samples, 0 for a period without any
+    float mean;     // Mean code
+    float m2;       // Sum of squared deviations from the mean, variance is m2 / count
+    int16_t min;
+    int16_t max;
+    // Weights of the codes per slice of 4096 codes, lowest first. All of them
+    // are halved together when one would overflow, so they stay in proportion
+    // and a quantile is found by interpolating within its slice.
+    uint16_t sketch[ROLLUP_SKETCH_BINS];
+} rollup_summary_t;
+
+WIRE_ASSERT_FIELD(rollup_summary_t, count, 0, 4);
+WIRE_ASSERT_FIELD(rollup_summary_t, mean, 4, 4);
+WIRE_ASSERT_FIELD(rollup_summary_t, m2, 8, 4);
+WIRE_ASSERT_FIELD(rollup_summary_t, min, 12, 2);
+WIRE_ASSERT_FIELD(rollup_summary_t, max, 14, 2);
+WIRE_ASSERT_FIELD(rollup_summary_t, sketch, 16, 2 * ROLLUP_SKETCH_BINS);
+
+// Rollup frame as sent over the UART, little endian, no padding
+typedef struct {
+    uint8_t type;      // ROLLUP_FRAME_TYPE
+    uint8_t version;   // ROLLUP_FRAME_VERSION
+    uint8_t channel;   // sensor_t
+    uint8_t level;     // 0 second, 1 minute, 2 hour
+    uint32_t start_ms; // Start of the period on the sample time base
+    rollup_summary_t summary;
+} rollup_frame_t;
+
+WIRE_ASSERT_FIELD(rollup_frame_t, type, 0, 1);
+WIRE_ASSERT_FIELD(rollup_frame_t, version, 1, 1);
+WIRE_ASSERT_FIELD(rollup_frame_t, channel, 2, 1);
+WIRE_ASSERT_FIELD(rollup_frame_t, level, 3, 1);
+WIRE_ASSERT_FIELD(rollup_frame_t, start_ms, 4, 4);
+WIRE_ASSERT_FIELD(rollup_frame_t, summary, 8, sizeof(rollup_summary_t));
+
+// Payload of a FLASH_LOG_RECORD_ROLLUP record. The record is stamped with
+// the time it was logged, rounded down to whole seconds after the start of
+// the period, so the log stays in time order for flash_log_seek.
+typedef struct {
+    uint8_t channel; // sensor_t
+    uint8_t level;
+    uint16_t age_s;  // The period starts this many seconds before the record timestamp
+    rollup_summary_t summary;
+} rollup_record_t;
+
+// Answer to a query, little endian, no padding
+typedef struct {
+    uint8_t type;      // ROLLUP_QUERY_FRAME_TYPE
+    uint8_t version;   // ROLLUP_QUERY_FRAME_VERSION
+    uint8_t channel;   // sensor_t
+    uint8_t records;   // Summaries merged, saturated at 255, 0 when none was in the range
+    uint32_t first_ms; // Start of the earliest period merged
+    uint32_t end_ms;   // End of the latest period merged
+    rollup_summary_t summary;
+} rollup_query_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Clear every level, before the sampling timer starts
+void stats_rollup_init(void);
+
+// Create the query task, with FLASH_LOG. It sleeps until a query arrives.
+void stats_rollup_start(void);
+
+// Fold one stored sample into the open second of its channel. A sample in
+// a later period closes the open one, and the periods above it when their
+// own period ends too. Producer task only.
+void stats_rollup_sample(sensor_t channel, int16_t code, uint32_t timestamp);
+
+// Send and log the summaries closed since the last call from
+// ROLLUP_REPORT_LEVEL up, stamped with now, then as much of a requested
+// dump as the transmit queue takes. Consumer task only.
+void stats_rollup_report(bool log, uint32_t now);
+
+// Ask the consumer to send every summary of a level held in RAM, each
+// channel oldest first, from its next report on. False for a bad level.
+bool stats_rollup_dump(uint32_t level);
+
+// Ask the query task for the summary of a channel from from_ms to to_ms,
+// merged from the logged summaries whose periods lie within the range: the
+// hours it covers whole and the ROLLUP_REPORT_LEVEL summaries of its edges.
+// A new query replaces one that runs. False without FLASH_LOG or for a bad
+// channel or range.
+bool stats_rollup_query(uint32_t channel, uint32_t from_ms, uint32_t to_ms);
+
+// Summary kernels, O(1) per sample and per merge, in rollup_summary.c, which
+// the host build links as well
+void rollup_summary_reset(rollup_summary_t *summary);
+void rollup_summary_add(rollup_summary_t *summary, int16_t code);
+void rollup_summary_merge(rollup_summary_t *summary, const rollup_summary_t *other);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STATS_ROLLUP_H */
@@ -0,0 +1,50 @@
+/**
+  ******************************************************************************
+  * @file    stats_snapshot.h
+  * @brief   Latest statistics of every channel, readable from any context.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STATS_SNAPSHOT_H
+#define __STATS_SNAPSHOT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_data.h"
+#include "stats_frame.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the consumer publishes the statistics of every report, and a "stats"
+// command answers with the latest of them at once
+#ifndef STATS_SNAPSHOT
+#define STATS_SNAPSHOT 0
+#endif
+// First byte of the answer to a "stats" command, a stats_frame_t otherwise
+#define STATS_SNAPSHOT_FRAME_TYPE 0xB3
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    uint32_t sequence;  // Reports published since boot, the first is 1
+    uint32_t timestamp; // Scheduled time of the newest sample of the report in ms
+    float stats[SENSOR_COUNT][STATS_FIELD_COUNT];
+} stats_snapshot_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Publish the statistics of a report. Consumer task only.
+void stats_snapshot_publish(const float stats[SENSOR_COUNT][STATS_FIELD_COUNT], uint32_t timestamp);
+
+// Copy the latest statistics, from a task or an interrupt. Never blocks and
+// never waits for the consumer. False until the first report.
+bool stats_snapshot_read(stats_snapshot_t *snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STATS_SNAPSHOT_H */
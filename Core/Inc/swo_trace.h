@@ -0,0 +1,72 @@
+/**
+  ******************************************************************************
+  * @file    swo_trace.h
+  * @brief   ITM stimulus ports over SWO for debug output and timing markers.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SWO_TRACE_H
+#define __SWO_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: route _write, so printf, to the ITM and send markers over SWO (PB3).
+// USART2 stays for the data link.
+#ifndef SWO_TRACE
+#define SWO_TRACE 0
+#endif
+// NRZ bit rate of SWO when no probe set it up, a divider of the core clock
+#ifndef SWO_TRACE_BAUD
+#define SWO_TRACE_BAUD 2000000
+#endif
+// ITM stimulus ports: text of _write, 32-bit markers. KERNEL_TRACE_ITM_PORT
+// (1) carries kernel trace dumps.
+#define SWO_TRACE_LOG_PORT 0
+#define SWO_TRACE_MARKER_PORT 2
+// Marker word: the id in the low 16 bits, the edge in the top bits
+#define SWO_TRACE_POINT 0x00000000U
+#define SWO_TRACE_BEGIN 0x40000000U
+#define SWO_TRACE_END 0x80000000U
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    SWO_MARKER_TICK = 1,  // producer_task, from the tick to the last sample stored
+    SWO_MARKER_COMPUTE,   // consumer_task, statistics of a batch
+    SWO_MARKER_BROADCAST  // consumer_task, serialization of the reports
+} swo_marker_t;
+
+/* Exported variables --------------------------------------------------------*/
+// Markers dropped on a full ITM FIFO
+extern volatile uint32_t swo_trace_marker_drops;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Set up SWO and the stimulus ports unless a probe did, after SystemClock_Config
+void swo_trace_init(void);
+
+/* Exported functions --------------------------------------------------------*/
+// Mark a point in time, SWO_TRACE_BEGIN, SWO_TRACE_END or SWO_TRACE_POINT with
+// an id. One store, or nothing while the port is off. A full FIFO drops the
+// marker rather than wait, the timing of the code stays the same. Any context.
+static inline void swo_trace_marker(uint32_t edge, uint32_t id) {
+    if ((ITM->TCR & ITM_TCR_ITMENA_Msk) == 0 || (ITM->TER & (1UL << SWO_TRACE_MARKER_PORT)) == 0) {
+        return;
+    }
+    if (ITM->PORT[SWO_TRACE_MARKER_PORT].u32 == 0UL) {
+        swo_trace_marker_drops++;
+        return;
+    }
+    ITM->PORT[SWO_TRACE_MARKER_PORT].u32 = edge | (id & 0xFFFFU);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SWO_TRACE_H */
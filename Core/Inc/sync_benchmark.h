@@ -0,0 +1,43 @@
+/**
+  ******************************************************************************
+  * @file    sync_benchmark.h
+  * @brief   On-target cycle benchmark of the kernel and core synchronization primitives.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SYNC_BENCHMARK_H
+#define __SYNC_BENCHMARK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: time every way the pipeline could hand data between tasks once at boot
+// and report it over USART2
+#ifndef SYNC_BENCHMARK
+#define SYNC_BENCHMARK 0
+#endif
+// Timed runs per case
+#ifndef SYNC_BENCHMARK_RUNS
+#define SYNC_BENCHMARK_RUNS 64
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Create the benchmark task and its partner. They run once after the
+// scheduler starts, above the processing stage, report one CSV line per case
+// over USART2 and then delete themselves: primitive,contention,min,avg,max
+// (core cycles). An uncontended case is one acquire and release, or send and
+// receive, by one task. A ping_pong case is a round trip to the partner task
+// above it and back: two handoffs and two context switches.
+void sync_benchmark_start(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SYNC_BENCHMARK_H */
@@ -0,0 +1,68 @@
+/**
+  ******************************************************************************
+  * @file    task_signal.h
+  * @brief   Event bits on FreeRTOS direct-to-task notifications.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TASK_SIGNAL_H
+#define __TASK_SIGNAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include "cmsis_os.h"
+
+/* Exported constants --------------------------------------------------------*/
+// One bit per wake-up source, so several sources can share a task
+#define TASK_SIGNAL_SAMPLE_TICK  (1UL << 0) // TIM3 sampling tick, producer
+#define TASK_SIGNAL_I2C_DONE     (1UL << 1) // I2C list finished, task running it
+#define TASK_SIGNAL_BATCH_READY  (1UL << 2) // New batch in the ring, consumer
+#define TASK_SIGNAL_REPLAY       (1UL << 3) // Replay requested, flash log task
+#define TASK_SIGNAL_TRACE_DUMP   (1UL << 4) // Dump requested, kernel trace task
+#define TASK_SIGNAL_SIM_REPLAY   (1UL << 5) // Replay source selected, sensor simulation task
+#define TASK_SIGNAL_ROLLUP_QUERY (1UL << 6) // Query requested, rollup query task
+#define TASK_SIGNAL_PROFILE_DUMP (1UL << 7) // Dump requested, PC profiler task
+#define TASK_SIGNAL_I2C_GRANT    (1UL << 8) // Buses handed over by the I2C arbiter, any requester
+#define TASK_SIGNAL_WINDOW_DUMP  (1UL << 9) // Window captured, window dump task
+#define TASK_SIGNAL_SENSOR_READY (1UL << 10) // Data-ready line rose, producer
+#define TASK_SIGNAL_DMA_COPY     (1UL << 11) // Copy queue done, task waiting on it
+#define TASK_SIGNAL_OCCUPANCY    (1UL << 12) // Occupancy state changed, consumer
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Block the calling task until one of bits is signalled or the timeout expires.
+// Returns the signalled bits among bits and clears them, bits of other
+// sources stay pending for their own wait. Returns 0 on timeout.
+uint32_t task_signal_wait(uint32_t bits, TickType_t timeout);
+
+// The setters run once per sample from the TIM3 and I2C interrupts, so they
+// are inlined straight onto the native notification calls. osSignalSet does
+// the same through a call, the inHandlerMode() check and the previous value,
+// SYNC_BENCHMARK times both.
+
+// Set bits on a task from task context, a NULL task is ignored
+static inline void task_signal_set(TaskHandle_t task, uint32_t bits) {
+    if (task != NULL) {
+        (void)xTaskNotify(task, bits, eSetBits);
+    }
+}
+
+// Set bits on a task from an interrupt and yield if it should run next
+static inline void task_signal_set_from_isr(TaskHandle_t task, uint32_t bits) {
+    BaseType_t higher_priority_task_woken = pdFALSE;
+
+    if (task != NULL) {
+        (void)xTaskNotifyFromISR(task, bits, eSetBits, &higher_priority_task_woken);
+    }
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TASK_SIGNAL_H */
@@ -0,0 +1,56 @@
+/**
+  ******************************************************************************
+  * @file    task_telemetry.h
+  * @brief   Per-task CPU load, stack and context switch telemetry frame.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TASK_TELEMETRY_H
+#define __TASK_TELEMETRY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Exported constants --------------------------------------------------------*/
+// First byte of a task telemetry frame
+#define TASK_TELEMETRY_FRAME_TYPE 0xA2
+// Tasks reported per frame, keeps the frame within UART_TX_FRAME_MAX.
+// uxTaskGetSystemState reports nothing when more tasks exist than this.
+#define TASK_TELEMETRY_MAX_TASKS 7
+
+/* Exported types ------------------------------------------------------------*/
+// One task over the last interval, little endian, no padding
+typedef struct {
+    uint8_t task_number;       // FreeRTOS task number, follows creation order
+    uint8_t priority;
+    uint16_t cpu_permille;     // Share of the interval the task was running
+    uint16_t stack_free_words; // Stack high water mark since the task started
+    uint16_t switches;         // Times the task was switched in, saturated
+} task_telemetry_entry_t;
+
+typedef struct {
+    uint8_t type;              // TASK_TELEMETRY_FRAME_TYPE
+    uint8_t task_count;
+    uint16_t reserved;
+    uint32_t interval_us;      // Length of the interval on the run-time counter
+    task_telemetry_entry_t tasks[TASK_TELEMETRY_MAX_TASKS];
+} task_telemetry_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Fill a frame with the load of every task since the previous call.
+// Returns the number of bytes to send, only the used entries are included.
+uint16_t task_telemetry_build(task_telemetry_frame_t *frame);
+
+// Scheduler hook, called through traceTASK_SWITCHED_IN with the new TCB
+void task_telemetry_switched_in(void *task);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TASK_TELEMETRY_H */
@@ -0,0 +1,51 @@
+/**
+  ******************************************************************************
+  * @file    throughput_bench.h
+  * @brief   Throughput stress benchmark of the whole pipeline on simulated sensors.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __THROUGHPUT_BENCH_H
+#define __THROUGHPUT_BENCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "sample_ring.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: ramp the sampling rate of every window size until the pipeline drops
+// samples or frames or misses ticks. Set by the secondtry_bench.elf target,
+// which also sets SENSOR_SIMULATION and DEADLINE_MONITOR.
+#ifndef THROUGHPUT_BENCH
+#define THROUGHPUT_BENCH 0
+#endif
+// Time a new setting runs before it is measured, the backlog of the previous one drains
+#ifndef THROUGHPUT_BENCH_SETTLE_MS
+#define THROUGHPUT_BENCH_SETTLE_MS 500
+#endif
+// Time a setting is measured
+#ifndef THROUGHPUT_BENCH_DWELL_MS
+#define THROUGHPUT_BENCH_DWELL_MS 2000
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Create the benchmark task, before the scheduler starts. It takes over the
+// pipeline settings from the command channel, so no window, batch or period
+// command should be sent while it runs. For each window size it shortens
+// the sampling period step by step and reports one CSV line per step over
+// USART2: window,period_ms,rate_hz,ticks,missed,overruns,ring_drops,frame_drops,result.
+// The first failing step ends the ramp and a max,window,period_ms,rate_hz
+// line gives the fastest one that passed, 0 when none did. Then the
+// settings go back to where they were and the task deletes itself.
+void throughput_bench_start(const sample_ring_t *rings);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __THROUGHPUT_BENCH_H */
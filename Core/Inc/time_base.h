@@ -0,0 +1,60 @@
+/**
+  ******************************************************************************
+  * @file    time_base.h
+  * @brief   Microsecond time base on the 32-bit TIM2 counter, epoch mapping.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TIME_BASE_H
+#define __TIME_BASE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "main.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: TIM2 runs free at TIME_BASE_HZ from boot and its wraps are counted, so
+// stamps extend to 64 bits and map to epoch time after an "epoch" command
+#ifndef TIME_BASE
+#define TIME_BASE 0
+#endif
+#define TIME_BASE_HZ 1000000U
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Start TIM2 with its update interrupt, after MX_TIM2_Init
+void time_base_start(void);
+
+// Stamp in microseconds, a single load of the counter, any context. It wraps
+// every 71.6 minutes, time_base_extend turns it into a 64-bit time.
+static inline uint32_t time_base_stamp(void) {
+    return TIM2->CNT;
+}
+
+// 64-bit microseconds since time_base_start, any context
+uint64_t time_base_now(void);
+
+// 64-bit time of a stamp taken less than one wrap ago
+uint64_t time_base_extend(uint32_t stamp);
+
+// Map the local clock to the host clock: the host sent epoch_s seconds plus
+// epoch_us microseconds since 1970 and the message ended at stamp.
+// Later calls replace the mapping, the clock is not slewed.
+void time_base_sync(uint32_t epoch_s, uint32_t epoch_us, uint32_t stamp);
+
+// Epoch microseconds of a 64-bit local time, false before the first sync
+bool time_base_to_epoch(uint64_t local_us, uint64_t *epoch_us);
+
+// Called from HAL_TIM_PeriodElapsedCallback on the TIM2 update event
+void time_base_overflow_from_isr(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TIME_BASE_H */
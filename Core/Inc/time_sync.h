@@ -0,0 +1,98 @@
+/**
+  ******************************************************************************
+  * @file    time_sync.h
+  * @brief   Four-timestamp clock synchronization with the gateway, drift and slew.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TIME_SYNC_H
+#define __TIME_SYNC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "wire_format.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the "sync" and "delay" commands measure the offset of TIM2 to the
+// gateway clock, and once synchronized the sampling ticks are stamped with
+// the gateway time. Needs TIME_BASE.
+#ifndef TIME_SYNC
+#define TIME_SYNC 0
+#endif
+// Exchanges the clock filter keeps, the one with the shortest round trip of
+// them is the one the least queued on the link
+#ifndef TIME_SYNC_FILTER
+#define TIME_SYNC_FILTER 8
+#endif
+// An error above this steps the clock instead of slewing it
+#ifndef TIME_SYNC_STEP_US
+#define TIME_SYNC_STEP_US 100000
+#endif
+// Rate at which an error is slewed out, 1 ms takes 2 s
+#define TIME_SYNC_SLEW_PPM 500
+// Largest drift estimate, well above the tolerance of a crystal
+#define TIME_SYNC_DRIFT_MAX_PPB 200000
+// First byte of a sync frame
+#define TIME_SYNC_FRAME_TYPE 0xBD
+#define TIME_SYNC_FRAME_VERSION 1
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    TIME_SYNC_STATE_FREE,    // Never synchronized, the sample times count from boot
+    TIME_SYNC_STATE_STEPPED, // The last exchange used stepped the clock
+    TIME_SYNC_STATE_SLEWING, // The last exchange used is being slewed out
+} time_sync_state_t;
+
+// Sync frame, little endian, no padding. Sent in answer to "sync", the gateway
+// stamps its arrival and returns that time with "delay". Carries the result of
+// the exchanges so far.
+typedef struct {
+    uint8_t type;      // TIME_SYNC_FRAME_TYPE
+    uint8_t version;   // TIME_SYNC_FRAME_VERSION
+    uint16_t exchange; // Number the "delay" of this exchange echoes
+    uint8_t state;     // time_sync_state_t
+    uint8_t used;      // Exchanges the filter used, saturated
+    uint16_t rejected; // Exchanges the filter passed over for a shorter round trip
+    int32_t error_us;  // Offset of the last exchange used minus the clock, before its step or slew
+    uint32_t delay_us; // Round trip of that exchange without the turnaround of the node
+    int32_t drift_ppb; // Rate of the gateway clock over TIM2 minus one, in 1e-9
+    uint32_t sample_ms; // Sample time base now
+} time_sync_frame_t;
+
+WIRE_ASSERT_FIELD(time_sync_frame_t, type, 0, 1);
+WIRE_ASSERT_FIELD(time_sync_frame_t, version, 1, 1);
+WIRE_ASSERT_FIELD(time_sync_frame_t, exchange, 2, 2);
+WIRE_ASSERT_FIELD(time_sync_frame_t, state, 4, 1);
+WIRE_ASSERT_FIELD(time_sync_frame_t, used, 5, 1);
+WIRE_ASSERT_FIELD(time_sync_frame_t, rejected, 6, 2);
+WIRE_ASSERT_FIELD(time_sync_frame_t, error_us, 8, 4);
+WIRE_ASSERT_FIELD(time_sync_frame_t, delay_us, 12, 4);
+WIRE_ASSERT_FIELD(time_sync_frame_t, drift_ppb, 16, 4);
+WIRE_ASSERT_FIELD(time_sync_frame_t, sample_ms, 20, 4);
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Open an exchange: the gateway sent "sync" at epoch_us microseconds since
+// 1970 on its clock and the line ended at the local stamp. Sends the sync
+// frame, whose departure the gateway stamps. Command task only.
+void time_sync_request(uint64_t epoch_us, uint32_t stamp);
+
+// Close the exchange with the gateway time at which the sync frame arrived,
+// and feed it to the filter. False if exchange is not the open one.
+// Command task only.
+bool time_sync_complete(uint32_t exchange, uint64_t epoch_us);
+
+// Gateway time now, in milliseconds since 2000-01-01, wrapping like every
+// sample time. False before the first exchange. Any context.
+bool time_sync_now_ms(uint32_t *time_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TIME_SYNC_H */
@@ -0,0 +1,71 @@
+/**
+  ******************************************************************************
+  * @file    trend_filter.h
+  * @brief   Recursive smoothing of each channel, a few words of state per channel.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TREND_FILTER_H
+#define __TREND_FILTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_stats.h"
+#if STATS_USE_CMSIS_DSP
+#include "arm_math.h"
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+// Smoothers, chosen at build time through STATS_TREND_FILTER
+#define STATS_TREND_EMA 0     // First order, y += alpha (x - y)
+#define STATS_TREND_BIQUAD 1  // Second order Butterworth low pass
+#ifndef STATS_TREND_FILTER
+#define STATS_TREND_FILTER STATS_TREND_EMA
+#endif
+#if STATS_TREND_FILTER != STATS_TREND_EMA && STATS_TREND_FILTER != STATS_TREND_BIQUAD
+#error "STATS_TREND_FILTER must be STATS_TREND_EMA or STATS_TREND_BIQUAD"
+#endif
+// Time constant of the EMA in stored samples of the channel, alpha is its inverse
+#ifndef STATS_TREND_EMA_SAMPLES
+#define STATS_TREND_EMA_SAMPLES 16
+#endif
+// -3 dB cutoff of the biquad in cycles per stored sample, below 0.5
+#ifndef STATS_TREND_CUTOFF
+#define STATS_TREND_CUTOFF 0.02f
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    bool primed;          // State holds the signal level, not zeros
+#if STATS_TREND_FILTER == STATS_TREND_BIQUAD
+    float coeffs[5];      // b0, b1, b2, -a1, -a2 in the CMSIS-DSP order
+#if STATS_USE_CMSIS_DSP
+    arm_biquad_casd_df1_inst_f32 instance;
+    float state[4];       // x[n-1], x[n-2], y[n-1], y[n-2]
+#else
+    float x1, x2, y1, y2;
+#endif
+#endif
+    volatile float value; // Newest output, a single word the consumer reads
+} trend_filter_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Design the filter and clear the state
+void trend_filter_init(trend_filter_t *filter);
+
+// Add one sample and return the smoothed value, also left in filter->value.
+// The first sample fills the state, the output starts at the signal level
+// instead of rising from 0. O(1) per sample.
+float trend_filter_add(trend_filter_t *filter, float value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TREND_FILTER_H */
@@ -0,0 +1,98 @@
+/**
+  ******************************************************************************
+  * @file    trigger_engine.h
+  * @brief   Per-sample alarm rules that send an alert frame at once.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TRIGGER_ENGINE_H
+#define __TRIGGER_ENGINE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "sensor_data.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: every read is checked against the rules of trigger_rules, a rule that
+// is raised or cleared sends an alert frame from the producer task
+#ifndef TRIGGER_ENGINE
+#define TRIGGER_ENGINE 0
+#endif
+// First byte of an alert frame
+#define TRIGGER_FRAME_TYPE 0xAA
+#define TRIGGER_FRAME_VERSION 1
+// Rules of the current sensors, in sensor units, see sensor_registry.
+// PIR: motion, the value is 1 while the output is high.
+#ifndef TRIGGER_PIR_ABOVE
+#define TRIGGER_PIR_ABOVE 0.5f
+#endif
+// Humidity and heat: the raw word above which the room is too warm or damp
+#ifndef TRIGGER_HUMIDITY_AND_HEAT_ABOVE
+#define TRIGGER_HUMIDITY_AND_HEAT_ABOVE 60000.0f
+#endif
+#ifndef TRIGGER_HUMIDITY_AND_HEAT_HYSTERESIS
+#define TRIGGER_HUMIDITY_AND_HEAT_HYSTERESIS 1000.0f
+#endif
+// LDR: change per second of a light switched on or off
+#ifndef TRIGGER_LDR_RATE
+#define TRIGGER_LDR_RATE 8192.0f
+#endif
+#ifndef TRIGGER_LDR_RATE_HYSTERESIS
+#define TRIGGER_LDR_RATE_HYSTERESIS 4096.0f
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    TRIGGER_ABOVE,  // Raised above threshold, cleared below threshold - hysteresis
+    TRIGGER_BELOW,  // Raised below threshold, cleared above threshold + hysteresis
+    TRIGGER_RATE    // Raised when the change per second between two reads of
+                    // the channel exceeds threshold either way, cleared below
+                    // threshold - hysteresis
+} trigger_kind_t;
+
+typedef struct {
+    sensor_t channel;
+    trigger_kind_t kind;
+    float threshold;  // Sensor units, sensor units per second for TRIGGER_RATE
+    float hysteresis; // Keeps a value at the threshold from sending an alert per read
+} trigger_rule_t;
+
+// Alert frame as sent over the UART, little endian, no padding
+typedef struct {
+    uint8_t type;       // TRIGGER_FRAME_TYPE
+    uint8_t version;    // TRIGGER_FRAME_VERSION
+    uint8_t sequence;   // Incremented per alert, gaps are lost alerts
+    uint8_t rule;       // Index into trigger_rules
+    uint32_t timestamp; // Scheduled time of the read in ms
+    uint8_t channel;    // sensor_t of the rule
+    uint8_t raised;     // 1: the condition started, 0: it ended
+    uint16_t value;     // The read, in the STATS_FRAME_ENCODING code of the channel
+} trigger_frame_t;
+
+/* Exported variables --------------------------------------------------------*/
+extern const trigger_rule_t trigger_rules[];
+extern const uint32_t trigger_rule_count;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Clear the rule states, before the sampling timer starts
+void trigger_engine_init(void);
+
+// Check one read against the rules of its channel. A rule that changes state
+// is queued for trigger_engine_flush, a newer change replaces one that was
+// not sent yet. O(rules) per read, producer task only.
+void trigger_engine_sample(sensor_t channel, float value, uint32_t timestamp);
+
+// Send the queued alerts ahead of the next batch, as many as the transmit
+// queue takes. What does not fit is sent at the next call. Producer task only.
+void trigger_engine_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TRIGGER_ENGINE_H */
@@ -0,0 +1,89 @@
+/**
+  ******************************************************************************
+  * @file    tt_executive.h
+  * @brief   Time-triggered executive, a static table of slots run at every tick.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TT_EXECUTIVE_H
+#define __TT_EXECUTIVE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// 1: with ISR_PIPELINE, the deferred work of each tick is a minor frame of a
+// static schedule instead of the acquire and report stages. The slots of the
+// table in main.c run in their frames in table order, each timed against its
+// budget. The budgets are checked against the frame before the timer starts.
+#ifndef TT_EXECUTIVE
+#define TT_EXECUTIVE 0
+#endif
+// Share of the sampling period the slots of one frame may take together, the
+// rest is left to the ADC, USART2 and timer interrupts that preempt them
+#ifndef TT_EXECUTIVE_LOAD_PCT
+#define TT_EXECUTIVE_LOAD_PCT 70
+#endif
+#if TT_EXECUTIVE_LOAD_PCT < 1 || TT_EXECUTIVE_LOAD_PCT > 100
+#error "TT_EXECUTIVE_LOAD_PCT must be 1 to 100"
+#endif
+// Budgets of the slots of main.c in microseconds. Once the sampling sweep,
+// once a batch the window statistics, then the frames of the report.
+#ifndef TT_BUDGET_ACQUIRE_US
+#define TT_BUDGET_ACQUIRE_US 500
+#endif
+#ifndef TT_BUDGET_COMPUTE_US
+#define TT_BUDGET_COMPUTE_US 5000
+#endif
+#ifndef TT_BUDGET_TRANSMIT_US
+#define TT_BUDGET_TRANSMIT_US 1000
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+// Work of one slot, with the scheduled time of its frame in ms
+typedef void (*tt_slot_run_t)(uint32_t timestamp);
+
+// One entry of the schedule, due in the frames where frame % period == offset
+typedef struct {
+    const char *name;
+    tt_slot_run_t run;
+    uint16_t period;    // Frames between two runs, divides the major cycle
+    uint16_t offset;    // First frame it runs in, below period
+    uint32_t budget_us; // Longest run that is not an overrun
+} tt_slot_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Check a schedule without running it: every slot fits the major cycle of
+// major_frames and no frame holds more budget than load_pct of frame_us.
+// Returns the first frame that does not fit, or major_frames when all do.
+uint32_t tt_executive_check(const tt_slot_t *slots, uint32_t count, uint32_t major_frames, uint32_t frame_us,
+                            uint32_t load_pct);
+
+// Take the schedule, false when tt_executive_check rejects it. Before the
+// sampling timer starts; the table must outlive the executive.
+bool tt_executive_init(const tt_slot_t *slots, uint32_t count, uint32_t major_frames, uint32_t frame_us);
+
+// Run the slots of the frame of this tick, as the acquire stage of
+// isr_pipeline. Never completes a batch for the report stage, the report
+// is made of slots of its own.
+bool tt_executive_frame_from_isr(uint32_t timestamp);
+
+// Runs of a slot over its budget, and frames over their share of the
+// period or not run at all because the previous one still was, since boot
+uint32_t tt_executive_slot_overruns(uint32_t slot);
+uint32_t tt_executive_frame_overruns(void);
+
+// Longest run of a slot since boot in microseconds, to set its budget from
+uint32_t tt_executive_slot_worst_us(uint32_t slot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TT_EXECUTIVE_H */
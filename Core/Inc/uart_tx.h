@@ -0,0 +1,155 @@
+/**
+  ******************************************************************************
+  * @file    uart_tx.h
+  * @brief   Queued DMA transmit path for USART2 (BLE module link), and USART1
+  *          (wired bulk link) with BULK_LINK.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __UART_TX_H
+#define __UART_TX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include "isr_pipeline.h"
+#include "main.h"
+
+/* Exported constants --------------------------------------------------------*/
+// Line rate of USART2 toward the BLE module, 8N1. Above APB1 / 16 the USART
+// samples 8 times per bit instead of 16.
+#ifndef UART_BAUD_RATE
+#define UART_BAUD_RATE 115200
+#endif
+// 1: RTS/CTS hardware flow control on PD4/PD3. The module holds CTS high
+// while its buffer is full and the DMA waits instead of overrunning it.
+#ifndef UART_FLOW_CONTROL
+#define UART_FLOW_CONTROL 0
+#endif
+// Largest frame that can be queued, longer frames are rejected
+#ifndef UART_TX_FRAME_MAX
+#define UART_TX_FRAME_MAX 64
+#endif
+// Number of bursts that can wait for the DMA, must be a power of two
+#ifndef UART_TX_QUEUE_LENGTH
+#define UART_TX_QUEUE_LENGTH 4
+#endif
+// Largest burst of frames sent in one DMA transfer, one BLE ATT payload
+// with the 251-byte LE data length
+#ifndef UART_TX_BURST_MAX
+#define UART_TX_BURST_MAX 244
+#endif
+// Longest time a frame waits for more frames to join its burst, 0 sends
+// every frame on its own. The deadline is a software timer, ISR_PIPELINE
+// has no timer task to run it.
+#ifndef UART_TX_FLUSH_MS
+#if ISR_PIPELINE
+#define UART_TX_FLUSH_MS 0
+#else
+#define UART_TX_FLUSH_MS 20
+#endif
+#endif
+// 1: every frame goes out as COBS(frame + CRC-32) followed by a 0x00 delimiter,
+// the CRC is the little-endian crc_unit_calculate of the frame
+#ifndef UART_FRAMING
+#define UART_FRAMING 1
+#endif
+// 1: a second, wired link on USART1 (PA9 TX) with a queue of its own, for the
+// bulk traffic link_route.h sends there. BLE keeps the live data.
+#ifndef BULK_LINK
+#define BULK_LINK 0
+#endif
+// Line rate of USART1, 8N1. APB2 stays at 84 MHz whatever the clock governor
+// does, 8 samples per bit reach 10.5 Mbaud and 3 Mbaud divides it exactly.
+#ifndef BULK_LINK_BAUD_RATE
+#define BULK_LINK_BAUD_RATE 3000000
+#endif
+// Bursts of the bulk link that can wait for the DMA, must be a power of two
+#ifndef BULK_LINK_QUEUE_LENGTH
+#define BULK_LINK_QUEUE_LENGTH 4
+#endif
+// Largest burst of the bulk link, frames stay within UART_TX_FRAME_MAX. No
+// MTU on a wire, a larger burst costs RAM and saves DMA restarts.
+#ifndef BULK_LINK_BURST_MAX
+#define BULK_LINK_BURST_MAX 1024
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+// Links with a queue of their own
+typedef enum {
+    UART_LINK_BLE = 0, // USART2, the BLE module
+#if BULK_LINK
+    UART_LINK_BULK,    // USART1, the wired link
+#endif
+    UART_LINK_COUNT
+} uart_link_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Reset the queue and create the flush timer, must run before the first uart_tx_send
+void uart_tx_init(void);
+
+// Copy a frame into the open burst. The burst goes to the DMA when it is
+// full or UART_TX_FLUSH_MS after its first frame, whichever comes first.
+// Frames are sized before framing, the framing bytes do not count.
+// Never blocks: when the queue is full the new frame is dropped and
+// counted, so a slow link cannot stall the caller. Task context only.
+bool uart_tx_send(const uint8_t *data, uint16_t size);
+
+// Same as uart_tx_send, but waits a tick at a time for a free burst instead
+// of dropping the frame. For reports that must not lose a line, such as the
+// benchmarks, never for the pipeline tasks.
+bool uart_tx_send_blocking(const uint8_t *data, uint16_t size);
+
+// Same as uart_tx_send on the queue of a given link
+bool uart_tx_link_send(uart_link_t link, const uint8_t *data, uint16_t size);
+
+// Same as uart_tx_send for a frame derived from a sample published at
+// origin_cycles, its completion also feeds the end-to-end latency
+bool uart_tx_send_traced(const uint8_t *data, uint16_t size, uint32_t origin_cycles);
+
+// Reserve room for a frame of up to max_size bytes in the open BLE burst and
+// return where to write it, word aligned. NULL when the queue is full or
+// max_size too large, the frame then counts as dropped. Until the commit the
+// caller holds the transmit critical section: serialize the frame and
+// nothing else, no kernel call, no wait. Task context only.
+uint8_t *uart_tx_reserve(uint16_t max_size);
+
+// Queue the first size bytes written at the reservation, size 0 queues
+// nothing. Exactly one commit follows every reservation that succeeded.
+void uart_tx_commit(uint16_t size);
+
+// Same as uart_tx_commit for a frame derived from a sample published at
+// origin_cycles
+void uart_tx_commit_traced(uint16_t size, uint32_t origin_cycles);
+
+// Send the open burst now instead of at its deadline
+void uart_tx_flush(void);
+void uart_tx_link_flush(uart_link_t link);
+
+// Number of bursts that can still be opened, a frame is never dropped while
+// this is not 0. uart_tx_send, uart_tx_flush and uart_tx_free are the BLE link.
+uint32_t uart_tx_free(void);
+uint32_t uart_tx_link_free(uart_link_t link);
+
+// Called from HAL_UART_ErrorCallback, drops the burst the DMA was sending on
+// the USART of huart. Not for USART2 with LL_FAST_PATH, the HAL does not know
+// about the transfer.
+void uart_tx_error_from_isr(UART_HandleTypeDef *huart);
+
+// Called from DMA1_Stream6_IRQHandler with LL_FAST_PATH, in place of the HAL
+// handler: ends the burst and starts the next one
+void uart_tx_dma_from_isr(void);
+
+// Number of frames rejected because the queue was full or the frame too long
+uint32_t uart_tx_dropped(void);
+uint32_t uart_tx_link_dropped(uart_link_t link);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UART_TX_H */
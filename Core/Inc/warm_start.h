@@ -0,0 +1,50 @@
+/**
+  ******************************************************************************
+  * @file    warm_start.h
+  * @brief   Checkpoint of the statistics windows in backup SRAM, restored at boot.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __WARM_START_H
+#define __WARM_START_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "sample_ring.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the consumer copies the window of every channel to the 4 KB backup SRAM
+// and the next boot starts from it, the first report goes out at once
+#ifndef WARM_START
+#define WARM_START 0
+#endif
+// Newest samples kept per channel, a larger window restarts partly filled.
+// Fewer above five channels, all of them fit the backup SRAM.
+#ifndef WARM_START_SAMPLES
+#define WARM_START_SAMPLES (SENSOR_COUNT <= 5 ? 100 : 400 / SENSOR_COUNT)
+#endif
+// Reports between two checkpoints
+#ifndef WARM_START_PERIOD
+#define WARM_START_PERIOD 1
+#endif
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Power the backup SRAM and push the samples of a valid checkpoint into the
+// empty rings, stamped so the newest one lands 1 ms before this boot. Must
+// run before the producer starts. Returns the number of samples restored,
+// 0 when there was no checkpoint or it was written by another build.
+uint32_t warm_start_restore(sample_ring_t rings[SENSOR_COUNT]);
+
+// Write the newest window samples each ring holds for SAMPLE_READER_STATS,
+// consumer task only
+void warm_start_save(const sample_ring_t rings[SENSOR_COUNT]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __WARM_START_H */
@@ -0,0 +1,106 @@
+/**
+  ******************************************************************************
+  * @file    watchdog.h
+  * @brief   IWDG supervisor of the pipeline stages, reset cause in backup registers.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __WATCHDOG_H
+#define __WATCHDOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+// 1: run the IWDG and a supervisor task that refreshes it while every stage
+// checks in within its budget
+#ifndef WATCHDOG
+#define WATCHDOG 0
+#endif
+// IWDG timeout, up to 8190. LSI runs anywhere from 17 to 47 kHz, so the real
+// timeout is 0.7 to 1.9 times this. It must outlast a flash sector erase (2 s).
+#ifndef WATCHDOG_TIMEOUT_MS
+#define WATCHDOG_TIMEOUT_MS 4000
+#endif
+// Supervisor period, the IWDG is refreshed at this rate
+#ifndef WATCHDOG_KICK_MS
+#define WATCHDOG_KICK_MS 250
+#endif
+// Budgets: acquisition twice the sampling period plus the slack, the other
+// stages from their arming to their return to idle
+#ifndef WATCHDOG_ACQUIRE_SLACK_MS
+#define WATCHDOG_ACQUIRE_SLACK_MS 500
+#endif
+#ifndef WATCHDOG_PROCESS_BUDGET_MS
+#define WATCHDOG_PROCESS_BUDGET_MS 3000
+#endif
+#ifndef WATCHDOG_TRANSMIT_BUDGET_MS
+#define WATCHDOG_TRANSMIT_BUDGET_MS 1000
+#endif
+#if WATCHDOG_TIMEOUT_MS > 8190 || WATCHDOG_KICK_MS * 2 > WATCHDOG_TIMEOUT_MS
+#error "WATCHDOG_TIMEOUT_MS must be at most 8190 and twice WATCHDOG_KICK_MS"
+#endif
+// First byte of the reset cause frame
+#define WATCHDOG_FRAME_TYPE 0xAC
+#define WATCHDOG_FRAME_VERSION 1
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    WATCHDOG_STAGE_ACQUIRE,  // producer_task, checks in every tick
+    WATCHDOG_STAGE_PROCESS,  // consumer_task, from the batch signal to the end of its reports
+    WATCHDOG_STAGE_TRANSMIT, // USART2 DMA, from the start of a burst to its completion
+    WATCHDOG_STAGE_COUNT
+} watchdog_stage_t;
+
+typedef enum {
+    WATCHDOG_CAUSE_NONE,  // Power on, reset pin or brown out, see rcc_csr
+    WATCHDOG_CAUSE_STAGE, // A stage missed its budget, stage tells which
+    WATCHDOG_CAUSE_ERROR, // Error_Handler, detail is the address it was called from
+    WATCHDOG_CAUSE_FAULT, // HardFault, detail is SCB->CFSR. With CRASH_CAPTURE stage is the exception number.
+    WATCHDOG_CAUSE_IWDG   // The IWDG expired with nothing recorded, the supervisor could not run
+} watchdog_cause_t;
+
+// Reset cause frame as sent over the UART, little endian, no padding. Sent
+// once after every boot.
+typedef struct {
+    uint8_t type;         // WATCHDOG_FRAME_TYPE
+    uint8_t version;      // WATCHDOG_FRAME_VERSION
+    uint8_t cause;        // watchdog_cause_t of the last reset
+    uint8_t stage;        // watchdog_stage_t with WATCHDOG_CAUSE_STAGE
+    uint32_t detail;      // Uptime in ms of a missed budget, see watchdog_cause_t otherwise
+    uint32_t reset_count; // Recorded resets since the backup domain was powered
+    uint32_t rcc_csr;     // Reset flags of RCC_CSR at boot
+} watchdog_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Read and clear the reset cause, early in main
+void watchdog_init(void);
+
+// Start the IWDG and the supervisor task, before the scheduler starts. The
+// acquisition stage is expected to check in from here on.
+void watchdog_start(void);
+
+// A periodic stage is alive, it has to check in again within budget_ms.
+// Task or interrupt context.
+void watchdog_checkin(watchdog_stage_t stage, uint32_t budget_ms);
+
+// A stage has work to finish within budget_ms. Keeps the earlier deadline
+// when the stage is already armed. Task or interrupt context.
+void watchdog_arm(watchdog_stage_t stage, uint32_t budget_ms);
+
+// A stage waits for work and is not supervised until it is armed again
+void watchdog_idle(watchdog_stage_t stage);
+
+// Keep the cause of the coming reset in the backup registers, any context
+void watchdog_record(watchdog_cause_t cause, uint32_t stage, uint32_t detail);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __WATCHDOG_H */
@@ -0,0 +1,71 @@
+/**
+  ******************************************************************************
+  * @file    window_dump.h
+  * @brief   Raw samples of one channel window, frozen at a report and streamed on request.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __WINDOW_DUMP_H
+#define __WINDOW_DUMP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include "sample_ring.h"
+#include "sensor_data.h"
+
+/* Exported constants --------------------------------------------------------*/
+// 1: the "dump" command sends the raw samples of the window of one channel as
+// it stood at the next report
+#ifndef WINDOW_DUMP
+#define WINDOW_DUMP 0
+#endif
+// First byte of a dump frame
+#define WINDOW_DUMP_FRAME_TYPE 0xBB
+#define WINDOW_DUMP_FRAME_VERSION 1
+// Samples per frame, a frame stays within 64 bytes
+#define WINDOW_DUMP_FRAME_SAMPLES 13
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+    uint16_t offset_ms; // After the timestamp of its frame
+    int16_t code;       // sensor_to_fixed of the stored value
+} window_dump_sample_t;
+
+// Dump frame, little endian, no padding. A dump is the sample frames, oldest
+// first, then one frame without samples whose first is the window size.
+typedef struct {
+    uint8_t type;       // WINDOW_DUMP_FRAME_TYPE
+    uint8_t version;    // WINDOW_DUMP_FRAME_VERSION
+    uint8_t channel;    // sensor_t
+    uint8_t count;      // Samples that follow, 0 in the end frame
+    uint16_t dump;      // Incremented per dump, the frames of one dump share it
+    uint16_t first;     // Position of samples[0] in the window, oldest is 0
+    uint32_t timestamp; // Of samples[0] on the sample time base, of the report in the end frame
+    window_dump_sample_t samples[WINDOW_DUMP_FRAME_SAMPLES];
+} window_dump_frame_t;
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Create the dump task, before the scheduler starts
+void window_dump_start(void);
+
+// Ask for the window of channel at the next report. False when the channel
+// does not exist or a dump is still pending or running. Any task.
+bool window_dump_request(uint32_t channel);
+
+// Copy the window of the requested channel, the samples the
+// SAMPLE_READER_STATS reader of its ring holds, and hand it to the dump task.
+// Nothing to do without a request. Consumer task only, after the statistics
+// of the report, stamped with timestamp.
+void window_dump_capture(const sample_ring_t rings[SENSOR_COUNT], uint32_t timestamp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __WINDOW_DUMP_H */
@@ -0,0 +1,84 @@
+/**
+  ******************************************************************************
+  * @file    wire_format.h
+  * @brief   Layout checks and little-endian field access of the frames on the wire.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __WIRE_FORMAT_H
+#define __WIRE_FORMAT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Exported constants --------------------------------------------------------*/
+// The frame structs are the schema: the firmware fills them in place and
+// sends their bytes, and the host decoder reads the same structs' offsets.
+// Their fields are naturally aligned, so no compiler pads them, and every
+// offset is pinned next to the struct with WIRE_ASSERT_FIELD. A layout
+// change then fails the build of both ends instead of one receiver.
+#ifdef __cplusplus
+#define WIRE_ASSERT(condition, message) static_assert(condition, message)
+#else
+#define WIRE_ASSERT(condition, message) _Static_assert(condition, message)
+#endif
+// field of type lies at offset and is size bytes wide
+#define WIRE_ASSERT_FIELD(type, field, offset, size)                                         \
+    WIRE_ASSERT(offsetof(type, field) == (offset) && sizeof(((type *)0)->field) == (size), \
+                #type "." #field " moved, bump the frame version")
+
+// The target is little endian and writes the structs as they are. A big
+// endian host reads them through the accessors below.
+#define WIRE_NATIVE_LITTLE_ENDIAN (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+
+/* Exported functions prototypes ---------------------------------------------*/
+// Accessors of the little-endian fields at any alignment. The memcpy is one
+// load or store on the Cortex-M4, which handles unaligned words, and on a big
+// endian machine the swap is a single REV or REV16. No branch either way.
+
+static inline uint16_t wire_get_u16(const uint8_t *data) {
+    uint16_t value;
+
+    memcpy(&value, data, sizeof(value));
+#if !WIRE_NATIVE_LITTLE_ENDIAN
+    value = __builtin_bswap16(value);
+#endif
+    return value;
+}
+
+static inline uint32_t wire_get_u32(const uint8_t *data) {
+    uint32_t value;
+
+    memcpy(&value, data, sizeof(value));
+#if !WIRE_NATIVE_LITTLE_ENDIAN
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+static inline void wire_put_u16(uint8_t *data, uint16_t value) {
+#if !WIRE_NATIVE_LITTLE_ENDIAN
+    value = __builtin_bswap16(value);
+#endif
+    memcpy(data, &value, sizeof(value));
+}
+
+static inline void wire_put_u32(uint8_t *data, uint32_t value) {
+#if !WIRE_NATIVE_LITTLE_ENDIAN
+    value = __builtin_bswap32(value);
+#endif
+    memcpy(data, &value, sizeof(value));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __WIRE_FORMAT_H */
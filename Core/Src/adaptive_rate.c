@@ -0,0 +1,135 @@
+/**
+  ******************************************************************************
+  * @file    adaptive_rate.c
+  * @brief   Report rate and window size that follow the volatility of the data.
+  *
+  *          Each reported channel keeps two exponential moving averages of
+  *          its samples, a fast one and a slow one, and the variance around
+  *          the slow one, all updated per sample in constant time. On a
+  *          stationary signal the fast average stays within a fraction of a
+  *          standard deviation of the slow one. A step, a ramp or a burst of
+  *          motion pulls it away by several, so the drift, in standard
+  *          deviations, tells change from noise whatever the unit.
+  *
+  *          The level halves the batch and the window once per step, up to
+  *          ADAPTIVE_RATE_LEVELS. A sharp change jumps to the busiest level
+  *          and closes the batch as soon as it holds the busiest batch, so
+  *          the first report after the change goes out without waiting for
+  *          the quiet interval. Each quiet batch steps back one level, and
+  *          the gap between the two thresholds keeps the rate from flapping.
+  *          The levels only ever shorten the configured settings, which the
+  *          command channel still owns, so every level fits the storage.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "adaptive_rate.h"
+#include "pipeline_config.h"
+#include <math.h>
+
+/* Private defines -----------------------------------------------------------*/
+#define ADAPTIVE_RATE_FAST_ALPHA (1.0f / ADAPTIVE_RATE_FAST_SAMPLES)
+#define ADAPTIVE_RATE_SLOW_ALPHA (1.0f / ADAPTIVE_RATE_SLOW_SAMPLES)
+
+// Samples before the variance is trusted
+#define ADAPTIVE_RATE_WARMUP_SAMPLES (ADAPTIVE_RATE_SLOW_SAMPLES / 4U)
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    float fast;
+    float slow;
+    float variance;     // Around the slow average
+    uint32_t samples;   // Seen since adaptive_rate_init, saturates at the warm-up
+} adaptive_rate_channel_t;
+
+/* Private variables ---------------------------------------------------------*/
+static adaptive_rate_channel_t adaptive_rate_channels[SENSOR_COUNT];
+// Largest squared drift of the batch, in variances
+static float adaptive_rate_batch_drift;
+static bool adaptive_rate_batch_busy;
+// Written by the producer, read by the consumer for the window
+static volatile uint32_t adaptive_rate_current_level;
+
+// Function to shorten a setting by the level, down to its floor
+static uint32_t adaptive_rate_scale(uint32_t configured, uint32_t floor, uint32_t level) {
+    uint32_t scaled = configured >> level;
+
+    if (floor > configured) {
+        floor = configured;
+    }
+    return scaled < floor ? floor : scaled;
+}
+
+// Function to forget the history and go back to the configured rate
+void adaptive_rate_init(void) {
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        adaptive_rate_channels[channel].samples = 0;
+    }
+    adaptive_rate_batch_drift = 0.0f;
+    adaptive_rate_batch_busy = false;
+    adaptive_rate_current_level = 0;
+}
+
+// Function to update the averages of one channel and rate its drift
+void adaptive_rate_sample(sensor_t channel, float value) {
+    adaptive_rate_channel_t *state = &adaptive_rate_channels[channel];
+
+    if (state->samples == 0) {
+        state->fast = value;
+        state->slow = value;
+        state->variance = 0.0f;
+    }
+    float deviation = value - state->slow;
+    state->fast += ADAPTIVE_RATE_FAST_ALPHA * (value - state->fast);
+    state->slow += ADAPTIVE_RATE_SLOW_ALPHA * deviation;
+    state->variance += ADAPTIVE_RATE_SLOW_ALPHA * (deviation * deviation - state->variance);
+    if (state->samples < ADAPTIVE_RATE_WARMUP_SAMPLES) {
+        state->samples++;
+        return;
+    }
+
+    // Squared on both sides, no square root per sample
+    float floor = ADAPTIVE_RATE_NOISE_FLOOR * fabsf(state->slow);
+    float spread = state->variance + floor * floor;
+    float drift = state->fast - state->slow;
+    if (spread <= 0.0f) {
+        // Flat at zero, any change is news
+        spread = 1.0e-12f;
+    }
+    drift = drift * drift / spread;
+    if (drift > adaptive_rate_batch_drift) {
+        adaptive_rate_batch_drift = drift;
+    }
+    if (drift > ADAPTIVE_RATE_BUSY_SIGMA * ADAPTIVE_RATE_BUSY_SIGMA) {
+        adaptive_rate_batch_busy = true;
+        adaptive_rate_current_level = ADAPTIVE_RATE_LEVELS;
+    }
+}
+
+// Function to step the level back after a quiet batch
+void adaptive_rate_batch_end(void) {
+    uint32_t level = adaptive_rate_current_level;
+
+    if (!adaptive_rate_batch_busy && level > 0 &&
+        adaptive_rate_batch_drift < ADAPTIVE_RATE_QUIET_SIGMA * ADAPTIVE_RATE_QUIET_SIGMA) {
+        adaptive_rate_current_level = level - 1U;
+    }
+    adaptive_rate_batch_drift = 0.0f;
+    adaptive_rate_batch_busy = false;
+}
+
+// Function to read the batch of the current level
+uint32_t adaptive_rate_samples_per_batch(void) {
+    return adaptive_rate_scale(pipeline_config.samples_per_batch, ADAPTIVE_RATE_BATCH_MIN,
+                               adaptive_rate_current_level);
+}
+
+// Function to read the window of the current level
+uint32_t adaptive_rate_window_size(void) {
+    return adaptive_rate_scale(pipeline_config.window_size, ADAPTIVE_RATE_WINDOW_MIN, adaptive_rate_current_level);
+}
+
+// Function to read the current level
+uint32_t adaptive_rate_level(void) {
+    return adaptive_rate_current_level;
+}
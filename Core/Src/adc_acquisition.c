@@ -0,0 +1,208 @@
+/**
+  ******************************************************************************
+  * @file    adc_acquisition.c
+  * @brief   Timer-triggered ADC1 scan acquisition for the analog sensors.
+  *
+  *          TIM8 triggers one scan of all SENSOR_SOURCE_ADC inputs at
+  *          ADC_ACQUISITION_RATE_HZ and the DMA stores the results in a
+  *          circular buffer. The half and full transfer interrupts add each
+  *          completed half to per-channel sums, so the CPU sees one
+  *          interrupt per ADC_ACQUISITION_SCANS / 2 scans and the producer
+  *          takes the mean at its tick without any bus transaction. The
+  *          registers are used directly, this project does not ship the HAL
+  *          ADC driver.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "adc_acquisition.h"
+#include "cmsis_os.h"
+#include "critical_section.h"
+#include "main.h"
+#include "sensor_registry.h"
+#include "spectral_analysis.h"
+
+#if (ADC_ACQUISITION_SCANS % 2) != 0
+#error "ADC_ACQUISITION_SCANS must be even"
+#endif
+
+/* External variables --------------------------------------------------------*/
+extern DMA_HandleTypeDef hdma_adc1;
+extern TIM_HandleTypeDef htim8;
+
+/* Private defines -----------------------------------------------------------*/
+// TIM8_TRGO in ADC_CR2 EXTSEL
+#define ADC_EXTSEL_TIM8_TRGO 14U
+// 480 cycles, the photoresistor divider is a high impedance source
+#define ADC_SAMPLE_TIME_480_CYCLES 7U
+
+/* Private variables ---------------------------------------------------------*/
+// DMA target, SRAM
+static uint16_t adc_buffer[ADC_ACQUISITION_SCANS * ADC_ACQUISITION_CHANNELS_MAX];
+static uint32_t adc_channel_count;
+// Scan slot of each sensor_t, only valid for SENSOR_SOURCE_ADC rows
+static uint8_t adc_slot[SENSOR_COUNT];
+// Written by the DMA interrupts, read and cleared by the producer
+static uint32_t adc_sum[ADC_ACQUISITION_CHANNELS_MAX];
+static uint32_t adc_count[ADC_ACQUISITION_CHANNELS_MAX];
+static float adc_last[ADC_ACQUISITION_CHANNELS_MAX];
+
+/* Private function prototypes -----------------------------------------------*/
+static void adc_acquisition_pin_init(uint32_t input);
+static void adc_acquisition_accumulate(const uint16_t *scans, uint32_t count);
+static void adc_acquisition_half_from_isr(DMA_HandleTypeDef *hdma);
+static void adc_acquisition_full_from_isr(DMA_HandleTypeDef *hdma);
+
+// Function to switch the pin of an ADC1 input to analog mode
+static void adc_acquisition_pin_init(uint32_t input) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    GPIO_TypeDef *port;
+    uint32_t pin;
+
+    if (input < 8) {
+        __HAL_RCC_GPIOA_CLK_ENABLE();
+        port = GPIOA;
+        pin = input;
+    } else if (input < 10) {
+        __HAL_RCC_GPIOB_CLK_ENABLE();
+        port = GPIOB;
+        pin = input - 8;
+    } else {
+        __HAL_RCC_GPIOC_CLK_ENABLE();
+        port = GPIOC;
+        pin = input - 10;
+    }
+    GPIO_InitStruct.Pin = 1U << pin;
+    GPIO_InitStruct.Mode = GPIO_MODE_ANALOG;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    HAL_GPIO_Init(port, &GPIO_InitStruct);
+}
+
+// Function to set up the scan sequence and the circular DMA
+void adc_acquisition_init(void) {
+    uint32_t sqr[3] = {0};
+
+    adc_channel_count = 0;
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        const sensor_driver_t *driver = &sensor_registry[channel];
+        if (driver->source != SENSOR_SOURCE_ADC) {
+            continue;
+        }
+        if (adc_channel_count == ADC_ACQUISITION_CHANNELS_MAX) {
+            Error_Handler();
+        }
+        uint32_t slot = adc_channel_count++;
+        uint32_t input = driver->adc_channel;
+
+        adc_slot[channel] = (uint8_t)slot;
+        adc_sum[slot] = 0;
+        adc_count[slot] = 0;
+        adc_last[slot] = 0.0f;
+        adc_acquisition_pin_init(input);
+
+        // Sequence position slot: SQR3 holds SQ1-SQ6, SQR2 SQ7-SQ12
+        sqr[slot / 6] |= input << ((slot % 6) * 5);
+        if (input >= 10) {
+            MODIFY_REG(ADC1->SMPR1, 7U << ((input - 10) * 3), ADC_SAMPLE_TIME_480_CYCLES << ((input - 10) * 3));
+        } else {
+            MODIFY_REG(ADC1->SMPR2, 7U << (input * 3), ADC_SAMPLE_TIME_480_CYCLES << (input * 3));
+        }
+    }
+    if (adc_channel_count == 0) {
+        return;
+    }
+
+    __HAL_RCC_ADC1_CLK_ENABLE();
+    // ADCCLK = PCLK2 / 4, 21 MHz at most in both clock profiles
+    MODIFY_REG(ADC->CCR, ADC_CCR_ADCPRE, ADC_CCR_ADCPRE_0);
+    ADC1->CR1 = ADC_CR1_SCAN;
+    ADC1->SQR1 = (adc_channel_count - 1U) << ADC_SQR1_L_Pos;
+    ADC1->SQR2 = sqr[1];
+    ADC1->SQR3 = sqr[0];
+    // One scan per TIM8 update, DMA requests keep coming for the circular buffer
+    ADC1->CR2 = ADC_CR2_DMA | ADC_CR2_DDS | (ADC_EXTSEL_TIM8_TRGO << ADC_CR2_EXTSEL_Pos) |
+                ADC_CR2_EXTEN_0 | ADC_CR2_ADON;
+
+    hdma_adc1.Instance = DMA2_Stream0;
+    hdma_adc1.Init.Channel = DMA_CHANNEL_0;
+    hdma_adc1.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_adc1.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_adc1.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_adc1.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    hdma_adc1.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    hdma_adc1.Init.Mode = DMA_CIRCULAR;
+    hdma_adc1.Init.Priority = DMA_PRIORITY_LOW;
+    hdma_adc1.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_adc1) != HAL_OK) {
+        Error_Handler();
+    }
+    hdma_adc1.XferHalfCpltCallback = adc_acquisition_half_from_isr;
+    hdma_adc1.XferCpltCallback = adc_acquisition_full_from_isr;
+    if (HAL_DMA_Start_IT(&hdma_adc1, (uint32_t)(uintptr_t)&ADC1->DR, (uint32_t)(uintptr_t)adc_buffer,
+                         ADC_ACQUISITION_SCANS * adc_channel_count) != HAL_OK) {
+        Error_Handler();
+    }
+}
+
+// Function to start the conversions
+void adc_acquisition_start(void) {
+    if (adc_channel_count == 0) {
+        return;
+    }
+    if (HAL_TIM_Base_Start(&htim8) != HAL_OK) {
+        Error_Handler();
+    }
+}
+
+// Function to add completed scans to the channel sums
+static void adc_acquisition_accumulate(const uint16_t *scans, uint32_t count) {
+    for (uint32_t scan = 0; scan < count; ++scan) {
+        for (uint32_t slot = 0; slot < adc_channel_count; ++slot) {
+            adc_sum[slot] += *scans++;
+        }
+    }
+    for (uint32_t slot = 0; slot < adc_channel_count; ++slot) {
+        adc_count[slot] += count;
+    }
+}
+
+// DMA half transfer callback, the first half of the buffer is complete
+static void adc_acquisition_half_from_isr(DMA_HandleTypeDef *hdma) {
+    (void)hdma;
+    adc_acquisition_accumulate(adc_buffer, ADC_ACQUISITION_SCANS / 2);
+#if SPECTRAL_ANALYSIS
+    spectral_analysis_collect_from_isr(&adc_buffer[adc_slot[SPECTRAL_ANALYSIS_CHANNEL]], ADC_ACQUISITION_SCANS / 2,
+                                       adc_channel_count);
+#endif
+}
+
+// DMA transfer complete callback, the second half of the buffer is complete
+static void adc_acquisition_full_from_isr(DMA_HandleTypeDef *hdma) {
+    (void)hdma;
+    adc_acquisition_accumulate(&adc_buffer[(ADC_ACQUISITION_SCANS / 2) * adc_channel_count],
+                               ADC_ACQUISITION_SCANS / 2);
+#if SPECTRAL_ANALYSIS
+    // Every conversion of the channel, not the mean, the spectrum needs the scan rate
+    spectral_analysis_collect_from_isr(&adc_buffer[(ADC_ACQUISITION_SCANS / 2) * adc_channel_count +
+                                                   adc_slot[SPECTRAL_ANALYSIS_CHANNEL]],
+                                       ADC_ACQUISITION_SCANS / 2, adc_channel_count);
+#endif
+}
+
+// Function to take the mean of a channel since the previous sample
+float adc_acquisition_sample(sensor_t channel) {
+    uint32_t slot = adc_slot[channel];
+
+    // Each channel is sampled at its own divider, so each keeps its own count.
+    // Four accesses against the DMA half-transfer handler, every sample.
+    uint32_t state = critical_section_enter();
+    uint32_t sum = adc_sum[slot];
+    uint32_t count = adc_count[slot];
+    adc_sum[slot] = 0;
+    adc_count[slot] = 0;
+    critical_section_exit(state);
+    if (count != 0) {
+        adc_last[slot] = (float)sum / (float)count;
+    }
+    return adc_last[slot];
+}
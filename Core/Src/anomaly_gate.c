@@ -0,0 +1,91 @@
+/**
+  ******************************************************************************
+  * @file    anomaly_gate.c
+  * @brief   Z-score of every statistics window against a learned baseline, gates the live reports.
+  *
+  *          On a stable site one window looks like the last hundred, and
+  *          most of the airtime carries frames nobody reads. Each statistic
+  *          of each channel keeps a baseline across windows: an exponential
+  *          mean and variance of its values, the window counted about
+  *          1 / ANOMALY_GATE_ALPHA times. A new window is scored before it is
+  *          learned, every statistic by its distance to the mean in standard
+  *          deviations, and the window is anomalous when one of them goes
+  *          beyond ANOMALY_GATE_THRESHOLD plus the deadband of the channel,
+  *          the smallest change the delta reporting would send, so a
+  *          statistic that never moves is not anomalous for one code.
+  *
+  *          An anomalous window is sent, and so are the ANOMALY_GATE_HOLD
+  *          windows after it, so the receiver sees the episode settle. Any
+  *          other window is only sent as a heartbeat, one in
+  *          ANOMALY_GATE_HEARTBEAT. The anomalous windows are learned too,
+  *          so a lasting new level becomes the baseline and stops being
+  *          sent. The score is a few operations per statistic, a tiny model
+  *          would learn nothing more from a handful of features.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "anomaly_gate.h"
+#include "sensor_registry.h"
+#include <math.h>
+
+/* Private variables ---------------------------------------------------------*/
+// Consumer task only
+static float anomaly_gate_mean[SENSOR_COUNT][STATS_FIELD_COUNT];
+static float anomaly_gate_variance[SENSOR_COUNT][STATS_FIELD_COUNT];
+static uint32_t anomaly_gate_primed; // Channels whose baseline started
+static uint32_t anomaly_gate_learned;
+static uint32_t anomaly_gate_hold;
+static uint32_t anomaly_gate_quiet;
+
+// Function to score a window, learn it and decide whether it is sent
+bool anomaly_gate_admit(uint16_t channel_mask, const float values[SENSOR_COUNT][STATS_FIELD_COUNT]) {
+    bool anomalous = anomaly_gate_learned < ANOMALY_GATE_WARMUP;
+
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        if ((channel_mask & (1U << channel)) == 0) {
+            anomaly_gate_primed &= ~(1UL << channel);
+            continue;
+        }
+        // A channel seen for the first time, or again in the mask, starts from its window
+        bool primed = (anomaly_gate_primed & (1UL << channel)) != 0;
+        float floor = sensor_registry[channel].deadband;
+        anomaly_gate_primed |= 1UL << channel;
+        for (uint32_t field = 0; field < STATS_FIELD_COUNT; ++field) {
+            float value = values[channel][field];
+            if (!isfinite(value)) {
+                continue;
+            }
+            if (!primed) {
+                anomaly_gate_mean[channel][field] = value;
+                anomaly_gate_variance[channel][field] = 0.0f;
+                continue;
+            }
+            // Scored against the baseline before this window, then learned into it
+            float deviation = value - anomaly_gate_mean[channel][field];
+            float limit = ANOMALY_GATE_THRESHOLD * sqrtf(anomaly_gate_variance[channel][field]) + floor;
+            if (fabsf(deviation) > limit) {
+                anomalous = true;
+            }
+            anomaly_gate_mean[channel][field] += ANOMALY_GATE_ALPHA * deviation;
+            anomaly_gate_variance[channel][field] =
+                (1.0f - ANOMALY_GATE_ALPHA) *
+                (anomaly_gate_variance[channel][field] + ANOMALY_GATE_ALPHA * deviation * deviation);
+        }
+    }
+    if (anomaly_gate_learned < ANOMALY_GATE_WARMUP) {
+        anomaly_gate_learned++;
+    }
+
+    if (anomalous) {
+        anomaly_gate_hold = ANOMALY_GATE_HOLD;
+    } else if (anomaly_gate_hold > 0) {
+        anomaly_gate_hold--;
+        anomalous = true;
+    }
+    if (anomalous || ++anomaly_gate_quiet >= ANOMALY_GATE_HEARTBEAT) {
+        anomaly_gate_quiet = 0;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,50 @@
+/**
+  ******************************************************************************
+  * @file    arena.c
+  * @brief   Linear region allocator, carved once per configuration and reset as a whole.
+  *
+  *          Working sets that are laid out together and dropped together do
+  *          not need a heap: an arena hands its storage out front to back
+  *          and takes it all back by rewinding one offset. There is no
+  *          header per allocation and no free list, so no fragment is ever
+  *          left between two allocations. The same sequence of allocations
+  *          always lands at the same addresses, and the fill level is the
+  *          whole account of where the memory went.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "arena.h"
+#include <stddef.h>
+
+// Function to start an arena over its storage
+void arena_init(arena_t *arena, uint32_t *storage, uint32_t size) {
+    arena->storage = (uint8_t *)storage;
+    arena->size = size & ~3U;
+    arena->used = 0;
+    arena->peak = 0;
+    arena->resets = 0;
+    arena->failures = 0;
+}
+
+// Function to take the next bytes of the storage
+void *arena_alloc(arena_t *arena, uint32_t size) {
+    uint32_t bytes = ARENA_BYTES(size);
+
+    if (bytes > arena->size - arena->used) {
+        arena->failures++;
+        return NULL;
+    }
+    void *block = arena->storage + arena->used;
+    arena->used += bytes;
+    if (arena->used > arena->peak) {
+        arena->peak = arena->used;
+    }
+    return block;
+}
+
+// Function to give back every allocation
+void arena_reset(arena_t *arena) {
+    arena->used = 0;
+    arena->resets++;
+}
@@ -0,0 +1,70 @@
+/**
+  ******************************************************************************
+  * @file    batch_watermark.c
+  * @brief   Consumer handoff driven by the fill of the rings and a latency deadline.
+  *
+  *          The producer wakes the consumer once per batch, and a batch is a
+  *          fixed count of ticks. That count only stands for the samples in
+  *          the rings while every channel is stored at every tick: channels
+  *          read every few ticks, shed or decimated bring a fraction of it,
+  *          and a FIFO drain brings several reads in one tick. Here the
+  *          producer counts what actually reached each ring since the last
+  *          handoff and wakes the consumer on that instead, so every wakeup
+  *          and its context switch carry a full batch of work whatever the
+  *          rates.
+  *
+  *          The high watermark hands over at once and keeps a fast ring
+  *          within the headroom it has behind the window. The deadline
+  *          bounds the wait of the oldest new sample for slow channels and
+  *          quiet periods, once the low watermark is reached. The consumer
+  *          is unchanged: it already takes every sample its reader has not
+  *          seen in one pass.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "batch_watermark.h"
+
+#if BATCH_WATERMARK
+/* Private variables ---------------------------------------------------------*/
+// Producer only, the samples of each ring since the last handoff
+static uint32_t batch_watermark_pending[SENSOR_COUNT];
+static uint32_t batch_watermark_fullest;
+// Sample time of the oldest of them, valid while batch_watermark_fullest is not 0
+static uint32_t batch_watermark_oldest;
+
+// Function to start with no new samples
+void batch_watermark_init(void) {
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        batch_watermark_pending[channel] = 0;
+    }
+    batch_watermark_fullest = 0;
+}
+
+// Function to count a sample that reached its ring
+void batch_watermark_sample(sensor_t channel, uint32_t timestamp) {
+    // The reads of a FIFO drain come oldest first, the first one of the batch dates it
+    if (batch_watermark_fullest == 0 || (int32_t)(timestamp - batch_watermark_oldest) < 0) {
+        batch_watermark_oldest = timestamp;
+    }
+    if (++batch_watermark_pending[channel] > batch_watermark_fullest) {
+        batch_watermark_fullest = batch_watermark_pending[channel];
+    }
+}
+
+// Function to check the watermarks and the deadline at the end of a tick
+bool batch_watermark_due(uint32_t now, uint32_t batch, uint32_t period_ms) {
+    uint32_t high = BATCH_WATERMARK_HIGH != 0 && BATCH_WATERMARK_HIGH < batch ? BATCH_WATERMARK_HIGH : batch;
+    uint32_t latency_ms = BATCH_WATERMARK_LATENCY_MS != 0 ? BATCH_WATERMARK_LATENCY_MS : batch * period_ms;
+    uint32_t fullest = batch_watermark_fullest;
+
+    if (fullest < high && (fullest < BATCH_WATERMARK_LOW || now - batch_watermark_oldest < latency_ms)) {
+        return false;
+    }
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        batch_watermark_pending[channel] = 0;
+    }
+    batch_watermark_fullest = 0;
+    return true;
+}
+#endif /* BATCH_WATERMARK */
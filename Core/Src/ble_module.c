@@ -0,0 +1,117 @@
+/**
+  ******************************************************************************
+  * @file    ble_module.c
+  * @brief   AT command setup of the BLE module on USART2 at boot.
+  *
+  *          A transparent UART bridge keeps its own connection parameters,
+  *          and the defaults favour battery life over throughput: a long
+  *          connection interval carries one small packet per event. Most
+  *          bridges take AT commands on the same UART while no central is
+  *          connected and pass every byte through once one is, so the
+  *          setup runs at boot, before the command channel and the
+  *          transmit queue own USART2, and only while the link is down.
+  *          The commands are a table of command and expected reply, sent
+  *          one by one with polled HAL_UART_Transmit and HAL_UART_Receive.
+  *          A reply is taken until the line stays quiet, as the HM-10
+  *          sends no line end, and the table stops at the first reply that
+  *          does not match.
+  *
+  *          The default table is for the HM-10: the shortest connection
+  *          interval the central allows (7.5 to 10 ms) and no slave
+  *          latency, then a reset for them to apply. A module with data
+  *          length extension and MTU commands lists them here as well, and
+  *          UART_TX_BURST_MAX then matches the ATT payload it negotiates.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "ble_module.h"
+#include "main.h"
+#include "link_backlog.h"
+#include "uart_tx.h"
+#include <stdbool.h>
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+// Longest reply compared, the rest is read and ignored
+#define BLE_MODULE_REPLY_MAX 24
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    const char *command; // Sent as is, no line end
+    const char *reply;   // Expected start of the reply
+    bool reset;          // The module restarts after it, wait BLE_MODULE_RESET_MS
+} ble_module_command_t;
+
+/* External variables --------------------------------------------------------*/
+extern UART_HandleTypeDef huart2;
+
+/* Private variables ---------------------------------------------------------*/
+static const ble_module_command_t ble_module_commands[] = {
+    { "AT", "OK", false },               // Command mode, nobody connected
+    { "AT+COMI0", "OK+Set:0", false },   // Minimum connection interval 7.5 ms
+    { "AT+COMA1", "OK+Set:1", false },   // Maximum connection interval 10 ms
+    { "AT+COLA0", "OK+Set:0", false },   // No slave latency
+    { "AT+RESET", "OK+RESET", true },    // The parameters apply from the next connection
+};
+#define BLE_MODULE_COMMAND_COUNT (sizeof(ble_module_commands) / sizeof(ble_module_commands[0]))
+
+static ble_module_frame_t ble_module_result;
+
+/* Private function prototypes -----------------------------------------------*/
+static uint32_t ble_module_receive(char *reply, uint32_t size);
+
+// Function to send the command table and check the replies
+void ble_module_configure(void) {
+    char reply[BLE_MODULE_REPLY_MAX + 1];
+
+    ble_module_result.type = BLE_MODULE_FRAME_TYPE;
+    ble_module_result.version = BLE_MODULE_FRAME_VERSION;
+    ble_module_result.commands = (uint8_t)BLE_MODULE_COMMAND_COUNT;
+#if LINK_BACKLOG
+    if (link_backlog_link_up()) {
+        // The commands would go to the central as data
+        ble_module_result.skipped = 1;
+        return;
+    }
+#endif
+    for (uint32_t i = 0; i < BLE_MODULE_COMMAND_COUNT; ++i) {
+        const ble_module_command_t *command = &ble_module_commands[i];
+
+        // A byte left from the module start would be taken for the reply
+        __HAL_UART_FLUSH_DRREGISTER(&huart2);
+        if (HAL_UART_Transmit(&huart2, (const uint8_t *)command->command, (uint16_t)strlen(command->command),
+                              BLE_MODULE_REPLY_MS) != HAL_OK) {
+            return;
+        }
+        ble_module_receive(reply, sizeof(reply));
+        if (strncmp(reply, command->reply, strlen(command->reply)) != 0) {
+            return;
+        }
+        ble_module_result.accepted++;
+        if (command->reset) {
+            HAL_Delay(BLE_MODULE_RESET_MS);
+        }
+    }
+}
+
+// Function to read a reply until the line stays quiet, returns its length
+static uint32_t ble_module_receive(char *reply, uint32_t size) {
+    uint32_t length = 0;
+    uint32_t timeout = BLE_MODULE_REPLY_MS;
+    uint8_t byte;
+
+    while (HAL_UART_Receive(&huart2, &byte, 1, timeout) == HAL_OK) {
+        if (length < size - 1U) {
+            reply[length++] = (char)byte;
+        }
+        timeout = BLE_MODULE_REPLY_GAP_MS;
+    }
+    reply[length] = '\0';
+    return length;
+}
+
+// Function to send the result frame
+void ble_module_report(void) {
+    uart_tx_send((const uint8_t *)&ble_module_result, sizeof(ble_module_result));
+}
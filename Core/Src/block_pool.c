@@ -0,0 +1,104 @@
+/**
+  ******************************************************************************
+  * @file    block_pool.c
+  * @brief   Fixed-size block pools with constant time allocation, ISR safe.
+  *
+  *          Each pool serves one block size from static storage, a producer
+  *          of two sizes of buffer keeps two pools. Every block is the same
+  *          size, so a freed block fits any later request and the pool cannot
+  *          fragment however long it runs. The free list is a stack of
+  *          blocks linked through their first word: taking or giving back a
+  *          block is a few instructions inside a critical section, the same
+  *          at any fill level.
+  *
+  *          The critical section masks the interrupts up to
+  *          configMAX_SYSCALL_INTERRUPT_PRIORITY, so tasks and the interrupts
+  *          that may call the kernel share a pool safely. A lock-free list
+  *          would need a tag against ABA on LDREX/STREX and gains nothing at
+  *          this length of critical section.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "block_pool.h"
+#include "cmsis_os.h"
+#include "critical_section.h"
+#include <stddef.h>
+
+// Function to split the storage into a list of free blocks
+void block_pool_init(block_pool_t *pool, uint32_t *storage, uint32_t block_size, uint32_t block_count) {
+    uint32_t words = BLOCK_POOL_WORDS(block_size);
+
+    pool->storage = (uint8_t *)storage;
+    pool->block_size = words * sizeof(uint32_t);
+    pool->block_count = block_count;
+    pool->free_list = NULL;
+    // Linked from the last block down, so blocks are handed out in address order
+    for (uint32_t i = block_count; i > 0; --i) {
+        void **block = (void **)&storage[(i - 1U) * words];
+        *block = pool->free_list;
+        pool->free_list = block;
+    }
+    pool->free_count = block_count;
+    pool->min_free = block_count;
+    pool->failures = 0;
+}
+
+// Function to pop the head of the free list, inside a critical section
+static void *block_pool_take(block_pool_t *pool) {
+    void **block = pool->free_list;
+
+    if (block == NULL) {
+        pool->failures++;
+        return NULL;
+    }
+    pool->free_list = *block;
+    if (--pool->free_count < pool->min_free) {
+        pool->min_free = pool->free_count;
+    }
+    return block;
+}
+
+// Function to check that a pointer is the start of a block of the pool
+static bool block_pool_owns(const block_pool_t *pool, const void *block) {
+    uintptr_t offset = (uintptr_t)block - (uintptr_t)pool->storage;
+
+    return (uintptr_t)block >= (uintptr_t)pool->storage && offset < pool->block_size * pool->block_count &&
+           offset % pool->block_size == 0;
+}
+
+// Function to push a block on the free list, inside a critical section
+static void block_pool_give(block_pool_t *pool, void *block) {
+    *(void **)block = pool->free_list;
+    pool->free_list = block;
+    pool->free_count++;
+}
+
+// Function to take a block, from a task or an interrupt
+void *block_pool_alloc(block_pool_t *pool) {
+    uint32_t state = critical_section_enter();
+    void *block = block_pool_take(pool);
+    critical_section_exit(state);
+    return block;
+}
+
+// Function to take a block from an interrupt
+void *block_pool_alloc_from_isr(block_pool_t *pool) {
+    return block_pool_alloc(pool);
+}
+
+// Function to give a block back, from a task or an interrupt
+bool block_pool_free(block_pool_t *pool, void *block) {
+    if (!block_pool_owns(pool, block)) {
+        return false;
+    }
+    uint32_t state = critical_section_enter();
+    block_pool_give(pool, block);
+    critical_section_exit(state);
+    return true;
+}
+
+// Function to give a block back from an interrupt
+bool block_pool_free_from_isr(block_pool_t *pool, void *block) {
+    return block_pool_free(pool, block);
+}
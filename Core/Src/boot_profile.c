@@ -0,0 +1,64 @@
+/**
+  ******************************************************************************
+  * @file    boot_profile.c
+  * @brief   Cycle counter marks from reset to the first frame, reported once.
+  *
+  *          The reset handler starts CYCCNT before SystemInit, so the marks
+  *          cover the copy of .data and .ccmram and the zeroing of .bss as
+  *          well as every init step of main. They are kept in the no-init
+  *          section, which the startup code does not clear behind the first
+  *          two marks.
+  *
+  *          Each mark also keeps the core clock the next step runs at: the
+  *          16 MHz HSI up to SystemClock_Config, SystemCoreClock after it.
+  *          The report converts every step at its own clock and adds them
+  *          up, so a time is right across the clock switch. The profile
+  *          goes out once, as the first frame of the consumer.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "boot_profile.h"
+#include "cycle_counter.h"
+#include "main.h"
+#include "uart_tx.h"
+
+/* Private variables ---------------------------------------------------------*/
+// Written before the startup code clears .bss, the reset handler sets them up
+static uint32_t boot_profile_cycles[BOOT_MARK_COUNT] NOINIT;
+// Core clock from each mark to the next
+static uint32_t boot_profile_hz[BOOT_MARK_COUNT] NOINIT;
+
+// Function to start the counter at reset
+void boot_profile_reset(void) {
+    cycle_counter_init();
+    for (uint32_t mark = 0; mark < BOOT_MARK_COUNT; ++mark) {
+        boot_profile_cycles[mark] = 0;
+        boot_profile_hz[mark] = HSI_VALUE;
+    }
+}
+
+// Function to record the end of a boot step
+void boot_profile_mark(boot_mark_t mark) {
+    boot_profile_cycles[mark] = cycle_counter_now();
+    // SystemCoreClock only holds its initial value once .data is copied
+    boot_profile_hz[mark] = mark < BOOT_MARK_CLOCK ? HSI_VALUE : SystemCoreClock;
+}
+
+// Function to send the time of every mark
+void boot_profile_report(void) {
+    boot_profile_frame_t frame = {
+        .type = BOOT_PROFILE_FRAME_TYPE,
+        .version = BOOT_PROFILE_FRAME_VERSION,
+        .count = BOOT_MARK_COUNT,
+    };
+    uint32_t us = 0;
+
+    boot_profile_mark(BOOT_MARK_FIRST_FRAME);
+    for (uint32_t mark = 1; mark < BOOT_MARK_COUNT; ++mark) {
+        uint32_t cycles = boot_profile_cycles[mark] - boot_profile_cycles[mark - 1];
+        us += cycles / (boot_profile_hz[mark - 1] / 1000000U);
+        frame.us[mark] = us;
+    }
+    uart_tx_send((const uint8_t *)&frame, sizeof(frame));
+}
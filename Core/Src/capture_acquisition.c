@@ -0,0 +1,213 @@
+/**
+  ******************************************************************************
+  * @file    capture_acquisition.c
+  * @brief   TIM4 input capture acquisition for the sensors with a frequency output.
+  *
+  *          A light-to-frequency converter or a flow meter has no register to
+  *          read, its value is the rate of its output. Counting the edges in
+  *          an EXTI handler costs an interrupt per edge. Here TIM4 CH3 latches
+  *          the counter at every rising edge and the DMA moves the capture
+  *          into a circular buffer, so an edge costs one bus transfer and no
+  *          CPU. The only interrupts are one per lap of the buffer and one per
+  *          wrap of the 16-bit counter.
+  *
+  *          At each sample the producer takes the number of captures from the
+  *          laps and the DMA position, and the time of the newest one from its
+  *          age on the running counter. The frequency over the read interval
+  *          is the captures divided by the time between the newest edges of
+  *          two samples, whatever the number of edges in between, so the
+  *          sample costs the same at 10 Hz and at 100 kHz. The counters are
+  *          used directly, as in adc_acquisition.c.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "capture_acquisition.h"
+#include "main.h"
+#include "pipeline_priorities.h"
+#include "sensor_registry.h"
+#include <stdbool.h>
+
+#if CAPTURE_ACQUISITION_EDGES_PER_CAPTURE != 1 && CAPTURE_ACQUISITION_EDGES_PER_CAPTURE != 2 && \
+    CAPTURE_ACQUISITION_EDGES_PER_CAPTURE != 4 && CAPTURE_ACQUISITION_EDGES_PER_CAPTURE != 8
+#error "CAPTURE_ACQUISITION_EDGES_PER_CAPTURE must be 1, 2, 4 or 8"
+#endif
+
+/* External variables --------------------------------------------------------*/
+extern DMA_HandleTypeDef hdma_tim4_ch3;
+
+/* Private defines -----------------------------------------------------------*/
+// IC3PSC of TIM4_CCMR2, captures every 2^n-th edge
+#if CAPTURE_ACQUISITION_EDGES_PER_CAPTURE == 8
+#define CAPTURE_IC_PRESCALER 3U
+#elif CAPTURE_ACQUISITION_EDGES_PER_CAPTURE == 4
+#define CAPTURE_IC_PRESCALER 2U
+#elif CAPTURE_ACQUISITION_EDGES_PER_CAPTURE == 2
+#define CAPTURE_IC_PRESCALER 1U
+#else
+#define CAPTURE_IC_PRESCALER 0U
+#endif
+// IC3F of TIM4_CCMR2, 8 samples at the timer clock, a glitch of 100 ns is no edge
+#define CAPTURE_IC_FILTER 3U
+
+/* Private variables ---------------------------------------------------------*/
+// DMA target, SRAM
+static uint16_t capture_buffer[CAPTURE_ACQUISITION_CAPTURES];
+static bool capture_enabled;
+// Written by the DMA and TIM4 interrupts, read by the producer
+static volatile uint32_t capture_laps;
+static volatile uint32_t capture_wraps;
+// Producer only: captures and time of the newest edge at the previous sample,
+// in counts of the extended counter, and the period it left
+static bool capture_referenced;
+static uint32_t capture_last_total;
+static uint32_t capture_last_edge;
+static float capture_period_counts;
+
+/* Private function prototypes -----------------------------------------------*/
+static void capture_acquisition_lap_from_isr(DMA_HandleTypeDef *hdma);
+
+// Function to set up the channel, its pin and the circular DMA
+void capture_acquisition_init(void) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    uint32_t rows = 0;
+    uint32_t tim_clock = HAL_RCC_GetPCLK1Freq();
+
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        rows += sensor_registry[channel].source == SENSOR_SOURCE_CAPTURE;
+    }
+    if (rows > CAPTURE_ACQUISITION_CHANNELS_MAX) {
+        Error_Handler();
+    }
+    if (rows == 0) {
+        return;
+    }
+    capture_enabled = true;
+    capture_laps = 0;
+    capture_wraps = 0;
+    capture_referenced = false;
+    capture_period_counts = 0.0f;
+
+    // PB8 is TIM4_CH3 on AF2
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    GPIO_InitStruct.Pin = GPIO_PIN_8;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    GPIO_InitStruct.Alternate = GPIO_AF2_TIM4;
+    HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+    // APB1 timers run at twice PCLK1 whenever the APB1 prescaler is not 1,
+    // the clock governor never changes it
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1) {
+        tim_clock *= 2U;
+    }
+    __HAL_RCC_TIM4_CLK_ENABLE();
+    TIM4->PSC = tim_clock / CAPTURE_ACQUISITION_COUNTER_HZ - 1U;
+    TIM4->ARR = 0xFFFFU;
+    // Load the prescaler now, without an interrupt for it
+    TIM4->CR1 = TIM_CR1_URS;
+    TIM4->EGR = TIM_EGR_UG;
+    TIM4->SR = 0;
+    // IC3 on TI3, rising edges, a DMA request per capture
+    TIM4->CCMR2 = (1U << TIM_CCMR2_CC3S_Pos) | (CAPTURE_IC_PRESCALER << TIM_CCMR2_IC3PSC_Pos) |
+                  (CAPTURE_IC_FILTER << TIM_CCMR2_IC3F_Pos);
+    TIM4->CCER = TIM_CCER_CC3E;
+    TIM4->DIER = TIM_DIER_CC3DE | TIM_DIER_UIE;
+
+    // TIM4_CH3 is DMA1 Stream7 channel 2, the other TIM4 channels share streams with the I2C buses
+    hdma_tim4_ch3.Instance = DMA1_Stream7;
+    hdma_tim4_ch3.Init.Channel = DMA_CHANNEL_2;
+    hdma_tim4_ch3.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_tim4_ch3.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_tim4_ch3.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_tim4_ch3.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    hdma_tim4_ch3.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    hdma_tim4_ch3.Init.Mode = DMA_CIRCULAR;
+    hdma_tim4_ch3.Init.Priority = DMA_PRIORITY_LOW;
+    hdma_tim4_ch3.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_tim4_ch3) != HAL_OK) {
+        Error_Handler();
+    }
+    // No half transfer callback, so only the end of a lap interrupts
+    hdma_tim4_ch3.XferCpltCallback = capture_acquisition_lap_from_isr;
+    if (HAL_DMA_Start_IT(&hdma_tim4_ch3, (uint32_t)(uintptr_t)&TIM4->CCR3, (uint32_t)(uintptr_t)capture_buffer,
+                         CAPTURE_ACQUISITION_CAPTURES) != HAL_OK) {
+        Error_Handler();
+    }
+    HAL_NVIC_SetPriority(TIM4_IRQn, IRQ_PRIORITY_ACQUIRE, 0);
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+}
+
+// Function to start the counter
+void capture_acquisition_start(void) {
+    if (!capture_enabled) {
+        return;
+    }
+    TIM4->CR1 |= TIM_CR1_CEN;
+}
+
+// DMA transfer complete callback, the buffer starts its next lap
+static void capture_acquisition_lap_from_isr(DMA_HandleTypeDef *hdma) {
+    (void)hdma;
+    capture_laps++;
+}
+
+// Function to count a wrap of the counter
+void capture_acquisition_wrap_from_isr(void) {
+    if ((TIM4->SR & TIM_SR_UIF) != 0) {
+        TIM4->SR = (uint32_t)~TIM_SR_UIF;
+        capture_wraps++;
+    }
+}
+
+// Function to take the rate of the edges since the previous sample
+float capture_acquisition_sample(sensor_t channel) {
+    uint32_t laps, wraps, remaining, count;
+
+    // One view of the laps, the DMA position, the wraps and the counter: the
+    // interrupts are above the producer, so it reads again until neither count
+    // moved and no interrupt that would move one is pending
+    do {
+        laps = capture_laps;
+        wraps = capture_wraps;
+        remaining = __HAL_DMA_GET_COUNTER(&hdma_tim4_ch3);
+        count = TIM4->CNT;
+    } while (laps != capture_laps || wraps != capture_wraps || (TIM4->SR & TIM_SR_UIF) != 0 ||
+             __HAL_DMA_GET_FLAG(&hdma_tim4_ch3, __HAL_DMA_GET_TC_FLAG_INDEX(&hdma_tim4_ch3)) != 0);
+
+    uint32_t position = CAPTURE_ACQUISITION_CAPTURES - remaining;
+    uint32_t total = laps * CAPTURE_ACQUISITION_CAPTURES + position;
+    uint32_t now = (wraps << 16) | count;
+    if (total == 0) {
+        return 0.0f;
+    }
+    // The newest edge is less than one wrap old while the output runs above the minimum rate
+    uint16_t newest = capture_buffer[(position + CAPTURE_ACQUISITION_CAPTURES - 1U) % CAPTURE_ACQUISITION_CAPTURES];
+    uint32_t edge = now - (uint16_t)(count - newest);
+
+    if (!capture_referenced) {
+        // The first edge seen only starts the interval
+        capture_referenced = true;
+    } else if (total != capture_last_total) {
+        capture_period_counts = (float)(edge - capture_last_edge) /
+                                (float)((total - capture_last_total) * CAPTURE_ACQUISITION_EDGES_PER_CAPTURE);
+    } else {
+        // No edge since the last sample, the period is at least the time since the newest one
+        float open_counts = (float)(now - capture_last_edge) / (float)CAPTURE_ACQUISITION_EDGES_PER_CAPTURE;
+        if (open_counts > capture_period_counts) {
+            capture_period_counts = open_counts;
+        }
+        edge = capture_last_edge;
+    }
+    capture_last_total = total;
+    capture_last_edge = edge;
+
+    if (capture_period_counts <= 0.0f) {
+        return 0.0f;
+    }
+    if (sensor_registry[channel].capture_period) {
+        return capture_period_counts * (1000000.0f / (float)CAPTURE_ACQUISITION_COUNTER_HZ);
+    }
+    return (float)CAPTURE_ACQUISITION_COUNTER_HZ / capture_period_counts;
+}
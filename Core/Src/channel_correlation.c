@@ -0,0 +1,133 @@
+/**
+  ******************************************************************************
+  * @file    channel_correlation.c
+  * @brief   Streaming covariance and correlation between pairs of channels.
+  *
+  *          A receiver that wants to know how humidity follows the light
+  *          needs both series, and the statistics frames only carry the
+  *          moments of each channel alone. The producer keeps the co-moment
+  *          of every pair in correlation_pairs instead, with the same
+  *          single precision Welford update as the window statistics, over
+  *          the samples it stores. Nothing is buffered: each pair holds the
+  *          newest unused sample of both channels and takes the pair in as
+  *          soon as the second one arrives, so channels read at different
+  *          rates are paired at the rate of the slower one.
+  *
+  *          The co-moments cover one report interval. At the end of a batch
+  *          the producer publishes them into the slot the consumer does not
+  *          read and starts over, like the quantiles, and the consumer sends
+  *          the covariance and correlation of every pair after the
+  *          statistics of the same report.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "channel_correlation.h"
+#include "main.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Exported variables --------------------------------------------------------*/
+const correlation_pair_t correlation_pairs[] = {
+    // Light on or off against the room climate and against motion
+    { SENSOR_HUMIDITY_AND_HEAT, SENSOR_LDR },
+    { SENSOR_PIR, SENSOR_LDR },
+#if SENSOR_HEAT_CHANNEL
+    { SENSOR_HUMIDITY_AND_HEAT, SENSOR_HEAT },
+    { SENSOR_HEAT, SENSOR_LDR },
+#endif
+};
+const uint32_t correlation_pair_count = sizeof(correlation_pairs) / sizeof(correlation_pairs[0]);
+
+/* Private types -------------------------------------------------------------*/
+// A pair of the interval being sampled, owned by producer_task
+typedef struct {
+    comoment_t stats;
+    float x;
+    float y;
+    bool fresh_x; // x holds a sample not added yet
+    bool fresh_y;
+} correlation_state_t;
+
+/* Private variables ---------------------------------------------------------*/
+static correlation_state_t correlation_state[CORRELATION_PAIRS_MAX];
+// Co-moments of the last two intervals. The producer fills the slot that is
+// not published and then publishes it, the consumer reads the published slot,
+// which is not written again until a whole batch later.
+static comoment_t correlation_published[2][CORRELATION_PAIRS_MAX];
+static volatile uint32_t correlation_published_slot;
+
+// Function to check the pairs and clear the co-moments
+void channel_correlation_init(void) {
+    if (correlation_pair_count > CORRELATION_PAIRS_MAX) {
+        Error_Handler();
+    }
+    for (uint32_t i = 0; i < correlation_pair_count; ++i) {
+        if (correlation_pairs[i].x >= SENSOR_COUNT || correlation_pairs[i].y >= SENSOR_COUNT ||
+            correlation_pairs[i].x == correlation_pairs[i].y) {
+            Error_Handler();
+        }
+    }
+    memset(correlation_state, 0, sizeof(correlation_state));
+    for (uint32_t i = 0; i < CORRELATION_PAIRS_MAX; ++i) {
+        comoment_reset(&correlation_state[i].stats);
+        comoment_reset(&correlation_published[0][i]);
+        comoment_reset(&correlation_published[1][i]);
+    }
+    correlation_published_slot = 0;
+}
+
+// Function to pair a stored sample with the newest one of the other channel
+void channel_correlation_sample(sensor_t channel, float value) {
+    for (uint32_t i = 0; i < correlation_pair_count; ++i) {
+        correlation_state_t *state = &correlation_state[i];
+        if (correlation_pairs[i].x == channel) {
+            state->x = value;
+            state->fresh_x = true;
+        } else if (correlation_pairs[i].y == channel) {
+            state->y = value;
+            state->fresh_y = true;
+        } else {
+            continue;
+        }
+        if (state->fresh_x && state->fresh_y) {
+            comoment_add(&state->stats, state->x, state->y);
+            state->fresh_x = false;
+            state->fresh_y = false;
+        }
+    }
+}
+
+// Function to publish the co-moments of the finished interval
+void channel_correlation_publish(void) {
+    uint32_t slot = correlation_published_slot ^ 1U;
+
+    for (uint32_t i = 0; i < correlation_pair_count; ++i) {
+        correlation_published[slot][i] = correlation_state[i].stats;
+        comoment_reset(&correlation_state[i].stats);
+    }
+    correlation_published_slot = slot;
+}
+
+// Function to build the frame of the published interval
+uint16_t channel_correlation_build(correlation_frame_t *frame, uint32_t timestamp) {
+    const comoment_t *published = correlation_published[correlation_published_slot];
+
+    frame->type = CORRELATION_FRAME_TYPE;
+    frame->version = CORRELATION_FRAME_VERSION;
+    frame->pair_count = (uint8_t)correlation_pair_count;
+    frame->reserved = 0;
+    frame->timestamp = timestamp;
+    for (uint32_t i = 0; i < correlation_pair_count; ++i) {
+        correlation_entry_t *entry = &frame->pairs[i];
+        entry->channel_x = (uint8_t)correlation_pairs[i].x;
+        entry->channel_y = (uint8_t)correlation_pairs[i].y;
+        entry->correlation = (int16_t)lrintf(comoment_correlation(&published[i]) * 32767.0f);
+        entry->count = (uint16_t)(published[i].count > 0xFFFFU ? 0xFFFFU : published[i].count);
+        entry->reserved = 0;
+        entry->covariance = comoment_covariance(&published[i]);
+    }
+    return (uint16_t)(offsetof(correlation_frame_t, pairs) + correlation_pair_count * sizeof(correlation_entry_t));
+}
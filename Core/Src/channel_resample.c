@@ -0,0 +1,232 @@
+/**
+  ******************************************************************************
+  * @file    channel_resample.c
+  * @brief   Streaming resampler of the channel rings onto a common timebase.
+  *
+  *          Every channel is stored at its own rate and phase: the PIR at
+  *          each tick, the slow I2C sensors every few ticks, a FIFO sensor
+  *          in bursts of back-dated reads. A receiver that relates two
+  *          channels needs their values at the same instants, so this
+  *          module reads the rings once more and computes a row of every
+  *          channel at each multiple of CHANNEL_RESAMPLE_PERIOD_MS.
+  *
+  *          Its reader of each ring does not gate the producer and keeps
+  *          only the newest sample at or before the next row, plus the ones
+  *          after it. Each row advances the reader over the samples it has
+  *          passed, so the work is O(1) per output sample amortized, and
+  *          nothing is copied: the samples stay in the ring slots they were
+  *          published to. With the zero-order hold a row is ready as soon as
+  *          the pipeline has passed its time. The linear method waits for
+  *          the sample after the row, up to CHANNEL_RESAMPLE_WAIT_MS, and a
+  *          channel that has not been heard from for that long is still
+  *          given a value but is marked not valid.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "channel_resample.h"
+
+#if CHANNEL_RESAMPLE
+#include "sensor_registry.h"
+#include "stats_frame.h"
+
+/* Private variables ---------------------------------------------------------*/
+static sample_ring_t *resample_rings;
+static uint32_t resample_next_ms;
+static bool resample_started;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool channel_resample_start(uint16_t channel_mask);
+static bool channel_resample_value(sensor_t channel, uint32_t row_ms, uint32_t now_ms, float *value, bool *valid);
+
+// Function to attach the resampler to every ring
+void channel_resample_init(sample_ring_t *rings) {
+    resample_rings = rings;
+    resample_started = false;
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        sample_ring_attach(&rings[channel], SAMPLE_READER_RESAMPLE, false);
+    }
+}
+
+// Function to place the first row at the first period after the oldest
+// sample of the channel that started last, false while no channel has one
+static bool channel_resample_start(uint16_t channel_mask) {
+    uint32_t start = 0;
+    bool any = false;
+
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        sample_ring_t *ring = &resample_rings[channel];
+        if ((channel_mask & (1U << channel)) == 0) {
+            continue;
+        }
+        sample_ring_catch_up(ring, SAMPLE_READER_RESAMPLE);
+        if (sample_ring_count(ring, SAMPLE_READER_RESAMPLE) == 0) {
+            continue;
+        }
+        uint32_t oldest = sample_ring_timestamp(ring, SAMPLE_READER_RESAMPLE, 0);
+        if (!any || (int32_t)(oldest - start) > 0) {
+            start = oldest;
+        }
+        any = true;
+    }
+    if (!any) {
+        return false;
+    }
+    resample_next_ms = (start + CHANNEL_RESAMPLE_PERIOD_MS - 1U) / CHANNEL_RESAMPLE_PERIOD_MS *
+                       CHANNEL_RESAMPLE_PERIOD_MS;
+    resample_started = true;
+    return true;
+}
+
+// Function to compute the value of one channel at row_ms, false while the
+// channel may still get a sample that changes it
+static bool channel_resample_value(sensor_t channel, uint32_t row_ms, uint32_t now_ms, float *value, bool *valid) {
+    sample_ring_t *ring = &resample_rings[channel];
+    uint32_t count;
+
+    sample_ring_catch_up(ring, SAMPLE_READER_RESAMPLE);
+    count = sample_ring_count(ring, SAMPLE_READER_RESAMPLE);
+    // Keep the newest sample at or before the row, let the older ones go
+    while (count >= 2 && (int32_t)(sample_ring_timestamp(ring, SAMPLE_READER_RESAMPLE, 1) - row_ms) <= 0) {
+        sample_ring_discard(ring, SAMPLE_READER_RESAMPLE, 1);
+        count--;
+    }
+
+    bool waited = (int32_t)(now_ms - row_ms) >= (int32_t)CHANNEL_RESAMPLE_WAIT_MS;
+    if (count == 0) {
+        // Never heard from, or all it had was lapped
+        *value = 0.0f;
+        *valid = false;
+        return waited;
+    }
+
+    uint32_t before_ms = sample_ring_timestamp(ring, SAMPLE_READER_RESAMPLE, 0);
+    float before = (float)sample_ring_value(ring, SAMPLE_READER_RESAMPLE, 0);
+    bool ready;
+    *value = before;
+    if ((int32_t)(before_ms - row_ms) > 0) {
+        // The channel started after the row, nothing is known of it then
+        *valid = false;
+        ready = true;
+    } else {
+        *valid = row_ms - before_ms <= CHANNEL_RESAMPLE_WAIT_MS;
+        if (count >= 2) {
+#if CHANNEL_RESAMPLE_METHOD == CHANNEL_RESAMPLE_LINEAR
+            uint32_t after_ms = sample_ring_timestamp(ring, SAMPLE_READER_RESAMPLE, 1);
+            float after = (float)sample_ring_value(ring, SAMPLE_READER_RESAMPLE, 1);
+            *value = before + (after - before) * (float)(row_ms - before_ms) / (float)(after_ms - before_ms);
+#endif
+            ready = true;
+        } else {
+#if CHANNEL_RESAMPLE_METHOD == CHANNEL_RESAMPLE_LINEAR
+            // No sample after the row yet, hold the last one once the wait is over
+            ready = waited;
+#else
+            // Another channel is past the row, the producer published its tick already
+            ready = (int32_t)(now_ms - row_ms) > 0;
+#endif
+        }
+    }
+    // Lapped while reading, the slots may hold newer samples
+    if (sample_ring_catch_up(ring, SAMPLE_READER_RESAMPLE) != 0) {
+        return false;
+    }
+#if STATS_FIXED_POINT
+    *value *= sensor_registry[channel].fixed_scale;
+#endif
+    return ready;
+}
+
+// Function to compute the next aligned row once every channel of the mask can give its value
+bool channel_resample_next(uint16_t channel_mask, uint32_t *time_ms, float *values, uint16_t *valid_mask) {
+    uint32_t now_ms = 0;
+    bool any = false;
+    uint32_t index = 0;
+
+    if (!resample_started && !channel_resample_start(channel_mask)) {
+        return false;
+    }
+    // The newest sample of any channel is how far the pipeline got
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        const sample_ring_t *ring = &resample_rings[channel];
+        uint32_t count = sample_ring_count(ring, SAMPLE_READER_RESAMPLE);
+        if ((channel_mask & (1U << channel)) == 0 || count == 0) {
+            continue;
+        }
+        uint32_t newest = sample_ring_timestamp(ring, SAMPLE_READER_RESAMPLE, count - 1);
+        if (!any || (int32_t)(newest - now_ms) > 0) {
+            now_ms = newest;
+        }
+        any = true;
+    }
+    if (!any) {
+        return false;
+    }
+
+    *valid_mask = 0;
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        bool valid;
+        if ((channel_mask & (1U << channel)) == 0) {
+            continue;
+        }
+        if (!channel_resample_value((sensor_t)channel, resample_next_ms, now_ms, &values[index++], &valid)) {
+            return false;
+        }
+        *valid_mask |= valid ? (uint16_t)(1U << channel) : 0U;
+    }
+    *time_ms = resample_next_ms;
+    resample_next_ms += CHANNEL_RESAMPLE_PERIOD_MS;
+    return true;
+}
+
+// Function to fill a resample frame with the rows that are ready
+uint16_t channel_resample_build(resample_frame_t *frame, uint16_t channel_mask) {
+    uint32_t channels = 0;
+
+    channel_mask &= (uint16_t)((1UL << SENSOR_COUNT) - 1U);
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        channels += (channel_mask >> channel) & 1U;
+    }
+    if (channels == 0) {
+        return 0;
+    }
+
+    uint32_t row_words = 1U + channels;
+    uint32_t max_rows = RESAMPLE_FRAME_WORDS / row_words;
+    uint32_t rows = 0;
+    max_rows = max_rows > UINT8_MAX ? UINT8_MAX : max_rows;
+    while (rows < max_rows) {
+        float values[SENSOR_COUNT];
+        uint32_t time_ms;
+        uint16_t valid_mask;
+        if (!channel_resample_next(channel_mask, &time_ms, values, &valid_mask)) {
+            break;
+        }
+        if (rows == 0) {
+            frame->first_ms = time_ms;
+        }
+        uint16_t *row = &frame->rows[rows * row_words];
+        uint32_t index = 0;
+        row[0] = valid_mask;
+        for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+            if ((channel_mask & (1U << channel)) != 0) {
+                bool valid = (valid_mask & (1U << channel)) != 0;
+                row[1U + index] = stats_frame_quantize((sensor_t)channel, valid ? values[index] : 0.0f);
+                index++;
+            }
+        }
+        rows++;
+    }
+    if (rows == 0) {
+        return 0;
+    }
+
+    frame->type = RESAMPLE_FRAME_TYPE;
+    frame->version = RESAMPLE_FRAME_VERSION;
+    frame->encoding = STATS_FRAME_ENCODING;
+    frame->row_count = (uint8_t)rows;
+    frame->channel_mask = channel_mask;
+    frame->period_ms = (uint16_t)CHANNEL_RESAMPLE_PERIOD_MS;
+    return (uint16_t)(RESAMPLE_FRAME_HEADER_SIZE + 2U * rows * row_words);
+}
+#endif /* CHANNEL_RESAMPLE */
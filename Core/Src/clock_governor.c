@@ -0,0 +1,178 @@
+/**
+  ******************************************************************************
+  * @file    clock_governor.c
+  * @brief   Core clock scaling between two levels, driven by CPU load and transmit backlog.
+  *
+  *          Every CLOCK_GOVERNOR_PERIOD_MS the governor reads how long the
+  *          idle task ran on the 1 MHz run-time counter. A busy share above
+  *          CLOCK_GOVERNOR_UP_PERMILLE at 84 MHz, or half of the transmit
+  *          queue waiting for the UART, raises HCLK to 168 MHz at once. It
+  *          drops again after CLOCK_GOVERNOR_HOLD_PERIODS intervals in a row
+  *          below CLOCK_GOVERNOR_DOWN_PERMILLE with no backlog.
+  *
+  *          The PLL keeps running at 168 MHz and only the bus prescalers
+  *          change, in one write of RCC_CFGR. The two levels are chosen so
+  *          APB1 stays at 42 MHz and its timers at 84 MHz: USART2, the
+  *          I2C buses, TIM2, TIM3 and TIM5 see no change, so a byte or a
+  *          transfer in flight is not disturbed and the baud rate, the I2C
+  *          timing and the timestamps need nothing re-derived. APB2 stays
+  *          at 84 MHz for the ADC, only its timers change clock: TIM1, the
+  *          HAL time base, is set up again, the TIM8 prescaler takes the new
+  *          clock at its next update and SysTick is reloaded for the kernel
+  *          tick. The flash wait states go up before the clock does and down
+  *          after it. The voltage scale stays at 1, as the regulator output
+  *          is only changed safely with the PLL off on this family.
+  *
+  *          Times measured on the DWT cycle counter are converted with the
+  *          SystemCoreClock of the moment, a span across a switch is off by
+  *          up to a factor of two once.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "clock_governor.h"
+
+#if CLOCK_GOVERNOR
+#include "adc_acquisition.h"
+#include "cmsis_os.h"
+#include "energy_profile.h"
+#include "pipeline_priorities.h"
+#include "stack_profile.h"
+#include "swo_trace.h"
+#include "uart_tx.h"
+
+/* External variables --------------------------------------------------------*/
+// Defined by the port, not declared in its headers
+extern void vPortSetupTimerInterrupt(void);
+#if ADC_ACQUISITION
+extern TIM_HandleTypeDef htim8;
+#endif
+
+/* Private defines -----------------------------------------------------------*/
+#ifndef CLOCK_GOVERNOR_STACK_SIZE
+#define CLOCK_GOVERNOR_STACK_SIZE 128
+#endif
+// With the command task, the choice applies before the next batch is built
+#define CLOCK_GOVERNOR_PRIORITY TASK_PRIORITY_CONTROL
+// Bursts waiting for the DMA that raise the clock, the serializing falls behind the link
+#define CLOCK_GOVERNOR_BACKLOG_BURSTS (UART_TX_QUEUE_LENGTH / 2U)
+
+/* Private types -------------------------------------------------------------*/
+typedef enum {
+    CLOCK_GOVERNOR_FULL = 0, // 168 MHz, 5 flash wait states
+    CLOCK_GOVERNOR_HALF,     // 84 MHz, 2 flash wait states
+    CLOCK_GOVERNOR_LEVEL_COUNT
+} clock_governor_level_t;
+
+// Prescalers and flash latency of a level, the PLL is the same for both
+typedef struct {
+    uint32_t cfgr;    // HPRE, PPRE1 and PPRE2 of RCC_CFGR
+    uint32_t latency; // FLASH_LATENCY_x
+} clock_governor_setting_t;
+
+/* Private variables ---------------------------------------------------------*/
+// APB1 is 42 MHz at both levels: 168 / 4 and 84 / 2
+static const clock_governor_setting_t clock_governor_settings[CLOCK_GOVERNOR_LEVEL_COUNT] = {
+    [CLOCK_GOVERNOR_FULL] = { RCC_CFGR_HPRE_DIV1 | RCC_CFGR_PPRE1_DIV4 | RCC_CFGR_PPRE2_DIV2, FLASH_LATENCY_5 },
+    [CLOCK_GOVERNOR_HALF] = { RCC_CFGR_HPRE_DIV2 | RCC_CFGR_PPRE1_DIV2 | RCC_CFGR_PPRE2_DIV1, FLASH_LATENCY_2 },
+};
+static clock_governor_level_t clock_governor_current;
+static TaskHandle_t clock_governor_task_handle;
+static StaticTask_t clock_governor_task_tcb;
+static StackType_t clock_governor_task_stack[CLOCK_GOVERNOR_STACK_SIZE];
+
+/* Private function prototypes -----------------------------------------------*/
+static void clock_governor_task(void *argument);
+static void clock_governor_switch(clock_governor_level_t level);
+
+// Function to create the governor task
+void clock_governor_start(void) {
+    clock_governor_current = CLOCK_GOVERNOR_FULL;
+    clock_governor_task_handle = xTaskCreateStatic(clock_governor_task, "Governor", CLOCK_GOVERNOR_STACK_SIZE, NULL,
+                                                   CLOCK_GOVERNOR_PRIORITY, clock_governor_task_stack,
+                                                   &clock_governor_task_tcb);
+#if STACK_PROFILE
+    stack_profile_track(clock_governor_task_handle, CLOCK_GOVERNOR_STACK_SIZE);
+#endif
+}
+
+// Function to move the core to a level and set up again what runs on its clock
+static void clock_governor_switch(clock_governor_level_t level) {
+    const clock_governor_setting_t *setting = &clock_governor_settings[level];
+
+    taskENTER_CRITICAL();
+    if (setting->latency > __HAL_FLASH_GET_LATENCY()) {
+        // More wait states before the clock goes up
+        __HAL_FLASH_SET_LATENCY(setting->latency);
+        while (__HAL_FLASH_GET_LATENCY() != setting->latency) {
+        }
+    }
+    MODIFY_REG(RCC->CFGR, RCC_CFGR_HPRE | RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2, setting->cfgr);
+    if (setting->latency < __HAL_FLASH_GET_LATENCY()) {
+        __HAL_FLASH_SET_LATENCY(setting->latency);
+    }
+    SystemCoreClockUpdate();
+#if ENERGY_PROFILE
+    // TIM2 runs off PCLK1 times two at both levels and keeps its 1 MHz
+    energy_profile_clock_changed();
+#endif
+
+    // The kernel tick counts HCLK cycles, the tick in progress starts over
+    vPortSetupTimerInterrupt();
+    // TIM1 and TIM8 run at PCLK2 from here on, twice that at the full level
+    HAL_InitTick(uwTickPrio);
+#if ADC_ACQUISITION
+    uint32_t tim_clock = HAL_RCC_GetPCLK2Freq();
+    if ((RCC->CFGR & RCC_CFGR_PPRE2) != RCC_CFGR_PPRE2_DIV1) {
+        tim_clock *= 2U;
+    }
+    // Buffered, the scan trigger runs one period on the old prescaler
+    __HAL_TIM_SET_PRESCALER(&htim8, (tim_clock / 1000000U) - 1U);
+#endif
+#if SWO_TRACE
+    TPI->ACPR = SystemCoreClock / SWO_TRACE_BAUD - 1U;
+#endif
+    clock_governor_current = level;
+    taskEXIT_CRITICAL();
+}
+
+// Governor task, measures the load of each interval and picks the level of the next
+static void clock_governor_task(void *argument) {
+    uint32_t last_time = portGET_RUN_TIME_COUNTER_VALUE();
+    uint32_t last_idle = ulTaskGetIdleRunTimeCounter();
+    uint32_t quiet_periods = 0;
+
+    (void)argument;
+    // Measures on a fixed schedule, the time of a switch does not add up
+    TickType_t wake = xTaskGetTickCount();
+    while (1) {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(CLOCK_GOVERNOR_PERIOD_MS));
+        uint32_t now = portGET_RUN_TIME_COUNTER_VALUE();
+        uint32_t idle = ulTaskGetIdleRunTimeCounter();
+        uint32_t elapsed = now - last_time;
+        uint32_t idle_time = idle - last_idle;
+        last_time = now;
+        last_idle = idle;
+        if (elapsed == 0) {
+            continue;
+        }
+        // Up to 4 s of microseconds, times 1000 still fits in 32 bits
+        uint32_t busy_permille = idle_time >= elapsed ? 0 : 1000U - (idle_time * 1000U) / elapsed;
+        bool backlog = UART_TX_QUEUE_LENGTH - uart_tx_free() >= CLOCK_GOVERNOR_BACKLOG_BURSTS;
+
+        if (clock_governor_current == CLOCK_GOVERNOR_HALF) {
+            if (busy_permille > CLOCK_GOVERNOR_UP_PERMILLE || backlog) {
+                clock_governor_switch(CLOCK_GOVERNOR_FULL);
+            }
+            quiet_periods = 0;
+        } else if (busy_permille < CLOCK_GOVERNOR_DOWN_PERMILLE && !backlog) {
+            if (++quiet_periods >= CLOCK_GOVERNOR_HOLD_PERIODS) {
+                clock_governor_switch(CLOCK_GOVERNOR_HALF);
+                quiet_periods = 0;
+            }
+        } else {
+            quiet_periods = 0;
+        }
+    }
+}
+#endif /* CLOCK_GOVERNOR */
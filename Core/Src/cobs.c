@@ -0,0 +1,59 @@
+/**
+  ******************************************************************************
+  * @file    cobs.c
+  * @brief   Consistent Overhead Byte Stuffing for the UART frames.
+  *
+  *          COBS replaces every 0x00 of a frame by the distance to the next
+  *          one, so 0x00 can delimit frames on the wire. A receiver that
+  *          loses bytes resynchronizes at the next delimiter, and the cost
+  *          is at most one byte per 254.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "cobs.h"
+
+// Function to stuff a frame, each code byte holds the distance to the next zero
+uint32_t cobs_encode(const uint8_t *src, uint32_t size, uint8_t *dst) {
+    uint32_t code_index = 0;
+    uint32_t out = 1;
+    uint8_t code = 1;
+
+    for (uint32_t i = 0; i < size; ++i) {
+        if (src[i] == 0) {
+            dst[code_index] = code;
+            code_index = out++;
+            code = 1;
+            continue;
+        }
+        dst[out++] = src[i];
+        if (++code == 0xFF) {
+            // Longest run without a zero, the next code byte does not stand for one
+            dst[code_index] = code;
+            code_index = out++;
+            code = 1;
+        }
+    }
+    dst[code_index] = code;
+    return out;
+}
+
+// Function to unstuff a frame received between two delimiters
+int32_t cobs_decode(const uint8_t *src, uint32_t size, uint8_t *dst) {
+    uint32_t in = 0;
+    uint32_t out = 0;
+
+    while (in < size) {
+        uint8_t code = src[in++];
+        if (code == 0 || in + code - 1U > size) {
+            return -1;
+        }
+        for (uint8_t i = 1; i < code; ++i) {
+            dst[out++] = src[in++];
+        }
+        if (code != 0xFF && in < size) {
+            dst[out++] = 0;
+        }
+    }
+    return (int32_t)out;
+}
@@ -0,0 +1,447 @@
+/**
+  ******************************************************************************
+  * @file    command_channel.c
+  * @brief   USART2 receive path for runtime configuration commands.
+  *
+  *          USART2_RX runs on DMA1_Stream5 into a circular buffer with
+  *          idle-line detection, so the CPU sees one event per burst of
+  *          bytes (or per half buffer) instead of one interrupt per byte.
+  *          The event handler only splits lines. Every complete line goes
+  *          into a message buffer, with the stamp of its end, and the command
+  *          task parses and applies the lines in order. Back-to-back lines,
+  *          such as a burst of settings followed by a time sync, queue up to
+  *          COMMAND_QUEUE_LINES instead of being dropped while the one before
+  *          is handled. The interrupt copies each line once, whatever the
+  *          rate, and the task sleeps in the message buffer in between.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "command_channel.h"
+#include "cmsis_os.h"
+#include "config_store.h"
+#include "crash_capture.h"
+#include "flash_log.h"
+#include "kernel_trace.h"
+#include "link_route.h"
+#include "pc_profile.h"
+#include "message_buffer.h"
+#include "pipeline_priorities.h"
+#include "pipeline_config.h"
+#include "reliable_link.h"
+#include "rtc_stop.h"
+#include "sample_mailbox.h"
+#include "sensor_sim.h"
+#include "stack_profile.h"
+#include "stats_rollup.h"
+#include "stats_snapshot.h"
+#include "time_base.h"
+#include "time_sync.h"
+#include "uart_tx.h"
+#include "window_dump.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+#ifndef COMMAND_CHANNEL_STACK_SIZE
+#define COMMAND_CHANNEL_STACK_SIZE 256
+#endif
+// Above the consumer, a setting applies before the next batch is built
+#define COMMAND_CHANNEL_PRIORITY TASK_PRIORITY_CONTROL
+
+/* Private types -------------------------------------------------------------*/
+// One queued line, sent up to and including its terminator
+typedef struct {
+    uint32_t stamp; // Time base stamp of the line end, 0 without TIME_BASE
+    char line[COMMAND_LINE_MAX];
+} command_message_t;
+
+// Bytes of a queued message, the message buffer adds its length word
+#define COMMAND_MESSAGE_STORAGE (sizeof(size_t) + sizeof(command_message_t))
+
+/* External variables --------------------------------------------------------*/
+extern UART_HandleTypeDef huart2;
+
+/* Private variables ---------------------------------------------------------*/
+// DMA target, static in SRAM
+static uint8_t command_rx_buffer[COMMAND_RX_BUFFER_SIZE];
+// Position in command_rx_buffer up to which bytes have been handled
+static uint32_t command_rx_read;
+// Line being received, only used by the event handler
+static command_message_t command_line;
+static uint32_t command_line_length;
+static bool command_line_too_long;
+// Lines waiting for the command task
+static MessageBufferHandle_t command_queue;
+static StaticMessageBuffer_t command_queue_storage;
+static uint8_t command_queue_buffer[COMMAND_QUEUE_LINES * COMMAND_MESSAGE_STORAGE + 1U];
+static volatile uint32_t command_drop_count;
+
+static StaticTask_t command_task_tcb;
+static StackType_t command_task_stack[COMMAND_CHANNEL_STACK_SIZE];
+
+#if STATS_SNAPSHOT
+// Set by a "stats" line, the latest statistics follow its reply
+static bool command_stats_requested;
+#endif
+#if SAMPLE_MAILBOX
+// Set by a "latest" line, the newest sample of every channel follows its reply
+static bool command_latest_requested;
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+static void command_channel_receive(void);
+static void command_channel_byte_from_isr(char byte, BaseType_t *woken);
+static void command_channel_task(void *argument);
+#if STATS_SNAPSHOT
+static void command_channel_send_stats(void);
+#endif
+#if SAMPLE_MAILBOX
+static void command_channel_send_latest(void);
+#endif
+static void command_channel_execute(char *line, uint32_t stamp);
+#if RELIABLE_LINK
+static bool command_channel_ack(const char *line);
+#endif
+static command_status_t command_channel_apply(char *line, uint32_t stamp);
+
+// Function to create the command task and start the circular reception
+void command_channel_start(void) {
+    command_rx_read = 0;
+    command_line_length = 0;
+    command_line_too_long = false;
+    command_drop_count = 0;
+    command_queue = xMessageBufferCreateStatic(sizeof(command_queue_buffer), command_queue_buffer,
+                                               &command_queue_storage);
+    TaskHandle_t task = xTaskCreateStatic(command_channel_task, "Command", COMMAND_CHANNEL_STACK_SIZE, NULL,
+                                          COMMAND_CHANNEL_PRIORITY, command_task_stack, &command_task_tcb);
+#if STACK_PROFILE
+    stack_profile_track(task, COMMAND_CHANNEL_STACK_SIZE);
+#else
+    (void)task;
+#endif
+    command_channel_receive();
+}
+
+// Function to (re)arm the idle-line DMA reception
+static void command_channel_receive(void) {
+    command_rx_read = 0;
+    if (HAL_UARTEx_ReceiveToIdle_DMA(&huart2, command_rx_buffer, sizeof(command_rx_buffer)) != HAL_OK) {
+        Error_Handler();
+    }
+}
+
+// Function to restart the reception after a line error
+void command_channel_error_from_isr(void) {
+    if (huart2.RxState == HAL_UART_STATE_READY) {
+        command_line_length = 0;
+        command_channel_receive();
+    }
+}
+
+// Function to split received bytes into lines
+static void command_channel_byte_from_isr(char byte, BaseType_t *woken) {
+    if (byte != '\r' && byte != '\n') {
+        if (command_line_length < COMMAND_LINE_MAX - 1) {
+            command_line.line[command_line_length++] = byte;
+        } else {
+            command_line_too_long = true;
+        }
+        return;
+    }
+    if (command_line_length == 0 && !command_line_too_long) {
+        // Second half of a CR LF pair, or an empty line
+        return;
+    }
+
+    // A line that finds the queue full gets no reply
+    if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) {
+        // An over-long line is passed on empty so that it is answered as unknown
+        uint32_t length = command_line_too_long ? 0 : command_line_length;
+        command_line.line[length] = '\0';
+#if TIME_BASE
+        command_line.stamp = time_base_stamp();
+#else
+        command_line.stamp = 0;
+#endif
+        size_t size = offsetof(command_message_t, line) + length + 1U;
+        if (xMessageBufferSendFromISR(command_queue, &command_line, size, woken) != size) {
+            command_drop_count++;
+        }
+    }
+    command_line_length = 0;
+    command_line_too_long = false;
+}
+
+// Reception event: idle line, half or full buffer. size is the write position.
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t size) {
+    BaseType_t woken = pdFALSE;
+
+    if (huart->Instance != USART2) {
+        return;
+    }
+    for (; command_rx_read < size; ++command_rx_read) {
+        command_channel_byte_from_isr((char)command_rx_buffer[command_rx_read], &woken);
+    }
+    if (command_rx_read >= sizeof(command_rx_buffer)) {
+        // The circular DMA wrapped, the next event counts from the start
+        command_rx_read = 0;
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+// Function to parse one line and change the setting it names, stamp is the
+// time base stamp of its line end
+static command_status_t command_channel_apply(char *line, uint32_t stamp) {
+    char *context = NULL;
+    char *name = strtok_r(line, " \t", &context);
+    char *argument = strtok_r(NULL, " \t", &context);
+    char *end = NULL;
+    uint32_t value = 0;
+
+    (void)stamp;
+    if (name == NULL) {
+        return COMMAND_STATUS_UNKNOWN;
+    }
+    if (strcmp(name, "config") == 0) {
+        return COMMAND_STATUS_OK;
+    }
+#if STATS_SNAPSHOT
+    if (strcmp(name, "stats") == 0) {
+        command_stats_requested = true;
+        return COMMAND_STATUS_OK;
+    }
+#endif
+#if SAMPLE_MAILBOX
+    if (strcmp(name, "latest") == 0) {
+        command_latest_requested = true;
+        return COMMAND_STATUS_OK;
+    }
+#endif
+    if (argument == NULL) {
+        return COMMAND_STATUS_OUT_OF_RANGE;
+    }
+    value = strtoul(argument, &end, 0);
+    if (*end != '\0') {
+        return COMMAND_STATUS_OUT_OF_RANGE;
+    }
+
+    bool accepted;
+    if (strcmp(name, "window") == 0) {
+        accepted = pipeline_config_set_window_size(value);
+    } else if (strcmp(name, "batch") == 0) {
+        accepted = pipeline_config_set_samples_per_batch(value);
+    } else if (strcmp(name, "period") == 0) {
+        accepted = pipeline_config_set_sample_period(value);
+    } else if (strcmp(name, "channels") == 0) {
+        accepted = pipeline_config_set_channel_mask(value);
+#if TIME_BASE
+    } else if (strcmp(name, "epoch") == 0) {
+        // Optional microseconds within the second
+        char *fraction = strtok_r(NULL, " \t", &context);
+        uint32_t epoch_us = fraction != NULL ? strtoul(fraction, &end, 0) : 0;
+        accepted = (fraction == NULL || *end == '\0') && epoch_us < TIME_BASE_HZ;
+        if (accepted) {
+            time_base_sync(value, epoch_us, stamp);
+        }
+#endif
+#if TIME_SYNC
+    } else if (strcmp(name, "sync") == 0) {
+        // Gateway seconds and microseconds as it sent the line, the sync frame answers
+        char *fraction = strtok_r(NULL, " \t", &context);
+        uint32_t sent_us = fraction != NULL ? strtoul(fraction, &end, 0) : 0;
+        accepted = fraction != NULL && *end == '\0' && sent_us < TIME_BASE_HZ;
+        if (accepted) {
+            time_sync_request((uint64_t)value * TIME_BASE_HZ + sent_us, stamp);
+        }
+    } else if (strcmp(name, "delay") == 0) {
+        // Exchange, then the gateway seconds and microseconds the sync frame arrived at
+        char *seconds = strtok_r(NULL, " \t", &context);
+        uint32_t arrived_s = seconds != NULL ? strtoul(seconds, &end, 0) : 0;
+        bool parsed = seconds != NULL && *end == '\0';
+        char *fraction = strtok_r(NULL, " \t", &context);
+        uint32_t arrived_us = fraction != NULL ? strtoul(fraction, &end, 0) : 0;
+        accepted = parsed && fraction != NULL && *end == '\0' && arrived_us < TIME_BASE_HZ &&
+                   time_sync_complete(value, (uint64_t)arrived_s * TIME_BASE_HZ + arrived_us);
+#endif
+#if RTC_STOP_SAMPLING
+    } else if (strcmp(name, "clock") == 0) {
+        // Unix seconds, the sample times continue from the new calendar
+        accepted = rtc_stop_set_calendar(value);
+#endif
+#if BULK_LINK
+    } else if (strcmp(name, "route") == 0) {
+        // Bit n of the link_traffic_t traffic on the wired link, the rest on BLE
+        accepted = link_route_set(value);
+#endif
+#if FLASH_LOG
+    } else if (strcmp(name, "replay") == 0) {
+        // The records follow the reply, the flash log task sends them
+        flash_log_replay(value);
+        accepted = true;
+#endif
+#if SENSOR_SIMULATION
+    } else if (strcmp(name, "sim") == 0) {
+        // Optional first sequence of a replay
+        char *from = strtok_r(NULL, " \t", &context);
+        uint32_t sequence = from != NULL ? strtoul(from, &end, 0) : 0;
+        accepted = (from == NULL || *end == '\0') && sensor_sim_select(value, sequence);
+    } else if (strcmp(name, "sample") == 0) {
+        // The code may be negative, a full FIFO rejects it so the host can pace the stream
+        char *code = strtok_r(NULL, " \t", &context);
+        long parsed = code != NULL ? strtol(code, &end, 0) : 0;
+        accepted = code != NULL && *end == '\0' && parsed >= INT16_MIN && parsed <= INT16_MAX &&
+                   sensor_sim_inject(value, (int16_t)parsed);
+#endif
+#if STATS_ROLLUP
+    } else if (strcmp(name, "rollup") == 0) {
+        // The consumer sends the level after its next report
+        accepted = stats_rollup_dump(value);
+    } else if (strcmp(name, "query") == 0) {
+        // Channel, then the range in ms on the sample time base
+        char *from = strtok_r(NULL, " \t", &context);
+        uint32_t from_ms = from != NULL ? strtoul(from, &end, 0) : 0;
+        bool parsed = from != NULL && *end == '\0';
+        char *to = strtok_r(NULL, " \t", &context);
+        uint32_t to_ms = to != NULL ? strtoul(to, &end, 0) : 0;
+        accepted = parsed && to != NULL && *end == '\0' && stats_rollup_query(value, from_ms, to_ms);
+#endif
+#if KERNEL_TRACE
+    } else if (strcmp(name, "trace") == 0) {
+        // The ring freezes here, the kernel trace task sends it after the reply
+        accepted = kernel_trace_dump(value);
+#endif
+#if PC_PROFILE
+    } else if (strcmp(name, "profile") == 0) {
+        // The table freezes here, the profiler task sends it after the reply
+        accepted = value <= 1 && pc_profile_dump(value == 1);
+#endif
+#if CONFIG_STORE
+    } else if (strcmp(name, "save") == 0) {
+        // Erases a flash sector, the CPU stalls for the time it takes
+        accepted = value <= 1 && config_store_commit(value == 1 ? CONFIG_STORE_FIELDS_ALL : 0);
+#endif
+#if WINDOW_DUMP
+    } else if (strcmp(name, "dump") == 0) {
+        // The window freezes at the next report, the dump task sends it after the reply
+        accepted = window_dump_request(value);
+#endif
+    } else {
+        return COMMAND_STATUS_UNKNOWN;
+    }
+    return accepted ? COMMAND_STATUS_OK : COMMAND_STATUS_OUT_OF_RANGE;
+}
+
+// Function to apply one line and answer it
+static void command_channel_execute(char *line, uint32_t stamp) {
+    command_reply_frame_t reply;
+#if CRASH_CAPTURE
+    // The first two characters name the command, an empty line stops at the first
+    uint32_t name = (uint8_t)line[0];
+    if (name != 0) {
+        name |= (uint32_t)(uint8_t)line[1] << 8;
+    }
+    crash_capture_trace(CRASH_EVENT_COMMAND, name);
+#endif
+    command_status_t status = command_channel_apply(line, stamp);
+
+    reply.type = COMMAND_REPLY_FRAME_TYPE;
+    reply.status = (uint8_t)status;
+    reply.window_size = (uint16_t)pipeline_config.window_size;
+    reply.samples_per_batch = (uint16_t)pipeline_config.samples_per_batch;
+    // A period of the RTC wakeup can pass 65 s, the reply then shows the largest it can
+    reply.sample_period_ms = pipeline_config.sample_period_ms > UINT16_MAX ? UINT16_MAX
+                                                                           : (uint16_t)pipeline_config.sample_period_ms;
+    reply.channel_mask = (uint16_t)pipeline_config.channel_mask;
+    uart_tx_send((const uint8_t *)&reply, sizeof(reply));
+#if STATS_SNAPSHOT
+    if (command_stats_requested) {
+        command_channel_send_stats();
+        command_stats_requested = false;
+    }
+#endif
+#if SAMPLE_MAILBOX
+    if (command_latest_requested) {
+        command_channel_send_latest();
+        command_latest_requested = false;
+    }
+#endif
+}
+
+#if STATS_SNAPSHOT
+// Function to send the latest published statistics of every channel, nothing
+// before the first report
+static void command_channel_send_stats(void) {
+    stats_snapshot_t snapshot;
+    stats_frame_t frame;
+
+    if (!stats_snapshot_read(&snapshot)) {
+        return;
+    }
+    uint16_t size = stats_frame_encode(&frame, (uint16_t)snapshot.sequence, snapshot.timestamp,
+                                       (uint16_t)((1U << SENSOR_COUNT) - 1U), snapshot.stats);
+    frame.type = STATS_SNAPSHOT_FRAME_TYPE;
+    uart_tx_send((const uint8_t *)&frame, size);
+}
+#endif
+
+#if SAMPLE_MAILBOX
+// Function to send the newest sample of every channel, nothing before the
+// first tick
+static void command_channel_send_latest(void) {
+    sample_mailbox_frame_t frame;
+    const sample_row_t *row = sample_mailbox_latest(SAMPLE_MAILBOX_COMMAND);
+
+    if (row == NULL) {
+        return;
+    }
+    uint16_t size = sample_mailbox_frame(&frame, row);
+    uart_tx_send((const uint8_t *)&frame, size);
+}
+#endif
+
+#if RELIABLE_LINK
+// Function to pass an "ack <newest> [<received>]" line on, false for other lines
+static bool command_channel_ack(const char *line) {
+    char *end = NULL;
+
+    if (strncmp(line, "ack ", 4) != 0) {
+        return false;
+    }
+    unsigned long newest = strtoul(&line[4], &end, 0);
+    // Without the bitmap every earlier frame arrived
+    unsigned long received = *end != '\0' ? strtoul(end, &end, 0) : 0xFFFFFFFFUL;
+    if (*end == '\0' && newest <= UINT16_MAX) {
+        reliable_link_ack((uint16_t)newest, (uint32_t)received);
+    }
+    return true;
+}
+#endif
+
+// Function to handle the queued lines in order
+static void command_channel_task(void *argument) {
+    command_message_t message;
+
+    (void)argument;
+    while (1) {
+        size_t size = xMessageBufferReceive(command_queue, &message, sizeof(message), portMAX_DELAY);
+        if (size <= offsetof(command_message_t, line)) {
+            continue;
+        }
+#if RELIABLE_LINK
+        // Acknowledgements come at the report rate, they get no reply
+        if (command_channel_ack(message.line)) {
+            continue;
+        }
+#endif
+        // The terminator was sent with the line
+        command_channel_execute(message.line, message.stamp);
+    }
+}
+
+// Function to read the number of lines dropped because the queue was full
+uint32_t command_channel_dropped(void) {
+    return command_drop_count;
+}
@@ -0,0 +1,161 @@
+/**
+  ******************************************************************************
+  * @file    config_store.c
+  * @brief   Runtime settings kept over resets in two dedicated flash sectors.
+  *
+  *          The settings changed over the command channel live in RAM and
+  *          a reset falls back to the build defaults. A save commits them as
+  *          one binary record, and the boot takes the record where it lies
+  *          in flash: a CRC over a few words and one setter call per
+  *          setting, nothing to parse and nothing to copy first.
+  *
+  *          The record is double buffered over two small sectors. A commit
+  *          erases the sector that does not hold the current record and
+  *          programs the new one there with a higher sequence, its CRC word
+  *          last. Until that word is in, the old record is the valid one
+  *          with the highest sequence, so a reset at any point of a commit
+  *          boots with either the old settings or the new ones, never a mix.
+  *          Each commit erases one sector, alternating, so both wear alike
+  *          and a 16 KB sector outlasts any number of saves made by hand.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "config_store.h"
+
+#if CONFIG_STORE
+#include "cmsis_os.h"
+#include "crc_unit.h"
+#include "flash_log.h"
+#include "main.h"
+#include "pipeline_config.h"
+#include <stddef.h>
+
+/* Private variables ---------------------------------------------------------*/
+// Sector of the current record, CONFIG_STORE_SECTOR_COUNT when none is valid.
+// Written at boot and by the commits of the command task.
+static uint32_t config_store_current = CONFIG_STORE_SECTOR_COUNT;
+
+/* Private function prototypes -----------------------------------------------*/
+static const config_store_record_t *config_store_at(uint32_t sector);
+static bool config_store_valid(const config_store_record_t *record);
+static bool config_store_write(uint32_t sector, const config_store_record_t *record);
+
+// Function to find the current record and apply its settings
+uint32_t config_store_init(void) {
+    uint32_t applied = 0;
+
+    for (uint32_t sector = 0; sector < CONFIG_STORE_SECTOR_COUNT; ++sector) {
+        const config_store_record_t *record = config_store_at(sector);
+        if (config_store_valid(record) &&
+            (config_store_current == CONFIG_STORE_SECTOR_COUNT ||
+             (int32_t)(record->sequence - config_store_at(config_store_current)->sequence) > 0)) {
+            config_store_current = sector;
+        }
+    }
+    const config_store_record_t *record = config_store_record();
+    if (record == NULL) {
+        return 0;
+    }
+    // The batch before the window, a longer window may only fit with the stored batch
+    if ((record->fields & CONFIG_STORE_FIELD_BATCH) != 0) {
+        applied += pipeline_config_set_samples_per_batch(record->samples_per_batch);
+    }
+    if ((record->fields & CONFIG_STORE_FIELD_WINDOW) != 0) {
+        applied += pipeline_config_set_window_size(record->window_size);
+    }
+    if ((record->fields & CONFIG_STORE_FIELD_PERIOD) != 0) {
+        applied += pipeline_config_set_sample_period(record->sample_period_ms);
+    }
+    if ((record->fields & CONFIG_STORE_FIELD_CHANNELS) != 0) {
+        applied += pipeline_config_set_channel_mask(record->channel_mask);
+    }
+    return applied;
+}
+
+// Function to give the current record in flash
+const config_store_record_t *config_store_record(void) {
+    return config_store_current < CONFIG_STORE_SECTOR_COUNT ? config_store_at(config_store_current) : NULL;
+}
+
+// Function to commit the current settings, or none, to the other sector
+bool config_store_commit(uint32_t fields) {
+    const config_store_record_t *current = config_store_record();
+    config_store_record_t record;
+
+    if (fields != 0 && fields != CONFIG_STORE_FIELDS_ALL) {
+        return false;
+    }
+    record.magic = CONFIG_STORE_MAGIC;
+    record.version = CONFIG_STORE_VERSION;
+    record.size = sizeof(record);
+    record.sequence = current != NULL ? current->sequence + 1U : 1U;
+    record.fields = fields;
+    record.window_size = pipeline_config.window_size;
+    record.samples_per_batch = pipeline_config.samples_per_batch;
+    record.sample_period_ms = pipeline_config.sample_period_ms;
+    record.channel_mask = pipeline_config.channel_mask;
+    // The CRC unit is shared with the transmit path, the critical section serializes it
+    taskENTER_CRITICAL();
+    record.crc = crc_unit_calculate((const uint8_t *)&record, offsetof(config_store_record_t, crc));
+    taskEXIT_CRITICAL();
+
+    uint32_t sector = current != NULL ? (config_store_current + 1U) % CONFIG_STORE_SECTOR_COUNT : 0;
+    if (!config_store_write(sector, &record)) {
+        return false;
+    }
+    config_store_current = sector;
+    return true;
+}
+
+// Function to map the record slot at the start of a sector
+static const config_store_record_t *config_store_at(uint32_t sector) {
+    return (const config_store_record_t *)(uintptr_t)(CONFIG_STORE_BASE + sector * CONFIG_STORE_SECTOR_SIZE);
+}
+
+// Function to check a record of this build in place. Before the scheduler
+// starts, or with the CRC unit held.
+static bool config_store_valid(const config_store_record_t *record) {
+    return record->magic == CONFIG_STORE_MAGIC && record->version == CONFIG_STORE_VERSION &&
+           record->size == sizeof(*record) &&
+           record->crc == crc_unit_calculate((const uint8_t *)record, offsetof(config_store_record_t, crc));
+}
+
+// Function to erase a sector and program a record at its start, the CRC word last
+static bool config_store_write(uint32_t sector, const config_store_record_t *record) {
+    FLASH_EraseInitTypeDef erase = {
+        .TypeErase = FLASH_TYPEERASE_SECTORS,
+        .Sector = CONFIG_STORE_SECTOR_FIRST + sector,
+        .NbSectors = 1,
+        .VoltageRange = FLASH_VOLTAGE_RANGE_3
+    };
+    const uint32_t *words = (const uint32_t *)record;
+    uint32_t address = (uint32_t)(uintptr_t)config_store_at(sector);
+    uint32_t sector_error = 0;
+    bool ok;
+
+#if FLASH_LOG
+    // The log programs the same bank, its flash sequences must not interleave with these
+    flash_log_lock();
+#endif
+    HAL_FLASH_Unlock();
+    ok = HAL_FLASHEx_Erase(&erase, &sector_error) == HAL_OK;
+    for (uint32_t i = 0; i < sizeof(*record) / 4U && ok; ++i) {
+        ok = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address + 4U * i, words[i]) == HAL_OK;
+    }
+    HAL_FLASH_Lock();
+    // The data cache may still hold the erased words
+    FLASH_FlushCaches();
+#if FLASH_LOG
+    flash_log_unlock();
+#endif
+    if (!ok) {
+        return false;
+    }
+    // Read back as the next boot will
+    taskENTER_CRITICAL();
+    ok = config_store_valid(config_store_at(sector));
+    taskEXIT_CRITICAL();
+    return ok;
+}
+#endif /* CONFIG_STORE */
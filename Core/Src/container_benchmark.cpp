@@ -0,0 +1,247 @@
+/**
+  ******************************************************************************
+  * @file    container_benchmark.cpp
+  * @brief   On-target cycle benchmark of the fixed-capacity containers.
+  *
+  *          Every container of static_containers.hpp is timed with the DWT
+  *          cycle counter on the batch sizes of the statistics benchmark,
+  *          next to the C structure of the pipeline that does the same
+  *          work: StaticRing next to sample_ring_t, MonotonicDeque next to
+  *          extremum_window_t. Each case moves size items through the
+  *          container in a critical section, the preparation stays out of
+  *          the timed region. The lines use the format of STATS_BENCHMARK,
+  *          so placement_compare.py also reads them.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "container_benchmark.h"
+
+#if CONTAINER_BENCHMARK
+#include <cstdio>
+#include <cstring>
+#include "cmsis_os.h"
+#include "cycle_counter.h"
+#include "pipeline_priorities.h"
+#include "sample_ring.h"
+#include "sensor_stats.h"
+#include "static_containers.hpp"
+#include "uart_tx.h"
+
+/* Private defines -----------------------------------------------------------*/
+#ifndef CONTAINER_BENCHMARK_STACK_SIZE
+#define CONTAINER_BENCHMARK_STACK_SIZE 384
+#endif
+// Above the consumer, below the producer, like the statistics benchmark
+#define CONTAINER_BENCHMARK_PRIORITY TASK_PRIORITY_CONTROL
+// Samples in the sliding window of the min/max cases
+#define CONTAINER_BENCHMARK_WINDOW 32U
+
+namespace {
+
+// Largest case, the capacity of every container
+constexpr std::size_t capacity = 256;
+static_assert(capacity <= SAMPLE_RING_SIZE, "the largest case must fit in a sample ring");
+static_assert(CONTAINER_BENCHMARK_WINDOW <= STATS_WINDOW_CAPACITY, "the C min/max window holds the window");
+
+/* Private types -------------------------------------------------------------*/
+enum Case {
+    CASE_STATIC_RING,     // StaticRing push then pop of every item
+    CASE_SAMPLE_RING,     // sample_ring_push then sample_ring_pop of every item
+    CASE_MONOTONIC_DEQUE, // Max and min MonotonicDeque over a sliding window
+#if !STATS_ARENA
+    CASE_EXTREMUM_WINDOW, // extremum_window_t over the same window
+#endif
+    CASE_STATIC_HEAP,     // StaticHeap push of every item, then pop of all
+    CASE_STATIC_VECTOR,   // StaticVector push_back of every item, then a sum
+    CASE_COUNT
+};
+
+enum Distribution {
+    DISTRIBUTION_SORTED,
+    DISTRIBUTION_RANDOM,
+    DISTRIBUTION_CONSTANT,
+    DISTRIBUTION_COUNT
+};
+
+/* Private variables ---------------------------------------------------------*/
+const char *const case_names[CASE_COUNT] = {
+    "static_ring", "sample_ring", "monotonic_deque",
+#if !STATS_ARENA
+    "extremum_window",
+#endif
+    "static_heap", "static_vector"
+};
+const char *const distribution_names[DISTRIBUTION_COUNT] = {
+    "sorted", "random", "constant"
+};
+const std::uint32_t sizes[] = { 16, 32, 64, 128, capacity };
+const char report_header[] = "kernel,size,distribution,min,avg,max\r\n";
+
+float input[capacity] CCMRAM_NOINIT;
+fixed::StaticRing<float, capacity> ring CCMRAM;
+sample_ring_t samples CCMRAM;
+fixed::MonotonicDeque<float, CONTAINER_BENCHMARK_WINDOW> window_max CCMRAM;
+fixed::MonotonicDeque<float, CONTAINER_BENCHMARK_WINDOW, std::less<float>> window_min CCMRAM;
+#if !STATS_ARENA
+extremum_window_t extremum CCMRAM;
+#endif
+fixed::StaticHeap<float, capacity> heap CCMRAM;
+fixed::StaticVector<float, capacity> vector CCMRAM;
+
+volatile float sink;
+
+StaticTask_t task_tcb CCMRAM;
+StackType_t task_stack[CONTAINER_BENCHMARK_STACK_SIZE] CCMRAM_NOINIT;
+
+// Function to generate the input of one case
+void fill(Distribution distribution, std::uint32_t count) {
+    std::uint32_t seed = 12345;
+
+    for (std::uint32_t i = 0; i < count; ++i) {
+        switch (distribution) {
+        case DISTRIBUTION_SORTED:
+            input[i] = static_cast<float>(i);
+            break;
+        case DISTRIBUTION_RANDOM:
+            // 12-bit values like a sensor word, deterministic between runs
+            seed = seed * 1664525U + 1013904223U;
+            input[i] = static_cast<float>(seed >> 20);
+            break;
+        default:
+            input[i] = 1000.0f;
+            break;
+        }
+    }
+}
+
+// Function to time one run of a case on the prepared input
+std::uint32_t run(Case which, std::uint32_t count) {
+    float result = 0.0f;
+    float item;
+    std::uint32_t start, cycles;
+
+    // Untimed preparation, every case starts empty
+    ring.clear();
+    sample_ring_init(&samples);
+    window_max.clear();
+    window_min.clear();
+#if !STATS_ARENA
+    extremum_window_reset(&extremum);
+#endif
+    heap.clear();
+    vector.clear();
+
+    taskENTER_CRITICAL();
+    start = cycle_counter_now();
+    switch (which) {
+    case CASE_STATIC_RING:
+        for (std::uint32_t i = 0; i < count; ++i) {
+            ring.push(input[i]);
+        }
+        while (ring.pop(item)) {
+            result += item;
+        }
+        break;
+    case CASE_SAMPLE_RING: {
+        sensor_data_t sample{};
+        for (std::uint32_t i = 0; i < count; ++i) {
+            sample.timestamp = i;
+            sample.value = static_cast<sample_value_t>(input[i]);
+            sample_ring_push(&samples, &sample);
+        }
+        while (sample_ring_pop(&samples, SAMPLE_READER_STATS, &sample)) {
+            result += static_cast<float>(sample.value);
+        }
+        break;
+    }
+    case CASE_MONOTONIC_DEQUE:
+        for (std::uint32_t i = 0; i < count; ++i) {
+            window_max.push(input[i], i);
+            window_min.push(input[i], i);
+            if (i >= CONTAINER_BENCHMARK_WINDOW) {
+                window_max.expire(i - CONTAINER_BENCHMARK_WINDOW + 1U);
+                window_min.expire(i - CONTAINER_BENCHMARK_WINDOW + 1U);
+            }
+            result += window_max.front() - window_min.front();
+        }
+        break;
+#if !STATS_ARENA
+    case CASE_EXTREMUM_WINDOW:
+        for (std::uint32_t i = 0; i < count; ++i) {
+            extremum_window_add(&extremum, input[i]);
+            if (i >= CONTAINER_BENCHMARK_WINDOW) {
+                extremum_window_remove_oldest(&extremum);
+            }
+            result += extremum_window_max(&extremum) - extremum_window_min(&extremum);
+        }
+        break;
+#endif
+    case CASE_STATIC_HEAP:
+        for (std::uint32_t i = 0; i < count; ++i) {
+            heap.push(input[i]);
+        }
+        while (heap.pop(item)) {
+            result += item;
+        }
+        break;
+    default:
+        for (std::uint32_t i = 0; i < count; ++i) {
+            vector.push_back(input[i]);
+        }
+        for (float value : vector) {
+            result += value;
+        }
+        break;
+    }
+    cycles = cycle_counter_since(start);
+    taskEXIT_CRITICAL();
+
+    sink = result;
+    return cycles;
+}
+
+// Function to time every case, size and distribution and report the results
+void benchmark_task(void *argument) {
+    char line[UART_TX_FRAME_MAX];
+
+    (void)argument;
+    cycle_counter_init();
+    uart_tx_send_blocking(reinterpret_cast<const std::uint8_t *>(report_header), sizeof(report_header) - 1);
+
+    for (std::uint32_t which = 0; which < CASE_COUNT; ++which) {
+        for (std::uint32_t count : sizes) {
+            for (std::uint32_t distribution = 0; distribution < DISTRIBUTION_COUNT; ++distribution) {
+                std::uint32_t min = UINT32_MAX, max = 0;
+                std::uint64_t total = 0;
+
+                fill(static_cast<Distribution>(distribution), count);
+                for (std::uint32_t n = 0; n < CONTAINER_BENCHMARK_RUNS; ++n) {
+                    std::uint32_t cycles = run(static_cast<Case>(which), count);
+                    min = cycles < min ? cycles : min;
+                    max = cycles > max ? cycles : max;
+                    total += cycles;
+                }
+
+                std::snprintf(line, sizeof(line), "%s,%lu,%s,%lu,%lu,%lu\r\n", case_names[which],
+                              static_cast<unsigned long>(count), distribution_names[distribution],
+                              static_cast<unsigned long>(min),
+                              static_cast<unsigned long>(total / CONTAINER_BENCHMARK_RUNS),
+                              static_cast<unsigned long>(max));
+                uart_tx_send_blocking(reinterpret_cast<const std::uint8_t *>(line),
+                                      static_cast<std::uint16_t>(std::strlen(line)));
+            }
+        }
+    }
+
+    vTaskDelete(nullptr);
+}
+
+} // namespace
+
+// Function to create the one-shot benchmark task
+void container_benchmark_start(void) {
+    xTaskCreateStatic(benchmark_task, "ContainerBench", CONTAINER_BENCHMARK_STACK_SIZE, nullptr,
+                      CONTAINER_BENCHMARK_PRIORITY, task_stack, &task_tcb);
+}
+#endif /* CONTAINER_BENCHMARK */
@@ -0,0 +1,241 @@
+/**
+  ******************************************************************************
+  * @file    crash_capture.c
+  * @brief   Fault register dump and trace of the last pipeline events over a reset.
+  *
+  *          The pipeline traces its steps into a small ring in no-init RAM:
+  *          the ticks, the I2C reads, the batches, the reports, the bursts
+  *          and the commands. The startup does not clear the section, so
+  *          after any reset but a power cycle the ring still holds the last
+  *          CRASH_CAPTURE_TRACE_DEPTH events before it.
+  *
+  *          The fault handlers hand the stack of the faulting context to
+  *          crash_capture_fault. It reads the stacked registers, the fault
+  *          status and address registers and the running task, freezes a
+  *          copy of the ring and keeps the record in no-init RAM and in the
+  *          backup SRAM, then resets. A stack that could not be written or
+  *          that points outside the RAM is not read, the fault would nest.
+  *          With a debugger attached it stops on a breakpoint first.
+  *
+  *          At the next boot the record, or the ring after a reset without a
+  *          fault, is taken over and cleared, and sent once as one fault
+  *          frame and the trace frames. Both copies carry a magic and a
+  *          checksum, the content of RAM after power on is random.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "crash_capture.h"
+#include "main.h"
+#include "cmsis_os.h"
+#include "cycle_counter.h"
+#include "uart_tx.h"
+#include "watchdog.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+// The low half counts up with every change of the record layout
+#define CRASH_RING_MAGIC 0x43540001U
+#define CRASH_RECORD_MAGIC 0x43520001U
+// The record is copied to the start of the 4 KB backup SRAM
+#define CRASH_BACKUP_RECORD ((crash_record_t *)BKPSRAM_BASE)
+// EXC_RETURN bits: the context ran on the PSP, the frame has no FPU registers
+#define CRASH_EXC_RETURN_PSP 0x04U
+#define CRASH_EXC_RETURN_NO_FPU 0x10U
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    uint32_t magic;  // CRASH_RING_MAGIC
+    uint32_t head;   // Events traced since boot, the newest is at head - 1
+    crash_event_record_t events[CRASH_CAPTURE_TRACE_DEPTH];
+} crash_ring_t;
+
+typedef struct {
+    uint32_t magic;  // CRASH_RECORD_MAGIC
+    crash_fault_frame_t fault;
+    uint32_t trace_count;
+    crash_event_record_t trace[CRASH_CAPTURE_TRACE_DEPTH];  // Oldest first
+    uint32_t checksum;  // Over the words before it
+} crash_record_t;
+
+/* Private variables ---------------------------------------------------------*/
+// Kept over a reset, validated at boot
+static crash_ring_t crash_ring NOINIT;
+static crash_record_t crash_record NOINIT;
+// What the last boot left, sent once by crash_capture_report
+static crash_record_t crash_boot_record;
+static bool crash_boot_fault;
+
+/* Private function prototypes -----------------------------------------------*/
+static uint32_t crash_capture_checksum(const crash_record_t *record);
+static bool crash_capture_valid(const crash_record_t *record);
+static void crash_capture_snapshot(crash_record_t *record);
+static bool crash_capture_in_ram(uintptr_t address, uint32_t size);
+
+// Function to take over what the last boot left and clear it
+void crash_capture_init(void) {
+    crash_record_t *backup = CRASH_BACKUP_RECORD;
+
+    __HAL_RCC_PWR_CLK_ENABLE();
+    HAL_PWR_EnableBkUpAccess();
+    __HAL_RCC_BKPSRAM_CLK_ENABLE();
+    // Keeps the backup SRAM on VBAT, it is only lost with both supplies
+    (void)HAL_PWREx_EnableBkUpReg();
+
+    crash_boot_fault = false;
+    crash_boot_record.trace_count = 0;
+    if (crash_capture_valid(&crash_record)) {
+        crash_boot_record = crash_record;
+        crash_boot_fault = true;
+    } else if (crash_capture_valid(backup)) {
+        crash_boot_record = *backup;
+        crash_boot_record.fault.flags |= CRASH_FLAG_BACKUP;
+        crash_boot_fault = true;
+    } else if (crash_ring.magic == CRASH_RING_MAGIC) {
+        // A reset without a fault, a watchdog or the reset pin, still has its trace
+        crash_capture_snapshot(&crash_boot_record);
+    }
+    crash_record.magic = 0;
+    backup->magic = 0;
+    crash_ring.magic = CRASH_RING_MAGIC;
+    crash_ring.head = 0;
+
+    // Each fault on its own handler, the vector tells them apart. They
+    // escalate to HardFault when they hit inside a fault handler.
+    SCB->SHCSR |= SCB_SHCSR_MEMFAULTENA_Msk | SCB_SHCSR_BUSFAULTENA_Msk | SCB_SHCSR_USGFAULTENA_Msk;
+}
+
+// Function to send the dump and the trace of the last boot
+void crash_capture_report(void) {
+    crash_trace_frame_t frame;
+
+    if (crash_boot_fault) {
+        uart_tx_send((const uint8_t *)&crash_boot_record.fault, sizeof(crash_boot_record.fault));
+        crash_boot_fault = false;
+    }
+
+    frame.type = CRASH_TRACE_FRAME_TYPE;
+    frame.version = CRASH_FRAME_VERSION;
+    frame.part = 0;
+    for (uint32_t first = 0; first < crash_boot_record.trace_count; first += CRASH_TRACE_FRAME_EVENTS) {
+        uint32_t count = crash_boot_record.trace_count - first;
+        if (count > CRASH_TRACE_FRAME_EVENTS) {
+            count = CRASH_TRACE_FRAME_EVENTS;
+        }
+        frame.count = (uint8_t)count;
+        memset(frame.events, 0, sizeof(frame.events));
+        memcpy(frame.events, &crash_boot_record.trace[first], count * sizeof(frame.events[0]));
+        uart_tx_send((const uint8_t *)&frame, sizeof(frame));
+        frame.part++;
+    }
+    crash_boot_record.trace_count = 0;
+}
+
+// Function to keep an event in the ring
+void crash_capture_trace(crash_event_t event, uint32_t arg) {
+    UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+    crash_event_record_t *entry = &crash_ring.events[crash_ring.head++ & (CRASH_CAPTURE_TRACE_DEPTH - 1U)];
+
+    entry->cycles = cycle_counter_now();
+    entry->arg = (uint16_t)arg;
+    entry->event = (uint8_t)event;
+    entry->context = (uint8_t)__get_IPSR();
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+// Function to dump the faulting context, keep it over the reset and reset
+void crash_capture_fault(const uint32_t *frame, uint32_t exc_return) {
+    crash_record_t *record = &crash_record;
+    crash_fault_frame_t *fault = &record->fault;
+    uint32_t cfsr = SCB->CFSR;
+
+    memset(record, 0, sizeof(*record));
+    fault->type = CRASH_FAULT_FRAME_TYPE;
+    fault->version = CRASH_FRAME_VERSION;
+    fault->vector = (uint8_t)__get_IPSR();
+    if ((exc_return & CRASH_EXC_RETURN_PSP) != 0) {
+        fault->flags |= CRASH_FLAG_THREAD;
+    }
+    if ((exc_return & CRASH_EXC_RETURN_NO_FPU) == 0) {
+        fault->flags |= CRASH_FLAG_FPU;
+    }
+    // A failed stacking leaves the frame unwritten, an overflowed stack may point anywhere
+    if ((cfsr & (SCB_CFSR_MSTKERR_Msk | SCB_CFSR_STKERR_Msk)) == 0 &&
+        crash_capture_in_ram((uintptr_t)frame, 8U * sizeof(uint32_t))) {
+        fault->r0 = frame[0];
+        fault->r1 = frame[1];
+        fault->r2 = frame[2];
+        fault->r3 = frame[3];
+        fault->r12 = frame[4];
+        fault->lr = frame[5];
+        fault->pc = frame[6];
+        fault->xpsr = frame[7];
+        fault->flags |= CRASH_FLAG_STACKED;
+    }
+    fault->cfsr = cfsr;
+    fault->hfsr = SCB->HFSR;
+    fault->mmfar = SCB->MMFAR;
+    fault->bfar = SCB->BFAR;
+    fault->sp = (uint32_t)(uintptr_t)frame;
+    fault->uptime_ms = HAL_GetTick();
+    if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) {
+        // The task that runs or that an interrupt preempted
+        const char *name = pcTaskGetName(NULL);
+        for (uint32_t i = 0; i < sizeof(fault->task) && name[i] != '\0'; ++i) {
+            fault->task[i] = name[i];
+        }
+    }
+    crash_capture_snapshot(record);
+    record->magic = CRASH_RECORD_MAGIC;
+    record->checksum = crash_capture_checksum(record);
+
+    // The backup SRAM also survives a new firmware that moves the no-init section
+    __HAL_RCC_PWR_CLK_ENABLE();
+    HAL_PWR_EnableBkUpAccess();
+    __HAL_RCC_BKPSRAM_CLK_ENABLE();
+    memcpy(CRASH_BACKUP_RECORD, record, sizeof(*record));
+#if WATCHDOG
+    watchdog_record(WATCHDOG_CAUSE_FAULT, fault->vector, cfsr);
+#endif
+
+    if ((CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk) != 0) {
+        __BKPT(0);
+    }
+    NVIC_SystemReset();
+}
+
+// Function to copy the ring into a record, oldest event first
+static void crash_capture_snapshot(crash_record_t *record) {
+    uint32_t head = crash_ring.head;
+    uint32_t count = head < CRASH_CAPTURE_TRACE_DEPTH ? head : CRASH_CAPTURE_TRACE_DEPTH;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        record->trace[i] = crash_ring.events[(head - count + i) & (CRASH_CAPTURE_TRACE_DEPTH - 1U)];
+    }
+    record->trace_count = count;
+}
+
+// Function to hash the words of a record in front of its checksum, FNV-1a
+static uint32_t crash_capture_checksum(const crash_record_t *record) {
+    const uint32_t *words = (const uint32_t *)record;
+    uint32_t hash = 2166136261U;
+
+    for (uint32_t i = 0; i < offsetof(crash_record_t, checksum) / sizeof(uint32_t); ++i) {
+        hash = (hash ^ words[i]) * 16777619U;
+    }
+    return hash;
+}
+
+// Function to check a record left over a reset
+static bool crash_capture_valid(const crash_record_t *record) {
+    return record->magic == CRASH_RECORD_MAGIC && record->trace_count <= CRASH_CAPTURE_TRACE_DEPTH &&
+           record->checksum == crash_capture_checksum(record);
+}
+
+// Function to check that a range lies in SRAM1, SRAM2 or the CCM RAM
+static bool crash_capture_in_ram(uintptr_t address, uint32_t size) {
+    return (address >= SRAM1_BASE && address + size <= SRAM2_BASE + 0x4000U) ||
+           (address >= CCMDATARAM_BASE && address + size <= CCMDATARAM_BASE + 0x10000U);
+}
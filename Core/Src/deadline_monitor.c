@@ -0,0 +1,214 @@
+/**
+  ******************************************************************************
+  * @file    deadline_monitor.c
+  * @brief   Lateness, jitter and overrun monitor of the sampling ticks.
+  *
+  *          The sample timestamps are the scheduled times of the ticks, so
+  *          an acquisition that runs late does not show in the data. Each
+  *          tick is timed against the cycle count of its TIM3 interrupt
+  *          instead: the start delay up to the first read is the jitter of
+  *          the schedule, the finish time up to the last sample stored is
+  *          the share of the period the tick needs. An acquisition that
+  *          runs past the next tick is an overrun. One that runs past a
+  *          second tick merges both notifications, the tick count then
+  *          jumps and the skipped tick is counted as missed.
+  *
+  *          With DEADLINE_MONITOR_SHED a run of late ticks stops the reads of
+  *          the I2C sensor with the longest read in the window, usually one
+  *          that stretches the clock or times out, so the other channels
+  *          keep their period. It is read again after a fixed time and shed
+  *          again if the bus is still slow.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "deadline_monitor.h"
+#include "cmsis_os.h"
+#include "cycle_counter.h"
+#include "pipeline_config.h"
+#include <stdbool.h>
+#include <string.h>
+
+/* Private variables ---------------------------------------------------------*/
+// Written by producer_task, snapshot by consumer_task in a critical section
+static uint32_t deadline_last_tick;
+static uint32_t deadline_ticks;
+static uint32_t deadline_missed;
+static uint32_t deadline_overruns;
+static uint32_t deadline_worst_start_us;
+static uint32_t deadline_worst_finish_us;
+static uint32_t deadline_start_buckets[DEADLINE_MONITOR_BUCKETS];
+static uint32_t deadline_finish_buckets[DEADLINE_MONITOR_BUCKETS];
+static volatile uint32_t deadline_shed;
+
+#if DEADLINE_MONITOR_SHED
+// Degrade state, producer_task only
+static uint32_t deadline_read_worst[SENSOR_COUNT];
+static uint32_t deadline_shed_at[SENSOR_COUNT];
+static uint32_t deadline_window_ticks;
+static uint32_t deadline_late_ticks;
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+static uint32_t deadline_monitor_us(uint32_t start_cycles);
+static void deadline_monitor_count(uint32_t *buckets, uint32_t us, uint32_t shift);
+#if DEADLINE_MONITOR_SHED
+static void deadline_monitor_degrade(bool late);
+#endif
+
+// Function to clear the counters
+void deadline_monitor_init(void) {
+    deadline_last_tick = 0;
+    deadline_ticks = 0;
+    deadline_missed = 0;
+    deadline_overruns = 0;
+    deadline_worst_start_us = 0;
+    deadline_worst_finish_us = 0;
+    memset(deadline_start_buckets, 0, sizeof(deadline_start_buckets));
+    memset(deadline_finish_buckets, 0, sizeof(deadline_finish_buckets));
+    deadline_shed = 0;
+#if DEADLINE_MONITOR_SHED
+    memset(deadline_read_worst, 0, sizeof(deadline_read_worst));
+    deadline_window_ticks = 0;
+    deadline_late_ticks = 0;
+#endif
+}
+
+// Function to read the microseconds since a cycle count
+static uint32_t deadline_monitor_us(uint32_t start_cycles) {
+    uint32_t cycles_per_us = SystemCoreClock / 1000000U;
+    return cycle_counter_since(start_cycles) / (cycles_per_us != 0 ? cycles_per_us : 1U);
+}
+
+// Function to count a time in its log2 bucket
+static void deadline_monitor_count(uint32_t *buckets, uint32_t us, uint32_t shift) {
+    uint32_t scaled = us >> shift;
+    uint32_t bucket = scaled == 0 ? 0 : 31U - (uint32_t)__builtin_clz(scaled);
+
+    if (bucket >= DEADLINE_MONITOR_BUCKETS) {
+        bucket = DEADLINE_MONITOR_BUCKETS - 1;
+    }
+    buckets[bucket]++;
+}
+
+// Function to time the start of an acquisition against its tick
+void deadline_monitor_start(uint32_t tick_count, uint32_t tick_cycles) {
+    uint32_t start_us = deadline_monitor_us(tick_cycles);
+
+    // The count of the first tick is 1, a larger step skipped ticks
+    deadline_missed += tick_count - deadline_last_tick - 1U;
+    deadline_last_tick = tick_count;
+    deadline_ticks++;
+    deadline_monitor_count(deadline_start_buckets, start_us, 0);
+    if (start_us > deadline_worst_start_us) {
+        deadline_worst_start_us = start_us;
+    }
+}
+
+// Function to keep the longest read of each channel in the shed window
+void deadline_monitor_read(sensor_t channel, uint32_t cycles) {
+#if DEADLINE_MONITOR_SHED
+    if (cycles > deadline_read_worst[channel]) {
+        deadline_read_worst[channel] = cycles;
+    }
+#else
+    (void)channel;
+    (void)cycles;
+#endif
+}
+
+// Function to time the end of an acquisition against the period
+void deadline_monitor_finish(uint32_t tick_cycles) {
+    uint32_t finish_us = deadline_monitor_us(tick_cycles);
+    uint32_t period_us = pipeline_config.sample_period_ms * 1000U;
+
+    deadline_monitor_count(deadline_finish_buckets, finish_us, DEADLINE_MONITOR_FINISH_SHIFT);
+    if (finish_us > deadline_worst_finish_us) {
+        deadline_worst_finish_us = finish_us;
+    }
+    if (finish_us > period_us) {
+        deadline_overruns++;
+    }
+#if DEADLINE_MONITOR_SHED
+    deadline_monitor_degrade(finish_us > period_us / 100U * DEADLINE_MONITOR_BUDGET_PCT);
+#endif
+}
+
+#if DEADLINE_MONITOR_SHED
+// Function to shed the slowest sensor after a run of late ticks and restore it later
+static void deadline_monitor_degrade(bool late) {
+    uint32_t shed = deadline_shed;
+
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        if ((shed & (1U << channel)) != 0 &&
+            deadline_ticks - deadline_shed_at[channel] >= DEADLINE_MONITOR_RESTORE_TICKS) {
+            shed &= ~(1U << channel);
+        }
+    }
+
+    deadline_window_ticks++;
+    if (late) {
+        deadline_late_ticks++;
+    }
+    if (deadline_late_ticks >= DEADLINE_MONITOR_SHED_AFTER) {
+        // Only I2C reads are timed, ADC and hook channels are never shed
+        uint32_t slowest = SENSOR_COUNT;
+        for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+            if ((shed & (1U << channel)) == 0 && deadline_read_worst[channel] != 0 &&
+                (slowest == SENSOR_COUNT || deadline_read_worst[channel] > deadline_read_worst[slowest])) {
+                slowest = channel;
+            }
+        }
+        if (slowest != SENSOR_COUNT) {
+            shed |= 1U << slowest;
+            deadline_shed_at[slowest] = deadline_ticks;
+        }
+    }
+    if (deadline_late_ticks >= DEADLINE_MONITOR_SHED_AFTER || deadline_window_ticks >= DEADLINE_MONITOR_SHED_WINDOW) {
+        memset(deadline_read_worst, 0, sizeof(deadline_read_worst));
+        deadline_window_ticks = 0;
+        deadline_late_ticks = 0;
+    }
+    deadline_shed = shed;
+}
+#endif
+
+// Function to read the channels that are shed
+uint32_t deadline_monitor_shed_mask(void) {
+    return deadline_shed;
+}
+
+// Function to read the missed ticks
+uint32_t deadline_monitor_missed(void) {
+    return deadline_missed;
+}
+
+// Function to read the overrun acquisitions
+uint32_t deadline_monitor_overruns(void) {
+    return deadline_overruns;
+}
+
+// Function to fill a deadline frame and restart the histograms
+uint16_t deadline_monitor_build(deadline_frame_t *frame) {
+    frame->type = DEADLINE_FRAME_TYPE;
+    frame->version = DEADLINE_FRAME_VERSION;
+
+    // The producer preempts the consumer, take the counters in one piece
+    taskENTER_CRITICAL();
+    frame->shed_mask = (uint16_t)deadline_shed;
+    frame->ticks = deadline_ticks;
+    frame->missed = deadline_missed;
+    frame->overruns = deadline_overruns;
+    frame->worst_start_us = deadline_worst_start_us;
+    frame->worst_finish_us = deadline_worst_finish_us;
+    for (uint32_t i = 0; i < DEADLINE_MONITOR_BUCKETS; ++i) {
+        frame->start_buckets[i] =
+            deadline_start_buckets[i] > UINT16_MAX ? UINT16_MAX : (uint16_t)deadline_start_buckets[i];
+        frame->finish_buckets[i] =
+            deadline_finish_buckets[i] > UINT16_MAX ? UINT16_MAX : (uint16_t)deadline_finish_buckets[i];
+    }
+    memset(deadline_start_buckets, 0, sizeof(deadline_start_buckets));
+    memset(deadline_finish_buckets, 0, sizeof(deadline_finish_buckets));
+    taskEXIT_CRITICAL();
+    return sizeof(*frame);
+}
@@ -0,0 +1,175 @@
+/**
+  ******************************************************************************
+  * @file    dma_copy.c
+  * @brief   Asynchronous bulk copies on a DMA2 memory-to-memory stream.
+  *
+  *          The batch median copies the window of every channel before it
+  *          reorders it, and the "dump" command freezes a window of samples
+  *          and timestamps. On the CPU each of these is a memcpy that the
+  *          statistics wait behind. Here the caller queues the blocks, DMA2
+  *          Stream1 moves them one after the other, and the caller goes on
+  *          with what does not need the copy, the sums over the same window
+  *          for the median, and only waits where it reads the copy.
+  *
+  *          A block is only worth a transfer above DMA_COPY_MIN_BYTES, the
+  *          smaller ones are copied at once. The DMA does not reach CCM, so a
+  *          block with an end there is copied by the CPU as well, DMA_COPY_RAM
+  *          keeps the snapshot buffers out of it. The stream runs at the
+  *          lowest priority of the controller, ADC1 on Stream0 goes first.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "dma_copy.h"
+
+#if DMA_COPY
+#include "cmsis_os.h"
+#include "pipeline_priorities.h"
+#include "task_signal.h"
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+#define DMA_COPY_STREAM DMA2_Stream1
+#define DMA_COPY_FLAGS \
+    (DMA_LIFCR_CTCIF1 | DMA_LIFCR_CHTIF1 | DMA_LIFCR_CTEIF1 | DMA_LIFCR_CDMEIF1 | DMA_LIFCR_CFEIF1)
+// NDTR counts 16 bits of transfers
+#define DMA_COPY_UNITS_MAX 0xFFFFU
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    void *dst;
+    const void *src;
+    size_t size;
+} dma_copy_block_t;
+
+/* Private variables ---------------------------------------------------------*/
+// Written by the submitting task, read by the interrupt that chains them
+static dma_copy_block_t dma_copy_queue[DMA_COPY_QUEUE];
+static volatile uint32_t dma_copy_count;
+// Next block to start, and whether one is on the stream, both owned by the
+// interrupt while a transfer runs
+static volatile uint32_t dma_copy_next;
+static volatile bool dma_copy_busy;
+static volatile bool dma_copy_failed;
+static TaskHandle_t volatile dma_copy_task;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool dma_copy_reachable(const void *address, size_t size);
+static void dma_copy_start(uint32_t index);
+
+// Function to enable the controller and the stream interrupt
+void dma_copy_init(void) {
+    __HAL_RCC_DMA2_CLK_ENABLE();
+    DMA_COPY_STREAM->CR = 0;
+    while ((DMA_COPY_STREAM->CR & DMA_SxCR_EN) != 0) {
+    }
+    DMA2->LIFCR = DMA_COPY_FLAGS;
+    // Only wakes a task, nothing waits on it in an interrupt
+    HAL_NVIC_SetPriority(DMA2_Stream1_IRQn, IRQ_PRIORITY_LINK, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Stream1_IRQn);
+}
+
+// Function to check that a block lies outside of CCM, on the bus matrix
+static bool dma_copy_reachable(const void *address, size_t size) {
+    uintptr_t start = (uintptr_t)address;
+
+    return start > CCMDATARAM_END || start + size <= CCMDATARAM_BASE;
+}
+
+// Function to queue a copy, or make it at once when the DMA would not pay off
+void dma_copy_submit(void *dst, const void *src, size_t size) {
+    if (size < DMA_COPY_MIN_BYTES || size > DMA_COPY_UNITS_MAX || dma_copy_count == DMA_COPY_QUEUE ||
+        !dma_copy_reachable(dst, size) || !dma_copy_reachable(src, size)) {
+        memcpy(dst, src, size);
+        return;
+    }
+    dma_copy_task = xTaskGetCurrentTaskHandle();
+    taskENTER_CRITICAL();
+    uint32_t index = dma_copy_count;
+    dma_copy_queue[index].dst = dst;
+    dma_copy_queue[index].src = src;
+    dma_copy_queue[index].size = size;
+    dma_copy_count = index + 1U;
+    if (!dma_copy_busy) {
+        dma_copy_busy = true;
+        dma_copy_next = index + 1U;
+        dma_copy_start(index);
+    }
+    taskEXIT_CRITICAL();
+}
+
+// Function to program the stream for one block in the widest unit all of it aligns to
+static void dma_copy_start(uint32_t index) {
+    const dma_copy_block_t *block = &dma_copy_queue[index];
+    uint32_t alignment = (uint32_t)(uintptr_t)block->dst | (uint32_t)(uintptr_t)block->src | block->size;
+    uint32_t width = 0;
+    uint32_t units = block->size;
+
+    if ((alignment & 3U) == 0) {
+        width = DMA_SxCR_PSIZE_1 | DMA_SxCR_MSIZE_1;
+        units = block->size / 4U;
+    } else if ((alignment & 1U) == 0) {
+        width = DMA_SxCR_PSIZE_0 | DMA_SxCR_MSIZE_0;
+        units = block->size / 2U;
+    }
+    DMA2->LIFCR = DMA_COPY_FLAGS;
+    // Memory to memory reads through the peripheral port, and only in FIFO mode
+    DMA_COPY_STREAM->PAR = (uint32_t)(uintptr_t)block->src;
+    DMA_COPY_STREAM->M0AR = (uint32_t)(uintptr_t)block->dst;
+    DMA_COPY_STREAM->NDTR = units;
+    DMA_COPY_STREAM->FCR = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH;
+    DMA_COPY_STREAM->CR = DMA_SxCR_DIR_1 | DMA_SxCR_PINC | DMA_SxCR_MINC | width | DMA_SxCR_TCIE | DMA_SxCR_TEIE |
+                          DMA_SxCR_EN;
+}
+
+// Function to wait for the queue, finishing it on the CPU if the DMA gave up
+void dma_copy_wait(void) {
+    if (dma_copy_count == 0) {
+        return;
+    }
+    // A signal left from an earlier queue only costs one more pass
+    while (dma_copy_busy) {
+        if (task_signal_wait(TASK_SIGNAL_DMA_COPY, pdMS_TO_TICKS(DMA_COPY_TIMEOUT_MS)) == 0) {
+            break;
+        }
+    }
+
+    taskENTER_CRITICAL();
+    bool failed = dma_copy_failed || dma_copy_busy;
+    if (dma_copy_busy) {
+        DMA_COPY_STREAM->CR &= ~(DMA_SxCR_EN | DMA_SxCR_TCIE | DMA_SxCR_TEIE);
+        while ((DMA_COPY_STREAM->CR & DMA_SxCR_EN) != 0) {
+        }
+        DMA2->LIFCR = DMA_COPY_FLAGS;
+        dma_copy_busy = false;
+    }
+    dma_copy_failed = false;
+    taskEXIT_CRITICAL();
+
+    // The sources are unchanged until the return, so the whole queue is copied again
+    if (failed) {
+        for (uint32_t index = 0; index < dma_copy_count; ++index) {
+            memcpy(dma_copy_queue[index].dst, dma_copy_queue[index].src, dma_copy_queue[index].size);
+        }
+    }
+    dma_copy_count = 0;
+}
+
+// Function to chain the next block or report the end of the queue
+void dma_copy_irq_from_isr(void) {
+    uint32_t status = DMA2->LISR;
+
+    DMA2->LIFCR = DMA_COPY_FLAGS;
+    if ((status & DMA_LISR_TEIF1) != 0) {
+        // The stream disabled itself, the waiting task redoes the queue
+        dma_copy_failed = true;
+    } else if ((status & DMA_LISR_TCIF1) == 0) {
+        return;
+    } else if (dma_copy_next < dma_copy_count) {
+        dma_copy_start(dma_copy_next++);
+        return;
+    }
+    dma_copy_busy = false;
+    task_signal_set_from_isr(dma_copy_task, TASK_SIGNAL_DMA_COPY);
+}
+#endif /* DMA_COPY */
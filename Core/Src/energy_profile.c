@@ -0,0 +1,168 @@
+/**
+  ******************************************************************************
+  * @file    energy_profile.c
+  * @brief   GPIO stage markers for a power analyzer and power-state accounting.
+  *
+  *          Tuning for battery life needs to know which stage the charge
+  *          goes to. A power analyzer sees the current but not the code, so
+  *          every stage raises a GPIO line of its own while it runs: the
+  *          acquisition of a tick, the statistics of a batch, the USART2 DMA
+  *          and the idle sleep. Triggered on those lines, the analyzer
+  *          integrates the charge of each stage. A marker is one store to
+  *          BSRR, a few nanoseconds, and the line itself draws nothing when
+  *          no probe is attached.
+  *
+  *          On the chip the idle task reports every change of power state,
+  *          and the clock governor every change of HCLK. The time between
+  *          two changes is read on the 1 MHz TIM2 counter and added to its
+  *          state and its clock. TIM2 stops in STOP, so the STOP time comes
+  *          from the RTC instead. The energy frame turns those times into
+  *          an estimate with a linear current model per state and the
+  *          number of samples published in the same interval. The model starts
+  *          on datasheet figures, and the markers are what it is calibrated
+  *          with.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "energy_profile.h"
+
+#if ENERGY_PROFILE
+#include "critical_section.h"
+#include <string.h>
+
+/* Private variables ---------------------------------------------------------*/
+// State and clock of the segment open since energy_since, on TIM2
+static energy_state_t energy_state;
+static uint32_t energy_mhz;
+static uint32_t energy_since;
+// Accounting of the interval, guarded by a critical section
+static uint64_t energy_state_us[ENERGY_STATE_COUNT];
+static uint64_t energy_state_mhz_us[ENERGY_STATE_COUNT];
+static uint64_t energy_clock_us[ENERGY_CLOCK_SLOTS];
+static uint16_t energy_clock_mhz[ENERGY_CLOCK_SLOTS];
+static uint32_t energy_samples;
+
+/* Private function prototypes -----------------------------------------------*/
+static void energy_profile_close(void);
+
+// Function to set up the marker lines and open the first segment
+void energy_profile_init(void) {
+    GPIO_InitTypeDef marker_init = {0};
+
+    __HAL_RCC_GPIOD_CLK_ENABLE();
+    HAL_GPIO_WritePin(ENERGY_MARKER_GPIO_Port, ENERGY_MARKER_PINS, GPIO_PIN_RESET);
+    marker_init.Pin = ENERGY_MARKER_PINS;
+    marker_init.Mode = GPIO_MODE_OUTPUT_PP;
+    marker_init.Pull = GPIO_NOPULL;
+    // Edges within a few nanoseconds of the store, the analyzer lines up on them
+    marker_init.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(ENERGY_MARKER_GPIO_Port, &marker_init);
+
+    memset(energy_state_us, 0, sizeof(energy_state_us));
+    memset(energy_state_mhz_us, 0, sizeof(energy_state_mhz_us));
+    memset(energy_clock_us, 0, sizeof(energy_clock_us));
+    memset(energy_clock_mhz, 0, sizeof(energy_clock_mhz));
+    energy_samples = 0;
+    energy_state = ENERGY_STATE_RUN;
+    energy_mhz = SystemCoreClock / 1000000U;
+    energy_since = TIM2->CNT;
+}
+
+// Function to add the open segment to its state and clock, caller in a critical section
+static void energy_profile_close(void) {
+    uint32_t now = TIM2->CNT;
+    uint32_t elapsed = now - energy_since;
+
+    energy_since = now;
+    energy_state_us[energy_state] += elapsed;
+    energy_state_mhz_us[energy_state] += (uint64_t)elapsed * energy_mhz;
+    for (uint32_t slot = 0; slot < ENERGY_CLOCK_SLOTS; ++slot) {
+        if (energy_clock_mhz[slot] == 0) {
+            energy_clock_mhz[slot] = (uint16_t)energy_mhz;
+        }
+        if (energy_clock_mhz[slot] == energy_mhz) {
+            energy_clock_us[slot] += elapsed;
+            return;
+        }
+    }
+}
+
+// Function to move the accounting to another power state
+void energy_profile_enter(energy_state_t state) {
+    uint32_t mask = critical_section_enter();
+
+    energy_profile_close();
+    energy_state = state;
+    critical_section_exit(mask);
+}
+
+// Function to move the accounting to the new HCLK
+void energy_profile_clock_changed(void) {
+    uint32_t mask = critical_section_enter();
+
+    energy_profile_close();
+    energy_mhz = SystemCoreClock / 1000000U;
+    critical_section_exit(mask);
+}
+
+// Function to add a STOP period measured on the RTC
+void energy_profile_stopped(uint32_t ms) {
+    uint32_t mask = critical_section_enter();
+
+    energy_state_us[ENERGY_STATE_STOP] += (uint64_t)ms * 1000U;
+    critical_section_exit(mask);
+}
+
+// Function to count a published sample
+void energy_profile_sample(void) {
+    energy_samples++;
+}
+
+// Function to close the interval into an energy frame
+uint16_t energy_profile_build(energy_frame_t *frame) {
+    uint64_t state_us[ENERGY_STATE_COUNT];
+    uint64_t state_mhz_us[ENERGY_STATE_COUNT];
+    uint64_t clock_us[ENERGY_CLOCK_SLOTS];
+    uint16_t clock_mhz[ENERGY_CLOCK_SLOTS];
+    uint32_t mask = critical_section_enter();
+
+    energy_profile_close();
+    memcpy(state_us, energy_state_us, sizeof(state_us));
+    memcpy(state_mhz_us, energy_state_mhz_us, sizeof(state_mhz_us));
+    memcpy(clock_us, energy_clock_us, sizeof(clock_us));
+    memcpy(clock_mhz, energy_clock_mhz, sizeof(clock_mhz));
+    frame->samples = energy_samples;
+    memset(energy_state_us, 0, sizeof(energy_state_us));
+    memset(energy_state_mhz_us, 0, sizeof(energy_state_mhz_us));
+    memset(energy_clock_us, 0, sizeof(energy_clock_us));
+    memset(energy_clock_mhz, 0, sizeof(energy_clock_mhz));
+    energy_samples = 0;
+    critical_section_exit(mask);
+
+    // Microamps times microseconds is picocoulombs, times millivolts femtojoules
+    float femtojoules = (float)ENERGY_SUPPLY_MV *
+        ((float)ENERGY_RUN_BASE_UA * (float)state_us[ENERGY_STATE_RUN] +
+         (float)ENERGY_RUN_UA_PER_MHZ * (float)state_mhz_us[ENERGY_STATE_RUN] +
+         (float)ENERGY_SLEEP_BASE_UA * (float)state_us[ENERGY_STATE_SLEEP] +
+         (float)ENERGY_SLEEP_UA_PER_MHZ * (float)state_mhz_us[ENERGY_STATE_SLEEP] +
+         (float)ENERGY_STOP_UA * (float)state_us[ENERGY_STATE_STOP]);
+
+    frame->type = ENERGY_FRAME_TYPE;
+    frame->version = ENERGY_FRAME_VERSION;
+    frame->clock_mhz = (uint16_t)(SystemCoreClock / 1000000U);
+    frame->interval_ms = 0;
+    for (uint32_t state = 0; state < ENERGY_STATE_COUNT; ++state) {
+        frame->state_ms[state] = (uint32_t)(state_us[state] / 1000U);
+        frame->interval_ms += frame->state_ms[state];
+    }
+    for (uint32_t slot = 0; slot < ENERGY_CLOCK_SLOTS; ++slot) {
+        frame->clocks[slot].mhz = clock_mhz[slot];
+        frame->clocks[slot].reserved = 0;
+        frame->clocks[slot].time_ms = (uint32_t)(clock_us[slot] / 1000U);
+    }
+    frame->energy_uj = (uint32_t)(femtojoules / 1e9f);
+    frame->sample_nj = frame->samples == 0 ? 0 : (uint32_t)(femtojoules / 1e6f / (float)frame->samples);
+    return (uint16_t)sizeof(*frame);
+}
+#endif /* ENERGY_PROFILE */
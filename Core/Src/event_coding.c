@@ -0,0 +1,163 @@
+/**
+  ******************************************************************************
+  * @file    event_coding.c
+  * @brief   Run-length statistics of the channels that only store their level changes.
+  *
+  *          The PIR channel is idle nearly all the time, read at every tick
+  *          its ring and its log fill with the same value. Event-coded, the
+  *          producer stores a sample only when the value differs from the
+  *          previous one, so every sample in the ring starts a run that
+  *          lasts until the next sample, the newest run until now. A window
+  *          of samples is then a window of runs and covers hours of idle
+  *          time at the cost of a few samples.
+  *
+  *          The statistics of the samples would count a run of one tick as
+  *          much as one of an hour, so they are taken from the runs, each
+  *          weighted by its time: the standard deviation from the time sums
+  *          and the median as the value held for half of the window. The
+  *          minimum and the maximum are those of the samples already. The
+  *          event frame adds what only the runs know: their count, the
+  *          rising edges, the active share and the longest runs.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "event_coding.h"
+#include "sensor_stats.h"
+#include "stats_frame.h"
+#include "uart_tx.h"
+#include <math.h>
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    uint32_t timestamp;
+    uint32_t window_ms;
+    uint32_t runs;
+    uint32_t events;
+    uint32_t active_ms;
+    uint32_t longest_active_ms;
+    uint32_t longest_idle_ms;
+    bool active;
+} event_coding_runs_t;
+
+/* Private variables ---------------------------------------------------------*/
+// Consumer task only
+static event_coding_runs_t event_coding_runs[SENSOR_COUNT];
+static uint32_t event_coding_updated;
+// Runs of one window ordered by value for the median
+static float event_coding_values[STATS_WINDOW_CAPACITY];
+static uint32_t event_coding_durations[STATS_WINDOW_CAPACITY];
+
+/* Private function prototypes -----------------------------------------------*/
+static float event_coding_median(uint32_t count, uint32_t total_ms);
+
+// Function to measure the runs of a channel window and weight its statistics by time
+bool event_coding_update(sensor_t channel, const sample_ring_t *ring, uint32_t now, float unit, float *out) {
+    event_coding_runs_t *runs = &event_coding_runs[channel];
+    uint32_t count = sample_ring_count(ring, SAMPLE_READER_STATS);
+    uint32_t offset = 0;
+    float sum = 0.0f, sum_sq = 0.0f;
+
+    if (count == 0) {
+        return false;
+    }
+    // The window never holds more, the cap only keeps the scratch in bounds
+    if (count > STATS_WINDOW_CAPACITY) {
+        offset = count - STATS_WINDOW_CAPACITY;
+        count = STATS_WINDOW_CAPACITY;
+    }
+
+    uint32_t start = sample_ring_timestamp(ring, SAMPLE_READER_STATS, offset);
+    runs->timestamp = now;
+    runs->window_ms = (int32_t)(now - start) > 0 ? now - start : 0;
+    runs->runs = count;
+    runs->events = 0;
+    runs->active_ms = 0;
+    runs->longest_active_ms = 0;
+    runs->longest_idle_ms = 0;
+    bool previous_active = false;
+    for (uint32_t index = 0; index < count; ++index) {
+        float value = (float)sample_ring_value(ring, SAMPLE_READER_STATS, offset + index);
+        uint32_t end = index + 1 < count ? sample_ring_timestamp(ring, SAMPLE_READER_STATS, offset + index + 1) : now;
+        uint32_t begin = sample_ring_timestamp(ring, SAMPLE_READER_STATS, offset + index);
+        uint32_t duration = (int32_t)(end - begin) > 0 ? end - begin : 0;
+        bool active = value != 0.0f;
+
+        if (active) {
+            runs->events += index > 0 && !previous_active;
+            runs->active_ms += duration;
+            if (duration > runs->longest_active_ms) {
+                runs->longest_active_ms = duration;
+            }
+        } else if (duration > runs->longest_idle_ms) {
+            runs->longest_idle_ms = duration;
+        }
+        previous_active = active;
+        sum += value * (float)duration;
+        sum_sq += value * value * (float)duration;
+
+        // Insertion by value, a window of runs is short
+        uint32_t slot = index;
+        while (slot > 0 && event_coding_values[slot - 1] > value) {
+            event_coding_values[slot] = event_coding_values[slot - 1];
+            event_coding_durations[slot] = event_coding_durations[slot - 1];
+            slot--;
+        }
+        event_coding_values[slot] = value;
+        event_coding_durations[slot] = duration;
+    }
+    runs->active = previous_active;
+    event_coding_updated |= 1UL << channel;
+
+    // A window that only started has no time yet, the level stands for itself
+    if (runs->window_ms == 0) {
+        out[STATS_FIELD_STD_DEV] = 0.0f;
+        out[STATS_FIELD_MEDIAN] = event_coding_values[count - 1] * unit;
+        return true;
+    }
+    float mean = sum / (float)runs->window_ms;
+    float variance = sum_sq / (float)runs->window_ms - mean * mean;
+    out[STATS_FIELD_STD_DEV] = (variance > 0.0f ? sqrtf(variance) : 0.0f) * unit;
+    out[STATS_FIELD_MEDIAN] = event_coding_median(count, runs->window_ms) * unit;
+    return true;
+}
+
+// Function to send one event frame per channel updated since the last report
+void event_coding_report(void) {
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        const event_coding_runs_t *runs = &event_coding_runs[channel];
+        event_coding_frame_t frame;
+
+        if ((event_coding_updated & (1UL << channel)) == 0) {
+            continue;
+        }
+        frame.type = EVENT_CODING_FRAME_TYPE;
+        frame.version = EVENT_CODING_FRAME_VERSION;
+        frame.channel = (uint8_t)channel;
+        frame.active = runs->active;
+        frame.timestamp = runs->timestamp;
+        frame.window_ms = runs->window_ms;
+        frame.runs = runs->runs > UINT16_MAX ? UINT16_MAX : (uint16_t)runs->runs;
+        frame.events = runs->events > UINT16_MAX ? UINT16_MAX : (uint16_t)runs->events;
+        frame.duty = runs->window_ms == 0 ? (runs->active ? 10000U : 0U)
+                                          : (uint16_t)((uint64_t)runs->active_ms * 10000U / runs->window_ms);
+        frame.reserved = 0;
+        frame.longest_active_ms = runs->longest_active_ms;
+        frame.longest_idle_ms = runs->longest_idle_ms;
+        uart_tx_send((const uint8_t *)&frame, sizeof(frame));
+    }
+    event_coding_updated = 0;
+}
+
+// Function to find the value the sorted runs hold for half of the window
+static float event_coding_median(uint32_t count, uint32_t total_ms) {
+    uint32_t held = 0;
+
+    for (uint32_t index = 0; index < count; ++index) {
+        held += event_coding_durations[index];
+        if (2U * (uint64_t)held >= total_ms) {
+            return event_coding_values[index];
+        }
+    }
+    return event_coding_values[count - 1];
+}
@@ -0,0 +1,660 @@
+/**
+  ******************************************************************************
+  * @file    flash_log.c
+  * @brief   Log-structured record store in the internal flash, with replay.
+  *
+  *          Records are only ever appended. They are packed into a page
+  *          buffer in RAM and a page is programmed in one go once the next
+  *          record does not fit, so the flash sees one program session per
+  *          FLASH_LOG_PAGE_SIZE bytes instead of one per record. Each record
+  *          carries a sequence number and a CRC-32, pages are written in
+  *          order from page 1 of a sector, page 0 holds the sector header
+  *          with its erase count and the sequence of its first record.
+  *
+  *          When the write sector is full the next one is erased and
+  *          reformatted, which drops the oldest records. Rotation is strict
+  *          round robin, so every sector is erased as often as the others.
+  *          A torn page from a reset while programming only loses the records
+  *          after the first bad CRC, the next page starts clean.
+  *
+  *          The index is the sector header table in RAM. A replay finds its
+  *          sector from the first sequences and its page with a binary search
+  *          over the first record of each page, then walks the records from
+  *          there, so a replay never scans the whole log. Records still in
+  *          the page buffer are replayed from RAM. A seek by time uses the
+  *          same index, with the timestamp of the first record of each
+  *          sector kept next to its first sequence.
+  *
+  *          An erase stalls every fetch from the flash bank for the one to
+  *          two seconds it takes. With FLASH_LOG_IDLE_ERASE the next sector
+  *          is erased ahead, from the idle hook, so it happens when every
+  *          task waits and an append that moves on only writes the header.
+  *          The erase itself runs from SRAM with the interrupts masked down
+  *          to the sampling tick, and with RAM_FUNCTIONS the vector table,
+  *          the TIM3 handler and the tick are in SRAM too: the ticks of the
+  *          erase are still counted on time and the producer takes the
+  *          latest one when it is over, the time base never slips. The
+  *          reads themselves need the HAL and the kernel, which stay in
+  *          flash, so the samples of those ticks are missed, except those a
+  *          FIFO sensor keeps for its next drain.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "flash_log.h"
+#include "cmsis_os.h"
+#include "crc_unit.h"
+#include "link_route.h"
+#include "pipeline_priorities.h"
+#include "ram_func.h"
+#include "sample_timer.h"
+#include "semphr.h"
+#include "stack_profile.h"
+#include "task_signal.h"
+#include <string.h>
+
+#if (FLASH_LOG_PAGE_SIZE & 3U) != 0 || FLASH_LOG_SECTOR_SIZE % FLASH_LOG_PAGE_SIZE != 0
+#error "FLASH_LOG_PAGE_SIZE must be a multiple of 4 that divides the sector"
+#endif
+
+/* Private defines -----------------------------------------------------------*/
+#define FLASH_LOG_SECTOR_MAGIC 0x53464C47U // "GLFS"
+#define FLASH_LOG_ERASED_SIZE 0xFFFFU
+#define FLASH_LOG_FRAME_HEADER_SIZE 12U
+#ifndef FLASH_LOG_STACK_SIZE
+#define FLASH_LOG_STACK_SIZE 256
+#endif
+#define FLASH_LOG_PRIORITY TASK_PRIORITY_TRANSMIT
+#if FLASH_LOG_IDLE_ERASE
+// System exceptions and the interrupts of the STM32F407, the last one is the FPU's
+#define FLASH_LOG_VECTOR_COUNT (16U + (uint32_t)FPU_IRQn + 1U)
+// Error flags of a sector erase
+#define FLASH_LOG_ERASE_ERRORS (FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR)
+#endif
+
+/* Private types -------------------------------------------------------------*/
+// Page 0 of every sector, crc covers the three words before it
+typedef struct {
+    uint32_t magic;
+    uint32_t erase_count;
+    uint32_t first_sequence;
+    uint32_t crc;
+} flash_log_sector_header_t;
+
+// Record header in flash, followed by size payload bytes padded to a word.
+// crc covers the header from size on and the payload.
+typedef struct {
+    uint32_t crc;
+    uint16_t size;   // FLASH_LOG_ERASED_SIZE: no record, rest of the page is free
+    uint8_t type;    // flash_log_record_t
+    uint8_t reserved;
+    uint32_t sequence;
+    uint32_t timestamp;
+} flash_log_record_header_t;
+
+// Index entry of one sector
+typedef struct {
+    bool valid;              // Header read back with a good CRC
+    uint32_t erase_count;
+    uint32_t first_sequence;
+    uint32_t first_timestamp; // Of the first record in page 1, once it is programmed
+    uint32_t used_pages;     // Pages programmed, the header page included
+} flash_log_sector_t;
+
+/* Private variables ---------------------------------------------------------*/
+static flash_log_sector_t flash_log_sectors[FLASH_LOG_SECTOR_COUNT];
+static uint32_t flash_log_write_sector;
+// Page buffer, erased bytes are 0xFF so unused words are skipped when programming
+static uint32_t flash_log_page[FLASH_LOG_PAGE_SIZE / 4U];
+static uint32_t flash_log_page_used;
+static uint32_t flash_log_sequence;
+static bool flash_log_enabled;
+static volatile uint32_t flash_log_error_count;
+
+// Appends, flushes and replay reads hold it, a sector erase holds it for seconds
+static SemaphoreHandle_t flash_log_mutex;
+static StaticSemaphore_t flash_log_mutex_storage;
+
+static TaskHandle_t flash_log_task_handle;
+static StaticTask_t flash_log_task_tcb;
+static StackType_t flash_log_task_stack[FLASH_LOG_STACK_SIZE];
+static volatile uint32_t flash_log_replay_from;
+#if FLASH_LOG_IDLE_ERASE
+// Erased ahead by the idle hook, its header is not written yet. Under the mutex.
+static bool flash_log_erased[FLASH_LOG_SECTOR_COUNT];
+// Set by a flush that leaves the write sector with FLASH_LOG_ERASE_AHEAD_PAGES or fewer
+static volatile bool flash_log_erase_due;
+#if RAM_FUNCTIONS
+// The table the core reads during an erase, VTOR needs it aligned to its size rounded up
+static uint32_t flash_log_vectors[FLASH_LOG_VECTOR_COUNT] __attribute__((aligned(512)));
+#endif
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+static const uint8_t *flash_log_page_address(uint32_t sector, uint32_t page);
+static uint32_t flash_log_record_length(uint16_t size);
+static bool flash_log_record_valid(const uint8_t *page, uint32_t offset, uint32_t limit,
+                                   flash_log_record_header_t *header);
+static bool flash_log_page_empty(const uint8_t *page);
+static bool flash_log_program(uint32_t address, const uint32_t *words, uint32_t count);
+static bool flash_log_format(uint32_t sector, uint32_t first_sequence);
+static void flash_log_flush_locked(void);
+static void flash_log_scan(uint32_t sector);
+static void flash_log_task(void *argument);
+#if FLASH_LOG_IDLE_ERASE
+static bool flash_log_erase_in_ram(uint32_t sector_number);
+#endif
+
+// Function to read the address of a page of the log
+static const uint8_t *flash_log_page_address(uint32_t sector, uint32_t page) {
+    return (const uint8_t *)(uintptr_t)(FLASH_LOG_BASE + sector * FLASH_LOG_SECTOR_SIZE + page * FLASH_LOG_PAGE_SIZE);
+}
+
+// Function to read the bytes a record takes in a page
+static uint32_t flash_log_record_length(uint16_t size) {
+    return sizeof(flash_log_record_header_t) + ((size + 3U) & ~3U);
+}
+
+// Function to read the header of the record at offset and check its CRC
+static bool flash_log_record_valid(const uint8_t *page, uint32_t offset, uint32_t limit,
+                                   flash_log_record_header_t *header) {
+    if (offset + sizeof(*header) > limit) {
+        return false;
+    }
+    memcpy(header, &page[offset], sizeof(*header));
+    if (header->size == FLASH_LOG_ERASED_SIZE || header->size > FLASH_LOG_PAYLOAD_MAX ||
+        offset + flash_log_record_length(header->size) > limit) {
+        return false;
+    }
+
+    // The CRC unit is shared with the transmit path, the critical section serializes it
+    taskENTER_CRITICAL();
+    uint32_t crc = crc_unit_calculate(&page[offset + sizeof(uint32_t)],
+                                      sizeof(*header) - sizeof(uint32_t) + header->size);
+    taskEXIT_CRITICAL();
+    return crc == header->crc;
+}
+
+// Function to tell whether a page was never programmed since the last erase
+static bool flash_log_page_empty(const uint8_t *page) {
+    flash_log_record_header_t header;
+
+    memcpy(&header, page, sizeof(header));
+    return header.crc == 0xFFFFFFFFU && header.size == FLASH_LOG_ERASED_SIZE;
+}
+
+// Function to program words of erased flash, erased words are left alone
+static bool flash_log_program(uint32_t address, const uint32_t *words, uint32_t count) {
+    bool ok = true;
+
+    HAL_FLASH_Unlock();
+    for (uint32_t i = 0; i < count && ok; ++i) {
+        if (words[i] != 0xFFFFFFFFU) {
+            ok = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address + 4U * i, words[i]) == HAL_OK;
+        }
+    }
+    HAL_FLASH_Lock();
+    // The data cache may still hold the erased words
+    FLASH_FlushCaches();
+    return ok;
+}
+
+// Function to erase a sector and write the header that starts it
+static bool flash_log_format(uint32_t sector, uint32_t first_sequence) {
+    FLASH_EraseInitTypeDef erase = {
+        .TypeErase = FLASH_TYPEERASE_SECTORS,
+        .Sector = FLASH_LOG_SECTOR_FIRST + sector,
+        .NbSectors = 1,
+        .VoltageRange = FLASH_VOLTAGE_RANGE_3
+    };
+    flash_log_sector_t *entry = &flash_log_sectors[sector];
+    flash_log_sector_header_t header;
+    uint32_t sector_error = 0;
+
+    header.magic = FLASH_LOG_SECTOR_MAGIC;
+#if FLASH_LOG_IDLE_ERASE
+    bool erased = flash_log_erased[sector];
+    flash_log_erased[sector] = false;
+#else
+    bool erased = false;
+#endif
+    header.erase_count = entry->valid || erased ? entry->erase_count + 1U : 1U;
+    header.first_sequence = first_sequence;
+    taskENTER_CRITICAL();
+    header.crc = crc_unit_calculate((const uint8_t *)&header, sizeof(header) - sizeof(uint32_t));
+    taskEXIT_CRITICAL();
+
+    entry->valid = false;
+    HAL_StatusTypeDef status = HAL_OK;
+    if (!erased) {
+        HAL_FLASH_Unlock();
+        status = HAL_FLASHEx_Erase(&erase, &sector_error);
+        HAL_FLASH_Lock();
+    }
+    if (status != HAL_OK ||
+        !flash_log_program((uint32_t)(uintptr_t)flash_log_page_address(sector, 0), (const uint32_t *)&header,
+                           sizeof(header) / 4U)) {
+        return false;
+    }
+
+    entry->valid = true;
+    entry->erase_count = header.erase_count;
+    entry->first_sequence = first_sequence;
+    entry->used_pages = 1;
+    return true;
+}
+
+// Function to read the header and the programmed pages of one sector into the index
+static void flash_log_scan(uint32_t sector) {
+    flash_log_sector_t *entry = &flash_log_sectors[sector];
+    flash_log_sector_header_t header;
+
+    memcpy(&header, flash_log_page_address(sector, 0), sizeof(header));
+    uint32_t crc = crc_unit_calculate((const uint8_t *)&header, sizeof(header) - sizeof(uint32_t));
+    entry->valid = header.magic == FLASH_LOG_SECTOR_MAGIC && header.crc == crc;
+    entry->erase_count = header.erase_count;
+    entry->first_sequence = header.first_sequence;
+
+    // Pages are programmed in order, the first empty one ends the sector
+    entry->used_pages = 1;
+    while (entry->valid && entry->used_pages < FLASH_LOG_PAGES_PER_SECTOR &&
+           !flash_log_page_empty(flash_log_page_address(sector, entry->used_pages))) {
+        entry->used_pages++;
+    }
+    if (entry->used_pages > 1U) {
+        flash_log_record_header_t first;
+        memcpy(&first, flash_log_page_address(sector, 1), sizeof(first));
+        entry->first_timestamp = first.timestamp;
+    }
+}
+
+// Function to rebuild the index and find where the log continues
+void flash_log_init(void) {
+    bool found = false;
+
+    flash_log_mutex = xSemaphoreCreateMutexStatic(&flash_log_mutex_storage);
+#if FLASH_LOG_IDLE_ERASE && RAM_FUNCTIONS
+    // Same entries, so the switch is safe with the interrupts running
+    memcpy(flash_log_vectors, (const void *)(uintptr_t)SCB->VTOR, sizeof(flash_log_vectors));
+    SCB->VTOR = (uint32_t)(uintptr_t)flash_log_vectors;
+    __DSB();
+#endif
+    memset(flash_log_page, 0xFF, sizeof(flash_log_page));
+    flash_log_page_used = 0;
+    flash_log_error_count = 0;
+
+    for (uint32_t sector = 0; sector < FLASH_LOG_SECTOR_COUNT; ++sector) {
+        flash_log_scan(sector);
+        const flash_log_sector_t *entry = &flash_log_sectors[sector];
+        if (entry->valid && (!found ||
+            (int32_t)(entry->first_sequence - flash_log_sectors[flash_log_write_sector].first_sequence) > 0)) {
+            flash_log_write_sector = sector;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        flash_log_write_sector = 0;
+        flash_log_sequence = 0;
+        flash_log_enabled = flash_log_format(0, 0);
+        if (!flash_log_enabled) {
+            flash_log_error_count++;
+        }
+        return;
+    }
+
+    // The newest record is in the last page of the newest sector that has a good one
+    const flash_log_sector_t *entry = &flash_log_sectors[flash_log_write_sector];
+    flash_log_sequence = entry->first_sequence;
+    for (uint32_t page = entry->used_pages - 1U; page > 0; --page) {
+        const uint8_t *address = flash_log_page_address(flash_log_write_sector, page);
+        flash_log_record_header_t header;
+        bool any = false;
+
+        for (uint32_t offset = 0; flash_log_record_valid(address, offset, FLASH_LOG_PAGE_SIZE, &header);
+             offset += flash_log_record_length(header.size)) {
+            flash_log_sequence = header.sequence + 1U;
+            any = true;
+        }
+        if (any) {
+            break;
+        }
+    }
+    flash_log_enabled = true;
+}
+
+// Function to create the replay task
+void flash_log_start(void) {
+    flash_log_task_handle = xTaskCreateStatic(flash_log_task, "FlashLog", FLASH_LOG_STACK_SIZE, NULL,
+                                              FLASH_LOG_PRIORITY, flash_log_task_stack, &flash_log_task_tcb);
+#if STACK_PROFILE
+    stack_profile_track(flash_log_task_handle, FLASH_LOG_STACK_SIZE);
+#endif
+}
+
+// Function to program the page buffer, moving to the next sector when the
+// write sector is full. Caller holds the mutex.
+static void flash_log_flush_locked(void) {
+    flash_log_sector_t *entry = &flash_log_sectors[flash_log_write_sector];
+
+    if (flash_log_page_used == 0 || !flash_log_enabled) {
+        return;
+    }
+    if (entry->used_pages == FLASH_LOG_PAGES_PER_SECTOR) {
+        // The oldest sector goes, the header dates the sector by its first record
+        uint32_t next = (flash_log_write_sector + 1U) % FLASH_LOG_SECTOR_COUNT;
+        flash_log_record_header_t first;
+
+        memcpy(&first, flash_log_page, sizeof(first));
+        if (!flash_log_format(next, first.sequence)) {
+            // A sector that cannot be erased is worn out, stop rather than lose order
+            flash_log_error_count++;
+            flash_log_enabled = false;
+            return;
+        }
+        flash_log_write_sector = next;
+        entry = &flash_log_sectors[next];
+    }
+
+    if (entry->used_pages == 1U) {
+        flash_log_record_header_t first;
+        memcpy(&first, flash_log_page, sizeof(first));
+        entry->first_timestamp = first.timestamp;
+    }
+    if (!flash_log_program((uint32_t)(uintptr_t)flash_log_page_address(flash_log_write_sector, entry->used_pages),
+                           flash_log_page, FLASH_LOG_PAGE_SIZE / 4U)) {
+        // The records after the failing word fail their CRC, the next page is clean
+        flash_log_error_count++;
+    }
+    entry->used_pages++;
+    memset(flash_log_page, 0xFF, sizeof(flash_log_page));
+    flash_log_page_used = 0;
+#if FLASH_LOG_IDLE_ERASE
+    if (FLASH_LOG_PAGES_PER_SECTOR - entry->used_pages <= FLASH_LOG_ERASE_AHEAD_PAGES &&
+        !flash_log_erased[(flash_log_write_sector + 1U) % FLASH_LOG_SECTOR_COUNT]) {
+        flash_log_erase_due = true;
+    }
+#endif
+}
+
+// Function to add a record to the page buffer
+bool flash_log_append(flash_log_record_t type, uint32_t timestamp, const void *payload, uint16_t size) {
+    uint32_t length = flash_log_record_length(size);
+    flash_log_record_header_t header;
+
+    if (size > FLASH_LOG_PAYLOAD_MAX) {
+        return false;
+    }
+    xSemaphoreTake(flash_log_mutex, portMAX_DELAY);
+    if (flash_log_page_used + length > FLASH_LOG_PAGE_SIZE) {
+        flash_log_flush_locked();
+    }
+    if (!flash_log_enabled) {
+        xSemaphoreGive(flash_log_mutex);
+        return false;
+    }
+
+    uint8_t *record = (uint8_t *)flash_log_page + flash_log_page_used;
+    header.size = size;
+    header.type = (uint8_t)type;
+    header.reserved = 0;
+    header.sequence = flash_log_sequence++;
+    header.timestamp = timestamp;
+    memcpy(record, &header, sizeof(header));
+    memcpy(&record[sizeof(header)], payload, size);
+    taskENTER_CRITICAL();
+    header.crc = crc_unit_calculate(&record[sizeof(uint32_t)], sizeof(header) - sizeof(uint32_t) + size);
+    taskEXIT_CRITICAL();
+    memcpy(record, &header.crc, sizeof(header.crc));
+    flash_log_page_used += length;
+    xSemaphoreGive(flash_log_mutex);
+    return true;
+}
+
+// Function to program the buffered records without waiting for a full page
+void flash_log_flush(void) {
+    xSemaphoreTake(flash_log_mutex, portMAX_DELAY);
+    flash_log_flush_locked();
+    xSemaphoreGive(flash_log_mutex);
+}
+
+// Function to find the oldest record at or after sequence and copy it into a replay frame
+uint16_t flash_log_read(uint32_t sequence, flash_log_frame_t *frame) {
+    flash_log_record_header_t header;
+    const uint8_t *page = NULL;
+    uint32_t offset = 0;
+    bool found = false;
+
+    xSemaphoreTake(flash_log_mutex, portMAX_DELAY);
+    if ((int32_t)(sequence - flash_log_sequence) >= 0) {
+        xSemaphoreGive(flash_log_mutex);
+        return 0;
+    }
+
+    // Sectors from the oldest on, starting at the newest one that begins at or before sequence
+    uint32_t order[FLASH_LOG_SECTOR_COUNT];
+    uint32_t count = 0;
+    for (uint32_t step = 1; step <= FLASH_LOG_SECTOR_COUNT; ++step) {
+        uint32_t sector = (flash_log_write_sector + step) % FLASH_LOG_SECTOR_COUNT;
+        if (flash_log_sectors[sector].valid && flash_log_sectors[sector].used_pages > 1U) {
+            order[count++] = sector;
+        }
+    }
+    uint32_t first = 0;
+    while (first + 1U < count && (int32_t)(flash_log_sectors[order[first + 1U]].first_sequence - sequence) <= 0) {
+        first++;
+    }
+
+    for (uint32_t position = first; position < count && !found; ++position) {
+        uint32_t sector = order[position];
+        uint32_t low = 1, high = flash_log_sectors[sector].used_pages - 1U;
+
+        // Last page whose first record is not newer than sequence
+        while (position == first && low < high) {
+            uint32_t middle = (low + high + 1U) / 2U;
+            memcpy(&header, flash_log_page_address(sector, middle), sizeof(header));
+            if ((int32_t)(header.sequence - sequence) <= 0) {
+                low = middle;
+            } else {
+                high = middle - 1U;
+            }
+        }
+        for (uint32_t index = low; index < flash_log_sectors[sector].used_pages && !found; ++index) {
+            page = flash_log_page_address(sector, index);
+            for (offset = 0; flash_log_record_valid(page, offset, FLASH_LOG_PAGE_SIZE, &header);
+                 offset += flash_log_record_length(header.size)) {
+                if ((int32_t)(header.sequence - sequence) >= 0) {
+                    found = true;
+                    break;
+                }
+            }
+        }
+    }
+    if (!found) {
+        // Not programmed yet, the record is in the page buffer
+        page = (const uint8_t *)flash_log_page;
+        for (offset = 0; flash_log_record_valid(page, offset, flash_log_page_used, &header);
+             offset += flash_log_record_length(header.size)) {
+            if ((int32_t)(header.sequence - sequence) >= 0) {
+                found = true;
+                break;
+            }
+        }
+    }
+    if (found) {
+        frame->type = FLASH_LOG_FRAME_TYPE;
+        frame->version = FLASH_LOG_FRAME_VERSION;
+        frame->record_type = header.type;
+        frame->reserved = 0;
+        frame->sequence = header.sequence;
+        frame->timestamp = header.timestamp;
+        memcpy(frame->payload, &page[offset + sizeof(header)], header.size);
+    }
+    xSemaphoreGive(flash_log_mutex);
+    return found ? (uint16_t)(FLASH_LOG_FRAME_HEADER_SIZE + header.size) : 0;
+}
+
+// Function to find where the records of a time start, by the first record of
+// each sector and then of each page
+uint32_t flash_log_seek(uint32_t timestamp) {
+    flash_log_record_header_t header;
+    uint32_t sequence;
+
+    xSemaphoreTake(flash_log_mutex, portMAX_DELAY);
+    // Sectors oldest first, the newest one whose first record is not newer than timestamp
+    uint32_t sector = FLASH_LOG_SECTOR_COUNT;
+    bool oldest = true;
+    for (uint32_t step = 1; step <= FLASH_LOG_SECTOR_COUNT; ++step) {
+        uint32_t candidate = (flash_log_write_sector + step) % FLASH_LOG_SECTOR_COUNT;
+        const flash_log_sector_t *entry = &flash_log_sectors[candidate];
+        if (!entry->valid || entry->used_pages <= 1U) {
+            continue;
+        }
+        if (oldest || (int32_t)(entry->first_timestamp - timestamp) <= 0) {
+            sector = candidate;
+        }
+        oldest = false;
+    }
+    if (sector == FLASH_LOG_SECTOR_COUNT) {
+        // Nothing programmed yet, every record is in the page buffer
+        sequence = flash_log_sequence;
+        if (flash_log_record_valid((const uint8_t *)flash_log_page, 0, flash_log_page_used, &header)) {
+            sequence = header.sequence;
+        }
+        xSemaphoreGive(flash_log_mutex);
+        return sequence;
+    }
+
+    // Last page whose first record is not newer than timestamp
+    uint32_t low = 1, high = flash_log_sectors[sector].used_pages - 1U;
+    while (low < high) {
+        uint32_t middle = (low + high + 1U) / 2U;
+        memcpy(&header, flash_log_page_address(sector, middle), sizeof(header));
+        if ((int32_t)(header.timestamp - timestamp) <= 0) {
+            low = middle;
+        } else {
+            high = middle - 1U;
+        }
+    }
+    memcpy(&header, flash_log_page_address(sector, low), sizeof(header));
+    sequence = header.sequence;
+    xSemaphoreGive(flash_log_mutex);
+    return sequence;
+}
+
+// Function to start a replay, from task context
+void flash_log_replay(uint32_t sequence) {
+    flash_log_replay_from = sequence;
+    task_signal_set(flash_log_task_handle, TASK_SIGNAL_REPLAY);
+}
+
+// Function to read the sequence of the next record
+uint32_t flash_log_next_sequence(void) {
+    return flash_log_sequence;
+}
+
+// Function to read the number of flash errors
+uint32_t flash_log_errors(void) {
+    return flash_log_error_count;
+}
+
+#if FLASH_LOG_IDLE_ERASE
+// Function to erase the next sector ahead of the write sector, idle task only
+void flash_log_idle(void) {
+    // The idle task must never block, a busy log is tried again at the next idle
+    if (!flash_log_erase_due || xSemaphoreTake(flash_log_mutex, 0) != pdTRUE) {
+        return;
+    }
+    uint32_t next = (flash_log_write_sector + 1U) % FLASH_LOG_SECTOR_COUNT;
+    flash_log_erase_due = false;
+    if (flash_log_enabled && !flash_log_erased[next]) {
+        // Its records go now, a replay must not walk into the erase
+        flash_log_sectors[next].valid = false;
+        sample_timer_hold(true);
+        HAL_FLASH_Unlock();
+        bool ok = flash_log_erase_in_ram(FLASH_LOG_SECTOR_FIRST + next);
+        HAL_FLASH_Lock();
+        // The caches may still hold the old words
+        FLASH_FlushCaches();
+        sample_timer_hold(false);
+        if (ok) {
+            flash_log_erased[next] = true;
+        } else {
+            // flash_log_format erases it again when the log moves on, and counts the failure there
+            flash_log_error_count++;
+        }
+    }
+    xSemaphoreGive(flash_log_mutex);
+}
+
+// Function to erase one sector by its registers, from SRAM. Only the
+// interrupts of the sampling tick level and above can run meanwhile, the
+// others wait until the end with the kernel's.
+RAMFUNC static bool flash_log_erase_in_ram(uint32_t sector_number) {
+    uint32_t basepri = __get_BASEPRI();
+
+    __set_BASEPRI((IRQ_PRIORITY_TIMER + 1U) << (8U - __NVIC_PRIO_BITS));
+    while ((FLASH->SR & FLASH_SR_BSY) != 0) {
+    }
+    FLASH->SR = FLASH_LOG_ERASE_ERRORS | FLASH_SR_EOP;
+    FLASH->CR = (FLASH->CR & ~(FLASH_CR_PSIZE | FLASH_CR_SNB)) | FLASH_PSIZE_WORD | FLASH_CR_SER |
+                (sector_number << FLASH_CR_SNB_Pos);
+    FLASH->CR |= FLASH_CR_STRT;
+    while ((FLASH->SR & FLASH_SR_BSY) != 0) {
+    }
+    FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+    uint32_t errors = FLASH->SR & FLASH_LOG_ERASE_ERRORS;
+    FLASH->SR = errors;
+    __set_BASEPRI(basepri);
+    return errors == 0;
+}
+#endif
+
+// Function to keep the log off the flash while another writer uses it
+void flash_log_lock(void) {
+    xSemaphoreTake(flash_log_mutex, portMAX_DELAY);
+}
+
+// Function to let the log program and erase again
+void flash_log_unlock(void) {
+    xSemaphoreGive(flash_log_mutex);
+}
+
+// Function to send the requested records as fast as the transmit queue drains
+static void flash_log_task(void *argument) {
+    flash_log_frame_t frame;
+
+    (void)argument;
+    while (1) {
+        task_signal_wait(TASK_SIGNAL_REPLAY, portMAX_DELAY);
+        uint32_t sequence = flash_log_replay_from;
+
+        while (1) {
+            if (task_signal_wait(TASK_SIGNAL_REPLAY, 0) != 0) {
+                // A new request replaces the running replay
+                sequence = flash_log_replay_from;
+            }
+            // One burst stays free for the live frames of the consumer
+            while (link_route_free(LINK_TRAFFIC_DUMP) <= 1) {
+                vTaskDelay(1);
+            }
+
+            uint16_t size = flash_log_read(sequence, &frame);
+            if (size == 0) {
+                break;
+            }
+            link_route_send(LINK_TRAFFIC_DUMP, (const uint8_t *)&frame, size);
+            sequence = frame.sequence + 1U;
+        }
+
+        // Tell the receiver where the live log stands
+        frame.type = FLASH_LOG_FRAME_TYPE;
+        frame.version = FLASH_LOG_FRAME_VERSION;
+        frame.record_type = FLASH_LOG_RECORD_END;
+        frame.reserved = 0;
+        frame.sequence = flash_log_next_sequence();
+        frame.timestamp = 0;
+        link_route_send(LINK_TRAFFIC_DUMP, (const uint8_t *)&frame, FLASH_LOG_FRAME_HEADER_SIZE);
+        link_route_flush(LINK_TRAFFIC_DUMP);
+    }
+}
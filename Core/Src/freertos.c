@@ -24,6 +24,10 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "energy_profile.h"
+#include "flash_log.h"
+#include "heap_telemetry.h"
+#include "time_base.h"
 
 /* USER CODE END Includes */
 
@@ -44,6 +48,11 @@
 
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN Variables */
+/* heap_4 pool in CCM RAM: task stacks and kernel objects stay off the bus
+   matrix shared with the DMA, nothing allocated from it may be a DMA target */
+#if (configSUPPORT_DYNAMIC_ALLOCATION == 1)
+uint8_t ucHeap[configTOTAL_HEAP_SIZE] CCMRAM_NOINIT;
+#endif
 
 /* USER CODE END Variables */
 
@@ -56,8 +65,8 @@
 void vApplicationGetIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer, uint32_t *pulIdleTaskStackSize );
 
 /* USER CODE BEGIN GET_IDLE_TASK_MEMORY */
-static StaticTask_t xIdleTaskTCBBuffer;
-static StackType_t xIdleStack[configMINIMAL_STACK_SIZE];
+static StaticTask_t xIdleTaskTCBBuffer CCMRAM;
+static StackType_t xIdleStack[configMINIMAL_STACK_SIZE] CCMRAM_NOINIT;
 
 void vApplicationGetIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer, uint32_t *pulIdleTaskStackSize )
 {
@@ -68,7 +77,110 @@ void vApplicationGetIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer, StackTy
 }
 /* USER CODE END GET_IDLE_TASK_MEMORY */
 
+/* GetTimerTaskMemory prototype (linked to static allocation support) */
+void vApplicationGetTimerTaskMemory( StaticTask_t **ppxTimerTaskTCBBuffer, StackType_t **ppxTimerTaskStackBuffer, uint32_t *pulTimerTaskStackSize );
+
+/* USER CODE BEGIN GET_TIMER_TASK_MEMORY */
+static StaticTask_t xTimerTaskTCBBuffer CCMRAM;
+static StackType_t xTimerStack[configTIMER_TASK_STACK_DEPTH] CCMRAM_NOINIT;
+
+void vApplicationGetTimerTaskMemory( StaticTask_t **ppxTimerTaskTCBBuffer, StackType_t **ppxTimerTaskStackBuffer, uint32_t *pulTimerTaskStackSize )
+{
+  *ppxTimerTaskTCBBuffer = &xTimerTaskTCBBuffer;
+  *ppxTimerTaskStackBuffer = &xTimerStack[0];
+  *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+  /* place for user code */
+}
+/* USER CODE END GET_TIMER_TASK_MEMORY */
+
+/* USER CODE BEGIN PREPOSTSLEEP */
+#if (configUSE_TICKLESS_IDLE == 1)
+extern TIM_HandleTypeDef htim1;
+
+/* Called by the idle task with interrupts masked, right before the WFI.
+   TIM1 would end the sleep every millisecond, so its update interrupt and
+   counter are stopped until the core wakes. Any enabled interrupt (SysTick at
+   the end of the expected idle time, TIM3, DMA, USART2) still wakes it. */
+void PreSleepProcessing(uint32_t *ulExpectedIdleTime)
+{
+  (void)ulExpectedIdleTime;
+  HAL_SuspendTick();
+  __HAL_TIM_DISABLE(&htim1);
+#if ENERGY_PROFILE
+  energy_profile_enter(ENERGY_STATE_SLEEP);
+  energy_profile_begin(ENERGY_STAGE_SLEEP);
+#endif
+}
+
+void PostSleepProcessing(uint32_t *ulExpectedIdleTime)
+{
+  (void)ulExpectedIdleTime;
+#if ENERGY_PROFILE
+  energy_profile_end(ENERGY_STAGE_SLEEP);
+  energy_profile_enter(ENERGY_STATE_RUN);
+#endif
+  __HAL_TIM_ENABLE(&htim1);
+  HAL_ResumeTick();
+}
+
+/* vTaskStepTick reports the tick periods that passed in sleep, the HAL tick
+   missed the same time while TIM1 was stopped */
+void PostSleepStepTick(uint32_t ulSteppedTicks)
+{
+  uwTick += ulSteppedTicks * portTICK_PERIOD_MS;
+}
+#endif
+/* USER CODE END PREPOSTSLEEP */
+
 /* Private application code --------------------------------------------------*/
 /* USER CODE BEGIN Application */
+#if (configUSE_IDLE_HOOK == 1)
+/* Called by the idle task on every pass, before it sleeps. Nothing else runs
+   then, so the flash log erases its next sector here. */
+void vApplicationIdleHook(void)
+{
+  flash_log_idle();
+}
+#endif
+
+#if (configGENERATE_RUN_TIME_STATS == 1)
+extern TIM_HandleTypeDef htim2;
+
+/* Functions needed when configGENERATE_RUN_TIME_STATS is on */
+void configureTimerForRunTimeStats(void)
+{
+  /* TIM2 is a free running 32-bit counter at 1 MHz, set up by MX_TIM2_Init.
+     With TIME_BASE it already runs since time_base_start. */
+#if !TIME_BASE
+  HAL_TIM_Base_Start(&htim2);
+#endif
+}
+
+unsigned long getRunTimeCounterValue(void)
+{
+  return TIM2->CNT;
+}
+#endif
+
+#if (configCHECK_FOR_STACK_OVERFLOW > 0)
+/* Name of the task whose stack overflowed, for the debugger */
+volatile const char *stack_overflow_task;
+
+void vApplicationStackOverflowHook(TaskHandle_t xTask, char *pcTaskName)
+{
+  /* The stack no longer holds what the task needs to go on, stop here */
+  (void)xTask;
+  stack_overflow_task = pcTaskName;
+  Error_Handler();
+}
+#endif
+
+#if (configUSE_MALLOC_FAILED_HOOK == 1)
+void vApplicationMallocFailedHook(void)
+{
+  /* Only counted, the caller sees NULL and handles it */
+  heap_telemetry_malloc_failed();
+}
+#endif
 
 /* USER CODE END Application */
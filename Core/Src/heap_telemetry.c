@@ -0,0 +1,131 @@
+/**
+  ******************************************************************************
+  * @file    heap_telemetry.c
+  * @brief   FreeRTOS heap_4 and newlib heap usage frame.
+  *
+  *          Two heaps can hand out memory: heap_4 in CCM RAM for kernel
+  *          objects made with the dynamic API, and the newlib heap that _sbrk
+  *          grows from _end towards the main stack. The pipeline allocates
+  *          from neither, everything it uses is static, so the frame is there
+  *          to prove it and to size configTOTAL_HEAP_SIZE and _Min_Heap_Size.
+  *
+  *          heap_4 keeps the free space, the minimum ever free and the
+  *          allocation counts, vPortGetHeapStats walks its free list for the
+  *          largest block and the fragment count. The traceMALLOC hook flags
+  *          every allocation made once the scheduler runs and keeps the task
+  *          of the last one. newlib malloc cannot be traced without wrapping
+  *          it, so a growth of its heap after the start stands for it: the
+  *          first malloc of a size newlib has no free chunk for.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "heap_telemetry.h"
+#include "cmsis_os.h"
+#include "stats_arena.h"
+#include <stdbool.h>
+#include <string.h>
+
+/* Private variables ---------------------------------------------------------*/
+static volatile uint32_t heap_telemetry_rtos_failed;
+static volatile uint32_t heap_telemetry_late_allocs;
+static uint32_t heap_telemetry_late_size;
+static char heap_telemetry_late_task[4];
+static volatile uint32_t heap_telemetry_sbrk_used;
+static volatile uint32_t heap_telemetry_sbrk_peak;
+static volatile uint32_t heap_telemetry_sbrk_failures;
+static volatile bool heap_telemetry_failed_any;
+
+// Function to tell whether the scheduler was started
+static bool heap_telemetry_scheduler_started(void) {
+    return xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED;
+}
+
+// Function to remember an allocation made after the scheduler started
+static void heap_telemetry_late(uint32_t size) {
+    const char *name = pcTaskGetName(NULL);
+
+    taskENTER_CRITICAL();
+    heap_telemetry_late_allocs++;
+    heap_telemetry_late_size = size;
+    strncpy(heap_telemetry_late_task, name, sizeof(heap_telemetry_late_task));
+    taskEXIT_CRITICAL();
+}
+
+// Function to trace a pvPortMalloc call, runs with the scheduler suspended
+void heap_telemetry_malloc(void *address, uint32_t size) {
+    (void)address;
+    if (heap_telemetry_scheduler_started()) {
+        heap_telemetry_late(size);
+    }
+}
+
+// Function to count a pvPortMalloc call that found no block
+void heap_telemetry_malloc_failed(void) {
+    heap_telemetry_rtos_failed++;
+    heap_telemetry_failed_any = true;
+}
+
+// Function to follow the size of the newlib heap
+void heap_telemetry_sbrk(int32_t increment, uint32_t used) {
+    heap_telemetry_sbrk_used = used;
+    if (used > heap_telemetry_sbrk_peak) {
+        heap_telemetry_sbrk_peak = used;
+    }
+    if (increment > 0 && heap_telemetry_scheduler_started()) {
+        heap_telemetry_late((uint32_t)increment);
+    }
+}
+
+// Function to count a refused growth of the newlib heap
+void heap_telemetry_sbrk_failed(void) {
+    heap_telemetry_sbrk_failures++;
+    heap_telemetry_failed_any = true;
+}
+
+// Function to build a heap telemetry frame
+uint16_t heap_telemetry_build(heap_telemetry_frame_t *frame) {
+    memset(frame, 0, sizeof(*frame));
+    frame->type = HEAP_TELEMETRY_FRAME_TYPE;
+
+#if (configSUPPORT_DYNAMIC_ALLOCATION == 1)
+    HeapStats_t stats;
+    vPortGetHeapStats(&stats);
+    frame->rtos_free_blocks = (uint16_t)(stats.xNumberOfFreeBlocks > UINT16_MAX ? UINT16_MAX
+                                                                                 : stats.xNumberOfFreeBlocks);
+    frame->rtos_free = stats.xAvailableHeapSpaceInBytes;
+    frame->rtos_min_ever_free = stats.xMinimumEverFreeBytesRemaining;
+    frame->rtos_largest_free = stats.xSizeOfLargestFreeBlockInBytes;
+    frame->rtos_allocs = stats.xNumberOfSuccessfulAllocations;
+    frame->rtos_frees = stats.xNumberOfSuccessfulFrees;
+#else
+    frame->flags |= HEAP_TELEMETRY_FLAG_NO_RTOS_HEAP;
+#endif
+    frame->rtos_failed = heap_telemetry_rtos_failed;
+
+    taskENTER_CRITICAL();
+    frame->late_allocs = heap_telemetry_late_allocs;
+    frame->late_size = heap_telemetry_late_size;
+    memcpy(frame->late_task, heap_telemetry_late_task, sizeof(frame->late_task));
+    taskEXIT_CRITICAL();
+    if (frame->late_allocs != 0) {
+        frame->flags |= HEAP_TELEMETRY_FLAG_LATE_ALLOC;
+    }
+
+    frame->sbrk_used = heap_telemetry_sbrk_used;
+    frame->sbrk_peak = heap_telemetry_sbrk_peak;
+    frame->sbrk_failed = heap_telemetry_sbrk_failures;
+    if (heap_telemetry_failed_any) {
+        frame->flags |= HEAP_TELEMETRY_FLAG_FAILED;
+    }
+
+#if STATS_ARENA
+    // Carved by the consumer task, which also sends this frame
+    const arena_t *arena = stats_arena_state();
+    frame->flags |= HEAP_TELEMETRY_FLAG_ARENA;
+    frame->arena_size = arena->size;
+    frame->arena_used = arena->used;
+    frame->arena_peak = arena->peak;
+#endif
+    return sizeof(*frame);
+}
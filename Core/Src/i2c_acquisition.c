@@ -0,0 +1,652 @@
+/**
+  ******************************************************************************
+  * @file    i2c_acquisition.c
+  * @brief   DMA-driven I2C acquisition engine.
+  *
+  *          Reads are described as a list of transactions, each on one of
+  *          the I2C_BUS_COUNT buses. The first read of every bus is started
+  *          with HAL_I2C_Master_Receive_DMA, or HAL_I2C_Master_Transmit_IT
+  *          for a command that starts a conversion. Every completion
+  *          callback starts the next transaction of the same bus from
+  *          interrupt context and only the end of the last bus wakes the
+  *          calling task with a notification. A sample of all sensors costs
+  *          one wake-up, each bus stays busy back to back and the buses
+  *          overlap, so the time of a tick is that of its busiest bus.
+  *
+  *          The barrier is seq_pending, one bit per bus with reads in the
+  *          list, cleared by the last completion of each bus. The bus
+  *          interrupts share one priority and never nest, so clearing needs
+  *          no lock, and the one that clears the last bit sends the single
+  *          notification. A bit per bus rather than per channel is enough,
+  *          as a bus only finishes after every read it holds. An event group
+  *          would do the same with more RAM, and xEventGroupSetBitsFromISR
+  *          defers the set to the timer service task, one more context
+  *          switch between the last byte and the wake-up.
+  *
+  *          A timeout, bus error or lost arbitration usually means a slave
+  *          still holds SDA low. The bus is then recovered by clocking SCL as
+  *          a GPIO, sending a STOP and resetting the peripheral, so one glitch
+  *          does not make every following sample fail.
+  *
+  *          With SENSOR_POWER_GATING the buses are deinitialized between
+  *          the reads of two ticks, with the supply of the sensors, and
+  *          initialized again by the HAL before the next reads.
+  *
+  *          With I2C_TELEMETRY the end of every transaction and every
+  *          recovery is counted for its bus and device, see i2c_telemetry.c.
+  *
+  *          With LL_FAST_PATH the HAL calls and IRQ handlers are left out
+  *          of the sample path: a transaction is started with a few
+  *          register writes and its address phase, bytes and STOP are
+  *          driven from the event, error and DMA interrupts of its bus.
+  *          Reads of 2 bytes or more still go through the DMA, the others
+  *          are moved by the event interrupt.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "i2c_acquisition.h"
+#include "crash_capture.h"
+#include "cycle_counter.h"
+#include "i2c_telemetry.h"
+#include "ram_func.h"
+#include "task_signal.h"
+#include "stm32f4xx_ll_dma.h"
+#if LL_FAST_PATH
+#include "stm32f4xx_ll_i2c.h"
+#endif
+
+/* External variables --------------------------------------------------------*/
+extern I2C_HandleTypeDef hi2c1;
+#if I2C_BUS_COUNT > 1
+extern I2C_HandleTypeDef hi2c2;
+#endif
+#if I2C_BUS_COUNT > 2
+extern I2C_HandleTypeDef hi2c3;
+#endif
+
+/* Private defines -----------------------------------------------------------*/
+// A slave can be stuck in the middle of a byte plus its ACK
+#define I2C_RECOVERY_CLOCKS 9
+// Errors that leave the bus or the peripheral in an unknown state
+#define I2C_RECOVERY_ERRORS (HAL_I2C_ERROR_BERR | HAL_I2C_ERROR_ARLO | HAL_I2C_ERROR_TIMEOUT)
+#if LL_FAST_PATH
+// Cycles BUSY may take to drop after the STOP of the previous transaction,
+// two SCL periods. Starts run from the interrupts, a bus busy for longer is
+// refused and left to the recovery at the end of the list.
+#define I2C_LL_BUSY_CYCLES (2U * SystemCoreClock / I2C_BUS_SPEED_HZ)
+// DMA stream flags, shifted down to those of stream 0: transfer complete,
+// transfer error and all of them
+#define I2C_LL_DMA_TC 0x20U
+#define I2C_LL_DMA_TE 0x08U
+#define I2C_LL_DMA_ALL 0x3DU
+#endif
+
+/* Private types -------------------------------------------------------------*/
+// Peripheral and pins of one bus, the pins are driven as GPIO to recover it
+typedef struct {
+    I2C_HandleTypeDef *handle;
+    GPIO_TypeDef *scl_port;
+    uint16_t scl_pin;
+    GPIO_TypeDef *sda_port;
+    uint16_t sda_pin;
+    uint32_t reset_mask; // RCC_APB1RSTR bit of the peripheral
+    uint32_t dma_stream; // LL_DMA_STREAM_x of the receive stream on DMA1
+} i2c_bus_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const i2c_bus_t i2c_buses[I2C_BUS_COUNT] = {
+    { &hi2c1, GPIOB, GPIO_PIN_6, GPIOB, GPIO_PIN_7, RCC_APB1RSTR_I2C1RST, LL_DMA_STREAM_0 },
+#if I2C_BUS_COUNT > 1
+    { &hi2c2, GPIOB, GPIO_PIN_10, GPIOB, GPIO_PIN_11, RCC_APB1RSTR_I2C2RST, LL_DMA_STREAM_3 },
+#endif
+#if I2C_BUS_COUNT > 2
+    { &hi2c3, GPIOA, GPIO_PIN_8, GPIOC, GPIO_PIN_9, RCC_APB1RSTR_I2C3RST, LL_DMA_STREAM_2 },
+#endif
+};
+
+// Task waiting for the current list, notified from the HAL callbacks
+static TaskHandle_t volatile i2c_transfer_task;
+// List being executed, the index of each bus is advanced from ISR context only
+static i2c_transaction_t *seq_list;
+static uint32_t seq_count;
+static volatile uint32_t seq_index[I2C_BUS_COUNT];
+// Bit n set: bus n still has reads of the list to run. Cleared from the
+// interrupts of the buses, which share one priority and never nest.
+static volatile uint32_t seq_pending;
+// Set by the task on timeout so the abort callbacks end the list
+static volatile bool seq_aborting;
+// HAL error codes collected over the current list, per bus
+static volatile uint32_t seq_error_code[I2C_BUS_COUNT];
+#if I2C_TELEMETRY
+// Cycle count at the start of the current transaction of each bus
+static uint32_t seq_start_cycles[I2C_BUS_COUNT];
+#endif
+#if LL_FAST_PATH
+// Bytes of the current transaction not moved yet, when the interrupt moves them
+static uint8_t *ll_data[I2C_BUS_COUNT];
+static uint16_t ll_remaining[I2C_BUS_COUNT];
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+static uint32_t i2c_bus_of(const I2C_HandleTypeDef *hi2c);
+static uint32_t i2c_sequence_find(uint32_t bus, uint32_t from);
+static void i2c_sequence_start_next(uint32_t bus);
+static void i2c_sequence_bus_done(uint32_t bus);
+static void i2c_sequence_step_from_isr(uint32_t bus, HAL_StatusTypeDef status, uint32_t error);
+static void i2c_bus_delay(void);
+#if LL_FAST_PATH
+static void i2c_bus_ll_setup(uint32_t bus);
+static HAL_StatusTypeDef i2c_bus_ll_start(uint32_t bus, const i2c_transaction_t *transaction);
+static void i2c_bus_ll_stop(uint32_t bus);
+static uint32_t i2c_bus_dma_flags(uint32_t bus);
+static void i2c_bus_dma_clear(uint32_t bus, uint32_t flags);
+#endif
+
+// Function to reset the acquisition state
+void i2c_acquisition_init(void) {
+    i2c_transfer_task = NULL;
+    seq_list = NULL;
+    seq_count = 0;
+    seq_pending = 0;
+    seq_aborting = false;
+    for (uint32_t bus = 0; bus < I2C_BUS_COUNT; ++bus) {
+        seq_index[bus] = 0;
+        seq_error_code[bus] = 0;
+#if LL_FAST_PATH
+        i2c_bus_ll_setup(bus);
+#endif
+    }
+}
+
+// Function to run a list of reads, back to back on each bus, and wait for the last one
+HAL_StatusTypeDef i2c_acquisition_run(i2c_transaction_t *list, uint32_t count, uint32_t timeout_ms) {
+    HAL_StatusTypeDef result = HAL_OK;
+    uint32_t used = 0;
+
+    if (count == 0) {
+        return HAL_OK;
+    }
+    // Drop a completion left over from a list that timed out earlier
+    i2c_transfer_task = xTaskGetCurrentTaskHandle();
+    task_signal_wait(TASK_SIGNAL_I2C_DONE, 0);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        list[i].status = HAL_BUSY;
+        used |= 1U << list[i].bus;
+    }
+    seq_list = list;
+    seq_count = count;
+    for (uint32_t bus = 0; bus < I2C_BUS_COUNT; ++bus) {
+        seq_index[bus] = 0;
+        seq_error_code[bus] = 0;
+    }
+    seq_pending = used;
+    seq_aborting = false;
+
+    // The I2C interrupts must not step the list while it is being started
+    taskENTER_CRITICAL();
+    for (uint32_t bus = 0; bus < I2C_BUS_COUNT; ++bus) {
+        if ((used & (1U << bus)) != 0) {
+            i2c_sequence_start_next(bus);
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    // Sleep until the last transaction of every bus completed or failed
+    if (task_signal_wait(TASK_SIGNAL_I2C_DONE, pdMS_TO_TICKS(timeout_ms)) == 0) {
+        // A slave did not answer in time, stop the transfers and release the buses
+        uint32_t stuck = seq_pending;
+        seq_aborting = true;
+#if LL_FAST_PATH
+        // Nothing to wait for, the transfers end here
+        taskENTER_CRITICAL();
+        for (uint32_t bus = 0; bus < I2C_BUS_COUNT; ++bus) {
+            if ((stuck & (1U << bus)) != 0 && seq_index[bus] < count) {
+                i2c_bus_ll_stop(bus);
+                i2c_sequence_step_from_isr(bus, HAL_TIMEOUT, HAL_I2C_ERROR_TIMEOUT);
+            }
+        }
+        taskEXIT_CRITICAL();
+#else
+        for (uint32_t bus = 0; bus < I2C_BUS_COUNT; ++bus) {
+            uint32_t index = seq_index[bus];
+            if ((stuck & (1U << bus)) != 0 && index < count) {
+                HAL_I2C_Master_Abort_IT(i2c_buses[bus].handle, list[index].device_address << 1);
+            }
+        }
+#endif
+        task_signal_wait(TASK_SIGNAL_I2C_DONE, pdMS_TO_TICKS(timeout_ms));
+        for (uint32_t i = 0; i < count; ++i) {
+            if (list[i].status == HAL_BUSY) {
+                list[i].done_cycles = cycle_counter_now();
+                list[i].status = HAL_TIMEOUT;
+            }
+        }
+        for (uint32_t bus = 0; bus < I2C_BUS_COUNT; ++bus) {
+            if ((stuck & (1U << bus)) != 0) {
+                i2c_acquisition_recover(bus);
+            }
+        }
+        return HAL_TIMEOUT;
+    }
+
+    for (uint32_t bus = 0; bus < I2C_BUS_COUNT; ++bus) {
+        if ((used & (1U << bus)) != 0 && ((seq_error_code[bus] & I2C_RECOVERY_ERRORS) != 0 ||
+                                          __HAL_I2C_GET_FLAG(i2c_buses[bus].handle, I2C_FLAG_BUSY))) {
+            i2c_acquisition_recover(bus);
+        }
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (list[i].status != HAL_OK) {
+            result = HAL_ERROR;
+        }
+    }
+    return result;
+}
+
+// Function to read from one I2C1 device with DMA and wait for completion
+HAL_StatusTypeDef i2c_acquisition_read(uint8_t device_address, uint8_t *data, uint16_t size, uint32_t timeout_ms) {
+    i2c_transaction_t transaction = { .device_address = device_address, .data = data, .size = size };
+
+    i2c_acquisition_run(&transaction, 1, timeout_ms);
+    return transaction.status;
+}
+
+// Function to wait about half an SCL period of standard mode
+static void i2c_bus_delay(void) {
+    for (volatile uint32_t i = SystemCoreClock / 1000000U; i > 0; --i) {
+    }
+}
+
+// Function to release a stuck bus and bring its peripheral back to a known state
+void i2c_acquisition_recover(uint32_t bus) {
+    const i2c_bus_t *pins = &i2c_buses[bus];
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+#if CRASH_CAPTURE
+#if LL_FAST_PATH
+    // The HAL did not run the transfers, the errors are those of the list
+    uint32_t error_code = seq_error_code[bus];
+#else
+    uint32_t error_code = pins->handle->ErrorCode;
+#endif
+    crash_capture_trace(CRASH_EVENT_I2C_RECOVER, (bus << 12) | (error_code & 0xFFFU));
+#endif
+#if I2C_TELEMETRY
+    i2c_telemetry_recovery(bus);
+#endif
+
+    HAL_I2C_DeInit(pins->handle);
+
+    // Drive both lines as open-drain GPIO, released high
+    HAL_GPIO_WritePin(pins->scl_port, pins->scl_pin, GPIO_PIN_SET);
+    HAL_GPIO_WritePin(pins->sda_port, pins->sda_pin, GPIO_PIN_SET);
+    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_OD;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+    GPIO_InitStruct.Pin = pins->scl_pin;
+    HAL_GPIO_Init(pins->scl_port, &GPIO_InitStruct);
+    GPIO_InitStruct.Pin = pins->sda_pin;
+    HAL_GPIO_Init(pins->sda_port, &GPIO_InitStruct);
+    i2c_bus_delay();
+
+    // Clock SCL until the slave finishes its byte and lets SDA go
+    for (uint32_t i = 0; i < I2C_RECOVERY_CLOCKS; ++i) {
+        if (HAL_GPIO_ReadPin(pins->sda_port, pins->sda_pin) == GPIO_PIN_SET) {
+            break;
+        }
+        HAL_GPIO_WritePin(pins->scl_port, pins->scl_pin, GPIO_PIN_RESET);
+        i2c_bus_delay();
+        HAL_GPIO_WritePin(pins->scl_port, pins->scl_pin, GPIO_PIN_SET);
+        i2c_bus_delay();
+    }
+
+    // STOP condition: SDA rises while SCL is high
+    HAL_GPIO_WritePin(pins->sda_port, pins->sda_pin, GPIO_PIN_RESET);
+    i2c_bus_delay();
+    HAL_GPIO_WritePin(pins->scl_port, pins->scl_pin, GPIO_PIN_SET);
+    i2c_bus_delay();
+    HAL_GPIO_WritePin(pins->sda_port, pins->sda_pin, GPIO_PIN_SET);
+    i2c_bus_delay();
+
+    // Reset the peripheral, it may still see the bus as busy
+    SET_BIT(RCC->APB1RSTR, pins->reset_mask);
+    CLEAR_BIT(RCC->APB1RSTR, pins->reset_mask);
+
+    // MspInit gives the pins back to the peripheral and relinks the DMA
+    if (HAL_I2C_Init(pins->handle) != HAL_OK) {
+        Error_Handler();
+    }
+#if LL_FAST_PATH
+    i2c_bus_ll_setup(bus);
+#endif
+}
+
+#if SENSOR_POWER_GATING
+// Function to switch the sensors and their buses on or off between the reads of two ticks
+void i2c_acquisition_power(bool on) {
+    if (!on) {
+        // MspDeInit stops the clock, the DMA stream and the interrupts, and floats the pins
+        for (uint32_t bus = 0; bus < I2C_BUS_COUNT; ++bus) {
+            HAL_I2C_DeInit(i2c_buses[bus].handle);
+        }
+        HAL_GPIO_WritePin(SENSOR_POWER_GPIO_Port, SENSOR_POWER_Pin, GPIO_PIN_RESET);
+        return;
+    }
+    HAL_GPIO_WritePin(SENSOR_POWER_GPIO_Port, SENSOR_POWER_Pin, GPIO_PIN_SET);
+    for (uint32_t bus = 0; bus < I2C_BUS_COUNT; ++bus) {
+        // The handle kept its Init, MspInit brings the clock, pins and DMA back
+        if (HAL_I2C_Init(i2c_buses[bus].handle) != HAL_OK) {
+            Error_Handler();
+        }
+#if LL_FAST_PATH
+        i2c_bus_ll_setup(bus);
+#endif
+    }
+    // A tick period rounds down, one more makes the wait at least SENSOR_POWER_UP_MS
+    vTaskDelay(pdMS_TO_TICKS(SENSOR_POWER_UP_MS) + 1U);
+}
+#endif
+
+// Function to find the bus of a HAL handle, I2C_BUS_COUNT when it is none of them
+RAMFUNC static uint32_t i2c_bus_of(const I2C_HandleTypeDef *hi2c) {
+    uint32_t bus = 0;
+
+    while (bus < I2C_BUS_COUNT && i2c_buses[bus].handle->Instance != hi2c->Instance) {
+        bus++;
+    }
+    return bus;
+}
+
+// Function to find the next transaction of a bus, seq_count when it has no more
+RAMFUNC static uint32_t i2c_sequence_find(uint32_t bus, uint32_t from) {
+    while (from < seq_count && seq_list[from].bus != bus) {
+        from++;
+    }
+    return from;
+}
+
+// Function to start the next transaction of a bus, skipping those the HAL refuses.
+// Runs in task context with the I2C interrupts masked, or from the callbacks.
+RAMFUNC static void i2c_sequence_start_next(uint32_t bus) {
+    uint32_t index;
+
+    while ((index = i2c_sequence_find(bus, seq_index[bus])) < seq_count) {
+        i2c_transaction_t *transaction = &seq_list[index];
+        HAL_StatusTypeDef status;
+
+        seq_index[bus] = index;
+#if LL_FAST_PATH
+        status = i2c_bus_ll_start(bus, transaction);
+#else
+        uint16_t address = transaction->device_address << 1;
+        if (transaction->write) {
+            // A few command bytes, not worth a DMA stream of their own
+            status = HAL_I2C_Master_Transmit_IT(i2c_buses[bus].handle, address, transaction->data, transaction->size);
+        } else {
+            status = HAL_I2C_Master_Receive_DMA(i2c_buses[bus].handle, address, transaction->data, transaction->size);
+        }
+#endif
+        if (status == HAL_OK) {
+#if I2C_TELEMETRY
+            seq_start_cycles[bus] = cycle_counter_now();
+#endif
+            return;
+        }
+        transaction->done_cycles = cycle_counter_now();
+        transaction->status = status;
+#if I2C_TELEMETRY
+        // Refused before it reached the bus
+        i2c_telemetry_transaction_from_isr(bus, transaction->device_address, transaction->size, status, 0, 0);
+#endif
+        seq_index[bus] = index + 1U;
+    }
+    seq_index[bus] = seq_count;
+    i2c_sequence_bus_done(bus);
+}
+
+// Function to retire a bus from the list, the last one wakes the task
+RAMFUNC static void i2c_sequence_bus_done(uint32_t bus) {
+    uint32_t pending = seq_pending & ~(1U << bus);
+
+    seq_pending = pending;
+    if (pending == 0) {
+        task_signal_set_from_isr(i2c_transfer_task, TASK_SIGNAL_I2C_DONE);
+    }
+}
+
+// Function to record the result of the current transaction of a bus, with
+// the HAL_I2C_ERROR_* flags it raised, and chain its next one
+RAMFUNC static void i2c_sequence_step_from_isr(uint32_t bus, HAL_StatusTypeDef status, uint32_t error) {
+    uint32_t index = seq_index[bus];
+
+    seq_error_code[bus] |= error;
+    if (index >= seq_count) {
+        return;
+    }
+    seq_list[index].done_cycles = cycle_counter_now();
+    seq_list[index].status = status;
+#if I2C_TELEMETRY
+    i2c_telemetry_transaction_from_isr(bus, seq_list[index].device_address, seq_list[index].size, status, error,
+                                       seq_list[index].done_cycles - seq_start_cycles[bus]);
+#endif
+    seq_index[bus] = index + 1U;
+    if (seq_aborting) {
+        i2c_sequence_bus_done(bus);
+        return;
+    }
+    i2c_sequence_start_next(bus);
+}
+
+// DMA receive complete callback
+RAMFUNC void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c) {
+    uint32_t bus = i2c_bus_of(hi2c);
+
+    if (bus < I2C_BUS_COUNT) {
+        i2c_sequence_step_from_isr(bus, HAL_OK, 0);
+    }
+}
+
+// Interrupt driven write complete callback
+RAMFUNC void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c) {
+    uint32_t bus = i2c_bus_of(hi2c);
+
+    if (bus < I2C_BUS_COUNT) {
+        i2c_sequence_step_from_isr(bus, HAL_OK, 0);
+    }
+}
+
+// Bus error, NACK or arbitration lost, the next device is still read
+RAMFUNC void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c) {
+    uint32_t bus = i2c_bus_of(hi2c);
+
+    if (bus < I2C_BUS_COUNT) {
+        i2c_sequence_step_from_isr(bus, HAL_ERROR, hi2c->ErrorCode);
+    }
+}
+
+// Abort requested after a timeout has completed
+void HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef *hi2c) {
+    uint32_t bus = i2c_bus_of(hi2c);
+
+    if (bus < I2C_BUS_COUNT) {
+        i2c_sequence_step_from_isr(bus, HAL_TIMEOUT, 0);
+    }
+}
+
+#if LL_FAST_PATH
+// Function to point the receive stream of a bus at its data register, after every HAL_I2C_Init
+static void i2c_bus_ll_setup(uint32_t bus) {
+    const i2c_bus_t *pins = &i2c_buses[bus];
+
+    LL_DMA_SetPeriphAddress(DMA1, pins->dma_stream, (uint32_t)(uintptr_t)&pins->handle->Instance->DR);
+    LL_DMA_EnableIT_TC(DMA1, pins->dma_stream);
+    LL_DMA_EnableIT_TE(DMA1, pins->dma_stream);
+}
+
+// Function to read the flags of the receive stream of a bus. HAL_DMA_Init
+// keeps where they are: StreamBaseAddress is the LISR or HISR of the
+// stream, its clear register two words on, and StreamIndex the shift.
+RAMFUNC static uint32_t i2c_bus_dma_flags(uint32_t bus) {
+    const DMA_HandleTypeDef *hdma = i2c_buses[bus].handle->hdmarx;
+
+    return ((volatile uint32_t *)(uintptr_t)hdma->StreamBaseAddress)[0] >> hdma->StreamIndex;
+}
+
+// Function to clear flags of the receive stream of a bus
+RAMFUNC static void i2c_bus_dma_clear(uint32_t bus, uint32_t flags) {
+    const DMA_HandleTypeDef *hdma = i2c_buses[bus].handle->hdmarx;
+
+    ((volatile uint32_t *)(uintptr_t)hdma->StreamBaseAddress)[2] = flags << hdma->StreamIndex;
+}
+
+// Function to start a transaction with register writes, the address goes out from the event interrupt
+RAMFUNC static HAL_StatusTypeDef i2c_bus_ll_start(uint32_t bus, const i2c_transaction_t *transaction) {
+    const i2c_bus_t *pins = &i2c_buses[bus];
+    I2C_TypeDef *i2c = pins->handle->Instance;
+    uint32_t start = cycle_counter_now();
+
+    if (transaction->size == 0) {
+        return HAL_ERROR;
+    }
+    // The STOP of the transaction before may still be on the bus
+    while (LL_I2C_IsActiveFlag_BUSY(i2c)) {
+        if (cycle_counter_since(start) > I2C_LL_BUSY_CYCLES) {
+            return HAL_BUSY;
+        }
+    }
+    ll_data[bus] = transaction->data;
+    ll_remaining[bus] = transaction->size;
+    LL_I2C_AcknowledgeNextData(i2c, LL_I2C_ACK);
+    if (!transaction->write && transaction->size > 1U) {
+        i2c_bus_dma_clear(bus, I2C_LL_DMA_ALL);
+        LL_DMA_SetMemoryAddress(DMA1, pins->dma_stream, (uint32_t)(uintptr_t)transaction->data);
+        LL_DMA_SetDataLength(DMA1, pins->dma_stream, transaction->size);
+        LL_DMA_EnableStream(DMA1, pins->dma_stream);
+        // The byte after the end of the DMA is answered with a NACK
+        LL_I2C_EnableLastDMA(i2c);
+        LL_I2C_EnableDMAReq_RX(i2c);
+    }
+    LL_I2C_EnableIT_EVT(i2c);
+    LL_I2C_EnableIT_ERR(i2c);
+    LL_I2C_GenerateStartCondition(i2c);
+    return HAL_OK;
+}
+
+// Function to mask the interrupts of a bus and stop its receive stream
+RAMFUNC static void i2c_bus_ll_stop(uint32_t bus) {
+    const i2c_bus_t *pins = &i2c_buses[bus];
+
+    CLEAR_BIT(pins->handle->Instance->CR2,
+              I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN | I2C_CR2_ITERREN | I2C_CR2_DMAEN | I2C_CR2_LAST);
+    if (LL_DMA_IsEnabledStream(DMA1, pins->dma_stream)) {
+        LL_DMA_DisableStream(DMA1, pins->dma_stream);
+        // Its flags are only final once the current byte is through
+        while (LL_DMA_IsEnabledStream(DMA1, pins->dma_stream)) {
+        }
+    }
+    i2c_bus_dma_clear(bus, I2C_LL_DMA_ALL);
+}
+
+// Function to drive the address phase and the bytes the DMA does not move
+RAMFUNC void i2c_acquisition_ev_from_isr(uint32_t bus) {
+    I2C_TypeDef *i2c = i2c_buses[bus].handle->Instance;
+    uint32_t index = seq_index[bus];
+    uint32_t sr1 = i2c->SR1;
+
+    if (index >= seq_count) {
+        // Left over from a list that ended
+        i2c_bus_ll_stop(bus);
+        return;
+    }
+    const i2c_transaction_t *transaction = &seq_list[index];
+
+    if ((sr1 & I2C_SR1_SB) != 0) {
+        // Reading SR1 and writing DR clears SB
+        LL_I2C_TransmitData8(i2c, (uint8_t)(transaction->device_address << 1) | (transaction->write ? 0U : 1U));
+    } else if ((sr1 & I2C_SR1_ADDR) != 0) {
+        if (!transaction->write && transaction->size == 1U) {
+            // The only byte gets the NACK and the STOP, both set before ADDR is cleared
+            LL_I2C_AcknowledgeNextData(i2c, LL_I2C_NACK);
+            LL_I2C_ClearFlag_ADDR(i2c);
+            LL_I2C_GenerateStopCondition(i2c);
+            LL_I2C_EnableIT_BUF(i2c);
+        } else if (!transaction->write) {
+            // The DMA moves the bytes, its completion ends the read
+            LL_I2C_ClearFlag_ADDR(i2c);
+            LL_I2C_DisableIT_EVT(i2c);
+        } else {
+            LL_I2C_ClearFlag_ADDR(i2c);
+            LL_I2C_EnableIT_BUF(i2c);
+        }
+    } else if (transaction->write) {
+        if (ll_remaining[bus] > 0 && (sr1 & I2C_SR1_TXE) != 0) {
+            LL_I2C_TransmitData8(i2c, *ll_data[bus]++);
+            if (--ll_remaining[bus] == 0) {
+                LL_I2C_DisableIT_BUF(i2c);
+            }
+        } else if (ll_remaining[bus] == 0 && (sr1 & I2C_SR1_BTF) != 0) {
+            // The last byte is out and acknowledged
+            LL_I2C_GenerateStopCondition(i2c);
+            i2c_bus_ll_stop(bus);
+            i2c_sequence_step_from_isr(bus, HAL_OK, 0);
+        }
+    } else if ((sr1 & I2C_SR1_RXNE) != 0) {
+        *ll_data[bus] = LL_I2C_ReceiveData8(i2c);
+        i2c_bus_ll_stop(bus);
+        i2c_sequence_step_from_isr(bus, HAL_OK, 0);
+    }
+}
+
+// Function to end a transaction on a bus error, NACK or lost arbitration
+RAMFUNC void i2c_acquisition_er_from_isr(uint32_t bus) {
+    I2C_TypeDef *i2c = i2c_buses[bus].handle->Instance;
+    uint32_t sr1 = i2c->SR1;
+    uint32_t error = 0;
+
+    if ((sr1 & I2C_SR1_BERR) != 0) {
+        error |= HAL_I2C_ERROR_BERR;
+        LL_I2C_ClearFlag_BERR(i2c);
+    }
+    if ((sr1 & I2C_SR1_ARLO) != 0) {
+        // The peripheral already fell back to slave mode
+        error |= HAL_I2C_ERROR_ARLO;
+        LL_I2C_ClearFlag_ARLO(i2c);
+    }
+    if ((sr1 & I2C_SR1_AF) != 0) {
+        // Nobody answered the address or a byte, release the bus
+        error |= HAL_I2C_ERROR_AF;
+        LL_I2C_ClearFlag_AF(i2c);
+        LL_I2C_GenerateStopCondition(i2c);
+    }
+    if ((sr1 & I2C_SR1_OVR) != 0) {
+        error |= HAL_I2C_ERROR_OVR;
+        LL_I2C_ClearFlag_OVR(i2c);
+    }
+    if (error == 0 || seq_index[bus] >= seq_count) {
+        return;
+    }
+    i2c_bus_ll_stop(bus);
+    i2c_sequence_step_from_isr(bus, HAL_ERROR, error);
+}
+
+// Function to end a DMA read on the flags of its stream
+RAMFUNC void i2c_acquisition_dma_from_isr(uint32_t bus) {
+    I2C_TypeDef *i2c = i2c_buses[bus].handle->Instance;
+    uint32_t flags = i2c_bus_dma_flags(bus) & I2C_LL_DMA_ALL;
+
+    i2c_bus_dma_clear(bus, flags);
+    if ((flags & (I2C_LL_DMA_TC | I2C_LL_DMA_TE)) == 0 || seq_index[bus] >= seq_count) {
+        return;
+    }
+    // Complete, the NACK went out with the last byte. Or failed, the stream stopped itself.
+    LL_I2C_GenerateStopCondition(i2c);
+    i2c_bus_ll_stop(bus);
+    if ((flags & I2C_LL_DMA_TE) != 0) {
+        i2c_sequence_step_from_isr(bus, HAL_ERROR, HAL_I2C_ERROR_DMA);
+    } else {
+        i2c_sequence_step_from_isr(bus, HAL_OK, 0);
+    }
+}
+#endif
@@ -0,0 +1,127 @@
+/**
+  ******************************************************************************
+  * @file    i2c_arbiter.c
+  * @brief   Priority arbiter of the I2C buses between the tasks that run transaction lists.
+  *
+  *          The acquisition engine runs one list at a time over every bus,
+  *          its sequence state and completion interrupts belong to that list.
+  *          Two tasks calling it at once would restart each other's buses,
+  *          the HAL answering HAL_BUSY in the middle. The arbiter holds the
+  *          engine for one list at a time: a task that finds it free takes
+  *          it at once, one that finds it busy joins the queue and blocks on
+  *          its notification. The end of a list hands the engine straight to
+  *          the head of the queue, so the engine is never free in between
+  *          and no later arrival overtakes a waiting list.
+  *
+  *          The queue is kept sorted on insertion, class first and then the
+  *          deadline, a handful of entries moved under a critical section.
+  *          The producer's SAMPLING lists therefore run as soon as the list
+  *          on the bus ends, and at worst wait for one background list:
+  *          keep those short, a write or one read each.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "i2c_arbiter.h"
+#include "task_signal.h"
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    TaskHandle_t task;
+    uint8_t request_class; // i2c_arbiter_class_t
+    TickType_t deadline;
+} i2c_arbiter_waiter_t;
+
+/* Private variables ---------------------------------------------------------*/
+#if I2C_ARBITER
+// Guarded by a critical section, any task
+static bool i2c_arbiter_busy;
+static i2c_arbiter_waiter_t i2c_arbiter_queue[I2C_ARBITER_WAITERS];
+static uint32_t i2c_arbiter_waiting;
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+#if I2C_ARBITER
+static bool i2c_arbiter_acquire(i2c_arbiter_class_t request_class, TickType_t deadline);
+static void i2c_arbiter_release(void);
+static bool i2c_arbiter_before(const i2c_arbiter_waiter_t *a, const i2c_arbiter_waiter_t *b);
+#endif
+
+// Function to run a list once the arbiter grants the buses
+HAL_StatusTypeDef i2c_arbiter_run(i2c_transaction_t *list, uint32_t count, uint32_t timeout_ms,
+                                  i2c_arbiter_class_t request_class, TickType_t deadline) {
+#if I2C_ARBITER
+    if (!i2c_arbiter_acquire(request_class, deadline)) {
+        // Nothing ran, the statuses left from the last run must not pass for this one
+        for (uint32_t index = 0; index < count; ++index) {
+            list[index].status = HAL_BUSY;
+        }
+        return HAL_BUSY;
+    }
+    HAL_StatusTypeDef status = i2c_acquisition_run(list, count, timeout_ms);
+    i2c_arbiter_release();
+    return status;
+#else
+    (void)request_class;
+    (void)deadline;
+    return i2c_acquisition_run(list, count, timeout_ms);
+#endif
+}
+
+#if I2C_ARBITER
+// Function to take the buses, or wait in the queue until they are handed
+// over. Fails only when the queue is full.
+static bool i2c_arbiter_acquire(i2c_arbiter_class_t request_class, TickType_t deadline) {
+    i2c_arbiter_waiter_t waiter = { xTaskGetCurrentTaskHandle(), (uint8_t)request_class, deadline };
+
+    taskENTER_CRITICAL();
+    if (!i2c_arbiter_busy) {
+        i2c_arbiter_busy = true;
+        taskEXIT_CRITICAL();
+        return true;
+    }
+    if (i2c_arbiter_waiting == I2C_ARBITER_WAITERS) {
+        taskEXIT_CRITICAL();
+        return false;
+    }
+    // Insertion into the sorted queue, behind the waiters that go first
+    uint32_t index = i2c_arbiter_waiting++;
+    while (index > 0 && i2c_arbiter_before(&waiter, &i2c_arbiter_queue[index - 1])) {
+        i2c_arbiter_queue[index] = i2c_arbiter_queue[index - 1];
+        index--;
+    }
+    i2c_arbiter_queue[index] = waiter;
+    taskEXIT_CRITICAL();
+
+    // The releasing task removed this waiter before the notification
+    task_signal_wait(TASK_SIGNAL_I2C_GRANT, portMAX_DELAY);
+    return true;
+}
+
+// Function to hand the buses to the first waiter, or free them
+static void i2c_arbiter_release(void) {
+    TaskHandle_t next = NULL;
+
+    taskENTER_CRITICAL();
+    if (i2c_arbiter_waiting > 0) {
+        next = i2c_arbiter_queue[0].task;
+        i2c_arbiter_waiting--;
+        for (uint32_t index = 0; index < i2c_arbiter_waiting; ++index) {
+            i2c_arbiter_queue[index] = i2c_arbiter_queue[index + 1];
+        }
+    } else {
+        i2c_arbiter_busy = false;
+    }
+    taskEXIT_CRITICAL();
+    task_signal_set(next, TASK_SIGNAL_I2C_GRANT);
+}
+
+// Function to order two waiters, class first, then the earlier deadline.
+// Equal ones keep their arrival order.
+static bool i2c_arbiter_before(const i2c_arbiter_waiter_t *a, const i2c_arbiter_waiter_t *b) {
+    if (a->request_class != b->request_class) {
+        return a->request_class < b->request_class;
+    }
+    return (int32_t)(a->deadline - b->deadline) < 0;
+}
+#endif
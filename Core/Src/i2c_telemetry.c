@@ -0,0 +1,192 @@
+/**
+  ******************************************************************************
+  * @file    i2c_telemetry.c
+  * @brief   Utilization and error counters of every I2C bus and device.
+  *
+  *          Whether a bus has room for another sensor or needs fast mode is a
+  *          question of how long its transactions hold it and how often they
+  *          fail. The acquisition engine reports the end of every
+  *          transaction from the interrupt that ends it, with the cycles it
+  *          held the bus and the error flags the peripheral raised, and
+  *          every recovery of a bus. Each is counted for its bus and for its
+  *          device, the devices found on the way in a small table.
+  *
+  *          The counters cover the window since the last report: the busy
+  *          time over the window length is the utilization of a bus, and
+  *          the errors over the transactions its failure rate. A bus close
+  *          to full shows in its utilization well before its reads start
+  *          to miss their tick.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "i2c_telemetry.h"
+
+#if I2C_TELEMETRY
+#include "cmsis_os.h"
+#include "i2c_acquisition.h"
+#include "ram_func.h"
+#include "uart_tx.h"
+#include <stddef.h>
+#include <string.h>
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t busy_us;
+    uint32_t nacks;
+    uint32_t arbitration_lost;
+    uint32_t bus_errors;
+    uint32_t timeouts;
+    uint32_t other_errors;
+    uint32_t recoveries;
+} i2c_telemetry_counters_t;
+
+typedef struct {
+    uint8_t bus;
+    uint8_t address;
+    i2c_telemetry_counters_t counters;
+} i2c_telemetry_device_t;
+
+/* Private variables ---------------------------------------------------------*/
+// Written from the bus interrupts, which share one priority and never nest,
+// taken and cleared by the consumer in a critical section
+static i2c_telemetry_counters_t i2c_telemetry_buses[I2C_BUS_COUNT];
+static i2c_telemetry_device_t i2c_telemetry_devices[I2C_TELEMETRY_DEVICES];
+static uint32_t i2c_telemetry_device_count;
+// Consumer task only
+static uint32_t i2c_telemetry_window_start;
+
+/* Private function prototypes -----------------------------------------------*/
+static void i2c_telemetry_count(i2c_telemetry_counters_t *counters, uint16_t size, HAL_StatusTypeDef status,
+                                uint32_t error, uint32_t us);
+static void i2c_telemetry_entry(i2c_telemetry_entry_t *entry, const i2c_telemetry_counters_t *counters,
+                                uint32_t window_ms);
+static uint16_t i2c_telemetry_saturate(uint32_t value);
+
+// Function to count one transaction for its bus and its device
+RAMFUNC void i2c_telemetry_transaction_from_isr(uint32_t bus, uint8_t address, uint16_t size,
+                                                HAL_StatusTypeDef status, uint32_t error, uint32_t cycles) {
+    uint32_t us = cycles / (SystemCoreClock / 1000000U);
+    uint32_t index = 0;
+
+    i2c_telemetry_count(&i2c_telemetry_buses[bus], size, status, error, us);
+    while (index < i2c_telemetry_device_count &&
+           (i2c_telemetry_devices[index].bus != bus || i2c_telemetry_devices[index].address != address)) {
+        index++;
+    }
+    if (index == i2c_telemetry_device_count) {
+        if (index == I2C_TELEMETRY_DEVICES) {
+            return;
+        }
+        // The table only grows, a device keeps its entry once seen
+        i2c_telemetry_devices[index].bus = (uint8_t)bus;
+        i2c_telemetry_devices[index].address = address;
+        i2c_telemetry_device_count = index + 1U;
+    }
+    i2c_telemetry_count(&i2c_telemetry_devices[index].counters, size, status, error, us);
+}
+
+// Function to count one recovery of a bus
+void i2c_telemetry_recovery(uint32_t bus) {
+    taskENTER_CRITICAL();
+    i2c_telemetry_buses[bus].recoveries++;
+    taskEXIT_CRITICAL();
+}
+
+// Function to send the table of the window and start the next one
+void i2c_telemetry_report(void) {
+    i2c_telemetry_frame_t frame;
+    uint32_t now = HAL_GetTick();
+    uint32_t window_ms = now - i2c_telemetry_window_start;
+
+    frame.type = I2C_TELEMETRY_FRAME_TYPE;
+    frame.version = I2C_TELEMETRY_FRAME_VERSION;
+    frame.sequence = 0;
+    frame.entry_count = 0;
+    frame.window_ms = window_ms;
+    i2c_telemetry_window_start = now;
+    for (uint32_t index = 0; index < I2C_BUS_COUNT + I2C_TELEMETRY_DEVICES; ++index) {
+        i2c_telemetry_counters_t counters, *source;
+        uint8_t bus, address;
+
+        // Each entry in one piece, the bus interrupts preempt the consumer
+        taskENTER_CRITICAL();
+        if (index < I2C_BUS_COUNT) {
+            bus = (uint8_t)index;
+            address = I2C_TELEMETRY_BUS_ENTRY;
+            source = &i2c_telemetry_buses[index];
+        } else if (index - I2C_BUS_COUNT < i2c_telemetry_device_count) {
+            bus = i2c_telemetry_devices[index - I2C_BUS_COUNT].bus;
+            address = i2c_telemetry_devices[index - I2C_BUS_COUNT].address;
+            source = &i2c_telemetry_devices[index - I2C_BUS_COUNT].counters;
+        } else {
+            taskEXIT_CRITICAL();
+            break;
+        }
+        counters = *source;
+        memset(source, 0, sizeof(*source));
+        taskEXIT_CRITICAL();
+        if (counters.transactions == 0 && counters.recoveries == 0) {
+            continue;
+        }
+
+        i2c_telemetry_entry_t *entry = &frame.entries[frame.entry_count++];
+        entry->bus = bus;
+        entry->address = address;
+        i2c_telemetry_entry(entry, &counters, window_ms);
+        if (frame.entry_count == I2C_TELEMETRY_FRAME_ENTRIES) {
+            uart_tx_send((const uint8_t *)&frame, sizeof(frame));
+            frame.sequence++;
+            frame.entry_count = 0;
+        }
+    }
+    if (frame.entry_count > 0) {
+        uart_tx_send((const uint8_t *)&frame,
+                     offsetof(i2c_telemetry_frame_t, entries) + frame.entry_count * sizeof(i2c_telemetry_entry_t));
+    }
+}
+
+// Function to add one transaction to a set of counters
+RAMFUNC static void i2c_telemetry_count(i2c_telemetry_counters_t *counters, uint16_t size, HAL_StatusTypeDef status,
+                                        uint32_t error, uint32_t us) {
+    counters->transactions++;
+    counters->busy_us += us;
+    if (status == HAL_OK) {
+        counters->bytes += size;
+    } else if (status == HAL_TIMEOUT) {
+        counters->timeouts++;
+    } else if ((error & HAL_I2C_ERROR_AF) != 0) {
+        counters->nacks++;
+    } else if ((error & HAL_I2C_ERROR_ARLO) != 0) {
+        counters->arbitration_lost++;
+    } else if ((error & HAL_I2C_ERROR_BERR) != 0) {
+        counters->bus_errors++;
+    } else {
+        counters->other_errors++;
+    }
+}
+
+// Function to fill the counted fields of a frame entry
+static void i2c_telemetry_entry(i2c_telemetry_entry_t *entry, const i2c_telemetry_counters_t *counters,
+                                uint32_t window_ms) {
+    uint64_t utilization = window_ms == 0 ? 0 : (uint64_t)counters->busy_us * 10U / window_ms;
+
+    entry->utilization = utilization > 10000U ? 10000U : (uint16_t)utilization;
+    entry->transactions = counters->transactions;
+    entry->bytes = counters->bytes;
+    entry->busy_us = counters->busy_us;
+    entry->nacks = i2c_telemetry_saturate(counters->nacks);
+    entry->arbitration_lost = i2c_telemetry_saturate(counters->arbitration_lost);
+    entry->bus_errors = i2c_telemetry_saturate(counters->bus_errors);
+    entry->timeouts = i2c_telemetry_saturate(counters->timeouts);
+    entry->other_errors = i2c_telemetry_saturate(counters->other_errors);
+    entry->recoveries = i2c_telemetry_saturate(counters->recoveries);
+}
+
+// Function to fit a count into a 16-bit field
+static uint16_t i2c_telemetry_saturate(uint32_t value) {
+    return value > UINT16_MAX ? UINT16_MAX : (uint16_t)value;
+}
+#endif /* I2C_TELEMETRY */
@@ -0,0 +1,103 @@
+/**
+  ******************************************************************************
+  * @file    isr_pipeline.c
+  * @brief   Interrupt-only operating mode, the pipeline without the scheduler.
+  *
+  *          With the samples coming from DMA and timer interrupts, the tasks
+  *          of a simple configuration mostly wait: every tick costs two
+  *          context switches into the producer and out of it, every batch
+  *          two more for the consumer, and the idle task in between. Here
+  *          the core sleeps with SLEEPONEXIT instead. It only wakes for an
+  *          interrupt and goes back to sleep on its return without running
+  *          any thread code, so there is no scheduler, no SysTick and no
+  *          HAL tick to wake it.
+  *
+  *          The TIM3 tick only records its time and pends a spare vector at
+  *          the lowest priority. That deferred work samples the tick and,
+  *          at the end of a batch, runs the statistics and queues the
+  *          report. It tail-chains behind the tick and is preempted by the
+  *          ADC, USART2 and timer interrupts, the way the tasks were. A tick
+  *          that fires while the work is still busy pends it again, and a
+  *          tick that could not be reached in time is counted and skipped.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "isr_pipeline.h"
+
+#if ISR_PIPELINE
+#include "critical_section.h"
+#include "main.h"
+#include "pipeline_priorities.h"
+
+/* External variables --------------------------------------------------------*/
+extern TIM_HandleTypeDef htim1;
+
+/* Private variables ---------------------------------------------------------*/
+static isr_pipeline_acquire_t isr_pipeline_acquire;
+static isr_pipeline_report_t isr_pipeline_report;
+// Written by the tick interrupt, read by the deferred work in a critical section
+static volatile uint32_t isr_pipeline_ticks;
+static volatile uint32_t isr_pipeline_timestamp;
+// Deferred work only
+static uint32_t isr_pipeline_done;
+static uint32_t isr_pipeline_skipped;
+
+// Function to set the stages and enable the deferred interrupt
+void isr_pipeline_init(isr_pipeline_acquire_t acquire, isr_pipeline_report_t report) {
+    isr_pipeline_acquire = acquire;
+    isr_pipeline_report = report;
+    isr_pipeline_ticks = 0;
+    isr_pipeline_done = 0;
+    isr_pipeline_skipped = 0;
+    HAL_NVIC_SetPriority(ISR_PIPELINE_IRQn, IRQ_PRIORITY_DEFERRED, 0);
+    HAL_NVIC_ClearPendingIRQ(ISR_PIPELINE_IRQn);
+    HAL_NVIC_EnableIRQ(ISR_PIPELINE_IRQn);
+}
+
+// Function to record a tick and pend the deferred work
+void isr_pipeline_tick_from_isr(uint32_t timestamp) {
+    isr_pipeline_timestamp = timestamp;
+    isr_pipeline_ticks++;
+    NVIC_SetPendingIRQ(ISR_PIPELINE_IRQn);
+}
+
+// Function to run the latest tick and the report of the batch it completed
+void isr_pipeline_deferred_from_isr(void) {
+    // The tick interrupt is masked by the section, the count and its time match
+    uint32_t mask = critical_section_enter();
+    uint32_t ticks = isr_pipeline_ticks;
+    uint32_t timestamp = isr_pipeline_timestamp;
+    critical_section_exit(mask);
+
+    if (ticks == isr_pipeline_done) {
+        return;
+    }
+    isr_pipeline_skipped += ticks - isr_pipeline_done - 1U;
+    isr_pipeline_done = ticks;
+    if (isr_pipeline_acquire(timestamp) && isr_pipeline_report != NULL) {
+        isr_pipeline_report();
+    }
+}
+
+// Function to sleep on exit from the interrupts for good
+void isr_pipeline_run(void) {
+    // TIM1 would wake the core every millisecond for a HAL tick nothing waits on
+    HAL_SuspendTick();
+    __HAL_TIM_DISABLE(&htim1);
+    // A kernel call during the setup masks the interrupts until a scheduler
+    // starts, and none will
+    __set_BASEPRI(0);
+    SCB->SCR |= SCB_SCR_SLEEPONEXIT_Msk;
+    __DSB();
+    while (1) {
+        // Only reached again if SLEEPONEXIT is cleared
+        __WFI();
+    }
+}
+
+// Function to read the ticks skipped by the deferred work
+uint32_t isr_pipeline_overruns(void) {
+    return isr_pipeline_skipped;
+}
+#endif /* ISR_PIPELINE */
@@ -0,0 +1,169 @@
+/**
+  ******************************************************************************
+  * @file    isr_profile.c
+  * @brief   Duration, entry latency and CPU share of the peripheral interrupts.
+  *
+  *          Each handler reads the cycle counter at its entry and exit. The
+  *          handlers that preempt it add their own time to a running total,
+  *          so the time of a handler is its own, once, however deep the
+  *          nesting goes. The cost of the two calls themselves, some tens
+  *          of cycles, is part of every time.
+  *
+  *          Per interrupt the window keeps the run count, the total and the
+  *          longest run, and a log2 histogram the percentiles are read
+  *          from. The share is the total over the core cycles of the
+  *          window: an interrupt with a high share is one to move into a
+  *          task.
+  *
+  *          The entry latency needs to know when the interrupt was raised.
+  *          TIM1, the HAL time base, and TIM3, the sampling timer, restart
+  *          counting from 0 at their update event, so their counter at entry
+  *          is the latency: to 1 us for TIM1 and to the 100 us step of the
+  *          counter for TIM3. The other interrupts report no latency.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "isr_profile.h"
+#include "cmsis_os.h"
+#include "cycle_counter.h"
+#include "link_route.h"
+#include "main.h"
+#include "ram_func.h"
+#include <stddef.h>
+#include <string.h>
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    uint32_t count;
+    uint32_t cycles;
+    uint32_t max_cycles;
+    uint32_t latency_count;
+    uint32_t latency_max_us;
+    uint32_t buckets[ISR_PROFILE_BUCKETS];
+} isr_profile_slot_t;
+
+/* Private variables ---------------------------------------------------------*/
+// Written by the handlers, taken and cleared by the consumer in a critical section
+static isr_profile_slot_t isr_profile_slots[ISR_PROFILE_IRQ_COUNT] CCMRAM;
+// Cycles of every handler that returned, nested ones included, wraps
+static uint32_t isr_profile_nested;
+// Consumer task only
+static uint32_t isr_profile_window_start;
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t isr_profile_percentile(const isr_profile_slot_t *slot, uint32_t permille);
+
+// Function to start the first window
+void isr_profile_init(void) {
+    taskENTER_CRITICAL();
+    memset(isr_profile_slots, 0, sizeof(isr_profile_slots));
+    taskEXIT_CRITICAL();
+    isr_profile_window_start = HAL_GetTick();
+}
+
+// Function to note the entry of a handler
+RAMFUNC void isr_profile_enter(isr_profile_context_t *context) {
+    // The counter first: a handler that preempts in between counts as part of
+    // this one rather than being taken out of a time it is not in
+    context->start = cycle_counter_now();
+    context->nested = isr_profile_nested;
+}
+
+// Function to count the run of a handler
+RAMFUNC void isr_profile_exit(isr_profile_irq_t irq, const isr_profile_context_t *context) {
+    uint32_t total = cycle_counter_since(context->start);
+    uint32_t preempted = isr_profile_nested - context->nested;
+    uint32_t cycles = preempted < total ? total - preempted : 0;
+    isr_profile_slot_t *slot = &isr_profile_slots[irq];
+
+    // The handler this one preempted takes it out as a whole
+    isr_profile_nested = context->nested + total;
+
+    uint32_t bucket = cycles == 0 ? 0 : 31U - (uint32_t)__builtin_clz(cycles);
+    if (bucket >= ISR_PROFILE_BUCKETS) {
+        bucket = ISR_PROFILE_BUCKETS - 1;
+    }
+    slot->buckets[bucket]++;
+    slot->count++;
+    slot->cycles += cycles;
+    if (cycles > slot->max_cycles) {
+        slot->max_cycles = cycles;
+    }
+}
+
+// Function to keep the longest entry latency of a timer interrupt
+RAMFUNC void isr_profile_latency(isr_profile_irq_t irq, uint32_t us) {
+    isr_profile_slot_t *slot = &isr_profile_slots[irq];
+
+    slot->latency_count++;
+    if (us > slot->latency_max_us) {
+        slot->latency_max_us = us;
+    }
+}
+
+// Function to find the bucket below which a share of the runs finished
+static uint8_t isr_profile_percentile(const isr_profile_slot_t *slot, uint32_t permille) {
+    uint64_t target = (uint64_t)slot->count * permille;
+    uint64_t runs = 0;
+
+    for (uint32_t bucket = 0; bucket < ISR_PROFILE_BUCKETS; ++bucket) {
+        runs += slot->buckets[bucket];
+        if (runs * 1000U >= target) {
+            return (uint8_t)bucket;
+        }
+    }
+    return ISR_PROFILE_BUCKETS - 1;
+}
+
+// Function to send the table of the window and start the next one
+void isr_profile_report(void) {
+    isr_profile_frame_t frame;
+    uint32_t now = HAL_GetTick();
+    uint32_t window_ms = now - isr_profile_window_start;
+    uint64_t window_cycles = (uint64_t)window_ms * (SystemCoreClock / 1000U);
+
+    isr_profile_window_start = now;
+    frame.type = ISR_PROFILE_FRAME_TYPE;
+    frame.version = ISR_PROFILE_FRAME_VERSION;
+    frame.sequence = 0;
+    frame.entry_count = 0;
+    frame.window_ms = window_ms;
+    for (uint32_t irq = 0; irq < ISR_PROFILE_IRQ_COUNT; ++irq) {
+        isr_profile_slot_t slot;
+
+        // Each slot in one piece, every profiled interrupt is masked by the kernel
+        taskENTER_CRITICAL();
+        slot = isr_profile_slots[irq];
+        memset(&isr_profile_slots[irq], 0, sizeof(isr_profile_slots[irq]));
+        taskEXIT_CRITICAL();
+        if (slot.count == 0) {
+            continue;
+        }
+
+        isr_profile_entry_t *entry = &frame.entries[frame.entry_count++];
+        uint64_t share = window_cycles == 0 ? 0 : ((uint64_t)slot.cycles * 10000U) / window_cycles;
+        entry->irq = (uint8_t)irq;
+        entry->p50_bucket = isr_profile_percentile(&slot, 500);
+        entry->p99_bucket = isr_profile_percentile(&slot, 990);
+        entry->reserved = 0;
+        entry->share_permyriad = share > 0xFFFFU ? 0xFFFFU : (uint16_t)share;
+        if (slot.latency_count == 0) {
+            entry->latency_max_us = ISR_PROFILE_NO_LATENCY;
+        } else {
+            entry->latency_max_us = slot.latency_max_us >= ISR_PROFILE_NO_LATENCY ?
+                                    ISR_PROFILE_NO_LATENCY - 1U : (uint16_t)slot.latency_max_us;
+        }
+        entry->count = slot.count;
+        entry->max_cycles = slot.max_cycles;
+        if (frame.entry_count == ISR_PROFILE_FRAME_ENTRIES) {
+            link_route_send(LINK_TRAFFIC_PROFILE, (const uint8_t *)&frame, sizeof(frame));
+            frame.sequence++;
+            frame.entry_count = 0;
+        }
+    }
+    if (frame.entry_count > 0) {
+        link_route_send(LINK_TRAFFIC_PROFILE, (const uint8_t *)&frame,
+                        offsetof(isr_profile_frame_t, entries) + frame.entry_count * sizeof(isr_profile_entry_t));
+    }
+}
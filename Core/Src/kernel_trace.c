@@ -0,0 +1,202 @@
+/**
+  ******************************************************************************
+  * @file    kernel_trace.c
+  * @brief   Binary trace of the scheduler and the task handoffs, from the FreeRTOS trace hooks.
+  *
+  *          The kernel calls the hooks on every context switch, queue or
+  *          semaphore operation and task notification, always inside a
+  *          critical section or the PendSV handler with its interrupts
+  *          masked. A hook takes the cycle count and stores one 8-byte
+  *          record in a RAM ring, a few dozen cycles and no lock. The
+  *          running task is kept from the last switch, so the other
+  *          records do not have to look it up.
+  *
+  *          The handoff of the pipeline shows as notifications: the TIM3
+  *          and I2C interrupts notify the producer, the producer notifies
+  *          the consumer, each with its task_signal.h bit as the value the
+  *          receiver gets. The switches around them show who waited.
+  *
+  *          A dump freezes the ring, so it shows the last KERNEL_TRACE_DEPTH
+  *          events before the command and not the dump itself. The dump
+  *          task sends the task names and the records as trace frames, over
+  *          the UART with what the transmit queue leaves or over SWO to the
+  *          ITM stimulus port, then empties the ring and records again.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "kernel_trace.h"
+#include "main.h"
+#include "cmsis_os.h"
+#include "cycle_counter.h"
+#include "link_route.h"
+#include "pipeline_priorities.h"
+#include "stack_profile.h"
+#include "task_signal.h"
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+#ifndef KERNEL_TRACE_STACK_SIZE
+#define KERNEL_TRACE_STACK_SIZE 192
+#endif
+// Runs with what the live frames leave, like the other senders of old data
+#define KERNEL_TRACE_PRIORITY TASK_PRIORITY_TRANSMIT
+
+/* Private variables ---------------------------------------------------------*/
+// Written by the hooks with the kernel interrupts masked, read by the dump
+// task while kernel_trace_frozen keeps the hooks out
+static kernel_trace_record_t kernel_trace_ring[KERNEL_TRACE_DEPTH];
+static uint32_t kernel_trace_head;
+static uint8_t kernel_trace_current;
+static volatile bool kernel_trace_frozen;
+static uint32_t kernel_trace_sink;
+static TaskStatus_t kernel_trace_status[KERNEL_TRACE_MAX_TASKS];
+
+static TaskHandle_t kernel_trace_task_handle;
+static StaticTask_t kernel_trace_task_tcb;
+static StackType_t kernel_trace_task_stack[KERNEL_TRACE_STACK_SIZE];
+
+/* Private function prototypes -----------------------------------------------*/
+static void kernel_trace_task(void *argument);
+static bool kernel_trace_swo_enabled(void);
+static void kernel_trace_emit(const kernel_trace_frame_t *frame);
+static void kernel_trace_send_tasks(kernel_trace_frame_t *frame);
+static void kernel_trace_send_records(kernel_trace_frame_t *frame);
+
+// Function to create the dump task
+void kernel_trace_start(void) {
+    kernel_trace_task_handle = xTaskCreateStatic(kernel_trace_task, "KernelTrace", KERNEL_TRACE_STACK_SIZE, NULL,
+                                                 KERNEL_TRACE_PRIORITY, kernel_trace_task_stack,
+                                                 &kernel_trace_task_tcb);
+#if STACK_PROFILE
+    stack_profile_track(kernel_trace_task_handle, KERNEL_TRACE_STACK_SIZE);
+#endif
+}
+
+// Function to freeze the ring and hand it to the dump task, from task context
+bool kernel_trace_dump(uint32_t sink) {
+    if (kernel_trace_frozen || sink > KERNEL_TRACE_SINK_SWO ||
+        (sink == KERNEL_TRACE_SINK_SWO && !kernel_trace_swo_enabled())) {
+        return false;
+    }
+    kernel_trace_sink = sink;
+    kernel_trace_frozen = true;
+    task_signal_set(kernel_trace_task_handle, TASK_SIGNAL_TRACE_DUMP);
+    return true;
+}
+
+// Function to keep the running task and record its switch, inside the scheduler
+void kernel_trace_switched_in(uint32_t task) {
+    kernel_trace_current = task > UINT8_MAX ? UINT8_MAX : (uint8_t)task;
+    kernel_trace_event(KERNEL_TRACE_SWITCH_IN, task);
+}
+
+// Function to record one event, inside the kernel with its interrupts masked
+void kernel_trace_event(uint32_t event, uint32_t object) {
+    if (kernel_trace_frozen) {
+        return;
+    }
+    kernel_trace_record_t *record = &kernel_trace_ring[kernel_trace_head++ & (KERNEL_TRACE_DEPTH - 1U)];
+
+    if (event == KERNEL_TRACE_QUEUE_SEND || event == KERNEL_TRACE_QUEUE_SEND_FROM_ISR ||
+        event == KERNEL_TRACE_QUEUE_RECEIVE) {
+        // Queues are word aligned in SRAM, 16 bits of word offset are unique
+        object = (object - SRAM1_BASE) >> 2;
+    }
+    record->cycles = cycle_counter_now();
+    record->event = (uint8_t)event;
+    record->task = kernel_trace_current;
+    record->object = (uint16_t)object;
+}
+
+// Function to check that a probe enabled the ITM and its stimulus port
+static bool kernel_trace_swo_enabled(void) {
+    return (CoreDebug->DEMCR & CoreDebug_DEMCR_TRCENA_Msk) != 0 && (ITM->TCR & ITM_TCR_ITMENA_Msk) != 0 &&
+           (ITM->TER & (1UL << KERNEL_TRACE_ITM_PORT)) != 0;
+}
+
+// Function to send one frame to the sink of the dump
+static void kernel_trace_emit(const kernel_trace_frame_t *frame) {
+    if (kernel_trace_sink == KERNEL_TRACE_SINK_UART) {
+        // One burst stays free for the live frames of the consumer
+        while (link_route_free(LINK_TRAFFIC_TRACE) <= 1) {
+            vTaskDelay(1);
+        }
+        link_route_send(LINK_TRAFFIC_TRACE, (const uint8_t *)frame, sizeof(*frame));
+        return;
+    }
+
+    for (uint32_t offset = 0; offset < sizeof(*frame); offset += sizeof(uint32_t)) {
+        uint32_t word;
+        memcpy(&word, (const uint8_t *)frame + offset, sizeof(word));
+        // The port reads 0 while its FIFO is full, a probe that goes away ends the dump
+        while (ITM->PORT[KERNEL_TRACE_ITM_PORT].u32 == 0UL) {
+            if (!kernel_trace_swo_enabled()) {
+                return;
+            }
+        }
+        ITM->PORT[KERNEL_TRACE_ITM_PORT].u32 = word;
+    }
+}
+
+// Function to send the names of the task numbers
+static void kernel_trace_send_tasks(kernel_trace_frame_t *frame) {
+    // 0 when there are more tasks than KERNEL_TRACE_MAX_TASKS
+    UBaseType_t count = uxTaskGetSystemState(kernel_trace_status, KERNEL_TRACE_MAX_TASKS, NULL);
+
+    frame->kind = KERNEL_TRACE_KIND_TASKS;
+    for (UBaseType_t first = 0; first < count; first += KERNEL_TRACE_FRAME_ENTRIES) {
+        memset(frame->tasks, 0, sizeof(frame->tasks));
+        frame->count = 0;
+        for (UBaseType_t i = first; i < count && i - first < KERNEL_TRACE_FRAME_ENTRIES; ++i) {
+            kernel_trace_task_t *task = &frame->tasks[frame->count++];
+            task->number = (uint8_t)kernel_trace_status[i].xTaskNumber;
+            strncpy(task->name, kernel_trace_status[i].pcTaskName, sizeof(task->name) - 1);
+        }
+        kernel_trace_emit(frame);
+    }
+}
+
+// Function to send the frozen ring, oldest record first
+static void kernel_trace_send_records(kernel_trace_frame_t *frame) {
+    uint32_t head = kernel_trace_head;
+    uint32_t count = head < KERNEL_TRACE_DEPTH ? head : KERNEL_TRACE_DEPTH;
+
+    frame->kind = KERNEL_TRACE_KIND_RECORDS;
+    for (uint32_t first = 0; first < count; first += KERNEL_TRACE_FRAME_ENTRIES) {
+        memset(frame->records, 0, sizeof(frame->records));
+        frame->count = 0;
+        for (uint32_t i = first; i < count && i - first < KERNEL_TRACE_FRAME_ENTRIES; ++i) {
+            frame->records[frame->count++] = kernel_trace_ring[(head - count + i) & (KERNEL_TRACE_DEPTH - 1U)];
+        }
+        kernel_trace_emit(frame);
+    }
+
+    frame->kind = KERNEL_TRACE_KIND_END;
+    frame->count = 1;
+    memset(frame->records, 0, sizeof(frame->records));
+    frame->summary.recorded = head;
+    frame->summary.lost = head - count;
+    kernel_trace_emit(frame);
+}
+
+// Dump task, sends the frozen ring and starts recording again
+static void kernel_trace_task(void *argument) {
+    kernel_trace_frame_t frame;
+
+    (void)argument;
+    frame.type = KERNEL_TRACE_FRAME_TYPE;
+    frame.version = KERNEL_TRACE_FRAME_VERSION;
+    while (1) {
+        task_signal_wait(TASK_SIGNAL_TRACE_DUMP, portMAX_DELAY);
+        kernel_trace_send_tasks(&frame);
+        kernel_trace_send_records(&frame);
+        if (kernel_trace_sink == KERNEL_TRACE_SINK_UART) {
+            link_route_flush(LINK_TRAFFIC_TRACE);
+        }
+
+        // The hooks are out while frozen, the ring is ours to clear
+        kernel_trace_head = 0;
+        kernel_trace_frozen = false;
+    }
+}
@@ -0,0 +1,64 @@
+/**
+  ******************************************************************************
+  * @file    latency_trace.c
+  * @brief   Per-stage latency histograms of the acquisition to UART pipeline.
+  *
+  *          Stages are timed with the DWT cycle counter and kept as log2
+  *          histograms of microseconds in RAM, a few hundred bytes in total.
+  *          Recording is a subtraction, a division and a count leading zeros,
+  *          cheap enough for the producer, the consumer and the USART2 ISR.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "latency_trace.h"
+#include "cycle_counter.h"
+#include <string.h>
+
+/* Private variables ---------------------------------------------------------*/
+static latency_histogram_t latency_histograms[LATENCY_STAGE_COUNT];
+
+// Function to clear the histograms
+void latency_trace_init(void) {
+    memset(latency_histograms, 0, sizeof(latency_histograms));
+}
+
+// Function to add one latency measurement to a stage
+void latency_trace_record(latency_stage_t stage, uint32_t start_cycles) {
+    latency_histogram_t *histogram = &latency_histograms[stage];
+    uint32_t cycles_per_us = SystemCoreClock / 1000000U;
+    uint32_t us = cycle_counter_since(start_cycles) / (cycles_per_us != 0 ? cycles_per_us : 1U);
+    uint32_t bucket = us == 0 ? 0 : 31U - (uint32_t)__builtin_clz(us);
+
+    if (bucket >= LATENCY_BUCKETS) {
+        bucket = LATENCY_BUCKETS - 1;
+    }
+    if (histogram->count == 0 || us < histogram->min_us) {
+        histogram->min_us = us;
+    }
+    if (us > histogram->max_us) {
+        histogram->max_us = us;
+    }
+    histogram->buckets[bucket]++;
+    histogram->count++;
+}
+
+// Function to access the histogram of a stage
+const latency_histogram_t *latency_trace_histogram(latency_stage_t stage) {
+    return &latency_histograms[stage];
+}
+
+// Function to pack one stage into a report frame
+void latency_trace_report(latency_stage_t stage, latency_report_frame_t *frame) {
+    const latency_histogram_t *histogram = &latency_histograms[stage];
+
+    frame->type = LATENCY_REPORT_FRAME_TYPE;
+    frame->stage = (uint8_t)stage;
+    frame->reserved = 0;
+    frame->count = histogram->count;
+    frame->min_us = histogram->min_us;
+    frame->max_us = histogram->max_us;
+    for (uint32_t i = 0; i < LATENCY_BUCKETS; ++i) {
+        frame->buckets[i] = histogram->buckets[i] > UINT16_MAX ? UINT16_MAX : (uint16_t)histogram->buckets[i];
+    }
+}
@@ -0,0 +1,277 @@
+/**
+  ******************************************************************************
+  * @file    link_backlog.c
+  * @brief   BLE link state and store-and-forward of the statistics.
+  *
+  *          While the BLE module reports no connection, the consumer keeps
+  *          every report as a full statistics record instead of sending it:
+  *          deltas only make sense to a receiver that saw the report before.
+  *          The newest LINK_BACKLOG_DEPTH records are held in RAM. When RAM
+  *          is full the oldest record is dropped from it. With FLASH_LOG the
+  *          same record is in the flash log under the same sequence, so only
+  *          the range that left RAM is remembered and read back from flash
+  *          on reconnect.
+  *
+  *          A low-priority task samples the link state. Once the link is up
+  *          it drains the backlog oldest first, as fast as the transmit
+  *          queue takes it. It always leaves one burst to the consumer,
+  *          so live frames never wait behind the backlog. With BULK_LINK
+  *          the backlog may be routed to the wired link, which has no
+  *          connection to wait for: it then drains while BLE is still down.
+  *
+  *          Records live in blocks of a pool with one spare for the record
+  *          being drained. A record is filled and sent from its block, the
+  *          critical sections only move pointers.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "link_backlog.h"
+#include "block_pool.h"
+#include "cmsis_os.h"
+#include "link_route.h"
+#include "load_shed.h"
+#include "main.h"
+#include "pipeline_priorities.h"
+#include "stack_profile.h"
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+#ifndef LINK_BACKLOG_STACK_SIZE
+#define LINK_BACKLOG_STACK_SIZE 256
+#endif
+#define LINK_BACKLOG_PRIORITY TASK_PRIORITY_TRANSMIT
+#define LINK_BACKLOG_FRAME_HEADER_SIZE 12U
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    flash_log_frame_t frame;
+    uint16_t size;
+} link_backlog_entry_t;
+
+/* Private variables ---------------------------------------------------------*/
+// The ring holds up to LINK_BACKLOG_DEPTH blocks, the drain task one more
+BLOCK_POOL_STORAGE(link_backlog_storage, sizeof(link_backlog_entry_t), LINK_BACKLOG_DEPTH + 1);
+static block_pool_t link_backlog_pool;
+// Written by the consumer, read by the drain task, indices are free running
+static link_backlog_entry_t *link_backlog_entries[LINK_BACKLOG_DEPTH];
+static uint32_t link_backlog_head;
+static uint32_t link_backlog_tail;
+static uint32_t link_backlog_drop_count;
+#if FLASH_LOG
+// Sequences [spill_from, spill_to) left RAM and are read back from the flash log
+static bool link_backlog_spilled;
+static uint32_t link_backlog_spill_from;
+static uint32_t link_backlog_spill_to;
+#else
+static uint32_t link_backlog_sequence;
+#endif
+
+static StaticTask_t link_backlog_task_tcb;
+static StackType_t link_backlog_task_stack[LINK_BACKLOG_STACK_SIZE];
+
+/* Private function prototypes -----------------------------------------------*/
+static void link_backlog_task(void *argument);
+static void link_backlog_wait_for_room(void);
+static bool link_backlog_can_drain(void);
+#if FLASH_LOG
+static bool link_backlog_drain_flash(void);
+#endif
+static bool link_backlog_drain_ram(void);
+
+// Function to empty the backlog
+void link_backlog_init(void) {
+    block_pool_init(&link_backlog_pool, link_backlog_storage, sizeof(link_backlog_entry_t), LINK_BACKLOG_DEPTH + 1);
+    link_backlog_head = 0;
+    link_backlog_tail = 0;
+    link_backlog_drop_count = 0;
+#if FLASH_LOG
+    link_backlog_spilled = false;
+#else
+    link_backlog_sequence = 0;
+#endif
+}
+
+// Function to create the drain task
+void link_backlog_start(void) {
+    TaskHandle_t task = xTaskCreateStatic(link_backlog_task, "LinkBacklog", LINK_BACKLOG_STACK_SIZE, NULL,
+                                          LINK_BACKLOG_PRIORITY, link_backlog_task_stack, &link_backlog_task_tcb);
+#if STACK_PROFILE
+    stack_profile_track(task, LINK_BACKLOG_STACK_SIZE);
+#else
+    (void)task;
+#endif
+}
+
+// Function to read the connection output of the BLE module
+bool link_backlog_link_up(void) {
+    return HAL_GPIO_ReadPin(BLE_LINK_GPIO_Port, BLE_LINK_Pin) == GPIO_PIN_SET;
+}
+
+// Function to keep one report until the link is back
+void link_backlog_store(uint32_t sequence, uint32_t timestamp, const void *frame, uint16_t size) {
+    if (size > FLASH_LOG_PAYLOAD_MAX) {
+        return;
+    }
+
+    link_backlog_entry_t *evicted = NULL;
+    taskENTER_CRITICAL();
+    if (link_backlog_head - link_backlog_tail == LINK_BACKLOG_DEPTH) {
+        // RAM is full, the oldest record goes
+        evicted = link_backlog_entries[link_backlog_tail % LINK_BACKLOG_DEPTH];
+#if FLASH_LOG
+        uint32_t oldest = evicted->frame.sequence;
+        if (!link_backlog_spilled) {
+            link_backlog_spill_from = oldest;
+            link_backlog_spilled = true;
+        }
+        link_backlog_spill_to = oldest + 1U;
+#else
+        link_backlog_drop_count++;
+#endif
+        link_backlog_tail++;
+    }
+    taskEXIT_CRITICAL();
+    if (evicted != NULL) {
+        block_pool_free(&link_backlog_pool, evicted);
+    }
+
+    // Only the drain task takes records meanwhile, the ring has room
+    link_backlog_entry_t *entry = block_pool_alloc(&link_backlog_pool);
+    if (entry == NULL) {
+        link_backlog_drop_count++;
+        return;
+    }
+    entry->frame.type = FLASH_LOG_FRAME_TYPE;
+    entry->frame.version = FLASH_LOG_FRAME_VERSION;
+    entry->frame.record_type = FLASH_LOG_RECORD_STATS;
+    entry->frame.reserved = 0;
+#if FLASH_LOG
+    entry->frame.sequence = sequence;
+#else
+    (void)sequence;
+    entry->frame.sequence = link_backlog_sequence++;
+#endif
+    entry->frame.timestamp = timestamp;
+    memcpy(entry->frame.payload, frame, size);
+    entry->size = (uint16_t)(LINK_BACKLOG_FRAME_HEADER_SIZE + size);
+
+    taskENTER_CRITICAL();
+    link_backlog_entries[link_backlog_head % LINK_BACKLOG_DEPTH] = entry;
+    link_backlog_head++;
+    taskEXIT_CRITICAL();
+}
+
+// Function to read the number of reports waiting in RAM
+uint32_t link_backlog_pending(void) {
+    return link_backlog_head - link_backlog_tail;
+}
+
+// Function to read the number of reports that could not be kept
+uint32_t link_backlog_dropped(void) {
+    return link_backlog_drop_count;
+}
+
+// Function to check that the link the backlog is routed to takes it
+static bool link_backlog_can_drain(void) {
+    return link_route(LINK_TRAFFIC_BACKLOG) != UART_LINK_BLE || link_backlog_link_up();
+}
+
+// Function to wait until a burst is free beyond the one kept for live frames
+static void link_backlog_wait_for_room(void) {
+#if LOAD_SHEDDING
+    // Nothing from the backlog on BLE while anything is shed, it goes before the live frames
+    while (link_route(LINK_TRAFFIC_BACKLOG) == UART_LINK_BLE ? !load_shed_admit(LOAD_SHED_CLASS_BACKLOG)
+                                                             : link_route_free(LINK_TRAFFIC_BACKLOG) <= 1) {
+#else
+    while (link_route_free(LINK_TRAFFIC_BACKLOG) <= 1) {
+#endif
+        vTaskDelay(1);
+    }
+}
+
+#if FLASH_LOG
+// Function to send the statistics records that only the flash log still holds
+static bool link_backlog_drain_flash(void) {
+    flash_log_frame_t frame;
+    bool sent = false;
+
+    while (link_backlog_can_drain()) {
+        taskENTER_CRITICAL();
+        bool spilled = link_backlog_spilled;
+        uint32_t from = link_backlog_spill_from, to = link_backlog_spill_to;
+        taskEXIT_CRITICAL();
+        if (!spilled) {
+            break;
+        }
+
+        link_backlog_wait_for_room();
+        uint16_t size = flash_log_read(from, &frame);
+        bool in_range = size != 0 && (int32_t)(frame.sequence - to) < 0;
+        if (in_range && frame.record_type == FLASH_LOG_RECORD_STATS) {
+            link_route_send(LINK_TRAFFIC_BACKLOG, (const uint8_t *)&frame, size);
+            sent = true;
+        }
+
+        taskENTER_CRITICAL();
+        if (!in_range || (int32_t)(frame.sequence + 1U - link_backlog_spill_to) >= 0) {
+            // The range is sent, or already overwritten in flash
+            link_backlog_spilled = false;
+        } else {
+            link_backlog_spill_from = frame.sequence + 1U;
+        }
+        taskEXIT_CRITICAL();
+    }
+    return sent;
+}
+#endif
+
+// Function to send the records held in RAM, oldest first
+static bool link_backlog_drain_ram(void) {
+    link_backlog_entry_t *entry = NULL;
+    bool sent = false;
+
+    while (link_backlog_can_drain()) {
+        link_backlog_wait_for_room();
+
+        taskENTER_CRITICAL();
+        bool any = link_backlog_head != link_backlog_tail;
+        if (any) {
+            entry = link_backlog_entries[link_backlog_tail % LINK_BACKLOG_DEPTH];
+            link_backlog_tail++;
+        }
+        taskEXIT_CRITICAL();
+        if (!any) {
+            break;
+        }
+        link_route_send(LINK_TRAFFIC_BACKLOG, (const uint8_t *)&entry->frame, entry->size);
+        block_pool_free(&link_backlog_pool, entry);
+        sent = true;
+    }
+    return sent;
+}
+
+// Function to watch the link and drain the backlog once it is up
+static void link_backlog_task(void *argument) {
+    TickType_t wake = xTaskGetTickCount();
+
+    (void)argument;
+    while (1) {
+        bool sent = false;
+
+        // A drain can take longer than a period, the next poll then comes at once
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(LINK_BACKLOG_POLL_MS));
+        if (!link_backlog_can_drain()) {
+            continue;
+        }
+#if FLASH_LOG
+        // Flash holds the older part, it goes out first
+        sent = link_backlog_drain_flash();
+#endif
+        sent = link_backlog_drain_ram() || sent;
+        if (sent) {
+            // The last records need not wait for the burst deadline
+            link_route_flush(LINK_TRAFFIC_BACKLOG);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/**
+  ******************************************************************************
+  * @file    link_route.c
+  * @brief   Routing of the bulk traffic between the BLE link and the wired bulk link.
+  *
+  *          A dump, a backlog drain or a trace can fill the BLE link for
+  *          seconds, and every burst it takes is one the statistics wait for.
+  *          With BULK_LINK such traffic goes on the wired USART1 link instead,
+  *          which has its own queue and a line rate many times that of the
+  *          BLE module. Each sender names its traffic rather than a link, and
+  *          one mask says which traffic goes where: a site with no cable
+  *          clears it and everything stays on BLE as without BULK_LINK.
+  *
+  *          The mask is read at every call. A sender that waits for room on
+  *          its link and is moved meanwhile finds room on the other one, the
+  *          frames of one dump may then be split between both links.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "link_route.h"
+
+/* Private variables ---------------------------------------------------------*/
+#if BULK_LINK
+// Written by the command task, read by every sender. Bits past the traffic are ignored.
+static volatile uint32_t link_route_bulk = LINK_ROUTE_BULK_MASK & ((1U << LINK_TRAFFIC_COUNT) - 1U);
+#endif
+
+// Function to find the link a traffic goes on
+uart_link_t link_route(link_traffic_t traffic) {
+#if BULK_LINK
+    if ((link_route_bulk & (1U << traffic)) != 0) {
+        return UART_LINK_BULK;
+    }
+#else
+    (void)traffic;
+#endif
+    return UART_LINK_BLE;
+}
+
+// Function to change the traffic on the bulk link
+bool link_route_set(uint32_t bulk_mask) {
+#if BULK_LINK
+    if (bulk_mask >= (1U << LINK_TRAFFIC_COUNT)) {
+        return false;
+    }
+    link_route_bulk = bulk_mask;
+    return true;
+#else
+    return bulk_mask == 0;
+#endif
+}
+
+// Function to read the traffic on the bulk link
+uint32_t link_route_mask(void) {
+#if BULK_LINK
+    return link_route_bulk;
+#else
+    return 0;
+#endif
+}
+
+// Function to queue a frame on the link of its traffic
+bool link_route_send(link_traffic_t traffic, const uint8_t *data, uint16_t size) {
+    return uart_tx_link_send(link_route(traffic), data, size);
+}
+
+// Function to send the open burst of the link of a traffic
+void link_route_flush(link_traffic_t traffic) {
+    uart_tx_link_flush(link_route(traffic));
+}
+
+// Function to read the bursts that can still be opened on the link of a traffic
+uint32_t link_route_free(link_traffic_t traffic) {
+    return uart_tx_link_free(link_route(traffic));
+}
@@ -0,0 +1,172 @@
+/**
+  ******************************************************************************
+  * @file    load_shed.c
+  * @brief   Load shedding driven by the depth of the pipeline queues.
+  *
+  *          Every stage hands its output on through a queue that drops when
+  *          it is full: the rings drop the new sample, the transmit queue
+  *          the new frame. Left alone, a saturated link or core drops
+  *          whatever comes last, an alert as readily as a view. Here the
+  *          depth of those queues sets a level that decides what goes
+  *          first, so the service shrinks in a fixed order instead.
+  *
+  *          The producer samples the transmit bursts in use and the fill of
+  *          every ring at each tick and keeps the peaks. At each batch the
+  *          consumer compares the peaks and the drop counters with the high
+  *          and low marks. Pressure raises the level by one, and it takes
+  *          LOAD_SHED_RECOVER_BATCHES calm batches to lower it by one, so a
+  *          load at the edge does not make it flap. Frames are admitted by
+  *          class against the free bursts, so the alerts keep a reserve of
+  *          their own whatever the level.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "load_shed.h"
+
+#if LOAD_SHEDDING
+#include "sensor_registry.h"
+
+/* Private variables ---------------------------------------------------------*/
+static const sample_ring_t *load_shed_rings;
+// Written by the consumer, read by every task
+static volatile uint32_t load_shed_current;
+// Peaks since the last update, raised by the producer and taken by the consumer
+static volatile uint32_t load_shed_queue_peak;
+static volatile uint32_t load_shed_ring_peak;
+// Consumer task only
+static uint32_t load_shed_calm;
+static uint32_t load_shed_frames_dropped;
+static uint32_t load_shed_samples_dropped;
+static uint32_t load_shed_level_batches[LOAD_SHED_LEVEL_COUNT];
+// Channels marked shed_low_priority in the registry
+static uint32_t load_shed_low_priority;
+
+/* Private function prototypes -----------------------------------------------*/
+static uint32_t load_shed_ring_drops(void);
+
+// Function to start without shedding
+void load_shed_init(const sample_ring_t *rings) {
+    load_shed_rings = rings;
+    load_shed_current = LOAD_SHED_LEVEL_NONE;
+    load_shed_queue_peak = 0;
+    load_shed_ring_peak = 0;
+    load_shed_calm = 0;
+    load_shed_frames_dropped = uart_tx_dropped();
+    load_shed_samples_dropped = load_shed_ring_drops();
+    load_shed_low_priority = 0;
+    for (uint32_t level = 0; level < LOAD_SHED_LEVEL_COUNT; ++level) {
+        load_shed_level_batches[level] = 0;
+    }
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        // A FIFO row is due when it fills, skipping a drain would only overrun it
+        if (sensor_registry[channel].shed_low_priority && sensor_registry[channel].fifo_depth <= 1) {
+            load_shed_low_priority |= 1U << channel;
+        }
+    }
+}
+
+// Function to sum the samples every ring dropped since boot
+static uint32_t load_shed_ring_drops(void) {
+    uint32_t dropped = 0;
+
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        dropped += load_shed_rings[channel].dropped;
+    }
+    return dropped;
+}
+
+// Function to keep the deepest queues of the batch
+void load_shed_observe(void) {
+    uint32_t queued = UART_TX_QUEUE_LENGTH - uart_tx_free();
+    uint32_t filled = 0;
+
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        uint32_t count = sample_ring_count(&load_shed_rings[channel], SAMPLE_READER_STATS);
+        filled = count > filled ? count : filled;
+    }
+    if (queued > load_shed_queue_peak) {
+        load_shed_queue_peak = queued;
+    }
+    if (filled > load_shed_ring_peak) {
+        load_shed_ring_peak = filled;
+    }
+}
+
+// Function to step the level from the peaks and drops of the batch
+void load_shed_update(void) {
+    uint32_t queued = __atomic_exchange_n(&load_shed_queue_peak, 0U, __ATOMIC_RELAXED);
+    uint32_t filled = __atomic_exchange_n(&load_shed_ring_peak, 0U, __ATOMIC_RELAXED);
+    uint32_t frames = uart_tx_dropped();
+    uint32_t samples = load_shed_ring_drops();
+    bool dropped = frames != load_shed_frames_dropped || samples != load_shed_samples_dropped;
+    uint32_t level = load_shed_current;
+
+    load_shed_frames_dropped = frames;
+    load_shed_samples_dropped = samples;
+    if (dropped || queued >= LOAD_SHED_QUEUE_HIGH ||
+        filled * 100U >= (uint32_t)LOAD_SHED_RING_HIGH_PCT * SAMPLE_RING_SIZE) {
+        // Under pressure, shed one more step at once
+        load_shed_calm = 0;
+        level = level + 1U < LOAD_SHED_LEVEL_COUNT ? level + 1U : level;
+    } else if (queued < LOAD_SHED_QUEUE_LOW &&
+               filled * 100U < (uint32_t)LOAD_SHED_RING_LOW_PCT * SAMPLE_RING_SIZE) {
+        if (level > LOAD_SHED_LEVEL_NONE && ++load_shed_calm >= LOAD_SHED_RECOVER_BATCHES) {
+            load_shed_calm = 0;
+            level--;
+        }
+    } else {
+        // Between the marks the level holds, and the calm run starts over
+        load_shed_calm = 0;
+    }
+    load_shed_current = level;
+    load_shed_level_batches[level]++;
+}
+
+// Function to read the current level
+load_shed_level_t load_shed_level(void) {
+    return (load_shed_level_t)load_shed_current;
+}
+
+// Function to check a frame class against the level and the free bursts
+bool load_shed_admit(load_shed_class_t frame_class) {
+    uint32_t free = uart_tx_free();
+
+    switch (frame_class) {
+    case LOAD_SHED_CLASS_ALERT:
+        return free > 0;
+    case LOAD_SHED_CLASS_LIVE:
+        return free > LOAD_SHED_ALERT_RESERVE;
+    case LOAD_SHED_CLASS_DETAIL:
+        return load_shed_current == LOAD_SHED_LEVEL_NONE && free > LOAD_SHED_ALERT_RESERVE;
+    default:
+        // One more burst stays free for the live frames
+        return load_shed_current == LOAD_SHED_LEVEL_NONE && free > LOAD_SHED_ALERT_RESERVE + 1U;
+    }
+}
+
+// Function to find the low-priority channels skipped at this tick
+uint32_t load_shed_mask(uint32_t tick) {
+    uint32_t mask = 0;
+
+    if (load_shed_current < LOAD_SHED_LEVEL_DECIMATE) {
+        return 0;
+    }
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        if ((load_shed_low_priority & (1U << channel)) == 0) {
+            continue;
+        }
+        // Counted in reads of the channel, so one read in LOAD_SHED_DECIMATION stays
+        uint32_t read = tick / sensor_read_divider(&sensor_registry[channel]);
+        if (read % LOAD_SHED_DECIMATION != 0) {
+            mask |= 1U << channel;
+        }
+    }
+    return mask;
+}
+
+// Function to read the batches spent at a level
+uint32_t load_shed_batches(load_shed_level_t level) {
+    return level < LOAD_SHED_LEVEL_COUNT ? load_shed_level_batches[level] : 0;
+}
+#endif /* LOAD_SHEDDING */
@@ -1,90 +1,580 @@
 #include <stdbool.h>
 #include "main.h"
+#include "adaptive_rate.h"
+#include "adc_acquisition.h"
+#include "capture_acquisition.h"
+#include "anomaly_gate.h"
+#include "batch_watermark.h"
+#include "ble_module.h"
+#include "boot_profile.h"
+#include "channel_correlation.h"
+#include "channel_resample.h"
+#include "clock_governor.h"
 #include "cmsis_os.h"
+#include "command_channel.h"
+#include "config_store.h"
+#include "container_benchmark.h"
+#include "crc_unit.h"
+#include "crash_capture.h"
+#include "cycle_counter.h"
+#include "deadline_monitor.h"
+#include "dma_copy.h"
+#include "energy_profile.h"
+#include "event_coding.h"
+#include "flash_log.h"
+#include "heap_telemetry.h"
+#include "i2c_acquisition.h"
+#include "i2c_arbiter.h"
+#include "i2c_telemetry.h"
+#include "isr_pipeline.h"
+#include "isr_profile.h"
+#include "kernel_trace.h"
+#include "latency_trace.h"
+#include "link_backlog.h"
+#include "load_shed.h"
+#include "occupancy_fusion.h"
+#include "outlier_filter.h"
+#include "pc_profile.h"
+#include "pipeline_priorities.h"
+#include "pipeline_config.h"
+#include "pir_event.h"
+#include "quantile_p2.h"
+#include "reliable_link.h"
+#include "rtc_stop.h"
+#include "sample_codec.h"
+#include "sample_decimator.h"
+#include "sample_mailbox.h"
+#include "sample_ring.h"
+#include "sample_timer.h"
+#include "sensor_breaker.h"
+#include "sensor_data.h"
+#include "sensor_drdy.h"
+#include "sensor_health.h"
+#include "sensor_registry.h"
+#include "sensor_sim.h"
+#include "sensor_stats.h"
+#include "stats_benchmark.h"
+#include "stats_arena.h"
+#include "stats_delta.h"
+#include "stats_engine.h"
+#include "sync_benchmark.h"
+#include "spectral_analysis.h"
+#include "stack_profile.h"
+#include "stats_frame.h"
+#include "stats_rollup.h"
+#include "stats_snapshot.h"
+#include "swo_trace.h"
+#include "task_signal.h"
+#include "task_telemetry.h"
+#include "throughput_bench.h"
+#include "time_base.h"
+#include "time_sync.h"
+#include "trend_filter.h"
+#include "trigger_engine.h"
+#include "tt_executive.h"
+#include "uart_tx.h"
+#include "warm_start.h"
+#include "watchdog.h"
+#include "window_dump.h"
+#include <stddef.h>
 #include <time.h>
-#include <math.h>
 #include <string.h>
 
 /* Private includes ----------------------------------------------------------*/
-// Define the structure to hold sensor data
+// Define the structure to hold filtered data for BLE, in stats frame order
 typedef struct {
-    float PIR;
-    float humidity_and_heat;
-    float LDR;
-} sensor_data_t;
-
-// Define the enum for different sensor types
-typedef enum {
-    SENSOR_PIR,
-    SENSOR_HUMIDITY_AND_HEAT,
-    SENSOR_LDR
-} sensor_t;
-
-// Define the structure to hold filtered data for BLE
-typedef struct {
-    float pir_std_dev;
-    float pir_max;
-    float pir_min;
-    float pir_median;
-    float humidity_and_heat_std_dev;
-    float humidity_and_heat_max;
-    float humidity_and_heat_min;
-    float humidity_and_heat_median;
-    float ldr_std_dev;
-    float ldr_max;
-    float ldr_min;
-    float ldr_median;
+    float stats[SENSOR_COUNT][STATS_FIELD_COUNT];
 } filtered_data_for_ble;
 
 // Task function prototypes
 void producer_task(void *argument);
 void consumer_task(void *argument);
 
-// Define buffer size and sensor I2C addresses
+// Define statistics window and sampling schedule, the sensors are listed in
+// sensor_registry.c. These are the settings at boot, the command channel can change them.
+// The window counts samples of each channel, the batch sampling ticks. Each
+// sensor is stored every sample_divider ticks of SAMPLE_PERIOD_MS and read
+// oversample times as often, see sample_decimator.h.
 #define BUFFER_SIZE 100
-#define PIR_I2C_ADDRESS 0x01
-#define HUMIDITY_AND_HEAT_I2C_ADDRESS 0x02
-#define LDR_I2C_ADDRESS 0x03
+#if RTC_STOP_SAMPLING
+#define SAMPLE_PERIOD_MS (RTC_STOP_PERIOD_S * 1000U)
+#else
+#define SAMPLE_PERIOD_MS 250
+#endif
+#define SAMPLES_PER_BATCH 120
+// 1: update statistics per sample, 0: recompute them with the fused batch kernel
+#ifndef STATS_STREAMING
+#define STATS_STREAMING 1
+#endif
+// What a report carries with the streaming statistics: SLIDING the window of
+// the newest samples, HOPPING the window that closed at the last of every
+// STATS_WINDOW_HOP samples, TUMBLING the last complete block of window size
+// samples, blocks do not overlap
+#define STATS_WINDOW_SLIDING 0
+#define STATS_WINDOW_HOPPING 1
+#define STATS_WINDOW_TUMBLING 2
+#ifndef STATS_WINDOW_MODE
+#define STATS_WINDOW_MODE STATS_WINDOW_SLIDING
+#endif
+#ifndef STATS_WINDOW_HOP
+#define STATS_WINDOW_HOP 30
+#endif
+// Span of the window in ms on top of its size: a sample this much older than
+// the newest one leaves it. 0: the window counts samples only.
+#ifndef STATS_WINDOW_MS
+#define STATS_WINDOW_MS 0
+#endif
+// Longest time a sample of STATS_TIME_WEIGHTED holds, a gap beyond it is not
+// credited to the sample before it. 0: no limit.
+#ifndef STATS_TIME_WEIGHT_HOLD_MS
+#define STATS_TIME_WEIGHT_HOLD_MS 0
+#endif
+// 1: a channel whose window did not move since its last report, or that no
+// frame, log or snapshot reads, keeps its statistics instead of recomputing them
+#ifndef STATS_LAZY
+#define STATS_LAZY 0
+#endif
+// 1: send keyframes every STATS_KEYFRAME_INTERVAL reports and only the changed statistics in between
+#ifndef STATS_DELTA_REPORTING
+#define STATS_DELTA_REPORTING 0
+#endif
+// 1: time the statistics kernels once at boot and report them over USART2
+#ifndef STATS_BENCHMARK
+#define STATS_BENCHMARK 0
+#endif
+// 1: follow every sensor frame with one stage of the latency histograms
+#ifndef LATENCY_REPORT
+#define LATENCY_REPORT 0
+#endif
+// 1: send per-task CPU load, stack and switch counts every TASK_TELEMETRY_PERIOD batches
+#ifndef TASK_TELEMETRY
+#define TASK_TELEMETRY 0
+#endif
+#define TASK_TELEMETRY_PERIOD 4
 //#define BLE_USART_ADDRESS 0x04
 
+// Batches are handed over by index, not copied: each ring keeps the window,
+// the batch the consumer is working on and the batch the producer is filling.
+// A channel read at every tick needs the most room.
+#if SAMPLE_RING_SIZE < (BUFFER_SIZE + 2 * SAMPLES_PER_BATCH)
+#error "SAMPLE_RING_SIZE too small for BUFFER_SIZE and two SAMPLES_PER_BATCH"
+#endif
+#if STATS_WINDOW_CAPACITY < BUFFER_SIZE
+#error "STATS_WINDOW_CAPACITY too small for BUFFER_SIZE"
+#endif
+#if STATS_WINDOW_MODE != STATS_WINDOW_SLIDING && STATS_WINDOW_MODE != STATS_WINDOW_HOPPING && \
+    STATS_WINDOW_MODE != STATS_WINDOW_TUMBLING
+#error "STATS_WINDOW_MODE must be STATS_WINDOW_SLIDING, STATS_WINDOW_HOPPING or STATS_WINDOW_TUMBLING"
+#endif
+#if (STATS_WINDOW_MODE != STATS_WINDOW_SLIDING || STATS_WINDOW_MS) && !STATS_STREAMING
+#error "STATS_WINDOW_MODE and STATS_WINDOW_MS close the windows per sample, build them with STATS_STREAMING=1"
+#endif
+#if SENSOR_DRDY && SENSOR_POWER_GATING
+#error "SENSOR_DRDY: the sensors are off between the ticks of SENSOR_POWER_GATING, they cannot signal a result"
+#endif
+#if STATS_TIME_WEIGHTED && !STATS_STREAMING
+#error "STATS_TIME_WEIGHTED weights the streaming windows, build it with STATS_STREAMING=1"
+#endif
+#if STATS_ARENA && !STATS_STREAMING
+#error "STATS_ARENA holds the streaming windows, build it with STATS_STREAMING=1"
+#endif
+#if STATS_VIEWS && !STATS_STREAMING
+#error "STATS_VIEWS slides the views with the streaming statistics, build it with STATS_STREAMING=1"
+#endif
+#if STATS_ENGINE && STATS_STREAMING
+#error "STATS_ENGINE replaces the batch kernels, build it with STATS_STREAMING=0"
+#endif
+#if STATS_LAZY && STATS_ENGINE
+#error "STATS_LAZY skips the per-channel kernels, the engine computes every channel at once"
+#endif
+#if RTC_STOP_SAMPLING && WATCHDOG
+#error "RTC_STOP_SAMPLING: the IWDG keeps counting in STOP mode, a sleep between two ticks outlasts it"
+#endif
+#if TIME_SYNC && RTC_STOP_SAMPLING
+#error "TIME_SYNC stamps the TIM3 ticks, RTC_STOP_SAMPLING stamps its wakeups with the calendar"
+#endif
+#if TIME_SYNC && FLASH_LOG_IDLE_ERASE
+#error "TIME_SYNC stamps the ticks from flash, FLASH_LOG_IDLE_ERASE needs the tick interrupt to run from RAM"
+#endif
+#if RTC_STOP_SAMPLING && CAPTURE_ACQUISITION
+#error "RTC_STOP_SAMPLING stops TIM4 with the other clocks, the captures need it running"
+#endif
+#if SENSOR_POWER_GATING && SENSOR_FIFO
+#error "SENSOR_POWER_GATING switches the sensors off between ticks, a FIFO sensor must keep sampling"
+#endif
+#if ISR_PIPELINE && (FLASH_LOG || LINK_BACKLOG || RELIABLE_LINK || STATS_ROLLUP || WINDOW_DUMP || SENSOR_SIMULATION || \
+                     KERNEL_TRACE || PC_PROFILE || CLOCK_GOVERNOR || WATCHDOG || STATS_BENCHMARK || SYNC_BENCHMARK || \
+                     CONTAINER_BENCHMARK || THROUGHPUT_BENCH || TASK_TELEMETRY || STACK_PROFILE || DMA_COPY || \
+                     TIME_SYNC || CONFIG_STORE)
+#error "ISR_PIPELINE starts no scheduler, the options with a task of their own or commands need the task pipeline"
+#endif
+#if ISR_PIPELINE && (DEADLINE_MONITOR || SENSOR_HEALTH || SENSOR_OCCUPANCY || ADAPTIVE_RATE || WARM_START || \
+                     ISR_PROFILE || HEAP_TELEMETRY || SPECTRAL_ANALYSIS)
+#error "ISR_PIPELINE runs the stages in an interrupt, these options enter kernel critical sections or signal tasks"
+#endif
+#if ISR_PIPELINE && (SENSOR_DRDY || SENSOR_FIFO || SENSOR_POWER_GATING)
+#error "ISR_PIPELINE reads no I2C sensor, the deferred work cannot wait for a bus sequence"
+#endif
+#if ISR_PIPELINE && ((configUSE_TICKLESS_IDLE == 1) || RTC_STOP_SAMPLING)
+#error "ISR_PIPELINE sleeps on exit itself, there is no idle task to sleep in"
+#endif
+#if ISR_PIPELINE && UART_TX_FLUSH_MS > 0
+#error "ISR_PIPELINE has no timer service task, build it with UART_TX_FLUSH_MS=0"
+#endif
+#if TT_EXECUTIVE && !ISR_PIPELINE
+#error "TT_EXECUTIVE schedules the deferred work of ISR_PIPELINE"
+#endif
+#if TT_EXECUTIVE && BATCH_WATERMARK
+#error "TT_EXECUTIVE keeps a fixed schedule of batches, build it without BATCH_WATERMARK"
+#endif
+// The last frame of a batch holds every slot of the schedule in tt_schedule
+#if TT_EXECUTIVE && (TT_BUDGET_ACQUIRE_US + TT_BUDGET_COMPUTE_US + TT_BUDGET_TRANSMIT_US) * 100ULL > \
+                    SAMPLE_PERIOD_MS * 1000ULL * TT_EXECUTIVE_LOAD_PCT
+#error "The TT_BUDGET_* of one frame exceed TT_EXECUTIVE_LOAD_PCT of SAMPLE_PERIOD_MS"
+#endif
+#if FLASH_LOG
+_Static_assert(sizeof(stats_frame_t) <= FLASH_LOG_PAYLOAD_MAX, "raise UART_TX_FRAME_MAX to replay this many sensors");
+#endif
+#if STATS_DELTA_REPORTING
+_Static_assert(sizeof(stats_report_t) <= UART_TX_FRAME_MAX, "raise UART_TX_FRAME_MAX for this many sensors");
+#else
+_Static_assert(sizeof(stats_frame_t) <= UART_TX_FRAME_MAX, "raise UART_TX_FRAME_MAX for this many sensors");
+#endif
+#if STATS_VIEWS
+_Static_assert(sizeof(stats_view_frame_t) <= UART_TX_FRAME_MAX, "raise UART_TX_FRAME_MAX for the view frames");
+#endif
+#if PIR_EVENT_CAPTURE
+_Static_assert(sizeof(pir_event_frame_t) <= UART_TX_FRAME_MAX, "PIR_EVENT_FRAME_EDGES too large for UART_TX_FRAME_MAX");
+#endif
+#if SPECTRAL_ANALYSIS
+_Static_assert(sizeof(spectral_frame_t) <= UART_TX_FRAME_MAX, "spectral_frame_t too large for UART_TX_FRAME_MAX");
+#endif
+#if STATS_CORRELATION
+_Static_assert(sizeof(correlation_frame_t) <= UART_TX_FRAME_MAX, "correlation_frame_t too large for UART_TX_FRAME_MAX");
+#endif
+#if DEADLINE_MONITOR
+_Static_assert(sizeof(deadline_frame_t) <= UART_TX_FRAME_MAX, "deadline_frame_t too large for UART_TX_FRAME_MAX");
+#endif
+#if SENSOR_HEALTH
+_Static_assert(sizeof(sensor_health_frame_t) <= UART_TX_FRAME_MAX, "sensor_health_frame_t too large for UART_TX_FRAME");
+#endif
+#if SENSOR_EVENT_CODING
+_Static_assert(sizeof(event_coding_frame_t) <= UART_TX_FRAME_MAX, "event_coding_frame_t too large for UART_TX_FRAME");
+#endif
+#if I2C_TELEMETRY
+_Static_assert(sizeof(i2c_telemetry_frame_t) <= UART_TX_FRAME_MAX, "i2c_telemetry_frame_t too large for UART_TX_FRAME");
+#endif
+#if WINDOW_DUMP
+_Static_assert(sizeof(window_dump_frame_t) <= UART_TX_FRAME_MAX, "window_dump_frame_t too large for UART_TX_FRAME");
+#endif
+#if TIME_SYNC
+_Static_assert(sizeof(time_sync_frame_t) <= UART_TX_FRAME_MAX, "time_sync_frame_t too large for UART_TX_FRAME");
+#endif
+#if HEAP_TELEMETRY
+_Static_assert(sizeof(heap_telemetry_frame_t) <= UART_TX_FRAME_MAX, "raise UART_TX_FRAME_MAX for the heap frame");
+#endif
+
 /* Private variables ---------------------------------------------------------*/
-sensor_data_t sensor_buffer[BUFFER_SIZE];
-int buffer_head = 0, buffer_tail = 0;
+// One ring per channel, written by producer_task, read and released by
+// consumer_task. CPU only, the I2C DMA lands in sensor_raw, so the rings can
+// live in CCM RAM. With DMA_COPY the window snapshots are read from them by
+// DMA2, so they move to SRAM.
+sample_ring_t sensor_buffer[SENSOR_COUNT] DMA_COPY_RAM;
+
+#if STATS_QUANTILES
+#define QUANTILE_COUNT 2
+static const float quantile_p[QUANTILE_COUNT] = { STATS_QUANTILE_UPPER_P, STATS_QUANTILE_TAIL_P };
+// Estimates over the batch being sampled, owned by producer_task
+static quantile_p2_t batch_quantiles[SENSOR_COUNT][QUANTILE_COUNT] CCMRAM;
+// Results of the last two batches. The producer fills the slot that is not
+// published and then publishes it, the consumer reads the published slot,
+// which is not written again until a whole batch later.
+static float published_quantiles[2][SENSOR_COUNT][QUANTILE_COUNT];
+static volatile uint32_t published_quantile_slot;
+#endif
+
+#if SENSOR_DECIMATION
+// Decimation filter of each channel, owned by producer_task
+static sample_decimator_t sensor_decimator[SENSOR_COUNT] CCMRAM;
+#endif
+
+#if STATS_TREND
+// Smoothed trend of each channel, updated by producer_task, value read by consumer_task
+static trend_filter_t sensor_trend[SENSOR_COUNT] CCMRAM;
+#endif
+
+#if OUTLIER_FILTER
+// Hampel filter of each channel, owned by producer_task
+static outlier_filter_t sensor_outlier[SENSOR_COUNT] CCMRAM;
+#endif
+
+#if STATS_STREAMING
+// Per-channel streaming statistics, owned by consumer_task
+static window_stats_t window_stats[SENSOR_COUNT] CCMRAM;
+// Samples at the front of each ring that are already in window_stats
+static uint32_t window_count[SENSOR_COUNT];
+#if STATS_ARENA
+// Window size the arrays of window_stats and view_stats are carved for
+static uint32_t layout_window;
+#endif
+#if STATS_WINDOW_MODE != STATS_WINDOW_SLIDING
+// Samples added since the last window closed
+static uint32_t window_hop[SENSOR_COUNT];
+#endif
+#if STATS_VIEWS
+// Lengths of the views, each slides over the newest samples of the window
+static const uint16_t view_length[] = { STATS_VIEW_WINDOWS };
+#define VIEW_COUNT (sizeof(view_length) / sizeof(view_length[0]))
+// Streaming statistics of the views of each channel, owned by consumer_task
+static window_stats_t view_stats[VIEW_COUNT][SENSOR_COUNT] CCMRAM;
+// Newest samples of each window that are in each view
+static uint32_t view_count[VIEW_COUNT][SENSOR_COUNT];
+// Statistics of each view as last computed, in stats frame order
+static float view_fields[VIEW_COUNT][SENSOR_COUNT][STATS_FIELD_COUNT];
+#endif
+#elif !STATS_ENGINE
+// Scratch copy of one channel for the in-place median selection
+static sample_value_t median_scratch[STATS_WINDOW_CAPACITY] DMA_COPY_RAM;
+#endif
+
+#if STATS_FIXED_POINT
+// The rings hold int16 codes, statistics leave the kernels in code units
+#define SAMPLE_UNIT(channel) (sensor_registry[channel].fixed_scale)
+#else
+#define SAMPLE_UNIT(channel) 1.0f
+#endif
+
+#if STATS_LAZY
+// Window each channel had when its statistics were last computed, as the
+// cursor of its oldest sample and the count. Owned by consumer_task.
+static uint32_t computed_first[SENSOR_COUNT];
+static uint32_t computed_count[SENSOR_COUNT];
+// Bit n set: channel n was computed at least once
+static uint32_t computed_reports;
+#endif
+
+// Statistics of the window, owned by consumer_task. Static so the consumer
+// stack does not grow with the sensors. The frame is built in the transmit
+// burst, see broadcast_ble.
+static filtered_data_for_ble filtered_stats CCMRAM;
+
+#if STATS_DELTA_REPORTING
+// Statistics the receiver holds, owned by consumer_task
+static stats_delta_t stats_delta CCMRAM;
+#endif
+
+#if ISR_PIPELINE
+// Newest sample of the batch computed and not sent yet, deferred work only
+static bool isr_batch_ready;
+static uint32_t isr_batch_timestamp;
+static uint32_t isr_batch_cycles;
+#endif
+
+#if FLASH_LOG
+// Every channel of a report as it goes into the log, independent of the receiver
+static stats_frame_t logged_stats CCMRAM;
+#if FLASH_LOG_COMPRESS
+// Codes of one record before they are packed
+static int16_t logged_codes[FLASH_LOG_PACKED_MAX];
+#endif
+#endif
+
+// Raw bytes of one sample or of a FIFO drain, static in SRAM so the DMA never
+// targets a task stack or CCM RAM
+static uint8_t sensor_raw[SENSOR_COUNT][SENSOR_READ_MAX];
+// The sensors due at a tick are read as a single I2C sequence, the triggers
+// first, each group in channel order on each bus. A sensor with a trigger takes
+// two entries: its write in the first sequence and its read in a second one,
+// after the conversions.
+static i2c_transaction_t sensor_reads[2 * SENSOR_COUNT];
+// Channel of each entry of sensor_reads
+static uint8_t sensor_read_channel[2 * SENSOR_COUNT];
+// Position of each channel in sensor_reads at the current tick, its read or a failed trigger
+static uint8_t sensor_read_index[SENSOR_COUNT];
+// Reads whose transfer failed and that were not stored, per channel
+static uint32_t sensor_read_errors[SENSOR_COUNT];
+#if SENSOR_FIFO
+// Set by the data-ready line, the FIFO rows are drained at the next tick
+static volatile bool sensor_fifo_ready;
+#endif
+#if SENSOR_EVENT_CODING
+// Last value stored for each event-coded channel and the channels that have
+// one, producer task only
+static sample_value_t event_coded_value[SENSOR_COUNT];
+static uint32_t event_coded_stored;
+#endif
+#if SENSOR_DERIVED
+// Latest read of every channel with its time, and the channels published
+// since the producer began the reads of the tick or of the data-ready lines,
+// producer task only
+static float derived_inputs[SENSOR_COUNT];
+static uint32_t derived_times[SENSOR_COUNT];
+static uint32_t derived_fresh;
+#endif
 
 // Hardware peripherals
 I2C_HandleTypeDef hi2c1;
+DMA_HandleTypeDef hdma_i2c1_rx;
+#if I2C_BUS_COUNT > 1
+I2C_HandleTypeDef hi2c2;
+DMA_HandleTypeDef hdma_i2c2_rx;
+#endif
+#if I2C_BUS_COUNT > 2
+I2C_HandleTypeDef hi2c3;
+DMA_HandleTypeDef hdma_i2c3_rx;
+#endif
+#if TASK_TELEMETRY || TIME_BASE || CLOCK_GOVERNOR || ENERGY_PROFILE
+TIM_HandleTypeDef htim2;
+#endif
+TIM_HandleTypeDef htim3;
+#if PIR_EVENT_CAPTURE
+TIM_HandleTypeDef htim5;
+#endif
+#if ADC_ACQUISITION
+TIM_HandleTypeDef htim8;
+DMA_HandleTypeDef hdma_adc1;
+#endif
+#if CAPTURE_ACQUISITION
+DMA_HandleTypeDef hdma_tim4_ch3;
+#endif
 UART_HandleTypeDef huart2;
+DMA_HandleTypeDef hdma_usart2_rx;
+DMA_HandleTypeDef hdma_usart2_tx;
+#if BULK_LINK
+UART_HandleTypeDef huart1;
+DMA_HandleTypeDef hdma_usart1_tx;
+#endif
 
 // FreeRTOS handles
-// Create threads, mutex and semaphore
-osThreadId producer_task_handle;
-osThreadId consumer_task_handle;
-
-osMutexId sensor_buffer_mutex;
-osMutexDef(sensor_buffer_mutex);
-
-osSemaphoreId producer_semaphore;
-osSemaphoreDef(producer_semaphore);
+// Tasks are woken with direct-to-task notifications, see task_signal.h
+TaskHandle_t producer_task_handle;
+TaskHandle_t consumer_task_handle;
 
-osSemaphoreId consumer_semaphore;
-osSemaphoreDef(consumer_semaphore);
+// Static task storage, sized at compile time and placed in CCM RAM.
+// Host/tools/stack_report.py suggests sizes from a STACK_PROFILE build.
+#ifndef PRODUCER_STACK_SIZE
+#define PRODUCER_STACK_SIZE configMINIMAL_STACK_SIZE
+#endif
+// The consumer runs the float kernels, leave room for the FPU context frame
+#ifndef CONSUMER_STACK_SIZE
+#define CONSUMER_STACK_SIZE (configMINIMAL_STACK_SIZE * 2)
+#endif
+static StaticTask_t producer_task_tcb CCMRAM;
+static StackType_t producer_task_stack[PRODUCER_STACK_SIZE] CCMRAM_NOINIT;
+static StaticTask_t consumer_task_tcb CCMRAM;
+static StackType_t consumer_task_stack[CONSUMER_STACK_SIZE] CCMRAM_NOINIT;
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_USART2_UART_Init(void);
+#if BULK_LINK
+static void MX_USART1_UART_Init(void);
+#endif
 static void MX_I2C1_Init(void);
+#if I2C_BUS_COUNT > 1
+static void MX_I2C2_Init(void);
+#endif
+#if I2C_BUS_COUNT > 2
+static void MX_I2C3_Init(void);
+#endif
+#if TASK_TELEMETRY || TIME_BASE || CLOCK_GOVERNOR || ENERGY_PROFILE
+static void MX_TIM2_Init(void);
+#endif
+static void MX_TIM3_Init(void);
+#if PIR_EVENT_CAPTURE
+static void MX_TIM5_Init(void);
+#endif
+#if ADC_ACQUISITION
+static void MX_TIM8_Init(void);
+#endif
 
 // Function prototypes for sensor operations
-float i2c_read_sensor_data(uint8_t device_address, sensor_t sensor_type);
-bool buffer_push(sensor_data_t data);
-void broadcast_ble(filtered_data_for_ble filtered_data);
+static void check_sensor_registry(void);
+static void sensor_read_queue(uint32_t index, uint32_t channel, bool trigger);
+static void sensor_setup(void);
+static void sensor_publish(uint32_t channel, float value, uint32_t timestamp, uint32_t acquired_cycles);
+static void sensor_publish_tick(uint32_t tick, uint32_t timestamp, uint32_t due_mask, uint32_t shed_mask);
+#if SENSOR_DERIVED
+static bool sensor_derive(uint32_t channel, float *value, uint32_t *timestamp);
+#endif
+static uint32_t sensor_conversion_wait_ms(uint32_t first, uint32_t count);
+#if DEADLINE_MONITOR || SENSOR_HEALTH
+static void sensor_read_times(uint32_t first, uint32_t count, uint32_t start_cycles);
+#endif
+#if SENSOR_DRDY
+static void sensor_drdy_read(void);
+#endif
+void broadcast_ble(const filtered_data_for_ble *filtered_data, uint32_t timestamp, uint32_t origin_cycles);
 
 // Function prototypes for data processing
-float calculate_std_dev(float data[], uint32_t count);
-float calculate_max(float data[], uint32_t count);
-float calculate_min(float data[], uint32_t count);
-float calculate_median(float data[], uint32_t count);
+static uint32_t report_samples_per_batch(void);
+static uint32_t report_window_size(void);
+#if !STATS_ENGINE
+static bool channel_window_moved(uint32_t channel, uint32_t count);
+#endif
+static uint32_t update_statistics(filtered_data_for_ble *filtered_data);
+static void windows_init(void);
+static bool batch_newest(uint32_t *timestamp, uint32_t *cycles);
+#if ISR_PIPELINE
+static bool isr_tick_acquire(uint32_t timestamp);
+static void isr_batch_close(void);
+#if !TT_EXECUTIVE
+static void isr_batch_report(void);
+#endif
+static void isr_batch_compute(void);
+static void isr_batch_transmit(void);
+#endif
+#if TT_EXECUTIVE
+static void tt_slot_acquire(uint32_t timestamp);
+static void tt_slot_compute(uint32_t timestamp);
+static void tt_slot_transmit(uint32_t timestamp);
+#endif
+#if CHANNEL_RESAMPLE
+static void send_resampled(void);
+#endif
+#if STATS_VIEWS || STATS_CORRELATION || CHANNEL_RESAMPLE
+static bool report_detail(void);
+#endif
+#if STATS_STREAMING
+#if STATS_TIME_WEIGHTED
+static float sample_hold_ms(const sample_ring_t *ring, uint32_t index);
+#endif
+static void channel_window_remove_oldest(sensor_t channel, uint32_t held);
+static void window_fields(const window_stats_t *stats, sensor_t channel, uint32_t offset, uint32_t count, float *out);
+#endif
+#if STATS_ARENA
+static void windows_layout(uint32_t window_size);
+#endif
+#if STATS_VIEWS
+static void channel_views_add(sensor_t channel, uint32_t offset, sample_value_t value, uint32_t window_size);
+static void channel_views_shrink(sensor_t channel, uint32_t count);
+static void channel_views_fields(sensor_t channel, uint32_t count, bool moved, const float *out);
+static void send_views(uint32_t timestamp);
+#endif
+#if STATS_QUANTILES
+static void publish_quantiles(void);
+static void channel_quantiles(sensor_t channel, float *out);
+#endif
+#if FLASH_LOG
+static void log_new_samples(void);
+#if SENSOR_EVENT_CODING
+static void log_channel_events(sensor_t channel);
+#endif
+static void log_statistics(const filtered_data_for_ble *filtered_data, uint32_t timestamp);
+#endif
+
+#if TT_EXECUTIVE
+// Static schedule of TT_EXECUTIVE over a major cycle of one batch, in the
+// order the slots run within a frame. The sweep opens every frame, the
+// statistics and the report close the batch in the frame of its last tick.
+static const tt_slot_t tt_schedule[] = {
+    { "acquire", tt_slot_acquire, 1, 0, TT_BUDGET_ACQUIRE_US },
+    { "compute", tt_slot_compute, SAMPLES_PER_BATCH, SAMPLES_PER_BATCH - 1, TT_BUDGET_COMPUTE_US },
+    { "transmit", tt_slot_transmit, SAMPLES_PER_BATCH, SAMPLES_PER_BATCH - 1, TT_BUDGET_TRANSMIT_US },
+};
+#endif
 
 /**
   * @brief  The application entry point.
@@ -92,24 +582,329 @@ float calculate_median(float data[], uint32_t count);
   */
 int main(void)
 {
+#if BOOT_PROFILE
+    boot_profile_mark(BOOT_MARK_MAIN);
+#endif
     // System initialization for USART/UART, I2C communication and data processing
     HAL_Init();
+#if BOOT_PROFILE
+    // The counter runs since the reset handler, zeroing it would lose the marks
+    boot_profile_mark(BOOT_MARK_HAL_INIT);
+#else
+    cycle_counter_init();
+#endif
     SystemClock_Config();
+#if BOOT_PROFILE
+    boot_profile_mark(BOOT_MARK_CLOCK);
+#endif
+#if CRASH_CAPTURE
+    // Before the pipeline traces over what the last boot left
+    crash_capture_init();
+#endif
+#if SWO_TRACE
+    // The ITM prescaler follows the core clock
+    swo_trace_init();
+#endif
+#if WATCHDOG
+    // Before anything can fail and record a new cause
+    watchdog_init();
+#endif
+#if (configUSE_TICKLESS_IDLE == 1) && defined(DEBUG)
+    // Keep the debug port clocked while the idle task sleeps
+    HAL_DBGMCU_EnableDBGSleepMode();
+#endif
+#if RTC_STOP_SAMPLING && defined(DEBUG)
+    // And while it stops
+    HAL_DBGMCU_EnableDBGStopMode();
+#endif
     MX_GPIO_Init();
+#if BOOT_PROFILE
+    boot_profile_mark(BOOT_MARK_GPIO);
+#endif
+    MX_DMA_Init();
+#if BOOT_PROFILE
+    boot_profile_mark(BOOT_MARK_DMA);
+#endif
     MX_USART2_UART_Init();
+#if BULK_LINK
+    MX_USART1_UART_Init();
+#endif
+#if BOOT_PROFILE
+    boot_profile_mark(BOOT_MARK_USART2);
+#endif
     MX_I2C1_Init();
+#if I2C_BUS_COUNT > 1
+    MX_I2C2_Init();
+#endif
+#if I2C_BUS_COUNT > 2
+    MX_I2C3_Init();
+#endif
+#if BOOT_PROFILE
+    boot_profile_mark(BOOT_MARK_I2C);
+#endif
+#if TASK_TELEMETRY || TIME_BASE || CLOCK_GOVERNOR || ENERGY_PROFILE
+    MX_TIM2_Init();
+#endif
+    MX_TIM3_Init();
+#if PIR_EVENT_CAPTURE
+    MX_TIM5_Init();
+#endif
+#if ADC_ACQUISITION
+    MX_TIM8_Init();
+#endif
+#if BOOT_PROFILE
+    boot_profile_mark(BOOT_MARK_TIMERS);
+#endif
+#if BLE_MODULE
+    // Still in command mode, and before a kernel object masks the HAL tick
+    ble_module_configure();
+#endif
 
     // Initialize FreeRTOS resources
-    sensor_buffer_mutex = xSemaphoreCreateMutex();
-    producer_semaphore = xSemaphoreCreateBinary();
-    consumer_semaphore = xSemaphoreCreateBinary();
+#if STACK_PROFILE
+    // Paint the interrupt stack before anything else nests on it
+    stack_profile_init();
+#endif
+    check_sensor_registry();
+    latency_trace_init();
+#if ISR_PROFILE
+    // The first window starts here, the handlers already count into it
+    isr_profile_init();
+#endif
+    i2c_acquisition_init();
+    crc_unit_init();
+#if DMA_COPY
+    dma_copy_init();
+#endif
+    uart_tx_init();
+#if FLASH_LOG
+    flash_log_init();
+#endif
+#if LINK_BACKLOG
+    link_backlog_init();
+#endif
+#if RELIABLE_LINK
+    reliable_link_init();
+#endif
+    pipeline_config_init(BUFFER_SIZE, SAMPLES_PER_BATCH, SAMPLE_PERIOD_MS);
+#if ADAPTIVE_RATE
+    adaptive_rate_init();
+#endif
+#if RTC_STOP_SAMPLING
+    // The first tick time is read from the calendar
+    rtc_stop_init();
+#endif
+    sample_timer_init(SAMPLE_PERIOD_MS);
+#if CONFIG_STORE
+    // The settings of the last save, read in place. The first tick still has the default period.
+    config_store_init();
+#endif
+#if DEADLINE_MONITOR
+    deadline_monitor_init();
+#endif
+#if PIR_EVENT_CAPTURE
+    pir_event_init();
+#endif
+#if ADC_ACQUISITION
+    adc_acquisition_init();
+#if SPECTRAL_ANALYSIS
+    spectral_analysis_init();
+#endif
+#endif
+#if CAPTURE_ACQUISITION
+    capture_acquisition_init();
+#endif
+#if TRIGGER_ENGINE
+    trigger_engine_init();
+#endif
+#if SENSOR_OCCUPANCY
+    occupancy_fusion_init();
+#endif
+#if STATS_CORRELATION
+    channel_correlation_init();
+#endif
+#if STATS_ROLLUP
+    stats_rollup_init();
+#endif
+#if SAMPLE_MAILBOX
+    sample_mailbox_init();
+#endif
+#if BATCH_WATERMARK
+    batch_watermark_init();
+#endif
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        sample_ring_init(&sensor_buffer[channel]);
+#if FLASH_LOG
+        // Every sample is logged once, whatever the statistics window keeps.
+        // Nothing is logged in a simulation, so the reader stays detached there.
+        if (!SENSOR_SIMULATION) {
+            sample_ring_attach(&sensor_buffer[channel], SAMPLE_READER_LOG, true);
+        }
+#endif
+#if SENSOR_DECIMATION
+        sample_decimator_init(&sensor_decimator[channel], sensor_registry[channel].oversample);
+#endif
+#if OUTLIER_FILTER
+        outlier_filter_init(&sensor_outlier[channel], sensor_registry[channel].outlier_floor);
+#endif
+#if STATS_TREND
+        trend_filter_init(&sensor_trend[channel]);
+#endif
+#if STATS_QUANTILES
+        for (uint32_t quantile = 0; quantile < QUANTILE_COUNT; ++quantile) {
+            quantile_p2_init(&batch_quantiles[channel][quantile], quantile_p[quantile]);
+        }
+#endif
+    }
+#if STATS_DELTA_REPORTING
+    stats_delta_reset(&stats_delta);
+#endif
+#if WARM_START
+    // The window of the previous run, in the rings before the first tick
+    uint32_t warm_samples = warm_start_restore(sensor_buffer);
+#if FLASH_LOG
+    // Logged by the previous run already
+    for (uint32_t channel = 0; channel < SENSOR_COUNT && !SENSOR_SIMULATION; ++channel) {
+        sample_ring_discard(&sensor_buffer[channel], SAMPLE_READER_LOG,
+                            sample_ring_count(&sensor_buffer[channel], SAMPLE_READER_LOG));
+    }
+#endif
+#endif
+#if LOAD_SHEDDING
+    load_shed_init(sensor_buffer);
+#endif
+#if CHANNEL_RESAMPLE
+    // Attached after the restore, the rows start with the first new sample
+    channel_resample_init(sensor_buffer);
+#endif
+
+#if TT_EXECUTIVE
+    // No tasks, the slots of the static schedule run as deferred interrupt work
+    windows_init();
+    if (!tt_executive_init(tt_schedule, sizeof(tt_schedule) / sizeof(tt_schedule[0]), SAMPLES_PER_BATCH,
+                           SAMPLE_PERIOD_MS * 1000U)) {
+        Error_Handler();
+    }
+    isr_pipeline_init(tt_executive_frame_from_isr, NULL);
+#elif ISR_PIPELINE
+    // No tasks, the producer and consumer stages run as deferred interrupt work
+    windows_init();
+    isr_pipeline_init(isr_tick_acquire, isr_batch_report);
+#else
+    // Create producer and consumer tasks from static storage, nothing comes from the heap.
+    // The producer preempts the statistics, see pipeline_priorities.h.
+    producer_task_handle = xTaskCreateStatic(producer_task, "ProducerTask", PRODUCER_STACK_SIZE, NULL,
+                                             TASK_PRIORITY_ACQUIRE, producer_task_stack, &producer_task_tcb);
+    consumer_task_handle = xTaskCreateStatic(consumer_task, "ConsumerTask", CONSUMER_STACK_SIZE, NULL,
+                                             TASK_PRIORITY_PROCESS, consumer_task_stack, &consumer_task_tcb);
+#if STACK_PROFILE
+    stack_profile_track(producer_task_handle, PRODUCER_STACK_SIZE);
+    stack_profile_track(consumer_task_handle, CONSUMER_STACK_SIZE);
+#endif
+#if WARM_START
+    if (warm_samples > 0) {
+        // The restored window is reported without waiting for a batch
+        task_signal_set(consumer_task_handle, TASK_SIGNAL_BATCH_READY);
+    }
+#endif
+#if STATS_BENCHMARK
+    // Runs above the consumer and finishes long before the first batch
+    stats_benchmark_start();
+#endif
+#if SYNC_BENCHMARK
+    // Runs above the consumer, its partner task one level higher
+    sync_benchmark_start();
+#endif
+#if CONTAINER_BENCHMARK
+    // Runs above the consumer like the statistics benchmark
+    container_benchmark_start();
+#endif
+#if FLASH_LOG
+    // Sleeps until a replay command arrives
+    flash_log_start();
+#endif
+#if STATS_ROLLUP
+    // Sleeps until a query command arrives
+    stats_rollup_start();
+#endif
+#if LINK_BACKLOG
+    // Drains what was kept while the BLE link was down
+    link_backlog_start();
+#endif
+#if RELIABLE_LINK
+    // Sends again what the receiver did not acknowledge
+    reliable_link_start();
+#endif
+#if SENSOR_SIMULATION
+    // Generates from the first tick, replays once a sim command selects it
+    sensor_sim_start();
+#endif
+#if THROUGHPUT_BENCH
+    // Drives the period and window from the first tick on
+    throughput_bench_start(sensor_buffer);
+#endif
+#if KERNEL_TRACE
+    // Sleeps until a trace command arrives, the hooks record from the first switch
+    kernel_trace_start();
+#endif
+#if PC_PROFILE
+    // Samples from here on, the boot before it is in BOOT_PROFILE
+    pc_profile_start();
+#endif
+#if WINDOW_DUMP
+    // Sleeps until a dump command freezes a window
+    window_dump_start();
+#endif
 
-    // Create producer and consumer tasks
-    xTaskCreate(producer_task, "ProducerTask", configMINIMAL_STACK_SIZE, NULL, 1, &producer_task_handle);
-    xTaskCreate(consumer_task, "ConsumerTask", configMINIMAL_STACK_SIZE, NULL, 1, &consumer_task_handle);
+    // Listen for configuration commands on USART2
+    command_channel_start();
+#endif
+#if CLOCK_GOVERNOR
+    // Full speed until the first interval has been measured
+    clock_governor_start();
+#endif
+#if WATCHDOG
+    // The IWDG cannot be stopped once it runs, start it last
+    watchdog_start();
+#endif
 
+#if PIR_EVENT_CAPTURE
+    // The edge clock starts with the sampling timer, both count from 0
+    if (HAL_TIM_Base_Start_IT(&htim5) != HAL_OK) {
+        Error_Handler();
+    }
+#endif
+#if TIME_BASE
+    // Stamps count from here, before any sample or command can be stamped
+    time_base_start();
+#endif
+#if ADC_ACQUISITION
+    // Conversions run ahead of the first tick, so it already finds a mean
+    adc_acquisition_start();
+#endif
+#if CAPTURE_ACQUISITION
+    // The first tick takes the newest edge as the start of its interval
+    capture_acquisition_start();
+#endif
+    // Start the sampling timer, the first tick arrives one period after start
+#if RTC_STOP_SAMPLING
+    rtc_stop_start();
+#else
+    if (HAL_TIM_Base_Start_IT(&htim3) != HAL_OK) {
+        Error_Handler();
+    }
+#endif
+
+#if BOOT_PROFILE
+    boot_profile_mark(BOOT_MARK_SCHEDULER);
+#endif
+#if ISR_PIPELINE
+    // From here on the core only runs interrupts
+    isr_pipeline_run();
+#else
     // Start FreeRTOS scheduler
     vTaskStartScheduler();
+#endif
 
     // The program should never reach here
     while (1) {}
@@ -117,213 +912,1908 @@ int main(void)
 
 
 void producer_task(void *argument) {
+#if !BATCH_WATERMARK
+    uint32_t samples_in_batch = 0;
+#endif
+    uint32_t tick = 0;
+
+#if SENSOR_POWER_GATING
+    // Off until the first tick with I2C reads, each power-up setting the sensors up again
+    i2c_acquisition_power(false);
+#else
+    // Rates and FIFO watermarks of the sensors that need them, before the first read
+    sensor_setup();
+#endif
+#if SENSOR_DRDY
+    // A line that came up before its interrupt was enabled raises no edge
+    sensor_drdy_rearm();
+#endif
     while (1) {
-        // Wait for producer semaphore
-        xSemaphoreTake(producer_semaphore, portMAX_DELAY);
-
-        // Access shared sensor buffer with mutex
-        osMutexWait(sensor_buffer_mutex, osWaitForever);
-        // Read sensor data and push it into the buffer
-        for(int i = 0; i < 30; ++i) {
-            osDelay(1000);  // Delay for 1 second
-
-            sensor_data_t sensor_data;
-            sensor_data.PIR = i2c_read_sensor_data(PIR_I2C_ADDRESS, SENSOR_PIR);
-            sensor_data.humidity_and_heat = i2c_read_sensor_data(HUMIDITY_AND_HEAT_I2C_ADDRESS, SENSOR_HUMIDITY_AND_HEAT);
-            sensor_data.LDR = i2c_read_sensor_data(LDR_I2C_ADDRESS, SENSOR_LDR);
-
-            if (!buffer_push(sensor_data)) {
-                // If buffer is full, discard oldest data
-                buffer_head = (buffer_head + 1) % BUFFER_SIZE;
-                // And push the newest data again
-                buffer_push(sensor_data);
+        // Wait for the next TIM3 sampling tick
+#if SENSOR_DRDY
+        // The data-ready rows are read as their lines rise, in between the ticks
+        uint32_t timestamp = 0;
+        uint32_t signalled;
+        do {
+            signalled = sample_timer_wait_or(TASK_SIGNAL_SENSOR_READY, &timestamp);
+            if ((signalled & TASK_SIGNAL_SENSOR_READY) != 0) {
+                sensor_drdy_read();
+            }
+        } while ((signalled & TASK_SIGNAL_SAMPLE_TICK) == 0);
+#else
+        uint32_t timestamp = sample_timer_wait();
+#endif
+        uint32_t tick_cycles = sample_timer_tick_cycles();
+#if SWO_TRACE
+        swo_trace_marker(SWO_TRACE_BEGIN, SWO_MARKER_TICK);
+#endif
+#if ENERGY_PROFILE
+        energy_profile_begin(ENERGY_STAGE_ACQUIRE);
+#endif
+#if CRASH_CAPTURE
+        crash_capture_trace(CRASH_EVENT_TICK, tick);
+#endif
+#if DEADLINE_MONITOR
+        deadline_monitor_start(sample_timer_tick_count(), tick_cycles);
+        // Sensors shed for running the ticks over their budget are not read
+        uint32_t shed_mask = deadline_monitor_shed_mask();
+#else
+        uint32_t shed_mask = 0;
+#endif
+#if LOAD_SHEDDING
+        // Low-priority channels are read less while the queues are backed up
+        load_shed_observe();
+        shed_mask |= load_shed_mask(tick);
+#endif
+
+        // The I2C sensors due at this tick, slow sensors cost no bus time in between
+        // and a FIFO or data-ready row none until its line has come up
+#if SENSOR_FIFO
+        bool fifo_due = sensor_fifo_ready;
+        sensor_fifo_ready = false;
+#else
+        bool fifo_due = false;
+#endif
+        uint32_t due_mask = 0;
+        for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+            const sensor_driver_t *driver = &sensor_registry[channel];
+            bool due = driver->fifo_depth > 1 ? fifo_due : tick % sensor_read_divider(driver) == 0;
+            // A data-ready row is read when its line rises, never speculatively
+            due = due && !sensor_on_drdy(driver);
+            if (due && sensor_source(driver) == SENSOR_SOURCE_I2C && (shed_mask & (1U << channel)) == 0) {
+#if SENSOR_BREAKER
+                // A sensor that keeps failing skips its due reads, no bus time spent on it
+                if (!sensor_breaker_allow((sensor_t)channel)) {
+                    continue;
+                }
+#endif
+                due_mask |= 1U << channel;
+            }
+        }
+        // Split phase: the triggers go first, so the plain reads of the same
+        // sequence run while the sensors convert
+        uint32_t count = 0;
+        for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+            if ((due_mask & (1U << channel)) != 0 && sensor_registry[channel].trigger != NULL) {
+                sensor_read_queue(count++, channel, true);
+            }
+        }
+        uint32_t triggers = count;
+        // Both sequences of the tick should have started before the next tick
+        TickType_t reads_deadline = xTaskGetTickCount() + pdMS_TO_TICKS(pipeline_config.sample_period_ms);
+        for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+            if ((due_mask & (1U << channel)) != 0 && sensor_registry[channel].trigger == NULL) {
+                sensor_read_queue(count++, channel, false);
             }
         }
-        // Release Mutex
-        osMutexRelease(sensor_buffer_mutex);
+        // The due sensors in one DMA sequence, back to back on each bus and the
+        // buses at the same time, each transaction has its own status
+        if (count > 0) {
+#if SENSOR_POWER_GATING
+            // The supply came up after the tick, the timestamp is still that of the tick
+            i2c_acquisition_power(true);
+            sensor_setup();
+#endif
+            memset(sensor_raw, 0, sizeof(sensor_raw));
+#if DEADLINE_MONITOR || SENSOR_HEALTH
+            uint32_t reads_cycles = cycle_counter_now();
+#endif
+            HAL_StatusTypeDef reads_status =
+                i2c_arbiter_run(sensor_reads, count, count * I2C_ACQUISITION_TIMEOUT_MS, I2C_ARBITER_SAMPLING,
+                                reads_deadline);
+#if CRASH_CAPTURE
+            crash_capture_trace(CRASH_EVENT_READS, ((uint32_t)reads_status << 8) | count);
+#else
+            (void)reads_status;
+#endif
+#if DEADLINE_MONITOR || SENSOR_HEALTH
+            sensor_read_times(0, count, reads_cycles);
+#endif
+        }
+        // One wait for the longest conversion still running, then the results
+        // of every sensor whose trigger went through in a second sequence
+        if (triggers > 0) {
+            uint32_t wait_ms = sensor_conversion_wait_ms(0, triggers);
+            if (wait_ms > 0) {
+                // A tick period rounds down, one more makes the wait at least wait_ms
+                vTaskDelay(pdMS_TO_TICKS(wait_ms) + 1U);
+            }
+            uint32_t first = count;
+            for (uint32_t index = 0; index < triggers; ++index) {
+                if (sensor_reads[index].status == HAL_OK) {
+                    sensor_read_queue(count++, sensor_read_channel[index], false);
+                }
+            }
+            if (count > first) {
+#if DEADLINE_MONITOR || SENSOR_HEALTH
+                uint32_t results_cycles = cycle_counter_now();
+#endif
+                HAL_StatusTypeDef results_status =
+                    i2c_arbiter_run(&sensor_reads[first], count - first, (count - first) * I2C_ACQUISITION_TIMEOUT_MS,
+                                    I2C_ARBITER_SAMPLING, reads_deadline);
+#if CRASH_CAPTURE
+                crash_capture_trace(CRASH_EVENT_READS, ((uint32_t)results_status << 8) | (count - first));
+#else
+                (void)results_status;
+#endif
+#if DEADLINE_MONITOR || SENSOR_HEALTH
+                sensor_read_times(first, count - first, results_cycles);
+#endif
+            }
+        }
+#if SENSOR_BREAKER
+        // The trigger or the read of each sensor, whichever failed first
+        for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+            if ((due_mask & (1U << channel)) != 0) {
+                sensor_breaker_result((sensor_t)channel, sensor_reads[sensor_read_index[channel]].status == HAL_OK);
+            }
+        }
+#endif
+#if SENSOR_POWER_GATING
+        if (count > 0) {
+            // Every read of the tick is in, the sensors wait unpowered for the next one
+            i2c_acquisition_power(false);
+        }
+#endif
+#if SENSOR_FIFO
+        // Still up after the drain, the FIFO filled again and raises no new edge
+        if (fifo_due && HAL_GPIO_ReadPin(SENSOR_FIFO_READY_GPIO_Port, SENSOR_FIFO_READY_Pin) == GPIO_PIN_SET) {
+            sensor_fifo_ready = true;
+        }
+#endif
+        // Publish the samples, a full ring drops its sample and counts the overrun
+        sensor_publish_tick(tick, timestamp, due_mask, shed_mask);
+        tick++;
+#if TRIGGER_ENGINE
+        // Alerts of this tick go out now, not with the batch
+        trigger_engine_flush();
+#endif
+        latency_trace_record(LATENCY_STAGE_ACQUIRE, tick_cycles);
+#if DEADLINE_MONITOR
+        deadline_monitor_finish(tick_cycles);
+#endif
+#if SWO_TRACE
+        swo_trace_marker(SWO_TRACE_END, SWO_MARKER_TICK);
+#endif
+#if ENERGY_PROFILE
+        energy_profile_end(ENERGY_STAGE_ACQUIRE);
+#endif
+#if WATCHDOG
+        // The next tick is one period away, a hung read shows as a missing check in
+        watchdog_checkin(WATCHDOG_STAGE_ACQUIRE, 2U * pipeline_config.sample_period_ms + WATCHDOG_ACQUIRE_SLACK_MS);
+#endif
 
-        // Signal consumer task
-        xSemaphoreGive(consumer_semaphore);
+#if BATCH_WATERMARK
+        // Signal consumer task once the rings hold a batch, or their oldest new sample at its deadline
+        if (batch_watermark_due(timestamp, report_samples_per_batch(), pipeline_config.sample_period_ms)) {
+#else
+        // Signal consumer task once a full batch of ticks has been sampled
+        if (++samples_in_batch >= report_samples_per_batch()) {
+            samples_in_batch = 0;
+#endif
+#if ADAPTIVE_RATE
+            adaptive_rate_batch_end();
+#endif
+#if STATS_QUANTILES
+            publish_quantiles();
+#endif
+#if STATS_CORRELATION
+            channel_correlation_publish();
+#endif
+#if WATCHDOG
+            // The consumer has to get to the batch even when it is starved
+            watchdog_arm(WATCHDOG_STAGE_PROCESS, WATCHDOG_PROCESS_BUDGET_MS);
+#endif
+#if CRASH_CAPTURE
+            crash_capture_trace(CRASH_EVENT_BATCH, report_samples_per_batch());
+#endif
+            task_signal_set(consumer_task_handle, TASK_SIGNAL_BATCH_READY);
+        }
     }
 }
 
 
 void consumer_task(void *argument) {
-    /* Consumer thread waits the condition variable which indicates
-     * that there are at least one entry in the circular thread queue.
-     * If the variable is set then takes mutex, read data,
-     * release mutex and set condition variable which indicates
-     * that there are at least one entry in the circular queue.
-     * After this it can apply and filter to the data.
+    /* Consumer thread waits for the notification which indicates that
+     * a new batch of samples has been pushed into the ring.
+     * It brings the statistics of the window up to date, releases
+     * samples that fell out of the window and broadcasts the result.
+     * Ownership moves with the ring indices: slots below head belong to
+     * the consumer, the producer keeps filling the next batch behind
+     * them, so sampling never pauses while statistics are computed.
      */
-    while (1) {
-        // Wait for consumer semaphore
-        xSemaphoreTake(consumer_semaphore, portMAX_DELAY);
-
-        // Access shared sensor buffer with mutex
-        osMutexWait(sensor_buffer_mutex, osWaitForever);
+    windows_init();
+#if LATENCY_REPORT
+    uint32_t report_stage = 0;
+#endif
+#if TASK_TELEMETRY
+    uint32_t telemetry_batches = 0;
+#endif
+#if STACK_PROFILE
+    uint32_t stack_profile_batches = 0;
+#endif
+#if ISR_PROFILE
+    uint32_t isr_profile_batches = 0;
+#endif
+#if HEAP_TELEMETRY
+    uint32_t heap_telemetry_batches = 0;
+#endif
+#if ENERGY_PROFILE
+    uint32_t energy_batches = 0;
+#endif
+#if SPECTRAL_ANALYSIS
+    uint32_t spectral_batches = 0;
+#endif
+#if DEADLINE_MONITOR
+    uint32_t deadline_batches = 0;
+#endif
+#if SENSOR_HEALTH
+    uint32_t sensor_health_batches = 0;
+#endif
+#if SENSOR_EVENT_CODING
+    uint32_t event_coding_batches = 0;
+#endif
+#if I2C_TELEMETRY
+    uint32_t i2c_telemetry_batches = 0;
+#endif
+#if SENSOR_OCCUPANCY
+    bool reported = false;
+#endif
+#if BOOT_PROFILE
+    // First frame, its own mark ends the profile
+    boot_profile_report();
+#endif
+#if BLE_MODULE
+    // How far the module setup at boot got
+    ble_module_report();
+#endif
+#if CRASH_CAPTURE
+    // The dump of the last fault goes out before the first report
+    crash_capture_report();
+#endif
 
-        // Read all sensor data from the buffer and write it to temp data array
-        float pir_data[BUFFER_SIZE];
-        float humidity_and_heat_data[BUFFER_SIZE];
-        float ldr_data[BUFFER_SIZE];
+    while (1) {
+        // Wait for the producer to signal a new batch
+#if WATCHDOG
+        watchdog_idle(WATCHDOG_STAGE_PROCESS);
+#endif
+#if SENSOR_OCCUPANCY
+        uint32_t signals = task_signal_wait(TASK_SIGNAL_BATCH_READY | TASK_SIGNAL_OCCUPANCY, portMAX_DELAY);
+#else
+        task_signal_wait(TASK_SIGNAL_BATCH_READY, portMAX_DELAY);
+#endif
+#if WATCHDOG
+        watchdog_arm(WATCHDOG_STAGE_PROCESS, WATCHDOG_PROCESS_BUDGET_MS);
+#endif
+#if SENSOR_OCCUPANCY
+        if ((signals & TASK_SIGNAL_BATCH_READY) == 0) {
+            // A new occupancy state between batches goes out now with the statistics
+            // of the last report, dated by the read that changed it
+            if (reported) {
+                broadcast_ble(&filtered_stats, occupancy_fusion_changed_ms(), cycle_counter_now());
+            }
+            continue;
+        }
+#endif
+#if CRASH_CAPTURE
+        crash_capture_trace(CRASH_EVENT_COMPUTE, 0);
+#endif
 
-        for (int i = 0; i < BUFFER_SIZE; ++i) {
-            pir_data[i] = sensor_buffer[i].PIR;
-            humidity_and_heat_data[i] = sensor_buffer[i].humidity_and_heat;
-            ldr_data[i] = sensor_buffer[i].LDR;
+        // The newest sample of the batch, over all channels, dates the frame
+        uint32_t newest_cycles, newest_timestamp;
+        if (!batch_newest(&newest_timestamp, &newest_cycles)) {
+            continue;
         }
-        // Release Mutex
-        osMutexRelease(sensor_buffer_mutex);
-        // And Semaphore
-        xSemaphoreGive(producer_semaphore);
+        uint32_t compute_start = cycle_counter_now();
+        latency_trace_record(LATENCY_STAGE_QUEUE, newest_cycles);
+#if FLASH_LOG
+        // Simulated samples would rotate the recording a replay reads out of the log
+        if (!SENSOR_SIMULATION) {
+            log_new_samples();
+        }
+#endif
 
         // Calculate statistics for each sensor data type
-        float pir_std_dev = calculate_std_dev(pir_data, BUFFER_SIZE);
-        float pir_max = calculate_max(pir_data, BUFFER_SIZE);
-        float pir_min = calculate_min(pir_data, BUFFER_SIZE);
-        float pir_median = calculate_median(pir_data, BUFFER_SIZE);
-
-        float humidity_and_heat_std_dev = calculate_std_dev(humidity_and_heat_data, BUFFER_SIZE);
-        float humidity_and_heat_max = calculate_max(humidity_and_heat_data, BUFFER_SIZE);
-        float humidity_and_heat_min = calculate_min(humidity_and_heat_data, BUFFER_SIZE);
-        float humidity_and_heat_median = calculate_median(humidity_and_heat_data, BUFFER_SIZE);
-
-        float ldr_std_dev = calculate_std_dev(ldr_data, BUFFER_SIZE);
-        float ldr_max = calculate_max(ldr_data, BUFFER_SIZE);
-        float ldr_min = calculate_min(ldr_data, BUFFER_SIZE);
-        float ldr_median = calculate_median(ldr_data, BUFFER_SIZE);
-
-        // Pack the filtered data for BLE transmission
-        filtered_data_for_ble filtered_data;
-        filtered_data.pir_std_dev = pir_std_dev;
-        filtered_data.pir_max = pir_max;
-        filtered_data.pir_min = pir_min;
-        filtered_data.pir_median = pir_median;
-        filtered_data.humidity_and_heat_std_dev = humidity_and_heat_std_dev;
-        filtered_data.humidity_and_heat_max = humidity_and_heat_max;
-        filtered_data.humidity_and_heat_min = humidity_and_heat_min;
-        filtered_data.humidity_and_heat_median = humidity_and_heat_median;
-        filtered_data.ldr_std_dev = ldr_std_dev;
-        filtered_data.ldr_max = ldr_max;
-        filtered_data.ldr_min = ldr_min;
-        filtered_data.ldr_median = ldr_median;
+#if SWO_TRACE
+        swo_trace_marker(SWO_TRACE_BEGIN, SWO_MARKER_COMPUTE);
+#endif
+#if ENERGY_PROFILE
+        energy_profile_begin(ENERGY_STAGE_COMPUTE);
+#endif
+        uint32_t updated = update_statistics(&filtered_stats);
+#if ENERGY_PROFILE
+        energy_profile_end(ENERGY_STAGE_COMPUTE);
+#endif
+#if SWO_TRACE
+        swo_trace_marker(SWO_TRACE_END, SWO_MARKER_COMPUTE);
+#endif
+        if (updated == 0) {
+            continue;
+        }
+#if SENSOR_EVENT_CODING
+        // A few stored changes stand for the whole window, weighted by their time
+        for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+            if (sensor_registry[channel].event_coded) {
+                event_coding_update((sensor_t)channel, &sensor_buffer[channel], newest_timestamp, SAMPLE_UNIT(channel),
+                                    filtered_stats.stats[channel]);
+            }
+        }
+#endif
+        latency_trace_record(LATENCY_STAGE_COMPUTE, compute_start);
+#if WINDOW_DUMP
+        // The samples behind the statistics of this report, if a dump asked for them
+        window_dump_capture(sensor_buffer, newest_timestamp);
+#endif
+#if STATS_SNAPSHOT
+        // Readable by the command task before the frame is even queued
+        stats_snapshot_publish(filtered_stats.stats, newest_timestamp);
+#endif
+#if WARM_START
+        // The window as it is now, for the next boot
+        warm_start_save(sensor_buffer);
+#endif
+
+#if LOAD_SHEDDING
+        // The level of the frames of this batch, from the queues since the last one
+        load_shed_update();
+#endif
 
         // Broadcast filtered data over BLE
-        broadcast_ble(filtered_data);
+#if SWO_TRACE
+        swo_trace_marker(SWO_TRACE_BEGIN, SWO_MARKER_BROADCAST);
+#endif
+#if ANOMALY_GATE
+        // Windows near their baseline only go out as heartbeats, the flash log keeps them all
+        if (anomaly_gate_admit((uint16_t)pipeline_config.channel_mask, filtered_stats.stats)) {
+            broadcast_ble(&filtered_stats, newest_timestamp, newest_cycles);
+        }
+#else
+        broadcast_ble(&filtered_stats, newest_timestamp, newest_cycles);
+#endif
+#if SENSOR_OCCUPANCY
+        reported = true;
+#endif
+#if SWO_TRACE
+        swo_trace_marker(SWO_TRACE_END, SWO_MARKER_BROADCAST);
+#endif
+#if STATS_VIEWS
+        // The shorter views of the same samples
+        if (report_detail()) {
+            send_views(newest_timestamp);
+        }
+#endif
+#if FLASH_LOG
+        if (!SENSOR_SIMULATION) {
+            log_statistics(&filtered_stats, newest_timestamp);
+        }
+#endif
+
+#if STATS_CORRELATION
+        // Co-moments of the same interval as the statistics just sent
+        correlation_frame_t correlation_frame;
+        uint16_t correlation_size = channel_correlation_build(&correlation_frame, newest_timestamp);
+        if (report_detail()) {
+            uart_tx_send((const uint8_t *)&correlation_frame, correlation_size);
+        }
+#endif
+#if STATS_ROLLUP
+        // Minutes and hours that closed during the batch, logged like the statistics
+        stats_rollup_report(!SENSOR_SIMULATION, newest_timestamp);
+#endif
+
+#if PIR_EVENT_CAPTURE
+        // Motion edges since the last report, what does not fit waits for the next batch
+        pir_event_frame_t edges;
+        uint16_t edges_size;
+        while (uart_tx_free() > 0 && (edges_size = pir_event_build(&edges)) != 0) {
+            uart_tx_send((const uint8_t *)&edges, edges_size);
+        }
+#endif
+#if CHANNEL_RESAMPLE
+        send_resampled();
+#endif
+
+#if LATENCY_REPORT
+        // One stage per frame keeps the added airtime bounded
+        latency_report_frame_t report;
+        latency_trace_report(report_stage, &report);
+        uart_tx_send((const uint8_t *)&report, sizeof(report));
+        report_stage = (report_stage + 1) % LATENCY_STAGE_COUNT;
+#endif
+#if TASK_TELEMETRY
+        // Loads are averaged over the batches since the previous frame
+        if (++telemetry_batches == TASK_TELEMETRY_PERIOD) {
+            task_telemetry_frame_t telemetry;
+            uint16_t size = task_telemetry_build(&telemetry);
+            uart_tx_send((const uint8_t *)&telemetry, size);
+            telemetry_batches = 0;
+        }
+#endif
+#if STACK_PROFILE
+        // High water marks only move on new paths, a slow period is enough
+        if (++stack_profile_batches == STACK_PROFILE_PERIOD) {
+            stack_profile_frame_t stack_frame;
+            uint16_t size = stack_profile_build(&stack_frame);
+            uart_tx_send((const uint8_t *)&stack_frame, size);
+            stack_profile_batches = 0;
+        }
+#endif
+#if ISR_PROFILE
+        // A window of several batches, so the rare interrupts show in it too
+        if (++isr_profile_batches == ISR_PROFILE_PERIOD) {
+            isr_profile_report();
+            isr_profile_batches = 0;
+        }
+#endif
+#if HEAP_TELEMETRY
+        // Nothing in the pipeline allocates, the frame only confirms it
+        if (++heap_telemetry_batches == HEAP_TELEMETRY_PERIOD) {
+            heap_telemetry_frame_t heap_frame;
+            uint16_t size = heap_telemetry_build(&heap_frame);
+            uart_tx_send((const uint8_t *)&heap_frame, size);
+            heap_telemetry_batches = 0;
+        }
+#endif
+#if ENERGY_PROFILE
+        // Power-state times and the energy per sample since the previous frame
+        if (++energy_batches == ENERGY_PROFILE_PERIOD) {
+            energy_frame_t energy_frame;
+            uint16_t size = energy_profile_build(&energy_frame);
+            uart_tx_send((const uint8_t *)&energy_frame, size);
+            energy_batches = 0;
+        }
+#endif
+#if SPECTRAL_ANALYSIS
+        // One FFT of the newest block, a few hundred microseconds per report
+        if (++spectral_batches == SPECTRAL_ANALYSIS_PERIOD) {
+            spectral_frame_t spectral_frame;
+            uint16_t size = spectral_analysis_build(&spectral_frame);
+            if (size != 0) {
+                uart_tx_send((const uint8_t *)&spectral_frame, size);
+            }
+            spectral_batches = 0;
+        }
+#endif
+#if DEADLINE_MONITOR
+        // Lateness of the ticks since the previous frame, counters since boot
+        if (++deadline_batches == DEADLINE_MONITOR_PERIOD) {
+            deadline_frame_t deadline_frame;
+            uint16_t size = deadline_monitor_build(&deadline_frame);
+            uart_tx_send((const uint8_t *)&deadline_frame, size);
+            deadline_batches = 0;
+        }
+#endif
+#if SENSOR_HEALTH
+        // Reads and failures of the channels since the previous table, scores rolling
+        if (++sensor_health_batches == SENSOR_HEALTH_PERIOD) {
+            sensor_health_report();
+            sensor_health_batches = 0;
+        }
+#endif
+#if SENSOR_EVENT_CODING
+        // Runs of the event-coded channels as they stand at the latest batch
+        if (++event_coding_batches == SENSOR_EVENT_CODING_PERIOD) {
+            event_coding_report();
+            event_coding_batches = 0;
+        }
+#endif
+#if I2C_TELEMETRY
+        // Bus time and failures of every bus and device since the previous table
+        if (++i2c_telemetry_batches == I2C_TELEMETRY_PERIOD) {
+            i2c_telemetry_report();
+            i2c_telemetry_batches = 0;
+        }
+#endif
+#if CRASH_CAPTURE
+        crash_capture_trace(CRASH_EVENT_REPORT, uart_tx_free());
+#endif
+    }
+}
+
+// Function to start the statistics windows of every channel empty
+static void windows_init(void) {
+#if STATS_ARENA
+    windows_layout(pipeline_config.window_size);
+#elif STATS_STREAMING
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        window_stats_reset(&window_stats[channel]);
+#if STATS_VIEWS
+        for (uint32_t view = 0; view < VIEW_COUNT; ++view) {
+            window_stats_reset(&view_stats[view][channel]);
+        }
+#endif
     }
+#endif
 }
 
-// Function to push data into the buffer
-bool buffer_push(sensor_data_t data) {
-    int next_head = (buffer_head + 1) % BUFFER_SIZE;
-    if (next_head != buffer_tail) {
-        sensor_buffer[buffer_head] = data;
-        buffer_head = next_head;
-        return true;
+// Function to find the newest sample of the batch over all channels, false without any
+static bool batch_newest(uint32_t *timestamp, uint32_t *cycles) {
+    bool any_sample = false;
+
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        const sample_ring_t *ring = &sensor_buffer[channel];
+        uint32_t available = sample_ring_count(ring, SAMPLE_READER_STATS);
+        if (available == 0) {
+            continue;
+        }
+        uint32_t sample_time = sample_ring_timestamp(ring, SAMPLE_READER_STATS, available - 1);
+        if (!any_sample || (int32_t)(sample_time - *timestamp) > 0) {
+            *timestamp = sample_time;
+            *cycles = sample_ring_acquired_cycles(ring, SAMPLE_READER_STATS, available - 1);
+            any_sample = true;
+        }
     }
+    return any_sample;
+}
+
+#if ISR_PIPELINE
+// Function to sample one tick from the deferred interrupt, the producer_task
+// loop without the I2C sequences. True once the tick completed a batch, never
+// with TT_EXECUTIVE, whose schedule ends the batches.
+static bool isr_tick_acquire(uint32_t timestamp) {
+    static uint32_t tick;
+#if !BATCH_WATERMARK && !TT_EXECUTIVE
+    static uint32_t samples_in_batch;
+#endif
+    uint32_t tick_cycles = sample_timer_tick_cycles();
+
+#if SWO_TRACE
+    swo_trace_marker(SWO_TRACE_BEGIN, SWO_MARKER_TICK);
+#endif
+#if ENERGY_PROFILE
+    energy_profile_begin(ENERGY_STAGE_ACQUIRE);
+#endif
+#if CRASH_CAPTURE
+    crash_capture_trace(CRASH_EVENT_TICK, tick);
+#endif
+#if LOAD_SHEDDING
+    load_shed_observe();
+    uint32_t shed_mask = load_shed_mask(tick);
+#else
+    uint32_t shed_mask = 0;
+#endif
+    sensor_publish_tick(tick++, timestamp, 0, shed_mask);
+#if TRIGGER_ENGINE
+    trigger_engine_flush();
+#endif
+    latency_trace_record(LATENCY_STAGE_ACQUIRE, tick_cycles);
+#if SWO_TRACE
+    swo_trace_marker(SWO_TRACE_END, SWO_MARKER_TICK);
+#endif
+#if ENERGY_PROFILE
+    energy_profile_end(ENERGY_STAGE_ACQUIRE);
+#endif
+
+#if TT_EXECUTIVE
+    // A skipped tick still counts as a frame of the schedule, a count of the runs here would not
     return false;
+#else
+#if BATCH_WATERMARK
+    if (!batch_watermark_due(timestamp, report_samples_per_batch(), pipeline_config.sample_period_ms)) {
+        return false;
+    }
+#else
+    if (++samples_in_batch < report_samples_per_batch()) {
+        return false;
+    }
+    samples_in_batch = 0;
+#endif
+    isr_batch_close();
+    return true;
+#endif
 }
 
+// Function to publish what the producer side keeps per batch, once the batch is complete
+static void isr_batch_close(void) {
+#if STATS_QUANTILES
+    publish_quantiles();
+#endif
+#if STATS_CORRELATION
+    channel_correlation_publish();
+#endif
+#if CRASH_CAPTURE
+    crash_capture_trace(CRASH_EVENT_BATCH, report_samples_per_batch());
+#endif
+}
 
-// Function to read sensor data from I2C
-float i2c_read_sensor_data(uint8_t device_address, sensor_t sensor_type) {
-    uint8_t data[2]; // Buffer for received data
-    HAL_I2C_Master_Receive(&hi2c1, device_address << 1, data, sizeof(data), HAL_MAX_DELAY); // Read data from I2C device
-    // Process and convert received data appropriately
-    float sensor_data = (float)((data[0] << 8) | data[1]); // Example: Convert 16-bit data to float
-    return sensor_data;
+#if !TT_EXECUTIVE
+// Function to compute and send the report of a batch from the deferred
+// interrupt, the statistics frames of consumer_task without the periodic ones
+static void isr_batch_report(void) {
+    isr_batch_compute();
+    isr_batch_transmit();
 }
+#endif
 
-// Function to transmit data over BLE
-void broadcast_ble(filtered_data_for_ble filtered_data) {
-    // Package data for transmission over USART to BLE device
-    uint8_t data[48]; // 4 bytes x 12 data
-    memcpy(data, &filtered_data, sizeof(filtered_data_for_ble));
-    // Transmit data over USART to BLE
-    HAL_UART_Transmit(&huart2, data, sizeof(data), HAL_MAX_DELAY);
+// Function to compute the statistics of a batch, kept for isr_batch_transmit
+static void isr_batch_compute(void) {
+    uint32_t newest_cycles, newest_timestamp;
+
+    isr_batch_ready = false;
+#if CRASH_CAPTURE
+    crash_capture_trace(CRASH_EVENT_COMPUTE, 0);
+#endif
+    if (!batch_newest(&newest_timestamp, &newest_cycles)) {
+        return;
+    }
+    uint32_t compute_start = cycle_counter_now();
+    latency_trace_record(LATENCY_STAGE_QUEUE, newest_cycles);
+#if SWO_TRACE
+    swo_trace_marker(SWO_TRACE_BEGIN, SWO_MARKER_COMPUTE);
+#endif
+#if ENERGY_PROFILE
+    energy_profile_begin(ENERGY_STAGE_COMPUTE);
+#endif
+    uint32_t updated = update_statistics(&filtered_stats);
+#if ENERGY_PROFILE
+    energy_profile_end(ENERGY_STAGE_COMPUTE);
+#endif
+#if SWO_TRACE
+    swo_trace_marker(SWO_TRACE_END, SWO_MARKER_COMPUTE);
+#endif
+    if (updated == 0) {
+        return;
+    }
+#if LOAD_SHEDDING
+    load_shed_update();
+#endif
+#if SENSOR_EVENT_CODING
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        if (sensor_registry[channel].event_coded) {
+            event_coding_update((sensor_t)channel, &sensor_buffer[channel], newest_timestamp, SAMPLE_UNIT(channel),
+                                filtered_stats.stats[channel]);
+        }
+    }
+#endif
+    latency_trace_record(LATENCY_STAGE_COMPUTE, compute_start);
+#if STATS_SNAPSHOT
+    stats_snapshot_publish(filtered_stats.stats, newest_timestamp);
+#endif
+    isr_batch_timestamp = newest_timestamp;
+    isr_batch_cycles = newest_cycles;
+    isr_batch_ready = true;
+}
+
+// Function to send the frames of the batch isr_batch_compute computed last
+static void isr_batch_transmit(void) {
+    uint32_t newest_timestamp = isr_batch_timestamp;
+
+    if (!isr_batch_ready) {
+        return;
+    }
+    isr_batch_ready = false;
+#if ANOMALY_GATE
+    if (anomaly_gate_admit((uint16_t)pipeline_config.channel_mask, filtered_stats.stats)) {
+        broadcast_ble(&filtered_stats, newest_timestamp, isr_batch_cycles);
+    }
+#else
+    broadcast_ble(&filtered_stats, newest_timestamp, isr_batch_cycles);
+#endif
+#if STATS_VIEWS
+    if (report_detail()) {
+        send_views(newest_timestamp);
+    }
+#endif
+#if STATS_CORRELATION
+    correlation_frame_t correlation_frame;
+    uint16_t correlation_size = channel_correlation_build(&correlation_frame, newest_timestamp);
+    if (report_detail()) {
+        uart_tx_send((const uint8_t *)&correlation_frame, correlation_size);
+    }
+#endif
+#if CHANNEL_RESAMPLE
+    send_resampled();
+#endif
+#if CRASH_CAPTURE
+    crash_capture_trace(CRASH_EVENT_REPORT, uart_tx_free());
+#endif
+}
+#endif
+
+#if TT_EXECUTIVE
+// Function to run the sampling sweep of a frame, the batch it completes is
+// closed by the compute slot the schedule gives that frame
+static void tt_slot_acquire(uint32_t timestamp) {
+    (void)isr_tick_acquire(timestamp);
+}
+
+// Function to close the batch and run its statistics in its slot, the frame
+// count of the executive is the only one that says where a batch ends
+static void tt_slot_compute(uint32_t timestamp) {
+    (void)timestamp;
+    isr_batch_close();
+    isr_batch_compute();
+}
+
+// Function to queue the report of the batch in its slot
+static void tt_slot_transmit(uint32_t timestamp) {
+    (void)timestamp;
+    isr_batch_transmit();
+}
+#endif
+
+#if CHANNEL_RESAMPLE
+// Function to send the aligned rows that became ready, what does not fit
+// in the queue waits in the rings for the next batch
+static void send_resampled(void) {
+    resample_frame_t frame;
+    uint16_t size;
+
+    while (uart_tx_free() > 0 && report_detail() &&
+           (size = channel_resample_build(&frame, (uint16_t)pipeline_config.channel_mask)) != 0) {
+        uart_tx_send((const uint8_t *)&frame, size);
+    }
+}
+#endif
+
+#if STATS_VIEWS || STATS_CORRELATION || CHANNEL_RESAMPLE
+// Function to check whether the frames beyond the statistics go out now,
+// the first to be shed under load
+static bool report_detail(void) {
+#if LOAD_SHEDDING
+    return load_shed_admit(LOAD_SHED_CLASS_DETAIL);
+#else
+    return true;
+#endif
+}
+#endif
+
+// Function to read the sampling ticks of the batch in progress
+static uint32_t report_samples_per_batch(void) {
+#if ADAPTIVE_RATE
+    return adaptive_rate_samples_per_batch();
+#else
+    return pipeline_config.samples_per_batch;
+#endif
+}
+
+// Function to read the window the next statistics cover
+static uint32_t report_window_size(void) {
+#if ADAPTIVE_RATE
+    return adaptive_rate_window_size();
+#else
+    return pipeline_config.window_size;
+#endif
+}
+
+#if !STATS_ENGINE
+// Function to tell whether the statistics of a channel window need to be
+// computed for this report: something reads the channel and the window is
+// not the one of its last computation. With STATS_LAZY off always true.
+static bool channel_window_moved(uint32_t channel, uint32_t count) {
+#if STATS_LAZY
+    uint32_t first = sensor_buffer[channel].cursors[SAMPLE_READER_STATS];
+    uint32_t read = pipeline_config.channel_mask;
+
+#if FLASH_LOG
+    // Every channel goes into the log
+    read = SENSOR_SIMULATION ? read : UINT32_MAX;
+#endif
+#if STATS_SNAPSHOT
+    read = UINT32_MAX;
+#endif
+    if ((read & (1UL << channel)) == 0) {
+        return false;
+    }
+    // No sample came in or left, whatever the reports in between
+    if ((computed_reports & (1UL << channel)) != 0 && computed_first[channel] == first &&
+        computed_count[channel] == count) {
+        return false;
+    }
+    computed_first[channel] = first;
+    computed_count[channel] = count;
+    computed_reports |= 1UL << channel;
+    return true;
+#else
+    (void)channel;
+    (void)count;
+    return true;
+#endif
+}
+#endif
+
+#if STATS_STREAMING
+// Function to slide the window of one channel over its new samples.
+// Every sample is added once and removed once, nothing rescans the window.
+// A hopping or tumbling window writes its statistics into out as it closes.
+static uint32_t channel_window_update(sensor_t channel, uint32_t window_size, float *out) {
+    sample_ring_t *ring = &sensor_buffer[channel];
+    window_stats_t *stats = &window_stats[channel];
+    uint32_t count = window_count[channel];
+    uint32_t available = sample_ring_count(ring, SAMPLE_READER_STATS);
+
+    // The window was made smaller, let the oldest samples go first
+    for (; count > window_size; --count, --available) {
+#if STATS_VIEWS
+        channel_views_shrink(channel, count);
+#endif
+        channel_window_remove_oldest(channel, count);
+    }
+
+    for (; count < available; ++count) {
+        sample_value_t value = sample_ring_value(ring, SAMPLE_READER_STATS, count);
+        window_stats_add(stats, value);
+#if STATS_TIME_WEIGHTED
+        // The sample before it held until now
+        if (count > 0) {
+            window_stats_hold(stats, sample_ring_value(ring, SAMPLE_READER_STATS, count - 1),
+                              sample_hold_ms(ring, count - 1));
+        }
+#endif
+#if STATS_VIEWS
+        // Before the window lets go of its oldest sample, which a view may still need
+        channel_views_add(channel, count, value, window_size);
+#endif
+
+        if (count == window_size) {
+            // Oldest sample leaves the window, hand it back to the producer
+            channel_window_remove_oldest(channel, count + 1);
+            --count;
+            --available;
+        }
+#if STATS_WINDOW_MS
+        // Samples that are too old leave as well, however few the window holds
+        uint32_t newest = sample_ring_timestamp(ring, SAMPLE_READER_STATS, count);
+        while (count > 0 &&
+               (int32_t)(newest - sample_ring_timestamp(ring, SAMPLE_READER_STATS, 0)) >= (int32_t)STATS_WINDOW_MS) {
+#if STATS_VIEWS
+            channel_views_shrink(channel, count + 1);
+#endif
+            channel_window_remove_oldest(channel, count + 1);
+            --count;
+            --available;
+        }
+#endif
+#if STATS_WINDOW_MODE != STATS_WINDOW_SLIDING
+        // The window closes every hop samples, its statistics stand until the next one
+#if STATS_WINDOW_MODE == STATS_WINDOW_TUMBLING
+        uint32_t hop = window_size;
+#else
+        uint32_t hop = STATS_WINDOW_HOP;
+#endif
+        if (++window_hop[channel] >= hop) {
+            window_hop[channel] = 0;
+            window_fields(stats, channel, 0, count + 1, out);
+        }
+#endif
+    }
+
+#if STATS_WINDOW_MODE == STATS_WINDOW_SLIDING
+    (void)out;
+#endif
+    window_count[channel] = count;
+    return count;
+}
+
+// Function to let the oldest sample of a channel window go back to the
+// producer, the window holding held samples
+static void channel_window_remove_oldest(sensor_t channel, uint32_t held) {
+    sample_ring_t *ring = &sensor_buffer[channel];
+    sample_value_t oldest = sample_ring_value(ring, SAMPLE_READER_STATS, 0);
+
+#if STATS_TIME_WEIGHTED
+    // Only held once the sample after it came in
+    if (held > 1) {
+        window_stats_release(&window_stats[channel], oldest, sample_hold_ms(ring, 0));
+    }
+#else
+    (void)held;
+#endif
+    window_stats_remove_oldest(&window_stats[channel], oldest);
+    sample_ring_discard(ring, SAMPLE_READER_STATS, 1);
+}
+
+#if STATS_TIME_WEIGHTED
+// Function to read how long the window sample at index held, until the one
+// after it. Samples out of time order hold for 0.
+static float sample_hold_ms(const sample_ring_t *ring, uint32_t index) {
+    int32_t held = (int32_t)(sample_ring_timestamp(ring, SAMPLE_READER_STATS, index + 1) -
+                             sample_ring_timestamp(ring, SAMPLE_READER_STATS, index));
+
+    if (held <= 0) {
+        return 0.0f;
+    }
+#if STATS_TIME_WEIGHT_HOLD_MS
+    if (held > (int32_t)STATS_TIME_WEIGHT_HOLD_MS) {
+        held = (int32_t)STATS_TIME_WEIGHT_HOLD_MS;
+    }
+#endif
+    return (float)held;
+}
+#endif
+
+// Function to bring every channel window up to date and read the streaming statistics
+static uint32_t update_statistics(filtered_data_for_ble *filtered_data) {
+#if STATS_ARENA
+    // A resized window is carved again before it slides
+    uint32_t configured = pipeline_config.window_size;
+    if (configured != layout_window) {
+        windows_layout(configured);
+    }
+#endif
+    uint32_t window_size = report_window_size();
+    uint32_t largest = 0;
+
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        const window_stats_t *stats = &window_stats[channel];
+        float *out = filtered_data->stats[channel];
+        uint32_t count = channel_window_update(channel, window_size, out);
+        bool moved = channel_window_moved(channel, count);
+
+        largest = count > largest ? count : largest;
+#if STATS_WINDOW_MODE == STATS_WINDOW_SLIDING
+        if (moved) {
+            window_fields(stats, (sensor_t)channel, 0, count, out);
+        }
+#else
+        // Written as the windows closed
+        (void)stats;
+        (void)moved;
+#endif
+#if STATS_QUANTILES
+        channel_quantiles(channel, out);
+#endif
+#if STATS_TREND
+        out[STATS_FIELD_TREND] = sensor_trend[channel].value;
+#endif
+#if STATS_VIEWS
+        channel_views_fields((sensor_t)channel, count, moved, out);
+#endif
+    }
+    return largest;
+}
+
+#if STATS_ARENA
+// Function to carve the window arrays for a window size and start every
+// window over. They fill again from the samples their rings still hold.
+static void windows_layout(uint32_t window_size) {
+    window_stats_t *views = NULL;
+
+#if STATS_VIEWS
+    views = &view_stats[0][0];
+#endif
+    if (!stats_arena_layout(window_stats, views, window_size)) {
+        // The setters refuse a window that does not fit, only the default can
+        Error_Handler();
+    }
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        window_stats_reset(&window_stats[channel]);
+        window_count[channel] = 0;
+#if STATS_WINDOW_MODE != STATS_WINDOW_SLIDING
+        window_hop[channel] = 0;
+#endif
+#if STATS_VIEWS
+        for (uint32_t view = 0; view < VIEW_COUNT; ++view) {
+            window_stats_reset(&view_stats[view][channel]);
+            view_count[view][channel] = 0;
+        }
+#endif
+    }
+    layout_window = window_size;
+}
+#endif
+
+// Function to read the streaming statistics of a window, the count samples
+// of the ring from offset on
+static void window_fields(const window_stats_t *stats, sensor_t channel, uint32_t offset, uint32_t count, float *out) {
+    float unit = SAMPLE_UNIT(channel);
+
+    out[STATS_FIELD_STD_DEV] = window_stats_std_dev(stats) * unit;
+    out[STATS_FIELD_MAX] = extremum_window_max(&stats->extremum) * unit;
+    out[STATS_FIELD_MIN] = extremum_window_min(&stats->extremum) * unit;
+#if STATS_TIME_WEIGHTED
+    out[STATS_FIELD_TIME_MEAN] = window_stats_time_mean(stats) * unit;
+    out[STATS_FIELD_TIME_STD_DEV] = window_stats_time_std_dev(stats) * unit;
+#endif
+#if STATS_HISTOGRAM_MEDIAN
+    // The histogram refines its bin over the window codes in the ring
+    const sample_value_t *first, *second;
+    uint32_t first_count, second_count;
+    sample_ring_span(&sensor_buffer[channel], SAMPLE_READER_STATS, offset, count, &first, &first_count, &second,
+                     &second_count);
+    out[STATS_FIELD_MEDIAN] =
+        order_histogram_percentile(&stats->histogram, 0.5f, first, first_count, second, second_count) * unit;
+#else
+    (void)offset;
+    (void)count;
+    out[STATS_FIELD_MEDIAN] = median_window_median(&stats->median) * unit;
+#endif
+}
+
+#if STATS_VIEWS
+// Function to slide the views of a channel over the sample the window just
+// added at offset. A full view lets go of the sample length before it, which
+// the window still holds.
+static void channel_views_add(sensor_t channel, uint32_t offset, sample_value_t value, uint32_t window_size) {
+    const sample_ring_t *ring = &sensor_buffer[channel];
+
+    for (uint32_t view = 0; view < VIEW_COUNT; ++view) {
+        window_stats_t *stats = &view_stats[view][channel];
+        uint32_t length = view_length[view] < window_size ? view_length[view] : window_size;
+
+        window_stats_add(stats, value);
+#if STATS_TIME_WEIGHTED
+        if (view_count[view][channel] > 0) {
+            window_stats_hold(stats, sample_ring_value(ring, SAMPLE_READER_STATS, offset - 1),
+                              sample_hold_ms(ring, offset - 1));
+        }
+#endif
+        if (view_count[view][channel] == length) {
+#if STATS_TIME_WEIGHTED
+            window_stats_release(stats, sample_ring_value(ring, SAMPLE_READER_STATS, offset - length),
+                                 sample_hold_ms(ring, offset - length));
+#endif
+            window_stats_remove_oldest(stats, sample_ring_value(ring, SAMPLE_READER_STATS, offset - length));
+        } else {
+            view_count[view][channel]++;
+        }
+    }
+}
+
+// Function to take the oldest sample of the window out of the views that
+// span the whole window, before the window itself lets go of it
+static void channel_views_shrink(sensor_t channel, uint32_t count) {
+    const sample_ring_t *ring = &sensor_buffer[channel];
+
+    for (uint32_t view = 0; view < VIEW_COUNT; ++view) {
+        if (view_count[view][channel] == count) {
+#if STATS_TIME_WEIGHTED
+            if (count > 1) {
+                window_stats_release(&view_stats[view][channel], sample_ring_value(ring, SAMPLE_READER_STATS, 0),
+                                     sample_hold_ms(ring, 0));
+            }
+#endif
+            window_stats_remove_oldest(&view_stats[view][channel], sample_ring_value(ring, SAMPLE_READER_STATS, 0));
+            view_count[view][channel]--;
+        }
+    }
+}
+
+// Function to read the statistics of the views of a channel whose window
+// holds count samples. The quantiles and the trend are those of the window.
+static void channel_views_fields(sensor_t channel, uint32_t count, bool moved, const float *out) {
+    for (uint32_t view = 0; view < VIEW_COUNT; ++view) {
+        float *fields = view_fields[view][channel];
+        uint32_t in_view = view_count[view][channel];
+
+        if (moved && in_view > 0) {
+            window_fields(&view_stats[view][channel], channel, count - in_view, in_view, fields);
+        }
+#if STATS_TIME_WEIGHTED
+        uint32_t first_shared = STATS_FIELD_TIME_STD_DEV + 1;
+#else
+        uint32_t first_shared = STATS_FIELD_MEDIAN + 1;
+#endif
+        for (uint32_t field = first_shared; field < STATS_FIELD_COUNT; ++field) {
+            fields[field] = out[field];
+        }
+    }
+}
+
+// Function to send one frame per view with the statistics of the batch,
+// best effort behind the frame of the window
+static void send_views(uint32_t timestamp) {
+    static uint16_t sequence[VIEW_COUNT];
+    uint32_t window_size = report_window_size();
+
+    for (uint32_t view = 0; view < VIEW_COUNT; ++view) {
+        stats_view_frame_t frame;
+
+        frame.type = STATS_VIEW_FRAME_TYPE;
+        frame.view = (uint8_t)view;
+        frame.window = (uint16_t)(view_length[view] < window_size ? view_length[view] : window_size);
+        uint16_t size = stats_frame_encode(&frame.stats, sequence[view]++, timestamp,
+                                           (uint16_t)pipeline_config.channel_mask, view_fields[view]);
+        uart_tx_send((const uint8_t *)&frame, (uint16_t)(offsetof(stats_view_frame_t, stats) + size));
+    }
+}
+#endif
+#elif STATS_ENGINE
+// Function to recompute the statistics of every channel window with the
+// engine instance of stats_engine.cpp, only its features are computed
+static uint32_t update_statistics(filtered_data_for_ble *filtered_data) {
+    uint32_t largest = stats_engine_update(sensor_buffer, report_window_size(), filtered_data->stats);
+
+#if STATS_QUANTILES || STATS_TREND
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+#if STATS_QUANTILES
+        channel_quantiles(channel, filtered_data->stats[channel]);
+#endif
+#if STATS_TREND
+        filtered_data->stats[channel][STATS_FIELD_TREND] = sensor_trend[channel].value;
+#endif
+    }
+#endif
+    return largest;
+}
+#else
+// Function to run the fused kernel over the window of one channel in place.
+// Only the median still needs a copy because the selection reorders its input.
+static uint32_t channel_statistics(sensor_t channel, uint32_t window_size, float *out) {
+    sample_ring_t *ring = &sensor_buffer[channel];
+    const sample_value_t *first, *second;
+    uint32_t first_count, second_count;
+
+    // Hand samples older than the window back to the producer
+    uint32_t count = sample_ring_count(ring, SAMPLE_READER_STATS);
+    if (count > window_size) {
+        sample_ring_discard(ring, SAMPLE_READER_STATS, count - window_size);
+        count = window_size;
+    }
+    if (count == 0 || !channel_window_moved(channel, count)) {
+        return count;
+    }
+
+    sample_ring_span(ring, SAMPLE_READER_STATS, 0, count, &first, &first_count, &second, &second_count);
+#if DMA_COPY
+    // Copied by the DMA while the kernel reads the same samples
+    dma_copy_submit(median_scratch, first, first_count * sizeof(sample_value_t));
+    dma_copy_submit(&median_scratch[first_count], second, second_count * sizeof(sample_value_t));
+#else
+    memcpy(median_scratch, first, first_count * sizeof(sample_value_t));
+    memcpy(&median_scratch[first_count], second, second_count * sizeof(sample_value_t));
+#endif
+#if STATS_FIXED_POINT
+    // Integer sums over the codes, float only for the results
+    batch_stats_q15_t stats;
+    float unit = SAMPLE_UNIT(channel);
+    batch_stats_q15_reset(&stats);
+    batch_stats_q15_accumulate(&stats, first, first_count);
+    batch_stats_q15_accumulate(&stats, second, second_count);
+    out[STATS_FIELD_STD_DEV] = batch_stats_q15_std_dev(&stats) * unit;
+    out[STATS_FIELD_MAX] = (float)stats.max * unit;
+    out[STATS_FIELD_MIN] = (float)stats.min * unit;
+#if DMA_COPY
+    dma_copy_wait();
+#endif
+    out[STATS_FIELD_MEDIAN] = calculate_median_q15(median_scratch, count) * unit;
+#else
+    batch_stats_t stats;
+    batch_stats_reset(&stats);
+    batch_stats_accumulate(&stats, first, first_count);
+    batch_stats_accumulate(&stats, second, second_count);
+    out[STATS_FIELD_STD_DEV] = batch_stats_std_dev(&stats);
+    out[STATS_FIELD_MAX] = stats.max;
+    out[STATS_FIELD_MIN] = stats.min;
+#if DMA_COPY
+    dma_copy_wait();
+#endif
+    out[STATS_FIELD_MEDIAN] = calculate_median(median_scratch, count);
+#endif
+    return count;
 }
 
-// Function to calculate standard deviation
-float calculate_std_dev(float data[], uint32_t count) {
-    float sum = 0.0, mean, std_dev = 0.0;
+// Function to recompute the statistics of every channel window with the fused
+// kernel. Each ring stores its values contiguously, so the kernel reads the
+// samples where the producer wrote them.
+static uint32_t update_statistics(filtered_data_for_ble *filtered_data) {
+    uint32_t window_size = report_window_size();
+    uint32_t largest = 0;
 
-    // Calculate sum
-    for(uint32_t i = 0; i < count; ++i) {
-        sum += data[i];
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        uint32_t count = channel_statistics(channel, window_size, filtered_data->stats[channel]);
+        largest = count > largest ? count : largest;
+#if STATS_QUANTILES
+        channel_quantiles(channel, filtered_data->stats[channel]);
+#endif
+#if STATS_TREND
+        filtered_data->stats[channel][STATS_FIELD_TREND] = sensor_trend[channel].value;
+#endif
     }
+    return largest;
+}
+#endif
 
-    // Calculate mean
-    mean = sum / count;
+#if STATS_QUANTILES
+// Function to hand the quantiles of the finished batch to the consumer and
+// start the estimates of the next one. A channel without samples in the
+// batch keeps its previous quantiles.
+static void publish_quantiles(void) {
+    uint32_t slot = published_quantile_slot ^ 1U;
 
-    // Calculate standard deviation
-    for(uint32_t i = 0; i < count; ++i) {
-        std_dev += pow(data[i] - mean, 2);
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        for (uint32_t quantile = 0; quantile < QUANTILE_COUNT; ++quantile) {
+            quantile_p2_t *estimator = &batch_quantiles[channel][quantile];
+            published_quantiles[slot][channel][quantile] =
+                estimator->count > 0 ? quantile_p2_value(estimator)
+                                     : published_quantiles[slot ^ 1U][channel][quantile];
+            quantile_p2_init(estimator, quantile_p[quantile]);
+        }
     }
+    published_quantile_slot = slot;
+}
 
-    return sqrt(std_dev / count);
+// Function to copy the published quantiles of a channel into its statistics
+static void channel_quantiles(sensor_t channel, float *out) {
+    const float *published = published_quantiles[published_quantile_slot][channel];
+
+    out[STATS_FIELD_QUANTILE_UPPER] = published[0];
+    out[STATS_FIELD_QUANTILE_TAIL] = published[1];
 }
+#endif
 
-// Function to find maximum value
-float calculate_max(float data[], uint32_t count) {
-    float max = data[0];
-    for(uint32_t i = 1; i < count; ++i) {
-        if(data[i] > max) {
-            max = data[i];
+// Function to publish the samples of a tick, the I2C rows from the reads of due_mask
+static void sensor_publish_tick(uint32_t tick, uint32_t timestamp, uint32_t due_mask, uint32_t shed_mask) {
+    uint32_t acquired_cycles = cycle_counter_now();
+#if SENSOR_DERIVED
+    derived_fresh = 0;
+#endif
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        const sensor_driver_t *driver = &sensor_registry[channel];
+        // A FIFO row is due whenever it was drained, not on a tick count
+        bool fifo = driver->fifo_depth > 1 && sensor_source(driver) == SENSOR_SOURCE_I2C;
+        if ((!fifo && tick % sensor_read_divider(driver) != 0) || (shed_mask & (1U << channel)) != 0) {
+            continue;
         }
+        float value;
+        switch (sensor_source(driver)) {
+        case SENSOR_SOURCE_ADC:
+            value = adc_acquisition_sample(channel);
+            break;
+#if CAPTURE_ACQUISITION
+        case SENSOR_SOURCE_CAPTURE:
+            value = capture_acquisition_sample((sensor_t)channel);
+            break;
+#endif
+        case SENSOR_SOURCE_HOOK:
+            value = driver->sample();
+            break;
+        case SENSOR_SOURCE_SIM:
+            // Already in the sensor unit, not calibrated again
+            value = sensor_sim_sample((sensor_t)channel);
+            break;
+#if SENSOR_DERIVED
+        case SENSOR_SOURCE_DERIVED:
+            // Its inputs come first in the loop, a failed read of one leaves no sample
+            if (!sensor_derive(channel, &value, &timestamp)) {
+                continue;
+            }
+            break;
+#endif
+        default: {
+            // A shared row converts the bytes its parent read, there are none when it was shed
+            uint32_t read = sensor_source(driver) == SENSOR_SOURCE_SHARED ? driver->parent : channel;
+            if ((due_mask & (1U << read)) == 0) {
+                continue;
+            }
+            // A NACK or a timeout left no data, the tick has no sample of the sensor
+            if (sensor_reads[sensor_read_index[read]].status != HAL_OK) {
+                sensor_read_errors[channel]++;
+#if SENSOR_HEALTH
+                sensor_health_record((sensor_t)channel,
+                                     sensor_reads[sensor_read_index[read]].status == HAL_TIMEOUT ?
+                                     SENSOR_QUALITY_TIMEOUT : SENSOR_QUALITY_NACK);
+#endif
+                continue;
+            }
+            // The reads of a FIFO drain are oldest first, one read interval apart up to this tick
+            uint32_t reads = sensor_fifo_reads(driver);
+            uint32_t interval_ms = sensor_read_divider(driver) * pipeline_config.sample_period_ms;
+#if SENSOR_FIFO
+            // A drain of plain words is converted in one pass, two words per byte swap
+            float words[SENSOR_FIFO_DEPTH_MAX];
+            bool block = reads > 1 && driver->raw_size == 2 && driver->convert == sensor_convert_be16 &&
+                         driver->check == NULL;
+            if (block) {
+                sensor_convert_be16_block(sensor_raw[read], words, reads);
+            }
+#endif
+            for (uint32_t index = 0; index < reads; ++index) {
+                const uint8_t *raw = &sensor_raw[read][index * driver->raw_size];
+                // A bad CRC drops the read like a NACK
+                if (driver->check != NULL && !driver->check(raw)) {
+                    sensor_read_errors[channel]++;
+#if SENSOR_HEALTH
+                    sensor_health_record((sensor_t)channel, SENSOR_QUALITY_CRC);
+#endif
+                    continue;
+                }
+#if SENSOR_FIFO
+                value = block ? words[index] : driver->convert(raw);
+#else
+                value = driver->convert(raw);
+#endif
+                sensor_publish(channel, value, timestamp - (reads - 1U - index) * interval_ms, acquired_cycles);
+            }
+            continue;
+        }
+        }
+        sensor_publish(channel, value, timestamp, acquired_cycles);
     }
-    return max;
+#if SAMPLE_MAILBOX
+    // Once the whole tick is in, the readers never see half of it
+    sample_mailbox_publish(timestamp);
+#endif
 }
 
-// Function to find minimum value
-float calculate_min(float data[], uint32_t count) {
-    float min = data[0];
-    for(uint32_t i = 1; i < count; ++i) {
-        if(data[i] < min) {
-            min = data[i];
+// Function to take one read of a channel through the filters into its ring,
+// a full ring drops the sample and counts the overrun
+static void sensor_publish(uint32_t channel, float value, uint32_t timestamp, uint32_t acquired_cycles) {
+    const sensor_driver_t *driver = &sensor_registry[channel];
+
+    if (driver->calibrate != NULL && sensor_source(driver) != SENSOR_SOURCE_SIM) {
+        value = driver->calibrate(value);
+    }
+#if OUTLIER_FILTER
+    // Before the decimation filter, which would spread a bad read over its taps
+    if (!outlier_filter_accept(&sensor_outlier[channel], value)) {
+#if SENSOR_HEALTH
+        sensor_health_record((sensor_t)channel, SENSOR_QUALITY_OUTLIER);
+#endif
+        return;
+    }
+#endif
+#if SENSOR_HEALTH
+    // Every read that made it this far is good, the decimated ones too
+    sensor_health_record((sensor_t)channel, SENSOR_QUALITY_OK);
+#endif
+#if SENSOR_DERIVED
+    // The rows derived from this channel take the read itself, not its decimated value
+    derived_inputs[channel] = value;
+    derived_times[channel] = timestamp;
+    derived_fresh |= 1UL << channel;
+#endif
+#if TRIGGER_ENGINE
+    // Every read, ahead of the decimation filter and its delay
+    trigger_engine_sample((sensor_t)channel, value, timestamp);
+#endif
+#if SENSOR_OCCUPANCY
+    // Every read as well, a change of state is reported without waiting for the batch
+    if (occupancy_fusion_sample((sensor_t)channel, value, timestamp)) {
+        task_signal_set(consumer_task_handle, TASK_SIGNAL_OCCUPANCY);
+    }
+#endif
+#if SENSOR_DECIMATION
+    // Only every oversample-th read leaves the filter, stamped with its newest read
+    if (!sample_decimator_push(&sensor_decimator[channel], value, &value)) {
+        return;
+    }
+#endif
+#if ADAPTIVE_RATE
+    if ((pipeline_config.channel_mask & (1U << channel)) != 0) {
+        adaptive_rate_sample((sensor_t)channel, value);
+    }
+#endif
+    sensor_data_t sensor_data = {
+        .timestamp = timestamp,
+        .acquired_cycles = acquired_cycles,
+        .value = sensor_sample_value(channel, value),
+    };
+#if SENSOR_EVENT_CODING
+    // An unchanged value only extends the run of the last stored sample
+    uint32_t bit = 1UL << channel;
+    bool store = !driver->event_coded || (event_coded_stored & bit) == 0 ||
+                 event_coded_value[channel] != sensor_data.value;
+    if (store && sample_ring_push(&sensor_buffer[channel], &sensor_data)) {
+        event_coded_value[channel] = sensor_data.value;
+        event_coded_stored |= bit;
+    }
+#else
+    sample_ring_push(&sensor_buffer[channel], &sensor_data);
+#endif
+#if SAMPLE_MAILBOX
+    // Stored or not, it is the newest value of the channel
+    sample_mailbox_stage((sensor_t)channel, value);
+#endif
+#if BATCH_WATERMARK
+    // Stored or not: a coded-away sample moves the time-weighted window too, and a full ring
+    // needs the consumer all the more
+    batch_watermark_sample((sensor_t)channel, timestamp);
+#endif
+#if ENERGY_PROFILE
+    energy_profile_sample();
+#endif
+#if STATS_QUANTILES
+    for (uint32_t quantile = 0; quantile < QUANTILE_COUNT; ++quantile) {
+        quantile_p2_add(&batch_quantiles[channel][quantile], value);
+    }
+#endif
+#if STATS_TREND
+    trend_filter_add(&sensor_trend[channel], value);
+#endif
+#if STATS_CORRELATION
+    channel_correlation_sample((sensor_t)channel, value);
+#endif
+#if STATS_ROLLUP
+    stats_rollup_sample((sensor_t)channel, sensor_to_fixed((sensor_t)channel, value), timestamp);
+#endif
+}
+
+#if SENSOR_DERIVED
+// Function to compute a derived row from the reads its inputs published just
+// before it, false when one of them has none. The inputs of one read share
+// its time.
+static bool sensor_derive(uint32_t channel, float *value, uint32_t *timestamp) {
+    const sensor_driver_t *driver = &sensor_registry[channel];
+
+    if ((derived_fresh & driver->input_mask) != driver->input_mask) {
+        return false;
+    }
+    *value = driver->derive(derived_inputs);
+    *timestamp = derived_times[__builtin_ctz(driver->input_mask)];
+    return true;
+}
+#endif
+
+// Function to write the setup command of every I2C sensor that has one, in
+// one sequence at the start of the producer. A sensor that does not answer
+// counts a read error and is read as it is.
+static void sensor_setup(void) {
+    uint32_t count = 0;
+
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        const sensor_driver_t *driver = &sensor_registry[channel];
+        if (sensor_source(driver) != SENSOR_SOURCE_I2C || driver->setup == NULL) {
+            continue;
+        }
+        i2c_transaction_t *transaction = &sensor_reads[count];
+        transaction->device_address = driver->address;
+        transaction->bus = driver->bus;
+        transaction->write = 1;
+        transaction->data = (uint8_t *)driver->setup;
+        transaction->size = driver->setup_size;
+        sensor_read_channel[count++] = (uint8_t)channel;
+    }
+    if (count == 0) {
+        return;
+    }
+    i2c_arbiter_run(sensor_reads, count, count * I2C_ACQUISITION_TIMEOUT_MS, I2C_ARBITER_BACKGROUND,
+                    xTaskGetTickCount());
+    for (uint32_t index = 0; index < count; ++index) {
+        if (sensor_reads[index].status != HAL_OK) {
+            sensor_read_errors[sensor_read_channel[index]]++;
+#if SENSOR_HEALTH
+            sensor_health_record((sensor_t)sensor_read_channel[index], sensor_reads[index].status == HAL_TIMEOUT ?
+                                 SENSOR_QUALITY_TIMEOUT : SENSOR_QUALITY_NACK);
+#endif
+        }
+    }
+}
+
+// Function to add the trigger write or the read of a channel to sensor_reads
+static void sensor_read_queue(uint32_t index, uint32_t channel, bool trigger) {
+    const sensor_driver_t *driver = &sensor_registry[channel];
+    i2c_transaction_t *transaction = &sensor_reads[index];
+
+    transaction->device_address = driver->address;
+    transaction->bus = driver->bus;
+    transaction->write = trigger;
+    // The HAL only reads a buffer it transmits, the table stays in flash
+    transaction->data = trigger ? (uint8_t *)driver->trigger : sensor_raw[channel];
+    transaction->size = trigger ? driver->trigger_size : (uint16_t)(driver->raw_size * sensor_fifo_reads(driver));
+    sensor_read_channel[index] = (uint8_t)channel;
+    sensor_read_index[channel] = (uint8_t)index;
+}
+
+// Function to find how long the slowest of the triggered conversions still runs,
+// each one counts from the end of its own trigger write
+static uint32_t sensor_conversion_wait_ms(uint32_t first, uint32_t count) {
+    uint32_t cycles_per_ms = SystemCoreClock / 1000U;
+    uint32_t wait_ms = 0;
+
+    for (uint32_t index = first; index < first + count; ++index) {
+        if (sensor_reads[index].status != HAL_OK) {
+            continue;
+        }
+        uint32_t conversion_ms = sensor_registry[sensor_read_channel[index]].conversion_ms;
+        uint32_t elapsed_ms = cycle_counter_since(sensor_reads[index].done_cycles) / cycles_per_ms;
+        if (elapsed_ms < conversion_ms && conversion_ms - elapsed_ms > wait_ms) {
+            wait_ms = conversion_ms - elapsed_ms;
+        }
+    }
+    return wait_ms;
+}
+
+#if DEADLINE_MONITOR || SENSOR_HEALTH
+// Function to hand the bus time of every read of a sequence to the deadline
+// monitor and the health table. The transactions of a bus ran in list order,
+// each one from the end of the one before, so a read also pays for the
+// triggers queued ahead of it.
+static void sensor_read_times(uint32_t first, uint32_t count, uint32_t start_cycles) {
+    uint32_t bus_cycles[I2C_BUS_COUNT];
+
+    for (uint32_t bus = 0; bus < I2C_BUS_COUNT; ++bus) {
+        bus_cycles[bus] = start_cycles;
+    }
+    for (uint32_t index = first; index < first + count; ++index) {
+        const i2c_transaction_t *transaction = &sensor_reads[index];
+        uint32_t cycles = transaction->done_cycles - bus_cycles[transaction->bus];
+#if DEADLINE_MONITOR
+        if (!transaction->write) {
+            deadline_monitor_read((sensor_t)sensor_read_channel[index], cycles);
+        }
+#endif
+#if SENSOR_HEALTH
+        // The latency of a good read, a failed one already counts as a failure
+        if (!transaction->write && transaction->status == HAL_OK) {
+            sensor_health_latency((sensor_t)sensor_read_channel[index], cycles);
         }
+#endif
+        bus_cycles[transaction->bus] = transaction->done_cycles;
     }
-    return min;
 }
+#endif
 
-// Function to find median value
-float calculate_median(float data[], uint32_t count) {
-    float temp;
-    // Sort the data in ascending order
-    for(uint32_t i = 0; i < count - 1; ++i) {
-        for(uint32_t j = i + 1; j < count; ++j) {
-            if(data[i] > data[j]) {
-                temp = data[i];
-                data[i] = data[j];
-                data[j] = temp;
+#if SENSOR_DRDY
+// Function to read the data-ready rows whose line rose, in one sequence, and
+// publish each sample with the time of its edge. Runs between the ticks, the
+// tick path never reads these rows.
+static void sensor_drdy_read(void) {
+    uint32_t edge_time[SENSOR_COUNT];
+    uint32_t ready = sensor_drdy_take(edge_time);
+#if DEADLINE_MONITOR
+    ready &= ~deadline_monitor_shed_mask();
+#endif
+    uint32_t count = 0;
+
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        if ((ready & (1UL << channel)) == 0) {
+            continue;
+        }
+#if SENSOR_BREAKER
+        if (!sensor_breaker_allow((sensor_t)channel)) {
+            ready &= ~(1UL << channel);
+            continue;
+        }
+#endif
+        sensor_read_queue(count++, channel, false);
+    }
+    if (count == 0) {
+        return;
+    }
+#if DEADLINE_MONITOR || SENSOR_HEALTH
+    uint32_t reads_cycles = cycle_counter_now();
+#endif
+    // Same class as the reads of the tick, due before the next one
+    HAL_StatusTypeDef reads_status =
+        i2c_arbiter_run(sensor_reads, count, count * I2C_ACQUISITION_TIMEOUT_MS, I2C_ARBITER_SAMPLING,
+                        xTaskGetTickCount() + pdMS_TO_TICKS(pipeline_config.sample_period_ms));
+#if CRASH_CAPTURE
+    crash_capture_trace(CRASH_EVENT_READS, ((uint32_t)reads_status << 8) | count);
+#else
+    (void)reads_status;
+#endif
+#if DEADLINE_MONITOR || SENSOR_HEALTH
+    sensor_read_times(0, count, reads_cycles);
+#endif
+
+    // The read rows, the shared rows that convert their bytes and the rows derived from them
+    uint32_t acquired_cycles = cycle_counter_now();
+#if SENSOR_DERIVED
+    derived_fresh = 0;
+#endif
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        const sensor_driver_t *driver = &sensor_registry[channel];
+#if SENSOR_DERIVED
+        float value;
+        uint32_t time;
+        if (sensor_source(driver) == SENSOR_SOURCE_DERIVED) {
+            if (sensor_derive(channel, &value, &time)) {
+                sensor_publish(channel, value, time, acquired_cycles);
+            }
+            continue;
+        }
+#endif
+        uint32_t read = sensor_source(driver) == SENSOR_SOURCE_SHARED ? driver->parent : channel;
+        if ((sensor_source(driver) != SENSOR_SOURCE_I2C && sensor_source(driver) != SENSOR_SOURCE_SHARED) ||
+            (ready & (1UL << read)) == 0) {
+            continue;
+        }
+        HAL_StatusTypeDef status = sensor_reads[sensor_read_index[read]].status;
+#if SENSOR_BREAKER
+        if (read == channel) {
+            sensor_breaker_result((sensor_t)channel, status == HAL_OK);
+        }
+#endif
+        const uint8_t *raw = sensor_raw[read];
+        if (status != HAL_OK || (driver->check != NULL && !driver->check(raw))) {
+            sensor_read_errors[channel]++;
+#if SENSOR_HEALTH
+            sensor_health_record((sensor_t)channel, status == HAL_OK ? SENSOR_QUALITY_CRC :
+                                 status == HAL_TIMEOUT ? SENSOR_QUALITY_TIMEOUT : SENSOR_QUALITY_NACK);
+#endif
+            continue;
+        }
+        sensor_publish(channel, driver->convert(raw), edge_time[read], acquired_cycles);
+    }
+    // A line still up converted again during the read and raises no new edge
+    sensor_drdy_rearm();
+}
+#endif
+
+// Function to check the driver table once at boot, a bad row would read past
+// its DMA buffer or call a null function
+static void check_sensor_registry(void) {
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        const sensor_driver_t *driver = &sensor_registry[channel];
+        bool valid;
+        switch (driver->source) {
+        case SENSOR_SOURCE_I2C:
+            // A FIFO row selects its FIFO with the trigger and reads right after it, a data-ready
+            // row converts on its own and is read with no trigger
+            valid = driver->raw_size > 0 && driver->raw_size <= SENSOR_RAW_MAX && driver->convert != NULL &&
+                    driver->bus < I2C_BUS_COUNT && (driver->fifo_depth <= 1 || SENSOR_FIFO) &&
+                    driver->fifo_depth <= SENSOR_FIFO_DEPTH_MAX && (driver->setup == NULL || driver->setup_size > 0) &&
+                    (driver->trigger == NULL ||
+                     (driver->trigger_size > 0 && (driver->conversion_ms > 0 || driver->fifo_depth > 1))) &&
+                    (driver->drdy_line == 0 || (driver->drdy_line >= SENSOR_DRDY_LINE_FIRST &&
+                                                driver->drdy_line <= SENSOR_DRDY_LINE_LAST && driver->trigger == NULL));
+            break;
+        case SENSOR_SOURCE_ADC:
+            valid = ADC_ACQUISITION && driver->adc_channel <= ADC_ACQUISITION_INPUT_MAX;
+            break;
+        case SENSOR_SOURCE_CAPTURE:
+            valid = CAPTURE_ACQUISITION;
+            break;
+        case SENSOR_SOURCE_HOOK:
+            valid = driver->sample != NULL;
+            break;
+        case SENSOR_SOURCE_DERIVED:
+            // Computed after its inputs, at the ticks they are read, from one read each
+            valid = SENSOR_DERIVED && driver->derive != NULL && driver->input_mask != 0 &&
+                    (driver->input_mask >> channel) == 0;
+            for (uint32_t input = 0; valid && input < channel; ++input) {
+                const sensor_driver_t *row = &sensor_registry[input];
+                valid = (driver->input_mask & (1UL << input)) == 0 ||
+                        (row->fifo_depth <= 1 && row->sample_divider == driver->sample_divider &&
+                         row->oversample == driver->oversample);
+            }
+            break;
+        case SENSOR_SOURCE_SHARED:
+            // Read with its parent, so due at the same ticks, one value per read
+            valid = driver->parent < SENSOR_COUNT && driver->convert != NULL &&
+                    sensor_registry[driver->parent].source == SENSOR_SOURCE_I2C &&
+                    sensor_registry[driver->parent].fifo_depth <= 1 &&
+                    driver->sample_divider == sensor_registry[driver->parent].sample_divider &&
+                    driver->oversample == sensor_registry[driver->parent].oversample;
+            break;
+        default:
+            valid = false;
+            break;
+        }
+        // Reads must fall on ticks, so the oversample factor divides the divider. The
+        // decimation filter would turn each step of an event-coded row into a ramp.
+        valid = valid && (!driver->event_coded || driver->oversample == 1);
+        if (!valid || driver->sample_divider == 0 || driver->oversample == 0 ||
+            driver->oversample > SAMPLE_DECIMATOR_FACTOR_MAX || driver->sample_divider % driver->oversample != 0) {
+            Error_Handler();
+        }
+    }
+}
+
+#if FLASH_LOG
+// Function to append the samples each channel ring received since the
+// previous batch, as sensor_to_fixed codes in records of up to
+// FLASH_LOG_SAMPLES_MAX, or as many as FLASH_LOG_COMPRESS packs into one
+// record. The log reader gates the producer, so every sample stays in the
+// ring until it is logged, however small the window.
+static void log_new_samples(void) {
+#if FLASH_LOG_COMPRESS
+    const flash_log_record_t type = FLASH_LOG_RECORD_SAMPLES_PACKED;
+    const uint32_t max = FLASH_LOG_PACKED_MAX;
+    flash_log_packed_t record;
+    int16_t *codes_out = logged_codes;
+#else
+    const flash_log_record_t type = FLASH_LOG_RECORD_SAMPLES;
+    const uint32_t max = FLASH_LOG_SAMPLES_MAX;
+    flash_log_samples_t record;
+    int16_t *codes_out = record.codes;
+#endif
+
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        sample_ring_t *ring = &sensor_buffer[channel];
+        uint32_t count = sample_ring_count(ring, SAMPLE_READER_LOG);
+        uint32_t offset = 0;
+
+#if SENSOR_EVENT_CODING
+        // Its samples are not evenly spaced, each keeps its own time
+        if (sensor_registry[channel].event_coded) {
+            log_channel_events((sensor_t)channel);
+            continue;
+        }
+#endif
+        record.channel = (uint8_t)channel;
+        record.interval_ms = (uint16_t)(sensor_registry[channel].sample_divider * pipeline_config.sample_period_ms);
+        while (offset < count) {
+            uint32_t codes = count - offset < max ? count - offset : max;
+            uint32_t size;
+
+            for (uint32_t i = 0; i < codes; ++i) {
+#if STATS_FIXED_POINT
+                codes_out[i] = sample_ring_value(ring, SAMPLE_READER_LOG, offset + i);
+#else
+                codes_out[i] = sensor_to_fixed((sensor_t)channel,
+                                               sample_ring_value(ring, SAMPLE_READER_LOG, offset + i));
+#endif
+            }
+#if FLASH_LOG_COMPRESS
+            // The codes that do not fit go into the next record
+            codes = sample_codec_encode(logged_codes, codes, record.data, sizeof(record.data), &size);
+            size += offsetof(flash_log_packed_t, data);
+#else
+            size = offsetof(flash_log_samples_t, codes) + codes * sizeof(int16_t);
+#endif
+            record.count = (uint8_t)codes;
+            flash_log_append(type, sample_ring_timestamp(ring, SAMPLE_READER_LOG, offset), &record, (uint16_t)size);
+            offset += codes;
+        }
+        sample_ring_discard(ring, SAMPLE_READER_LOG, count);
+    }
+}
+
+#if SENSOR_EVENT_CODING
+// Function to append the level changes an event-coded channel stored since the
+// previous batch, up to FLASH_LOG_EVENTS_MAX per record, a change more than
+// 65 s after the first of its record starts the next one
+static void log_channel_events(sensor_t channel) {
+    sample_ring_t *ring = &sensor_buffer[channel];
+    uint32_t count = sample_ring_count(ring, SAMPLE_READER_LOG);
+    flash_log_events_t record;
+
+    record.channel = (uint8_t)channel;
+    record.reserved = 0;
+    for (uint32_t offset = 0; offset < count; offset += record.count) {
+        uint32_t first = sample_ring_timestamp(ring, SAMPLE_READER_LOG, offset);
+
+        record.count = 0;
+        while (record.count < FLASH_LOG_EVENTS_MAX && offset + record.count < count) {
+            uint32_t index = offset + record.count;
+            uint32_t after = sample_ring_timestamp(ring, SAMPLE_READER_LOG, index) - first;
+            if (after > UINT16_MAX) {
+                break;
             }
+            flash_log_event_t *event = &record.events[record.count++];
+            event->offset_ms = (uint16_t)after;
+#if STATS_FIXED_POINT
+            event->code = sample_ring_value(ring, SAMPLE_READER_LOG, index);
+#else
+            event->code = sensor_to_fixed(channel, sample_ring_value(ring, SAMPLE_READER_LOG, index));
+#endif
         }
+        flash_log_append(FLASH_LOG_RECORD_EVENTS, first, &record,
+                         (uint16_t)(offsetof(flash_log_events_t, events) + record.count * sizeof(flash_log_event_t)));
+    }
+    sample_ring_discard(ring, SAMPLE_READER_LOG, count);
+}
+#endif
+
+// Function to append the statistics of every channel, the frame the receiver
+// would get without delta reporting and channel mask
+static void log_statistics(const filtered_data_for_ble *filtered_data, uint32_t timestamp) {
+    uint16_t size = stats_frame_encode(&logged_stats, (uint16_t)flash_log_next_sequence(), timestamp,
+                                       (uint16_t)((1U << SENSOR_COUNT) - 1U), filtered_data->stats);
+
+    flash_log_append(FLASH_LOG_RECORD_STATS, timestamp, &logged_stats, size);
+}
+#endif
+
+// Function to transmit data over BLE
+void broadcast_ble(const filtered_data_for_ble *filtered_data, uint32_t timestamp, uint32_t origin_cycles) {
+    uint16_t channel_mask = (uint16_t)pipeline_config.channel_mask;
+
+#if SENSOR_OCCUPANCY
+    // The occupancy byte of the frame stands for the PIR statistics
+    channel_mask &= (uint16_t)~(1U << SENSOR_PIR);
+#endif
+#if LINK_BACKLOG
+    if (!link_backlog_link_up()) {
+        // Nobody listens, keep the full statistics until the link is back.
+        // With FLASH_LOG, log_statistics appends the same report next.
+        stats_frame_t frame;
+#if FLASH_LOG
+        uint32_t log_sequence = flash_log_next_sequence();
+#else
+        uint32_t log_sequence = 0;
+#endif
+        uint16_t size = stats_frame_encode(&frame, (uint16_t)log_sequence, timestamp, channel_mask,
+                                           filtered_data->stats);
+        link_backlog_store(log_sequence, timestamp, &frame, size);
+        return;
     }
-    // If odd number of elements, return the middle value
-    if(count % 2 != 0) {
-        return data[count / 2];
+#endif
+
+    // Package data for transmission over USART to BLE device, 16 bits per statistic.
+#if RELIABLE_LINK
+    // The frame is encoded in the retransmission window, which always has a slot
+    uint8_t *slot = reliable_link_reserve();
+#if STATS_DELTA_REPORTING
+    uint16_t size = stats_delta_encode(&stats_delta, (stats_report_t *)slot, timestamp, channel_mask,
+                                       filtered_data->stats);
+#else
+    static uint16_t sequence;
+    uint16_t size = stats_frame_encode((stats_frame_t *)slot, sequence++, timestamp, channel_mask,
+                                       filtered_data->stats);
+#endif
+    reliable_link_commit(size, origin_cycles);
+#else
+    // The frame is encoded straight into the USART2 DMA burst, a full queue drops
+    // it instead of blocking
+#if LOAD_SHEDDING
+    // The last bursts are kept for the alerts, the report stays out of them
+    bool admitted = load_shed_admit(LOAD_SHED_CLASS_LIVE);
+#else
+    bool admitted = true;
+#endif
+#if STATS_DELTA_REPORTING
+    stats_report_t *report = admitted ? (stats_report_t *)uart_tx_reserve(sizeof(stats_report_t)) : NULL;
+    if (report == NULL) {
+        stats_delta_lost(&stats_delta);
+        return;
+    }
+    // Size 0: nothing moved beyond its deadband, the receiver is up to date
+    uart_tx_commit_traced(stats_delta_encode(&stats_delta, report, timestamp, channel_mask, filtered_data->stats),
+                          origin_cycles);
+#else
+    static uint16_t sequence;
+    stats_frame_t *report = admitted ? (stats_frame_t *)uart_tx_reserve(sizeof(stats_frame_t)) : NULL;
+    if (report == NULL) {
+        // The receiver sees the gap
+        sequence++;
+        return;
     }
-    // If even number of elements, return the average of the two middle values
-    return (data[(count - 1) / 2] + data[count / 2]) / 2.0;
+    uart_tx_commit_traced(stats_frame_encode(report, sequence++, timestamp, channel_mask, filtered_data->stats),
+                          origin_cycles);
+#endif
+#endif
 }
 
-// System clock configuration
+// System clock configuration, HSE is the 25 MHz crystal (HSE_VALUE).
+// The PLL input is kept at 1 MHz and the 48 MHz PLLQ output is exact in
+// both profiles. Peripheral drivers read the bus clocks from the RCC at
+// init time, so the UART baud rate, I2C timing and TIM3 period follow the
+// selected profile, and HAL_RCC_ClockConfig updates SystemCoreClock and the
+// HAL tick. Prefetch and the I/D caches are enabled by HAL_Init.
 void SystemClock_Config(void)
 {
     RCC_OscInitTypeDef RCC_OscInitStruct = {0};
     RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
 
     __HAL_RCC_PWR_CLK_ENABLE();
+#if CLOCK_PROFILE == CLOCK_PROFILE_PERFORMANCE
+    // 168 MHz needs voltage scale 1
     __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE1);
+#elif CLOCK_PROFILE == CLOCK_PROFILE_LOW_POWER
+    __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE2);
+#else
+#error "Unknown CLOCK_PROFILE"
+#endif
 
     RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSE;
     RCC_OscInitStruct.HSEState = RCC_HSE_ON;
     RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
     RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
-    RCC_OscInitStruct.PLL.PLLM = 4;
-    RCC_OscInitStruct.PLL.PLLN = 50;
+    RCC_OscInitStruct.PLL.PLLM = 25;
+#if CLOCK_PROFILE == CLOCK_PROFILE_PERFORMANCE
+    // VCO 336 MHz, SYSCLK 168 MHz, 48 MHz domain
+    RCC_OscInitStruct.PLL.PLLN = 336;
     RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV2;
+    RCC_OscInitStruct.PLL.PLLQ = 7;
+#else
+    // VCO 192 MHz, SYSCLK 24 MHz, 48 MHz domain
+    RCC_OscInitStruct.PLL.PLLN = 192;
+    RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV8;
     RCC_OscInitStruct.PLL.PLLQ = 4;
+#endif
     if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
     {
         Error_Handler();
@@ -333,21 +2823,32 @@ void SystemClock_Config(void)
                                   |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
     RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
     RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
-    RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV2;
+#if CLOCK_PROFILE == CLOCK_PROFILE_PERFORMANCE
+    // APB1 at its 42 MHz maximum, APB2 at its 84 MHz maximum
+    RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV4;
+    RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV2;
+
+    if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_5) != HAL_OK)
+    {
+        Error_Handler();
+    }
+#else
+    RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV1;
     RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV1;
 
-    if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_1) != HAL_OK)
+    if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_0) != HAL_OK)
     {
         Error_Handler();
     }
+#endif
 }
 
-// I2C1 initialization
+// I2C1 initialization, bus profile from I2C_BUS_SPEED_HZ
 static void MX_I2C1_Init(void)
 {
     hi2c1.Instance = I2C1;
-    hi2c1.Init.ClockSpeed = 100000;
-    hi2c1.Init.DutyCycle = I2C_DUTYCYCLE_2;
+    hi2c1.Init.ClockSpeed = I2C_BUS_SPEED_HZ;
+    hi2c1.Init.DutyCycle = I2C_BUS_DUTY_CYCLE;
     hi2c1.Init.OwnAddress1 = 0;
     hi2c1.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
     hi2c1.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
@@ -359,35 +2860,397 @@ static void MX_I2C1_Init(void)
         Error_Handler();
     }
 }
+#if I2C_BUS_COUNT > 1
+// I2C2 initialization, same profile as I2C1
+static void MX_I2C2_Init(void)
+{
+    hi2c2.Instance = I2C2;
+    hi2c2.Init = hi2c1.Init;
+    if (HAL_I2C_Init(&hi2c2) != HAL_OK)
+    {
+        Error_Handler();
+    }
+}
+#endif
+#if I2C_BUS_COUNT > 2
+// I2C3 initialization, same profile as I2C1
+static void MX_I2C3_Init(void)
+{
+    hi2c3.Instance = I2C3;
+    hi2c3.Init = hi2c1.Init;
+    if (HAL_I2C_Init(&hi2c3) != HAL_OK)
+    {
+        Error_Handler();
+    }
+}
+#endif
 
 // USART2 initialization
 static void MX_USART2_UART_Init(void)
 {
     huart2.Instance = USART2;
-    huart2.Init.BaudRate = 115200;
+    huart2.Init.BaudRate = UART_BAUD_RATE;
     huart2.Init.WordLength = UART_WORDLENGTH_8B;
     huart2.Init.StopBits = UART_STOPBITS_1;
     huart2.Init.Parity = UART_PARITY_NONE;
     huart2.Init.Mode = UART_MODE_TX_RX;
+#if UART_FLOW_CONTROL
+    huart2.Init.HwFlowCtl = UART_HWCONTROL_RTS_CTS;
+#else
     huart2.Init.HwFlowCtl = UART_HWCONTROL_NONE;
-    huart2.Init.OverSampling = UART_OVERSAMPLING_16;
+#endif
+    // 16 samples per bit reach APB1 / 16, 8 samples twice that
+    huart2.Init.OverSampling = UART_BAUD_RATE > HAL_RCC_GetPCLK1Freq() / 16U ? UART_OVERSAMPLING_8
+                                                                             : UART_OVERSAMPLING_16;
     if (HAL_UART_Init(&huart2) != HAL_OK)
     {
         Error_Handler();
     }
 }
 
+#if BULK_LINK
+// USART1 initialization, the wired bulk link. Transmit only, nothing is read
+// from the cable.
+static void MX_USART1_UART_Init(void)
+{
+    huart1.Instance = USART1;
+    huart1.Init.BaudRate = BULK_LINK_BAUD_RATE;
+    huart1.Init.WordLength = UART_WORDLENGTH_8B;
+    huart1.Init.StopBits = UART_STOPBITS_1;
+    huart1.Init.Parity = UART_PARITY_NONE;
+    huart1.Init.Mode = UART_MODE_TX;
+    huart1.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    // On APB2, 16 samples per bit reach APB2 / 16, 8 samples twice that
+    huart1.Init.OverSampling = BULK_LINK_BAUD_RATE > HAL_RCC_GetPCLK2Freq() / 16U ? UART_OVERSAMPLING_8
+                                                                                  : UART_OVERSAMPLING_16;
+    if (HAL_UART_Init(&huart1) != HAL_OK)
+    {
+        Error_Handler();
+    }
+}
+#endif
+
+#if TASK_TELEMETRY || TIME_BASE || CLOCK_GOVERNOR || ENERGY_PROFILE
+// TIM2 initialization, free running 32-bit counter at 1 MHz for the run-time
+// stats and the time base
+static void MX_TIM2_Init(void)
+{
+    TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+    uint32_t tim_clock = HAL_RCC_GetPCLK1Freq();
+
+    // APB1 timers run at twice PCLK1 whenever the APB1 prescaler is not 1
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1) {
+        tim_clock *= 2U;
+    }
+
+    // Started by time_base_start, or else by the scheduler through
+    // portCONFIGURE_TIMER_FOR_RUN_TIME_STATS
+    htim2.Instance = TIM2;
+    htim2.Init.Prescaler = (tim_clock / 1000000U) - 1U;
+    htim2.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim2.Init.Period = 0xFFFFFFFFU;
+    htim2.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    if (HAL_TIM_Base_Init(&htim2) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+    if (HAL_TIM_ConfigClockSource(&htim2, &sClockSourceConfig) != HAL_OK)
+    {
+        Error_Handler();
+    }
+}
+#endif
+
+// TIM3 initialization, update event once per sampling period
+static void MX_TIM3_Init(void)
+{
+    TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+    uint32_t tim_clock = HAL_RCC_GetPCLK1Freq();
+
+    // APB1 timers run at twice PCLK1 whenever the APB1 prescaler is not 1
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1) {
+        tim_clock *= 2U;
+    }
+
+    // 10 kHz counter clock, so the 16-bit period covers up to 6.5 s
+    htim3.Instance = TIM3;
+    htim3.Init.Prescaler = (tim_clock / SAMPLE_TIMER_COUNTER_HZ) - 1U;
+    htim3.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim3.Init.Period = (SAMPLE_PERIOD_MS * SAMPLE_TIMER_COUNTER_HZ) / 1000U - 1U;
+    htim3.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim3.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+    if (HAL_TIM_Base_Init(&htim3) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+    if (HAL_TIM_ConfigClockSource(&htim3, &sClockSourceConfig) != HAL_OK)
+    {
+        Error_Handler();
+    }
+}
+
+#if PIR_EVENT_CAPTURE
+// TIM5 initialization, free running 32-bit counter at 1 MHz that stamps the PIR edges
+static void MX_TIM5_Init(void)
+{
+    TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+    uint32_t tim_clock = HAL_RCC_GetPCLK1Freq();
+
+    // APB1 timers run at twice PCLK1 whenever the APB1 prescaler is not 1
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1) {
+        tim_clock *= 2U;
+    }
+
+    // Same clock as TIM3, so the edges stay aligned with the sample timeline
+    htim5.Instance = TIM5;
+    htim5.Init.Prescaler = (tim_clock / 1000000U) - 1U;
+    htim5.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim5.Init.Period = 0xFFFFFFFFU;
+    htim5.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim5.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    if (HAL_TIM_Base_Init(&htim5) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+    if (HAL_TIM_ConfigClockSource(&htim5, &sClockSourceConfig) != HAL_OK)
+    {
+        Error_Handler();
+    }
+}
+#endif
+
+#if ADC_ACQUISITION
+// TIM8 initialization, its update event triggers one ADC1 scan at ADC_ACQUISITION_RATE_HZ
+static void MX_TIM8_Init(void)
+{
+    TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+    TIM_MasterConfigTypeDef sMasterConfig = {0};
+    uint32_t tim_clock = HAL_RCC_GetPCLK2Freq();
+
+    // APB2 timers run at twice PCLK2 whenever the APB2 prescaler is not 1
+    if ((RCC->CFGR & RCC_CFGR_PPRE2) != RCC_CFGR_PPRE2_DIV1) {
+        tim_clock *= 2U;
+    }
+
+    htim8.Instance = TIM8;
+    htim8.Init.Prescaler = (tim_clock / 1000000U) - 1U;
+    htim8.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim8.Init.Period = (1000000U / ADC_ACQUISITION_RATE_HZ) - 1U;
+    htim8.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim8.Init.RepetitionCounter = 0;
+    htim8.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    if (HAL_TIM_Base_Init(&htim8) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+    if (HAL_TIM_ConfigClockSource(&htim8, &sClockSourceConfig) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    sMasterConfig.MasterOutputTrigger = TIM_TRGO_UPDATE;
+    sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+    if (HAL_TIMEx_MasterConfigSynchronization(&htim8, &sMasterConfig) != HAL_OK)
+    {
+        Error_Handler();
+    }
+}
+#endif
+
+// DMA controller initialization
+static void MX_DMA_Init(void)
+{
+    __HAL_RCC_DMA1_CLK_ENABLE();
+#if ADC_ACQUISITION || BULK_LINK
+    __HAL_RCC_DMA2_CLK_ENABLE();
+#endif
+
+    // DMA1_Stream0 carries I2C1_RX, priority must stay below configMAX_SYSCALL_INTERRUPT_PRIORITY
+    HAL_NVIC_SetPriority(DMA1_Stream0_IRQn, IRQ_PRIORITY_ACQUIRE, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Stream0_IRQn);
+#if I2C_BUS_COUNT > 2
+    // DMA1_Stream2 carries I2C3_RX
+    HAL_NVIC_SetPriority(DMA1_Stream2_IRQn, IRQ_PRIORITY_ACQUIRE, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Stream2_IRQn);
+#endif
+#if I2C_BUS_COUNT > 1
+    // DMA1_Stream3 carries I2C2_RX, Stream2 is the only one I2C3_RX has
+    HAL_NVIC_SetPriority(DMA1_Stream3_IRQn, IRQ_PRIORITY_ACQUIRE, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Stream3_IRQn);
+#endif
+    // DMA1_Stream5 carries USART2_RX, the command channel
+    HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, IRQ_PRIORITY_LINK, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+    // DMA1_Stream6 carries USART2_TX
+    HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, IRQ_PRIORITY_LINK, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+#if BULK_LINK
+    // DMA2_Stream7 carries USART1_TX, masked by the transmit critical section like Stream6
+    HAL_NVIC_SetPriority(DMA2_Stream7_IRQn, IRQ_PRIORITY_LINK, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Stream7_IRQn);
+#endif
+#if ADC_ACQUISITION
+    // DMA2_Stream0 carries ADC1, one interrupt per half buffer
+    HAL_NVIC_SetPriority(DMA2_Stream0_IRQn, IRQ_PRIORITY_ACQUIRE, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+#endif
+#if CAPTURE_ACQUISITION
+    // DMA1_Stream7 carries TIM4_CH3, one interrupt per lap of the capture buffer
+    HAL_NVIC_SetPriority(DMA1_Stream7_IRQn, IRQ_PRIORITY_ACQUIRE, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Stream7_IRQn);
+#endif
+}
+
 // GPIO initialization
 static void MX_GPIO_Init(void)
 {
     __HAL_RCC_GPIOH_CLK_ENABLE();
     __HAL_RCC_GPIOA_CLK_ENABLE();
     __HAL_RCC_GPIOB_CLK_ENABLE();
+
+#if PIR_EVENT_CAPTURE
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    // PIR output on both edges, pulled down so an unplugged sensor reads no motion
+    GPIO_InitStruct.Pin = PIR_OUT_Pin;
+    GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING_FALLING;
+    GPIO_InitStruct.Pull = GPIO_PULLDOWN;
+    HAL_GPIO_Init(PIR_OUT_GPIO_Port, &GPIO_InitStruct);
+
+    HAL_NVIC_SetPriority(PIR_OUT_EXTI_IRQn, IRQ_PRIORITY_TIMER, 0);
+    HAL_NVIC_EnableIRQ(PIR_OUT_EXTI_IRQn);
+#endif
+#if SENSOR_FIFO
+    GPIO_InitTypeDef fifo_init = {0};
+
+    // Data-ready output of the FIFO sensors, pulled down so no sensor reads as empty
+    fifo_init.Pin = SENSOR_FIFO_READY_Pin;
+    fifo_init.Mode = GPIO_MODE_IT_RISING;
+    fifo_init.Pull = GPIO_PULLDOWN;
+    HAL_GPIO_Init(SENSOR_FIFO_READY_GPIO_Port, &fifo_init);
+
+    HAL_NVIC_SetPriority(SENSOR_FIFO_READY_EXTI_IRQn, IRQ_PRIORITY_ACQUIRE, 0);
+    HAL_NVIC_EnableIRQ(SENSOR_FIFO_READY_EXTI_IRQn);
+#endif
+#if SENSOR_DRDY
+    // Data-ready outputs of the sensors that sample on their own
+    sensor_drdy_gpio_init();
+#endif
+#if SENSOR_POWER_GATING
+    GPIO_InitTypeDef power_init = {0};
+
+    // Sensor supply switch, off until the producer reads the sensors
+    __HAL_RCC_GPIOE_CLK_ENABLE();
+    HAL_GPIO_WritePin(SENSOR_POWER_GPIO_Port, SENSOR_POWER_Pin, GPIO_PIN_RESET);
+    power_init.Pin = SENSOR_POWER_Pin;
+    power_init.Mode = GPIO_MODE_OUTPUT_PP;
+    power_init.Pull = GPIO_NOPULL;
+    power_init.Speed = GPIO_SPEED_FREQ_LOW;
+    HAL_GPIO_Init(SENSOR_POWER_GPIO_Port, &power_init);
+#endif
+#if LINK_BACKLOG
+    GPIO_InitTypeDef link_init = {0};
+
+    // BLE connection output, pulled down so a module without it reads disconnected
+    link_init.Pin = BLE_LINK_Pin;
+    link_init.Mode = GPIO_MODE_INPUT;
+    link_init.Pull = GPIO_PULLDOWN;
+    HAL_GPIO_Init(BLE_LINK_GPIO_Port, &link_init);
+#endif
+#if ENERGY_PROFILE
+    // Stage markers on PD12-PD15, low until their stage runs
+    energy_profile_init();
+#endif
+}
+
+/**
+  * @brief  Period elapsed callback in non blocking mode
+  * @note   TIM1 is the HAL timebase, TIM2 wraps once every 71 minutes
+  *         under the time base, TIM3 paces the sensor sampling and TIM5
+  *         wraps once every 71 minutes under the PIR edge stamps.
+  * @param  htim : TIM handle
+  * @retval None
+  */
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+    if (htim->Instance == TIM1) {
+        HAL_IncTick();
+    }
+#if TIME_BASE
+    else if (htim->Instance == TIM2) {
+        time_base_overflow_from_isr();
+    }
+#endif
+    else if (htim->Instance == TIM3) {
+        sample_timer_elapsed_from_isr();
+    }
+#if PIR_EVENT_CAPTURE
+    else if (htim->Instance == TIM5) {
+        pir_event_timer_overflow_from_isr();
+    }
+#endif
+}
+
+#if PIR_EVENT_CAPTURE || SENSOR_FIFO || SENSOR_DRDY
+/**
+  * @brief  EXTI line detection callback
+  * @param  GPIO_Pin : pin of the EXTI line that fired
+  * @retval None
+  */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+#if PIR_EVENT_CAPTURE
+    if (GPIO_Pin == PIR_OUT_Pin) {
+        pir_event_edge_from_isr();
+    }
+#endif
+#if SENSOR_FIFO
+    if (GPIO_Pin == SENSOR_FIFO_READY_Pin) {
+        // Drained at the next tick, which the producer wakes for anyway
+        sensor_fifo_ready = true;
+    }
+#endif
+#if SENSOR_DRDY
+    if ((GPIO_Pin & SENSOR_DRDY_PINS) != 0) {
+        // Read by the producer right away, stamped now
+        sensor_drdy_edge_from_isr(GPIO_Pin);
+    }
+#endif
+}
+#endif
+
+/**
+  * @brief  UART error callback
+  * @note   On USART2 either direction may have been stopped by the HAL.
+  * @param  huart : UART handle
+  * @retval None
+  */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance == USART2) {
+#if !LL_FAST_PATH
+        uart_tx_error_from_isr(huart);
+#endif
+        command_channel_error_from_isr();
+    }
+#if BULK_LINK
+    if (huart->Instance == USART1) {
+        uart_tx_error_from_isr(huart);
+    }
+#endif
 }
 
 // Error handler function
 void Error_Handler(void)
 {
+#if WATCHDOG
+    // The IWDG resets the device out of the loop below
+    watchdog_record(WATCHDOG_CAUSE_ERROR, 0, (uint32_t)(uintptr_t)__builtin_return_address(0));
+#endif
     __disable_irq();
     while (1) {}
 }
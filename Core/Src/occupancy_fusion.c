@@ -0,0 +1,125 @@
+/**
+  ******************************************************************************
+  * @file    occupancy_fusion.c
+  * @brief   Per-sample occupancy estimate from the PIR and LDR channels.
+  *
+  *          Occupancy used to be inferred on the host from the PIR and LDR
+  *          statistics of each report, half a minute after the fact and from
+  *          four figures of a 0/1 signal. Here a two-state Bayes filter runs
+  *          on every read instead: the log-odds of an occupied room go up by
+  *          a fixed evidence on a PIR read with motion and on a light that
+  *          was switched on or off, and leak away over time without motion,
+  *          since an occupant that sits still is missed by the PIR. A light
+  *          switch is a read that leaves a slow average of the LDR by a share
+  *          of it, so daylight drifting does not count and one switch counts
+  *          once. The state follows the log-odds with hysteresis.
+  *
+  *          The reports carry the state and its probability in one byte in
+  *          place of the statistics of the PIR channel, and a change of
+  *          state wakes the consumer to send a report right away, so the
+  *          host learns of it within a tick instead of a batch.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "occupancy_fusion.h"
+#include "sensor_registry.h"
+#include <math.h>
+
+#if SENSOR_OCCUPANCY
+
+/* Private variables ---------------------------------------------------------*/
+// Producer task only
+static float occupancy_log_odds;
+static float occupancy_baseline;
+static bool occupancy_light_started;
+static bool occupancy_occupied;
+static bool occupancy_pir_started;
+static uint32_t occupancy_pir_timestamp;
+// Written by the producer, read by any task
+static volatile uint8_t occupancy_byte;
+static volatile uint32_t occupancy_changed_ms;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool occupancy_fusion_light_step(float value);
+static bool occupancy_fusion_update(uint32_t timestamp);
+
+// Function to forget the occupancy and the light baseline
+void occupancy_fusion_init(void) {
+    occupancy_log_odds = 0.0f;
+    occupancy_light_started = false;
+    occupancy_occupied = false;
+    occupancy_pir_started = false;
+    occupancy_changed_ms = 0;
+    // Even odds of a vacant room
+    occupancy_byte = 64U;
+}
+
+// Function to tell a light switched from an LDR read, the baseline jumps to it
+static bool occupancy_fusion_light_step(float value) {
+    float step = fabsf(value - occupancy_baseline);
+
+    if (!occupancy_light_started) {
+        occupancy_baseline = value;
+        occupancy_light_started = true;
+        return false;
+    }
+    if (step > OCCUPANCY_LDR_STEP * fabsf(occupancy_baseline) && step > sensor_registry[SENSOR_LDR].deadband) {
+        occupancy_baseline = value;
+        return true;
+    }
+    occupancy_baseline += OCCUPANCY_LDR_ALPHA * (value - occupancy_baseline);
+    return false;
+}
+
+// Function to move the state after the log-odds and publish its byte
+static bool occupancy_fusion_update(uint32_t timestamp) {
+    bool occupied = occupancy_occupied ? occupancy_log_odds > -OCCUPANCY_THRESHOLD
+                                       : occupancy_log_odds > OCCUPANCY_THRESHOLD;
+    float probability = 1.0f / (1.0f + expf(-occupancy_log_odds));
+    float confidence = occupied ? probability : 1.0f - probability;
+    bool changed = occupied != occupancy_occupied;
+
+    occupancy_occupied = occupied;
+    if (changed) {
+        occupancy_changed_ms = timestamp;
+    }
+    occupancy_byte = (uint8_t)((occupied ? OCCUPANCY_OCCUPIED : 0U) |
+                               (uint32_t)lroundf(confidence * (float)OCCUPANCY_CONFIDENCE_MASK));
+    return changed;
+}
+
+// Function to update the filter with one PIR or LDR read
+bool occupancy_fusion_sample(sensor_t channel, float value, uint32_t timestamp) {
+    if (channel == SENSOR_PIR) {
+        // The leak over the time since the previous read, then its evidence
+        if (occupancy_pir_started) {
+            occupancy_log_odds -= OCCUPANCY_DECAY_PER_S * (float)(timestamp - occupancy_pir_timestamp) / 1000.0f;
+        }
+        occupancy_pir_timestamp = timestamp;
+        occupancy_pir_started = true;
+        if (value > OCCUPANCY_PIR_ABOVE) {
+            occupancy_log_odds += OCCUPANCY_PIR_EVIDENCE;
+        }
+    } else if (channel == SENSOR_LDR) {
+        if (!occupancy_fusion_light_step(value)) {
+            return false;
+        }
+        occupancy_log_odds += OCCUPANCY_LIGHT_EVIDENCE;
+    } else {
+        return false;
+    }
+    occupancy_log_odds = fminf(fmaxf(occupancy_log_odds, -OCCUPANCY_LOG_ODDS_MAX), OCCUPANCY_LOG_ODDS_MAX);
+    return occupancy_fusion_update(timestamp);
+}
+
+// Function to read the occupancy byte
+uint8_t occupancy_fusion_byte(void) {
+    return occupancy_byte;
+}
+
+// Function to read the time of the latest change of state
+uint32_t occupancy_fusion_changed_ms(void) {
+    return occupancy_changed_ms;
+}
+#endif /* SENSOR_OCCUPANCY */
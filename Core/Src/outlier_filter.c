@@ -0,0 +1,72 @@
+/**
+  ******************************************************************************
+  * @file    outlier_filter.c
+  * @brief   Hampel filter that drops single bad reads before they are stored.
+  *
+  *          A single garbage read, an all-ones word from a device that did
+  *          not drive the bus or a glitch on the ADC input, moves the maximum
+  *          and the standard deviation of the whole statistics window until
+  *          it leaves it. The median and the median absolute deviation of the
+  *          last few reads are not moved by one such read, so a read far
+  *          from the median in units of the MAD is dropped before it reaches
+  *          the decimation filter, the ring, the statistics or the link.
+  *
+  *          The median is the sliding median of the statistics, O(log n) per
+  *          read. The MAD needs the median of the deviations, which change
+  *          with every new median, so it is selected again over the few
+  *          reads of the window with the quickselect of calculate_median.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "outlier_filter.h"
+#include <math.h>
+
+/* Private defines -----------------------------------------------------------*/
+// MAD to standard deviation of a normal distribution
+#define OUTLIER_FILTER_MAD_SCALE 1.4826f
+
+// Function to clear the history of one sensor
+void outlier_filter_init(outlier_filter_t *filter, float floor) {
+#if STATS_ARENA
+    // The window only ever holds OUTLIER_FILTER_WINDOW reads, its arrays are that long
+    arena_t arena;
+    arena_init(&arena, filter->storage, sizeof(filter->storage));
+    (void)median_window_bind(&filter->window, &arena, OUTLIER_FILTER_WINDOW);
+#endif
+    median_window_reset(&filter->window);
+    filter->floor = floor;
+    filter->rejected = 0;
+}
+
+// Function to slide the window over one read and test it against the others
+bool outlier_filter_accept(outlier_filter_t *filter, float value) {
+    median_window_t *window = &filter->window;
+    float deviations[OUTLIER_FILTER_WINDOW];
+
+    if (filter->floor <= 0.0f) {
+        return true;
+    }
+    if (window->count == OUTLIER_FILTER_WINDOW) {
+        median_window_remove_oldest(window);
+    }
+    median_window_add(window, value);
+    if (window->count < OUTLIER_FILTER_WINDOW) {
+        return true;
+    }
+
+    float median = median_window_median(window);
+    for (uint32_t i = 0; i < OUTLIER_FILTER_WINDOW; ++i) {
+        deviations[i] = fabsf(window->values[(window->oldest + i) % STATS_WINDOW_SLOTS(window)] - median);
+    }
+    float limit = OUTLIER_FILTER_SIGMA * OUTLIER_FILTER_MAD_SCALE *
+                  calculate_median(deviations, OUTLIER_FILTER_WINDOW);
+    if (limit < filter->floor) {
+        limit = filter->floor;
+    }
+    if (fabsf(value - median) > limit) {
+        filter->rejected++;
+        return false;
+    }
+    return true;
+}
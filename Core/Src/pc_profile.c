@@ -0,0 +1,250 @@
+/**
+  ******************************************************************************
+  * @file    pc_profile.c
+  * @brief   Statistical profiler, a histogram of the interrupted PC taken from a TIM7 interrupt.
+  *
+  *          TIM7, a basic timer on APB1 nothing else uses, interrupts at
+  *          PC_PROFILE_HZ one level above the kernel mask, so it also lands
+  *          inside critical sections and the other interrupt handlers. The
+  *          handler takes the return address from the exception frame of
+  *          the code it interrupted, the PC that code continues at, and
+  *          counts it in an open addressing table. Spread over enough
+  *          samples the counts are the share of the core time spent at
+  *          each instruction, Host/tools/pc_profile_report.py folds them
+  *          into functions with the symbols of the image.
+  *
+  *          The task the sample belongs to is the handle of the running
+  *          task, or ISR when the stacked IPSR shows a handler. A sample
+  *          takes about 150 cycles, 0.2 % of the core at the default rate,
+  *          and the profiler may stay on in a production build.
+  *
+  *          A dump freezes the table, the dump task sends it with what the
+  *          transmit queue leaves, then the sampling goes on.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "pc_profile.h"
+
+#if PC_PROFILE
+#include "main.h"
+#include "cmsis_os.h"
+#include "link_route.h"
+#include "pipeline_priorities.h"
+#include "ram_func.h"
+#include "stack_profile.h"
+#include "task_signal.h"
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+#ifndef PC_PROFILE_STACK_SIZE
+#define PC_PROFILE_STACK_SIZE 160
+#endif
+// Runs with what the live frames leave, like the other senders of old data
+#define PC_PROFILE_PRIORITY TASK_PRIORITY_TRANSMIT
+// TIM7 counts microseconds
+#define PC_PROFILE_COUNTER_HZ 1000000U
+// Exception number field of the stacked xPSR, 0 in thread mode
+#define PC_PROFILE_IPSR_MASK 0x1FFU
+
+/* Private variables ---------------------------------------------------------*/
+// Written by the TIM7 handler, read by the dump task while pc_profile_frozen keeps the handler out
+static pc_profile_pc_t pc_profile_slots[PC_PROFILE_SLOTS] CCMRAM;
+static TaskHandle_t pc_profile_tasks[PC_PROFILE_MAX_TASKS];
+static uint32_t pc_profile_task_samples[PC_PROFILE_MAX_TASKS + 2];
+static uint32_t pc_profile_samples;
+static uint32_t pc_profile_dropped;
+static volatile bool pc_profile_frozen;
+static bool pc_profile_clear;
+
+static TaskHandle_t pc_profile_task_handle;
+static StaticTask_t pc_profile_task_tcb;
+static StackType_t pc_profile_task_stack[PC_PROFILE_STACK_SIZE];
+
+/* Private function prototypes -----------------------------------------------*/
+static void pc_profile_task(void *argument);
+static uint32_t pc_profile_task_index(TaskHandle_t task);
+static void pc_profile_emit(const pc_profile_frame_t *frame);
+static void pc_profile_send_tasks(pc_profile_frame_t *frame);
+static void pc_profile_send_pcs(pc_profile_frame_t *frame);
+
+// Function to create the dump task and start sampling
+void pc_profile_start(void) {
+    uint32_t tim_clock = HAL_RCC_GetPCLK1Freq();
+
+    pc_profile_task_handle = xTaskCreateStatic(pc_profile_task, "Profile", PC_PROFILE_STACK_SIZE, NULL,
+                                               PC_PROFILE_PRIORITY, pc_profile_task_stack, &pc_profile_task_tcb);
+#if STACK_PROFILE
+    stack_profile_track(pc_profile_task_handle, PC_PROFILE_STACK_SIZE);
+#endif
+
+    // APB1 timers run at twice PCLK1 when the bus is divided
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1) {
+        tim_clock *= 2U;
+    }
+    __HAL_RCC_TIM7_CLK_ENABLE();
+    TIM7->PSC = tim_clock / PC_PROFILE_COUNTER_HZ - 1U;
+    TIM7->ARR = PC_PROFILE_COUNTER_HZ / PC_PROFILE_HZ - 1U;
+    // Load the prescaler now, without an interrupt for it
+    TIM7->CR1 = TIM_CR1_URS;
+    TIM7->EGR = TIM_EGR_UG;
+    TIM7->SR = 0;
+    TIM7->DIER = TIM_DIER_UIE;
+    HAL_NVIC_SetPriority(TIM7_IRQn, IRQ_PRIORITY_PROFILE, 0);
+    HAL_NVIC_EnableIRQ(TIM7_IRQn);
+    TIM7->CR1 |= TIM_CR1_CEN;
+}
+
+// Function to freeze the table and wake the dump task
+bool pc_profile_dump(bool clear) {
+    if (pc_profile_frozen) {
+        return false;
+    }
+    pc_profile_clear = clear;
+    pc_profile_frozen = true;
+    task_signal_set(pc_profile_task_handle, TASK_SIGNAL_PROFILE_DUMP);
+    return true;
+}
+
+// Function to find the index of a task, adding it when there is room
+RAMFUNC static uint32_t pc_profile_task_index(TaskHandle_t task) {
+    for (uint32_t index = 0; index < PC_PROFILE_MAX_TASKS; ++index) {
+        if (pc_profile_tasks[index] == task) {
+            return index;
+        }
+        if (pc_profile_tasks[index] == NULL) {
+            pc_profile_tasks[index] = task;
+            return index;
+        }
+    }
+    return PC_PROFILE_TASK_OTHER;
+}
+
+// Function to count the PC and task of one sample
+RAMFUNC void pc_profile_sample(const uint32_t *frame) {
+    // UIF is the only flag of a basic timer
+    TIM7->SR = 0;
+    if (pc_profile_frozen) {
+        return;
+    }
+
+    // r0, r1, r2, r3, r12, lr, pc, xPSR
+    uint32_t pc = frame[6];
+    if ((frame[7] & PC_PROFILE_IPSR_MASK) != 0) {
+        pc_profile_task_samples[PC_PROFILE_TASK_ISR]++;
+    } else {
+        TaskHandle_t task = xTaskGetCurrentTaskHandle();
+        pc_profile_task_samples[task != NULL ? pc_profile_task_index(task) : PC_PROFILE_TASK_OTHER]++;
+    }
+    pc_profile_samples++;
+
+    // Fibonacci hashing of the halfword address, code runs from 0x08000000 so 0 marks a free slot
+    uint32_t slot = ((pc >> 1) * 2654435761U) >> (32U - __builtin_ctz(PC_PROFILE_SLOTS));
+    for (uint32_t probe = 0; probe < PC_PROFILE_PROBES; ++probe) {
+        pc_profile_pc_t *entry = &pc_profile_slots[(slot + probe) & (PC_PROFILE_SLOTS - 1U)];
+        if (entry->pc == pc) {
+            entry->count++;
+            return;
+        }
+        if (entry->pc == 0) {
+            entry->pc = pc;
+            entry->count = 1;
+            return;
+        }
+    }
+    pc_profile_dropped++;
+}
+
+// Function to send one frame, leaving a burst free for the live frames of the consumer
+static void pc_profile_emit(const pc_profile_frame_t *frame) {
+    while (link_route_free(LINK_TRAFFIC_PROFILE) <= 1) {
+        vTaskDelay(1);
+    }
+    link_route_send(LINK_TRAFFIC_PROFILE, (const uint8_t *)frame, sizeof(*frame));
+}
+
+// Function to send the samples of each task
+static void pc_profile_send_tasks(pc_profile_frame_t *frame) {
+    frame->kind = PC_PROFILE_KIND_TASKS;
+    frame->count = 0;
+    memset(frame->tasks, 0, sizeof(frame->tasks));
+    for (uint32_t index = 0; index < PC_PROFILE_MAX_TASKS + 2U; ++index) {
+        const char *name;
+        if (index == PC_PROFILE_TASK_ISR) {
+            name = "ISR";
+        } else if (index == PC_PROFILE_TASK_OTHER) {
+            name = "other";
+        } else if (pc_profile_tasks[index] != NULL) {
+            name = pcTaskGetName(pc_profile_tasks[index]);
+        } else {
+            continue;
+        }
+
+        pc_profile_task_t *task = &frame->tasks[frame->count++];
+        task->index = (uint8_t)index;
+        strncpy(task->name, name, sizeof(task->name) - 1);
+        task->samples = pc_profile_task_samples[index];
+        if (frame->count == PC_PROFILE_FRAME_TASKS) {
+            pc_profile_emit(frame);
+            frame->count = 0;
+            memset(frame->tasks, 0, sizeof(frame->tasks));
+        }
+    }
+    if (frame->count > 0) {
+        pc_profile_emit(frame);
+    }
+}
+
+// Function to send every counted PC and the summary
+static void pc_profile_send_pcs(pc_profile_frame_t *frame) {
+    frame->kind = PC_PROFILE_KIND_PCS;
+    frame->count = 0;
+    memset(frame->pcs, 0, sizeof(frame->pcs));
+    for (uint32_t slot = 0; slot < PC_PROFILE_SLOTS; ++slot) {
+        if (pc_profile_slots[slot].pc == 0) {
+            continue;
+        }
+        frame->pcs[frame->count++] = pc_profile_slots[slot];
+        if (frame->count == PC_PROFILE_FRAME_PCS) {
+            pc_profile_emit(frame);
+            frame->count = 0;
+            memset(frame->pcs, 0, sizeof(frame->pcs));
+        }
+    }
+    if (frame->count > 0) {
+        pc_profile_emit(frame);
+    }
+
+    frame->kind = PC_PROFILE_KIND_END;
+    frame->count = 1;
+    memset(frame->pcs, 0, sizeof(frame->pcs));
+    frame->summary.samples = pc_profile_samples;
+    frame->summary.dropped = pc_profile_dropped;
+    frame->summary.rate_hz = PC_PROFILE_HZ;
+    pc_profile_emit(frame);
+}
+
+// Dump task, sends the frozen table and lets the sampling go on
+static void pc_profile_task(void *argument) {
+    pc_profile_frame_t frame;
+
+    (void)argument;
+    frame.type = PC_PROFILE_FRAME_TYPE;
+    frame.version = PC_PROFILE_FRAME_VERSION;
+    while (1) {
+        task_signal_wait(TASK_SIGNAL_PROFILE_DUMP, portMAX_DELAY);
+        pc_profile_send_tasks(&frame);
+        pc_profile_send_pcs(&frame);
+        link_route_flush(LINK_TRAFFIC_PROFILE);
+
+        // The handler is out while frozen, the table is ours to clear
+        if (pc_profile_clear) {
+            memset(pc_profile_slots, 0, sizeof(pc_profile_slots));
+            memset(pc_profile_task_samples, 0, sizeof(pc_profile_task_samples));
+            pc_profile_samples = 0;
+            pc_profile_dropped = 0;
+        }
+        pc_profile_frozen = false;
+    }
+}
+#endif /* PC_PROFILE */
@@ -0,0 +1,90 @@
+/**
+  ******************************************************************************
+  * @file    pipeline_config.c
+  * @brief   Runtime settings of the sampling and statistics pipeline.
+  *
+  *          The sample rings and the streaming window state are sized for
+  *          the largest settings at compile time, runtime changes only pick
+  *          how much of that storage is used. Nothing is allocated when a
+  *          setting changes, so a change can never fail halfway.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "pipeline_config.h"
+#include "sample_ring.h"
+#include "sample_timer.h"
+#include "sensor_stats.h"
+#include "stats_arena.h"
+
+/* Exported variables --------------------------------------------------------*/
+pipeline_config_t pipeline_config;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool pipeline_config_fits(uint32_t window_size, uint32_t samples_per_batch);
+
+// Function to load the compile-time defaults
+void pipeline_config_init(uint32_t window_size, uint32_t samples_per_batch, uint32_t sample_period_ms) {
+    pipeline_config.window_size = window_size;
+    pipeline_config.samples_per_batch = samples_per_batch;
+    pipeline_config.sample_period_ms = sample_period_ms;
+    pipeline_config.channel_mask = (1U << SENSOR_COUNT) - 1U;
+}
+
+// Function to check a window and batch against the ring and window storage
+static bool pipeline_config_fits(uint32_t window_size, uint32_t samples_per_batch) {
+    // A sliding window holds the new sample before the oldest one leaves, one slot more than its size
+    if (window_size < 1 || window_size + 1U > STATS_WINDOW_CAPACITY_SLOTS) {
+        return false;
+    }
+#if STATS_ARENA
+    if (!stats_arena_fits(window_size)) {
+        return false;
+    }
+#endif
+    return samples_per_batch >= 1 && samples_per_batch <= SAMPLE_RING_SIZE &&
+           window_size + 2 * samples_per_batch <= SAMPLE_RING_SIZE;
+}
+
+// Function to resize the statistics window, the consumer applies it at its next batch
+bool pipeline_config_set_window_size(uint32_t window_size) {
+    if (!pipeline_config_fits(window_size, pipeline_config.samples_per_batch)) {
+        return false;
+    }
+    pipeline_config.window_size = window_size;
+    return true;
+}
+
+// Function to change the report interval in samples
+bool pipeline_config_set_samples_per_batch(uint32_t samples_per_batch) {
+    if (!pipeline_config_fits(pipeline_config.window_size, samples_per_batch)) {
+        return false;
+    }
+    pipeline_config.samples_per_batch = samples_per_batch;
+    return true;
+}
+
+// Function to change the sampling period, TIM3 switches at its next update
+bool pipeline_config_set_sample_period(uint32_t sample_period_ms) {
+    if (sample_period_ms < 1 || sample_period_ms > SAMPLE_TIMER_PERIOD_MAX_MS) {
+        return false;
+    }
+#if RTC_STOP_SAMPLING
+    // The wakeup timer counts calendar seconds
+    if (sample_period_ms % 1000U != 0) {
+        return false;
+    }
+#endif
+    sample_timer_set_period(sample_period_ms);
+    pipeline_config.sample_period_ms = sample_period_ms;
+    return true;
+}
+
+// Function to select the reported channels, at least one must stay on
+bool pipeline_config_set_channel_mask(uint32_t channel_mask) {
+    if (channel_mask == 0 || (channel_mask >> SENSOR_COUNT) != 0) {
+        return false;
+    }
+    pipeline_config.channel_mask = channel_mask;
+    return true;
+}
@@ -0,0 +1,131 @@
+/**
+  ******************************************************************************
+  * @file    pir_event.c
+  * @brief   Interrupt-driven capture of the PIR motion output.
+  *
+  *          The PIR output is nearly binary, polling it over I2C once per
+  *          tick costs a bus transaction and misses pulses shorter than the
+  *          tick. Instead both edges raise EXTI and the ISR only stores the
+  *          1 MHz TIM5 count into a lock-free ring. TIM5 is started together
+  *          with the sampling timer, so an edge converts to the same
+  *          millisecond timeline as the samples, with microsecond detail.
+  *          The conversion runs in the consumer task when edges are reported.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "pir_event.h"
+#include "main.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#if (PIR_EVENT_RING_SIZE & (PIR_EVENT_RING_SIZE - 1)) != 0
+#error "PIR_EVENT_RING_SIZE must be a power of two"
+#endif
+#define PIR_EVENT_RING_MASK (PIR_EVENT_RING_SIZE - 1)
+
+/* External variables --------------------------------------------------------*/
+extern TIM_HandleTypeDef htim5;
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    uint64_t time_us;
+    uint8_t level;
+} pir_raw_edge_t;
+
+/* Private variables ---------------------------------------------------------*/
+// head is written by the EXTI ISR, tail by the consumer task
+static pir_raw_edge_t pir_ring[PIR_EVENT_RING_SIZE];
+static volatile uint32_t pir_head;
+static volatile uint32_t pir_tail;
+static volatile uint32_t pir_dropped;
+// Upper 32 bits of the microsecond clock
+static volatile uint32_t pir_overflows;
+// Set on every rising edge, cleared by pir_event_sample
+static volatile bool pir_motion_seen;
+
+/* Private function prototypes -----------------------------------------------*/
+static uint64_t pir_event_now_us(void);
+
+// Function to reset the edge ring and the microsecond clock
+void pir_event_init(void) {
+    pir_head = 0;
+    pir_tail = 0;
+    pir_dropped = 0;
+    pir_overflows = 0;
+    pir_motion_seen = false;
+}
+
+// Function to read the 64-bit microsecond clock, TIM5 and EXTI share a priority
+static uint64_t pir_event_now_us(void) {
+    uint32_t count = __HAL_TIM_GET_COUNTER(&htim5);
+    uint32_t overflows = pir_overflows;
+
+    // The update interrupt is pending but could not run yet, the count already wrapped
+    if (__HAL_TIM_GET_FLAG(&htim5, TIM_FLAG_UPDATE) && count < 0x80000000U) {
+        overflows++;
+    }
+    return ((uint64_t)overflows << 32) | count;
+}
+
+// Function to stamp an edge of the PIR output, called from the EXTI ISR
+void pir_event_edge_from_isr(void) {
+    uint64_t time_us = pir_event_now_us();
+    uint8_t level = HAL_GPIO_ReadPin(PIR_OUT_GPIO_Port, PIR_OUT_Pin) == GPIO_PIN_SET ? 1U : 0U;
+    uint32_t head = pir_head;
+
+    if (level != 0) {
+        pir_motion_seen = true;
+    }
+    if (head - __atomic_load_n(&pir_tail, __ATOMIC_ACQUIRE) == PIR_EVENT_RING_SIZE) {
+        pir_dropped++;
+        return;
+    }
+    pir_ring[head & PIR_EVENT_RING_MASK].time_us = time_us;
+    pir_ring[head & PIR_EVENT_RING_MASK].level = level;
+    __atomic_store_n(&pir_head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Function to count a wrap of the 32-bit TIM5 counter
+void pir_event_timer_overflow_from_isr(void) {
+    pir_overflows++;
+}
+
+// Function to move the oldest edges into a frame
+uint16_t pir_event_build(pir_event_frame_t *frame) {
+    uint32_t tail = pir_tail;
+    uint32_t available = __atomic_load_n(&pir_head, __ATOMIC_ACQUIRE) - tail;
+    uint32_t dropped = __atomic_exchange_n(&pir_dropped, 0, __ATOMIC_RELAXED);
+    uint32_t count = available < PIR_EVENT_FRAME_EDGES ? available : PIR_EVENT_FRAME_EDGES;
+
+    if (count == 0 && dropped == 0) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        const pir_raw_edge_t *raw = &pir_ring[(tail + i) & PIR_EVENT_RING_MASK];
+        pir_edge_t *edge = &frame->edges[i];
+
+        edge->timestamp_ms = (uint32_t)(raw->time_us / 1000U);
+        edge->timestamp_us = (uint16_t)(raw->time_us % 1000U);
+        edge->level = raw->level;
+        edge->reserved = 0;
+    }
+    // Finish reading the slots before handing them back to the ISR
+    __atomic_store_n(&pir_tail, tail + count, __ATOMIC_RELEASE);
+
+    frame->type = PIR_EVENT_FRAME_TYPE;
+    frame->version = PIR_EVENT_FRAME_VERSION;
+    frame->count = (uint8_t)count;
+    frame->dropped = (uint8_t)(dropped > UINT8_MAX ? UINT8_MAX : dropped);
+    return (uint16_t)(offsetof(pir_event_frame_t, edges) + count * sizeof(frame->edges[0]));
+}
+
+// Function to sample the PIR channel from the latched edges, no bus access
+float pir_event_sample(void) {
+    bool seen = __atomic_exchange_n(&pir_motion_seen, false, __ATOMIC_RELAXED);
+
+    if (HAL_GPIO_ReadPin(PIR_OUT_GPIO_Port, PIR_OUT_Pin) == GPIO_PIN_SET) {
+        seen = true;
+    }
+    return seen ? 1.0f : 0.0f;
+}
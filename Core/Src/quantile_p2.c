@@ -0,0 +1,115 @@
+/**
+  ******************************************************************************
+  * @file    quantile_p2.c
+  * @brief   Constant-memory streaming quantile estimate (P-square algorithm).
+  *
+  *          Jain and Chlamtac's P-square algorithm keeps five marker heights
+  *          instead of the samples. Each new sample shifts the ranks of the
+  *          markers above it. A middle marker that drifted one rank or more
+  *          from its ideal rank moves by one, and its height is corrected on
+  *          the parabola through its neighbours, or linearly when the
+  *          parabola would leave their interval. The middle marker is the
+  *          estimate. Memory and time per sample are constant, whatever the
+  *          number of samples.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "quantile_p2.h"
+
+// Function to reset the estimator for the p-quantile
+void quantile_p2_init(quantile_p2_t *estimator, float p) {
+    estimator->p = p;
+    estimator->count = 0;
+}
+
+// Function to correct a marker height on the parabola through its neighbours
+static float quantile_p2_parabolic(const quantile_p2_t *estimator, uint32_t i, int32_t step) {
+    const float *q = estimator->height;
+    const int32_t *n = estimator->position;
+    float d = (float)step;
+
+    return q[i] + d / (float)(n[i + 1] - n[i - 1]) *
+                  ((float)(n[i] - n[i - 1] + step) * (q[i + 1] - q[i]) / (float)(n[i + 1] - n[i]) +
+                   (float)(n[i + 1] - n[i] - step) * (q[i] - q[i - 1]) / (float)(n[i] - n[i - 1]));
+}
+
+// Function to add a sample and move the markers that drifted
+void quantile_p2_add(quantile_p2_t *estimator, float value) {
+    float *q = estimator->height;
+    int32_t *n = estimator->position;
+    float p = estimator->p;
+    uint32_t k;
+
+    if (estimator->count < QUANTILE_P2_MARKERS) {
+        // Insertion sort of the first samples, they become the markers
+        k = estimator->count++;
+        while (k > 0 && q[k - 1] > value) {
+            q[k] = q[k - 1];
+            --k;
+        }
+        q[k] = value;
+        if (estimator->count == QUANTILE_P2_MARKERS) {
+            for (uint32_t i = 0; i < QUANTILE_P2_MARKERS; ++i) {
+                n[i] = (int32_t)i + 1;
+            }
+            estimator->desired[0] = 1.0f;
+            estimator->desired[1] = 1.0f + 2.0f * p;
+            estimator->desired[2] = 1.0f + 4.0f * p;
+            estimator->desired[3] = 3.0f + 2.0f * p;
+            estimator->desired[4] = 5.0f;
+        }
+        return;
+    }
+    estimator->count++;
+
+    // Cell of the sample, the outer markers follow the extremes
+    if (value < q[0]) {
+        q[0] = value;
+        k = 0;
+    } else if (value >= q[4]) {
+        q[4] = value;
+        k = 3;
+    } else {
+        k = 0;
+        while (value >= q[k + 1]) {
+            ++k;
+        }
+    }
+    for (uint32_t i = k + 1; i < QUANTILE_P2_MARKERS; ++i) {
+        n[i]++;
+    }
+    estimator->desired[1] += p / 2.0f;
+    estimator->desired[2] += p;
+    estimator->desired[3] += (1.0f + p) / 2.0f;
+    estimator->desired[4] += 1.0f;
+
+    for (uint32_t i = 1; i < QUANTILE_P2_MARKERS - 1; ++i) {
+        float drift = estimator->desired[i] - (float)n[i];
+        if ((drift >= 1.0f && n[i + 1] - n[i] > 1) || (drift <= -1.0f && n[i - 1] - n[i] < -1)) {
+            int32_t step = drift > 0.0f ? 1 : -1;
+            float height = quantile_p2_parabolic(estimator, i, step);
+            if (!(q[i - 1] < height && height < q[i + 1])) {
+                uint32_t j = step > 0 ? i + 1 : i - 1;
+                height = q[i] + (float)step * (q[j] - q[i]) / (float)(n[j] - n[i]);
+            }
+            q[i] = height;
+            n[i] += step;
+        }
+    }
+}
+
+// Function to read the estimate
+float quantile_p2_value(const quantile_p2_t *estimator) {
+    uint32_t count = estimator->count;
+
+    if (count == 0) {
+        return 0.0f;
+    }
+    if (count < QUANTILE_P2_MARKERS) {
+        // Nearest rank among the sorted samples
+        uint32_t rank = (uint32_t)(estimator->p * (float)(count - 1) + 0.5f);
+        return estimator->height[rank];
+    }
+    return estimator->height[2];
+}
@@ -0,0 +1,234 @@
+/**
+  ******************************************************************************
+  * @file    reliable_link.c
+  * @brief   Sliding-window retransmission of the statistics frames.
+  *
+  *          The consumer builds each statistics frame in a slot of the
+  *          window and sends it at once, without waiting for anything.
+  *          The slot is kept until the receiver reports the frame's
+  *          sequence, so up to RELIABLE_LINK_WINDOW frames are in flight and
+  *          the link runs at the report rate, not at one frame per round
+  *          trip.
+  *
+  *          The receiver answers with "ack <newest> [<received>]" lines on
+  *          USART2. An ack names the newest sequence that arrived and a
+  *          bitmap of the 32 before it. It is anchored at the newest frame
+  *          rather than at a cumulative point, because a frame the sender
+  *          gave up would hold a cumulative point back for good. A frame
+  *          that is missing while a frame sent after it arrived is sent
+  *          again at once; any other frame is sent again after
+  *          RELIABLE_LINK_RTO_MS.
+  *
+  *          A low-priority task does the retransmissions and always leaves
+  *          one burst of the transmit queue to the live frames. A frame is
+  *          given up after RELIABLE_LINK_ATTEMPTS sends, or when the window
+  *          is full and the consumer needs the slot. The sequence gap then
+  *          tells the receiver, which resumes at the next keyframe with
+  *          delta reporting.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "reliable_link.h"
+#include "cmsis_os.h"
+#include "link_backlog.h"
+#include "pipeline_priorities.h"
+#include "semphr.h"
+#include "stack_profile.h"
+
+/* Private defines -----------------------------------------------------------*/
+#ifndef RELIABLE_LINK_STACK_SIZE
+#define RELIABLE_LINK_STACK_SIZE 192
+#endif
+#define RELIABLE_LINK_PRIORITY TASK_PRIORITY_TRANSMIT
+// Timeouts are checked four times per RTO
+#define RELIABLE_LINK_POLL_TICKS pdMS_TO_TICKS(RELIABLE_LINK_RTO_MS / 4U)
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    uint8_t frame[UART_TX_FRAME_MAX] __attribute__((aligned(4)));
+    uint16_t size;
+    uint16_t sequence;
+    uint8_t attempts;
+    bool acked;         // Acknowledged or given up, the slot is done
+    bool due;           // Missing before a newer frame that arrived, send it now
+    TickType_t sent_tick;
+} reliable_link_slot_t;
+
+/* Private variables ---------------------------------------------------------*/
+// Frames in flight are [tail, head), the slot at head is the one the consumer
+// builds in. Indices are free running, the mutex guards them and the slots.
+static reliable_link_slot_t reliable_link_slots[RELIABLE_LINK_WINDOW + 1];
+static uint32_t reliable_link_head;
+static uint32_t reliable_link_tail;
+static SemaphoreHandle_t reliable_link_mutex;
+static StaticSemaphore_t reliable_link_mutex_storage;
+static uint32_t reliable_link_retransmit_count;
+static uint32_t reliable_link_lost_count;
+
+static TaskHandle_t reliable_link_task_handle;
+static StaticTask_t reliable_link_task_tcb;
+static StackType_t reliable_link_task_stack[RELIABLE_LINK_STACK_SIZE];
+
+/* Private function prototypes -----------------------------------------------*/
+static void reliable_link_task(void *argument);
+
+// Function to find the slot of a free running index
+static reliable_link_slot_t *reliable_link_slot(uint32_t index) {
+    return &reliable_link_slots[index % (RELIABLE_LINK_WINDOW + 1U)];
+}
+
+// Function to drop the finished frames at the old end of the window, mutex held
+static void reliable_link_advance(void) {
+    while (reliable_link_tail != reliable_link_head && reliable_link_slot(reliable_link_tail)->acked) {
+        reliable_link_tail++;
+    }
+}
+
+// Function to empty the window
+void reliable_link_init(void) {
+    reliable_link_head = 0;
+    reliable_link_tail = 0;
+    reliable_link_retransmit_count = 0;
+    reliable_link_lost_count = 0;
+    reliable_link_mutex = xSemaphoreCreateMutexStatic(&reliable_link_mutex_storage);
+}
+
+// Function to create the retransmission task
+void reliable_link_start(void) {
+    reliable_link_task_handle = xTaskCreateStatic(reliable_link_task, "ReliableLink", RELIABLE_LINK_STACK_SIZE, NULL,
+                                                  RELIABLE_LINK_PRIORITY, reliable_link_task_stack,
+                                                  &reliable_link_task_tcb);
+#if STACK_PROFILE
+    stack_profile_track(reliable_link_task_handle, RELIABLE_LINK_STACK_SIZE);
+#endif
+}
+
+// Function to hand out the slot for the next frame, making room if needed
+uint8_t *reliable_link_reserve(void) {
+    xSemaphoreTake(reliable_link_mutex, portMAX_DELAY);
+    if (reliable_link_head - reliable_link_tail == RELIABLE_LINK_WINDOW) {
+        // The oldest frame waited longest, it goes
+        reliable_link_slot_t *oldest = reliable_link_slot(reliable_link_tail);
+        if (!oldest->acked) {
+            oldest->acked = true;
+            reliable_link_lost_count++;
+        }
+        reliable_link_advance();
+    }
+    xSemaphoreGive(reliable_link_mutex);
+
+    // Outside the window, nobody else touches it
+    return reliable_link_slot(reliable_link_head)->frame;
+}
+
+// Function to send the frame of the reserved slot and keep it in flight
+void reliable_link_commit(uint16_t size, uint32_t origin_cycles) {
+    reliable_link_slot_t *slot = reliable_link_slot(reliable_link_head);
+
+    if (size == 0 || size > UART_TX_FRAME_MAX) {
+        return;
+    }
+    slot->size = size;
+    slot->sequence = (uint16_t)(slot->frame[2] | (slot->frame[3] << 8));
+    slot->attempts = 1;
+    slot->acked = false;
+    slot->due = false;
+    slot->sent_tick = xTaskGetTickCount();
+
+    xSemaphoreTake(reliable_link_mutex, portMAX_DELAY);
+    reliable_link_head++;
+    xSemaphoreGive(reliable_link_mutex);
+
+    // A full queue only delays the frame to its first timeout
+    uart_tx_send_traced(slot->frame, size, origin_cycles);
+}
+
+// Function to apply a receiver report to the frames in flight
+void reliable_link_ack(uint16_t newest, uint32_t received) {
+    const reliable_link_slot_t *anchor = NULL;
+    bool any_due = false;
+
+    xSemaphoreTake(reliable_link_mutex, portMAX_DELAY);
+    for (uint32_t i = reliable_link_tail; i != reliable_link_head; ++i) {
+        reliable_link_slot_t *slot = reliable_link_slot(i);
+        int16_t age = (int16_t)(newest - slot->sequence);
+        if (age == 0) {
+            slot->acked = true;
+            anchor = slot;
+        } else if (age > 0 && age <= RELIABLE_LINK_ACK_BITS && (received & (1UL << (age - 1))) != 0) {
+            slot->acked = true;
+        }
+    }
+    if (anchor != NULL) {
+        // Lost for sure when sent before a frame that arrived
+        for (uint32_t i = reliable_link_tail; i != reliable_link_head; ++i) {
+            reliable_link_slot_t *slot = reliable_link_slot(i);
+            if (!slot->acked && (int16_t)(newest - slot->sequence) > 0 &&
+                (int32_t)(anchor->sent_tick - slot->sent_tick) >= 0) {
+                slot->due = true;
+                any_due = true;
+            }
+        }
+    }
+    reliable_link_advance();
+    xSemaphoreGive(reliable_link_mutex);
+
+    if (any_due) {
+        xTaskNotifyGive(reliable_link_task_handle);
+    }
+}
+
+// Function to read the number of sends after the first
+uint32_t reliable_link_retransmits(void) {
+    return reliable_link_retransmit_count;
+}
+
+// Function to read the number of frames given up
+uint32_t reliable_link_lost(void) {
+    return reliable_link_lost_count;
+}
+
+// Function to send again the frames that are due, oldest first, mutex held
+static void reliable_link_resend(TickType_t now) {
+    for (uint32_t i = reliable_link_tail; i != reliable_link_head; ++i) {
+        reliable_link_slot_t *slot = reliable_link_slot(i);
+        if (slot->acked || (!slot->due && now - slot->sent_tick < pdMS_TO_TICKS(RELIABLE_LINK_RTO_MS))) {
+            continue;
+        }
+        if (slot->attempts >= RELIABLE_LINK_ATTEMPTS) {
+            slot->acked = true;
+            reliable_link_lost_count++;
+            continue;
+        }
+        if (uart_tx_free() <= 1) {
+            // The last free burst is kept for the live frames
+            break;
+        }
+        uart_tx_send(slot->frame, slot->size);
+        slot->attempts++;
+        slot->due = false;
+        slot->sent_tick = now;
+        reliable_link_retransmit_count++;
+    }
+    reliable_link_advance();
+}
+
+// Function to watch the frames in flight
+static void reliable_link_task(void *argument) {
+    (void)argument;
+
+    while (1) {
+        // Woken early by an ack that shows a loss
+        ulTaskNotifyTake(pdTRUE, RELIABLE_LINK_POLL_TICKS);
+#if LINK_BACKLOG
+        if (!link_backlog_link_up()) {
+            // Nobody would hear it, and the timeouts wait for the link
+            continue;
+        }
+#endif
+        xSemaphoreTake(reliable_link_mutex, portMAX_DELAY);
+        reliable_link_resend(xTaskGetTickCount());
+        xSemaphoreGive(reliable_link_mutex);
+    }
+}
@@ -0,0 +1,80 @@
+/**
+  ******************************************************************************
+  * @file    rollup_summary.c
+  * @brief   Mergeable summary of one channel over one period.
+  *
+  *          The kernels of stats_rollup, apart from its pyramid and tasks so
+  *          that the host build links the same code: the gateway aggregator
+  *          merges the summaries of every node of a site with the merge the
+  *          producer folds its seconds into minutes with, and the two ends
+  *          agree to the last bit of the float moments.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stats_rollup.h"
+#include <string.h>
+
+/* Private function prototypes -----------------------------------------------*/
+static void rollup_sketch_halve(uint16_t *sketch);
+
+// Function to clear a summary
+void rollup_summary_reset(rollup_summary_t *summary) {
+    memset(summary, 0, sizeof(*summary));
+    summary->min = INT16_MAX;
+    summary->max = INT16_MIN;
+}
+
+// Function to halve the sketch weights, they keep their proportions
+static void rollup_sketch_halve(uint16_t *sketch) {
+    for (uint32_t bin = 0; bin < ROLLUP_SKETCH_BINS; ++bin) {
+        sketch[bin] >>= 1;
+    }
+}
+
+// Function to add a code to a summary
+void rollup_summary_add(rollup_summary_t *summary, int16_t code) {
+    uint32_t bin = ((uint16_t)code ^ 0x8000U) >> ROLLUP_SKETCH_SHIFT;
+    float value = (float)code;
+    float delta = value - summary->mean;
+
+    summary->count++;
+    summary->mean += delta / (float)summary->count;
+    summary->m2 += delta * (value - summary->mean);
+    summary->min = code < summary->min ? code : summary->min;
+    summary->max = code > summary->max ? code : summary->max;
+    if (summary->sketch[bin] == UINT16_MAX) {
+        rollup_sketch_halve(summary->sketch);
+    }
+    summary->sketch[bin]++;
+}
+
+// Function to merge other into summary, the pairwise update of Chan et al.
+// for the mean and the squared deviations
+void rollup_summary_merge(rollup_summary_t *summary, const rollup_summary_t *other) {
+    uint32_t bins[ROLLUP_SKETCH_BINS];
+    uint32_t largest = 0;
+
+    if (other->count == 0) {
+        return;
+    }
+    if (summary->count == 0) {
+        *summary = *other;
+        return;
+    }
+    float count = (float)summary->count + (float)other->count;
+    float delta = other->mean - summary->mean;
+    summary->mean += delta * (float)other->count / count;
+    summary->m2 += other->m2 + delta * delta * (float)summary->count * (float)other->count / count;
+    summary->count += other->count;
+    summary->min = other->min < summary->min ? other->min : summary->min;
+    summary->max = other->max > summary->max ? other->max : summary->max;
+
+    for (uint32_t bin = 0; bin < ROLLUP_SKETCH_BINS; ++bin) {
+        bins[bin] = (uint32_t)summary->sketch[bin] + other->sketch[bin];
+        largest = bins[bin] > largest ? bins[bin] : largest;
+    }
+    for (uint32_t bin = 0; bin < ROLLUP_SKETCH_BINS; ++bin) {
+        summary->sketch[bin] = (uint16_t)(largest > UINT16_MAX ? bins[bin] >> 1 : bins[bin]);
+    }
+}
@@ -0,0 +1,327 @@
+/**
+  ******************************************************************************
+  * @file    rtc_stop.c
+  * @brief   RTC wakeup timer sampling with STOP mode in between, calendar timestamps.
+  *
+  *          At one sample a minute the core spends nearly all its time in
+  *          the idle task, and the tickless SLEEP still keeps the PLL, the
+  *          flash and every peripheral clock running. STOP mode stops them
+  *          all, but TIM3 with them, so the RTC wakeup timer on the 1 Hz
+  *          calendar clock takes over the sampling tick: its interrupt wakes
+  *          the core, releases the producer and stamps the tick with the
+  *          calendar second it fired on.
+  *
+  *          The idle task enters STOP through vPortSuppressTicksAndSleep,
+  *          which replaces the weak one of the port, and only when every
+  *          task waits without a timeout, so no kernel time falls due while
+  *          SysTick is stopped. The time slept is read back from the
+  *          calendar and the kernel tick stepped by it. The core wakes on
+  *          HSI, the clock source it had is brought back from the HSE and
+  *          PLL settings STOP leaves in place, a lock of about 1 ms. With
+  *          a timeout pending the idle task waits in plain SLEEP instead.
+  *
+  *          The registers are used directly, this project does not ship the
+  *          HAL RTC driver. Shadow registers are bypassed, so the calendar
+  *          reads right after STOP without waiting for a resynchronisation.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "rtc_stop.h"
+#include "cmsis_os.h"
+#include "energy_profile.h"
+#include "main.h"
+#include "pipeline_priorities.h"
+#include "sample_timer.h"
+#include "task.h"
+#include "uart_tx.h"
+
+#if RTC_STOP_SAMPLING
+/* Private defines -----------------------------------------------------------*/
+// ck_apre 256 Hz and ck_spre 1 Hz, the subseconds count PREDIV_S down
+#if RTC_STOP_LSE
+#define RTC_STOP_PREDIV_A 127U
+#define RTC_STOP_PREDIV_S 255U
+#else
+#define RTC_STOP_PREDIV_A 127U
+#define RTC_STOP_PREDIV_S 249U
+#endif
+// The crystal starts in about 2 s, a missing one stops the boot
+#define RTC_STOP_LSE_TIMEOUT_MS 5000U
+// Days from 1970-01-01 to 2000-01-01
+#define RTC_STOP_DAYS_TO_2000 10957U
+#define RTC_STOP_MS_PER_DAY 86400000ULL
+
+/* Private variables ---------------------------------------------------------*/
+// Written by the task that sets the period
+static uint32_t rtc_stop_period_s = RTC_STOP_PERIOD_S;
+static bool rtc_stop_running;
+
+/* Private function prototypes -----------------------------------------------*/
+static uint64_t rtc_stop_time_ms(bool whole_second);
+static void rtc_stop_wakeup_program(void);
+static bool rtc_stop_quiet(void);
+static void rtc_stop_enter(void);
+static uint32_t rtc_stop_bcd(uint32_t value);
+static uint32_t rtc_stop_days_from_civil(uint32_t year, uint32_t month, uint32_t day);
+
+// Function to start the RTC clock and the calendar if the backup domain lost them
+void rtc_stop_init(void) {
+    __HAL_RCC_PWR_CLK_ENABLE();
+    HAL_PWR_EnableBkUpAccess();
+#if !RTC_STOP_LSE
+    // A reset turns the LSI off, even under a calendar that kept running
+    RCC->CSR |= RCC_CSR_LSION;
+    while ((RCC->CSR & RCC_CSR_LSIRDY) == 0) {
+    }
+#endif
+    if ((RCC->BDCR & RCC_BDCR_RTCEN) == 0) {
+#if RTC_STOP_LSE
+        uint32_t start = HAL_GetTick();
+        RCC->BDCR |= RCC_BDCR_LSEON;
+        while ((RCC->BDCR & RCC_BDCR_LSERDY) == 0) {
+            if (HAL_GetTick() - start > RTC_STOP_LSE_TIMEOUT_MS) {
+                Error_Handler();
+            }
+        }
+        MODIFY_REG(RCC->BDCR, RCC_BDCR_RTCSEL, RCC_BDCR_RTCSEL_0);
+#else
+        MODIFY_REG(RCC->BDCR, RCC_BDCR_RTCSEL, RCC_BDCR_RTCSEL_1);
+#endif
+        RCC->BDCR |= RCC_BDCR_RTCEN;
+    }
+
+    RTC->WPR = 0xCAU;
+    RTC->WPR = 0x53U;
+    if ((RTC->ISR & RTC_ISR_INITS) == 0) {
+        // Not set since the backup domain came up: 24 h, 2000-01-01, a Saturday
+        RTC->ISR |= RTC_ISR_INIT;
+        while ((RTC->ISR & RTC_ISR_INITF) == 0) {
+        }
+        RTC->PRER = RTC_STOP_PREDIV_S;
+        RTC->PRER |= RTC_STOP_PREDIV_A << RTC_PRER_PREDIV_A_Pos;
+        RTC->CR &= ~RTC_CR_FMT;
+        RTC->TR = 0;
+        RTC->DR = (6U << RTC_DR_WDU_Pos) | (1U << RTC_DR_MU_Pos) | (1U << RTC_DR_DU_Pos);
+        RTC->ISR &= ~RTC_ISR_INIT;
+    }
+    RTC->CR |= RTC_CR_BYPSHAD;
+    RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+    RTC->WPR = 0xFFU;
+
+    // The wakeup flag reaches the NVIC, and ends STOP, as EXTI line 22
+    EXTI->IMR |= EXTI_IMR_MR22;
+    EXTI->RTSR |= EXTI_RTSR_TR22;
+    HAL_NVIC_SetPriority(RTC_WKUP_IRQn, IRQ_PRIORITY_TIMER, 0);
+    HAL_NVIC_EnableIRQ(RTC_WKUP_IRQn);
+}
+
+// Function to start the wakeup timer
+void rtc_stop_start(void) {
+    taskENTER_CRITICAL();
+    rtc_stop_running = true;
+    rtc_stop_wakeup_program();
+    taskEXIT_CRITICAL();
+}
+
+// Function to change the wakeup period, applied at once when the timer runs
+void rtc_stop_set_period(uint32_t period_ms) {
+    taskENTER_CRITICAL();
+    rtc_stop_period_s = period_ms / 1000U;
+    if (rtc_stop_running) {
+        rtc_stop_wakeup_program();
+    }
+    taskEXIT_CRITICAL();
+}
+
+// Function to load the period into the stopped wakeup timer and start it
+static void rtc_stop_wakeup_program(void) {
+    RTC->WPR = 0xCAU;
+    RTC->WPR = 0x53U;
+    RTC->CR &= ~RTC_CR_WUTE;
+    // Two RTC clock cycles at most
+    while ((RTC->ISR & RTC_ISR_WUTWF) == 0) {
+    }
+    RTC->WUTR = rtc_stop_period_s - 1U;
+    // ck_spre, one count per calendar second
+    RTC->CR = (RTC->CR & ~RTC_CR_WUCKSEL) | RTC_CR_WUCKSEL_2 | RTC_CR_WUTIE | RTC_CR_WUTE;
+    RTC->WPR = 0xFFU;
+}
+
+// Function to read the calendar
+uint32_t rtc_stop_now_ms(void) {
+    return (uint32_t)rtc_stop_time_ms(false);
+}
+
+// Function to read the calendar in milliseconds since 2000, to the second or with its subseconds
+static uint64_t rtc_stop_time_ms(bool whole_second) {
+    uint32_t ssr, tr, dr;
+
+    // The counters are read directly, a carry between two of them shows as a change
+    do {
+        ssr = RTC->SSR;
+        tr = RTC->TR;
+        dr = RTC->DR;
+    } while (ssr != RTC->SSR || tr != RTC->TR || dr != RTC->DR);
+
+    uint32_t year = 2000U + ((dr & RTC_DR_YT) >> RTC_DR_YT_Pos) * 10U + ((dr & RTC_DR_YU) >> RTC_DR_YU_Pos);
+    uint32_t month = ((dr & RTC_DR_MT) >> RTC_DR_MT_Pos) * 10U + ((dr & RTC_DR_MU) >> RTC_DR_MU_Pos);
+    uint32_t day = ((dr & RTC_DR_DT) >> RTC_DR_DT_Pos) * 10U + ((dr & RTC_DR_DU) >> RTC_DR_DU_Pos);
+    uint32_t seconds = (((tr & RTC_TR_HT) >> RTC_TR_HT_Pos) * 10U + ((tr & RTC_TR_HU) >> RTC_TR_HU_Pos)) * 3600U +
+                       (((tr & RTC_TR_MNT) >> RTC_TR_MNT_Pos) * 10U + ((tr & RTC_TR_MNU) >> RTC_TR_MNU_Pos)) * 60U +
+                       ((tr & RTC_TR_ST) >> RTC_TR_ST_Pos) * 10U + ((tr & RTC_TR_SU) >> RTC_TR_SU_Pos);
+    uint32_t ms = seconds * 1000U;
+    if (!whole_second) {
+        uint32_t prediv_s = RTC->PRER & RTC_PRER_PREDIV_S;
+        ms += (prediv_s - (ssr & RTC_SSR_SS)) * 1000U / (prediv_s + 1U);
+    }
+    uint32_t days = rtc_stop_days_from_civil(year, month, day) - RTC_STOP_DAYS_TO_2000;
+    return days * RTC_STOP_MS_PER_DAY + ms;
+}
+
+// Function to set the calendar from the Unix time
+bool rtc_stop_set_calendar(uint32_t epoch_s) {
+    uint32_t days = epoch_s / 86400U;
+    uint32_t seconds = epoch_s % 86400U;
+
+    if (days < RTC_STOP_DAYS_TO_2000 || days >= rtc_stop_days_from_civil(2100U, 1U, 1U)) {
+        return false;
+    }
+    // Civil date of the day, see rtc_stop_days_from_civil
+    uint32_t shifted = days + 719468U;
+    uint32_t era = shifted / 146097U;
+    uint32_t day_of_era = shifted - era * 146097U;
+    uint32_t year_of_era = (day_of_era - day_of_era / 1460U + day_of_era / 36524U - day_of_era / 146096U) / 365U;
+    uint32_t day_of_year = day_of_era - (365U * year_of_era + year_of_era / 4U - year_of_era / 100U);
+    uint32_t month_index = (5U * day_of_year + 2U) / 153U;
+    uint32_t day = day_of_year - (153U * month_index + 2U) / 5U + 1U;
+    uint32_t month = month_index < 10U ? month_index + 3U : month_index - 9U;
+    uint32_t year = year_of_era + era * 400U + (month <= 2U ? 1U : 0U);
+    // 1970-01-01 was a Thursday, the RTC counts Monday as 1
+    uint32_t weekday = (days + 3U) % 7U + 1U;
+
+    taskENTER_CRITICAL();
+    RTC->WPR = 0xCAU;
+    RTC->WPR = 0x53U;
+    RTC->ISR |= RTC_ISR_INIT;
+    while ((RTC->ISR & RTC_ISR_INITF) == 0) {
+    }
+    RTC->TR = (rtc_stop_bcd(seconds / 3600U) << RTC_TR_HU_Pos) | (rtc_stop_bcd(seconds / 60U % 60U) << RTC_TR_MNU_Pos) |
+              (rtc_stop_bcd(seconds % 60U) << RTC_TR_SU_Pos);
+    RTC->DR = (rtc_stop_bcd(year - 2000U) << RTC_DR_YU_Pos) | (weekday << RTC_DR_WDU_Pos) |
+              (rtc_stop_bcd(month) << RTC_DR_MU_Pos) | (rtc_stop_bcd(day) << RTC_DR_DU_Pos);
+    RTC->ISR &= ~RTC_ISR_INIT;
+    RTC->WPR = 0xFFU;
+    taskEXIT_CRITICAL();
+    return true;
+}
+
+// Function to count a wakeup as a sampling tick
+void rtc_stop_wakeup_from_isr(void) {
+    if ((RTC->ISR & RTC_ISR_WUTF) == 0) {
+        return;
+    }
+    // The flags clear on 0, INIT must keep its value
+    RTC->ISR = (~(RTC_ISR_WUTF | RTC_ISR_INIT) & 0x0000FFFFU) | (RTC->ISR & RTC_ISR_INIT);
+    EXTI->PR = EXTI_PR_PR22;
+    // The wakeup fires as the second turns, its time is that second
+    sample_timer_elapsed_at_from_isr((uint32_t)rtc_stop_time_ms(true));
+}
+
+// Function to idle in STOP while no task has a timeout, in SLEEP otherwise.
+// Replaces the weak tickless idle of the port.
+void vPortSuppressTicksAndSleep(TickType_t xExpectedIdleTime) {
+    // An interrupt that arrives from here on still ends the WFI
+    __disable_irq();
+    __DSB();
+    __ISB();
+    eSleepModeStatus status = eTaskConfirmSleepModeStatus();
+    if (status == eNoTasksWaitingTimeout && rtc_stop_quiet()) {
+        uint64_t before = rtc_stop_time_ms(false);
+        SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+        // The HAL tick pauses as in the tickless sleep and steps with the kernel
+        configPRE_SLEEP_PROCESSING(xExpectedIdleTime);
+        rtc_stop_enter();
+        configPOST_SLEEP_PROCESSING(xExpectedIdleTime);
+        uint32_t slept_ms = (uint32_t)(rtc_stop_time_ms(false) - before);
+#if ENERGY_PROFILE
+        // TIM2 stood still and only saw the wakeup, the RTC saw the STOP
+        energy_profile_stopped(slept_ms);
+#endif
+        SysTick->VAL = 0;
+        SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+        // No task waits on the kernel time, the step never passes an unblock time
+        vTaskStepTick(pdMS_TO_TICKS(slept_ms));
+    } else if (status != eAbortSleep) {
+        // The kernel and HAL ticks keep running and end the sleep within a millisecond
+#if ENERGY_PROFILE
+        energy_profile_enter(ENERGY_STATE_SLEEP);
+        energy_profile_begin(ENERGY_STAGE_SLEEP);
+#endif
+        __DSB();
+        __WFI();
+        __ISB();
+#if ENERGY_PROFILE
+        energy_profile_end(ENERGY_STAGE_SLEEP);
+        energy_profile_enter(ENERGY_STATE_RUN);
+#endif
+    }
+    __enable_irq();
+}
+
+// Function to check that STOP would not cut off a transfer that runs without a task waiting on it
+static bool rtc_stop_quiet(void) {
+    // The last frame is still shifting out, the UART task already went back to waiting
+    bool quiet = (USART2->SR & USART_SR_TC) != 0 && (DMA1_Stream6->CR & DMA_SxCR_EN) == 0;
+#if BULK_LINK
+    // A dump on the wired link as well
+    quiet = quiet && (USART1->SR & USART_SR_TC) != 0 && (DMA2_Stream7->CR & DMA_SxCR_EN) == 0;
+#endif
+    return quiet;
+}
+
+// Function to stop the clocks until an interrupt and bring the one the core ran on back
+static void rtc_stop_enter(void) {
+    uint32_t source = RCC->CFGR & RCC_CFGR_SW;
+
+    // Low-power regulator and the flash powered down, a few us more at the wakeup
+    MODIFY_REG(PWR->CR, PWR_CR_PDDS | PWR_CR_LPDS | PWR_CR_FPDS, PWR_CR_LPDS | PWR_CR_FPDS);
+    SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+    __DSB();
+    __WFI();
+    __ISB();
+    SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+
+    // Woken on HSI, the PLL keeps its dividers and only has to lock again
+    if (source == RCC_CFGR_SW_HSI) {
+        return;
+    }
+    RCC->CR |= RCC_CR_HSEON;
+    while ((RCC->CR & RCC_CR_HSERDY) == 0) {
+    }
+    if (source == RCC_CFGR_SW_PLL) {
+        RCC->CR |= RCC_CR_PLLON;
+        while ((RCC->CR & RCC_CR_PLLRDY) == 0) {
+        }
+    }
+    MODIFY_REG(RCC->CFGR, RCC_CFGR_SW, source);
+    while ((RCC->CFGR & RCC_CFGR_SWS) != (source << RCC_CFGR_SWS_Pos)) {
+    }
+}
+
+// Function to turn 0 to 99 into two BCD digits
+static uint32_t rtc_stop_bcd(uint32_t value) {
+    return ((value / 10U) << 4) | (value % 10U);
+}
+
+// Function to count the days from 1970-01-01 to a civil date, an era of the
+// Gregorian calendar is 400 years and starts in March
+static uint32_t rtc_stop_days_from_civil(uint32_t year, uint32_t month, uint32_t day) {
+    year -= month <= 2U ? 1U : 0U;
+    uint32_t era = year / 400U;
+    uint32_t year_of_era = year - era * 400U;
+    uint32_t day_of_year = (153U * (month > 2U ? month - 3U : month + 9U) + 2U) / 5U + day - 1U;
+    uint32_t day_of_era = year_of_era * 365U + year_of_era / 4U - year_of_era / 100U + day_of_year;
+    return era * 146097U + day_of_era - 719468U;
+}
+#endif
@@ -0,0 +1,122 @@
+/**
+  ******************************************************************************
+  * @file    sample_codec.c
+  * @brief   Bit-packed delta coding of the sample codes in the flash log.
+  *
+  *          The samples of a channel move little from one to the next: the
+  *          PIR code only changes on an edge and the humidity and light
+  *          codes drift by a few steps. Coded as differences behind a
+  *          variable-width prefix, in the style of the Gorilla time series
+  *          store, a quiet channel costs a bit per sample and a slowly
+  *          drifting one six, where the plain record takes sixteen. The
+  *          timestamps need no coding, a record holds the time of its first
+  *          sample and the nominal interval.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sample_codec.h"
+
+/* Private types -------------------------------------------------------------*/
+// Width class of a zig-zag delta, smallest first
+typedef struct {
+    uint8_t prefix;      // Prefix bits, most significant first
+    uint8_t prefix_bits;
+    uint8_t value_bits;
+} sample_codec_class_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const sample_codec_class_t sample_codec_classes[] = {
+    {0x0U, 1U, 0U},
+    {0x2U, 2U, 4U},
+    {0x6U, 3U, 8U},
+    {0xEU, 4U, 12U},
+    {0xFU, 4U, 16U},
+};
+#define SAMPLE_CODEC_CLASS_COUNT (sizeof(sample_codec_classes) / sizeof(sample_codec_classes[0]))
+
+// Function to write bits, most significant first, into a zeroed stream
+static void sample_codec_put(uint8_t *data, uint32_t position, uint32_t value, uint32_t bits) {
+    for (uint32_t i = 0; i < bits; ++i, ++position) {
+        if ((value >> (bits - 1U - i)) & 1U) {
+            data[position >> 3] |= (uint8_t)(0x80U >> (position & 7U));
+        }
+    }
+}
+
+// Function to read bits, most significant first
+static uint32_t sample_codec_get(const uint8_t *data, uint32_t position, uint32_t bits) {
+    uint32_t value = 0;
+
+    for (uint32_t i = 0; i < bits; ++i, ++position) {
+        value = (value << 1) | ((data[position >> 3] >> (7U - (position & 7U))) & 1U);
+    }
+    return value;
+}
+
+// Function to encode codes as bit-packed zig-zag deltas
+uint32_t sample_codec_encode(const int16_t *codes, uint32_t count, uint8_t *data, uint32_t capacity,
+                             uint32_t *size) {
+    uint32_t limit = capacity * 8U;
+    uint32_t position = 0;
+    uint16_t previous = 0;
+    uint32_t encoded = 0;
+
+    for (uint32_t i = 0; i < capacity; ++i) {
+        data[i] = 0;
+    }
+    for (; encoded < count; ++encoded) {
+        int16_t delta = (int16_t)(uint16_t)((uint16_t)codes[encoded] - previous);
+        uint32_t zigzag = (uint16_t)(((uint32_t)delta << 1) ^ (uint32_t)(delta >> 15));
+        const sample_codec_class_t *width = &sample_codec_classes[SAMPLE_CODEC_CLASS_COUNT - 1U];
+
+        for (uint32_t c = 0; c < SAMPLE_CODEC_CLASS_COUNT; ++c) {
+            if (zigzag < (1U << sample_codec_classes[c].value_bits)) {
+                width = &sample_codec_classes[c];
+                break;
+            }
+        }
+        if (position + width->prefix_bits + width->value_bits > limit) {
+            break;
+        }
+        sample_codec_put(data, position, width->prefix, width->prefix_bits);
+        position += width->prefix_bits;
+        sample_codec_put(data, position, zigzag, width->value_bits);
+        position += width->value_bits;
+        previous = (uint16_t)codes[encoded];
+    }
+    *size = (position + 7U) / 8U;
+    return encoded;
+}
+
+// Function to decode bit-packed zig-zag deltas back to codes
+uint32_t sample_codec_decode(const uint8_t *data, uint32_t size, int16_t *codes, uint32_t count) {
+    uint32_t limit = size * 8U;
+    uint32_t position = 0;
+    uint16_t previous = 0;
+    uint32_t decoded = 0;
+
+    for (; decoded < count; ++decoded) {
+        const sample_codec_class_t *width;
+
+        // The prefix is a run of up to four 1 bits, a 0 ends it early
+        uint32_t ones = 0;
+        while (ones < 4U && position + ones < limit && sample_codec_get(data, position + ones, 1U) != 0) {
+            ++ones;
+        }
+        if (ones < 4U && position + ones >= limit) {
+            break;
+        }
+        width = &sample_codec_classes[ones];
+        position += width->prefix_bits;
+        if (position + width->value_bits > limit) {
+            break;
+        }
+        uint32_t zigzag = sample_codec_get(data, position, width->value_bits);
+        position += width->value_bits;
+        uint16_t delta = (uint16_t)((zigzag >> 1) ^ (0U - (zigzag & 1U)));
+        previous = (uint16_t)(previous + delta);
+        codes[decoded] = (int16_t)previous;
+    }
+    return decoded;
+}
@@ -0,0 +1,120 @@
+/**
+  ******************************************************************************
+  * @file    sample_decimator.c
+  * @brief   Oversampling FIR decimation stage between acquisition and the rings.
+  *
+  *          A sensor is read factor times per stored sample and the reads
+  *          pass a low-pass FIR before only every factor-th output is kept.
+  *          The discarded outputs are never computed: the filter runs once
+  *          per stored sample over the newest taps reads, which is the
+  *          polyphase form of the decimator. The rings and the statistics
+  *          then see fewer samples with the out-of-band noise of the reads
+  *          removed instead of aliased into the window.
+  *
+  *          With STATS_USE_CMSIS_DSP the reads are collected into a block of
+  *          factor values and filtered by arm_fir_decimate_f32.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sample_decimator.h"
+#include <math.h>
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+#define SAMPLE_DECIMATOR_PI 3.14159265358979f
+
+// Function to design the filter and reset the history
+void sample_decimator_init(sample_decimator_t *decimator, uint32_t factor) {
+    float sum = 0.0f;
+
+    memset(decimator, 0, sizeof(*decimator));
+    if (factor < 1) {
+        factor = 1;
+    } else if (factor > SAMPLE_DECIMATOR_FACTOR_MAX) {
+        factor = SAMPLE_DECIMATOR_FACTOR_MAX;
+    }
+    decimator->factor = factor;
+    if (factor == 1) {
+        return;
+    }
+
+    // Cutoff at half the output rate, in cycles per read
+    uint32_t taps = SAMPLE_DECIMATOR_TAPS_PER_PHASE * factor;
+    float cutoff = 0.5f / (float)factor;
+    float center = (float)(taps - 1) / 2.0f;
+    for (uint32_t n = 0; n < taps; ++n) {
+        float t = (float)n - center;
+        float sinc = 2.0f * cutoff * (t == 0.0f ? 1.0f : sinf(2.0f * SAMPLE_DECIMATOR_PI * cutoff * t) /
+                                                        (2.0f * SAMPLE_DECIMATOR_PI * cutoff * t));
+        float window = 0.54f - 0.46f * cosf(2.0f * SAMPLE_DECIMATOR_PI * (float)n / (float)(taps - 1));
+        decimator->coeffs[n] = sinc * window;
+        sum += decimator->coeffs[n];
+    }
+    for (uint32_t n = 0; n < taps; ++n) {
+        decimator->coeffs[n] /= sum;
+    }
+    decimator->taps = taps;
+#if STATS_USE_CMSIS_DSP
+    // The block is always factor reads, a multiple of the factor by construction
+    arm_fir_decimate_init_f32(&decimator->instance, (uint16_t)taps, (uint8_t)factor, decimator->coeffs,
+                              decimator->state, factor);
+#endif
+}
+
+#if STATS_USE_CMSIS_DSP
+// Function to collect a block of reads and filter it with CMSIS-DSP
+bool sample_decimator_push(sample_decimator_t *decimator, float value, float *out) {
+    if (decimator->factor == 1) {
+        *out = value;
+        return true;
+    }
+    if (!decimator->primed) {
+        // The first taps - 1 state words are the history of the next block
+        for (uint32_t n = 0; n < decimator->taps - 1; ++n) {
+            decimator->state[n] = value;
+        }
+        decimator->primed = true;
+    }
+    decimator->block[decimator->phase++] = value;
+    if (decimator->phase < decimator->factor) {
+        return false;
+    }
+    decimator->phase = 0;
+    arm_fir_decimate_f32(&decimator->instance, decimator->block, out, decimator->factor);
+    return true;
+}
+#else
+// Function to add a read and filter the history every factor-th read
+bool sample_decimator_push(sample_decimator_t *decimator, float value, float *out) {
+    uint32_t taps = decimator->taps;
+
+    if (decimator->factor == 1) {
+        *out = value;
+        return true;
+    }
+    if (!decimator->primed) {
+        for (uint32_t n = 0; n < 2 * taps; ++n) {
+            decimator->history[n] = value;
+        }
+        decimator->primed = true;
+    }
+    decimator->history[decimator->head] = value;
+    decimator->history[decimator->head + taps] = value;
+    decimator->head = decimator->head + 1 == taps ? 0 : decimator->head + 1;
+    if (++decimator->phase < decimator->factor) {
+        return false;
+    }
+    decimator->phase = 0;
+
+    // history[head] is the oldest of the newest taps reads, the filter is
+    // symmetric so the coefficient order does not matter
+    const float *window = &decimator->history[decimator->head];
+    float acc = 0.0f;
+    for (uint32_t n = 0; n < taps; ++n) {
+        acc += decimator->coeffs[n] * window[n];
+    }
+    *out = acc;
+    return true;
+}
+#endif
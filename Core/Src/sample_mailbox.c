@@ -0,0 +1,113 @@
+/**
+  ******************************************************************************
+  * @file    sample_mailbox.c
+  * @brief   Triple-buffered mailbox of the newest sample of every channel.
+  *
+  *          The rings hold the windows for the statistics, but a reader that
+  *          only needs the newest values would have to walk every ring and
+  *          race the producer doing so. Here the producer keeps the newest
+  *          stored value of every channel in a row of its own and, at the
+  *          end of each tick, hands a copy of it over through three rows
+  *          per reader: one the producer writes, one the reader holds and
+  *          one in the middle, the newest published.
+  *
+  *          Publishing writes the free row and swaps it with the middle one
+  *          in one atomic exchange that also flags it as new. A reader that
+  *          finds the flag swaps the row it holds with the middle one the
+  *          same way and reads its row in place. Neither side ever waits for
+  *          the other: the row being written is never the one a reader holds,
+  *          and a reader never holds a row the producer writes. A row that is
+  *          not taken before the next tick is overwritten, the reader always
+  *          gets the newest complete one.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sample_mailbox.h"
+
+#if SAMPLE_MAILBOX
+#include "stats_frame.h"
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+// In the middle word next to its row index, set while the reader has not taken the row
+#define SAMPLE_MAILBOX_NEW 4U
+#define SAMPLE_MAILBOX_INDEX 3U
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    sample_row_t rows[3];
+    volatile uint32_t middle; // Row published last, and SAMPLE_MAILBOX_NEW
+    uint32_t write;           // Producer only
+    uint32_t read;            // Reader only
+} sample_mailbox_t;
+
+/* Private variables ---------------------------------------------------------*/
+static sample_mailbox_t sample_mailboxes[SAMPLE_MAILBOX_READER_COUNT];
+// Producer only, the row of the tick in progress
+static sample_row_t sample_mailbox_row;
+
+// Function to empty every reader
+void sample_mailbox_init(void) {
+    memset(sample_mailboxes, 0, sizeof(sample_mailboxes));
+    memset(&sample_mailbox_row, 0, sizeof(sample_mailbox_row));
+    for (uint32_t reader = 0; reader < SAMPLE_MAILBOX_READER_COUNT; ++reader) {
+        sample_mailboxes[reader].write = 0;
+        sample_mailboxes[reader].middle = 1;
+        sample_mailboxes[reader].read = 2;
+    }
+}
+
+// Function to keep a stored value for the row of the tick
+void sample_mailbox_stage(sensor_t channel, float value) {
+    sample_mailbox_row.values[channel] = value;
+    sample_mailbox_row.fresh_mask |= (uint16_t)(1U << channel);
+    sample_mailbox_row.valid_mask |= (uint16_t)(1U << channel);
+}
+
+// Function to publish the row of the tick to every reader
+void sample_mailbox_publish(uint32_t timestamp) {
+    sample_mailbox_row.sequence++;
+    sample_mailbox_row.timestamp = timestamp;
+    for (uint32_t reader = 0; reader < SAMPLE_MAILBOX_READER_COUNT; ++reader) {
+        sample_mailbox_t *mailbox = &sample_mailboxes[reader];
+        mailbox->rows[mailbox->write] = sample_mailbox_row;
+        // Release: the row is complete before a reader can swap it in
+        uint32_t previous = __atomic_exchange_n(&mailbox->middle, mailbox->write | SAMPLE_MAILBOX_NEW,
+                                                __ATOMIC_ACQ_REL);
+        mailbox->write = previous & SAMPLE_MAILBOX_INDEX;
+    }
+    // The next row starts with the values held, none of them fresh
+    sample_mailbox_row.fresh_mask = 0;
+}
+
+// Function to take the newest published row of a reader
+const sample_row_t *sample_mailbox_latest(sample_mailbox_reader_t reader) {
+    sample_mailbox_t *mailbox = &sample_mailboxes[reader];
+
+    if ((mailbox->middle & SAMPLE_MAILBOX_NEW) != 0) {
+        // Acquire: the whole row published with the flag is visible
+        uint32_t previous = __atomic_exchange_n(&mailbox->middle, mailbox->read, __ATOMIC_ACQ_REL);
+        mailbox->read = previous & SAMPLE_MAILBOX_INDEX;
+    }
+    const sample_row_t *row = &mailbox->rows[mailbox->read];
+    return row->sequence != 0 ? row : NULL;
+}
+
+// Function to fill a "latest" answer from a row
+uint16_t sample_mailbox_frame(sample_mailbox_frame_t *frame, const sample_row_t *row) {
+    frame->type = SAMPLE_MAILBOX_FRAME_TYPE;
+    frame->version = SAMPLE_MAILBOX_FRAME_VERSION;
+    frame->valid_mask = row->valid_mask;
+    frame->fresh_mask = row->fresh_mask;
+    frame->encoding = STATS_FRAME_ENCODING;
+    frame->reserved = 0;
+    frame->sequence = row->sequence;
+    frame->timestamp = row->timestamp;
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        bool valid = (row->valid_mask & (1U << channel)) != 0;
+        frame->values[channel] = stats_frame_quantize((sensor_t)channel, valid ? row->values[channel] : 0.0f);
+    }
+    return (uint16_t)sizeof(*frame);
+}
+#endif /* SAMPLE_MAILBOX */
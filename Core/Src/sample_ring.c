@@ -0,0 +1,181 @@
+/**
+  ******************************************************************************
+  * @file    sample_ring.c
+  * @brief   Lock-free single-producer/multi-reader ring of one channel.
+  *
+  *          The producer publishes a slot by storing head with release
+  *          semantics after the slot is written, every reader frees slots by
+  *          storing its own cursor with release semantics after it is done
+  *          reading. No mutex or critical section is needed on either side.
+  *
+  *          The readers work through the same samples at their own pace.
+  *          A gating reader holds back the producer, a slot is reused once
+  *          every gating reader released it. Any other reader never slows
+  *          the producer and is lapped instead, sample_ring_catch_up tells
+  *          it how much it missed.
+  *
+  *          The values live in their own array, so the window is at most two
+  *          contiguous runs of values that the statistics kernels can read
+  *          without copying the samples out first.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sample_ring.h"
+#include "ram_func.h"
+
+// Function to gather the fields of one slot into a sample
+static inline void sample_ring_load(const sample_ring_t *ring, uint32_t slot, sensor_data_t *sample) {
+    sample->timestamp = ring->timestamps[slot];
+    sample->acquired_cycles = ring->acquired_cycles[slot];
+    sample->value = ring->values[slot];
+}
+
+// Function to find how far the slowest gating reader is behind head
+static inline uint32_t sample_ring_used(const sample_ring_t *ring, uint32_t head) {
+    uint32_t gating = ring->gating;
+    uint32_t used = 0;
+
+    for (uint32_t reader = 0; reader < SAMPLE_READER_COUNT; ++reader) {
+        if ((gating & (1U << reader)) != 0) {
+            uint32_t behind = head - __atomic_load_n(&ring->cursors[reader], __ATOMIC_ACQUIRE);
+            used = behind > used ? behind : used;
+        }
+    }
+    return used;
+}
+
+// Function to reset the ring to empty
+void sample_ring_init(sample_ring_t *ring) {
+    ring->head = 0;
+    for (uint32_t reader = 0; reader < SAMPLE_READER_COUNT; ++reader) {
+        ring->cursors[reader] = 0;
+    }
+    ring->gating = 1U << SAMPLE_READER_STATS;
+    ring->dropped = 0;
+}
+
+// Function to start a reader at the newest sample
+void sample_ring_attach(sample_ring_t *ring, sample_reader_t reader, bool gating) {
+    ring->cursors[reader] = ring->head;
+    if (gating) {
+        ring->gating |= 1U << reader;
+    } else {
+        ring->gating &= ~(1U << reader);
+    }
+}
+
+// Function to push one sample, called by the producer only
+RAMFUNC bool sample_ring_push(sample_ring_t *ring, const sensor_data_t *sample) {
+    uint32_t head = ring->head;
+
+    if (sample_ring_used(ring, head) >= SAMPLE_RING_SIZE) {
+        ring->dropped++;
+        return false;
+    }
+    uint32_t slot = head & SAMPLE_RING_MASK;
+    ring->timestamps[slot] = sample->timestamp;
+    ring->acquired_cycles[slot] = sample->acquired_cycles;
+    ring->values[slot] = sample->value;
+    // Make the slot contents visible before the new head
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Function to pop the oldest sample of a reader
+bool sample_ring_pop(sample_ring_t *ring, sample_reader_t reader, sensor_data_t *sample) {
+    uint32_t cursor = ring->cursors[reader];
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    if (head == cursor) {
+        return false;
+    }
+    sample_ring_load(ring, cursor & SAMPLE_RING_MASK, sample);
+    // Finish reading the slot before handing it back to the producer
+    __atomic_store_n(&ring->cursors[reader], cursor + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Function to get the number of samples available to a reader
+uint32_t sample_ring_count(const sample_ring_t *ring, sample_reader_t reader) {
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - ring->cursors[reader];
+}
+
+// Function to read the value of a sample without consuming it
+sample_value_t sample_ring_value(const sample_ring_t *ring, sample_reader_t reader, uint32_t offset) {
+    return ring->values[(ring->cursors[reader] + offset) & SAMPLE_RING_MASK];
+}
+
+// Function to read the timestamp of a sample without consuming it
+uint32_t sample_ring_timestamp(const sample_ring_t *ring, sample_reader_t reader, uint32_t offset) {
+    return ring->timestamps[(ring->cursors[reader] + offset) & SAMPLE_RING_MASK];
+}
+
+// Function to read the publish time of a sample without consuming it
+uint32_t sample_ring_acquired_cycles(const sample_ring_t *ring, sample_reader_t reader, uint32_t offset) {
+    return ring->acquired_cycles[(ring->cursors[reader] + offset) & SAMPLE_RING_MASK];
+}
+
+// Function to copy a run of samples without consuming them
+uint32_t sample_ring_peek_batch(const sample_ring_t *ring, sample_reader_t reader, uint32_t offset,
+                                sensor_data_t *samples, uint32_t max) {
+    uint32_t available = sample_ring_count(ring, reader);
+    uint32_t cursor = ring->cursors[reader];
+    uint32_t count = 0;
+
+    if (offset >= available) {
+        return 0;
+    }
+    count = available - offset;
+    if (count > max) {
+        count = max;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        sample_ring_load(ring, (cursor + offset + i) & SAMPLE_RING_MASK, &samples[i]);
+    }
+    return count;
+}
+
+// Function to view the values of a run of samples in place as at most two contiguous parts
+uint32_t sample_ring_span(const sample_ring_t *ring, sample_reader_t reader, uint32_t offset, uint32_t count,
+                          const sample_value_t **first, uint32_t *first_count,
+                          const sample_value_t **second, uint32_t *second_count) {
+    uint32_t available = sample_ring_count(ring, reader);
+
+    if (offset >= available) {
+        count = 0;
+    } else if (count > available - offset) {
+        count = available - offset;
+    }
+
+    uint32_t start = (ring->cursors[reader] + offset) & SAMPLE_RING_MASK;
+    uint32_t until_end = SAMPLE_RING_SIZE - start;
+
+    *first = &ring->values[start];
+    *first_count = count < until_end ? count : until_end;
+    *second = &ring->values[0];
+    *second_count = count - *first_count;
+    return count;
+}
+
+// Function to hand the oldest samples of a reader back to the producer
+void sample_ring_discard(sample_ring_t *ring, sample_reader_t reader, uint32_t count) {
+    uint32_t available = sample_ring_count(ring, reader);
+
+    if (count > available) {
+        count = available;
+    }
+    __atomic_store_n(&ring->cursors[reader], ring->cursors[reader] + count, __ATOMIC_RELEASE);
+}
+
+// Function to move a lapped reader that does not gate to the oldest sample still held
+uint32_t sample_ring_catch_up(sample_ring_t *ring, sample_reader_t reader) {
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t cursor = ring->cursors[reader];
+
+    if (head - cursor <= SAMPLE_RING_SIZE) {
+        return 0;
+    }
+    __atomic_store_n(&ring->cursors[reader], head - SAMPLE_RING_SIZE, __ATOMIC_RELEASE);
+    return head - SAMPLE_RING_SIZE - cursor;
+}
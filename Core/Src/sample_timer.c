@@ -0,0 +1,160 @@
+/**
+  ******************************************************************************
+  * @file    sample_timer.c
+  * @brief   TIM3 driven sampling scheduler.
+  *
+  *          TIM3 fires once per sampling period and releases the producer
+  *          task with a direct-to-task notification. Sample timestamps add
+  *          up the periods of the update events, so the schedule never
+  *          drifts by the time spent on the I2C bus.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sample_timer.h"
+#include "cycle_counter.h"
+#include "isr_pipeline.h"
+#include "ram_func.h"
+#include "rtc_stop.h"
+#include "task_signal.h"
+#include "time_sync.h"
+
+/* External variables --------------------------------------------------------*/
+extern TIM_HandleTypeDef htim3;
+
+/* Private variables ---------------------------------------------------------*/
+// Task blocked in sample_timer_wait, NULL until it first waits
+static TaskHandle_t volatile sample_task;
+// Period in progress, and the one TIM3 loads from its preload register at the next update
+static uint32_t sample_period_ms;
+static volatile uint32_t sample_next_period_ms;
+// Scheduled time of the last update event, only written from the ISR
+static volatile uint32_t sample_time_ms;
+// Cycle counter at the last update event, start of the acquire latency
+static volatile uint32_t sample_tick_cycles;
+// Update events so far, only written from the ISR
+static volatile uint32_t sample_tick_count;
+// Set by sample_timer_hold, the ISR then only records that a tick is owed
+static volatile bool sample_held;
+static volatile bool sample_owed;
+
+// Function to set the sampling period
+void sample_timer_init(uint32_t period_ms) {
+    sample_period_ms = period_ms;
+    sample_next_period_ms = period_ms;
+#if RTC_STOP_SAMPLING
+    // The ticks carry the calendar time
+    sample_time_ms = rtc_stop_now_ms();
+#else
+    sample_time_ms = 0;
+#endif
+    sample_tick_count = 0;
+    sample_task = NULL;
+}
+
+// Function to reprogram the period, ARR is preloaded so it applies at the next update
+void sample_timer_set_period(uint32_t period_ms) {
+#if RTC_STOP_SAMPLING
+    // The wakeup timer restarts its count, the period applies from now
+    rtc_stop_set_period(period_ms);
+#endif
+    taskENTER_CRITICAL();
+#if !RTC_STOP_SAMPLING
+    __HAL_TIM_SET_AUTORELOAD(&htim3, (period_ms * SAMPLE_TIMER_COUNTER_HZ) / 1000U - 1U);
+#endif
+    sample_next_period_ms = period_ms;
+    taskEXIT_CRITICAL();
+}
+
+// Function to wait for the next sampling tick
+uint32_t sample_timer_wait(void) {
+    sample_task = xTaskGetCurrentTaskHandle();
+    task_signal_wait(TASK_SIGNAL_SAMPLE_TICK, portMAX_DELAY);
+    return sample_time_ms;
+}
+
+// Function to wait for the next sampling tick or another signal of the task
+uint32_t sample_timer_wait_or(uint32_t bits, uint32_t *timestamp) {
+    sample_task = xTaskGetCurrentTaskHandle();
+    uint32_t signalled = task_signal_wait(TASK_SIGNAL_SAMPLE_TICK | bits, portMAX_DELAY);
+    if ((signalled & TASK_SIGNAL_SAMPLE_TICK) != 0) {
+        *timestamp = sample_time_ms;
+    }
+    return signalled;
+}
+
+// Function to read the time since the last update from the TIM3 counter
+uint32_t sample_timer_now_from_isr(void) {
+#if RTC_STOP_SAMPLING
+    // TIM3 does not run, the calendar is the time base
+    return rtc_stop_now_ms();
+#else
+    uint32_t base = sample_time_ms;
+    uint32_t counter = __HAL_TIM_GET_COUNTER(&htim3);
+
+    // The update is pending but could not run yet, the counter already restarted
+    if (__HAL_TIM_GET_FLAG(&htim3, TIM_FLAG_UPDATE) != RESET) {
+        base += sample_period_ms;
+        counter = __HAL_TIM_GET_COUNTER(&htim3);
+    }
+    return base + counter * 1000U / SAMPLE_TIMER_COUNTER_HZ;
+#endif
+}
+
+// Function to read when the last tick fired
+uint32_t sample_timer_tick_cycles(void) {
+    return sample_tick_cycles;
+}
+
+// Function to read how many ticks fired
+uint32_t sample_timer_tick_count(void) {
+    return sample_tick_count;
+}
+
+// Function to release the producer on a TIM3 update event
+RAMFUNC void sample_timer_elapsed_from_isr(void) {
+#if TIME_SYNC
+    uint32_t synced_ms;
+
+    // On the gateway clock once it is known, the first tick after the first exchange steps to it
+    if (time_sync_now_ms(&synced_ms)) {
+        sample_timer_elapsed_at_from_isr(synced_ms);
+        return;
+    }
+#endif
+    sample_timer_elapsed_at_from_isr(sample_time_ms + sample_period_ms);
+}
+
+// Function to release the producer on a tick that fired at time_ms
+RAMFUNC void sample_timer_elapsed_at_from_isr(uint32_t time_ms) {
+    sample_tick_cycles = cycle_counter_now();
+    sample_tick_count++;
+    sample_time_ms = time_ms;
+    sample_period_ms = sample_next_period_ms;
+    if (sample_held) {
+        sample_owed = true;
+        return;
+    }
+#if ISR_PIPELINE
+    // No producer, the deferred interrupt takes the tick
+    isr_pipeline_tick_from_isr(time_ms);
+#else
+    task_signal_set_from_isr(sample_task, TASK_SIGNAL_SAMPLE_TICK);
+#endif
+}
+
+// Function to keep the ticks from waking the producer, and wake it for the latest one on release
+void sample_timer_hold(bool held) {
+    bool owed;
+
+    taskENTER_CRITICAL();
+    sample_held = held;
+    owed = !held && sample_owed;
+    if (!held) {
+        sample_owed = false;
+    }
+    taskEXIT_CRITICAL();
+    if (owed) {
+        task_signal_set(sample_task, TASK_SIGNAL_SAMPLE_TICK);
+    }
+}
@@ -0,0 +1,77 @@
+/**
+  ******************************************************************************
+  * @file    sensor_breaker.c
+  * @brief   Retry backoff and circuit breaker of the I2C sensors that stop answering.
+  *
+  *          A read that fails on the bus, a NACK or a timeout of its turn in
+  *          the sequence, still costs the bus its address phase or its whole
+  *          timeout, and the other sensors of the bus wait behind it. So a
+  *          failing sensor is not read at every due tick: after the n-th
+  *          failure in a row it skips 2^n - 1 of its due reads, at most
+  *          SENSOR_BREAKER_BACKOFF_MAX. After SENSOR_BREAKER_OPEN_AFTER
+  *          failures its breaker opens and it skips SENSOR_BREAKER_OPEN_SKIPS
+  *          reads, then one probe read goes out. A good probe closes the
+  *          breaker, a failed one opens it again. A dead sensor then costs
+  *          one read in a few hundred.
+  *
+  *          The backoff counts due reads rather than ticks, so a sensor read
+  *          every tenth tick backs off over the same number of its own reads
+  *          as one read every tick. A bad CRC is not a failure here, the
+  *          sensor answered and cost the bus no more than a good read.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sensor_breaker.h"
+
+/* Private types -------------------------------------------------------------*/
+typedef enum {
+    SENSOR_BREAKER_CLOSED = 0, // Read when due, backing off after a failure
+    SENSOR_BREAKER_OPEN,       // Not read until its skips run out
+    SENSOR_BREAKER_HALF_OPEN,  // One probe read, it closes or opens the breaker again
+} sensor_breaker_state_t;
+
+typedef struct {
+    uint8_t state;    // sensor_breaker_state_t
+    uint8_t failures; // In a row, saturated
+    uint16_t skips;   // Due reads still to skip
+} sensor_breaker_t;
+
+/* Private variables ---------------------------------------------------------*/
+// Producer task only
+static sensor_breaker_t sensor_breakers[SENSOR_COUNT];
+
+// Function to decide whether a due sensor is read at this tick
+bool sensor_breaker_allow(sensor_t channel) {
+    sensor_breaker_t *breaker = &sensor_breakers[channel];
+
+    if (breaker->skips > 0) {
+        breaker->skips--;
+        return false;
+    }
+    if (breaker->state == SENSOR_BREAKER_OPEN) {
+        breaker->state = SENSOR_BREAKER_HALF_OPEN;
+    }
+    return true;
+}
+
+// Function to close the breaker or back off after a read
+void sensor_breaker_result(sensor_t channel, bool ok) {
+    sensor_breaker_t *breaker = &sensor_breakers[channel];
+
+    if (ok) {
+        breaker->state = SENSOR_BREAKER_CLOSED;
+        breaker->failures = 0;
+        return;
+    }
+    if (breaker->failures < UINT8_MAX) {
+        breaker->failures++;
+    }
+    if (breaker->state == SENSOR_BREAKER_HALF_OPEN || breaker->failures >= SENSOR_BREAKER_OPEN_AFTER) {
+        breaker->state = SENSOR_BREAKER_OPEN;
+        breaker->skips = SENSOR_BREAKER_OPEN_SKIPS;
+        return;
+    }
+    uint32_t backoff = (1UL << breaker->failures) - 1U;
+    breaker->skips = (uint16_t)(backoff > SENSOR_BREAKER_BACKOFF_MAX ? SENSOR_BREAKER_BACKOFF_MAX : backoff);
+}
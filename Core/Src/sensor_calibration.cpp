@@ -0,0 +1,135 @@
+/**
+  ******************************************************************************
+  * @file    sensor_calibration.cpp
+  * @brief   Piecewise-linear sensor calibration tables, generated at compile time.
+  *
+  *          Each table samples the physical model of a sensor at evenly spaced
+  *          raw readings. The model is evaluated by the compiler through
+  *          constexpr functions, so the tables are constant data in flash and
+  *          no log or pow runs on the target. At runtime a reading costs one
+  *          shift, one table pair and one multiply-add.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sensor_calibration.h"
+
+static_assert((SENSOR_CALIBRATION_SEGMENTS << SENSOR_CALIBRATION_SEGMENT_SHIFT) == 65536,
+              "the segments must cover the 16-bit raw range");
+
+namespace {
+
+/* Compile-time math ---------------------------------------------------------*/
+constexpr double ln2 = 0.693147180559945309417;
+
+// Function to compute the natural logarithm of x > 0
+constexpr double ln(double x) {
+    int exponent = 0;
+    while (x > 2.0) {
+        x /= 2.0;
+        ++exponent;
+    }
+    while (x < 1.0) {
+        x *= 2.0;
+        --exponent;
+    }
+    // ln(x) = 2 atanh((x - 1) / (x + 1)), converges fast on [1, 2]
+    double t = (x - 1.0) / (x + 1.0);
+    double t2 = t * t;
+    double term = t;
+    double sum = 0.0;
+    for (int n = 1; n < 40; n += 2) {
+        sum += term / n;
+        term *= t2;
+    }
+    return 2.0 * sum + exponent * ln2;
+}
+
+// Function to compute e^x
+constexpr double exp(double x) {
+    int exponent = static_cast<int>(x / ln2);
+    double r = x - exponent * ln2;
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 30; ++n) {
+        term *= r / n;
+        sum += term;
+    }
+    for (; exponent > 0; --exponent) {
+        sum *= 2.0;
+    }
+    for (; exponent < 0; ++exponent) {
+        sum /= 2.0;
+    }
+    return sum;
+}
+
+/* Sensor models -------------------------------------------------------------*/
+// Function to convert a divider reading, 0 to 1 of full scale, to lux
+constexpr double ldr_lux(double ratio) {
+    if (ratio >= 1.0) {
+        return 0.0; // Open photoresistor, darkness
+    }
+    if (ratio <= 0.0) {
+        return SENSOR_CALIBRATION_LDR_LUX_MAX;
+    }
+    double resistance = SENSOR_CALIBRATION_LDR_FIXED_OHM * ratio / (1.0 - ratio);
+    // R = R10 (lux / 10)^-gamma
+    double lux = 10.0 * exp(ln(SENSOR_CALIBRATION_LDR_R10_OHM / resistance) / SENSOR_CALIBRATION_LDR_GAMMA);
+    return lux < SENSOR_CALIBRATION_LDR_LUX_MAX ? lux : SENSOR_CALIBRATION_LDR_LUX_MAX;
+}
+
+// Function to sample a model at every breakpoint of a table
+template <typename Model>
+constexpr sensor_calibration_table_t make_table(Model model) {
+    sensor_calibration_table_t table{};
+    for (int n = 0; n <= SENSOR_CALIBRATION_SEGMENTS; ++n) {
+        table.values[n] = static_cast<float>(model(static_cast<double>(n) / SENSOR_CALIBRATION_SEGMENTS));
+    }
+    return table;
+}
+
+// Function to check that a table never rises, brighter always reads lower
+constexpr bool non_increasing(const sensor_calibration_table_t &table) {
+    for (int n = 0; n < SENSOR_CALIBRATION_SEGMENTS; ++n) {
+        if (table.values[n + 1] > table.values[n]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr sensor_calibration_table_t ldr_table = make_table(ldr_lux);
+static_assert(non_increasing(ldr_table), "LDR calibration must be monotonic");
+static_assert(ldr_table.values[SENSOR_CALIBRATION_SEGMENTS] == 0.0f, "LDR table must end in darkness");
+
+} // namespace
+
+/* Exported variables --------------------------------------------------------*/
+// Constant initialized from the constexpr table, so it lands in .rodata
+extern "C" const sensor_calibration_table_t sensor_calibration_ldr_table = ldr_table;
+
+// Function to interpolate a table between the breakpoints around raw
+float sensor_calibration_apply(const sensor_calibration_table_t *table, float raw) {
+    if (!(raw > 0.0f)) {
+        return table->values[0]; // Also catches NaN
+    }
+    float position = raw * (1.0f / (1U << SENSOR_CALIBRATION_SEGMENT_SHIFT));
+    uint32_t segment = static_cast<uint32_t>(position);
+    if (segment >= SENSOR_CALIBRATION_SEGMENTS) {
+        return table->values[SENSOR_CALIBRATION_SEGMENTS];
+    }
+    float fraction = position - static_cast<float>(segment);
+    float low = table->values[segment];
+    return low + (table->values[segment + 1] - low) * fraction;
+}
+
+// Function to calibrate the LDR word read over I2C
+float sensor_calibration_ldr_lux(float raw) {
+    return sensor_calibration_apply(&sensor_calibration_ldr_table, raw);
+}
+
+// Function to calibrate the LDR mean of ADC1, 12-bit codes are 16 words each
+float sensor_calibration_ldr_lux_adc(float raw) {
+    return sensor_calibration_apply(&sensor_calibration_ldr_table, raw * 16.0f);
+}
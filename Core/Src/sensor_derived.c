@@ -0,0 +1,80 @@
+/**
+  ******************************************************************************
+  * @file    sensor_derived.c
+  * @brief   Virtual channels computed from the reads of the physical ones.
+  *
+  *          A dew point or a heat index is a nonlinear function of humidity
+  *          and temperature, so it cannot be computed from their statistics:
+  *          the mean dew point is not the dew point of the mean humidity at
+  *          the mean temperature, and a host would need every raw sample to
+  *          get it right. A SENSOR_SOURCE_DERIVED row of the registry is
+  *          computed instead from the reads of its input channels as they
+  *          are published, once per read and before the decimation filter,
+  *          and then goes through the same filter, ring and statistics as a
+  *          read of the bus. It costs a few hundred cycles per read and no
+  *          bus time, and it arrives at the host as one more channel.
+  *
+  *          The humidity and heat rows keep the raw words of the sensor, the
+  *          Sensirion transfer functions turn them into %RH and degC here.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sensor_derived.h"
+#include <math.h>
+
+#if SENSOR_DERIVED
+
+/* Private defines -----------------------------------------------------------*/
+// Magnus coefficients over water, -45 to 60 degC
+#define SENSOR_DERIVED_MAGNUS_B 17.62f
+#define SENSOR_DERIVED_MAGNUS_C 243.12f
+// Humidity the logarithm of the dew point is kept above
+#define SENSOR_DERIVED_RH_MIN 0.01f
+
+/* Private function prototypes -----------------------------------------------*/
+static float sensor_derived_humidity(const float *inputs);
+static float sensor_derived_temperature(const float *inputs);
+
+// Function to turn the humidity word into %RH
+static float sensor_derived_humidity(const float *inputs) {
+    float humidity = 100.0f * inputs[SENSOR_HUMIDITY_AND_HEAT] / 65535.0f;
+
+    return humidity < SENSOR_DERIVED_RH_MIN ? SENSOR_DERIVED_RH_MIN : humidity > 100.0f ? 100.0f : humidity;
+}
+
+// Function to turn the temperature word into degC
+static float sensor_derived_temperature(const float *inputs) {
+    return -45.0f + 175.0f * inputs[SENSOR_HEAT] / 65535.0f;
+}
+
+// Function to compute the dew point with the Magnus formula
+float sensor_derived_dew_point(const float *inputs) {
+    float temperature = sensor_derived_temperature(inputs);
+    float gamma = logf(sensor_derived_humidity(inputs) / 100.0f) +
+                  SENSOR_DERIVED_MAGNUS_B * temperature / (SENSOR_DERIVED_MAGNUS_C + temperature);
+
+    return SENSOR_DERIVED_MAGNUS_C * gamma / (SENSOR_DERIVED_MAGNUS_B - gamma);
+}
+
+// Function to compute the heat index of the US National Weather Service: the
+// Steadman approximation when it stays below 80 degF, the Rothfusz regression
+// with its corrections at very low and very high humidity above
+float sensor_derived_heat_index(const float *inputs) {
+    float t = sensor_derived_temperature(inputs) * 1.8f + 32.0f;
+    float rh = sensor_derived_humidity(inputs);
+    float index = 0.5f * (t + 61.0f + (t - 68.0f) * 1.2f + rh * 0.094f);
+
+    if ((index + t) * 0.5f >= 80.0f) {
+        index = -42.379f + 2.04901523f * t + 10.14333127f * rh - 0.22475541f * t * rh - 0.00683783f * t * t -
+                0.05481717f * rh * rh + 0.00122874f * t * t * rh + 0.00085282f * t * rh * rh -
+                0.00000199f * t * t * rh * rh;
+        if (rh < 13.0f && t >= 80.0f && t <= 112.0f) {
+            index -= (13.0f - rh) * 0.25f * sqrtf((17.0f - fabsf(t - 95.0f)) / 17.0f);
+        } else if (rh > 85.0f && t >= 80.0f && t <= 87.0f) {
+            index += (rh - 85.0f) * 0.1f * (87.0f - t) * 0.2f;
+        }
+    }
+    return (index - 32.0f) / 1.8f;
+}
+#endif /* SENSOR_DERIVED */
@@ -0,0 +1,108 @@
+/**
+  ******************************************************************************
+  * @file    sensor_drdy.c
+  * @brief   Data-ready lines of the I2C sensors that sample at their own rate.
+  *
+  *          A sensor that converts on its own raises its data-ready output
+  *          when a new result is in. Read on the tick count, it is either
+  *          polled faster than it converts, each read that finds the old
+  *          result a waste of bus time, or the result waits up to a tick
+  *          before it is read. On its line instead, the EXTI interrupt
+  *          stamps the edge on the sample time base and wakes the producer,
+  *          which reads exactly the rows that rose, one read each, as soon
+  *          as the buses are free.
+  *
+  *          The read itself stays in the producer. The acquisition engine
+  *          runs one list at a time and owns the DMA channels while it does,
+  *          a read started from the interrupt would have to break into the
+  *          list of the tick. The latency is one task switch, the sample
+  *          keeps the time of its edge.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sensor_drdy.h"
+#include "main.h"
+#include "pipeline_priorities.h"
+#include "sample_timer.h"
+#include "task_signal.h"
+
+#if SENSOR_DRDY
+/* Private variables ---------------------------------------------------------*/
+// Written by the EXTI ISR, taken by the producer in a critical section
+static volatile uint32_t sensor_drdy_ready;
+static volatile uint32_t sensor_drdy_time[SENSOR_COUNT];
+// Producer, NULL until it first takes the ready rows
+static TaskHandle_t volatile sensor_drdy_task;
+
+/* Private function prototypes -----------------------------------------------*/
+static void sensor_drdy_latch(uint16_t pins, uint32_t now);
+
+// Function to set the data-ready pins of the registry up as rising-edge interrupts
+void sensor_drdy_gpio_init(void) {
+    GPIO_InitTypeDef drdy_init = {0};
+
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        if (sensor_on_drdy(&sensor_registry[channel])) {
+            drdy_init.Pin |= 1U << sensor_registry[channel].drdy_line;
+        }
+    }
+    if (drdy_init.Pin == 0) {
+        return;
+    }
+    __HAL_RCC_GPIOE_CLK_ENABLE();
+    // Pulled down, an unplugged sensor never reads as ready
+    drdy_init.Mode = GPIO_MODE_IT_RISING;
+    drdy_init.Pull = GPIO_PULLDOWN;
+    HAL_GPIO_Init(SENSOR_DRDY_GPIO_Port, &drdy_init);
+
+    // With TIM3, so no update can run between the counter and the flag read of the stamp
+    HAL_NVIC_SetPriority(SENSOR_DRDY_EXTI_IRQn, IRQ_PRIORITY_TIMER, 0);
+    HAL_NVIC_EnableIRQ(SENSOR_DRDY_EXTI_IRQn);
+}
+
+// Function to stamp the rows whose line rose and wake the producer
+void sensor_drdy_edge_from_isr(uint16_t pins) {
+    sensor_drdy_latch(pins, sample_timer_now_from_isr());
+    task_signal_set_from_isr(sensor_drdy_task, TASK_SIGNAL_SENSOR_READY);
+}
+
+// Function to hand the ready rows and their stamps to the producer
+uint32_t sensor_drdy_take(uint32_t *timestamps) {
+    uint32_t ready;
+
+    sensor_drdy_task = xTaskGetCurrentTaskHandle();
+    taskENTER_CRITICAL();
+    ready = sensor_drdy_ready;
+    sensor_drdy_ready = 0;
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        timestamps[channel] = sensor_drdy_time[channel];
+    }
+    taskEXIT_CRITICAL();
+    return ready;
+}
+
+// Function to latch the rows that are ready without an edge
+void sensor_drdy_rearm(void) {
+    uint16_t high = (uint16_t)(SENSOR_DRDY_GPIO_Port->IDR & SENSOR_DRDY_PINS);
+
+    if (high == 0) {
+        return;
+    }
+    taskENTER_CRITICAL();
+    sensor_drdy_latch(high, sample_timer_now_from_isr());
+    taskEXIT_CRITICAL();
+    task_signal_set(xTaskGetCurrentTaskHandle(), TASK_SIGNAL_SENSOR_READY);
+}
+
+// Function to mark the rows of some pins ready at now
+static void sensor_drdy_latch(uint16_t pins, uint32_t now) {
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        const sensor_driver_t *driver = &sensor_registry[channel];
+        if (sensor_on_drdy(driver) && (pins & (1U << driver->drdy_line)) != 0) {
+            sensor_drdy_time[channel] = now;
+            sensor_drdy_ready |= 1UL << channel;
+        }
+    }
+}
+#endif
@@ -0,0 +1,149 @@
+/**
+  ******************************************************************************
+  * @file    sensor_health.c
+  * @brief   Quality of every sensor read, rolling error rate and read latency per channel.
+  *
+  *          The producer gives every read of a channel one quality: good, or
+  *          the reason it was dropped, a timeout or a NACK of the sequence,
+  *          a bad sensor CRC or a value the outlier filter turned down. A
+  *          dropped read never reaches the ring, so the statistics of a batch
+  *          only ever see good samples and need no mask of their own.
+  *
+  *          Per channel the window counts the reads and each kind of
+  *          failure, the flags seen and the bus time of the I2C reads. The
+  *          score runs across windows: an exponential average of the bad
+  *          reads over about the last 2^SENSOR_HEALTH_SHIFT of them, one
+  *          shift and add per read, so a sensor that starts failing shows
+  *          within a few windows and one that recovers climbs back as fast.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sensor_health.h"
+#include "cmsis_os.h"
+#include "main.h"
+#include "uart_tx.h"
+#include <stddef.h>
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+// Error rate of a channel that only ever failed, Q16
+#define SENSOR_HEALTH_ONE (1UL << 16)
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    uint32_t quality;
+    uint32_t reads;
+    uint32_t timeouts;
+    uint32_t nacks;
+    uint32_t crc_errors;
+    uint32_t outliers;
+    uint32_t latency_count;
+    uint32_t latency_sum_us;
+    uint32_t latency_max_us;
+} sensor_health_slot_t;
+
+/* Private variables ---------------------------------------------------------*/
+// Written by the producer, taken and cleared by the consumer in a critical section
+static sensor_health_slot_t sensor_health_slots[SENSOR_COUNT];
+// Rolling share of bad reads, Q16, producer task only, read whole by any task
+static uint32_t sensor_health_error[SENSOR_COUNT];
+// Consumer task only
+static uint32_t sensor_health_window_start;
+
+/* Private function prototypes -----------------------------------------------*/
+static uint16_t sensor_health_saturate(uint32_t value);
+
+// Function to count one read of a channel and move its error rate
+void sensor_health_record(sensor_t channel, uint32_t quality) {
+    sensor_health_slot_t *slot = &sensor_health_slots[channel];
+    uint32_t error = sensor_health_error[channel];
+
+    // Rounded away from the old rate, so it reaches 0 and 1 exactly
+    if (quality == SENSOR_QUALITY_OK) {
+        error -= (error + (1UL << SENSOR_HEALTH_SHIFT) - 1U) >> SENSOR_HEALTH_SHIFT;
+    } else {
+        error += (SENSOR_HEALTH_ONE - error + (1UL << SENSOR_HEALTH_SHIFT) - 1U) >> SENSOR_HEALTH_SHIFT;
+    }
+    sensor_health_error[channel] = error;
+
+    taskENTER_CRITICAL();
+    slot->quality |= quality;
+    slot->reads++;
+    slot->timeouts += (quality & SENSOR_QUALITY_TIMEOUT) != 0;
+    slot->nacks += (quality & SENSOR_QUALITY_NACK) != 0;
+    slot->crc_errors += (quality & SENSOR_QUALITY_CRC) != 0;
+    slot->outliers += (quality & SENSOR_QUALITY_OUTLIER) != 0;
+    taskEXIT_CRITICAL();
+}
+
+// Function to add the bus time of one read of a channel
+void sensor_health_latency(sensor_t channel, uint32_t cycles) {
+    sensor_health_slot_t *slot = &sensor_health_slots[channel];
+    uint32_t us = cycles / (SystemCoreClock / 1000000U);
+
+    taskENTER_CRITICAL();
+    slot->latency_count++;
+    slot->latency_sum_us += us;
+    if (us > slot->latency_max_us) {
+        slot->latency_max_us = us;
+    }
+    taskEXIT_CRITICAL();
+}
+
+// Function to give the rolling share of good reads of a channel
+uint16_t sensor_health_score(sensor_t channel) {
+    return (uint16_t)(((SENSOR_HEALTH_ONE - sensor_health_error[channel]) * 10000U) >> 16);
+}
+
+// Function to send the table of the window and start the next one
+void sensor_health_report(void) {
+    sensor_health_frame_t frame;
+    uint32_t now = HAL_GetTick();
+
+    frame.type = SENSOR_HEALTH_FRAME_TYPE;
+    frame.version = SENSOR_HEALTH_FRAME_VERSION;
+    frame.sequence = 0;
+    frame.entry_count = 0;
+    frame.window_ms = now - sensor_health_window_start;
+    sensor_health_window_start = now;
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        sensor_health_slot_t slot;
+
+        // Each slot in one piece, the producer preempts the consumer
+        taskENTER_CRITICAL();
+        slot = sensor_health_slots[channel];
+        memset(&sensor_health_slots[channel], 0, sizeof(sensor_health_slots[channel]));
+        taskEXIT_CRITICAL();
+        if (slot.reads == 0) {
+            continue;
+        }
+
+        sensor_health_entry_t *entry = &frame.entries[frame.entry_count++];
+        entry->channel = (uint8_t)channel;
+        entry->quality = (uint8_t)slot.quality;
+        entry->score = sensor_health_score((sensor_t)channel);
+        entry->reads = sensor_health_saturate(slot.reads);
+        entry->timeouts = sensor_health_saturate(slot.timeouts);
+        entry->nacks = sensor_health_saturate(slot.nacks);
+        entry->crc_errors = sensor_health_saturate(slot.crc_errors);
+        entry->outliers = sensor_health_saturate(slot.outliers);
+        entry->latency_avg_us =
+            slot.latency_count == 0 ? 0 : sensor_health_saturate(slot.latency_sum_us / slot.latency_count);
+        entry->latency_max_us = sensor_health_saturate(slot.latency_max_us);
+        if (frame.entry_count == SENSOR_HEALTH_FRAME_ENTRIES) {
+            uart_tx_send((const uint8_t *)&frame, sizeof(frame));
+            frame.sequence++;
+            frame.entry_count = 0;
+        }
+    }
+    if (frame.entry_count > 0) {
+        uart_tx_send((const uint8_t *)&frame,
+                     offsetof(sensor_health_frame_t, entries) + frame.entry_count * sizeof(sensor_health_entry_t));
+    }
+}
+
+// Function to fit a count into a 16-bit field
+static uint16_t sensor_health_saturate(uint32_t value) {
+    return value > UINT16_MAX ? UINT16_MAX : (uint16_t)value;
+}
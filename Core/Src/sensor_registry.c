@@ -0,0 +1,273 @@
+/**
+  ******************************************************************************
+  * @file    sensor_registry.c
+  * @brief   Table of the sensor drivers on the I2C buses.
+  *
+  *          Everything that differs between sensors is described here: the
+  *          bus, address and read size, the conversion of the raw bytes, how
+  *          often it is read and how its statistics are encoded. Each sensor
+  *          has its own ring and window, so a sensor read every n-th tick
+  *          costs bus time only at those ticks and its window spans n times
+  *          as long. The
+  *          producer, the sample ring, the statistics and the frames loop
+  *          over the channels, so adding a sensor is one sensor_t entry and
+  *          one row below. A device that returns several values in one
+  *          read has one I2C row and a SENSOR_SOURCE_SHARED row for each
+  *          further value, converted from the same raw bytes. A quantity
+  *          computed from other channels is a SENSOR_SOURCE_DERIVED row.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sensor_registry.h"
+#include "adc_acquisition.h"
+#include "outlier_filter.h"
+#include "pir_event.h"
+#include "sensor_calibration.h"
+#include "sensor_derived.h"
+#include "sample_decimator.h"
+#include "stats_delta.h"
+#include "stats_frame.h"
+#include <string.h>
+#if defined(__ARM_ARCH)
+#include "cmsis_compiler.h"
+#define SENSOR_REV16(word) __REV16(word)
+#else
+// Host build of the core, the same swap of the bytes of each half
+#define SENSOR_REV16(word) ((((word) >> 8) & 0x00FF00FFU) | (((word) << 8) & 0xFF00FF00U))
+#endif
+
+/* Private variables ---------------------------------------------------------*/
+#if SENSOR_FIFO && !ADC_ACQUISITION
+// The light sensor with a FIFO: register 0x01 takes the watermark and turns
+// on the data-ready output, register 0x00 reads out the FIFO oldest first
+static const uint8_t sensor_ldr_fifo_setup[] = {0x01, SENSOR_FIFO_DEPTH_LDR};
+static const uint8_t sensor_ldr_fifo_register[] = {0x00};
+#endif
+
+/* Exported variables --------------------------------------------------------*/
+const sensor_driver_t sensor_registry[SENSOR_COUNT] = {
+    [SENSOR_PIR] = {
+        .name = "pir",
+#if PIR_EVENT_CAPTURE
+        // Motion seen during the tick, the edges themselves are reported as events
+        .source = SENSOR_SOURCE_HOOK,
+        .sample_divider = 1,
+        .oversample = 1,
+        .sample = pir_event_sample,
+        .fixed_scale = 1.0f / 16384.0f, // Values are 0 to 1
+#else
+        .source = SENSOR_SOURCE_I2C,
+        .address = 0x01,
+        .bus = SENSOR_BUS_PIR,
+        .raw_size = 2,
+        .sample_divider = 1,   // Motion is short, every tick
+        .oversample = 1,       // A filter would only smear the short pulses
+        .convert = sensor_convert_be16,
+        .fixed_scale = STATS_FIXED_SCALE_PIR,
+#endif
+        .deadband = STATS_DEADBAND_PIR,
+        .outlier_floor = OUTLIER_FLOOR_PIR, // Motion pulses are short, not outliers
+        .event_coded = 1, // Idle for long stretches, its runs are what matter
+    },
+    [SENSOR_HUMIDITY_AND_HEAT] = {
+        .source = SENSOR_SOURCE_I2C,
+        .address = 0x02,
+        .bus = SENSOR_BUS_HUMIDITY_AND_HEAT,
+#if SENSOR_HEAT_CHANNEL
+        // Humidity word, CRC, temperature word, CRC; SENSOR_HEAT takes the temperature
+        .name = "humidity",
+        .raw_size = 6,
+        .check = sensor_check_first_crc8,
+#else
+        .name = "humidity_and_heat",
+        .raw_size = 2,
+#endif
+#if SENSOR_DRDY
+        .drdy_line = SENSOR_DRDY_LINE_HUMIDITY_AND_HEAT,
+#endif
+        .sample_divider = 20,  // Changes over minutes, every 5 s at the default tick
+        .oversample = SAMPLE_DECIMATOR_FACTOR(4),
+        .convert = sensor_convert_be16,
+        .fixed_scale = STATS_FIXED_SCALE_HUMIDITY_AND_HEAT,
+        .deadband = STATS_DEADBAND_HUMIDITY_AND_HEAT,
+        .outlier_floor = OUTLIER_FLOOR_HUMIDITY_AND_HEAT,
+    },
+    [SENSOR_LDR] = {
+        .name = "ldr",
+        .shed_low_priority = 1, // Room light changes slowly, the first channel slowed under load
+#if ADC_ACQUISITION
+        // Photoresistor divider on PC1, the sample averages about 1000 conversions.
+        // The 12-bit code is 1/16 of the 16-bit word, so are its units.
+        .source = SENSOR_SOURCE_ADC,
+        .adc_channel = 11,
+        .sample_divider = 4,
+        .oversample = 1,       // The conversion mean already is the decimation
+#if SENSOR_CALIBRATION
+        .calibrate = sensor_calibration_ldr_lux_adc,
+        .fixed_scale = STATS_FIXED_SCALE_LDR_LUX,
+        .deadband = STATS_DEADBAND_LDR_LUX,
+        .outlier_floor = OUTLIER_FLOOR_LDR_LUX,
+#else
+        .fixed_scale = STATS_FIXED_SCALE_LDR / 16.0f,
+        .deadband = STATS_DEADBAND_LDR / 16.0f,
+        .outlier_floor = OUTLIER_FLOOR_LDR / 16.0f,
+#endif
+#elif CAPTURE_ACQUISITION
+        // Light-to-frequency converter on PB8, the sample is its frequency in Hz
+        .source = SENSOR_SOURCE_CAPTURE,
+        .sample_divider = 4,
+        .oversample = 1,       // The edges of the whole interval already are the mean
+        .fixed_scale = STATS_FIXED_SCALE_LDR,
+        .deadband = STATS_DEADBAND_LDR,
+        .outlier_floor = OUTLIER_FLOOR_LDR,
+#else
+        .source = SENSOR_SOURCE_I2C,
+        .address = 0x03,
+        .bus = SENSOR_BUS_LDR,
+        .raw_size = 2,
+#if SENSOR_FIFO
+        // Converts every tick on its own, drained SENSOR_FIFO_DEPTH_LDR reads at a time
+        .setup = sensor_ldr_fifo_setup,
+        .setup_size = sizeof(sensor_ldr_fifo_setup),
+        .trigger = sensor_ldr_fifo_register,
+        .trigger_size = sizeof(sensor_ldr_fifo_register),
+        .fifo_depth = SENSOR_FIFO_DEPTH_LDR,
+#elif SENSOR_DRDY
+        .drdy_line = SENSOR_DRDY_LINE_LDR,
+#endif
+        .sample_divider = 4,   // Once per second at the default tick
+        .oversample = SAMPLE_DECIMATOR_FACTOR(4),
+        .convert = sensor_convert_be16,
+#if SENSOR_CALIBRATION
+        .calibrate = sensor_calibration_ldr_lux,
+        .fixed_scale = STATS_FIXED_SCALE_LDR_LUX,
+        .deadband = STATS_DEADBAND_LDR_LUX,
+        .outlier_floor = OUTLIER_FLOOR_LDR_LUX,
+#else
+        .fixed_scale = STATS_FIXED_SCALE_LDR,
+        .deadband = STATS_DEADBAND_LDR,
+        .outlier_floor = OUTLIER_FLOOR_LDR,
+#endif
+#endif
+    },
+#if SENSOR_HEAT_CHANNEL
+    [SENSOR_HEAT] = {
+        .name = "heat",
+        .source = SENSOR_SOURCE_SHARED,
+        .parent = SENSOR_HUMIDITY_AND_HEAT,
+        .sample_divider = 20,  // Read with the humidity, so at its rate
+        .oversample = SAMPLE_DECIMATOR_FACTOR(4),
+        .convert = sensor_convert_second_be16,
+        .check = sensor_check_second_crc8,
+        .fixed_scale = STATS_FIXED_SCALE_HEAT,
+        .deadband = STATS_DEADBAND_HEAT,
+        .outlier_floor = OUTLIER_FLOOR_HEAT,
+    },
+#endif
+#if SENSOR_DERIVED
+    [SENSOR_DEW_POINT] = {
+        .name = "dew_point",
+        .source = SENSOR_SOURCE_DERIVED,
+        .input_mask = (1U << SENSOR_HUMIDITY_AND_HEAT) | (1U << SENSOR_HEAT),
+        .sample_divider = 20,  // Computed at every read of its inputs
+        .oversample = SAMPLE_DECIMATOR_FACTOR(4),
+        .derive = sensor_derived_dew_point,
+        .fixed_scale = STATS_FIXED_SCALE_DERIVED,
+        .deadband = STATS_DEADBAND_DERIVED,
+        .outlier_floor = OUTLIER_FLOOR_DERIVED,
+    },
+    [SENSOR_HEAT_INDEX] = {
+        .name = "heat_index",
+        .source = SENSOR_SOURCE_DERIVED,
+        .input_mask = (1U << SENSOR_HUMIDITY_AND_HEAT) | (1U << SENSOR_HEAT),
+        .sample_divider = 20,
+        .oversample = SAMPLE_DECIMATOR_FACTOR(4),
+        .derive = sensor_derived_heat_index,
+        .fixed_scale = STATS_FIXED_SCALE_DERIVED,
+        .deadband = STATS_DEADBAND_DERIVED,
+        .outlier_floor = OUTLIER_FLOOR_DERIVED,
+    },
+#endif
+};
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t sensor_crc8(const uint8_t *data, uint32_t size);
+
+// Function to convert a raw big-endian word
+float sensor_convert_be16(const uint8_t *raw) {
+    return (float)((raw[0] << 8) | raw[1]);
+}
+
+// Function to convert count raw big-endian words, four per pass: each
+// REV16 swaps the bytes of two words, the halves are taken out as they are
+void sensor_convert_be16_block(const uint8_t *raw, float *out, uint32_t count) {
+    uint32_t index = 0;
+
+    for (; index + 4U <= count; index += 4U) {
+        uint32_t first, second;
+        // Compiles to unaligned LDRs, the words of a FIFO burst start at any byte
+        memcpy(&first, &raw[2U * index], sizeof(first));
+        memcpy(&second, &raw[2U * index + 4U], sizeof(second));
+        first = SENSOR_REV16(first);
+        second = SENSOR_REV16(second);
+        out[index] = (float)(first & 0xFFFFU);
+        out[index + 1U] = (float)(first >> 16);
+        out[index + 2U] = (float)(second & 0xFFFFU);
+        out[index + 3U] = (float)(second >> 16);
+    }
+    for (; index < count; ++index) {
+        out[index] = sensor_convert_be16(&raw[2U * index]);
+    }
+}
+
+// Function to convert the second word of a read of two CRC-protected words
+float sensor_convert_second_be16(const uint8_t *raw) {
+    return sensor_convert_be16(&raw[3]);
+}
+
+// Function to check the CRC of the first word of a read
+bool sensor_check_first_crc8(const uint8_t *raw) {
+    return sensor_crc8(raw, 2U) == raw[2];
+}
+
+// Function to check the CRC of the second word of a read
+bool sensor_check_second_crc8(const uint8_t *raw) {
+    return sensor_crc8(&raw[3], 2U) == raw[5];
+}
+
+// Function to compute the Sensirion CRC-8 of a word, polynomial 0x31, initial value 0xFF
+static uint8_t sensor_crc8(const uint8_t *data, uint32_t size) {
+    uint8_t crc = 0xFFU;
+
+    for (uint32_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (uint32_t bit = 0; bit < 8U; ++bit) {
+            crc = (uint8_t)((crc & 0x80U) != 0 ? ((uint32_t)crc << 1) ^ 0x31U : (uint32_t)crc << 1);
+        }
+    }
+    return crc;
+}
+
+// Function to express a value in the fixed-point unit of its channel
+int16_t sensor_to_fixed(sensor_t channel, float value) {
+    float scaled = value / sensor_registry[channel].fixed_scale;
+    int32_t fixed = (int32_t)(scaled + (scaled >= 0.0f ? 0.5f : -0.5f));
+
+    if (!(scaled < 32767.0f)) {
+        fixed = INT16_MAX; // Also catches NaN
+    } else if (scaled < -32768.0f) {
+        fixed = INT16_MIN;
+    }
+    return (int16_t)fixed;
+}
+
+// Function to turn a read into the stored sample value
+sample_value_t sensor_sample_value(sensor_t channel, float value) {
+#if STATS_FIXED_POINT
+    return sensor_to_fixed(channel, value);
+#else
+    (void)channel;
+    return value;
+#endif
+}
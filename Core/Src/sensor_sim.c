@@ -0,0 +1,266 @@
+/**
+  ******************************************************************************
+  * @file    sensor_sim.c
+  * @brief   Simulated sensors: generated, replayed from the flash log or streamed over the UART.
+  *
+  *          With SENSOR_SIMULATION the producer takes every sample from here
+  *          instead of the source in sensor_registry, in the sensor unit,
+  *          so calibration is skipped and the outlier filter, decimation
+  *          and everything after them see the values as they would be.
+  *          Nothing waits on a bus, so the sampling period can go down to
+  *          1 ms to load the pipeline at up to 250 times the default rate.
+  *
+  *          Generated values are a sine per channel with noise from a fixed
+  *          seed and a spike every SENSOR_SIM_SPIKE_EVERY samples, the same
+  *          sequence on every run. A replay feeds the sample records of
+  *          the flash log, plain or packed, as they were recorded, into a
+  *          FIFO per channel from a task at transmit priority and starts
+  *          over at the end of the recording. A stream takes the codes of "sample" commands.
+  *          The producer never waits for either and repeats the last value
+  *          when a FIFO runs dry. Nothing is logged during a simulation, so
+  *          a recording stays for the next replay.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sensor_sim.h"
+#include "cmsis_os.h"
+#include "flash_log.h"
+#include "pipeline_priorities.h"
+#include "sample_codec.h"
+#include "sensor_registry.h"
+#include "stack_profile.h"
+#include "task_signal.h"
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+#ifndef SENSOR_SIM_STACK_SIZE
+#define SENSOR_SIM_STACK_SIZE 192
+#endif
+// Fills the FIFOs with what the pipeline leaves, like the other flash readers
+#define SENSOR_SIM_PRIORITY TASK_PRIORITY_TRANSMIT
+// Generated waveform, as shares of the largest fixed16 value of the channel
+#define SENSOR_SIM_CENTER 0.5f
+#define SENSOR_SIM_SWING 0.25f
+#define SENSOR_SIM_NOISE 0.02f
+#define SENSOR_SIM_SPIKE 0.2f
+#define SENSOR_SIM_SPIKE_EVERY 251U
+// Samples per sine period of channel 0, the next channels are slower
+#define SENSOR_SIM_PERIOD_SAMPLES 64U
+#define SENSOR_SIM_TWO_PI 6.28318531f
+
+/* Private types -------------------------------------------------------------*/
+// Single producer, single consumer: the replay task or the command task
+// writes head, the producer task moves tail
+typedef struct {
+    int16_t codes[SENSOR_SIM_FIFO_DEPTH];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+} sensor_sim_fifo_t;
+
+/* Private variables ---------------------------------------------------------*/
+static volatile sensor_sim_mode_t sensor_sim_mode;
+// Bumped by every switch, the producer drops what waits when it sees it change
+static volatile uint32_t sensor_sim_generation;
+static uint32_t sensor_sim_seen[SENSOR_COUNT];
+static sensor_sim_fifo_t sensor_sim_fifos[SENSOR_COUNT];
+// Producer task only
+static uint32_t sensor_sim_index[SENSOR_COUNT];
+static uint32_t sensor_sim_noise[SENSOR_COUNT];
+static float sensor_sim_last[SENSOR_COUNT];
+static uint32_t sensor_sim_underrun_count;
+
+#if FLASH_LOG
+static volatile uint32_t sensor_sim_replay_from;
+static TaskHandle_t sensor_sim_task_handle;
+static StaticTask_t sensor_sim_task_tcb;
+static StackType_t sensor_sim_task_stack[SENSOR_SIM_STACK_SIZE];
+// Codes of the record being replayed, a packed record holds more than the stack should
+static int16_t sensor_sim_replay_codes[FLASH_LOG_PACKED_MAX];
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+static float sensor_sim_generate(sensor_t channel);
+static bool sensor_sim_push(sensor_sim_fifo_t *fifo, int16_t code);
+#if FLASH_LOG
+static void sensor_sim_task(void *argument);
+static uint32_t sensor_sim_unpack(const flash_log_frame_t *frame, uint16_t size, uint32_t *channel);
+#endif
+
+// Function to create the replay task
+void sensor_sim_start(void) {
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        sensor_sim_noise[channel] = 0x5EED0000U + channel;
+    }
+#if FLASH_LOG
+    sensor_sim_task_handle = xTaskCreateStatic(sensor_sim_task, "SensorSim", SENSOR_SIM_STACK_SIZE, NULL,
+                                               SENSOR_SIM_PRIORITY, sensor_sim_task_stack, &sensor_sim_task_tcb);
+#if STACK_PROFILE
+    stack_profile_track(sensor_sim_task_handle, SENSOR_SIM_STACK_SIZE);
+#endif
+#endif
+}
+
+// Function to switch the source of the simulated channels
+bool sensor_sim_select(uint32_t mode, uint32_t sequence) {
+    if (mode >= SENSOR_SIM_MODE_COUNT || (mode == SENSOR_SIM_REPLAY && !FLASH_LOG)) {
+        return false;
+    }
+    sensor_sim_mode = (sensor_sim_mode_t)mode;
+    sensor_sim_generation++;
+#if FLASH_LOG
+    if (mode == SENSOR_SIM_REPLAY) {
+        sensor_sim_replay_from = sequence;
+        task_signal_set(sensor_sim_task_handle, TASK_SIGNAL_SIM_REPLAY);
+    }
+#else
+    (void)sequence;
+#endif
+    return true;
+}
+
+// Function to queue a streamed code
+bool sensor_sim_inject(uint32_t channel, int16_t code) {
+    if (channel >= SENSOR_COUNT || sensor_sim_mode != SENSOR_SIM_STREAM) {
+        return false;
+    }
+    return sensor_sim_push(&sensor_sim_fifos[channel], code);
+}
+
+// Function to add a code to a FIFO, false when it is full
+static bool sensor_sim_push(sensor_sim_fifo_t *fifo, int16_t code) {
+    uint32_t head = fifo->head;
+
+    if (head - fifo->tail >= SENSOR_SIM_FIFO_DEPTH) {
+        return false;
+    }
+    fifo->codes[head & (SENSOR_SIM_FIFO_DEPTH - 1U)] = code;
+    fifo->head = head + 1U;
+    return true;
+}
+
+// Function to produce the next value of a channel
+float sensor_sim_sample(sensor_t channel) {
+    sensor_sim_fifo_t *fifo = &sensor_sim_fifos[channel];
+    uint32_t generation = sensor_sim_generation;
+
+    if (sensor_sim_seen[channel] != generation) {
+        // The codes of the previous source are stale
+        fifo->tail = fifo->head;
+        sensor_sim_seen[channel] = generation;
+    }
+    if (sensor_sim_mode == SENSOR_SIM_GENERATE) {
+        sensor_sim_last[channel] = sensor_sim_generate(channel);
+    } else if (fifo->tail != fifo->head) {
+        uint32_t tail = fifo->tail;
+        sensor_sim_last[channel] = fifo->codes[tail & (SENSOR_SIM_FIFO_DEPTH - 1U)] *
+                                   sensor_registry[channel].fixed_scale;
+        fifo->tail = tail + 1U;
+    } else {
+        sensor_sim_underrun_count++;
+    }
+    return sensor_sim_last[channel];
+}
+
+// Function to generate the next value of a channel
+static float sensor_sim_generate(sensor_t channel) {
+    float full = sensor_registry[channel].fixed_scale * (float)INT16_MAX;
+    uint32_t index = sensor_sim_index[channel]++;
+    uint32_t period = SENSOR_SIM_PERIOD_SAMPLES << channel;
+
+    // Numerical Recipes LCG, the top 24 bits as [-1, 1)
+    sensor_sim_noise[channel] = sensor_sim_noise[channel] * 1664525U + 1013904223U;
+    float noise = (float)(sensor_sim_noise[channel] >> 8) / 8388608.0f - 1.0f;
+    float phase = SENSOR_SIM_TWO_PI * (float)(index % period) / (float)period;
+    float value = SENSOR_SIM_CENTER + SENSOR_SIM_SWING * sinf(phase) + SENSOR_SIM_NOISE * noise;
+
+    if (index % SENSOR_SIM_SPIKE_EVERY == SENSOR_SIM_SPIKE_EVERY - 1U) {
+        value += SENSOR_SIM_SPIKE;
+    }
+    return value * full;
+}
+
+// Function to read the underrun count
+uint32_t sensor_sim_underruns(void) {
+    return sensor_sim_underrun_count;
+}
+
+#if FLASH_LOG
+// Replay task, copies the recorded samples into the FIFOs as they drain
+static void sensor_sim_task(void *argument) {
+    flash_log_frame_t frame;
+
+    (void)argument;
+    while (1) {
+        task_signal_wait(TASK_SIGNAL_SIM_REPLAY, portMAX_DELAY);
+        uint32_t first = sensor_sim_replay_from;
+        uint32_t sequence = first;
+        // The end of the recording, nothing is logged while it plays
+        uint32_t end = flash_log_next_sequence();
+        bool played = false;
+
+        while (sensor_sim_mode == SENSOR_SIM_REPLAY) {
+            if (task_signal_wait(TASK_SIGNAL_SIM_REPLAY, 0) != 0) {
+                // A new request replaces the running replay
+                first = sensor_sim_replay_from;
+                sequence = first;
+                played = false;
+            }
+            uint16_t size = flash_log_read(sequence, &frame);
+            if (size == 0 || (int32_t)(frame.sequence - end) >= 0) {
+                if (!played) {
+                    // No samples were recorded from first on
+                    break;
+                }
+                sequence = first;
+                played = false;
+                continue;
+            }
+            sequence = frame.sequence + 1U;
+
+            uint32_t channel;
+            uint32_t count = sensor_sim_unpack(&frame, size, &channel);
+            if (count == 0) {
+                continue;
+            }
+            played = true;
+            for (uint32_t i = 0; i < count && sensor_sim_mode == SENSOR_SIM_REPLAY; ++i) {
+                while (!sensor_sim_push(&sensor_sim_fifos[channel], sensor_sim_replay_codes[i]) &&
+                       sensor_sim_mode == SENSOR_SIM_REPLAY) {
+                    vTaskDelay(1);
+                }
+            }
+        }
+    }
+}
+
+// Function to copy the codes of a sample record, plain or packed, into
+// sensor_sim_replay_codes. Returns how many, 0 for any other record.
+static uint32_t sensor_sim_unpack(const flash_log_frame_t *frame, uint16_t size, uint32_t *channel) {
+    uint32_t payload_size = size - offsetof(flash_log_frame_t, payload);
+
+    if (frame->record_type == FLASH_LOG_RECORD_SAMPLES) {
+        flash_log_samples_t samples;
+        memcpy(&samples, frame->payload, sizeof(samples));
+        if (samples.channel >= SENSOR_COUNT || samples.count > FLASH_LOG_SAMPLES_MAX) {
+            return 0;
+        }
+        memcpy(sensor_sim_replay_codes, samples.codes, samples.count * sizeof(int16_t));
+        *channel = samples.channel;
+        return samples.count;
+    }
+    if (frame->record_type == FLASH_LOG_RECORD_SAMPLES_PACKED) {
+        flash_log_packed_t packed;
+        memcpy(&packed, frame->payload, sizeof(packed));
+        if (packed.channel >= SENSOR_COUNT || payload_size < offsetof(flash_log_packed_t, data)) {
+            return 0;
+        }
+        *channel = packed.channel;
+        return sample_codec_decode(packed.data, payload_size - offsetof(flash_log_packed_t, data),
+                                   sensor_sim_replay_codes, packed.count);
+    }
+    return 0;
+}
+#endif
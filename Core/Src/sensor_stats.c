@@ -0,0 +1,1092 @@
+/**
+  ******************************************************************************
+  * @file    sensor_stats.c
+  * @brief   Statistics kernels for the consumer task.
+  *
+  *          The batch kernels work on a contiguous array of samples, the
+  *          fused batch kernel walks a channel once for all of its moments. The
+  *          running_stats_* functions keep mean and variance up to date as
+  *          samples enter and leave the window, using Welford's update and
+  *          its inverse, in single precision only. The inverse rounds
+  *          differently from the update it undoes, so over a long slide the
+  *          window moments would drift. window_stats_* therefore runs a
+  *          second Welford that only ever adds, and takes it over as the
+  *          moments once the window has turned over: a resync per window,
+  *          paid as one more add per sample and never as a rescan. With
+  *          STATS_FIXED_POINT the window moments are exact integer sums of
+  *          the codes, running_stats_q15_*, and have nothing to resync.
+  *
+  *          weighted_stats_* is the same update with a weight per sample
+  *          (West). With STATS_TIME_WEIGHTED the window weights every sample
+  *          by the time it held until the next one, so a burst of samples
+  *          counts for the time it spans and not for its count, and a gap
+  *          for the time the last value stood. The weights come from the
+  *          sample timestamps, the moments are resynced like the others.
+  *
+  *          comoment_* extends the same update to the co-moment of two
+  *          channels. median_window_* keeps a sliding median with two
+  *          indexed heaps in O(log n) per sample and extremum_window_* a
+  *          sliding min/max with monotonic deques. order_histogram_* counts
+  *          int16 codes in coarse bins and finds any order statistic without
+  *          a comparison sort.
+  *
+  *          With STATS_USE_CMSIS_DSP the std dev/max/min batch kernels are
+  *          served by the CMSIS-DSP library instead of the loops below.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sensor_stats.h"
+#include "ram_func.h"
+#include <math.h>
+#include <string.h>
+#if STATS_USE_CMSIS_DSP
+#include "arm_math.h"
+#endif
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include "cmsis_compiler.h"
+#define STATS_Q15_DUAL_MAC 1
+#else
+#define STATS_Q15_DUAL_MAC 0
+#endif
+
+/* Private variables ---------------------------------------------------------*/
+// Samples a window had no slot for, written by the consumer task only
+static uint32_t window_stats_overflow_count;
+
+#if STATS_USE_CMSIS_DSP
+// Function to calculate standard deviation with CMSIS-DSP
+float calculate_std_dev(float data[], uint32_t count) {
+    float32_t std_dev;
+
+    if (count < 2) {
+        return 0.0f;
+    }
+    // arm_std_f32 divides by count - 1, scale back to the population deviation
+    arm_std_f32(data, count, &std_dev);
+    return std_dev * sqrtf((float)(count - 1) / (float)count);
+}
+
+// Function to find maximum value with CMSIS-DSP
+float calculate_max(float data[], uint32_t count) {
+    float32_t max;
+    uint32_t index;
+
+    arm_max_f32(data, count, &max, &index);
+    return max;
+}
+
+// Function to find minimum value with CMSIS-DSP
+float calculate_min(float data[], uint32_t count) {
+    float32_t min;
+    uint32_t index;
+
+    arm_min_f32(data, count, &min, &index);
+    return min;
+}
+#else
+// Function to calculate standard deviation
+RAMFUNC float calculate_std_dev(float data[], uint32_t count) {
+    float sum = 0.0f, mean, std_dev = 0.0f;
+
+    // Calculate sum
+    for(uint32_t i = 0; i < count; ++i) {
+        sum += data[i];
+    }
+
+    // Calculate mean
+    mean = sum / count;
+
+    // Calculate standard deviation
+    for(uint32_t i = 0; i < count; ++i) {
+        float deviation = data[i] - mean;
+        std_dev += deviation * deviation;
+    }
+
+    return sqrtf(std_dev / count);
+}
+
+// Function to find maximum value
+RAMFUNC float calculate_max(float data[], uint32_t count) {
+    float max = data[0];
+    for(uint32_t i = 1; i < count; ++i) {
+        if(data[i] > max) {
+            max = data[i];
+        }
+    }
+    return max;
+}
+
+// Function to find minimum value
+RAMFUNC float calculate_min(float data[], uint32_t count) {
+    float min = data[0];
+    for(uint32_t i = 1; i < count; ++i) {
+        if(data[i] < min) {
+            min = data[i];
+        }
+    }
+    return min;
+}
+#endif /* STATS_USE_CMSIS_DSP */
+
+// Function to exchange two samples
+static inline void swap_samples(float data[], int32_t a, int32_t b) {
+    float temp = data[a];
+    data[a] = data[b];
+    data[b] = temp;
+}
+
+// Function to move the k-th smallest value to data[k] with quickselect.
+// Afterwards nothing before k is larger and nothing after k is smaller.
+RAMFUNC static void select_kth(float data[], int32_t count, int32_t k) {
+    int32_t left = 0;
+    int32_t right = count - 1;
+
+    while (right > left) {
+        // Short ranges are cheaper to finish with an insertion sort
+        if (right - left < 16) {
+            for (int32_t i = left + 1; i <= right; ++i) {
+                float value = data[i];
+                int32_t j = i - 1;
+                while (j >= left && data[j] > value) {
+                    data[j + 1] = data[j];
+                    --j;
+                }
+                data[j + 1] = value;
+            }
+            return;
+        }
+
+        // Median of three pivot keeps sorted and constant windows linear
+        int32_t mid = left + (right - left) / 2;
+        if (data[mid] < data[left]) {
+            swap_samples(data, mid, left);
+        }
+        if (data[right] < data[left]) {
+            swap_samples(data, right, left);
+        }
+        if (data[right] < data[mid]) {
+            swap_samples(data, right, mid);
+        }
+        float pivot = data[mid];
+
+        // Hoare partition around the pivot
+        int32_t i = left;
+        int32_t j = right;
+        while (i <= j) {
+            while (data[i] < pivot) {
+                ++i;
+            }
+            while (data[j] > pivot) {
+                --j;
+            }
+            if (i <= j) {
+                swap_samples(data, i, j);
+                ++i;
+                --j;
+            }
+        }
+
+        // Continue only in the part that holds k
+        if (k <= j) {
+            right = j;
+        } else if (k >= i) {
+            left = i;
+        } else {
+            return;
+        }
+    }
+}
+
+// Function to find median value, reorders data in place
+RAMFUNC float calculate_median(float data[], uint32_t count) {
+    if (count == 0) {
+        return 0.0f;
+    }
+
+    uint32_t upper = count / 2;
+    select_kth(data, (int32_t)count, (int32_t)upper);
+
+    // If odd number of elements, return the middle value
+    if (count % 2 != 0) {
+        return data[upper];
+    }
+    // If even number of elements, the lower middle is the largest value before it
+    float lower = data[0];
+    for (uint32_t i = 1; i < upper; ++i) {
+        if (data[i] > lower) {
+            lower = data[i];
+        }
+    }
+    return (lower + data[upper]) * 0.5f;
+}
+
+/* Fused batch kernel --------------------------------------------------------*/
+// Function to clear the batch accumulators of a channel
+void batch_stats_reset(batch_stats_t *stats) {
+    stats->count = 0;
+    stats->shift = 0.0f;
+    stats->sum = 0.0f;
+    stats->sum_sq = 0.0f;
+    stats->min = 0.0f;
+    stats->max = 0.0f;
+}
+
+// Function to update the accumulators with a sample
+static inline void batch_stats_update(batch_stats_t *stats, float value) {
+    if (stats->count == 0) {
+        stats->shift = value;
+        stats->min = value;
+        stats->max = value;
+    }
+
+    float shifted = value - stats->shift;
+
+    stats->count++;
+    stats->sum += shifted;
+    stats->sum_sq += shifted * shifted;
+    if (value < stats->min) {
+        stats->min = value;
+    }
+    if (value > stats->max) {
+        stats->max = value;
+    }
+}
+
+// Function to accumulate sum, sum of squares, min and max of a channel in one pass
+RAMFUNC void batch_stats_accumulate(batch_stats_t *stats, const float *values, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        batch_stats_update(stats, values[i]);
+    }
+}
+
+// Function to get the population standard deviation of the batch
+float batch_stats_std_dev(const batch_stats_t *stats) {
+    if (stats->count == 0) {
+        return 0.0f;
+    }
+
+    float mean = stats->sum / (float)stats->count;
+    float variance = stats->sum_sq / (float)stats->count - mean * mean;
+    return variance > 0.0f ? sqrtf(variance) : 0.0f;
+}
+
+/* Fixed-point batch kernel --------------------------------------------------*/
+// Function to clear the integer accumulators of a channel
+void batch_stats_q15_reset(batch_stats_q15_t *stats) {
+    stats->count = 0;
+    stats->sum = 0;
+    stats->sum_sq = 0;
+    stats->min = INT16_MAX;
+    stats->max = INT16_MIN;
+}
+
+// Function to update the extrema with a sample
+static inline void batch_stats_q15_extrema(batch_stats_q15_t *stats, int16_t value) {
+    if (value < stats->min) {
+        stats->min = value;
+    }
+    if (value > stats->max) {
+        stats->max = value;
+    }
+}
+
+// Function to accumulate one sample at a time, the reference for the packed kernel
+RAMFUNC void batch_stats_q15_accumulate_scalar(batch_stats_q15_t *stats, const int16_t *values, uint32_t count) {
+    stats->count += count;
+    for (uint32_t i = 0; i < count; ++i) {
+        int32_t value = values[i];
+        stats->sum += value;
+        stats->sum_sq += (uint64_t)(value * value);
+        batch_stats_q15_extrema(stats, values[i]);
+    }
+}
+
+#if STATS_Q15_DUAL_MAC
+// Function to accumulate exact sum, sum of squares, min and max two samples at a time.
+// SMLALD adds both halfwords of a word into the 64-bit sums, the signed sum
+// wraps like the two's complement it is. SSUB16 sets the GE flag of each
+// lane and SEL picks that lane from either word, so the running min and max
+// are two lanes each without a branch. The lanes are merged at the end.
+RAMFUNC void batch_stats_q15_accumulate(batch_stats_q15_t *stats, const int16_t *values, uint32_t count) {
+    uint32_t pairs = count / 2;
+    uint64_t sum = (uint64_t)stats->sum;
+    uint64_t sum_sq = stats->sum_sq;
+    uint32_t min = (uint16_t)stats->min * 0x00010001U;
+    uint32_t max = (uint16_t)stats->max * 0x00010001U;
+
+    for (uint32_t i = 0; i < pairs; ++i) {
+        uint32_t pair;
+        // Halfword aligned only, the M4 handles the unaligned word load
+        memcpy(&pair, &values[2 * i], sizeof(pair));
+        sum = __SMLALD(pair, 0x00010001U, sum);
+        sum_sq = __SMLALD(pair, pair, sum_sq);
+        (void)__SSUB16(pair, max);
+        max = __SEL(pair, max);
+        (void)__SSUB16(min, pair);
+        min = __SEL(pair, min);
+    }
+    stats->count += 2 * pairs;
+    stats->sum = (int64_t)sum;
+    stats->sum_sq = sum_sq;
+    batch_stats_q15_extrema(stats, (int16_t)min);
+    batch_stats_q15_extrema(stats, (int16_t)(min >> 16));
+    batch_stats_q15_extrema(stats, (int16_t)max);
+    batch_stats_q15_extrema(stats, (int16_t)(max >> 16));
+    batch_stats_q15_accumulate_scalar(stats, &values[2 * pairs], count - 2 * pairs);
+}
+#else
+// Function to accumulate exact sum, sum of squares, min and max of int16 samples
+RAMFUNC void batch_stats_q15_accumulate(batch_stats_q15_t *stats, const int16_t *values, uint32_t count) {
+    batch_stats_q15_accumulate_scalar(stats, values, count);
+}
+#endif
+
+// Function to calculate the population standard deviation from the integer sums
+float batch_stats_q15_std_dev(const batch_stats_q15_t *stats) {
+    if (stats->count == 0) {
+        return 0.0f;
+    }
+
+    // n^2 variance is exact in 64 bits for any window that fits a ring
+    int64_t n = (int64_t)stats->count;
+    int64_t scaled = n * (int64_t)stats->sum_sq - stats->sum * stats->sum;
+    return scaled > 0 ? sqrtf((float)scaled) / (float)n : 0.0f;
+}
+
+// Function to exchange two integer samples
+static inline void swap_samples_q15(int16_t data[], int32_t a, int32_t b) {
+    int16_t temp = data[a];
+    data[a] = data[b];
+    data[b] = temp;
+}
+
+// Function to move the k-th smallest sample to data[k], select_kth for int16
+RAMFUNC static void select_kth_q15(int16_t data[], int32_t count, int32_t k) {
+    int32_t left = 0;
+    int32_t right = count - 1;
+
+    while (right > left) {
+        if (right - left < 16) {
+            for (int32_t i = left + 1; i <= right; ++i) {
+                int16_t value = data[i];
+                int32_t j = i - 1;
+                while (j >= left && data[j] > value) {
+                    data[j + 1] = data[j];
+                    --j;
+                }
+                data[j + 1] = value;
+            }
+            return;
+        }
+
+        int32_t mid = left + (right - left) / 2;
+        if (data[mid] < data[left]) {
+            swap_samples_q15(data, mid, left);
+        }
+        if (data[right] < data[left]) {
+            swap_samples_q15(data, right, left);
+        }
+        if (data[right] < data[mid]) {
+            swap_samples_q15(data, right, mid);
+        }
+        int16_t pivot = data[mid];
+
+        int32_t i = left;
+        int32_t j = right;
+        while (i <= j) {
+            while (data[i] < pivot) {
+                ++i;
+            }
+            while (data[j] > pivot) {
+                --j;
+            }
+            if (i <= j) {
+                swap_samples_q15(data, i, j);
+                ++i;
+                --j;
+            }
+        }
+
+        if (k <= j) {
+            right = j;
+        } else if (k >= i) {
+            left = i;
+        } else {
+            return;
+        }
+    }
+}
+
+// Function to find the median of int16 samples, reorders data in place
+RAMFUNC float calculate_median_q15(int16_t data[], uint32_t count) {
+    if (count == 0) {
+        return 0.0f;
+    }
+
+    uint32_t upper = count / 2;
+    select_kth_q15(data, (int32_t)count, (int32_t)upper);
+    if (count % 2 != 0) {
+        return (float)data[upper];
+    }
+    int16_t lower = data[0];
+    for (uint32_t i = 1; i < upper; ++i) {
+        if (data[i] > lower) {
+            lower = data[i];
+        }
+    }
+    return (float)((int32_t)lower + data[upper]) * 0.5f;
+}
+
+// Function to clear the running statistics
+void running_stats_reset(running_stats_t *stats) {
+    stats->count = 0;
+    stats->mean = 0.0f;
+    stats->m2 = 0.0f;
+}
+
+// Function to add a sample entering the window
+RAMFUNC void running_stats_add(running_stats_t *stats, float value) {
+    float delta = value - stats->mean;
+
+    stats->count++;
+    stats->mean += delta / (float)stats->count;
+    stats->m2 += delta * (value - stats->mean);
+}
+
+// Function to remove a sample leaving the window
+RAMFUNC void running_stats_remove(running_stats_t *stats, float value) {
+    if (stats->count <= 1) {
+        running_stats_reset(stats);
+        return;
+    }
+
+    float delta = value - stats->mean;
+
+    stats->count--;
+    stats->mean -= delta / (float)stats->count;
+    stats->m2 -= delta * (value - stats->mean);
+    // Rounding can leave a tiny negative residue when the window is constant
+    if (stats->m2 < 0.0f) {
+        stats->m2 = 0.0f;
+    }
+}
+
+// Function to get the mean of the window
+float running_stats_mean(const running_stats_t *stats) {
+    return stats->mean;
+}
+
+// Function to get the population standard deviation of the window
+float running_stats_std_dev(const running_stats_t *stats) {
+    if (stats->count == 0) {
+        return 0.0f;
+    }
+    return sqrtf(stats->m2 / (float)stats->count);
+}
+
+// Function to clear the weighted statistics
+void weighted_stats_reset(weighted_stats_t *stats) {
+    stats->count = 0;
+    stats->weight = 0.0f;
+    stats->mean = 0.0f;
+    stats->m2 = 0.0f;
+}
+
+// Function to add a sample of some weight entering the window
+RAMFUNC void weighted_stats_add(weighted_stats_t *stats, float value, float weight) {
+    float delta = value - stats->mean;
+
+    stats->count++;
+    stats->weight += weight;
+    stats->mean += delta * weight / stats->weight;
+    stats->m2 += weight * delta * (value - stats->mean);
+}
+
+// Function to remove a sample leaving the window with the weight it was added with
+RAMFUNC void weighted_stats_remove(weighted_stats_t *stats, float value, float weight) {
+    if (stats->count <= 1 || stats->weight <= weight) {
+        weighted_stats_reset(stats);
+        return;
+    }
+
+    float delta = value - stats->mean;
+
+    stats->count--;
+    stats->weight -= weight;
+    stats->mean -= delta * weight / stats->weight;
+    stats->m2 -= weight * delta * (value - stats->mean);
+    if (stats->m2 < 0.0f) {
+        stats->m2 = 0.0f;
+    }
+}
+
+// Function to get the weighted mean of the window
+float weighted_stats_mean(const weighted_stats_t *stats) {
+    return stats->mean;
+}
+
+// Function to get the weighted population standard deviation of the window
+float weighted_stats_std_dev(const weighted_stats_t *stats) {
+    if (stats->weight <= 0.0f) {
+        return 0.0f;
+    }
+    return sqrtf(stats->m2 / stats->weight);
+}
+
+// Function to clear the exact streaming moments
+void running_stats_q15_reset(running_stats_q15_t *stats) {
+    stats->count = 0;
+    stats->sum = 0;
+    stats->sum_sq = 0;
+}
+
+// Function to add a code entering the window
+RAMFUNC void running_stats_q15_add(running_stats_q15_t *stats, int16_t value) {
+    int32_t code = value;
+
+    stats->count++;
+    stats->sum += code;
+    stats->sum_sq += (uint64_t)(code * code);
+}
+
+// Function to remove a code leaving the window, exactly what its add added
+RAMFUNC void running_stats_q15_remove(running_stats_q15_t *stats, int16_t value) {
+    int32_t code = value;
+
+    if (stats->count == 0) {
+        return;
+    }
+    stats->count--;
+    stats->sum -= code;
+    stats->sum_sq -= (uint64_t)(code * code);
+}
+
+// Function to get the population standard deviation of the window codes
+float running_stats_q15_std_dev(const running_stats_q15_t *stats) {
+    if (stats->count == 0) {
+        return 0.0f;
+    }
+
+    // As batch_stats_q15_std_dev, n^2 variance is exact in 64 bits
+    int64_t n = (int64_t)stats->count;
+    int64_t scaled = n * (int64_t)stats->sum_sq - stats->sum * stats->sum;
+    return scaled > 0 ? sqrtf((float)scaled) / (float)n : 0.0f;
+}
+
+// Function to clear a co-moment
+void comoment_reset(comoment_t *stats) {
+    stats->count = 0;
+    stats->mean_x = 0.0f;
+    stats->mean_y = 0.0f;
+    stats->m2_x = 0.0f;
+    stats->m2_y = 0.0f;
+    stats->c_xy = 0.0f;
+}
+
+// Function to add a pair of samples, the co-moment takes the deviation of x
+// from the old mean times the one of y from the new mean
+RAMFUNC void comoment_add(comoment_t *stats, float x, float y) {
+    float delta_x = x - stats->mean_x;
+    float delta_y = y - stats->mean_y;
+
+    stats->count++;
+    stats->mean_x += delta_x / (float)stats->count;
+    stats->mean_y += delta_y / (float)stats->count;
+    stats->m2_x += delta_x * (x - stats->mean_x);
+    stats->m2_y += delta_y * (y - stats->mean_y);
+    stats->c_xy += delta_x * (y - stats->mean_y);
+}
+
+// Function to get the population covariance of the pairs
+float comoment_covariance(const comoment_t *stats) {
+    if (stats->count == 0) {
+        return 0.0f;
+    }
+    return stats->c_xy / (float)stats->count;
+}
+
+// Function to get the Pearson correlation of the pairs, 0 when either side is constant
+float comoment_correlation(const comoment_t *stats) {
+    float spread = stats->m2_x * stats->m2_y;
+
+    if (spread <= 0.0f) {
+        return 0.0f;
+    }
+    float correlation = stats->c_xy / sqrtf(spread);
+    // Rounding can push a perfect correlation just past 1
+    if (correlation > 1.0f) {
+        return 1.0f;
+    }
+    if (correlation < -1.0f) {
+        return -1.0f;
+    }
+    return correlation;
+}
+
+/* Sliding window median -----------------------------------------------------*/
+// The low heap is a max-heap holding the smaller half of the window, the
+// high heap a min-heap holding the larger half. Heaps store slot indices into
+// values[] and position[] tracks where each slot sits, so the oldest sample
+// can be removed from the middle of a heap in O(log n).
+
+// Function to check heap order between two slots
+static inline bool median_heap_before(const median_window_t *window, bool high, uint16_t a, uint16_t b) {
+    return high ? (window->values[a] < window->values[b]) : (window->values[a] > window->values[b]);
+}
+
+// Function to store a slot at a heap index and remember its position
+static inline void median_heap_set(median_window_t *window, bool high, uint16_t index, uint16_t slot) {
+    uint16_t *heap = high ? window->high : window->low;
+    heap[index] = slot;
+    window->position[slot] = index;
+    window->in_high[slot] = high;
+}
+
+// Function to move a slot towards the heap root
+RAMFUNC static void median_heap_sift_up(median_window_t *window, bool high, uint16_t index) {
+    uint16_t *heap = high ? window->high : window->low;
+    uint16_t slot = heap[index];
+
+    while (index > 0) {
+        uint16_t parent = (index - 1) / 2;
+        if (!median_heap_before(window, high, slot, heap[parent])) {
+            break;
+        }
+        median_heap_set(window, high, index, heap[parent]);
+        index = parent;
+    }
+    median_heap_set(window, high, index, slot);
+}
+
+// Function to move a slot towards the heap leaves
+RAMFUNC static void median_heap_sift_down(median_window_t *window, bool high, uint16_t index) {
+    uint16_t *heap = high ? window->high : window->low;
+    uint16_t size = high ? window->high_count : window->low_count;
+    uint16_t slot = heap[index];
+
+    while (1) {
+        uint16_t child = 2 * index + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && median_heap_before(window, high, heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!median_heap_before(window, high, heap[child], slot)) {
+            break;
+        }
+        median_heap_set(window, high, index, heap[child]);
+        index = child;
+    }
+    median_heap_set(window, high, index, slot);
+}
+
+// Function to insert a slot into one of the heaps
+RAMFUNC static void median_heap_insert(median_window_t *window, bool high, uint16_t slot) {
+    uint16_t index = high ? window->high_count++ : window->low_count++;
+    median_heap_set(window, high, index, slot);
+    median_heap_sift_up(window, high, index);
+}
+
+// Function to remove the slot at a heap index
+RAMFUNC static void median_heap_remove(median_window_t *window, bool high, uint16_t index) {
+    uint16_t *heap = high ? window->high : window->low;
+    uint16_t last = high ? --window->high_count : --window->low_count;
+
+    if (index == last) {
+        return;
+    }
+    // Fill the hole with the last leaf and restore order in either direction
+    uint16_t moved = heap[last];
+    median_heap_set(window, high, index, moved);
+    median_heap_sift_down(window, high, index);
+    median_heap_sift_up(window, high, window->position[moved]);
+}
+
+// Function to keep the low heap equal to or one larger than the high heap
+RAMFUNC static void median_heap_rebalance(median_window_t *window) {
+    if (window->low_count > window->high_count + 1) {
+        uint16_t slot = window->low[0];
+        median_heap_remove(window, false, 0);
+        median_heap_insert(window, true, slot);
+    } else if (window->high_count > window->low_count) {
+        uint16_t slot = window->high[0];
+        median_heap_remove(window, true, 0);
+        median_heap_insert(window, false, slot);
+    }
+}
+
+// Function to clear the sliding median
+void median_window_reset(median_window_t *window) {
+    window->low_count = 0;
+    window->high_count = 0;
+    window->oldest = 0;
+    window->count = 0;
+}
+
+#if STATS_ARENA
+// Function to take the arrays of the sliding median from an arena
+bool median_window_bind(median_window_t *window, arena_t *arena, uint16_t capacity) {
+    window->values = arena_alloc(arena, capacity * sizeof(float));
+    window->low = arena_alloc(arena, capacity * sizeof(uint16_t));
+    window->high = arena_alloc(arena, capacity * sizeof(uint16_t));
+    window->position = arena_alloc(arena, capacity * sizeof(uint16_t));
+    window->in_high = arena_alloc(arena, capacity * sizeof(uint8_t));
+    window->capacity = capacity;
+    return window->values != NULL && window->low != NULL && window->high != NULL && window->position != NULL &&
+           window->in_high != NULL;
+}
+#endif
+
+// Function to add a sample entering the window, dropped and counted when the window is full
+RAMFUNC void median_window_add(median_window_t *window, float value) {
+    if (window->count == STATS_WINDOW_SLOTS(window)) {
+        window_stats_overflow_count++;
+        return;
+    }
+
+    uint16_t slot = (window->oldest + window->count) % STATS_WINDOW_SLOTS(window);
+    window->values[slot] = value;
+    window->count++;
+
+    bool high = window->low_count > 0 && value > window->values[window->low[0]];
+    median_heap_insert(window, high, slot);
+    median_heap_rebalance(window);
+}
+
+// Function to remove the oldest sample from the window
+RAMFUNC void median_window_remove_oldest(median_window_t *window) {
+    if (window->count == 0) {
+        return;
+    }
+
+    uint16_t slot = window->oldest;
+    median_heap_remove(window, window->in_high[slot], window->position[slot]);
+    median_heap_rebalance(window);
+
+    window->oldest = (window->oldest + 1) % STATS_WINDOW_SLOTS(window);
+    window->count--;
+}
+
+// Function to get the median of the window
+float median_window_median(const median_window_t *window) {
+    if (window->count == 0) {
+        return 0.0f;
+    }
+    if (window->low_count > window->high_count) {
+        return window->values[window->low[0]];
+    }
+    return (window->values[window->low[0]] + window->values[window->high[0]]) * 0.5f;
+}
+
+/* Histogram order statistics -----------------------------------------------*/
+// Codes are counted by their top 8 bits, so the bins need no range setup and
+// cost 512 bytes whatever the window. A rank is found in the coarse bins, the
+// rest of the code is then taken 4 bits at a time from a 16-bin count of the
+// window codes that share the bits found so far. Two scans of the window and
+// a walk of the bins, no sort and no copy of the window.
+#define ORDER_HISTOGRAM_DIGIT_BITS 4U
+#define ORDER_HISTOGRAM_DIGITS (1U << ORDER_HISTOGRAM_DIGIT_BITS)
+
+// Function to map a code to an unsigned key in the same order
+static inline uint32_t order_histogram_key(int16_t code) {
+    return (uint16_t)code ^ 0x8000U;
+}
+
+// Function to clear the histogram
+void order_histogram_reset(order_histogram_t *histogram) {
+    memset(histogram->bins, 0, sizeof(histogram->bins));
+    histogram->count = 0;
+}
+
+// Function to count a code entering the window
+RAMFUNC void order_histogram_add(order_histogram_t *histogram, int16_t code) {
+    histogram->bins[order_histogram_key(code) >> ORDER_HISTOGRAM_SHIFT]++;
+    histogram->count++;
+}
+
+// Function to uncount a code leaving the window
+RAMFUNC void order_histogram_remove(order_histogram_t *histogram, int16_t code) {
+    uint16_t *bin = &histogram->bins[order_histogram_key(code) >> ORDER_HISTOGRAM_SHIFT];
+
+    if (*bin == 0) {
+        return;
+    }
+    (*bin)--;
+    histogram->count--;
+}
+
+// Function to count the codes of a span that share prefix above shift, by the digit below it
+RAMFUNC static void order_histogram_refine(uint16_t *digits, const int16_t *codes, uint32_t count,
+                                           uint32_t prefix, uint32_t shift) {
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t key = order_histogram_key(codes[i]);
+        if ((key >> (shift + ORDER_HISTOGRAM_DIGIT_BITS)) == prefix) {
+            digits[(key >> shift) & (ORDER_HISTOGRAM_DIGITS - 1U)]++;
+        }
+    }
+}
+
+// Function to find the code of a rank, 0 for the smallest. The spans are the
+// codes the histogram counts, in any order.
+RAMFUNC int16_t order_histogram_select(const order_histogram_t *histogram, uint32_t rank, const int16_t *first,
+                                       uint32_t first_count, const int16_t *second, uint32_t second_count) {
+    uint32_t prefix = 0;
+
+    if (histogram->count == 0) {
+        return 0;
+    }
+    if (rank >= histogram->count) {
+        rank = histogram->count - 1U;
+    }
+    while (prefix < ORDER_HISTOGRAM_BINS - 1U && rank >= histogram->bins[prefix]) {
+        rank -= histogram->bins[prefix];
+        prefix++;
+    }
+    for (uint32_t shift = ORDER_HISTOGRAM_SHIFT; shift > 0;) {
+        uint16_t digits[ORDER_HISTOGRAM_DIGITS] = { 0 };
+        uint32_t digit = 0;
+
+        shift -= ORDER_HISTOGRAM_DIGIT_BITS;
+        order_histogram_refine(digits, first, first_count, prefix, shift);
+        order_histogram_refine(digits, second, second_count, prefix, shift);
+        while (digit < ORDER_HISTOGRAM_DIGITS - 1U && rank >= digits[digit]) {
+            rank -= digits[digit];
+            digit++;
+        }
+        prefix = (prefix << ORDER_HISTOGRAM_DIGIT_BITS) | digit;
+    }
+    return (int16_t)(uint16_t)(prefix ^ 0x8000U);
+}
+
+// Function to find a percentile, p from 0 to 1, interpolated between the two
+// nearest ranks. p = 0.5 is the median, the mean of the middle two for an
+// even count.
+float order_histogram_percentile(const order_histogram_t *histogram, float p, const int16_t *first,
+                                 uint32_t first_count, const int16_t *second, uint32_t second_count) {
+    if (histogram->count == 0) {
+        return 0.0f;
+    }
+    p = p < 0.0f ? 0.0f : (p > 1.0f ? 1.0f : p);
+
+    float position = p * (float)(histogram->count - 1U);
+    uint32_t lower = (uint32_t)position;
+    float fraction = position - (float)lower;
+    float value = (float)order_histogram_select(histogram, lower, first, first_count, second, second_count);
+
+    if (fraction > 0.0f && lower + 1U < histogram->count) {
+        float upper = (float)order_histogram_select(histogram, lower + 1U, first, first_count, second, second_count);
+        value += (upper - value) * fraction;
+    }
+    return value;
+}
+
+/* Sliding minimum and maximum -----------------------------------------------*/
+// Each deque only keeps samples that can still become the extremum: a new
+// sample evicts every older one it dominates from the back, and the front
+// leaves once it falls out of the window. Every sample is pushed and popped
+// at most once, so updates are O(1) amortized.
+
+// Function to append a sample, dropping the ones it makes irrelevant
+RAMFUNC static void monotonic_deque_push(monotonic_deque_t *deque, bool is_max, float value, uint32_t sequence) {
+    while (deque->count > 0) {
+        uint16_t back = (deque->front + deque->count - 1) % STATS_WINDOW_SLOTS(deque);
+        if (is_max ? (deque->value[back] > value) : (deque->value[back] < value)) {
+            break;
+        }
+        deque->count--;
+    }
+    // Every slot holds a sample that still dominates, the next one would wrap onto the front
+    if (deque->count == STATS_WINDOW_SLOTS(deque)) {
+        window_stats_overflow_count++;
+        return;
+    }
+
+    uint16_t slot = (deque->front + deque->count) % STATS_WINDOW_SLOTS(deque);
+    deque->value[slot] = value;
+    deque->sequence[slot] = sequence;
+    deque->count++;
+}
+
+// Function to drop the front once it is older than the window
+RAMFUNC static void monotonic_deque_expire(monotonic_deque_t *deque, uint32_t oldest_sequence) {
+    if (deque->count > 0 && (int32_t)(deque->sequence[deque->front] - oldest_sequence) < 0) {
+        deque->front = (deque->front + 1) % STATS_WINDOW_SLOTS(deque);
+        deque->count--;
+    }
+}
+
+// Function to clear the sliding min/max
+void extremum_window_reset(extremum_window_t *window) {
+    window->max.front = 0;
+    window->max.count = 0;
+    window->min.front = 0;
+    window->min.count = 0;
+    window->next_sequence = 0;
+    window->oldest_sequence = 0;
+}
+
+#if STATS_ARENA
+// Function to take the arrays of a min/max deque from an arena
+static bool monotonic_deque_bind(monotonic_deque_t *deque, arena_t *arena, uint16_t capacity) {
+    deque->value = arena_alloc(arena, capacity * sizeof(float));
+    deque->sequence = arena_alloc(arena, capacity * sizeof(uint32_t));
+    deque->capacity = capacity;
+    return deque->value != NULL && deque->sequence != NULL;
+}
+#endif
+
+// Function to add a sample entering the window
+RAMFUNC void extremum_window_add(extremum_window_t *window, float value) {
+    monotonic_deque_push(&window->max, true, value, window->next_sequence);
+    monotonic_deque_push(&window->min, false, value, window->next_sequence);
+    window->next_sequence++;
+}
+
+// Function to remove the oldest sample from the window
+RAMFUNC void extremum_window_remove_oldest(extremum_window_t *window) {
+    if (window->oldest_sequence == window->next_sequence) {
+        return;
+    }
+    window->oldest_sequence++;
+    monotonic_deque_expire(&window->max, window->oldest_sequence);
+    monotonic_deque_expire(&window->min, window->oldest_sequence);
+}
+
+// Function to get the maximum of the window
+float extremum_window_max(const extremum_window_t *window) {
+    return window->max.count > 0 ? window->max.value[window->max.front] : 0.0f;
+}
+
+// Function to get the minimum of the window
+float extremum_window_min(const extremum_window_t *window) {
+    return window->min.count > 0 ? window->min.value[window->min.front] : 0.0f;
+}
+
+// Function to read the samples a window had no slot for
+uint32_t window_stats_overflows(void) {
+    return window_stats_overflow_count;
+}
+
+/* Per-channel window --------------------------------------------------------*/
+// Function to clear all streaming statistics of a channel
+void window_stats_reset(window_stats_t *stats) {
+#if STATS_FIXED_POINT
+    running_stats_q15_reset(&stats->moments);
+#else
+    running_stats_reset(&stats->moments);
+    running_stats_reset(&stats->shadow);
+    stats->resync_pending = 0;
+#endif
+#if STATS_TIME_WEIGHTED
+    weighted_stats_reset(&stats->timed);
+    weighted_stats_reset(&stats->timed_shadow);
+    stats->timed_pending = 0;
+#endif
+#if STATS_HISTOGRAM_MEDIAN
+    order_histogram_reset(&stats->histogram);
+#else
+    median_window_reset(&stats->median);
+#endif
+    extremum_window_reset(&stats->extremum);
+}
+
+#if STATS_ARENA
+// Function to take the arrays of every streaming kernel of a channel from an arena
+bool window_stats_bind(window_stats_t *stats, arena_t *arena, uint16_t capacity) {
+    bool bound = true;
+
+#if !STATS_HISTOGRAM_MEDIAN
+    bound &= median_window_bind(&stats->median, arena, capacity);
+#endif
+    bound &= monotonic_deque_bind(&stats->extremum.max, arena, capacity);
+    bound &= monotonic_deque_bind(&stats->extremum.min, arena, capacity);
+    return bound;
+}
+#endif
+
+// Function to add a sample entering the channel window
+RAMFUNC void window_stats_add(window_stats_t *stats, float value) {
+#if STATS_FIXED_POINT
+    // The window holds int16 codes, passed here as float
+    running_stats_q15_add(&stats->moments, (int16_t)value);
+#else
+    running_stats_add(&stats->moments, value);
+    running_stats_add(&stats->shadow, value);
+#endif
+#if STATS_HISTOGRAM_MEDIAN
+    order_histogram_add(&stats->histogram, (int16_t)value);
+#else
+    median_window_add(&stats->median, value);
+#endif
+    extremum_window_add(&stats->extremum, value);
+}
+
+// Function to remove the oldest sample from the channel window
+RAMFUNC void window_stats_remove_oldest(window_stats_t *stats, float oldest_value) {
+#if STATS_FIXED_POINT
+    running_stats_q15_remove(&stats->moments, (int16_t)oldest_value);
+#else
+    if (stats->resync_pending == 0) {
+        // Every sample older than the shadow has left, it holds the window
+        // exactly and replaces the moments, then starts over empty
+        stats->moments = stats->shadow;
+        running_stats_reset(&stats->shadow);
+        stats->resync_pending = stats->moments.count;
+    }
+    stats->resync_pending--;
+    running_stats_remove(&stats->moments, oldest_value);
+#endif
+#if STATS_HISTOGRAM_MEDIAN
+    order_histogram_remove(&stats->histogram, (int16_t)oldest_value);
+#else
+    median_window_remove_oldest(&stats->median);
+#endif
+    extremum_window_remove_oldest(&stats->extremum);
+}
+
+// Function to get the population standard deviation of the channel window
+float window_stats_std_dev(const window_stats_t *stats) {
+#if STATS_FIXED_POINT
+    return running_stats_q15_std_dev(&stats->moments);
+#else
+    return running_stats_std_dev(&stats->moments);
+#endif
+}
+
+#if STATS_TIME_WEIGHTED
+// Function to weight a window sample by the time it held
+RAMFUNC void window_stats_hold(window_stats_t *stats, float value, float held_ms) {
+    if (held_ms <= 0.0f) {
+        return;
+    }
+    weighted_stats_add(&stats->timed, value, held_ms);
+    weighted_stats_add(&stats->timed_shadow, value, held_ms);
+}
+
+// Function to take the hold of the oldest window sample out before it leaves
+RAMFUNC void window_stats_release(window_stats_t *stats, float value, float held_ms) {
+    if (held_ms <= 0.0f) {
+        return;
+    }
+    if (stats->timed_pending == 0) {
+        // As in window_stats_remove_oldest, the shadow holds the window exactly
+        stats->timed = stats->timed_shadow;
+        weighted_stats_reset(&stats->timed_shadow);
+        stats->timed_pending = stats->timed.count;
+    }
+    stats->timed_pending--;
+    weighted_stats_remove(&stats->timed, value, held_ms);
+}
+
+// Function to get the time-weighted mean of the channel window
+float window_stats_time_mean(const window_stats_t *stats) {
+    return weighted_stats_mean(&stats->timed);
+}
+
+// Function to get the time-weighted population standard deviation of the channel window
+float window_stats_time_std_dev(const window_stats_t *stats) {
+    return weighted_stats_std_dev(&stats->timed);
+}
+#endif
@@ -0,0 +1,332 @@
+/**
+  ******************************************************************************
+  * @file    spectral_analysis.c
+  * @brief   FFT of the raw ADC conversions of one channel, peaks and band energies.
+  *
+  *          The window statistics cannot tell a steady light from one that
+  *          flickers at 100 Hz, the mean of a thousand conversions is the
+  *          same. The ADC1 DMA interrupts copy the conversions of the channel
+  *          into one of two blocks at the scan rate. When a block is full it
+  *          becomes the newest one, unless the consumer is still reading the
+  *          previous one, in which case it is filled again. At its report
+  *          the consumer removes the mean of the newest block, applies a
+  *          Hann window and takes a real FFT. It then sends the strongest
+  *          peaks, interpolated between the bins, and the share of the AC
+  *          energy in each octave band.
+  *
+  *          With STATS_USE_CMSIS_DSP the FFT is arm_rfft_fast_f32, whose
+  *          twiddle tables are const and stay in flash. Otherwise a radix-2
+  *          FFT of half the size runs over the even and odd samples packed
+  *          as complex values and is split into the real spectrum. Its
+  *          twiddles and the window come from a quarter-wave sine table of
+  *          257 words, also const in flash, so no table is built in RAM
+  *          whatever the size. There is no analog anti-alias filter, content
+  *          above half the scan rate folds back into the spectrum.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "spectral_analysis.h"
+#include "cmsis_os.h"
+#include "main.h"
+#include "sensor_registry.h"
+#include "stats_frame.h"
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#if STATS_USE_CMSIS_DSP
+#include "arm_math.h"
+#endif
+
+/* Private defines -----------------------------------------------------------*/
+// Steps of the sine table per turn
+#define SPECTRAL_TABLE_TURN 1024U
+#define SPECTRAL_BINS (SPECTRAL_ANALYSIS_SIZE / 2U)
+// Amplitude of a sinusoid over its Hann-windowed bin magnitude, 2 / (N x 0.5)
+#define SPECTRAL_HANN_AMPLITUDE (4.0f / SPECTRAL_ANALYSIS_SIZE)
+
+/* Private variables ---------------------------------------------------------*/
+// sin(2 pi t / 1024) for t = 0 to 256
+static const float spectral_sine[SPECTRAL_TABLE_TURN / 4U + 1U] = {
+    0.00000000f, 0.00613588f, 0.01227154f, 0.01840673f, 0.02454123f, 0.03067480f, 0.03680722f, 0.04293826f,
+    0.04906767f, 0.05519524f, 0.06132074f, 0.06744392f, 0.07356456f, 0.07968244f, 0.08579731f, 0.09190896f,
+    0.09801714f, 0.10412163f, 0.11022221f, 0.11631863f, 0.12241068f, 0.12849811f, 0.13458071f, 0.14065824f,
+    0.14673047f, 0.15279719f, 0.15885814f, 0.16491312f, 0.17096189f, 0.17700422f, 0.18303989f, 0.18906866f,
+    0.19509032f, 0.20110463f, 0.20711138f, 0.21311032f, 0.21910124f, 0.22508391f, 0.23105811f, 0.23702361f,
+    0.24298018f, 0.24892761f, 0.25486566f, 0.26079412f, 0.26671276f, 0.27262136f, 0.27851969f, 0.28440754f,
+    0.29028468f, 0.29615089f, 0.30200595f, 0.30784964f, 0.31368174f, 0.31950203f, 0.32531029f, 0.33110631f,
+    0.33688985f, 0.34266072f, 0.34841868f, 0.35416353f, 0.35989504f, 0.36561300f, 0.37131719f, 0.37700741f,
+    0.38268343f, 0.38834505f, 0.39399204f, 0.39962420f, 0.40524131f, 0.41084317f, 0.41642956f, 0.42200027f,
+    0.42755509f, 0.43309382f, 0.43861624f, 0.44412214f, 0.44961133f, 0.45508359f, 0.46053871f, 0.46597650f,
+    0.47139674f, 0.47679923f, 0.48218377f, 0.48755016f, 0.49289819f, 0.49822767f, 0.50353838f, 0.50883014f,
+    0.51410274f, 0.51935599f, 0.52458968f, 0.52980362f, 0.53499762f, 0.54017147f, 0.54532499f, 0.55045797f,
+    0.55557023f, 0.56066158f, 0.56573181f, 0.57078075f, 0.57580819f, 0.58081396f, 0.58579786f, 0.59075970f,
+    0.59569930f, 0.60061648f, 0.60551104f, 0.61038281f, 0.61523159f, 0.62005721f, 0.62485949f, 0.62963824f,
+    0.63439328f, 0.63912444f, 0.64383154f, 0.64851440f, 0.65317284f, 0.65780669f, 0.66241578f, 0.66699992f,
+    0.67155895f, 0.67609270f, 0.68060100f, 0.68508367f, 0.68954054f, 0.69397146f, 0.69837625f, 0.70275474f,
+    0.70710678f, 0.71143220f, 0.71573083f, 0.72000251f, 0.72424708f, 0.72846439f, 0.73265427f, 0.73681657f,
+    0.74095113f, 0.74505779f, 0.74913639f, 0.75318680f, 0.75720885f, 0.76120239f, 0.76516727f, 0.76910334f,
+    0.77301045f, 0.77688847f, 0.78073723f, 0.78455660f, 0.78834643f, 0.79210658f, 0.79583690f, 0.79953727f,
+    0.80320753f, 0.80684755f, 0.81045720f, 0.81403633f, 0.81758481f, 0.82110251f, 0.82458930f, 0.82804505f,
+    0.83146961f, 0.83486287f, 0.83822471f, 0.84155498f, 0.84485357f, 0.84812034f, 0.85135519f, 0.85455799f,
+    0.85772861f, 0.86086694f, 0.86397286f, 0.86704625f, 0.87008699f, 0.87309498f, 0.87607009f, 0.87901223f,
+    0.88192126f, 0.88479710f, 0.88763962f, 0.89044872f, 0.89322430f, 0.89596625f, 0.89867447f, 0.90134885f,
+    0.90398929f, 0.90659570f, 0.90916798f, 0.91170603f, 0.91420976f, 0.91667906f, 0.91911385f, 0.92151404f,
+    0.92387953f, 0.92621024f, 0.92850608f, 0.93076696f, 0.93299280f, 0.93518351f, 0.93733901f, 0.93945922f,
+    0.94154407f, 0.94359346f, 0.94560733f, 0.94758559f, 0.94952818f, 0.95143502f, 0.95330604f, 0.95514117f,
+    0.95694034f, 0.95870347f, 0.96043052f, 0.96212140f, 0.96377607f, 0.96539444f, 0.96697647f, 0.96852209f,
+    0.97003125f, 0.97150389f, 0.97293995f, 0.97433938f, 0.97570213f, 0.97702814f, 0.97831737f, 0.97956977f,
+    0.98078528f, 0.98196387f, 0.98310549f, 0.98421009f, 0.98527764f, 0.98630810f, 0.98730142f, 0.98825757f,
+    0.98917651f, 0.99005821f, 0.99090264f, 0.99170975f, 0.99247953f, 0.99321195f, 0.99390697f, 0.99456457f,
+    0.99518473f, 0.99576741f, 0.99631261f, 0.99682030f, 0.99729046f, 0.99772307f, 0.99811811f, 0.99847558f,
+    0.99879546f, 0.99907773f, 0.99932238f, 0.99952942f, 0.99969882f, 0.99983058f, 0.99992470f, 0.99998118f,
+    1.00000000f
+};
+
+// Written by the DMA interrupts, the consumer reads the newest one
+static uint16_t spectral_blocks[2][SPECTRAL_ANALYSIS_SIZE] CCMRAM;
+static uint32_t spectral_fill_block;
+static uint32_t spectral_fill_count;
+static volatile uint32_t spectral_ready_block;
+static volatile bool spectral_ready;
+static volatile bool spectral_held;
+
+static float spectral_work[SPECTRAL_ANALYSIS_SIZE] CCMRAM;
+static float spectral_power[SPECTRAL_BINS] CCMRAM;
+#if STATS_USE_CMSIS_DSP
+static float spectral_out[SPECTRAL_ANALYSIS_SIZE] CCMRAM;
+static arm_rfft_fast_instance_f32 spectral_rfft;
+#endif
+
+// Function to read sin(2 pi t / 1024) from the quarter wave
+static float spectral_sin(uint32_t t) {
+    t %= SPECTRAL_TABLE_TURN;
+    if (t <= SPECTRAL_TABLE_TURN / 4U) {
+        return spectral_sine[t];
+    }
+    if (t <= SPECTRAL_TABLE_TURN / 2U) {
+        return spectral_sine[SPECTRAL_TABLE_TURN / 2U - t];
+    }
+    if (t <= 3U * SPECTRAL_TABLE_TURN / 4U) {
+        return -spectral_sine[t - SPECTRAL_TABLE_TURN / 2U];
+    }
+    return -spectral_sine[SPECTRAL_TABLE_TURN - t];
+}
+
+// Function to read cos(2 pi t / 1024)
+static float spectral_cos(uint32_t t) {
+    return spectral_sin(t + SPECTRAL_TABLE_TURN / 4U);
+}
+
+// Function to check the channel and clear the blocks
+void spectral_analysis_init(void) {
+    if (sensor_registry[SPECTRAL_ANALYSIS_CHANNEL].source != SENSOR_SOURCE_ADC) {
+        Error_Handler();
+    }
+    spectral_fill_block = 0;
+    spectral_fill_count = 0;
+    spectral_ready = false;
+    spectral_held = false;
+#if STATS_USE_CMSIS_DSP
+    if (arm_rfft_fast_init_f32(&spectral_rfft, SPECTRAL_ANALYSIS_SIZE) != ARM_MATH_SUCCESS) {
+        Error_Handler();
+    }
+#endif
+}
+
+// Function to copy the conversions of the channel into the block being filled
+void spectral_analysis_collect_from_isr(const uint16_t *conversions, uint32_t count, uint32_t stride) {
+    uint16_t *block = spectral_blocks[spectral_fill_block];
+
+    for (uint32_t i = 0; i < count; ++i, conversions += stride) {
+        block[spectral_fill_count++] = *conversions;
+        if (spectral_fill_count < SPECTRAL_ANALYSIS_SIZE) {
+            continue;
+        }
+        spectral_fill_count = 0;
+        // A block the consumer holds is kept, this one is filled again
+        if (!spectral_held) {
+            spectral_ready_block = spectral_fill_block;
+            spectral_ready = true;
+            spectral_fill_block ^= 1U;
+            block = spectral_blocks[spectral_fill_block];
+        }
+    }
+}
+
+#if STATS_USE_CMSIS_DSP
+// Function to turn the windowed block into bin powers with CMSIS-DSP
+static void spectral_power_spectrum(void) {
+    arm_rfft_fast_f32(&spectral_rfft, spectral_work, spectral_out, 0);
+    // out[0] and out[1] are the DC and Nyquist bins, then re, im per bin
+    spectral_power[0] = spectral_out[0] * spectral_out[0];
+    for (uint32_t k = 1; k < SPECTRAL_BINS; ++k) {
+        float re = spectral_out[2U * k];
+        float im = spectral_out[2U * k + 1U];
+        spectral_power[k] = re * re + im * im;
+    }
+}
+#else
+// Function to run an in-place radix-2 FFT over count complex values
+static void spectral_complex_fft(float *data, uint32_t count) {
+    // Bit-reversed order
+    for (uint32_t i = 1, j = 0; i < count; ++i) {
+        uint32_t bit = count >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            float re = data[2U * i], im = data[2U * i + 1U];
+            data[2U * i] = data[2U * j];
+            data[2U * i + 1U] = data[2U * j + 1U];
+            data[2U * j] = re;
+            data[2U * j + 1U] = im;
+        }
+    }
+    for (uint32_t length = 2; length <= count; length <<= 1) {
+        uint32_t half = length / 2U;
+        uint32_t step = SPECTRAL_TABLE_TURN / length;
+        for (uint32_t j = 0; j < half; ++j) {
+            float wr = spectral_cos(j * step);
+            float wi = -spectral_sin(j * step);
+            for (uint32_t i = j; i < count; i += length) {
+                float *u = &data[2U * i];
+                float *v = &data[2U * (i + half)];
+                float vr = v[0] * wr - v[1] * wi;
+                float vi = v[0] * wi + v[1] * wr;
+                v[0] = u[0] - vr;
+                v[1] = u[1] - vi;
+                u[0] += vr;
+                u[1] += vi;
+            }
+        }
+    }
+}
+
+// Function to turn the windowed block into bin powers, the even and odd
+// samples are the real and imaginary parts of a half-size complex FFT
+static void spectral_power_spectrum(void) {
+    const float *z = spectral_work;
+
+    spectral_complex_fft(spectral_work, SPECTRAL_BINS);
+    spectral_power[0] = (z[0] + z[1]) * (z[0] + z[1]);
+    for (uint32_t k = 1; k < SPECTRAL_BINS; ++k) {
+        uint32_t m = SPECTRAL_BINS - k;
+        // Spectra of the even and odd samples from Z[k] and conj(Z[M - k])
+        float even_re = 0.5f * (z[2U * k] + z[2U * m]);
+        float even_im = 0.5f * (z[2U * k + 1U] - z[2U * m + 1U]);
+        float odd_re = 0.5f * (z[2U * k + 1U] + z[2U * m + 1U]);
+        float odd_im = -0.5f * (z[2U * k] - z[2U * m]);
+        uint32_t t = k * (SPECTRAL_TABLE_TURN / SPECTRAL_ANALYSIS_SIZE);
+        float wr = spectral_cos(t);
+        float wi = -spectral_sin(t);
+        float re = even_re + odd_re * wr - odd_im * wi;
+        float im = even_im + odd_re * wi + odd_im * wr;
+        spectral_power[k] = re * re + im * im;
+    }
+}
+#endif
+
+// Function to keep the strongest local maxima of the spectrum, strongest first
+static uint32_t spectral_find_peaks(uint32_t bins[SPECTRAL_ANALYSIS_PEAKS]) {
+    uint32_t found = 0;
+
+    for (uint32_t k = 1; k < SPECTRAL_BINS; ++k) {
+        float p = spectral_power[k];
+        float next = k + 1U < SPECTRAL_BINS ? spectral_power[k + 1U] : 0.0f;
+        if (!(p > spectral_power[k - 1U] && p >= next)) {
+            continue;
+        }
+        uint32_t slot = found < SPECTRAL_ANALYSIS_PEAKS ? found++ : SPECTRAL_ANALYSIS_PEAKS;
+        for (; slot > 0 && spectral_power[bins[slot - 1U]] < p; --slot) {
+            if (slot < SPECTRAL_ANALYSIS_PEAKS) {
+                bins[slot] = bins[slot - 1U];
+            }
+        }
+        if (slot < SPECTRAL_ANALYSIS_PEAKS) {
+            bins[slot] = k;
+        }
+    }
+    return found;
+}
+
+// Function to place a peak between its bins with a parabola through the magnitudes
+static void spectral_peak(uint32_t k, spectral_peak_t *peak) {
+    float a = sqrtf(spectral_power[k - 1U]);
+    float b = sqrtf(spectral_power[k]);
+    float c = k + 1U < SPECTRAL_BINS ? sqrtf(spectral_power[k + 1U]) : 0.0f;
+    float curvature = a - 2.0f * b + c;
+    float offset = curvature < 0.0f ? 0.5f * (a - c) / curvature : 0.0f;
+
+    if (offset > 0.5f) {
+        offset = 0.5f;
+    } else if (offset < -0.5f) {
+        offset = -0.5f;
+    }
+    float frequency = ((float)k + offset) * (float)ADC_ACQUISITION_RATE_HZ / (float)SPECTRAL_ANALYSIS_SIZE;
+    peak->frequency_dhz = (uint16_t)(frequency * 10.0f + 0.5f);
+    peak->amplitude = stats_frame_float_to_half(b * SPECTRAL_HANN_AMPLITUDE);
+}
+
+// Function to analyse the newest block
+uint16_t spectral_analysis_build(spectral_frame_t *frame) {
+    taskENTER_CRITICAL();
+    bool ready = spectral_ready;
+    spectral_ready = false;
+    spectral_held = ready;
+    const uint16_t *block = spectral_blocks[spectral_ready_block];
+    taskEXIT_CRITICAL();
+    if (!ready) {
+        return 0;
+    }
+
+    float sum = 0.0f;
+    for (uint32_t n = 0; n < SPECTRAL_ANALYSIS_SIZE; ++n) {
+        sum += (float)block[n];
+    }
+    float mean = sum / SPECTRAL_ANALYSIS_SIZE;
+    float square_sum = 0.0f;
+    for (uint32_t n = 0; n < SPECTRAL_ANALYSIS_SIZE; ++n) {
+        float x = (float)block[n] - mean;
+        // Hann window sin^2(pi n / N), the table has the half turn
+        float w = spectral_sin(n * (SPECTRAL_TABLE_TURN / 2U) / SPECTRAL_ANALYSIS_SIZE);
+        square_sum += x * x;
+        spectral_work[n] = x * w * w;
+    }
+    // The block is copied, the interrupts may hand out the next one
+    spectral_held = false;
+
+    memset(frame, 0, sizeof(*frame));
+    frame->type = SPECTRAL_FRAME_TYPE;
+    frame->version = SPECTRAL_FRAME_VERSION;
+    frame->channel = SPECTRAL_ANALYSIS_CHANNEL;
+    frame->band_count = SPECTRAL_ANALYSIS_BANDS;
+    frame->sample_rate_hz = ADC_ACQUISITION_RATE_HZ;
+    frame->size = SPECTRAL_ANALYSIS_SIZE;
+    frame->mean = stats_frame_float_to_half(mean);
+    frame->rms = stats_frame_float_to_half(sqrtf(square_sum / SPECTRAL_ANALYSIS_SIZE));
+
+    spectral_power_spectrum();
+
+    uint32_t bins[SPECTRAL_ANALYSIS_PEAKS];
+    uint32_t found = spectral_find_peaks(bins);
+    for (uint32_t i = 0; i < found; ++i) {
+        spectral_peak(bins[i], &frame->peaks[i]);
+    }
+
+    float total = 0.0f;
+    float bands[SPECTRAL_ANALYSIS_BANDS] = {0};
+    for (uint32_t band = 0, k = 1; band < SPECTRAL_ANALYSIS_BANDS; ++band) {
+        for (; k < (2U << band) && k < SPECTRAL_BINS; ++k) {
+            bands[band] += spectral_power[k];
+        }
+        total += bands[band];
+    }
+    if (total > 0.0f) {
+        for (uint32_t band = 0; band < SPECTRAL_ANALYSIS_BANDS; ++band) {
+            frame->band_share[band] = (uint16_t)(bands[band] / total * 65535.0f + 0.5f);
+        }
+    }
+    return sizeof(*frame);
+}
@@ -0,0 +1,124 @@
+/**
+  ******************************************************************************
+  * @file    stack_profile.c
+  * @brief   Stack overflow checking and per-task stack usage frame.
+  *
+  *          The kernel fills every task stack with 0xA5 when the task is
+  *          created and configCHECK_FOR_STACK_OVERFLOW 2 checks the last
+  *          words of the stack on every switch out, see
+  *          vApplicationStackOverflowHook in freertos.c. The high water mark
+  *          of a task is the run of fill bytes that is still intact at the
+  *          far end of its stack. The kernel keeps no stack size in 10.3, so
+  *          the tasks are registered with the size of their static stack.
+  *
+  *          Interrupts run on the main stack, which the scheduler resets to
+  *          _estack when it starts. Its unused part is painted the same way
+  *          at boot and scanned from the bottom of the _Min_Stack_Size
+  *          reserve of the linker script.
+  *
+  *          The -fstack-usage output of a STACK_PROFILE build gives the
+  *          static worst case of each task, Host/tools/stack_report.py adds
+  *          it up along the call graph. The measured marks here show how
+  *          much of that a run actually reached.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stack_profile.h"
+#include "main.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+// Fill byte of the kernel, tskSTACK_FILL_BYTE in tasks.c
+#define STACK_PROFILE_FILL 0xA5A5A5A5U
+// Words left untouched below the stack pointer of stack_profile_init
+#define STACK_PROFILE_MARGIN_WORDS 16U
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    TaskHandle_t task;
+    uint32_t size_words;
+} stack_profile_task_t;
+
+/* External variables --------------------------------------------------------*/
+// Linker script symbols, only their address is meaningful
+extern uint32_t _estack;
+extern uint32_t _Min_Stack_Size;
+
+/* Private variables ---------------------------------------------------------*/
+// The first entry is the main stack
+static stack_profile_task_t stack_profile_tasks[STACK_PROFILE_MAX_TASKS - 1];
+static uint32_t stack_profile_task_count;
+static bool stack_profile_kernel_tasks_added;
+
+// Function to find the lowest word of the main stack reserve
+static uint32_t *stack_profile_main_bottom(void) {
+    return (uint32_t *)((uintptr_t)&_estack - (uintptr_t)&_Min_Stack_Size);
+}
+
+// Function to paint the part of the main stack that is not in use yet
+void stack_profile_init(void) {
+    uint32_t *word = stack_profile_main_bottom();
+    uint32_t *end = (uint32_t *)(uintptr_t)__get_MSP() - STACK_PROFILE_MARGIN_WORDS;
+
+    while (word < end) {
+        *word++ = STACK_PROFILE_FILL;
+    }
+    stack_profile_task_count = 0;
+    stack_profile_kernel_tasks_added = false;
+}
+
+// Function to register a task and the size of its stack
+void stack_profile_track(TaskHandle_t task, uint32_t size_words) {
+    if (task == NULL || stack_profile_task_count == STACK_PROFILE_MAX_TASKS - 1) {
+        return;
+    }
+    stack_profile_tasks[stack_profile_task_count].task = task;
+    stack_profile_tasks[stack_profile_task_count].size_words = size_words;
+    stack_profile_task_count++;
+}
+
+// Function to count the painted words left at the bottom of the main stack
+static uint32_t stack_profile_main_free(void) {
+    const uint32_t *word = stack_profile_main_bottom();
+    const uint32_t *top = &_estack;
+    uint32_t free_words = 0;
+
+    while (word < top && *word++ == STACK_PROFILE_FILL) {
+        free_words++;
+    }
+    return free_words;
+}
+
+// Function to fill one entry of the frame
+static void stack_profile_entry(stack_profile_entry_t *entry, const char *name, uint32_t size_words,
+                                uint32_t free_words) {
+    memset(entry->tag, 0, sizeof(entry->tag));
+    strncpy(entry->tag, name, sizeof(entry->tag));
+    entry->size_words = (uint16_t)(size_words > UINT16_MAX ? UINT16_MAX : size_words);
+    entry->min_free_words = (uint16_t)(free_words > UINT16_MAX ? UINT16_MAX : free_words);
+}
+
+// Function to build a stack profile frame
+uint16_t stack_profile_build(stack_profile_frame_t *frame) {
+    if (!stack_profile_kernel_tasks_added) {
+        // Their handles exist once the scheduler runs
+        stack_profile_track(xTimerGetTimerDaemonTaskHandle(), configTIMER_TASK_STACK_DEPTH);
+        stack_profile_track(xTaskGetIdleTaskHandle(), configMINIMAL_STACK_SIZE);
+        stack_profile_kernel_tasks_added = true;
+    }
+
+    frame->type = STACK_PROFILE_FRAME_TYPE;
+    frame->reserved = 0;
+    stack_profile_entry(&frame->tasks[0], "ISR", (uint32_t)(uintptr_t)&_Min_Stack_Size / sizeof(uint32_t),
+                        stack_profile_main_free());
+    for (uint32_t i = 0; i < stack_profile_task_count; ++i) {
+        TaskHandle_t task = stack_profile_tasks[i].task;
+        stack_profile_entry(&frame->tasks[i + 1], pcTaskGetName(task), stack_profile_tasks[i].size_words,
+                            uxTaskGetStackHighWaterMark(task));
+    }
+    frame->task_count = (uint8_t)(stack_profile_task_count + 1);
+    return (uint16_t)(offsetof(stack_profile_frame_t, tasks) + frame->task_count * sizeof(stack_profile_entry_t));
+}
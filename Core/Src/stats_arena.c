@@ -0,0 +1,105 @@
+/**
+  ******************************************************************************
+  * @file    stats_arena.c
+  * @brief   Arena of the streaming window storage, laid out again when the window is resized.
+  *
+  *          Each streaming window keeps its samples twice more, in the heaps
+  *          of the sliding median and the deques of the sliding min/max. Built
+  *          into the structs, those arrays are STATS_WINDOW_CAPACITY long for
+  *          every channel and every view, whatever window is configured.
+  *          Bound to this arena instead, they are carved to the window in
+  *          use, one after the other. When the window is resized, the arena
+  *          is given back in one step and carved again for the new length,
+  *          the windows then fill again from the samples of their rings. The
+  *          layout of a length is always the same and nothing is freed
+  *          piece by piece, so the arena cannot fragment.
+  *
+  *          A window holds one sample more than its length in the course of
+  *          a slide, between the add of the newest and the removal of the
+  *          oldest, so every array is one longer than its window.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stats_arena.h"
+#include "main.h"
+#include "stats_frame.h"
+
+#if STATS_ARENA
+/* Private defines -----------------------------------------------------------*/
+#if STATS_VIEWS
+#define STATS_ARENA_VIEWS (sizeof(stats_arena_view_length) / sizeof(stats_arena_view_length[0]))
+#else
+#define STATS_ARENA_VIEWS 0U
+#endif
+#if STATS_ARENA_BYTES
+#define STATS_ARENA_SIZE ARENA_BYTES(STATS_ARENA_BYTES)
+#else
+#define STATS_ARENA_SIZE \
+    (SENSOR_COUNT * (1U + STATS_ARENA_VIEWS) * WINDOW_STATS_STORAGE_BYTES(STATS_WINDOW_CAPACITY + 1U))
+#endif
+
+/* Private variables ---------------------------------------------------------*/
+#if STATS_VIEWS
+// The view lengths of main.c, in the same order
+static const uint16_t stats_arena_view_length[] = { STATS_VIEW_WINDOWS };
+#endif
+// The arena storage, consumer task only
+static uint32_t stats_arena_storage[STATS_ARENA_SIZE / 4U] CCMRAM_NOINIT;
+static arena_t stats_arena;
+
+/* Private function prototypes -----------------------------------------------*/
+#if STATS_VIEWS
+static uint32_t stats_arena_view_capacity(uint32_t view, uint32_t window_size);
+#endif
+
+// Function to add up the storage of a layout without carving it
+bool stats_arena_fits(uint32_t window_size) {
+    uint32_t bytes = WINDOW_STATS_STORAGE_BYTES(window_size + 1U);
+
+#if STATS_VIEWS
+    for (uint32_t view = 0; view < STATS_ARENA_VIEWS; ++view) {
+        bytes += WINDOW_STATS_STORAGE_BYTES(stats_arena_view_capacity(view, window_size));
+    }
+#endif
+    return SENSOR_COUNT * bytes <= STATS_ARENA_SIZE;
+}
+
+// Function to carve the arena again for the windows and views of a window size
+bool stats_arena_layout(window_stats_t *windows, window_stats_t *views, uint32_t window_size) {
+    bool bound = true;
+
+    if (stats_arena.storage == NULL) {
+        arena_init(&stats_arena, stats_arena_storage, sizeof(stats_arena_storage));
+    } else {
+        arena_reset(&stats_arena);
+    }
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        bound &= window_stats_bind(&windows[channel], &stats_arena, (uint16_t)(window_size + 1U));
+    }
+#if STATS_VIEWS
+    for (uint32_t view = 0; view < STATS_ARENA_VIEWS; ++view) {
+        uint16_t capacity = (uint16_t)stats_arena_view_capacity(view, window_size);
+        for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+            bound &= window_stats_bind(&views[view * SENSOR_COUNT + channel], &stats_arena, capacity);
+        }
+    }
+#else
+    (void)views;
+#endif
+    return bound;
+}
+
+// Function to expose the arena to the heap telemetry
+const arena_t *stats_arena_state(void) {
+    return &stats_arena;
+}
+
+#if STATS_VIEWS
+// Function to size the arrays of a view, never longer than the window
+static uint32_t stats_arena_view_capacity(uint32_t view, uint32_t window_size) {
+    uint32_t length = stats_arena_view_length[view];
+    return (length < window_size ? length : window_size) + 1U;
+}
+#endif
+#endif
@@ -0,0 +1,202 @@
+/**
+  ******************************************************************************
+  * @file    stats_benchmark.c
+  * @brief   On-target cycle benchmark of the statistics kernels.
+  *
+  *          Every kernel is timed with the DWT cycle counter over several
+  *          window sizes and input distributions. Input preparation is kept
+  *          out of the timed region, and the timed call runs in a critical
+  *          section so kernel interrupts do not land in the numbers. Results
+  *          go out over the queued USART2 path as CSV lines.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stats_benchmark.h"
+#include "cmsis_os.h"
+#include "cycle_counter.h"
+#include "pipeline_priorities.h"
+#include "sensor_stats.h"
+#include "uart_tx.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+#ifndef STATS_BENCHMARK_STACK_SIZE
+#define STATS_BENCHMARK_STACK_SIZE 384
+#endif
+// Above the consumer, below the producer
+#define STATS_BENCHMARK_PRIORITY TASK_PRIORITY_CONTROL
+
+/* Private types -------------------------------------------------------------*/
+typedef enum {
+    BENCHMARK_STD_DEV,
+    BENCHMARK_MAX,
+    BENCHMARK_MIN,
+    BENCHMARK_MEDIAN,
+    BENCHMARK_BATCH_STATS,
+    BENCHMARK_WINDOW_SLIDE,
+    BENCHMARK_BATCH_STATS_Q15,
+    BENCHMARK_BATCH_STATS_Q15_SCALAR,
+    BENCHMARK_KERNEL_COUNT
+} benchmark_kernel_t;
+
+typedef enum {
+    DISTRIBUTION_SORTED,
+    DISTRIBUTION_RANDOM,
+    DISTRIBUTION_CONSTANT,
+    DISTRIBUTION_COUNT
+} benchmark_distribution_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const char *const kernel_names[BENCHMARK_KERNEL_COUNT] = {
+    "std_dev", "max", "min", "median", "batch_stats", "window_slide", "batch_stats_q15",
+    "batch_stats_q15_scalar"
+};
+static const char *const distribution_names[DISTRIBUTION_COUNT] = {
+    "sorted", "random", "constant"
+};
+static const uint32_t window_sizes[] = { 16, 32, 64, 100, STATS_WINDOW_CAPACITY };
+static const char report_header[] = "kernel,size,distribution,min,avg,max\r\n";
+
+static float benchmark_input[STATS_WINDOW_CAPACITY + 1] CCMRAM_NOINIT;
+static float benchmark_work[STATS_WINDOW_CAPACITY] CCMRAM_NOINIT;
+// Same input as int16 codes for the fixed-point kernels
+static int16_t benchmark_input_q15[STATS_WINDOW_CAPACITY + 1] CCMRAM_NOINIT;
+static window_stats_t benchmark_window CCMRAM;
+// Results are stored here so the timed calls cannot be optimized away
+static volatile float benchmark_sink;
+
+static StaticTask_t benchmark_task_tcb CCMRAM;
+static StackType_t benchmark_task_stack[STATS_BENCHMARK_STACK_SIZE] CCMRAM_NOINIT;
+
+/* Private function prototypes -----------------------------------------------*/
+static void stats_benchmark_task(void *argument);
+static void benchmark_fill(benchmark_distribution_t distribution, uint32_t count);
+static uint32_t benchmark_run(benchmark_kernel_t kernel, uint32_t count);
+
+// Function to create the one-shot benchmark task
+void stats_benchmark_start(void) {
+    xTaskCreateStatic(stats_benchmark_task, "StatsBench", STATS_BENCHMARK_STACK_SIZE, NULL,
+                      STATS_BENCHMARK_PRIORITY, benchmark_task_stack, &benchmark_task_tcb);
+}
+
+// Function to generate the input of one case, count + 1 values for the slide
+static void benchmark_fill(benchmark_distribution_t distribution, uint32_t count) {
+    uint32_t seed = 12345;
+
+    for (uint32_t i = 0; i <= count; ++i) {
+        switch (distribution) {
+        case DISTRIBUTION_SORTED:
+            benchmark_input[i] = (float)i;
+            break;
+        case DISTRIBUTION_RANDOM:
+            // 12-bit values like a sensor word, deterministic between runs
+            seed = seed * 1664525U + 1013904223U;
+            benchmark_input[i] = (float)(seed >> 20);
+            break;
+        default:
+            benchmark_input[i] = 1000.0f;
+            break;
+        }
+        benchmark_input_q15[i] = (int16_t)benchmark_input[i];
+    }
+}
+
+// Function to time one call of a kernel on the prepared input
+static uint32_t benchmark_run(benchmark_kernel_t kernel, uint32_t count) {
+    batch_stats_t stats;
+    batch_stats_q15_t stats_q15;
+    float result = 0.0f;
+    uint32_t start, cycles;
+
+    // Untimed preparation: the in-place kernels get a fresh copy, the slide a full window
+    memcpy(benchmark_work, benchmark_input, count * sizeof(float));
+    if (kernel == BENCHMARK_WINDOW_SLIDE) {
+        window_stats_reset(&benchmark_window);
+        for (uint32_t i = 0; i < count; ++i) {
+            window_stats_add(&benchmark_window, benchmark_input[i]);
+        }
+    }
+
+    taskENTER_CRITICAL();
+    start = cycle_counter_now();
+    switch (kernel) {
+    case BENCHMARK_STD_DEV:
+        result = calculate_std_dev(benchmark_work, count);
+        break;
+    case BENCHMARK_MAX:
+        result = calculate_max(benchmark_work, count);
+        break;
+    case BENCHMARK_MIN:
+        result = calculate_min(benchmark_work, count);
+        break;
+    case BENCHMARK_MEDIAN:
+        result = calculate_median(benchmark_work, count);
+        break;
+    case BENCHMARK_BATCH_STATS:
+        batch_stats_reset(&stats);
+        batch_stats_accumulate(&stats, benchmark_work, count);
+        result = batch_stats_std_dev(&stats) + stats.min + stats.max;
+        break;
+    case BENCHMARK_BATCH_STATS_Q15:
+        batch_stats_q15_reset(&stats_q15);
+        batch_stats_q15_accumulate(&stats_q15, benchmark_input_q15, count);
+        result = (float)(stats_q15.sum + stats_q15.min + stats_q15.max);
+        break;
+    case BENCHMARK_BATCH_STATS_Q15_SCALAR:
+        batch_stats_q15_reset(&stats_q15);
+        batch_stats_q15_accumulate_scalar(&stats_q15, benchmark_input_q15, count);
+        result = (float)(stats_q15.sum + stats_q15.min + stats_q15.max);
+        break;
+    default:
+        // One sample leaves and one enters, what the consumer pays per sample
+        window_stats_remove_oldest(&benchmark_window, benchmark_input[0]);
+        window_stats_add(&benchmark_window, benchmark_input[count]);
+#if STATS_HISTOGRAM_MEDIAN
+        // The window now holds input[1] to input[count]
+        result = order_histogram_percentile(&benchmark_window.histogram, 0.5f, &benchmark_input_q15[1], count, NULL, 0);
+#else
+        result = median_window_median(&benchmark_window.median);
+#endif
+        break;
+    }
+    cycles = cycle_counter_since(start);
+    taskEXIT_CRITICAL();
+
+    benchmark_sink = result;
+    return cycles;
+}
+
+// Function to time every kernel, size and distribution and report the results
+static void stats_benchmark_task(void *argument) {
+    char line[UART_TX_FRAME_MAX];
+
+    cycle_counter_init();
+    uart_tx_send_blocking((const uint8_t *)report_header, sizeof(report_header) - 1);
+
+    for (uint32_t kernel = 0; kernel < BENCHMARK_KERNEL_COUNT; ++kernel) {
+        for (uint32_t size = 0; size < sizeof(window_sizes) / sizeof(window_sizes[0]); ++size) {
+            for (uint32_t distribution = 0; distribution < DISTRIBUTION_COUNT; ++distribution) {
+                uint32_t count = window_sizes[size];
+                uint32_t min = UINT32_MAX, max = 0;
+                uint64_t total = 0;
+
+                benchmark_fill(distribution, count);
+                for (uint32_t run = 0; run < STATS_BENCHMARK_RUNS; ++run) {
+                    uint32_t cycles = benchmark_run(kernel, count);
+                    min = cycles < min ? cycles : min;
+                    max = cycles > max ? cycles : max;
+                    total += cycles;
+                }
+
+                snprintf(line, sizeof(line), "%s,%lu,%s,%lu,%lu,%lu\r\n",
+                         kernel_names[kernel], (unsigned long)count, distribution_names[distribution],
+                         (unsigned long)min, (unsigned long)(total / STATS_BENCHMARK_RUNS), (unsigned long)max);
+                uart_tx_send_blocking((const uint8_t *)line, (uint16_t)strlen(line));
+            }
+        }
+    }
+
+    vTaskDelete(NULL);
+}
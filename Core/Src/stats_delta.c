@@ -0,0 +1,125 @@
+/**
+  ******************************************************************************
+  * @file    stats_delta.c
+  * @brief   Change-only reporting of the window statistics.
+  *
+  *          Indoors humidity and light barely move between reports, so most
+  *          statistics repeat. Between keyframes only the statistics that
+  *          moved beyond their deadband are sent, as varint deltas of their
+  *          16-bit codes: a quiet period costs nothing on the air and a small
+  *          change one or two bytes per statistic plus the header, 11 bytes
+  *          for three sensors and one more per two added sensors.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stats_delta.h"
+#include "sensor_registry.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Private function prototypes -----------------------------------------------*/
+static uint32_t put_varint(uint8_t *out, uint16_t delta);
+
+// Function to forget the receiver state
+void stats_delta_reset(stats_delta_t *state) {
+    memset(state, 0, sizeof(*state));
+    state->reports_since_keyframe = STATS_KEYFRAME_INTERVAL;
+}
+
+// Function to account for a report that never left
+void stats_delta_lost(stats_delta_t *state) {
+    state->sequence++;
+    state->reports_since_keyframe = STATS_KEYFRAME_INTERVAL;
+}
+
+// Function to write the zig-zag varint of a 16-bit delta
+static uint32_t put_varint(uint8_t *out, uint16_t delta) {
+    int16_t signed_delta = (int16_t)delta;
+    uint32_t zigzag = ((uint32_t)(uint16_t)signed_delta << 1) ^ (signed_delta < 0 ? 0xFFFFU : 0U);
+    uint32_t size = 0;
+
+    zigzag &= 0xFFFFU;
+    while (zigzag >= 0x80U) {
+        out[size++] = (uint8_t)(zigzag | 0x80U);
+        zigzag >>= 7;
+    }
+    out[size++] = (uint8_t)zigzag;
+    return size;
+}
+
+// Function to build a keyframe or the delta frame of the changed statistics
+uint16_t stats_delta_encode(stats_delta_t *state, stats_report_t *report, uint32_t timestamp,
+                            uint16_t channel_mask, const float values[SENSOR_COUNT][STATS_FIELD_COUNT]) {
+    if (state->reports_since_keyframe >= STATS_KEYFRAME_INTERVAL || channel_mask != state->channel_mask) {
+        // A new channel selection starts over with a keyframe
+        uint16_t size = stats_frame_encode(&report->key, state->sequence++, timestamp, channel_mask, values);
+        for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+            for (uint32_t field = 0; field < STATS_FIELD_COUNT; ++field) {
+                state->codes[channel][field] = stats_frame_quantize(channel, values[channel][field]);
+                state->values[channel][field] = values[channel][field];
+            }
+        }
+        state->channel_mask = channel_mask;
+#if SENSOR_OCCUPANCY
+        state->occupancy = report->key.occupancy;
+#endif
+        state->reports_since_keyframe = 1;
+        return size;
+    }
+    state->reports_since_keyframe++;
+
+    stats_delta_frame_t *frame = &report->delta;
+    uint32_t size = 0;
+    bool changed = false;
+
+    memset(frame->field_mask, 0, sizeof(frame->field_mask));
+
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        if ((channel_mask & (1U << channel)) == 0) {
+            continue;
+        }
+        for (uint32_t field = 0; field < STATS_FIELD_COUNT; ++field) {
+            float value = values[channel][field];
+            uint16_t code = stats_frame_quantize(channel, value);
+
+            // Unchanged codes are never sent, whatever the deadband
+            if (code == state->codes[channel][field] ||
+                fabsf(value - state->values[channel][field]) <= sensor_registry[channel].deadband) {
+                continue;
+            }
+            uint32_t bit = channel * STATS_FIELD_COUNT + field;
+            frame->field_mask[bit / 8] |= (uint8_t)(1U << (bit % 8));
+            changed = true;
+            size += put_varint(&frame->deltas[size], (uint16_t)(code - state->codes[channel][field]));
+            state->codes[channel][field] = code;
+            state->values[channel][field] = value;
+        }
+    }
+#if SENSOR_OCCUPANCY
+    // A new state goes out at once, a new confidence past its deadband
+    uint8_t occupancy = occupancy_fusion_byte();
+    uint32_t confidence = occupancy & OCCUPANCY_CONFIDENCE_MASK;
+    uint32_t sent = state->occupancy & OCCUPANCY_CONFIDENCE_MASK;
+    if (((occupancy ^ state->occupancy) & OCCUPANCY_OCCUPIED) != 0 ||
+        (confidence > sent ? confidence - sent : sent - confidence) > OCCUPANCY_CONFIDENCE_DEADBAND) {
+        changed = true;
+    }
+#endif
+    if (!changed) {
+        return 0;
+    }
+#if SENSOR_OCCUPANCY
+    frame->occupancy = occupancy;
+    state->occupancy = occupancy;
+#endif
+
+    frame->type = STATS_DELTA_FRAME_TYPE;
+    frame->version = STATS_DELTA_FRAME_VERSION;
+    frame->sequence = state->sequence++;
+    frame->timestamp = timestamp;
+    frame->encoding = STATS_FRAME_ENCODING;
+    return (uint16_t)(offsetof(stats_delta_frame_t, deltas) + size);
+}
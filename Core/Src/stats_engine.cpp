@@ -0,0 +1,45 @@
+/**
+  ******************************************************************************
+  * @file    stats_engine.cpp
+  * @brief   Statistics engine instance of this build, selected by the
+  *          STATS_FEATURE_* options.
+  *
+  *          The instance is sized by SENSOR_COUNT and STATS_WINDOW_CAPACITY
+  *          and lists the enabled features, so a product that does not report
+  *          a statistic does not carry its code, accumulators or scratch.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stats_engine.h"
+
+#if STATS_ENGINE
+#include "main.h"
+#include "sensor_registry.h"
+#include "stats_engine.hpp"
+
+namespace {
+
+using Engine = stats::Stats<SENSOR_COUNT, STATS_WINDOW_CAPACITY,
+                            stats::Select<STATS_FEATURE_STD_DEV, stats::StdDev>,
+                            stats::Select<STATS_FEATURE_MAX, stats::Max>,
+                            stats::Select<STATS_FEATURE_MIN, stats::Min>,
+                            stats::Select<STATS_FEATURE_MEDIAN, stats::Median>>;
+
+// Owned by the consumer task, the median scratch lives here
+Engine engine CCMRAM;
+
+} // namespace
+
+// Function to run the engine over the channel rings
+uint32_t stats_engine_update(sample_ring_t rings[SENSOR_COUNT], uint32_t window_size,
+                             float out[SENSOR_COUNT][STATS_FIELD_COUNT]) {
+    // Statistics leave the engine in ring units, code units with STATS_FIXED_POINT
+    float units[SENSOR_COUNT];
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        units[channel] = STATS_FIXED_POINT ? sensor_registry[channel].fixed_scale : 1.0f;
+    }
+    return engine.update(*reinterpret_cast<sample_ring_t (*)[SENSOR_COUNT]>(rings), window_size, units,
+                         *reinterpret_cast<float (*)[SENSOR_COUNT][STATS_FIELD_COUNT]>(out));
+}
+#endif /* STATS_ENGINE */
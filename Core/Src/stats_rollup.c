@@ -0,0 +1,431 @@
+/**
+  ******************************************************************************
+  * @file    stats_rollup.c
+  * @brief   Mergeable summaries of every channel per second, minute and hour.
+  *
+  *          The statistics frames describe the last window, about ten
+  *          seconds at the default schedule, and a dashboard that wants the
+  *          last day would need every raw sample. Instead the producer keeps
+  *          a pyramid of summaries per channel. Every stored sample goes into
+  *          the open second. The first sample of a new second closes it, and
+  *          the closed summary is merged into the open minute, which closes
+  *          the same way into the open hour. A summary is its count, mean,
+  *          sum of squared deviations, min, max and a 16-slice sketch of the
+  *          code distribution. Merging two of them is exact for everything
+  *          but the sketch, so an hour built from minutes is the hour of the
+  *          samples.
+  *
+  *          Each level keeps its last closed summaries in a ring in CCM RAM,
+  *          a day of hours in a few KB. At the next report the consumer sends
+  *          the minutes and hours that closed and appends them to the flash
+  *          log, where a replay finds them after a link gap. A "rollup"
+  *          command sends a whole level from RAM.
+  *
+  *          A "query" command asks for one channel over a time range. A task
+  *          at transmit priority seeks the flash log to the start of the
+  *          range through its sector and page index and reads on to its end.
+  *          On the way it merges every hour the range covers whole and the
+  *          minutes of its edges, and answers with one frame. The minutes of
+  *          an hour are held aside until the hour arrives, one period later,
+  *          and only count when it does not. A backfill of a day costs one
+  *          frame instead of the raw samples or 1440 minutes.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stats_rollup.h"
+#include "cmsis_os.h"
+#include "flash_log.h"
+#include "link_route.h"
+#include "main.h"
+#include "pipeline_priorities.h"
+#include "stack_profile.h"
+#include "task_signal.h"
+#include <stddef.h>
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+#define ROLLUP_DEPTH_TOTAL (ROLLUP_DEPTH_SECONDS + ROLLUP_DEPTH_MINUTES + ROLLUP_DEPTH_HOURS)
+// No dump waiting
+#define ROLLUP_DUMP_NONE 0xFFU
+#define ROLLUP_TOP_LEVEL (ROLLUP_LEVELS - 1U)
+#ifndef ROLLUP_QUERY_STACK_SIZE
+#define ROLLUP_QUERY_STACK_SIZE 256
+#endif
+// Reads the flash log like the replay, in what the pipeline leaves
+#define ROLLUP_QUERY_PRIORITY TASK_PRIORITY_TRANSMIT
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    rollup_summary_t summary;
+    uint32_t start_ms;
+} rollup_entry_t;
+
+typedef struct {
+    rollup_summary_t open; // Period being summed, empty until its first sample
+    uint32_t index;        // Period number of open, its start over the period length
+    volatile uint32_t head; // Summaries closed, the newest is in slot head - 1
+    uint32_t reported;      // Closed summaries the consumer has sent
+} rollup_level_t;
+
+// Summaries merged by a query, with the periods they cover
+typedef struct {
+    rollup_summary_t summary;
+    uint32_t first_ms;
+    uint32_t end_ms;
+    uint32_t records;
+} rollup_span_t;
+
+// Edge summaries inside an hour of the range, kept until the hour arrives
+typedef struct {
+    rollup_span_t span;
+    uint32_t index; // Hour they belong to
+    bool used;
+} rollup_pending_t;
+
+// The levels of one channel, written by producer_task. The consumer reads
+// the closed entries, a slot is only written again depth closes later.
+typedef struct {
+    rollup_level_t levels[ROLLUP_LEVELS];
+    rollup_entry_t entries[ROLLUP_DEPTH_TOTAL];
+} rollup_channel_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const uint16_t rollup_depth[ROLLUP_LEVELS] = { ROLLUP_DEPTH_SECONDS, ROLLUP_DEPTH_MINUTES, ROLLUP_DEPTH_HOURS };
+static const uint16_t rollup_offset[ROLLUP_LEVELS] = { 0, ROLLUP_DEPTH_SECONDS,
+                                                       ROLLUP_DEPTH_SECONDS + ROLLUP_DEPTH_MINUTES };
+static const uint32_t rollup_period_ms[ROLLUP_LEVELS] = { ROLLUP_BASE_PERIOD_MS, ROLLUP_BASE_PERIOD_MS * ROLLUP_FOLD,
+                                                          ROLLUP_BASE_PERIOD_MS * ROLLUP_FOLD * ROLLUP_FOLD };
+static rollup_channel_t stats_rollup[SENSOR_COUNT] CCMRAM;
+// Dump in progress, consumer_task only after the command task sets the level
+static volatile uint32_t rollup_dump_level;
+static uint32_t rollup_dump_channel;
+static uint32_t rollup_dump_next;
+
+#if FLASH_LOG
+static volatile uint32_t rollup_query_channel;
+static volatile uint32_t rollup_query_from_ms;
+static volatile uint32_t rollup_query_to_ms;
+static TaskHandle_t rollup_query_task_handle;
+static StaticTask_t rollup_query_task_tcb;
+static StackType_t rollup_query_task_stack[ROLLUP_QUERY_STACK_SIZE];
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+static void stats_rollup_close(rollup_channel_t *rollup, uint32_t level);
+static void stats_rollup_read(uint32_t channel, uint32_t level, uint32_t closed, rollup_entry_t *entry);
+static bool stats_rollup_send(uart_link_t link, uint32_t channel, uint32_t level, const rollup_entry_t *entry);
+#if FLASH_LOG
+static void rollup_span_merge(rollup_span_t *span, const rollup_span_t *other);
+static void rollup_span_reset(rollup_span_t *span);
+static void stats_rollup_query_run(uint32_t channel, uint32_t from_ms, uint32_t to_ms);
+static void stats_rollup_query_task(void *argument);
+#endif
+
+_Static_assert(ROLLUP_DEPTH_SECONDS > 0 && ROLLUP_DEPTH_MINUTES > 0 && ROLLUP_DEPTH_HOURS > 0,
+               "every rollup level needs a slot");
+_Static_assert(sizeof(rollup_frame_t) <= UART_TX_FRAME_MAX, "rollup_frame_t too large for UART_TX_FRAME_MAX");
+_Static_assert(sizeof(rollup_query_frame_t) <= UART_TX_FRAME_MAX,
+               "rollup_query_frame_t too large for UART_TX_FRAME_MAX");
+#if FLASH_LOG
+_Static_assert(sizeof(rollup_record_t) <= FLASH_LOG_PAYLOAD_MAX, "rollup_record_t too large for FLASH_LOG_PAYLOAD_MAX");
+#endif
+
+// Function to clear every level
+void stats_rollup_init(void) {
+    memset(stats_rollup, 0, sizeof(stats_rollup));
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        for (uint32_t level = 0; level < ROLLUP_LEVELS; ++level) {
+            rollup_summary_reset(&stats_rollup[channel].levels[level].open);
+        }
+    }
+    rollup_dump_level = ROLLUP_DUMP_NONE;
+}
+
+// Function to close the open summary of a level and merge it into the level
+// above, which first closes when it belongs to an earlier period. At most
+// ROLLUP_LEVELS calls deep.
+static void stats_rollup_close(rollup_channel_t *rollup, uint32_t level) {
+    rollup_level_t *current = &rollup->levels[level];
+    uint32_t head = current->head;
+    rollup_entry_t *entry = &rollup->entries[rollup_offset[level] + head % rollup_depth[level]];
+
+    entry->summary = current->open;
+    entry->start_ms = current->index * rollup_period_ms[level];
+    current->head = head + 1U;
+    if (level + 1U < ROLLUP_LEVELS) {
+        rollup_level_t *parent = &rollup->levels[level + 1U];
+        uint32_t index = current->index / ROLLUP_FOLD;
+        if (parent->open.count != 0 && parent->index != index) {
+            stats_rollup_close(rollup, level + 1U);
+        }
+        if (parent->open.count == 0) {
+            parent->index = index;
+        }
+        rollup_summary_merge(&parent->open, &current->open);
+    }
+    rollup_summary_reset(&current->open);
+}
+
+// Function to fold a stored sample into the open second of its channel
+void stats_rollup_sample(sensor_t channel, int16_t code, uint32_t timestamp) {
+    rollup_channel_t *rollup = &stats_rollup[channel];
+    rollup_level_t *base = &rollup->levels[0];
+    uint32_t index = timestamp / ROLLUP_BASE_PERIOD_MS;
+
+    if (base->open.count != 0 && base->index != index) {
+        stats_rollup_close(rollup, 0);
+    }
+    if (base->open.count == 0) {
+        base->index = index;
+    }
+    rollup_summary_add(&base->open, code);
+}
+
+// Function to copy a closed summary out of its ring. The producer only
+// closes at a tick, the copy is short enough to lock it out.
+static void stats_rollup_read(uint32_t channel, uint32_t level, uint32_t closed, rollup_entry_t *entry) {
+    taskENTER_CRITICAL();
+    *entry = stats_rollup[channel].entries[rollup_offset[level] + closed % rollup_depth[level]];
+    taskEXIT_CRITICAL();
+}
+
+// Function to send one summary on a link, false when its transmit queue is full
+static bool stats_rollup_send(uart_link_t link, uint32_t channel, uint32_t level, const rollup_entry_t *entry) {
+    rollup_frame_t frame = {
+        .type = ROLLUP_FRAME_TYPE,
+        .version = ROLLUP_FRAME_VERSION,
+        .channel = (uint8_t)channel,
+        .level = (uint8_t)level,
+        .start_ms = entry->start_ms,
+        .summary = entry->summary,
+    };
+    return uart_tx_link_send(link, (const uint8_t *)&frame, sizeof(frame));
+}
+
+// Function to send and log the newly closed summaries and go on with a dump
+void stats_rollup_report(bool log, uint32_t now) {
+    rollup_entry_t entry;
+
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        for (uint32_t level = ROLLUP_REPORT_LEVEL; level < ROLLUP_LEVELS; ++level) {
+            rollup_level_t *current = &stats_rollup[channel].levels[level];
+            uint32_t head = current->head;
+            if (head - current->reported > rollup_depth[level]) {
+                // Overwritten before the consumer got to them
+                current->reported = head - rollup_depth[level];
+            }
+            for (; current->reported != head; ++current->reported) {
+                stats_rollup_read(channel, level, current->reported, &entry);
+                stats_rollup_send(UART_LINK_BLE, channel, level, &entry);
+#if FLASH_LOG
+                if (log) {
+                    uint32_t age_s = (now - entry.start_ms) / 1000U;
+                    rollup_record_t record = {
+                        .channel = (uint8_t)channel,
+                        .level = (uint8_t)level,
+                        .age_s = (uint16_t)(age_s > UINT16_MAX ? UINT16_MAX : age_s),
+                        .summary = entry.summary,
+                    };
+                    flash_log_append(FLASH_LOG_RECORD_ROLLUP, entry.start_ms + record.age_s * 1000U, &record,
+                                     sizeof(record));
+                }
+#else
+                (void)log;
+                (void)now;
+#endif
+            }
+        }
+    }
+
+    // A dump leaves one burst of the queue to the live frames
+    uint32_t level = rollup_dump_level;
+    while (level != ROLLUP_DUMP_NONE && link_route_free(LINK_TRAFFIC_DUMP) > 1) {
+        uint32_t head = stats_rollup[rollup_dump_channel].levels[level].head;
+        uint32_t oldest = head > rollup_depth[level] ? head - rollup_depth[level] : 0;
+        if (rollup_dump_next < oldest) {
+            rollup_dump_next = oldest;
+        }
+        if (rollup_dump_next >= head) {
+            if (++rollup_dump_channel == SENSOR_COUNT) {
+                rollup_dump_level = level = ROLLUP_DUMP_NONE;
+            }
+            rollup_dump_next = 0;
+            continue;
+        }
+        stats_rollup_read(rollup_dump_channel, level, rollup_dump_next, &entry);
+        if (!stats_rollup_send(link_route(LINK_TRAFFIC_DUMP), rollup_dump_channel, level, &entry)) {
+            break;
+        }
+        rollup_dump_next++;
+    }
+}
+
+// Function to start a dump of a level from the next report on
+bool stats_rollup_dump(uint32_t level) {
+    if (level >= ROLLUP_LEVELS) {
+        return false;
+    }
+    taskENTER_CRITICAL();
+    rollup_dump_channel = 0;
+    rollup_dump_next = 0;
+    rollup_dump_level = level;
+    taskEXIT_CRITICAL();
+    return true;
+}
+
+// Function to create the query task
+void stats_rollup_start(void) {
+#if FLASH_LOG
+    rollup_query_task_handle = xTaskCreateStatic(stats_rollup_query_task, "RollupQuery", ROLLUP_QUERY_STACK_SIZE,
+                                                 NULL, ROLLUP_QUERY_PRIORITY, rollup_query_task_stack,
+                                                 &rollup_query_task_tcb);
+#if STACK_PROFILE
+    stack_profile_track(rollup_query_task_handle, ROLLUP_QUERY_STACK_SIZE);
+#endif
+#endif
+}
+
+// Function to hand a query to the query task
+bool stats_rollup_query(uint32_t channel, uint32_t from_ms, uint32_t to_ms) {
+#if FLASH_LOG
+    if (channel >= SENSOR_COUNT || (int32_t)(to_ms - from_ms) <= 0) {
+        return false;
+    }
+    taskENTER_CRITICAL();
+    rollup_query_channel = channel;
+    rollup_query_from_ms = from_ms;
+    rollup_query_to_ms = to_ms;
+    taskEXIT_CRITICAL();
+    task_signal_set(rollup_query_task_handle, TASK_SIGNAL_ROLLUP_QUERY);
+    return true;
+#else
+    (void)channel;
+    (void)from_ms;
+    (void)to_ms;
+    return false;
+#endif
+}
+
+#if FLASH_LOG
+// Function to clear a query span
+static void rollup_span_reset(rollup_span_t *span) {
+    rollup_summary_reset(&span->summary);
+    span->first_ms = 0;
+    span->end_ms = 0;
+    span->records = 0;
+}
+
+// Function to merge the summaries of other into span
+static void rollup_span_merge(rollup_span_t *span, const rollup_span_t *other) {
+    if (other->records == 0) {
+        return;
+    }
+    if (span->records == 0 || (int32_t)(other->first_ms - span->first_ms) < 0) {
+        span->first_ms = other->first_ms;
+    }
+    if (span->records == 0 || (int32_t)(other->end_ms - span->end_ms) > 0) {
+        span->end_ms = other->end_ms;
+    }
+    rollup_summary_merge(&span->summary, &other->summary);
+    span->records += other->records;
+}
+
+// Function to walk the log over a range and send the merged summary
+static void stats_rollup_query_run(uint32_t channel, uint32_t from_ms, uint32_t to_ms) {
+    const uint32_t hour_ms = rollup_period_ms[ROLLUP_TOP_LEVEL];
+    flash_log_frame_t frame;
+    rollup_record_t record;
+    rollup_span_t result;
+    rollup_pending_t pending[2];
+    // Top level periods that lie within the range whole, first to last - 1
+    uint32_t first_hour = (from_ms + hour_ms - 1U) / hour_ms;
+    uint32_t last_hour = to_ms / hour_ms;
+
+    rollup_span_reset(&result);
+    memset(pending, 0, sizeof(pending));
+    uint32_t sequence = flash_log_seek(from_ms - ROLLUP_QUERY_LAG_MS);
+    uint32_t end = flash_log_next_sequence();
+    while ((int32_t)(sequence - end) < 0) {
+        uint16_t size = flash_log_read(sequence, &frame);
+        if (size == 0 || (int32_t)(frame.timestamp - (to_ms + ROLLUP_QUERY_LAG_MS)) > 0) {
+            break;
+        }
+        sequence = frame.sequence + 1U;
+        if (frame.record_type != FLASH_LOG_RECORD_ROLLUP ||
+            size < offsetof(flash_log_frame_t, payload) + sizeof(record)) {
+            continue;
+        }
+        memcpy(&record, frame.payload, sizeof(record));
+        if (record.channel != channel ||
+            (record.level != ROLLUP_REPORT_LEVEL && record.level != ROLLUP_TOP_LEVEL)) {
+            continue;
+        }
+        rollup_span_t span = {
+            .summary = record.summary,
+            .first_ms = frame.timestamp - record.age_s * 1000U,
+            .records = 1,
+        };
+        span.end_ms = span.first_ms + rollup_period_ms[record.level];
+        if ((int32_t)(span.first_ms - from_ms) < 0 || (int32_t)(span.end_ms - to_ms) > 0) {
+            continue;
+        }
+
+        uint32_t hour = span.first_ms / hour_ms;
+        rollup_pending_t *slot = &pending[hour & 1U];
+        if (record.level == ROLLUP_TOP_LEVEL) {
+            // The hour stands for the edge summaries held aside for it
+            if (slot->used && slot->index == hour) {
+                slot->used = false;
+            }
+            rollup_span_merge(&result, &span);
+        } else if (hour >= first_hour && hour < last_hour) {
+            if (slot->used && slot->index != hour) {
+                // That hour never came, its summaries count as they are
+                rollup_span_merge(&result, &slot->span);
+                slot->used = false;
+            }
+            if (!slot->used) {
+                rollup_span_reset(&slot->span);
+                slot->index = hour;
+                slot->used = true;
+            }
+            rollup_span_merge(&slot->span, &span);
+        } else {
+            rollup_span_merge(&result, &span);
+        }
+    }
+    for (uint32_t i = 0; i < 2U; ++i) {
+        if (pending[i].used) {
+            rollup_span_merge(&result, &pending[i].span);
+        }
+    }
+
+    rollup_query_frame_t answer = {
+        .type = ROLLUP_QUERY_FRAME_TYPE,
+        .version = ROLLUP_QUERY_FRAME_VERSION,
+        .channel = (uint8_t)channel,
+        .records = (uint8_t)(result.records > UINT8_MAX ? UINT8_MAX : result.records),
+        .first_ms = result.records != 0 ? result.first_ms : from_ms,
+        .end_ms = result.records != 0 ? result.end_ms : from_ms,
+        .summary = result.summary,
+    };
+    while (!link_route_send(LINK_TRAFFIC_DUMP, (const uint8_t *)&answer, sizeof(answer))) {
+        vTaskDelay(1);
+    }
+}
+
+// Query task, answers one query at a time
+static void stats_rollup_query_task(void *argument) {
+    (void)argument;
+    while (1) {
+        task_signal_wait(TASK_SIGNAL_ROLLUP_QUERY, portMAX_DELAY);
+        taskENTER_CRITICAL();
+        uint32_t channel = rollup_query_channel;
+        uint32_t from_ms = rollup_query_from_ms;
+        uint32_t to_ms = rollup_query_to_ms;
+        taskEXIT_CRITICAL();
+        stats_rollup_query_run(channel, from_ms, to_ms);
+    }
+}
+#endif
@@ -0,0 +1,56 @@
+/**
+  ******************************************************************************
+  * @file    stats_snapshot.c
+  * @brief   Latest statistics of every channel, readable from any context.
+  *
+  *          The statistics only live in the consumer between two reports.
+  *          After each report it copies them here, so a command can answer
+  *          a host at once instead of waiting for the next batch, and other
+  *          tasks can read them without a mutex. The slot is a seqlock with
+  *          two copies: the writer makes the sequence odd, writes copy 0,
+  *          makes it even and writes copy 1, and a reader copies the slot
+  *          the sequence points to and retries when the sequence moved in
+  *          between. An interrupt that lands in the middle of a publish
+  *          reads the copy that is not being written and so never retries,
+  *          and a task retries at most once per report.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stats_snapshot.h"
+#include "main.h"
+#include <string.h>
+
+/* Private variables ---------------------------------------------------------*/
+// Odd while copy 0 is written, even while copy 1 is or neither
+static volatile uint32_t stats_snapshot_sequence;
+static stats_snapshot_t stats_snapshot_copies[2];
+
+// Function to publish the statistics of a report
+void stats_snapshot_publish(const float stats[SENSOR_COUNT][STATS_FIELD_COUNT], uint32_t timestamp) {
+    uint32_t published = stats_snapshot_sequence / 2U + 1U;
+
+    for (uint32_t copy = 0; copy < 2U; ++copy) {
+        // Readers move to the other copy before this one changes
+        stats_snapshot_sequence++;
+        __DMB();
+        stats_snapshot_copies[copy].sequence = published;
+        stats_snapshot_copies[copy].timestamp = timestamp;
+        memcpy(stats_snapshot_copies[copy].stats, stats, sizeof(stats_snapshot_copies[copy].stats));
+        __DMB();
+    }
+}
+
+// Function to copy the latest statistics
+bool stats_snapshot_read(stats_snapshot_t *snapshot) {
+    uint32_t sequence;
+
+    do {
+        sequence = stats_snapshot_sequence;
+        __DMB();
+        // Odd: copy 0 is being written, even: copy 1 may be
+        memcpy(snapshot, &stats_snapshot_copies[sequence & 1U], sizeof(*snapshot));
+        __DMB();
+    } while (stats_snapshot_sequence != sequence);
+    return snapshot->sequence != 0;
+}
@@ -53,8 +53,13 @@ HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority)
   /* Get clock configuration */
   HAL_RCC_GetClockConfig(&clkconfig, &pFLatency);
 
-  /* Compute TIM1 clock */
-      uwTimclock = HAL_RCC_GetPCLK2Freq();
+  /* Compute TIM1 clock, APB2 timers run at twice PCLK2 whenever the APB2
+     prescaler is not 1. Called again by the clock governor on every switch. */
+  uwTimclock = HAL_RCC_GetPCLK2Freq();
+  if (clkconfig.APB2CLKDivider != RCC_HCLK_DIV1)
+  {
+    uwTimclock *= 2U;
+  }
 
   /* Compute the prescaler value to have TIM1 counter clock equal to 1MHz */
   uwPrescalerValue = (uint32_t) ((uwTimclock / 1000000U) - 1U);
@@ -22,6 +22,24 @@
 #include "stm32f4xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "adc_acquisition.h"
+#include "capture_acquisition.h"
+#include "crash_capture.h"
+#include "dma_copy.h"
+#include "flash_log.h"
+#include "i2c_acquisition.h"
+#include "isr_pipeline.h"
+#include "isr_profile.h"
+#include "pc_profile.h"
+#include "pir_event.h"
+#include "sensor_drdy.h"
+#include "ram_func.h"
+#include "rtc_stop.h"
+#include "sample_timer.h"
+#include "sensor_registry.h"
+#include "time_base.h"
+#include "uart_tx.h"
+#include "watchdog.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -55,7 +73,37 @@
 /* USER CODE END 0 */
 
 /* External variables --------------------------------------------------------*/
+extern DMA_HandleTypeDef hdma_i2c1_rx;
+extern DMA_HandleTypeDef hdma_usart2_rx;
+extern DMA_HandleTypeDef hdma_usart2_tx;
+extern I2C_HandleTypeDef hi2c1;
+#if I2C_BUS_COUNT > 1
+extern DMA_HandleTypeDef hdma_i2c2_rx;
+extern I2C_HandleTypeDef hi2c2;
+#endif
+#if I2C_BUS_COUNT > 2
+extern DMA_HandleTypeDef hdma_i2c3_rx;
+extern I2C_HandleTypeDef hi2c3;
+#endif
 extern TIM_HandleTypeDef htim1;
+#if TIME_BASE
+extern TIM_HandleTypeDef htim2;
+#endif
+extern TIM_HandleTypeDef htim3;
+#if PIR_EVENT_CAPTURE
+extern TIM_HandleTypeDef htim5;
+#endif
+#if ADC_ACQUISITION
+extern DMA_HandleTypeDef hdma_adc1;
+#endif
+#if CAPTURE_ACQUISITION
+extern DMA_HandleTypeDef hdma_tim4_ch3;
+#endif
+extern UART_HandleTypeDef huart2;
+#if BULK_LINK
+extern DMA_HandleTypeDef hdma_usart1_tx;
+extern UART_HandleTypeDef huart1;
+#endif
 
 /* USER CODE BEGIN EV */
 
@@ -82,9 +130,16 @@ void NMI_Handler(void)
 /**
   * @brief This function handles Hard fault interrupt.
   */
+#if CRASH_CAPTURE
+CRASH_CAPTURE_HANDLER(HardFault_Handler)
+#else
 void HardFault_Handler(void)
 {
   /* USER CODE BEGIN HardFault_IRQn 0 */
+#if WATCHDOG
+  /* The IWDG resets the device out of the loop below */
+  watchdog_record(WATCHDOG_CAUSE_FAULT, 0, SCB->CFSR);
+#endif
 
   /* USER CODE END HardFault_IRQn 0 */
   while (1)
@@ -93,10 +148,14 @@ void HardFault_Handler(void)
     /* USER CODE END W1_HardFault_IRQn 0 */
   }
 }
+#endif
 
 /**
   * @brief This function handles Memory management fault.
   */
+#if CRASH_CAPTURE
+CRASH_CAPTURE_HANDLER(MemManage_Handler)
+#else
 void MemManage_Handler(void)
 {
   /* USER CODE BEGIN MemoryManagement_IRQn 0 */
@@ -108,10 +167,14 @@ void MemManage_Handler(void)
     /* USER CODE END W1_MemoryManagement_IRQn 0 */
   }
 }
+#endif
 
 /**
   * @brief This function handles Pre-fetch fault, memory access fault.
   */
+#if CRASH_CAPTURE
+CRASH_CAPTURE_HANDLER(BusFault_Handler)
+#else
 void BusFault_Handler(void)
 {
   /* USER CODE BEGIN BusFault_IRQn 0 */
@@ -123,10 +186,14 @@ void BusFault_Handler(void)
     /* USER CODE END W1_BusFault_IRQn 0 */
   }
 }
+#endif
 
 /**
   * @brief This function handles Undefined instruction or illegal state.
   */
+#if CRASH_CAPTURE
+CRASH_CAPTURE_HANDLER(UsageFault_Handler)
+#else
 void UsageFault_Handler(void)
 {
   /* USER CODE BEGIN UsageFault_IRQn 0 */
@@ -138,6 +205,7 @@ void UsageFault_Handler(void)
     /* USER CODE END W1_UsageFault_IRQn 0 */
   }
 }
+#endif
 
 /**
   * @brief This function handles Debug monitor.
@@ -159,20 +227,675 @@ void DebugMon_Handler(void)
 /* please refer to the startup file (startup_stm32f4xx.s).                    */
 /******************************************************************************/
 
+#if SENSOR_FIFO
+/**
+  * @brief This function handles EXTI line0 interrupt.
+  */
+void EXTI0_IRQHandler(void)
+{
+  /* USER CODE BEGIN EXTI0_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+
+  /* USER CODE END EXTI0_IRQn 0 */
+  HAL_GPIO_EXTI_IRQHandler(SENSOR_FIFO_READY_Pin);
+  /* USER CODE BEGIN EXTI0_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_EXTI0, &profile);
+#endif
+
+  /* USER CODE END EXTI0_IRQn 1 */
+}
+#endif
+
+#if PIR_EVENT_CAPTURE
+/**
+  * @brief This function handles EXTI line1 interrupt.
+  */
+void EXTI1_IRQHandler(void)
+{
+  /* USER CODE BEGIN EXTI1_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+
+  /* USER CODE END EXTI1_IRQn 0 */
+  HAL_GPIO_EXTI_IRQHandler(PIR_OUT_Pin);
+  /* USER CODE BEGIN EXTI1_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_EXTI1, &profile);
+#endif
+
+  /* USER CODE END EXTI1_IRQn 1 */
+}
+#endif
+
+#if SENSOR_DRDY
+/**
+  * @brief This function handles EXTI line[9:5] interrupts.
+  */
+void EXTI9_5_IRQHandler(void)
+{
+  /* USER CODE BEGIN EXTI9_5_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+  // Every pending line, cleared and reported together in one callback
+  uint16_t pending = (uint16_t)(__HAL_GPIO_EXTI_GET_IT(SENSOR_DRDY_PINS) & SENSOR_DRDY_PINS);
+
+  /* USER CODE END EXTI9_5_IRQn 0 */
+  HAL_GPIO_EXTI_IRQHandler(pending);
+  /* USER CODE BEGIN EXTI9_5_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_EXTI9_5, &profile);
+#endif
+
+  /* USER CODE END EXTI9_5_IRQn 1 */
+}
+#endif
+
+/**
+  * @brief This function handles DMA1 stream0 global interrupt.
+  */
+void DMA1_Stream0_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA1_Stream0_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+#if LL_FAST_PATH
+  i2c_acquisition_dma_from_isr(0);
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_DMA1_STREAM0, &profile);
+#endif
+  return;
+#endif
+  /* USER CODE END DMA1_Stream0_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_i2c1_rx);
+  /* USER CODE BEGIN DMA1_Stream0_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_DMA1_STREAM0, &profile);
+#endif
+
+  /* USER CODE END DMA1_Stream0_IRQn 1 */
+}
+
+#if I2C_BUS_COUNT > 2
+/**
+  * @brief This function handles DMA1 stream2 global interrupt.
+  */
+void DMA1_Stream2_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA1_Stream2_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+#if LL_FAST_PATH
+  i2c_acquisition_dma_from_isr(2);
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_DMA1_STREAM2, &profile);
+#endif
+  return;
+#endif
+  /* USER CODE END DMA1_Stream2_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_i2c3_rx);
+  /* USER CODE BEGIN DMA1_Stream2_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_DMA1_STREAM2, &profile);
+#endif
+
+  /* USER CODE END DMA1_Stream2_IRQn 1 */
+}
+#endif
+
+#if I2C_BUS_COUNT > 1
+/**
+  * @brief This function handles DMA1 stream3 global interrupt.
+  */
+void DMA1_Stream3_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA1_Stream3_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+#if LL_FAST_PATH
+  i2c_acquisition_dma_from_isr(1);
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_DMA1_STREAM3, &profile);
+#endif
+  return;
+#endif
+  /* USER CODE END DMA1_Stream3_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_i2c2_rx);
+  /* USER CODE BEGIN DMA1_Stream3_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_DMA1_STREAM3, &profile);
+#endif
+
+  /* USER CODE END DMA1_Stream3_IRQn 1 */
+}
+#endif
+
+/**
+  * @brief This function handles DMA1 stream5 global interrupt.
+  */
+void DMA1_Stream5_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA1_Stream5_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+
+  /* USER CODE END DMA1_Stream5_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_usart2_rx);
+  /* USER CODE BEGIN DMA1_Stream5_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_DMA1_STREAM5, &profile);
+#endif
+
+  /* USER CODE END DMA1_Stream5_IRQn 1 */
+}
+
+/**
+  * @brief This function handles DMA1 stream6 global interrupt.
+  */
+void DMA1_Stream6_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA1_Stream6_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+#if LL_FAST_PATH
+  uart_tx_dma_from_isr();
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_DMA1_STREAM6, &profile);
+#endif
+  return;
+#endif
+  /* USER CODE END DMA1_Stream6_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_usart2_tx);
+  /* USER CODE BEGIN DMA1_Stream6_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_DMA1_STREAM6, &profile);
+#endif
+
+  /* USER CODE END DMA1_Stream6_IRQn 1 */
+}
+
 /**
   * @brief This function handles TIM1 update interrupt and TIM10 global interrupt.
   */
 void TIM1_UP_TIM10_IRQHandler(void)
 {
   /* USER CODE BEGIN TIM1_UP_TIM10_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+  /* Counts microseconds from 0 since the update event */
+  isr_profile_latency(ISR_PROFILE_TIM1_UP_TIM10, TIM1->CNT);
+#endif
 
   /* USER CODE END TIM1_UP_TIM10_IRQn 0 */
   HAL_TIM_IRQHandler(&htim1);
   /* USER CODE BEGIN TIM1_UP_TIM10_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_TIM1_UP_TIM10, &profile);
+#endif
 
   /* USER CODE END TIM1_UP_TIM10_IRQn 1 */
 }
 
+#if TIME_BASE
+/**
+  * @brief This function handles TIM2 global interrupt.
+  */
+void TIM2_IRQHandler(void)
+{
+  /* USER CODE BEGIN TIM2_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+
+  /* USER CODE END TIM2_IRQn 0 */
+  HAL_TIM_IRQHandler(&htim2);
+  /* USER CODE BEGIN TIM2_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_TIM2, &profile);
+#endif
+
+  /* USER CODE END TIM2_IRQn 1 */
+}
+#endif
+
+/**
+  * @brief This function handles TIM3 global interrupt.
+  */
+#if FLASH_LOG_IDLE_ERASE
+/* Runs during the erases of the flash log, from SRAM with RAM_FUNCTIONS */
+RAMFUNC
+#endif
+void TIM3_IRQHandler(void)
+{
+  /* USER CODE BEGIN TIM3_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+  /* Counts from 0 since the tick, one step is 100 us */
+  isr_profile_latency(ISR_PROFILE_TIM3, TIM3->CNT * (1000000U / SAMPLE_TIMER_COUNTER_HZ));
+#endif
+
+  /* USER CODE END TIM3_IRQn 0 */
+#if FLASH_LOG_IDLE_ERASE
+  /* The update is the only enabled TIM3 interrupt, the HAL handler would run from flash */
+  if (__HAL_TIM_GET_FLAG(&htim3, TIM_FLAG_UPDATE) != RESET)
+  {
+    __HAL_TIM_CLEAR_IT(&htim3, TIM_IT_UPDATE);
+    sample_timer_elapsed_from_isr();
+  }
+#else
+  HAL_TIM_IRQHandler(&htim3);
+#endif
+  /* USER CODE BEGIN TIM3_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_TIM3, &profile);
+#endif
+
+  /* USER CODE END TIM3_IRQn 1 */
+}
+
+/**
+  * @brief This function handles I2C1 event interrupt.
+  */
+void I2C1_EV_IRQHandler(void)
+{
+  /* USER CODE BEGIN I2C1_EV_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+#if LL_FAST_PATH
+  i2c_acquisition_ev_from_isr(0);
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_I2C1_EV, &profile);
+#endif
+  return;
+#endif
+  /* USER CODE END I2C1_EV_IRQn 0 */
+  HAL_I2C_EV_IRQHandler(&hi2c1);
+  /* USER CODE BEGIN I2C1_EV_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_I2C1_EV, &profile);
+#endif
+
+  /* USER CODE END I2C1_EV_IRQn 1 */
+}
+
+/**
+  * @brief This function handles I2C1 error interrupt.
+  */
+void I2C1_ER_IRQHandler(void)
+{
+  /* USER CODE BEGIN I2C1_ER_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+#if LL_FAST_PATH
+  i2c_acquisition_er_from_isr(0);
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_I2C1_ER, &profile);
+#endif
+  return;
+#endif
+  /* USER CODE END I2C1_ER_IRQn 0 */
+  HAL_I2C_ER_IRQHandler(&hi2c1);
+  /* USER CODE BEGIN I2C1_ER_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_I2C1_ER, &profile);
+#endif
+
+  /* USER CODE END I2C1_ER_IRQn 1 */
+}
+
+#if I2C_BUS_COUNT > 1
+/**
+  * @brief This function handles I2C2 event interrupt.
+  */
+void I2C2_EV_IRQHandler(void)
+{
+  /* USER CODE BEGIN I2C2_EV_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+#if LL_FAST_PATH
+  i2c_acquisition_ev_from_isr(1);
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_I2C2_EV, &profile);
+#endif
+  return;
+#endif
+  /* USER CODE END I2C2_EV_IRQn 0 */
+  HAL_I2C_EV_IRQHandler(&hi2c2);
+  /* USER CODE BEGIN I2C2_EV_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_I2C2_EV, &profile);
+#endif
+
+  /* USER CODE END I2C2_EV_IRQn 1 */
+}
+
+/**
+  * @brief This function handles I2C2 error interrupt.
+  */
+void I2C2_ER_IRQHandler(void)
+{
+  /* USER CODE BEGIN I2C2_ER_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+#if LL_FAST_PATH
+  i2c_acquisition_er_from_isr(1);
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_I2C2_ER, &profile);
+#endif
+  return;
+#endif
+  /* USER CODE END I2C2_ER_IRQn 0 */
+  HAL_I2C_ER_IRQHandler(&hi2c2);
+  /* USER CODE BEGIN I2C2_ER_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_I2C2_ER, &profile);
+#endif
+
+  /* USER CODE END I2C2_ER_IRQn 1 */
+}
+#endif
+
+#if I2C_BUS_COUNT > 2
+/**
+  * @brief This function handles I2C3 event interrupt.
+  */
+void I2C3_EV_IRQHandler(void)
+{
+  /* USER CODE BEGIN I2C3_EV_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+#if LL_FAST_PATH
+  i2c_acquisition_ev_from_isr(2);
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_I2C3_EV, &profile);
+#endif
+  return;
+#endif
+  /* USER CODE END I2C3_EV_IRQn 0 */
+  HAL_I2C_EV_IRQHandler(&hi2c3);
+  /* USER CODE BEGIN I2C3_EV_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_I2C3_EV, &profile);
+#endif
+
+  /* USER CODE END I2C3_EV_IRQn 1 */
+}
+
+/**
+  * @brief This function handles I2C3 error interrupt.
+  */
+void I2C3_ER_IRQHandler(void)
+{
+  /* USER CODE BEGIN I2C3_ER_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+#if LL_FAST_PATH
+  i2c_acquisition_er_from_isr(2);
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_I2C3_ER, &profile);
+#endif
+  return;
+#endif
+  /* USER CODE END I2C3_ER_IRQn 0 */
+  HAL_I2C_ER_IRQHandler(&hi2c3);
+  /* USER CODE BEGIN I2C3_ER_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_I2C3_ER, &profile);
+#endif
+
+  /* USER CODE END I2C3_ER_IRQn 1 */
+}
+#endif
+
+/**
+  * @brief This function handles USART2 global interrupt.
+  */
+void USART2_IRQHandler(void)
+{
+  /* USER CODE BEGIN USART2_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+
+  /* USER CODE END USART2_IRQn 0 */
+  HAL_UART_IRQHandler(&huart2);
+  /* USER CODE BEGIN USART2_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_USART2, &profile);
+#endif
+
+  /* USER CODE END USART2_IRQn 1 */
+}
+
+#if PIR_EVENT_CAPTURE
+/**
+  * @brief This function handles TIM5 global interrupt.
+  */
+void TIM5_IRQHandler(void)
+{
+  /* USER CODE BEGIN TIM5_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+
+  /* USER CODE END TIM5_IRQn 0 */
+  HAL_TIM_IRQHandler(&htim5);
+  /* USER CODE BEGIN TIM5_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_TIM5, &profile);
+#endif
+
+  /* USER CODE END TIM5_IRQn 1 */
+}
+#endif
+
+#if ADC_ACQUISITION
+/**
+  * @brief This function handles DMA2 stream0 global interrupt.
+  */
+void DMA2_Stream0_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA2_Stream0_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+
+  /* USER CODE END DMA2_Stream0_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_adc1);
+  /* USER CODE BEGIN DMA2_Stream0_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_DMA2_STREAM0, &profile);
+#endif
+
+  /* USER CODE END DMA2_Stream0_IRQn 1 */
+}
+#endif
+
+#if DMA_COPY
+/**
+  * @brief This function handles DMA2 stream1 global interrupt, the memory copies.
+  */
+void DMA2_Stream1_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA2_Stream1_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+
+  /* USER CODE END DMA2_Stream1_IRQn 0 */
+  dma_copy_irq_from_isr();
+  /* USER CODE BEGIN DMA2_Stream1_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_DMA2_STREAM1, &profile);
+#endif
+
+  /* USER CODE END DMA2_Stream1_IRQn 1 */
+}
+#endif
+
+#if BULK_LINK
+/**
+  * @brief This function handles DMA2 stream7 global interrupt, USART1_TX.
+  */
+void DMA2_Stream7_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA2_Stream7_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+
+  /* USER CODE END DMA2_Stream7_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_usart1_tx);
+  /* USER CODE BEGIN DMA2_Stream7_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_DMA2_STREAM7, &profile);
+#endif
+
+  /* USER CODE END DMA2_Stream7_IRQn 1 */
+}
+
+/**
+  * @brief This function handles USART1 global interrupt.
+  */
+void USART1_IRQHandler(void)
+{
+  /* USER CODE BEGIN USART1_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+
+  /* USER CODE END USART1_IRQn 0 */
+  HAL_UART_IRQHandler(&huart1);
+  /* USER CODE BEGIN USART1_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_USART1, &profile);
+#endif
+
+  /* USER CODE END USART1_IRQn 1 */
+}
+#endif
+
+#if CAPTURE_ACQUISITION
+/**
+  * @brief This function handles TIM4 global interrupt.
+  */
+void TIM4_IRQHandler(void)
+{
+  /* USER CODE BEGIN TIM4_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+
+  /* USER CODE END TIM4_IRQn 0 */
+  capture_acquisition_wrap_from_isr();
+  /* USER CODE BEGIN TIM4_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_TIM4, &profile);
+#endif
+
+  /* USER CODE END TIM4_IRQn 1 */
+}
+
+/**
+  * @brief This function handles DMA1 stream7 global interrupt.
+  */
+void DMA1_Stream7_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA1_Stream7_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+
+  /* USER CODE END DMA1_Stream7_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_tim4_ch3);
+  /* USER CODE BEGIN DMA1_Stream7_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_DMA1_STREAM7, &profile);
+#endif
+
+  /* USER CODE END DMA1_Stream7_IRQn 1 */
+}
+#endif
+
+#if RTC_STOP_SAMPLING
+/**
+  * @brief This function handles RTC wake-up interrupt through EXTI line 22.
+  */
+void RTC_WKUP_IRQHandler(void)
+{
+  /* USER CODE BEGIN RTC_WKUP_IRQn 0 */
+#if ISR_PROFILE
+  isr_profile_context_t profile;
+  isr_profile_enter(&profile);
+#endif
+
+  /* USER CODE END RTC_WKUP_IRQn 0 */
+  rtc_stop_wakeup_from_isr();
+  /* USER CODE BEGIN RTC_WKUP_IRQn 1 */
+#if ISR_PROFILE
+  isr_profile_exit(ISR_PROFILE_RTC_WKUP, &profile);
+#endif
+
+  /* USER CODE END RTC_WKUP_IRQn 1 */
+}
+#endif
+
 /* USER CODE BEGIN 1 */
+#if ISR_PIPELINE
+/**
+  * @brief This function handles the deferred work of the interrupt-only mode.
+  */
+void HASH_RNG_IRQHandler(void)
+{
+  isr_pipeline_deferred_from_isr();
+}
+#endif
+
+#if PC_PROFILE
+/**
+  * @brief This function handles TIM7 global interrupt, the sampling profiler.
+  */
+PC_PROFILE_HANDLER(TIM7_IRQHandler)
+#endif
 
 /* USER CODE END 1 */
@@ -0,0 +1,77 @@
+/**
+  ******************************************************************************
+  * @file    swo_trace.c
+  * @brief   ITM stimulus ports over SWO for debug output and timing markers.
+  *
+  *          The ITM sends what is written to a stimulus port register out of
+  *          the SWO pin, in the background and apart from USART2, so debug
+  *          text and timing markers never take airtime from the data link.
+  *          A probe that sets up SWV keeps its own settings. Without one
+  *          the TPIU is set to NRZ at SWO_TRACE_BAUD, which is 8N1 and can
+  *          also be read with a plain serial adapter on PB3.
+  *
+  *          _write waits for the FIFO, one byte every 5 us at 2 Mbit/s, so
+  *          printf belongs in code that is not timed. The markers are one
+  *          store and are dropped when the FIFO is full. With the port off,
+  *          both return at once.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "swo_trace.h"
+#include "kernel_trace.h"
+
+/* Private defines -----------------------------------------------------------*/
+// CoreSight lock access key of the ITM
+#define SWO_TRACE_ITM_UNLOCK 0xC5ACCE55U
+// TPIU protocol, asynchronous NRZ
+#define SWO_TRACE_PROTOCOL_NRZ 2U
+// ATB ID of the ITM in the trace stream
+#define SWO_TRACE_BUS_ID 1U
+
+/* Exported variables --------------------------------------------------------*/
+volatile uint32_t swo_trace_marker_drops;
+
+// Function to set up SWO and the stimulus ports, unless a probe did
+void swo_trace_init(void) {
+    uint32_t ports = (1UL << SWO_TRACE_LOG_PORT) | (1UL << SWO_TRACE_MARKER_PORT);
+
+#if KERNEL_TRACE
+    ports |= 1UL << KERNEL_TRACE_ITM_PORT;
+#endif
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    if ((ITM->TCR & ITM_TCR_ITMENA_Msk) != 0) {
+        // The probe set the rate and chose its ports
+        return;
+    }
+
+    // TRACESWO on PB3 in asynchronous mode
+    DBGMCU->CR = (DBGMCU->CR & ~DBGMCU_CR_TRACE_MODE) | DBGMCU_CR_TRACE_IOEN;
+    TPI->SPPR = SWO_TRACE_PROTOCOL_NRZ;
+    TPI->ACPR = SystemCoreClock / SWO_TRACE_BAUD - 1U;
+    // Formatter off, the ITM packets go out as they are
+    TPI->FFCR = TPI_FFCR_TrigIn_Msk;
+
+    ITM->LAR = SWO_TRACE_ITM_UNLOCK;
+    ITM->TCR = (SWO_TRACE_BUS_ID << ITM_TCR_TraceBusID_Pos) | ITM_TCR_SYNCENA_Msk | ITM_TCR_ITMENA_Msk;
+    ITM->TPR = 0;
+    ITM->TER = ports;
+}
+
+#if SWO_TRACE
+// Newlib output, stdout and stderr go to the log port. Replaces the weak one
+// of syscalls.c, which has no __io_putchar behind it.
+int _write(int file, char *ptr, int len) {
+    (void)file;
+    if ((ITM->TCR & ITM_TCR_ITMENA_Msk) == 0 || (ITM->TER & (1UL << SWO_TRACE_LOG_PORT)) == 0) {
+        return len;
+    }
+    for (int i = 0; i < len; ++i) {
+        while (ITM->PORT[SWO_TRACE_LOG_PORT].u32 == 0UL) {
+            __NOP();
+        }
+        ITM->PORT[SWO_TRACE_LOG_PORT].u8 = (uint8_t)ptr[i];
+    }
+    return len;
+}
+#endif
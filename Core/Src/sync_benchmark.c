@@ -0,0 +1,320 @@
+/**
+  ******************************************************************************
+  * @file    sync_benchmark.c
+  * @brief   On-target cycle benchmark of the kernel and core synchronization primitives.
+  *
+  *          Every case is timed with the DWT cycle counter around the calls
+  *          only. Unlike the statistics kernels they run with interrupts
+  *          enabled, a kernel call must not be made from inside a critical
+  *          section and the cases that switch context cannot be. The minimum
+  *          is the cost of the primitive, the maximum has an interrupt in it.
+  *
+  *          The critical sections are the BASEPRI ones of the port, nesting
+  *          from a task or saved and restored from an ISR; the kernel masks
+  *          interrupts the same way and never disables them. FreeRTOS atomic.h
+  *          is built on the ISR variant of the same mask on this port, so
+  *          the LDREX/STREX loop the core offers is timed next to it. The
+  *          CMSIS-RTOS v1 wrappers are timed on the same objects as the
+  *          native calls they forward to, the difference is the wrapper.
+  *
+  *          For contention the partner task, one priority higher, waits on
+  *          the same primitive. Each handoff then wakes a task and switches
+  *          to it: the benchmark task signals, the partner runs at once,
+  *          signals back and blocks again, and the benchmark task takes the
+  *          reply. For the mutex the partner blocks on the mutex the
+  *          benchmark task holds, which inherits its priority until it gives
+  *          the mutex up, the release is timed until the partner is done.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sync_benchmark.h"
+
+#if SYNC_BENCHMARK
+#include "cmsis_os.h"
+#include "atomic.h"
+#include "cycle_counter.h"
+#include "pipeline_priorities.h"
+#include "semphr.h"
+#include "stream_buffer.h"
+#include "task_signal.h"
+#include "uart_tx.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+#ifndef SYNC_BENCHMARK_STACK_SIZE
+#define SYNC_BENCHMARK_STACK_SIZE 256
+#endif
+#ifndef SYNC_BENCHMARK_PARTNER_STACK_SIZE
+#define SYNC_BENCHMARK_PARTNER_STACK_SIZE 128
+#endif
+// Above the consumer, below the producer, like the statistics benchmark
+#define SYNC_BENCHMARK_PRIORITY TASK_PRIORITY_CONTROL
+// One above, so every handoff to it switches at once
+#define SYNC_BENCHMARK_PARTNER_PRIORITY (TASK_PRIORITY_CONTROL + 1)
+// Any bit, the task has no other source
+#define SYNC_BENCHMARK_SIGNAL (1UL << 0)
+// One word per message
+#define SYNC_BENCHMARK_STREAM_SIZE 16U
+
+/* Private types -------------------------------------------------------------*/
+typedef enum {
+    SYNC_CRITICAL,          // taskENTER_CRITICAL / taskEXIT_CRITICAL
+    SYNC_CRITICAL_FROM_ISR, // taskENTER_CRITICAL_FROM_ISR / taskEXIT_CRITICAL_FROM_ISR
+    SYNC_ATOMIC,            // Atomic_Increment_u32 of atomic.h
+    SYNC_LDREX_STREX,       // Exclusive load and store increment
+    SYNC_OS_MUTEX,          // CMSIS osMutexWait / osMutexRelease
+    SYNC_MUTEX,             // xSemaphoreTake / xSemaphoreGive on a mutex
+    SYNC_SEMAPHORE,         // xSemaphoreGive / xSemaphoreTake on a binary semaphore
+    SYNC_NOTIFY,            // xTaskNotifyGive / ulTaskNotifyTake
+    SYNC_STREAM,            // xStreamBufferSend / xStreamBufferReceive of one word
+    SYNC_OS_SEMAPHORE,      // CMSIS osSemaphoreRelease / osSemaphoreWait on the same semaphore
+    SYNC_OS_SIGNAL,         // CMSIS osSignalSet / osSignalWait
+    SYNC_TASK_SIGNAL,       // task_signal_set / task_signal_wait, the pipeline's own
+    SYNC_UNCONTENDED_COUNT,
+    // Round trips through the partner task
+    SYNC_PING_SEMAPHORE = SYNC_UNCONTENDED_COUNT,
+    SYNC_PING_NOTIFY,
+    SYNC_PING_STREAM,
+    SYNC_PING_MUTEX,
+    SYNC_CASE_COUNT
+} sync_case_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const char *const sync_names[SYNC_CASE_COUNT] = {
+    "critical", "critical_from_isr", "atomic_h", "ldrex_strex", "os_mutex", "mutex", "semaphore",
+    "notify", "stream", "os_semaphore", "os_signal", "task_signal", "semaphore", "notify", "stream", "mutex"
+};
+static const char report_header[] = "primitive,contention,min,avg,max\r\n";
+
+static volatile uint32_t sync_counter;
+static volatile sync_case_t sync_partner_case;
+
+static osStaticMutexDef_t sync_os_mutex_storage;
+osMutexStaticDef(sync_os_mutex, &sync_os_mutex_storage);
+static osMutexId sync_os_mutex_id;
+static SemaphoreHandle_t sync_mutex;
+static StaticSemaphore_t sync_mutex_storage;
+// Ping to the partner, pong back
+static SemaphoreHandle_t sync_ping;
+static StaticSemaphore_t sync_ping_storage;
+static SemaphoreHandle_t sync_pong;
+static StaticSemaphore_t sync_pong_storage;
+// Starts the partner on sync_partner_case
+static SemaphoreHandle_t sync_go;
+static StaticSemaphore_t sync_go_storage;
+static StreamBufferHandle_t sync_ping_stream;
+static StaticStreamBuffer_t sync_ping_stream_storage;
+static uint8_t sync_ping_stream_buffer[SYNC_BENCHMARK_STREAM_SIZE + 1U];
+static StreamBufferHandle_t sync_pong_stream;
+static StaticStreamBuffer_t sync_pong_stream_storage;
+static uint8_t sync_pong_stream_buffer[SYNC_BENCHMARK_STREAM_SIZE + 1U];
+
+static TaskHandle_t sync_benchmark_task_handle;
+static StaticTask_t sync_benchmark_task_tcb;
+static StackType_t sync_benchmark_task_stack[SYNC_BENCHMARK_STACK_SIZE] CCMRAM_NOINIT;
+static TaskHandle_t sync_partner_task_handle;
+static StaticTask_t sync_partner_task_tcb;
+static StackType_t sync_partner_task_stack[SYNC_BENCHMARK_PARTNER_STACK_SIZE] CCMRAM_NOINIT;
+
+/* Private function prototypes -----------------------------------------------*/
+static void sync_benchmark_task(void *argument);
+static void sync_partner_task(void *argument);
+static uint32_t sync_benchmark_run(sync_case_t sync_case);
+
+// Function to create the primitives and both tasks
+void sync_benchmark_start(void) {
+    sync_os_mutex_id = osMutexCreate(osMutex(sync_os_mutex));
+    sync_mutex = xSemaphoreCreateMutexStatic(&sync_mutex_storage);
+    sync_ping = xSemaphoreCreateBinaryStatic(&sync_ping_storage);
+    sync_pong = xSemaphoreCreateBinaryStatic(&sync_pong_storage);
+    sync_go = xSemaphoreCreateBinaryStatic(&sync_go_storage);
+    sync_ping_stream = xStreamBufferCreateStatic(SYNC_BENCHMARK_STREAM_SIZE, sizeof(uint32_t),
+                                                 sync_ping_stream_buffer, &sync_ping_stream_storage);
+    sync_pong_stream = xStreamBufferCreateStatic(SYNC_BENCHMARK_STREAM_SIZE, sizeof(uint32_t),
+                                                 sync_pong_stream_buffer, &sync_pong_stream_storage);
+
+    sync_benchmark_task_handle = xTaskCreateStatic(sync_benchmark_task, "SyncBench", SYNC_BENCHMARK_STACK_SIZE,
+                                                   NULL, SYNC_BENCHMARK_PRIORITY, sync_benchmark_task_stack,
+                                                   &sync_benchmark_task_tcb);
+    sync_partner_task_handle = xTaskCreateStatic(sync_partner_task, "SyncPeer", SYNC_BENCHMARK_PARTNER_STACK_SIZE,
+                                                 NULL, SYNC_BENCHMARK_PARTNER_PRIORITY, sync_partner_task_stack,
+                                                 &sync_partner_task_tcb);
+}
+
+// Function to time one run of a case
+static uint32_t sync_benchmark_run(sync_case_t sync_case) {
+    uint32_t word = 0;
+    uint32_t start;
+    uint32_t cycles;
+
+    switch (sync_case) {
+    case SYNC_CRITICAL:
+        start = cycle_counter_now();
+        taskENTER_CRITICAL();
+        taskEXIT_CRITICAL();
+        cycles = cycle_counter_since(start);
+        break;
+    case SYNC_CRITICAL_FROM_ISR: {
+        start = cycle_counter_now();
+        UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+        taskEXIT_CRITICAL_FROM_ISR(mask);
+        cycles = cycle_counter_since(start);
+        break;
+    }
+    case SYNC_ATOMIC:
+        start = cycle_counter_now();
+        (void)Atomic_Increment_u32(&sync_counter);
+        cycles = cycle_counter_since(start);
+        break;
+    case SYNC_LDREX_STREX:
+        start = cycle_counter_now();
+        do {
+            word = __LDREXW(&sync_counter);
+        } while (__STREXW(word + 1U, &sync_counter) != 0U);
+        cycles = cycle_counter_since(start);
+        break;
+    case SYNC_OS_MUTEX:
+        start = cycle_counter_now();
+        (void)osMutexWait(sync_os_mutex_id, 0);
+        (void)osMutexRelease(sync_os_mutex_id);
+        cycles = cycle_counter_since(start);
+        break;
+    case SYNC_MUTEX:
+        start = cycle_counter_now();
+        (void)xSemaphoreTake(sync_mutex, 0);
+        (void)xSemaphoreGive(sync_mutex);
+        cycles = cycle_counter_since(start);
+        break;
+    case SYNC_SEMAPHORE:
+        start = cycle_counter_now();
+        (void)xSemaphoreGive(sync_ping);
+        (void)xSemaphoreTake(sync_ping, 0);
+        cycles = cycle_counter_since(start);
+        break;
+    case SYNC_NOTIFY:
+        start = cycle_counter_now();
+        xTaskNotifyGive(sync_benchmark_task_handle);
+        (void)ulTaskNotifyTake(pdTRUE, 0);
+        cycles = cycle_counter_since(start);
+        break;
+    case SYNC_STREAM:
+        start = cycle_counter_now();
+        (void)xStreamBufferSend(sync_ping_stream, &word, sizeof(word), 0);
+        (void)xStreamBufferReceive(sync_ping_stream, &word, sizeof(word), 0);
+        cycles = cycle_counter_since(start);
+        break;
+    case SYNC_OS_SEMAPHORE:
+        start = cycle_counter_now();
+        (void)osSemaphoreRelease(sync_ping);
+        (void)osSemaphoreWait(sync_ping, 0);
+        cycles = cycle_counter_since(start);
+        break;
+    case SYNC_OS_SIGNAL:
+        start = cycle_counter_now();
+        (void)osSignalSet(sync_benchmark_task_handle, SYNC_BENCHMARK_SIGNAL);
+        (void)osSignalWait(SYNC_BENCHMARK_SIGNAL, 0);
+        cycles = cycle_counter_since(start);
+        break;
+    case SYNC_TASK_SIGNAL:
+        start = cycle_counter_now();
+        task_signal_set(sync_benchmark_task_handle, SYNC_BENCHMARK_SIGNAL);
+        (void)task_signal_wait(SYNC_BENCHMARK_SIGNAL, 0);
+        cycles = cycle_counter_since(start);
+        break;
+    case SYNC_PING_SEMAPHORE:
+        start = cycle_counter_now();
+        (void)xSemaphoreGive(sync_ping);
+        (void)xSemaphoreTake(sync_pong, portMAX_DELAY);
+        cycles = cycle_counter_since(start);
+        break;
+    case SYNC_PING_NOTIFY:
+        start = cycle_counter_now();
+        xTaskNotifyGive(sync_partner_task_handle);
+        (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        cycles = cycle_counter_since(start);
+        break;
+    case SYNC_PING_STREAM:
+        start = cycle_counter_now();
+        (void)xStreamBufferSend(sync_ping_stream, &word, sizeof(word), portMAX_DELAY);
+        (void)xStreamBufferReceive(sync_pong_stream, &word, sizeof(word), portMAX_DELAY);
+        cycles = cycle_counter_since(start);
+        break;
+    default:
+        // The partner blocks on the mutex held here before the release is timed
+        (void)xSemaphoreTake(sync_mutex, portMAX_DELAY);
+        xTaskNotifyGive(sync_partner_task_handle);
+        start = cycle_counter_now();
+        (void)xSemaphoreGive(sync_mutex);
+        cycles = cycle_counter_since(start);
+        break;
+    }
+    return cycles;
+}
+
+// Function to time every case and report the results
+static void sync_benchmark_task(void *argument) {
+    char line[UART_TX_FRAME_MAX];
+
+    (void)argument;
+    uart_tx_send_blocking((const uint8_t *)report_header, sizeof(report_header) - 1);
+    for (uint32_t sync_case = 0; sync_case < SYNC_CASE_COUNT; ++sync_case) {
+        uint32_t min = UINT32_MAX, max = 0;
+        uint64_t total = 0;
+
+        if (sync_case >= SYNC_UNCONTENDED_COUNT) {
+            // The partner runs at once and waits on the primitive of the case
+            sync_partner_case = (sync_case_t)sync_case;
+            (void)xSemaphoreGive(sync_go);
+        }
+        for (uint32_t run = 0; run < SYNC_BENCHMARK_RUNS; ++run) {
+            uint32_t cycles = sync_benchmark_run((sync_case_t)sync_case);
+            min = cycles < min ? cycles : min;
+            max = cycles > max ? cycles : max;
+            total += cycles;
+        }
+
+        snprintf(line, sizeof(line), "%s,%s,%lu,%lu,%lu\r\n", sync_names[sync_case],
+                 sync_case >= SYNC_UNCONTENDED_COUNT ? "ping_pong" : "none", (unsigned long)min,
+                 (unsigned long)(total / SYNC_BENCHMARK_RUNS), (unsigned long)max);
+        uart_tx_send_blocking((const uint8_t *)line, (uint16_t)strlen(line));
+    }
+
+    // The partner waits on sync_go again, nothing of either task is left running
+    vTaskDelete(sync_partner_task_handle);
+    vTaskDelete(NULL);
+}
+
+// Partner task, answers every run of the case it was started on
+static void sync_partner_task(void *argument) {
+    uint32_t word;
+
+    (void)argument;
+    while (1) {
+        (void)xSemaphoreTake(sync_go, portMAX_DELAY);
+        for (uint32_t run = 0; run < SYNC_BENCHMARK_RUNS; ++run) {
+            switch (sync_partner_case) {
+            case SYNC_PING_SEMAPHORE:
+                (void)xSemaphoreTake(sync_ping, portMAX_DELAY);
+                (void)xSemaphoreGive(sync_pong);
+                break;
+            case SYNC_PING_NOTIFY:
+                (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                xTaskNotifyGive(sync_benchmark_task_handle);
+                break;
+            case SYNC_PING_STREAM:
+                (void)xStreamBufferReceive(sync_ping_stream, &word, sizeof(word), portMAX_DELAY);
+                (void)xStreamBufferSend(sync_pong_stream, &word, sizeof(word), portMAX_DELAY);
+                break;
+            default:
+                // Blocks on the mutex until the benchmark task gives it up
+                (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                (void)xSemaphoreTake(sync_mutex, portMAX_DELAY);
+                (void)xSemaphoreGive(sync_mutex);
+                break;
+            }
+        }
+    }
+}
+#endif /* SYNC_BENCHMARK */
@@ -23,6 +23,12 @@
 /* Includes */
 #include <errno.h>
 #include <stdint.h>
+#include "heap_telemetry.h"
+#if LEAN_RUNTIME
+#include <reent.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
 
 /**
  * Pointer to the current high watermark of the heap usage
@@ -69,11 +75,47 @@ void *_sbrk(ptrdiff_t incr)
   if (__sbrk_heap_end + incr > max_heap)
   {
     errno = ENOMEM;
+#if HEAP_TELEMETRY
+    heap_telemetry_sbrk_failed();
+#endif
     return (void *)-1;
   }
 
   prev_heap_end = __sbrk_heap_end;
   __sbrk_heap_end += incr;
+#if HEAP_TELEMETRY
+  heap_telemetry_sbrk((int32_t)incr, (uint32_t)(__sbrk_heap_end - &_end));
+#endif
 
   return (void *)prev_heap_end;
 }
+
+#if LEAN_RUNTIME
+/**
+ * @brief __malloc_lock() and __malloc_unlock() guard the newlib heap, which
+ *        all tasks share once configUSE_NEWLIB_REENTRANT is 0
+ *
+ * The scheduler is suspended rather than a mutex taken, the lock nests and
+ * malloc can run before vTaskStartScheduler(). Never call malloc from an
+ * interrupt.
+ *
+ * @param r Unused, the reentrancy structure of the caller
+ */
+void __malloc_lock(struct _reent *r)
+{
+  (void)r;
+  if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+  {
+    vTaskSuspendAll();
+  }
+}
+
+void __malloc_unlock(struct _reent *r)
+{
+  (void)r;
+  if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+  {
+    (void)xTaskResumeAll();
+  }
+}
+#endif
@@ -0,0 +1,41 @@
+/**
+  ******************************************************************************
+  * @file    task_signal.c
+  * @brief   Event bits on FreeRTOS direct-to-task notifications.
+  *
+  *          A notification is cheaper than a semaphore and needs no kernel
+  *          object, but FreeRTOS 10.3 has one notification per task. The
+  *          producer waits for both the sampling tick and I2C completions, so
+  *          each source owns a bit of the notification value. xTaskNotifyWait
+  *          only clears the bits of the caller, and when other bits are still
+  *          set on return the task notifies itself so the next wait for them
+  *          does not block. The setters are inline in the header.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "task_signal.h"
+
+// Function to wait for any of the given bits
+uint32_t task_signal_wait(uint32_t bits, TickType_t timeout) {
+    TimeOut_t time_out;
+    uint32_t value = 0;
+    uint32_t signalled = 0;
+
+    vTaskSetTimeOutState(&time_out);
+    while (1) {
+        if (xTaskNotifyWait(0, bits, &value, timeout) == pdTRUE) {
+            signalled = value & bits;
+        }
+        // Stop once signalled, or when the remaining time has run out
+        if (signalled != 0 || xTaskCheckForTimeOut(&time_out, &timeout) == pdTRUE) {
+            break;
+        }
+    }
+
+    // Keep other sources pending, the state was consumed by this wait
+    if ((value & ~bits) != 0) {
+        xTaskNotify(xTaskGetCurrentTaskHandle(), 0, eSetBits);
+    }
+    return signalled;
+}
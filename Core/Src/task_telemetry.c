@@ -0,0 +1,87 @@
+/**
+  ******************************************************************************
+  * @file    task_telemetry.c
+  * @brief   Per-task CPU load, stack and context switch telemetry frame.
+  *
+  *          CPU time comes from the FreeRTOS run-time stats on the 1 MHz TIM2
+  *          counter. Loads are reported per interval between two frames, so
+  *          the 32-bit counter may wrap (every 71 minutes) without harm as
+  *          long as frames are sent more often than that. Context switches
+  *          are counted by the traceTASK_SWITCHED_IN hook in a small table
+  *          keyed by the TCB.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "task_telemetry.h"
+#include "cmsis_os.h"
+#include <string.h>
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    void *task;
+    uint32_t switches;
+} task_switch_count_t;
+
+/* Private variables ---------------------------------------------------------*/
+// Written by the scheduler hook only
+static task_switch_count_t switch_counts[TASK_TELEMETRY_MAX_TASKS];
+// State of the previous frame, indexed by task number
+static uint32_t previous_run_time[TASK_TELEMETRY_MAX_TASKS + 1];
+static uint32_t previous_switches[TASK_TELEMETRY_MAX_TASKS + 1];
+static uint32_t previous_total;
+static TaskStatus_t task_status[TASK_TELEMETRY_MAX_TASKS];
+
+// Function to count a context switch, runs inside the scheduler
+void task_telemetry_switched_in(void *task) {
+    for (uint32_t i = 0; i < TASK_TELEMETRY_MAX_TASKS; ++i) {
+        if (switch_counts[i].task == task || switch_counts[i].task == NULL) {
+            switch_counts[i].task = task;
+            switch_counts[i].switches++;
+            return;
+        }
+    }
+}
+
+// Function to find the switch count of a task
+static uint32_t task_switches(TaskHandle_t task) {
+    for (uint32_t i = 0; i < TASK_TELEMETRY_MAX_TASKS; ++i) {
+        if (switch_counts[i].task == (void *)task) {
+            return switch_counts[i].switches;
+        }
+    }
+    return 0;
+}
+
+// Function to build a telemetry frame for the interval since the last one
+uint16_t task_telemetry_build(task_telemetry_frame_t *frame) {
+    uint32_t total = 0;
+    UBaseType_t count = uxTaskGetSystemState(task_status, TASK_TELEMETRY_MAX_TASKS, &total);
+    uint32_t interval = total - previous_total;
+
+    memset(frame, 0, sizeof(*frame));
+    frame->type = TASK_TELEMETRY_FRAME_TYPE;
+    frame->task_count = (uint8_t)count;
+    frame->interval_us = interval;
+
+    for (UBaseType_t i = 0; i < count; ++i) {
+        const TaskStatus_t *status = &task_status[i];
+        task_telemetry_entry_t *entry = &frame->tasks[i];
+        uint32_t number = status->xTaskNumber <= TASK_TELEMETRY_MAX_TASKS ? status->xTaskNumber : 0;
+        uint32_t run_time = status->ulRunTimeCounter - previous_run_time[number];
+        uint32_t switches = task_switches(status->xHandle);
+        uint32_t new_switches = switches - previous_switches[number];
+
+        entry->task_number = (uint8_t)status->xTaskNumber;
+        entry->priority = (uint8_t)status->uxCurrentPriority;
+        entry->cpu_permille = interval != 0 ? (uint16_t)(((uint64_t)run_time * 1000U) / interval) : 0;
+        entry->stack_free_words = status->usStackHighWaterMark;
+        entry->switches = new_switches > UINT16_MAX ? UINT16_MAX : (uint16_t)new_switches;
+
+        previous_run_time[number] = status->ulRunTimeCounter;
+        previous_switches[number] = switches;
+    }
+    previous_total = total;
+
+    return (uint16_t)(offsetof(task_telemetry_frame_t, tasks) + count * sizeof(task_telemetry_entry_t));
+}
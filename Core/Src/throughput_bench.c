@@ -0,0 +1,152 @@
+/**
+  ******************************************************************************
+  * @file    throughput_bench.c
+  * @brief   Throughput stress benchmark of the whole pipeline on simulated sensors.
+  *
+  *          The sensors come from sensor_sim, so nothing waits on a bus and
+  *          the sampling period can go down to 1 ms. Each step runs one
+  *          window size at one period, lets it settle, then counts over
+  *          THROUGHPUT_BENCH_DWELL_MS what the pipeline failed to keep up
+  *          with: ticks the producer missed or overran (deadline_monitor),
+  *          samples the rings dropped because the consumer fell behind and
+  *          frames the transmit queue dropped. Any of them fails the step.
+  *          The task runs at supervisor priority so the steps keep their
+  *          length when the pipeline saturates, it sleeps in between.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "throughput_bench.h"
+#include "adaptive_rate.h"
+#include "cmsis_os.h"
+#include "deadline_monitor.h"
+#include "pipeline_config.h"
+#include "pipeline_priorities.h"
+#include "sample_timer.h"
+#include "sensor_sim.h"
+#include "sensor_stats.h"
+#include "stack_profile.h"
+#include "uart_tx.h"
+#include <stdio.h>
+#include <string.h>
+
+#if THROUGHPUT_BENCH && !(SENSOR_SIMULATION && DEADLINE_MONITOR)
+#error "THROUGHPUT_BENCH needs SENSOR_SIMULATION and DEADLINE_MONITOR"
+#endif
+#if THROUGHPUT_BENCH && ADAPTIVE_RATE
+#error "THROUGHPUT_BENCH sets the window, ADAPTIVE_RATE would change it under the benchmark"
+#endif
+#if THROUGHPUT_BENCH && RTC_STOP_SAMPLING
+#error "THROUGHPUT_BENCH steps the period in milliseconds, the RTC wakeup only counts seconds"
+#endif
+
+/* Private defines -----------------------------------------------------------*/
+#ifndef THROUGHPUT_BENCH_STACK_SIZE
+#define THROUGHPUT_BENCH_STACK_SIZE 256
+#endif
+#define THROUGHPUT_BENCH_PRIORITY TASK_PRIORITY_SUPERVISE
+
+/* Private types -------------------------------------------------------------*/
+// What the pipeline failed to keep up with, counters since boot
+typedef struct {
+    uint32_t ticks;
+    uint32_t missed;
+    uint32_t overruns;
+    uint32_t ring_drops;
+    uint32_t frame_drops;
+} throughput_counts_t;
+
+/* Private variables ---------------------------------------------------------*/
+// Sampling periods of a ramp, slowest first
+static const uint32_t bench_periods_ms[] = { 20, 10, 5, 4, 3, 2, 1 };
+static const uint32_t bench_window_sizes[] = { 16, 32, 64, 100, STATS_WINDOW_CAPACITY };
+static const char report_header[] =
+    "window,period_ms,rate_hz,ticks,missed,overruns,ring_drops,frame_drops,result\r\n";
+static const sample_ring_t *bench_rings;
+
+static TaskHandle_t bench_task_handle;
+static StaticTask_t bench_task_tcb;
+static StackType_t bench_task_stack[THROUGHPUT_BENCH_STACK_SIZE];
+
+/* Private function prototypes -----------------------------------------------*/
+static void throughput_bench_task(void *argument);
+static void throughput_bench_count(throughput_counts_t *counts);
+
+// Function to create the benchmark task
+void throughput_bench_start(const sample_ring_t *rings) {
+    bench_rings = rings;
+    bench_task_handle = xTaskCreateStatic(throughput_bench_task, "ThroughputBench", THROUGHPUT_BENCH_STACK_SIZE,
+                                          NULL, THROUGHPUT_BENCH_PRIORITY, bench_task_stack, &bench_task_tcb);
+#if STACK_PROFILE
+    stack_profile_track(bench_task_handle, THROUGHPUT_BENCH_STACK_SIZE);
+#endif
+}
+
+// Function to read the counters a step is judged by
+static void throughput_bench_count(throughput_counts_t *counts) {
+    counts->ticks = sample_timer_tick_count();
+    counts->missed = deadline_monitor_missed();
+    counts->overruns = deadline_monitor_overruns();
+    counts->ring_drops = 0;
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        counts->ring_drops += bench_rings[channel].dropped;
+    }
+    counts->frame_drops = uart_tx_dropped();
+}
+
+// Function to ramp the sampling rate of every window size and report the steps
+static void throughput_bench_task(void *argument) {
+    char line[UART_TX_FRAME_MAX];
+    uint32_t window_size = pipeline_config.window_size;
+    uint32_t period_ms = pipeline_config.sample_period_ms;
+
+    (void)argument;
+    uart_tx_send_blocking((const uint8_t *)report_header, sizeof(report_header) - 1);
+
+    for (uint32_t size = 0; size < sizeof(bench_window_sizes) / sizeof(bench_window_sizes[0]); ++size) {
+        uint32_t window = bench_window_sizes[size];
+        uint32_t sustained_ms = 0;
+
+        if (!pipeline_config_set_window_size(window)) {
+            // Does not fit the rings next to the configured batch
+            continue;
+        }
+        for (uint32_t step = 0; step < sizeof(bench_periods_ms) / sizeof(bench_periods_ms[0]); ++step) {
+            uint32_t period = bench_periods_ms[step];
+            throughput_counts_t before, after;
+
+            pipeline_config_set_sample_period(period);
+            // Also lets the backlog of the previous step drain before it counts
+            vTaskDelay(pdMS_TO_TICKS(THROUGHPUT_BENCH_SETTLE_MS));
+            throughput_bench_count(&before);
+            vTaskDelay(pdMS_TO_TICKS(THROUGHPUT_BENCH_DWELL_MS));
+            throughput_bench_count(&after);
+
+            uint32_t missed = after.missed - before.missed;
+            uint32_t overruns = after.overruns - before.overruns;
+            uint32_t ring_drops = after.ring_drops - before.ring_drops;
+            uint32_t frame_drops = after.frame_drops - before.frame_drops;
+            bool passed = missed == 0 && overruns == 0 && ring_drops == 0 && frame_drops == 0;
+
+            snprintf(line, sizeof(line), "%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%s\r\n",
+                     (unsigned long)window, (unsigned long)period, (unsigned long)(1000U / period),
+                     (unsigned long)(after.ticks - before.ticks), (unsigned long)missed,
+                     (unsigned long)overruns, (unsigned long)ring_drops, (unsigned long)frame_drops,
+                     passed ? "ok" : "fail");
+            uart_tx_send_blocking((const uint8_t *)line, (uint16_t)strlen(line));
+            if (!passed) {
+                break;
+            }
+            sustained_ms = period;
+        }
+
+        snprintf(line, sizeof(line), "max,%lu,%lu,%lu\r\n", (unsigned long)window,
+                 (unsigned long)sustained_ms, (unsigned long)(sustained_ms != 0 ? 1000U / sustained_ms : 0U));
+        uart_tx_send_blocking((const uint8_t *)line, (uint16_t)strlen(line));
+    }
+
+    // Back to the settings the firmware started with
+    pipeline_config_set_sample_period(period_ms);
+    pipeline_config_set_window_size(window_size);
+    vTaskDelete(NULL);
+}
@@ -0,0 +1,100 @@
+/**
+  ******************************************************************************
+  * @file    time_base.c
+  * @brief   Microsecond time base on the 32-bit TIM2 counter, epoch mapping.
+  *
+  *          TIM2 counts at 1 MHz from its prescaler and never stops, so a
+  *          stamp is one read of TIM2->CNT and costs the same in an ISR as in
+  *          a task. The update interrupt counts the wraps. A reader that
+  *          finds the update flag set before the interrupt ran adds the
+  *          pending wrap itself, and the wrap count is read twice around the
+  *          counter, so the 64-bit time is consistent at any priority.
+  *
+  *          The host sets the epoch mapping with "epoch <s> [<us>]" on the
+  *          command channel. The line is stamped in the receive interrupt,
+  *          so the mapping only carries the idle-line delay on top of the
+  *          link latency. The run-time stats of TASK_TELEMETRY read the same
+  *          counter.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "time_base.h"
+#include "cmsis_os.h"
+#include "critical_section.h"
+
+/* External variables --------------------------------------------------------*/
+extern TIM_HandleTypeDef htim2;
+
+/* Private variables ---------------------------------------------------------*/
+static volatile uint32_t time_base_wraps;
+// Epoch minus local time, valid once synced
+static int64_t time_base_offset;
+static volatile bool time_base_synced;
+
+// Function to start the counter and its wrap interrupt
+void time_base_start(void) {
+    time_base_wraps = 0;
+    time_base_synced = false;
+    if (HAL_TIM_Base_Start_IT(&htim2) != HAL_OK) {
+        Error_Handler();
+    }
+}
+
+// Function to read the 64-bit time
+uint64_t time_base_now(void) {
+    uint32_t wraps, count;
+
+    do {
+        wraps = time_base_wraps;
+        count = TIM2->CNT;
+        // The update interrupt is pending but could not run yet, the count already wrapped
+        if (__HAL_TIM_GET_FLAG(&htim2, TIM_FLAG_UPDATE) && count < 0x80000000U) {
+            wraps++;
+            break;
+        }
+    } while (wraps != time_base_wraps);
+    return ((uint64_t)wraps << 32) | count;
+}
+
+// Function to extend a stamp with the wraps at the time it was taken
+uint64_t time_base_extend(uint32_t stamp) {
+    uint64_t now = time_base_now();
+    uint32_t wraps = (uint32_t)(now >> 32);
+
+    if (stamp > (uint32_t)now) {
+        // Taken before the last wrap
+        wraps--;
+    }
+    return ((uint64_t)wraps << 32) | stamp;
+}
+
+// Function to set the epoch of the local clock
+void time_base_sync(uint32_t epoch_s, uint32_t epoch_us, uint32_t stamp) {
+    int64_t offset = (int64_t)((uint64_t)epoch_s * TIME_BASE_HZ + epoch_us) - (int64_t)time_base_extend(stamp);
+
+    // Offset is two words, readers must not see half of it
+    uint32_t state = critical_section_enter();
+    time_base_offset = offset;
+    time_base_synced = true;
+    critical_section_exit(state);
+}
+
+// Function to convert a local time to epoch microseconds
+bool time_base_to_epoch(uint64_t local_us, uint64_t *epoch_us) {
+    uint32_t state = critical_section_enter();
+    bool synced = time_base_synced;
+    int64_t offset = time_base_offset;
+    critical_section_exit(state);
+
+    if (!synced) {
+        return false;
+    }
+    *epoch_us = (uint64_t)((int64_t)local_us + offset);
+    return true;
+}
+
+// Function to count a wrap of the 32-bit TIM2 counter
+void time_base_overflow_from_isr(void) {
+    time_base_wraps++;
+}
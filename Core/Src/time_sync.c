@@ -0,0 +1,251 @@
+/**
+  ******************************************************************************
+  * @file    time_sync.c
+  * @brief   Four-timestamp clock synchronization with the gateway, drift and slew.
+  *
+  *          Every node stamps its samples on its own HSE, which drifts by
+  *          some 10 ppm, so the streams of a fleet part by a second a day.
+  *          The gateway opens an exchange with "sync <s> <us>", its time t1
+  *          as it sent the line. The node stamps the end of the line on
+  *          TIM2 (t2) in the receive interrupt and answers with a sync frame
+  *          sent at t3, whose arrival the gateway stamps (t4) and returns in
+  *          "delay <exchange> <s> <us>". The offset of the gateway clock is
+  *          then ((t1 - t2) + (t4 - t3)) / 2 at the middle of the exchange
+  *          and the round trip (t4 - t1) - (t3 - t2), the turnaround of the
+  *          node left out, as in PTP and NTP.
+  *
+  *          A frame that waited behind a burst of statistics or in the BLE
+  *          module comes back late, and only the symmetric part of a delay
+  *          cancels. The clock filter therefore keeps the last exchanges and
+  *          uses the one with the shortest round trip, the least queued, and
+  *          each one at most once. The first exchange, or an error above
+  *          TIME_SYNC_STEP_US, steps the clock. A smaller error is slewed out
+  *          at TIME_SYNC_SLEW_PPM, so the gateway time never runs backwards,
+  *          and the errors left after the slews estimate the drift of TIM2,
+  *          which the clock then follows between the exchanges.
+  *
+  *          Once synchronized the sampling ticks are stamped with the gateway
+  *          time in milliseconds since 2000, the time base of the RTC
+  *          calendar, so the samples of the fleet share one time line.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "time_sync.h"
+
+#if TIME_SYNC
+#include "cmsis_os.h"
+#include "critical_section.h"
+#include "sample_timer.h"
+#include "time_base.h"
+#include "uart_tx.h"
+
+#if !TIME_BASE
+#error "TIME_SYNC stamps the exchanges on the TIM2 time base, build it with TIME_BASE=1"
+#endif
+
+/* Private defines -----------------------------------------------------------*/
+// Microseconds from 1970-01-01 to 2000-01-01
+#define TIME_SYNC_2000_US 946684800000000LL
+// Shortest span the slew residuals are averaged over for a new drift
+#define TIME_SYNC_DRIFT_SPAN_US 16000000LL
+
+/* Private types -------------------------------------------------------------*/
+// One closed exchange
+typedef struct {
+    int64_t offset_us; // Gateway minus local time
+    uint64_t local_us; // Middle of the exchange on the local time
+    uint32_t delay_us; // Round trip
+} time_sync_sample_t;
+
+// Gateway minus local time as a function of the local time
+typedef struct {
+    uint64_t ref_us;       // Local time the terms count from
+    int64_t offset_us;     // At ref_us
+    int32_t drift_ppb;     // Added per local microsecond, in 1e-9 us
+    int32_t slew_us;       // Added in a ramp over slew_span_us from ref_us
+    uint32_t slew_span_us;
+} time_sync_clock_t;
+
+/* Private variables ---------------------------------------------------------*/
+// Written by the command task, read by the TIM3 interrupt, both in a critical section
+static time_sync_clock_t time_sync_clock;
+static bool time_sync_synced;
+// Command task only
+static time_sync_sample_t time_sync_filter[TIME_SYNC_FILTER];
+static uint32_t time_sync_samples;
+static uint64_t time_sync_used_us;
+static uint64_t time_sync_drift_from_us;
+static int64_t time_sync_drift_error_us;
+static bool time_sync_open;
+static uint16_t time_sync_exchange;
+static uint64_t time_sync_sent_us;     // t1, gateway
+static uint64_t time_sync_received_us; // t2, local
+static uint64_t time_sync_answered_us; // t3, local
+// Result of the last exchange used, for the frames
+static time_sync_state_t time_sync_state = TIME_SYNC_STATE_FREE;
+static uint8_t time_sync_used;
+static uint16_t time_sync_rejected;
+static int32_t time_sync_error_us;
+static uint32_t time_sync_delay_us;
+
+/* Private function prototypes -----------------------------------------------*/
+static int64_t time_sync_offset(const time_sync_clock_t *clock, uint64_t local_us, bool settled);
+static void time_sync_apply(const time_sync_sample_t *sample);
+
+// Function to evaluate the clock at a local time, with only the part of the
+// slew the ramp reached by then or with all of it
+static int64_t time_sync_offset(const time_sync_clock_t *clock, uint64_t local_us, bool settled) {
+    int64_t elapsed = (int64_t)(local_us - clock->ref_us);
+    int64_t offset = clock->offset_us + elapsed * clock->drift_ppb / 1000000000LL;
+
+    if (settled || elapsed >= (int64_t)clock->slew_span_us) {
+        offset += clock->slew_us;
+    } else if (elapsed > 0) {
+        offset += (int64_t)clock->slew_us * elapsed / (int64_t)clock->slew_span_us;
+    }
+    return offset;
+}
+
+// Function to stamp the request of the gateway and answer it
+void time_sync_request(uint64_t epoch_us, uint32_t stamp) {
+    time_sync_frame_t frame;
+
+    time_sync_sent_us = epoch_us;
+    time_sync_received_us = time_base_extend(stamp);
+    time_sync_exchange++;
+    time_sync_open = true;
+
+    frame.type = TIME_SYNC_FRAME_TYPE;
+    frame.version = TIME_SYNC_FRAME_VERSION;
+    frame.exchange = time_sync_exchange;
+    frame.state = (uint8_t)time_sync_state;
+    frame.used = time_sync_used;
+    frame.rejected = time_sync_rejected;
+    frame.error_us = time_sync_error_us;
+    frame.delay_us = time_sync_delay_us;
+    frame.drift_ppb = time_sync_clock.drift_ppb;
+    taskENTER_CRITICAL();
+    frame.sample_ms = sample_timer_now_from_isr();
+    taskEXIT_CRITICAL();
+
+    // The open burst goes first, the frame leaves once the bursts already
+    // queued are out, the filter rejects an exchange that waited for them
+    uart_tx_flush();
+    time_sync_answered_us = time_base_now();
+    uart_tx_send((const uint8_t *)&frame, sizeof(frame));
+    uart_tx_flush();
+}
+
+// Function to close the exchange and filter it
+bool time_sync_complete(uint32_t exchange, uint64_t epoch_us) {
+    time_sync_sample_t sample;
+
+    if (!time_sync_open || exchange != time_sync_exchange) {
+        return false;
+    }
+    time_sync_open = false;
+    int64_t outbound = (int64_t)(time_sync_received_us - time_sync_sent_us);
+    int64_t inbound = (int64_t)(epoch_us - time_sync_answered_us);
+    int64_t round_trip = (int64_t)(epoch_us - time_sync_sent_us) -
+                         (int64_t)(time_sync_answered_us - time_sync_received_us);
+    if (round_trip < 0) {
+        // The gateway clock stepped during the exchange
+        return false;
+    }
+    sample.offset_us = -(outbound - inbound) / 2;
+    sample.local_us = time_sync_received_us + (time_sync_answered_us - time_sync_received_us) / 2;
+    sample.delay_us = round_trip > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)round_trip;
+    time_sync_filter[time_sync_samples % TIME_SYNC_FILTER] = sample;
+    time_sync_samples++;
+
+    // The shortest round trip of the filter, used once and never after a newer one
+    uint32_t kept = time_sync_samples < TIME_SYNC_FILTER ? time_sync_samples : TIME_SYNC_FILTER;
+    const time_sync_sample_t *best = &time_sync_filter[0];
+    for (uint32_t index = 1; index < kept; ++index) {
+        if (time_sync_filter[index].delay_us < best->delay_us) {
+            best = &time_sync_filter[index];
+        }
+    }
+    if (time_sync_state != TIME_SYNC_STATE_FREE && best->local_us <= time_sync_used_us) {
+        if (time_sync_rejected < UINT16_MAX) {
+            time_sync_rejected++;
+        }
+        return true;
+    }
+    time_sync_apply(best);
+    return true;
+}
+
+// Function to step or slew the clock to an exchange and follow its drift
+static void time_sync_apply(const time_sync_sample_t *sample) {
+    time_sync_clock_t clock;
+
+    uint32_t state = critical_section_enter();
+    clock = time_sync_clock;
+    critical_section_exit(state);
+
+    int64_t error = sample->offset_us - time_sync_offset(&clock, sample->local_us, false);
+    if (time_sync_state == TIME_SYNC_STATE_FREE || error > TIME_SYNC_STEP_US || error < -TIME_SYNC_STEP_US) {
+        clock.ref_us = sample->local_us;
+        clock.offset_us = sample->offset_us;
+        clock.slew_us = 0;
+        clock.slew_span_us = 0;
+        time_sync_drift_from_us = sample->local_us;
+        time_sync_drift_error_us = 0;
+        time_sync_state = TIME_SYNC_STATE_STEPPED;
+    } else {
+        // What the whole slew of the last exchange did not remove is drift since then
+        time_sync_drift_error_us += sample->offset_us - time_sync_offset(&clock, sample->local_us, true);
+        int64_t span = (int64_t)(sample->local_us - time_sync_drift_from_us);
+        if (span >= TIME_SYNC_DRIFT_SPAN_US) {
+            // Half of the rate error a step, the noise of the exchanges averages out
+            int64_t drift = clock.drift_ppb + time_sync_drift_error_us * 1000000000LL / span / 2;
+            if (drift > TIME_SYNC_DRIFT_MAX_PPB) {
+                drift = TIME_SYNC_DRIFT_MAX_PPB;
+            } else if (drift < -TIME_SYNC_DRIFT_MAX_PPB) {
+                drift = -TIME_SYNC_DRIFT_MAX_PPB;
+            }
+            clock.drift_ppb = (int32_t)drift;
+            time_sync_drift_from_us = sample->local_us;
+            time_sync_drift_error_us = 0;
+        }
+        // The ramp starts where the clock stands, it never jumps
+        clock.offset_us = time_sync_offset(&clock, sample->local_us, false);
+        clock.ref_us = sample->local_us;
+        clock.slew_us = (int32_t)error;
+        clock.slew_span_us = (uint32_t)((error < 0 ? -error : error) * (1000000 / TIME_SYNC_SLEW_PPM));
+        time_sync_state = TIME_SYNC_STATE_SLEWING;
+    }
+
+    state = critical_section_enter();
+    time_sync_clock = clock;
+    time_sync_synced = true;
+    critical_section_exit(state);
+
+    time_sync_used_us = sample->local_us;
+    time_sync_error_us = (int32_t)error;
+    time_sync_delay_us = sample->delay_us;
+    if (time_sync_used < UINT8_MAX) {
+        time_sync_used++;
+    }
+}
+
+// Function to read the gateway time on the sample time base
+bool time_sync_now_ms(uint32_t *time_ms) {
+    time_sync_clock_t clock;
+    uint64_t local_us = time_base_now();
+
+    uint32_t state = critical_section_enter();
+    bool synced = time_sync_synced;
+    clock = time_sync_clock;
+    critical_section_exit(state);
+
+    if (!synced) {
+        return false;
+    }
+    int64_t since_2000 = (int64_t)local_us + time_sync_offset(&clock, local_us, false) - TIME_SYNC_2000_US;
+    *time_ms = (uint32_t)(since_2000 / 1000);
+    return true;
+}
+#endif /* TIME_SYNC */
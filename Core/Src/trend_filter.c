@@ -0,0 +1,83 @@
+/**
+  ******************************************************************************
+  * @file    trend_filter.c
+  * @brief   Recursive smoothing of each channel, a few words of state per channel.
+  *
+  *          A receiver that only wants the trend of a channel does not need
+  *          a window: a recursive filter updated on every stored sample
+  *          gives a smoothed value at any time from one to six words of
+  *          state, however long its time constant. The exponential moving
+  *          average is the cheapest, one multiply-add per sample. The
+  *          second order Butterworth section rolls off at 12 dB per octave
+  *          instead of 6, so it removes more noise for the same lag.
+  *
+  *          The biquad is the RBJ cookbook low pass with Q = 1/sqrt(2) in
+  *          direct form I. With STATS_USE_CMSIS_DSP it runs through
+  *          arm_biquad_cascade_df1_f32 one sample at a time.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "trend_filter.h"
+#include <math.h>
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+#define TREND_FILTER_PI 3.14159265358979f
+#define TREND_FILTER_EMA_ALPHA (1.0f / STATS_TREND_EMA_SAMPLES)
+
+// Function to design the filter and clear the state
+void trend_filter_init(trend_filter_t *filter) {
+    memset(filter, 0, sizeof(*filter));
+#if STATS_TREND_FILTER == STATS_TREND_BIQUAD
+    float omega = 2.0f * TREND_FILTER_PI * STATS_TREND_CUTOFF;
+    float cos_omega = cosf(omega);
+    float alpha = sinf(omega) / (2.0f * 0.70710678f);
+    float a0 = 1.0f + alpha;
+
+    filter->coeffs[0] = (1.0f - cos_omega) / 2.0f / a0;
+    filter->coeffs[1] = (1.0f - cos_omega) / a0;
+    filter->coeffs[2] = filter->coeffs[0];
+    filter->coeffs[3] = 2.0f * cos_omega / a0;
+    filter->coeffs[4] = -(1.0f - alpha) / a0;
+#if STATS_USE_CMSIS_DSP
+    arm_biquad_cascade_df1_init_f32(&filter->instance, 1, filter->coeffs, filter->state);
+#endif
+#endif
+}
+
+// Function to filter one sample
+float trend_filter_add(trend_filter_t *filter, float value) {
+    float out;
+
+#if STATS_TREND_FILTER == STATS_TREND_BIQUAD
+#if STATS_USE_CMSIS_DSP
+    if (!filter->primed) {
+        for (uint32_t n = 0; n < 4; ++n) {
+            filter->state[n] = value;
+        }
+        filter->primed = true;
+    }
+    arm_biquad_cascade_df1_f32(&filter->instance, &value, &out, 1);
+#else
+    if (!filter->primed) {
+        filter->x1 = filter->x2 = filter->y1 = filter->y2 = value;
+        filter->primed = true;
+    }
+    const float *c = filter->coeffs;
+    out = c[0] * value + c[1] * filter->x1 + c[2] * filter->x2 + c[3] * filter->y1 + c[4] * filter->y2;
+    filter->x2 = filter->x1;
+    filter->x1 = value;
+    filter->y2 = filter->y1;
+    filter->y1 = out;
+#endif
+#else
+    if (!filter->primed) {
+        filter->value = value;
+        filter->primed = true;
+    }
+    out = filter->value + TREND_FILTER_EMA_ALPHA * (value - filter->value);
+#endif
+    filter->value = out;
+    return out;
+}
@@ -0,0 +1,139 @@
+/**
+  ******************************************************************************
+  * @file    trigger_engine.c
+  * @brief   Per-sample alarm rules that send an alert frame at once.
+  *
+  *          The statistics describe a whole report interval and leave with
+  *          the batch, up to half a minute after the read that mattered. The
+  *          rules are checked in the producer on every read instead, right
+  *          after the outlier filter, and a rule that changes state goes out
+  *          as a 12-byte alert frame before the producer waits for the next
+  *          tick. The alert is in the transmit queue a few microseconds after
+  *          the read, the batch cadence stays as it is.
+  *
+  *          Alerts are sent on the edges of a condition only, raised and
+  *          cleared, so a lasting alarm costs two frames. When the queue is
+  *          full the edge waits in a pending slot of its rule and goes out at
+  *          a later tick. A newer edge of the same rule replaces it, so the
+  *          alert that goes out always has the current state of the rule.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "trigger_engine.h"
+#include "main.h"
+#include "stats_frame.h"
+#include "uart_tx.h"
+#include <math.h>
+#include <stdbool.h>
+
+/* Exported variables --------------------------------------------------------*/
+const trigger_rule_t trigger_rules[] = {
+    // Motion starts and ends halfway between the 0 and 1 of the PIR samples
+    { SENSOR_PIR, TRIGGER_ABOVE, TRIGGER_PIR_ABOVE, 0.25f },
+    { SENSOR_HUMIDITY_AND_HEAT, TRIGGER_ABOVE, TRIGGER_HUMIDITY_AND_HEAT_ABOVE, TRIGGER_HUMIDITY_AND_HEAT_HYSTERESIS },
+    { SENSOR_LDR, TRIGGER_RATE, TRIGGER_LDR_RATE, TRIGGER_LDR_RATE_HYSTERESIS },
+};
+const uint32_t trigger_rule_count = sizeof(trigger_rules) / sizeof(trigger_rules[0]);
+
+/* Private defines -----------------------------------------------------------*/
+// One bit per rule in the state words
+#define TRIGGER_RULES_MAX 32U
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    float value;
+    uint32_t timestamp;
+    bool primed;
+} trigger_last_read_t;
+
+// Edge waiting for room in the transmit queue
+typedef struct {
+    uint32_t timestamp;
+    float value;
+} trigger_pending_t;
+
+/* Private variables ---------------------------------------------------------*/
+// Producer task only
+static trigger_last_read_t trigger_last[SENSOR_COUNT];
+static trigger_pending_t trigger_pending[TRIGGER_RULES_MAX];
+static uint32_t trigger_raised_mask;
+static uint32_t trigger_pending_mask;
+static uint8_t trigger_sequence;
+
+// Function to clear the rule states
+void trigger_engine_init(void) {
+    if (trigger_rule_count > TRIGGER_RULES_MAX) {
+        Error_Handler();
+    }
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        trigger_last[channel].primed = false;
+    }
+    trigger_raised_mask = 0;
+    trigger_pending_mask = 0;
+    trigger_sequence = 0;
+}
+
+// Function to tell whether a rule holds, given whether it held before
+static bool trigger_rule_holds(const trigger_rule_t *rule, bool raised, float value, float rate) {
+    switch (rule->kind) {
+    case TRIGGER_ABOVE:
+        return raised ? value > rule->threshold - rule->hysteresis : value > rule->threshold;
+    case TRIGGER_BELOW:
+        return raised ? value < rule->threshold + rule->hysteresis : value < rule->threshold;
+    default:
+        return raised ? fabsf(rate) > rule->threshold - rule->hysteresis : fabsf(rate) > rule->threshold;
+    }
+}
+
+// Function to check a read against the rules of its channel
+void trigger_engine_sample(sensor_t channel, float value, uint32_t timestamp) {
+    trigger_last_read_t *last = &trigger_last[channel];
+    float rate = 0.0f;
+
+    // Change per second since the previous read, 0 for the first one
+    if (last->primed && timestamp != last->timestamp) {
+        rate = (value - last->value) * 1000.0f / (float)(timestamp - last->timestamp);
+    }
+    last->value = value;
+    last->timestamp = timestamp;
+    last->primed = true;
+
+    for (uint32_t i = 0; i < trigger_rule_count; ++i) {
+        const trigger_rule_t *rule = &trigger_rules[i];
+        if (rule->channel != channel) {
+            continue;
+        }
+        uint32_t bit = 1UL << i;
+        bool raised = (trigger_raised_mask & bit) != 0;
+        if (trigger_rule_holds(rule, raised, value, rate) == raised) {
+            continue;
+        }
+        trigger_raised_mask ^= bit;
+        trigger_pending_mask |= bit;
+        trigger_pending[i].timestamp = timestamp;
+        trigger_pending[i].value = value;
+    }
+}
+
+// Function to send the queued edges, lowest rule first
+void trigger_engine_flush(void) {
+    while (trigger_pending_mask != 0 && uart_tx_free() > 0) {
+        uint32_t i = (uint32_t)__builtin_ctz(trigger_pending_mask);
+        trigger_frame_t frame = {
+            .type = TRIGGER_FRAME_TYPE,
+            .version = TRIGGER_FRAME_VERSION,
+            .sequence = trigger_sequence,
+            .rule = (uint8_t)i,
+            .timestamp = trigger_pending[i].timestamp,
+            .channel = (uint8_t)trigger_rules[i].channel,
+            .raised = (trigger_raised_mask >> i) & 1U,
+            .value = stats_frame_quantize(trigger_rules[i].channel, trigger_pending[i].value),
+        };
+        if (!uart_tx_send((const uint8_t *)&frame, sizeof(frame))) {
+            break;
+        }
+        trigger_sequence++;
+        trigger_pending_mask &= ~(1UL << i);
+    }
+}
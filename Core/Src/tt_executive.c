@@ -0,0 +1,142 @@
+/**
+  ******************************************************************************
+  * @file    tt_executive.c
+  * @brief   Time-triggered executive, a static table of slots run at every tick.
+  *
+  *          ISR_PIPELINE runs the acquisition at every tick and the report
+  *          whenever a batch happens to complete, so how much work a tick
+  *          holds depends on the state of the pipeline. Here the work of the
+  *          ticks is laid out in advance instead: each tick opens a minor
+  *          frame, SAMPLES_PER_BATCH frames make the major cycle, and a
+  *          const table says which slot runs in which frame. The table is
+  *          checked before the timer starts, every frame of the cycle
+  *          against its share of the period, so a schedule that could run
+  *          late is refused at boot rather than found in the field.
+  *
+  *          At run time every slot is timed with the DWT cycle counter
+  *          against its own budget, and every frame against its share. An
+  *          overrun is counted and the slot is not cut short, its worst run
+  *          is kept so budgets can be set from measurements. A tick that
+  *          finds the previous frame still running is skipped by
+  *          isr_pipeline; the frame count follows the ticks, not the runs,
+  *          so every slot stays in the frame the table gives it.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "tt_executive.h"
+
+#if TT_EXECUTIVE
+#include "cycle_counter.h"
+#include "isr_pipeline.h"
+#include "main.h"
+
+/* Private defines -----------------------------------------------------------*/
+// Slots the counters have room for
+#define TT_EXECUTIVE_SLOTS_MAX 8
+
+/* Private variables ---------------------------------------------------------*/
+static const tt_slot_t *tt_slots;
+static uint32_t tt_slot_count;
+static uint32_t tt_major_frames;
+static uint32_t tt_cycles_per_us;
+static uint32_t tt_frame_cycles;
+// Deferred work only
+static uint32_t tt_frames_run;
+static uint32_t tt_frames_over;
+static uint32_t tt_slot_over[TT_EXECUTIVE_SLOTS_MAX];
+static uint32_t tt_slot_worst[TT_EXECUTIVE_SLOTS_MAX];
+
+// Function to find the first frame of the major cycle the schedule does not fit in
+uint32_t tt_executive_check(const tt_slot_t *slots, uint32_t count, uint32_t major_frames, uint32_t frame_us,
+                            uint32_t load_pct) {
+    uint64_t limit_us = (uint64_t)frame_us * load_pct / 100U;
+
+    if (major_frames == 0) {
+        return 0;
+    }
+    for (uint32_t slot = 0; slot < count; ++slot) {
+        // Periods that divide the cycle repeat it exactly, a slot outside of it fails in frame 0
+        if (slots[slot].run == NULL || slots[slot].period == 0 || slots[slot].offset >= slots[slot].period ||
+            major_frames % slots[slot].period != 0) {
+            return 0;
+        }
+    }
+    for (uint32_t frame = 0; frame < major_frames; ++frame) {
+        uint64_t used_us = 0;
+        for (uint32_t slot = 0; slot < count; ++slot) {
+            if (frame % slots[slot].period == slots[slot].offset) {
+                used_us += slots[slot].budget_us;
+            }
+        }
+        if (used_us > limit_us) {
+            return frame;
+        }
+    }
+    return major_frames;
+}
+
+// Function to take a schedule that passes the check
+bool tt_executive_init(const tt_slot_t *slots, uint32_t count, uint32_t major_frames, uint32_t frame_us) {
+    if (count == 0 || count > TT_EXECUTIVE_SLOTS_MAX ||
+        tt_executive_check(slots, count, major_frames, frame_us, TT_EXECUTIVE_LOAD_PCT) != major_frames) {
+        return false;
+    }
+    tt_slots = slots;
+    tt_slot_count = count;
+    tt_major_frames = major_frames;
+    // ISR_PIPELINE has no clock governor, the rate stays the one of the boot
+    tt_cycles_per_us = SystemCoreClock / 1000000U;
+    tt_frame_cycles = (uint32_t)((uint64_t)frame_us * TT_EXECUTIVE_LOAD_PCT / 100U * tt_cycles_per_us);
+    tt_frames_run = 0;
+    tt_frames_over = 0;
+    for (uint32_t slot = 0; slot < TT_EXECUTIVE_SLOTS_MAX; ++slot) {
+        tt_slot_over[slot] = 0;
+        tt_slot_worst[slot] = 0;
+    }
+    return true;
+}
+
+// Function to run the slots the table gives the frame of this tick
+bool tt_executive_frame_from_isr(uint32_t timestamp) {
+    // Ticks skipped by isr_pipeline were frames too
+    uint32_t frame = (tt_frames_run + isr_pipeline_overruns()) % tt_major_frames;
+    uint32_t frame_start = cycle_counter_now();
+
+    for (uint32_t slot = 0; slot < tt_slot_count; ++slot) {
+        const tt_slot_t *entry = &tt_slots[slot];
+        if (frame % entry->period != entry->offset) {
+            continue;
+        }
+        uint32_t start = cycle_counter_now();
+        entry->run(timestamp);
+        uint32_t cycles = cycle_counter_since(start);
+        if (cycles > tt_slot_worst[slot]) {
+            tt_slot_worst[slot] = cycles;
+        }
+        if (cycles > entry->budget_us * tt_cycles_per_us) {
+            tt_slot_over[slot]++;
+        }
+    }
+    if (cycle_counter_since(frame_start) > tt_frame_cycles) {
+        tt_frames_over++;
+    }
+    tt_frames_run++;
+    return false;
+}
+
+// Function to read the runs of a slot over its budget
+uint32_t tt_executive_slot_overruns(uint32_t slot) {
+    return slot < tt_slot_count ? tt_slot_over[slot] : 0;
+}
+
+// Function to read the frames over their share and the ticks skipped
+uint32_t tt_executive_frame_overruns(void) {
+    return tt_frames_over + isr_pipeline_overruns();
+}
+
+// Function to read the longest run of a slot
+uint32_t tt_executive_slot_worst_us(uint32_t slot) {
+    return slot < tt_slot_count ? tt_slot_worst[slot] / tt_cycles_per_us : 0;
+}
+#endif /* TT_EXECUTIVE */
@@ -0,0 +1,550 @@
+/**
+  ******************************************************************************
+  * @file    uart_tx.c
+  * @brief   Queued DMA transmit path for USART2, and USART1 with BULK_LINK.
+  *
+  *          Frames are copied into a small fixed queue of bursts and sent
+  *          with HAL_UART_Transmit_DMA. A burst collects frames until it is
+  *          full or UART_TX_FLUSH_MS after its first frame, so the BLE bridge
+  *          gets one MTU-sized write instead of one packet, with its own
+  *          connection event and header, per frame. The transmit complete
+  *          callback starts the next closed burst, so the sender only pays
+  *          for the copy and the line is kept busy back to back. When the
+  *          queue is full the newest frame is dropped: the statistics are
+  *          periodic, a fresh frame follows shortly and the consumer task
+  *          must never wait on the link.
+  *
+  *          With UART_FRAMING the frame is stored framed: a CRC-32 from the
+  *          hardware CRC unit is appended and the result COBS encoded and
+  *          terminated by 0x00. A receiver drops frames whose CRC fails and
+  *          picks up again at the next delimiter, also inside a burst.
+  *
+  *          uart_tx_reserve hands out a word-aligned place in the open burst
+  *          and uart_tx_commit queues what was written there, so a frame can
+  *          be serialized straight into the DMA buffer. With UART_FRAMING the
+  *          place is behind the worst-case stuffing of the frame, which
+  *          never overtakes its input, and COBS stuffs it in place.
+  *          uart_tx_send is the same with one copy into the reservation.
+  *          Frames of any length up to UART_TX_FRAME_MAX share a burst, so
+  *          statistics, deltas, alerts and telemetry all go through the
+  *          same queue. A FreeRTOS message buffer in between would add a
+  *          copy out of it and a task to drain it, the bursts are drained
+  *          by the DMA itself.
+  *
+  *          With LL_FAST_PATH a burst is a memory address, a length and the
+  *          enable bit of DMA1 stream 6, and ends on the transfer complete
+  *          of the stream instead of the USART: the next burst can be
+  *          loaded while the last bytes are still shifted out.
+  *
+  *          With BULK_LINK every link has a port of its own: USART1 has its
+  *          own queue of larger bursts on DMA2 stream 7, its own flush timer
+  *          and its own drop count, so a dump that fills the wired link never
+  *          takes a burst from the statistics on BLE. The latency trace, the
+  *          energy profile and the watchdog follow the BLE port only, the
+  *          live data. LL_FAST_PATH applies to USART2, USART1 stays on the
+  *          HAL.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "uart_tx.h"
+#include "cmsis_os.h"
+#include "crash_capture.h"
+#include "critical_section.h"
+#include "cycle_counter.h"
+#include "energy_profile.h"
+#include "latency_trace.h"
+#include "ram_func.h"
+#include "timers.h"
+#include "watchdog.h"
+#include <string.h>
+#if LL_FAST_PATH
+#include "stm32f4xx_ll_dma.h"
+#include "stm32f4xx_ll_usart.h"
+#endif
+#if UART_FRAMING
+#include "cobs.h"
+#include "crc_unit.h"
+#include "wire_format.h"
+#endif
+
+#if (UART_TX_QUEUE_LENGTH & (UART_TX_QUEUE_LENGTH - 1)) != 0
+#error "UART_TX_QUEUE_LENGTH must be a power of two"
+#endif
+
+#if UART_FRAMING
+#define UART_TX_CRC_SIZE 4U
+// Stuffed frame and CRC plus the delimiter
+#define UART_TX_ENCODED_MAX(size) (COBS_ENCODED_MAX((size) + UART_TX_CRC_SIZE) + 1U)
+#else
+#define UART_TX_ENCODED_MAX(size) (size)
+#endif
+
+// Reservations are word aligned so frames can be serialized in place
+#define UART_TX_ALIGN(offset) (((offset) + 3U) & ~3U)
+#if UART_FRAMING
+// The raw frame goes behind the room of its stuffing, COBS then runs in place
+#define UART_TX_FRAME_OFFSET(end, size) \
+    UART_TX_ALIGN((end) + UART_TX_ENCODED_MAX(size) - 1U - ((size) + UART_TX_CRC_SIZE))
+#define UART_TX_RESERVED_MAX(size) (UART_TX_ENCODED_MAX(size) + 3U)
+#else
+#define UART_TX_FRAME_OFFSET(end, size) UART_TX_ALIGN(end)
+#define UART_TX_RESERVED_MAX(size) ((size) + 3U)
+#endif
+
+#if UART_TX_BURST_MAX < UART_TX_RESERVED_MAX(UART_TX_FRAME_MAX)
+#error "UART_TX_BURST_MAX must hold the largest frame"
+#endif
+#if BULK_LINK
+#if (BULK_LINK_QUEUE_LENGTH & (BULK_LINK_QUEUE_LENGTH - 1)) != 0
+#error "BULK_LINK_QUEUE_LENGTH must be a power of two"
+#endif
+#if BULK_LINK_BURST_MAX < UART_TX_RESERVED_MAX(UART_TX_FRAME_MAX) || BULK_LINK_BURST_MAX > UINT16_MAX
+#error "BULK_LINK_BURST_MAX must hold the largest frame and fit a DMA transfer"
+#endif
+#endif
+
+// Burst storage of a port, every burst starts word aligned
+#define UART_TX_BURST_STRIDE(burst_max) UART_TX_ALIGN(burst_max)
+
+/* External variables --------------------------------------------------------*/
+extern UART_HandleTypeDef huart2;
+#if BULK_LINK
+extern UART_HandleTypeDef huart1;
+#endif
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    uint8_t *data;           // Word aligned, burst_max bytes of the port
+    uint16_t size;
+    bool traced;             // origin_cycles is valid
+    uint32_t queued_cycles;  // First frame queued, start of the transmit latency
+    uint32_t origin_cycles;  // Oldest traced frame, start of the end-to-end latency
+} uart_tx_burst_t;
+
+// Queue of one USART
+typedef struct {
+    UART_HandleTypeDef *huart;
+    uart_tx_burst_t *queue;
+    uint32_t queue_length;   // A power of two
+    uint16_t burst_max;
+    // Free running indices of the closed bursts, head is written by the senders,
+    // tail by the ISR. The open burst, if any, is the slot at head.
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    bool open;
+    // True while the DMA owns the burst at tail
+    volatile bool busy;
+    volatile uint32_t drop_count;
+#if UART_TX_FLUSH_MS > 0
+    // One-shot timer that closes the open burst at its deadline
+    TimerHandle_t flush_timer;
+    StaticTimer_t flush_timer_storage;
+#endif
+} uart_tx_port_t;
+
+/* Private variables ---------------------------------------------------------*/
+static uint8_t uart_tx_ble_data[UART_TX_QUEUE_LENGTH][UART_TX_BURST_STRIDE(UART_TX_BURST_MAX)]
+    __attribute__((aligned(4)));
+static uart_tx_burst_t uart_tx_ble_queue[UART_TX_QUEUE_LENGTH];
+#if BULK_LINK
+static uint8_t uart_tx_bulk_data[BULK_LINK_QUEUE_LENGTH][UART_TX_BURST_STRIDE(BULK_LINK_BURST_MAX)]
+    __attribute__((aligned(4)));
+static uart_tx_burst_t uart_tx_bulk_queue[BULK_LINK_QUEUE_LENGTH];
+#endif
+static uart_tx_port_t uart_tx_ports[UART_LINK_COUNT];
+// Reservation of uart_tx_reserve, valid until the commit. The critical
+// section held in between allows one reservation at a time, whatever the port.
+static uart_tx_port_t *uart_tx_reserved_port;
+static uint8_t *uart_tx_reserved_frame;
+static uint16_t uart_tx_reserved_max;
+static bool uart_tx_reserved_opened;
+static uint32_t uart_tx_reserved_mask;
+
+// The port of the live data, the one latency, energy and watchdog follow
+#define UART_TX_BLE (&uart_tx_ports[UART_LINK_BLE])
+
+/* Private function prototypes -----------------------------------------------*/
+static void uart_tx_port_init(uart_tx_port_t *port, UART_HandleTypeDef *huart, uart_tx_burst_t *queue,
+                              uint8_t *data, uint32_t queue_length, uint16_t burst_max, const char *name);
+static uint8_t *uart_tx_port_reserve(uart_tx_port_t *port, uint16_t max_size);
+static bool uart_tx_enqueue(uart_tx_port_t *port, const uint8_t *data, uint16_t size, bool traced,
+                            uint32_t origin_cycles);
+static void uart_tx_commit_frame(uint16_t size, bool traced, uint32_t origin_cycles);
+static void uart_tx_close_burst(uart_tx_port_t *port);
+static void uart_tx_port_flush(uart_tx_port_t *port);
+static uint32_t uart_tx_port_free(const uart_tx_port_t *port);
+static void uart_tx_start_next(uart_tx_port_t *port);
+static bool uart_tx_dma_start(uart_tx_port_t *port, uint8_t *data, uint16_t size);
+static void uart_tx_burst_done(uart_tx_port_t *port, bool sent);
+#if UART_TX_FLUSH_MS > 0
+static void uart_tx_flush_expired(TimerHandle_t timer);
+#endif
+
+// Function to reset the burst queues and create the flush timers
+void uart_tx_init(void) {
+    uart_tx_port_init(UART_TX_BLE, &huart2, uart_tx_ble_queue, &uart_tx_ble_data[0][0], UART_TX_QUEUE_LENGTH,
+                      UART_TX_BURST_MAX, "UartFlush");
+#if BULK_LINK
+    uart_tx_port_init(&uart_tx_ports[UART_LINK_BULK], &huart1, uart_tx_bulk_queue, &uart_tx_bulk_data[0][0],
+                      BULK_LINK_QUEUE_LENGTH, BULK_LINK_BURST_MAX, "BulkFlush");
+#endif
+#if LL_FAST_PATH
+    // The MSP set up the stream, it only lacks the data register and its interrupts
+    LL_DMA_SetPeriphAddress(DMA1, LL_DMA_STREAM_6, LL_USART_DMA_GetRegAddr(USART2));
+    LL_DMA_EnableIT_TC(DMA1, LL_DMA_STREAM_6);
+    LL_DMA_EnableIT_TE(DMA1, LL_DMA_STREAM_6);
+    LL_USART_EnableDMAReq_TX(USART2);
+#endif
+}
+
+// Function to reset the queue of one port and create its flush timer
+static void uart_tx_port_init(uart_tx_port_t *port, UART_HandleTypeDef *huart, uart_tx_burst_t *queue,
+                              uint8_t *data, uint32_t queue_length, uint16_t burst_max, const char *name) {
+    port->huart = huart;
+    port->queue = queue;
+    port->queue_length = queue_length;
+    port->burst_max = burst_max;
+    for (uint32_t slot = 0; slot < queue_length; ++slot) {
+        queue[slot].data = &data[slot * UART_TX_BURST_STRIDE(burst_max)];
+    }
+    port->head = 0;
+    port->tail = 0;
+    port->open = false;
+    port->busy = false;
+    port->drop_count = 0;
+#if UART_TX_FLUSH_MS > 0
+    port->flush_timer = xTimerCreateStatic(name, pdMS_TO_TICKS(UART_TX_FLUSH_MS), pdFALSE, port,
+                                           uart_tx_flush_expired, &port->flush_timer_storage);
+#else
+    (void)name;
+#endif
+}
+
+// Function to queue a frame without waiting for the line
+bool uart_tx_send(const uint8_t *data, uint16_t size) {
+    return uart_tx_enqueue(UART_TX_BLE, data, size, false, 0);
+}
+
+// Function to queue a frame, waits for a free burst instead of dropping it
+bool uart_tx_send_blocking(const uint8_t *data, uint16_t size) {
+    while (uart_tx_free() == 0) {
+        vTaskDelay(1);
+    }
+    return uart_tx_send(data, size);
+}
+
+// Function to queue a frame on a given link
+bool uart_tx_link_send(uart_link_t link, const uint8_t *data, uint16_t size) {
+    return uart_tx_enqueue(&uart_tx_ports[link], data, size, false, 0);
+}
+
+// Function to queue a frame that carries the publish time of its newest sample
+bool uart_tx_send_traced(const uint8_t *data, uint16_t size, uint32_t origin_cycles) {
+    return uart_tx_enqueue(UART_TX_BLE, data, size, true, origin_cycles);
+}
+
+// Function to reserve room for a frame in the open burst of the BLE link
+uint8_t *uart_tx_reserve(uint16_t max_size) {
+    return uart_tx_port_reserve(UART_TX_BLE, max_size);
+}
+
+// Function to reserve room for a frame in the open burst of a port, opening one if needed
+static uint8_t *uart_tx_port_reserve(uart_tx_port_t *port, uint16_t max_size) {
+    bool opened = false;
+
+    if (max_size == 0 || max_size > UART_TX_FRAME_MAX) {
+        port->drop_count++;
+        return NULL;
+    }
+
+    // The USARTs and their DMA streams run at a priority masked by the critical
+    // section, it stays entered until uart_tx_commit. A BASEPRI section, the
+    // senders include the deferred interrupt of ISR_PIPELINE.
+    uint32_t mask = critical_section_enter();
+    uart_tx_burst_t *burst = &port->queue[port->head & (port->queue_length - 1U)];
+    if (port->open && burst->size + UART_TX_RESERVED_MAX(max_size) > port->burst_max) {
+        uart_tx_close_burst(port);
+        burst = &port->queue[port->head & (port->queue_length - 1U)];
+    }
+    if (!port->open) {
+        if (port->head - port->tail == port->queue_length) {
+            port->drop_count++;
+            critical_section_exit(mask);
+            return NULL;
+        }
+        burst->size = 0;
+        burst->traced = false;
+        burst->queued_cycles = cycle_counter_now();
+        port->open = true;
+        opened = true;
+    }
+    uart_tx_reserved_port = port;
+    uart_tx_reserved_mask = mask;
+    uart_tx_reserved_opened = opened;
+    uart_tx_reserved_max = max_size;
+    uart_tx_reserved_frame = &burst->data[UART_TX_FRAME_OFFSET(burst->size, max_size)];
+    return uart_tx_reserved_frame;
+}
+
+// Function to frame the reserved frame in place and leave the critical section
+static void uart_tx_commit_frame(uint16_t size, bool traced, uint32_t origin_cycles) {
+    uart_tx_port_t *port = uart_tx_reserved_port;
+    uart_tx_burst_t *burst = &port->queue[port->head & (port->queue_length - 1U)];
+    uint8_t *frame = uart_tx_reserved_frame;
+    bool opened = uart_tx_reserved_opened;
+
+    if (size > uart_tx_reserved_max) {
+        // Written past the reservation, the frame cannot be trusted
+        port->drop_count++;
+        size = 0;
+    }
+    if (size == 0) {
+        if (opened) {
+            // Nothing joined the burst this call opened, leave the slot free
+            port->open = false;
+        }
+        critical_section_exit(uart_tx_reserved_mask);
+        return;
+    }
+
+    if (traced && !burst->traced) {
+        burst->traced = true;
+        burst->origin_cycles = origin_cycles;
+    }
+#if UART_FRAMING
+    // The CRC unit is shared by every sender, the critical section serializes it.
+    // The frame sits far enough behind the output for COBS to stuff it in place.
+    uint32_t crc = crc_unit_calculate(frame, size);
+    wire_put_u32(&frame[size], crc);
+    burst->size += (uint16_t)cobs_encode(frame, size + UART_TX_CRC_SIZE, &burst->data[burst->size]);
+    burst->data[burst->size++] = 0;
+#else
+    // Only moves when the burst end was not word aligned
+    memmove(&burst->data[burst->size], frame, size);
+    burst->size += size;
+#endif
+#if UART_TX_FLUSH_MS > 0
+    // Close early when the largest frame would not fit anymore
+    if (burst->size + UART_TX_RESERVED_MAX(UART_TX_FRAME_MAX) > port->burst_max) {
+        uart_tx_close_burst(port);
+    }
+#else
+    uart_tx_close_burst(port);
+#endif
+    critical_section_exit(uart_tx_reserved_mask);
+
+#if UART_TX_FLUSH_MS > 0
+    // The deadline counts from the first frame of the burst
+    if (opened) {
+        xTimerReset(port->flush_timer, 0);
+    }
+#else
+    (void)opened;
+#endif
+}
+
+// Function to queue the reserved frame
+void uart_tx_commit(uint16_t size) {
+    uart_tx_commit_frame(size, false, 0);
+}
+
+// Function to queue the reserved frame with the publish time of its newest sample
+void uart_tx_commit_traced(uint16_t size, uint32_t origin_cycles) {
+    uart_tx_commit_frame(size, true, origin_cycles);
+}
+
+// Function to copy a frame into a reservation and queue it
+static bool uart_tx_enqueue(uart_tx_port_t *port, const uint8_t *data, uint16_t size, bool traced,
+                            uint32_t origin_cycles) {
+    uint8_t *frame = uart_tx_port_reserve(port, size);
+
+    if (frame == NULL) {
+        return false;
+    }
+    memcpy(frame, data, size);
+    uart_tx_commit_frame(size, traced, origin_cycles);
+    return true;
+}
+
+// Function to move the open burst to the transmit queue, caller masks the transmit interrupts
+static void uart_tx_close_burst(uart_tx_port_t *port) {
+    if (!port->open) {
+        return;
+    }
+    port->open = false;
+    port->head++;
+    if (!port->busy) {
+        uart_tx_start_next(port);
+    }
+}
+
+// Function to send the open burst of a port now instead of at its deadline
+static void uart_tx_port_flush(uart_tx_port_t *port) {
+    uint32_t mask = critical_section_enter();
+
+    uart_tx_close_burst(port);
+    critical_section_exit(mask);
+}
+
+// Function to send the open burst now instead of at its deadline
+void uart_tx_flush(void) {
+    uart_tx_port_flush(UART_TX_BLE);
+}
+
+// Function to send the open burst of a link now instead of at its deadline
+void uart_tx_link_flush(uart_link_t link) {
+    uart_tx_port_flush(&uart_tx_ports[link]);
+}
+
+#if UART_TX_FLUSH_MS > 0
+// Flush timer callback, runs in the timer service task
+static void uart_tx_flush_expired(TimerHandle_t timer) {
+    uart_tx_port_flush((uart_tx_port_t *)pvTimerGetTimerID(timer));
+}
+#endif
+
+// Function to read the number of bursts of a port that can still be opened
+static uint32_t uart_tx_port_free(const uart_tx_port_t *port) {
+    return port->queue_length - (port->head - port->tail) - (port->open ? 1U : 0U);
+}
+
+// Function to read the number of bursts that can still be opened
+uint32_t uart_tx_free(void) {
+    return uart_tx_port_free(UART_TX_BLE);
+}
+
+// Function to read the number of bursts of a link that can still be opened
+uint32_t uart_tx_link_free(uart_link_t link) {
+    return uart_tx_port_free(&uart_tx_ports[link]);
+}
+
+// Function to read the number of dropped frames
+uint32_t uart_tx_dropped(void) {
+    return UART_TX_BLE->drop_count;
+}
+
+// Function to read the number of dropped frames of a link
+uint32_t uart_tx_link_dropped(uart_link_t link) {
+    return uart_tx_ports[link].drop_count;
+}
+
+// Function to hand the oldest closed burst to the DMA, caller masks the transmit interrupts
+RAMFUNC static void uart_tx_start_next(uart_tx_port_t *port) {
+    bool live = port == UART_TX_BLE;
+
+    while (port->tail != port->head) {
+        uart_tx_burst_t *burst = &port->queue[port->tail & (port->queue_length - 1U)];
+        if (uart_tx_dma_start(port, burst->data, burst->size)) {
+            port->busy = true;
+            if (!live) {
+                return;
+            }
+#if ENERGY_PROFILE
+            // High across back-to-back bursts, low once the queue drained
+            energy_profile_begin(ENERGY_STAGE_TRANSMIT);
+#endif
+#if CRASH_CAPTURE
+            crash_capture_trace(CRASH_EVENT_BURST, burst->size);
+#endif
+#if WATCHDOG
+            // A burst that never completes is a hung DMA or UART
+            watchdog_checkin(WATCHDOG_STAGE_TRANSMIT, WATCHDOG_TRANSMIT_BUDGET_MS);
+#endif
+            return;
+        }
+        // The UART refused the burst, drop it rather than retry forever
+        port->drop_count++;
+        port->tail++;
+    }
+    port->busy = false;
+    if (!live) {
+        return;
+    }
+#if ENERGY_PROFILE
+    energy_profile_end(ENERGY_STAGE_TRANSMIT);
+#endif
+#if WATCHDOG
+    watchdog_idle(WATCHDOG_STAGE_TRANSMIT);
+#endif
+}
+
+// Function to start the DMA on a burst, false when the UART refused it
+RAMFUNC static bool uart_tx_dma_start(uart_tx_port_t *port, uint8_t *data, uint16_t size) {
+#if LL_FAST_PATH
+    if (port != UART_TX_BLE) {
+        return HAL_UART_Transmit_DMA(port->huart, data, size) == HAL_OK;
+    }
+    if (LL_DMA_IsEnabledStream(DMA1, LL_DMA_STREAM_6)) {
+        return false;
+    }
+    LL_DMA_ClearFlag_TC6(DMA1);
+    LL_DMA_ClearFlag_HT6(DMA1);
+    LL_DMA_ClearFlag_TE6(DMA1);
+    LL_DMA_ClearFlag_DME6(DMA1);
+    LL_DMA_ClearFlag_FE6(DMA1);
+    LL_DMA_SetMemoryAddress(DMA1, LL_DMA_STREAM_6, (uint32_t)(uintptr_t)data);
+    LL_DMA_SetDataLength(DMA1, LL_DMA_STREAM_6, size);
+    LL_USART_ClearFlag_TC(USART2);
+    LL_DMA_EnableStream(DMA1, LL_DMA_STREAM_6);
+    return true;
+#else
+    return HAL_UART_Transmit_DMA(port->huart, data, size) == HAL_OK;
+#endif
+}
+
+// Function to release the burst the DMA just finished and chain the next one
+RAMFUNC static void uart_tx_burst_done(uart_tx_port_t *port, bool sent) {
+    const uart_tx_burst_t *burst = &port->queue[port->tail & (port->queue_length - 1U)];
+#if CRASH_CAPTURE
+    crash_capture_trace(CRASH_EVENT_BURST_DONE, sent ? 1U : 0U);
+#endif
+
+    if (sent && port == UART_TX_BLE) {
+        latency_trace_record(LATENCY_STAGE_TRANSMIT, burst->queued_cycles);
+        if (burst->traced) {
+            latency_trace_record(LATENCY_STAGE_END_TO_END, burst->origin_cycles);
+        }
+    }
+    port->tail++;
+    uart_tx_start_next(port);
+}
+
+// Transmit complete callback, the last byte has left the shift register
+RAMFUNC void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
+    for (uint32_t link = 0; link < UART_LINK_COUNT; ++link) {
+        if (huart->Instance == uart_tx_ports[link].huart->Instance) {
+            uart_tx_burst_done(&uart_tx_ports[link], true);
+        }
+    }
+}
+
+#if LL_FAST_PATH
+// Function to end the burst on the flags of DMA1 stream 6, the stream stopped itself
+RAMFUNC void uart_tx_dma_from_isr(void) {
+    if (LL_DMA_IsActiveFlag_TE6(DMA1)) {
+        LL_DMA_ClearFlag_TE6(DMA1);
+        LL_DMA_ClearFlag_TC6(DMA1);
+        if (UART_TX_BLE->busy) {
+            UART_TX_BLE->drop_count++;
+            uart_tx_burst_done(UART_TX_BLE, false);
+        }
+    } else if (LL_DMA_IsActiveFlag_TC6(DMA1)) {
+        LL_DMA_ClearFlag_TC6(DMA1);
+        if (UART_TX_BLE->busy) {
+            uart_tx_burst_done(UART_TX_BLE, true);
+        }
+    }
+}
+#endif
+
+// DMA or line error, the HAL already stopped the transfer if it was fatal
+void uart_tx_error_from_isr(UART_HandleTypeDef *huart) {
+    for (uint32_t link = 0; link < UART_LINK_COUNT; ++link) {
+        uart_tx_port_t *port = &uart_tx_ports[link];
+        if (huart->Instance == port->huart->Instance && port->busy && huart->gState == HAL_UART_STATE_READY) {
+            port->drop_count++;
+            uart_tx_burst_done(port, false);
+        }
+    }
+}
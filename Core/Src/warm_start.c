@@ -0,0 +1,150 @@
+/**
+  ******************************************************************************
+  * @file    warm_start.c
+  * @brief   Checkpoint of the statistics windows in backup SRAM, restored at boot.
+  *
+  *          The accumulators of the statistics are rebuilt from the window
+  *          samples, so only the samples are kept: the newest
+  *          WARM_START_SAMPLES of each channel with their timestamps, about
+  *          2.4 KB for three channels. The min/max deques, the median heaps
+  *          and the sums would take several KB per channel and follow from
+  *          the same samples.
+  *
+  *          A checkpoint is written in place. The magic word is cleared
+  *          first and set last, behind the CRC, so a reset in the middle of
+  *          a write leaves no valid checkpoint rather than a mixed one. The
+  *          backup regulator keeps the SRAM on VBAT while the main supply
+  *          is off, a reset alone keeps it anyway.
+  *
+  *          At boot the samples go back into the rings before the producer
+  *          runs, as if they had just been read. The consumer takes them as
+  *          its first batch, whatever the statistics mode, and reports the
+  *          restored window without waiting for a batch of new samples. The
+  *          time off is unknown, so the timestamps are moved to end 1 ms
+  *          before this boot.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "warm_start.h"
+#include "cmsis_os.h"
+#include "crc_unit.h"
+#include "cycle_counter.h"
+#include "main.h"
+#include <stddef.h>
+
+/* Private defines -----------------------------------------------------------*/
+#define WARM_START_MAGIC 0x5753544BU
+// Bumped whenever the layout of the checkpoint changes
+#define WARM_START_VERSION 1U
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    uint32_t magic;           // WARM_START_MAGIC once the checkpoint is complete
+    uint16_t version;         // WARM_START_VERSION
+    uint8_t sensor_count;     // SENSOR_COUNT of the build that wrote it
+    uint8_t value_size;       // sizeof(sample_value_t), 2 with STATS_FIXED_POINT
+    uint32_t newest_timestamp;
+    uint16_t count[SENSOR_COUNT];
+    uint32_t timestamps[SENSOR_COUNT][WARM_START_SAMPLES];
+    sample_value_t values[SENSOR_COUNT][WARM_START_SAMPLES];
+    uint32_t crc;             // crc_unit_calculate from version up to here
+} warm_start_image_t;
+
+_Static_assert(sizeof(warm_start_image_t) <= 4096U, "lower WARM_START_SAMPLES to fit the 4 KB backup SRAM");
+
+/* Private variables ---------------------------------------------------------*/
+static warm_start_image_t *const warm_start_image = (warm_start_image_t *)BKPSRAM_BASE;
+// Consumer task only
+static uint32_t warm_start_reports;
+
+/* Private function prototypes -----------------------------------------------*/
+static uint32_t warm_start_crc(void);
+
+// Function to run the checkpoint through the CRC unit, which the transmit path
+// shares from its critical section
+static uint32_t warm_start_crc(void) {
+    const uint8_t *from = (const uint8_t *)&warm_start_image->version;
+
+    taskENTER_CRITICAL();
+    uint32_t crc = crc_unit_calculate(from, offsetof(warm_start_image_t, crc) - offsetof(warm_start_image_t, version));
+    taskEXIT_CRITICAL();
+    return crc;
+}
+
+// Function to restore the rings from the checkpoint of the previous run
+uint32_t warm_start_restore(sample_ring_t rings[SENSOR_COUNT]) {
+    uint32_t restored = 0;
+
+    __HAL_RCC_PWR_CLK_ENABLE();
+    HAL_PWR_EnableBkUpAccess();
+    __HAL_RCC_BKPSRAM_CLK_ENABLE();
+    // Keeps the SRAM through a loss of the main supply, VBAT permitting
+    if (HAL_PWREx_EnableBkUpReg() != HAL_OK) {
+        return 0;
+    }
+    if (warm_start_image->magic != WARM_START_MAGIC || warm_start_image->version != WARM_START_VERSION ||
+        warm_start_image->sensor_count != SENSOR_COUNT || warm_start_image->value_size != sizeof(sample_value_t) ||
+        warm_start_image->crc != warm_start_crc()) {
+        return 0;
+    }
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        if (warm_start_image->count[channel] > WARM_START_SAMPLES) {
+            return 0;
+        }
+    }
+
+    uint32_t cycles = cycle_counter_now();
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        for (uint32_t index = 0; index < warm_start_image->count[channel]; ++index) {
+            sensor_data_t sample;
+            sample.timestamp = warm_start_image->timestamps[channel][index] - warm_start_image->newest_timestamp - 1U;
+            sample.acquired_cycles = cycles;
+            sample.value = warm_start_image->values[channel][index];
+            if (sample_ring_push(&rings[channel], &sample)) {
+                restored++;
+            }
+        }
+    }
+    return restored;
+}
+
+// Function to checkpoint the window of every channel
+void warm_start_save(const sample_ring_t rings[SENSOR_COUNT]) {
+    if (++warm_start_reports < WARM_START_PERIOD) {
+        return;
+    }
+    warm_start_reports = 0;
+
+    uint32_t newest = 0;
+    bool any_sample = false;
+    warm_start_image->magic = 0;
+    warm_start_image->version = WARM_START_VERSION;
+    warm_start_image->sensor_count = SENSOR_COUNT;
+    warm_start_image->value_size = sizeof(sample_value_t);
+    for (uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        const sample_ring_t *ring = &rings[channel];
+        uint32_t available = sample_ring_count(ring, SAMPLE_READER_STATS);
+        uint32_t count = available < WARM_START_SAMPLES ? available : WARM_START_SAMPLES;
+        uint32_t skip = available - count;
+
+        for (uint32_t index = 0; index < count; ++index) {
+            uint32_t offset = skip + index;
+            warm_start_image->timestamps[channel][index] = sample_ring_timestamp(ring, SAMPLE_READER_STATS, offset);
+            warm_start_image->values[channel][index] = sample_ring_value(ring, SAMPLE_READER_STATS, offset);
+        }
+        warm_start_image->count[channel] = (uint16_t)count;
+        if (count > 0) {
+            uint32_t timestamp = warm_start_image->timestamps[channel][count - 1];
+            if (!any_sample || (int32_t)(timestamp - newest) > 0) {
+                newest = timestamp;
+                any_sample = true;
+            }
+        }
+    }
+    warm_start_image->newest_timestamp = newest;
+    warm_start_image->crc = warm_start_crc();
+    // Last, a checkpoint is only valid once everything before it was written
+    __DSB();
+    warm_start_image->magic = WARM_START_MAGIC;
+}
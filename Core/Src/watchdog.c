@@ -0,0 +1,198 @@
+/**
+  ******************************************************************************
+  * @file    watchdog.c
+  * @brief   IWDG supervisor of the pipeline stages, reset cause in backup registers.
+  *
+  *          Refreshing the IWDG from any one task only proves that this task
+  *          runs. The supervisor runs above the pipeline and refreshes it
+  *          only while every stage checked in within its budget: the
+  *          producer every tick, the consumer between the batch signal and
+  *          the end of its reports, the USART2 DMA between the start and
+  *          the completion of a burst. A stage that waits for work is idle
+  *          and costs nothing. When a budget is missed the supervisor writes
+  *          the stage and the uptime to the RTC backup registers and resets
+  *          at once, so a hung peripheral costs one reboot instead of the
+  *          device. When the supervisor itself cannot run, in Error_Handler,
+  *          a HardFault or with the interrupts off, the IWDG expires and
+  *          resets the device after WATCHDOG_TIMEOUT_MS.
+  *
+  *          The backup registers keep their content over any reset as long
+  *          as VDD or VBAT is present. The cause is read and cleared at the
+  *          next boot and sent once as a reset cause frame.
+  *
+  *          The HAL IWDG driver is not part of this tree, the four IWDG
+  *          registers are written directly.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "watchdog.h"
+#include "main.h"
+#include "cmsis_os.h"
+#include "pipeline_config.h"
+#include "pipeline_priorities.h"
+#include "stack_profile.h"
+#include "uart_tx.h"
+#include <stdbool.h>
+
+/* Private defines -----------------------------------------------------------*/
+#ifndef WATCHDOG_STACK_SIZE
+#define WATCHDOG_STACK_SIZE configMINIMAL_STACK_SIZE
+#endif
+// Above the producer, a stuck stage cannot starve the check
+#define WATCHDOG_PRIORITY TASK_PRIORITY_SUPERVISE
+// IWDG key register values
+#define WATCHDOG_KEY_RELOAD 0xAAAAU
+#define WATCHDOG_KEY_ACCESS 0x5555U
+#define WATCHDOG_KEY_START 0xCCCCU
+// LSI / 64 is a 2 ms count at the nominal 32 kHz, 12 bits of reload
+#define WATCHDOG_PRESCALER IWDG_PR_PR_2
+#define WATCHDOG_RELOAD (WATCHDOG_TIMEOUT_MS / 2U - 1U)
+// BKP0R holds the magic, the cause and the stage, BKP1R the detail, BKP2R the count
+#define WATCHDOG_BACKUP_MAGIC 0x57440000U
+#define WATCHDOG_BACKUP_MAGIC_MASK 0xFFFF0000U
+
+/* Private types -------------------------------------------------------------*/
+typedef struct {
+    bool armed;
+    uint32_t since_ms;  // HAL_GetTick at the check in or arming
+    uint32_t budget_ms;
+} watchdog_stage_state_t;
+
+/* Private variables ---------------------------------------------------------*/
+// Written from the stages and read by the supervisor with the interrupts masked
+static watchdog_stage_state_t watchdog_stages[WATCHDOG_STAGE_COUNT];
+// Cause of the last reset, sent by the supervisor when it first runs
+static watchdog_frame_t watchdog_boot_frame;
+
+static TaskHandle_t watchdog_task_handle;
+static StaticTask_t watchdog_task_tcb;
+static StackType_t watchdog_task_stack[WATCHDOG_STACK_SIZE];
+
+/* Private function prototypes -----------------------------------------------*/
+static void watchdog_task(void *argument);
+
+// Function to read and clear the cause of the last reset
+void watchdog_init(void) {
+    uint32_t csr = RCC->CSR;
+
+    RCC->CSR |= RCC_CSR_RMVF;
+    __HAL_RCC_PWR_CLK_ENABLE();
+    HAL_PWR_EnableBkUpAccess();
+
+    uint32_t word = RTC->BKP0R;
+    if ((word & WATCHDOG_BACKUP_MAGIC_MASK) != WATCHDOG_BACKUP_MAGIC) {
+        // The backup domain lost its supply, nothing before this boot is known
+        word = WATCHDOG_BACKUP_MAGIC;
+        RTC->BKP2R = 0;
+    }
+    watchdog_cause_t cause = (watchdog_cause_t)((word >> 8) & 0xFFU);
+    if (cause == WATCHDOG_CAUSE_NONE && (csr & RCC_CSR_IWDGRSTF) != 0) {
+        cause = WATCHDOG_CAUSE_IWDG;
+        RTC->BKP2R++;
+    }
+
+    watchdog_boot_frame.type = WATCHDOG_FRAME_TYPE;
+    watchdog_boot_frame.version = WATCHDOG_FRAME_VERSION;
+    watchdog_boot_frame.cause = (uint8_t)cause;
+    watchdog_boot_frame.stage = (uint8_t)(word & 0xFFU);
+    watchdog_boot_frame.detail = cause == WATCHDOG_CAUSE_NONE ? 0 : RTC->BKP1R;
+    watchdog_boot_frame.reset_count = RTC->BKP2R;
+    watchdog_boot_frame.rcc_csr = csr;
+    RTC->BKP0R = WATCHDOG_BACKUP_MAGIC;
+
+    for (uint32_t stage = 0; stage < WATCHDOG_STAGE_COUNT; ++stage) {
+        watchdog_stages[stage].armed = false;
+    }
+}
+
+// Function to start the IWDG and the supervisor task
+void watchdog_start(void) {
+#ifdef DEBUG
+    // A breakpoint stops the count instead of resetting the target
+    __HAL_DBGMCU_FREEZE_IWDG();
+#endif
+    IWDG->KR = WATCHDOG_KEY_START;
+    IWDG->KR = WATCHDOG_KEY_ACCESS;
+    IWDG->PR = WATCHDOG_PRESCALER;
+    IWDG->RLR = WATCHDOG_RELOAD;
+    // The registers cross into the LSI domain within a few LSI cycles
+    while (IWDG->SR != 0) {}
+    IWDG->KR = WATCHDOG_KEY_RELOAD;
+
+    // The first tick is one sampling period away
+    watchdog_checkin(WATCHDOG_STAGE_ACQUIRE, 2U * pipeline_config.sample_period_ms + WATCHDOG_ACQUIRE_SLACK_MS);
+    watchdog_task_handle = xTaskCreateStatic(watchdog_task, "Watchdog", WATCHDOG_STACK_SIZE, NULL, WATCHDOG_PRIORITY,
+                                             watchdog_task_stack, &watchdog_task_tcb);
+#if STACK_PROFILE
+    stack_profile_track(watchdog_task_handle, WATCHDOG_STACK_SIZE);
+#endif
+}
+
+// Function to restart the budget of a periodic stage
+void watchdog_checkin(watchdog_stage_t stage, uint32_t budget_ms) {
+    watchdog_stage_state_t *state = &watchdog_stages[stage];
+    UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+
+    state->since_ms = HAL_GetTick();
+    state->budget_ms = budget_ms;
+    state->armed = true;
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+// Function to start the budget of a stage that got work, unless it runs already
+void watchdog_arm(watchdog_stage_t stage, uint32_t budget_ms) {
+    watchdog_stage_state_t *state = &watchdog_stages[stage];
+    UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+
+    if (!state->armed) {
+        state->since_ms = HAL_GetTick();
+        state->budget_ms = budget_ms;
+        state->armed = true;
+    }
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+// Function to stop supervising a stage until it has work again
+void watchdog_idle(watchdog_stage_t stage) {
+    watchdog_stages[stage].armed = false;
+}
+
+// Function to keep the first cause of this boot in the backup registers
+void watchdog_record(watchdog_cause_t cause, uint32_t stage, uint32_t detail) {
+    __HAL_RCC_PWR_CLK_ENABLE();
+    HAL_PWR_EnableBkUpAccess();
+    if ((RTC->BKP0R & WATCHDOG_BACKUP_MAGIC_MASK) != WATCHDOG_BACKUP_MAGIC) {
+        RTC->BKP2R = 0;
+    } else if (((RTC->BKP0R >> 8) & 0xFFU) != WATCHDOG_CAUSE_NONE) {
+        // A fault on the way down is a consequence, keep the first cause
+        return;
+    }
+    RTC->BKP1R = detail;
+    RTC->BKP2R++;
+    RTC->BKP0R = WATCHDOG_BACKUP_MAGIC | ((uint32_t)cause << 8) | (stage & 0xFFU);
+}
+
+// Supervisor task, refreshes the IWDG while every stage is within its budget
+static void watchdog_task(void *argument) {
+    (void)argument;
+
+    uart_tx_send((const uint8_t *)&watchdog_boot_frame, sizeof(watchdog_boot_frame));
+    // Kicks on a fixed schedule, the time of a check does not add up
+    TickType_t wake = xTaskGetTickCount();
+    while (1) {
+        for (uint32_t stage = 0; stage < WATCHDOG_STAGE_COUNT; ++stage) {
+            // Read the time with the state, a check in cannot land in between
+            taskENTER_CRITICAL();
+            watchdog_stage_state_t state = watchdog_stages[stage];
+            uint32_t now = HAL_GetTick();
+            taskEXIT_CRITICAL();
+            if (state.armed && now - state.since_ms > state.budget_ms) {
+                watchdog_record(WATCHDOG_CAUSE_STAGE, stage, now);
+                NVIC_SystemReset();
+            }
+        }
+        IWDG->KR = WATCHDOG_KEY_RELOAD;
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(WATCHDOG_KICK_MS));
+    }
+}
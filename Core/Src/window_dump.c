@@ -0,0 +1,184 @@
+/**
+  ******************************************************************************
+  * @file    window_dump.c
+  * @brief   Raw samples of one channel window, frozen at a report and streamed on request.
+  *
+  *          A statistic that looks wrong is only explained by the samples
+  *          behind it. The "dump" command asks for the window of a channel,
+  *          and the consumer copies it right after the next report, so the
+  *          copy is exactly the window those statistics came from, and the
+  *          ring goes on sliding. The copy is the stored sample codes and
+  *          timestamps, a few bytes per sample, never the ring itself.
+  *
+  *          The dump task sends the copy at the transmit priority: a frame
+  *          whenever more than one burst of the queue is free, so the live
+  *          frames always find room and the dump takes what they leave.
+  *          Sampling, statistics and reports keep running throughout.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "window_dump.h"
+
+#if WINDOW_DUMP
+#include "cmsis_os.h"
+#include "dma_copy.h"
+#include "link_route.h"
+#include "pipeline_priorities.h"
+#include "sensor_registry.h"
+#include "sensor_stats.h"
+#include "stack_profile.h"
+#include "task_signal.h"
+#include <stddef.h>
+
+/* Private defines -----------------------------------------------------------*/
+#ifndef WINDOW_DUMP_STACK_SIZE
+#define WINDOW_DUMP_STACK_SIZE 160
+#endif
+// Runs with what the live frames leave, like the other senders of old data
+#define WINDOW_DUMP_PRIORITY TASK_PRIORITY_TRANSMIT
+// No channel requested
+#define WINDOW_DUMP_IDLE UINT32_MAX
+
+/* Private variables ---------------------------------------------------------*/
+// Set by any task, taken by the consumer, WINDOW_DUMP_IDLE again once the dump was sent
+static volatile uint32_t window_dump_channel = WINDOW_DUMP_IDLE;
+static volatile bool window_dump_captured;
+// Written by the consumer before the signal, read by the dump task
+static uint32_t window_dump_timestamps[STATS_WINDOW_CAPACITY];
+static int16_t window_dump_codes[STATS_WINDOW_CAPACITY];
+static uint32_t window_dump_count;
+static uint32_t window_dump_report;
+
+static TaskHandle_t window_dump_task_handle;
+static StaticTask_t window_dump_task_tcb;
+static StackType_t window_dump_task_stack[WINDOW_DUMP_STACK_SIZE];
+
+/* Private function prototypes -----------------------------------------------*/
+static void window_dump_task(void *argument);
+static void window_dump_emit(const window_dump_frame_t *frame);
+
+// Function to create the dump task
+void window_dump_start(void) {
+    window_dump_task_handle = xTaskCreateStatic(window_dump_task, "Dump", WINDOW_DUMP_STACK_SIZE, NULL,
+                                                WINDOW_DUMP_PRIORITY, window_dump_task_stack,
+                                                &window_dump_task_tcb);
+#if STACK_PROFILE
+    stack_profile_track(window_dump_task_handle, WINDOW_DUMP_STACK_SIZE);
+#endif
+}
+
+// Function to ask for the window of a channel at the next report
+bool window_dump_request(uint32_t channel) {
+    bool accepted = false;
+
+    if (channel >= SENSOR_COUNT) {
+        return false;
+    }
+    taskENTER_CRITICAL();
+    if (window_dump_channel == WINDOW_DUMP_IDLE) {
+        window_dump_channel = channel;
+        accepted = true;
+    }
+    taskEXIT_CRITICAL();
+    return accepted;
+}
+
+// Function to copy the requested window and wake the dump task
+void window_dump_capture(const sample_ring_t rings[SENSOR_COUNT], uint32_t timestamp) {
+    uint32_t channel = window_dump_channel;
+
+    if (channel == WINDOW_DUMP_IDLE || window_dump_captured) {
+        return;
+    }
+    const sample_ring_t *ring = &rings[channel];
+    uint32_t count = sample_ring_count(ring, SAMPLE_READER_STATS);
+
+    // The window never holds more, the cap only keeps the copy in bounds
+    count = count < STATS_WINDOW_CAPACITY ? count : STATS_WINDOW_CAPACITY;
+#if DMA_COPY
+    // The timestamps are stored where the values are, the spans of one give those of the other
+    const sample_value_t *first, *second;
+    uint32_t first_count, second_count;
+    sample_ring_span(ring, SAMPLE_READER_STATS, 0, count, &first, &first_count, &second, &second_count);
+    const uint32_t *stamps = &ring->timestamps[first - ring->values];
+    dma_copy_submit(window_dump_timestamps, stamps, first_count * sizeof(uint32_t));
+    dma_copy_submit(&window_dump_timestamps[first_count], ring->timestamps, second_count * sizeof(uint32_t));
+#if STATS_FIXED_POINT
+    dma_copy_submit(window_dump_codes, first, first_count * sizeof(sample_value_t));
+    dma_copy_submit(&window_dump_codes[first_count], second, second_count * sizeof(sample_value_t));
+#else
+    // Converted while the timestamps are copied
+    for (uint32_t index = 0; index < count; ++index) {
+        window_dump_codes[index] = sensor_to_fixed((sensor_t)channel,
+                                                   sample_ring_value(ring, SAMPLE_READER_STATS, index));
+    }
+#endif
+    dma_copy_wait();
+#else
+    for (uint32_t index = 0; index < count; ++index) {
+        window_dump_timestamps[index] = sample_ring_timestamp(ring, SAMPLE_READER_STATS, index);
+#if STATS_FIXED_POINT
+        window_dump_codes[index] = sample_ring_value(ring, SAMPLE_READER_STATS, index);
+#else
+        window_dump_codes[index] = sensor_to_fixed((sensor_t)channel,
+                                                   sample_ring_value(ring, SAMPLE_READER_STATS, index));
+#endif
+    }
+#endif
+    window_dump_count = count;
+    window_dump_report = timestamp;
+    window_dump_captured = true;
+    task_signal_set(window_dump_task_handle, TASK_SIGNAL_WINDOW_DUMP);
+}
+
+// Function to send one frame, leaving a burst free for the live frames of the consumer
+static void window_dump_emit(const window_dump_frame_t *frame) {
+    while (link_route_free(LINK_TRAFFIC_DUMP) <= 1) {
+        vTaskDelay(1);
+    }
+    link_route_send(LINK_TRAFFIC_DUMP, (const uint8_t *)frame,
+                    (uint16_t)(offsetof(window_dump_frame_t, samples) + frame->count * sizeof(window_dump_sample_t)));
+}
+
+// Dump task, sends each captured window and takes the next request
+static void window_dump_task(void *argument) {
+    window_dump_frame_t frame;
+    uint16_t dump = 0;
+
+    (void)argument;
+    frame.type = WINDOW_DUMP_FRAME_TYPE;
+    frame.version = WINDOW_DUMP_FRAME_VERSION;
+    while (1) {
+        task_signal_wait(TASK_SIGNAL_WINDOW_DUMP, portMAX_DELAY);
+        frame.channel = (uint8_t)window_dump_channel;
+        frame.dump = dump++;
+
+        // A sample too far after the first of its frame for the offset starts the next one
+        for (uint32_t index = 0; index < window_dump_count; index += frame.count) {
+            frame.first = (uint16_t)index;
+            frame.timestamp = window_dump_timestamps[index];
+            frame.count = 0;
+            while (frame.count < WINDOW_DUMP_FRAME_SAMPLES && index + frame.count < window_dump_count) {
+                uint32_t after = window_dump_timestamps[index + frame.count] - frame.timestamp;
+                if (after > UINT16_MAX) {
+                    break;
+                }
+                frame.samples[frame.count].offset_ms = (uint16_t)after;
+                frame.samples[frame.count].code = window_dump_codes[index + frame.count];
+                frame.count++;
+            }
+            window_dump_emit(&frame);
+        }
+
+        frame.count = 0;
+        frame.first = (uint16_t)window_dump_count;
+        frame.timestamp = window_dump_report;
+        window_dump_emit(&frame);
+        link_route_flush(LINK_TRAFFIC_DUMP);
+
+        window_dump_captured = false;
+        window_dump_channel = WINDOW_DUMP_IDLE;
+    }
+}
+#endif /* WINDOW_DUMP */
@@ -59,9 +59,25 @@ defined in linker script */
   .type  Reset_Handler, %function
 Reset_Handler:  
   ldr   sp, =_estack     /* set stack pointer */
+
+#if BOOT_PROFILE
+/* Start the cycle counter, every boot step is timed from here, see boot_profile.c */
+  bl  boot_profile_reset
+#endif
+#if FAST_START
+/* Turn the crystal on, it settles while the memory is set up and SystemClock_Config waits less */
+  ldr r0, =0x40023800  /* RCC_CR */
+  ldr r1, [r0]
+  orr r1, r1, #0x00010000  /* RCC_CR_HSEON */
+  str r1, [r0]
+#endif
   
 /* Call the clock system initialization function.*/
   bl  SystemInit  
+#if BOOT_PROFILE
+  movs r0, #1  /* BOOT_MARK_SYSTEM_INIT */
+  bl  boot_profile_mark
+#endif
 
 /* Copy the data segment initializers from flash to SRAM */  
   ldr r0, =_sdata
@@ -80,6 +96,23 @@ LoopCopyDataInit:
   cmp r4, r1
   bcc CopyDataInit
   
+/* Copy the ccmram segment initializers from flash to CCM RAM */
+  ldr r0, =_sccmram
+  ldr r1, =_eccmram
+  ldr r2, =_siccmram
+  movs r3, #0
+  b LoopCopyCcmramInit
+
+CopyCcmramInit:
+  ldr r4, [r2, r3]
+  str r4, [r0, r3]
+  adds r3, r3, #4
+
+LoopCopyCcmramInit:
+  adds r4, r0, r3
+  cmp r4, r1
+  bcc CopyCcmramInit
+
 /* Zero fill the bss segment. */
   ldr r2, =_sbss
   ldr r4, =_ebss
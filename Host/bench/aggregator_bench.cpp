@@ -0,0 +1,237 @@
+/**
+  ******************************************************************************
+  * @file    aggregator_bench.cpp
+  * @brief   Host benchmark of the gateway aggregator over hundreds of synthetic nodes.
+  *
+  *          Each case builds the links of a site the way TIME_SYNC nodes
+  *          send them: a sync frame, then a report a second from
+  *          stats_delta_encode and, after the first report of every minute,
+  *          the minute summary of each channel from rollup_summary_add. The
+  *          nodes report at their own offset within the second, so the
+  *          streams interleave on the shared time line. The links are fed
+  *          round robin in 244-byte pieces, one BLE burst of
+  *          UART_TX_BURST_MAX, with a drain after every round, as the
+  *          gateway polls them.
+  *
+  *          The CSV gives the time per frame of the fastest, average and
+  *          slowest batch in nanoseconds and how many nodes one core would
+  *          keep up with at the rate of the capture. A merged stream out of
+  *          time order, a lost item or a site summary that is not the
+  *          merge of every node fails the run.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include "aggregator.hpp"
+
+namespace {
+
+/* Private defines -----------------------------------------------------------*/
+constexpr std::uint32_t bench_batches = 5;
+constexpr std::uint32_t bench_seconds = 600;
+constexpr std::uint32_t bench_minute_ms = ROLLUP_BASE_PERIOD_MS * ROLLUP_FOLD;
+// Start of the capture on the gateway time, five minutes before the
+// milliseconds since 2000 wrap, so the merge runs across the wrap
+constexpr std::uint32_t bench_start_ms = 0u - 5u * bench_minute_ms;
+// One BLE burst, UART_TX_BURST_MAX
+constexpr std::size_t bench_piece = 244;
+
+/* Private types -------------------------------------------------------------*/
+struct Site {
+    std::vector<std::vector<std::uint8_t>> links;
+    std::uint64_t frames = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t items = 0;
+    std::uint64_t summaries = 0;
+};
+
+struct Result {
+    std::uint64_t events = 0;
+    std::uint64_t sites = 0;
+    bool ordered = true;
+    bool merged = true;
+};
+
+/* Private variables ---------------------------------------------------------*/
+std::uint32_t bench_seed = 12345;
+
+// Function to read the monotonic clock in nanoseconds
+std::uint64_t bench_now_ns() {
+    timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<std::uint64_t>(now.tv_sec) * 1000000000u + static_cast<std::uint64_t>(now.tv_nsec);
+}
+
+// Function to draw a small step, deterministic between runs
+std::int32_t bench_step(std::int32_t range) {
+    bench_seed = bench_seed * 1664525u + 1013904223u;
+    return static_cast<std::int32_t>(bench_seed >> 16) % (2 * range + 1) - range;
+}
+
+// Function to append one frame as UART_FRAMING sends it
+void bench_frame(Site &site, std::vector<std::uint8_t> &link, const void *frame, std::size_t size) {
+    std::uint8_t framed[UART_TX_FRAME_MAX + 4];
+    std::uint8_t stuffed[COBS_ENCODED_MAX(UART_TX_FRAME_MAX + 4)];
+
+    std::memcpy(framed, frame, size);
+    std::uint32_t crc = decoder::crc32_mpeg2(framed, size);
+    wire_put_u32(&framed[size], crc);
+    std::uint32_t length = cobs_encode(framed, static_cast<std::uint32_t>(size + 4), stuffed);
+    link.insert(link.end(), stuffed, stuffed + length);
+    link.push_back(0);
+    site.frames++;
+    site.bytes += length + 1;
+}
+
+// Function to build the link of one node
+void bench_node(Site &site, std::uint32_t node) {
+    std::vector<std::uint8_t> link;
+    stats_delta_t state;
+    stats_report_t report;
+    rollup_frame_t rollup = {};
+    rollup_summary_t minutes[SENSOR_COUNT];
+    float values[SENSOR_COUNT][STATS_FIELD_COUNT];
+    std::int16_t codes[SENSOR_COUNT];
+    time_sync_frame_t sync = {};
+    std::uint32_t offset = node * 7919u % 1000u;
+
+    sync.type = TIME_SYNC_FRAME_TYPE;
+    sync.version = TIME_SYNC_FRAME_VERSION;
+    sync.state = TIME_SYNC_STATE_STEPPED;
+    bench_frame(site, link, &sync, sizeof(sync));
+    stats_delta_reset(&state);
+    for (std::size_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        for (float &value : values[channel]) {
+            value = 1000.0f + static_cast<float>(node);
+        }
+        codes[channel] = static_cast<std::int16_t>(node * 16u);
+        rollup_summary_reset(&minutes[channel]);
+    }
+
+    for (std::uint32_t second = 0; second < bench_seconds; ++second) {
+        std::uint32_t time = bench_start_ms + second * 1000u + offset;
+        for (std::size_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+            for (float &value : values[channel]) {
+                value += static_cast<float>(bench_step(12));
+            }
+        }
+        std::uint16_t size = stats_delta_encode(&state, &report, time, (1U << SENSOR_COUNT) - 1U, values);
+        if (size != 0) {
+            bench_frame(site, link, &report, size);
+            site.items++;
+        }
+        // The minute that closed goes out after the first report of the next one
+        if (second != 0 && second % ROLLUP_FOLD == 0) {
+            for (std::size_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+                rollup.type = ROLLUP_FRAME_TYPE;
+                rollup.version = ROLLUP_FRAME_VERSION;
+                rollup.channel = static_cast<std::uint8_t>(channel);
+                rollup.level = 1;
+                rollup.start_ms = bench_start_ms + (second / ROLLUP_FOLD - 1u) * bench_minute_ms;
+                rollup.summary = minutes[channel];
+                bench_frame(site, link, &rollup, sizeof(rollup));
+                site.items++;
+                rollup_summary_reset(&minutes[channel]);
+            }
+        }
+        for (std::size_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+            codes[channel] = static_cast<std::int16_t>(codes[channel] + bench_step(40));
+            rollup_summary_add(&minutes[channel], codes[channel]);
+        }
+    }
+    site.links.push_back(std::move(link));
+}
+
+// Function to build the links of a site
+Site bench_site(std::uint32_t nodes) {
+    Site site;
+
+    bench_seed = 12345;
+    for (std::uint32_t node = 0; node < nodes; ++node) {
+        bench_node(site, node);
+    }
+    site.summaries = static_cast<std::uint64_t>(bench_seconds / ROLLUP_FOLD - 1) * SENSOR_COUNT;
+    return site;
+}
+
+// Function to feed the links round robin and collect the merged stream
+Result bench_merge(std::vector<std::vector<std::uint8_t>> &links) {
+    decoder::Aggregator aggregator;
+    std::vector<std::size_t> offsets(links.size(), 0);
+    std::uint32_t last = 0;
+    Result result;
+
+    for (std::size_t link = 0; link < links.size(); ++link) {
+        aggregator.add_node();
+    }
+    auto on_event = [&](const decoder::NodeEvent &event) {
+        if (result.events != 0 && decoder::time_before(event.time, last)) {
+            result.ordered = false;
+        }
+        last = event.time;
+        result.events++;
+    };
+    auto on_site = [&](const decoder::SiteSummary &site) {
+        if (site.nodes != links.size() || site.summary.count != links.size() * ROLLUP_FOLD) {
+            result.merged = false;
+        }
+        result.sites++;
+    };
+    for (bool pending = true; pending;) {
+        pending = false;
+        for (std::size_t link = 0; link < links.size(); ++link) {
+            std::size_t left = links[link].size() - offsets[link];
+            if (left == 0) {
+                continue;
+            }
+            std::size_t size = left < bench_piece ? left : bench_piece;
+            aggregator.feed(static_cast<std::uint32_t>(link), links[link].data() + offsets[link], size);
+            offsets[link] += size;
+            pending = true;
+        }
+        aggregator.drain(on_event, on_site);
+    }
+    aggregator.finish(on_event, on_site);
+    return result;
+}
+
+} // namespace
+
+int main() {
+    std::vector<std::vector<std::uint8_t>> work;
+    int status = EXIT_SUCCESS;
+
+    std::printf("nodes,frames,bytes,min_ns,avg_ns,max_ns,frames_per_s,nodes_per_core\n");
+    for (std::uint32_t nodes : {16u, 128u, 512u}) {
+        Site site = bench_site(nodes);
+        double min = 0.0, max = 0.0, total = 0.0;
+
+        for (std::uint32_t batch = 0; batch < bench_batches; ++batch) {
+            work = site.links;
+            std::uint64_t start = bench_now_ns();
+            Result result = bench_merge(work);
+            double per_frame = static_cast<double>(bench_now_ns() - start) / static_cast<double>(site.frames);
+
+            if (!result.ordered || !result.merged || result.events != site.items || result.sites != site.summaries) {
+                std::fprintf(stderr, "%u nodes: merged stream differs from the site\n", nodes);
+                status = EXIT_FAILURE;
+            }
+            min = batch == 0 || per_frame < min ? per_frame : min;
+            max = per_frame > max ? per_frame : max;
+            total += per_frame;
+        }
+
+        double frames_per_s = 1e9 / min;
+        double node_frames_per_s = static_cast<double>(site.frames) / nodes / bench_seconds;
+        std::printf("%u,%llu,%llu,%.1f,%.1f,%.1f,%.0f,%.0f\n", nodes, static_cast<unsigned long long>(site.frames),
+                    static_cast<unsigned long long>(site.bytes), min, total / bench_batches, max, frames_per_s,
+                    frames_per_s / node_frames_per_s);
+    }
+    return status;
+}
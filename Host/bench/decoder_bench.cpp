@@ -0,0 +1,241 @@
+/**
+  ******************************************************************************
+  * @file    decoder_bench.cpp
+  * @brief   Host benchmark of the frame decoder on streams built by the firmware encoders.
+  *
+  *          Each case builds a capture the way the target sends it: reports
+  *          from stats_delta_encode, a keyframe every STATS_KEYFRAME_INTERVAL,
+  *          replayed sample records packed by sample_codec_encode, or both
+  *          interleaved, each frame with its CRC, COBS stuffed and delimited.
+  *          The capture is fed to the decoder in 244-byte pieces, one BLE
+  *          burst of UART_TX_BURST_MAX, so frames straddle the pieces as they
+  *          do on a gateway. The decoding is done in place, so every batch
+  *          starts from a fresh copy of the capture, outside the timing.
+  *
+  *          The CSV gives the time per frame of the fastest, average and
+  *          slowest batch in nanoseconds, the throughput of the fastest and
+  *          how many links at the default 115200 baud, sending flat out, one
+  *          core would keep up with. A decoded stream that differs from what
+  *          was encoded fails the run.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include "frame_decoder.hpp"
+#include "sample_codec.h"
+
+namespace {
+
+/* Private defines -----------------------------------------------------------*/
+constexpr std::uint32_t bench_batches = 20;
+constexpr std::uint32_t bench_reports = 20000;
+constexpr std::uint32_t bench_records = 10000;
+// One BLE burst, UART_TX_BURST_MAX
+constexpr std::size_t bench_piece = 244;
+// 8N1 at the default UART_BAUD_RATE
+constexpr double bench_link_bytes_per_s = 115200.0 / 10.0;
+
+/* Private types -------------------------------------------------------------*/
+enum class Case { stats, log, mixed };
+
+struct Capture {
+    std::vector<std::uint8_t> bytes;
+    std::uint32_t frames = 0;
+    std::uint32_t samples = 0;
+    // Codes of the last report, to check the decoded state against
+    std::uint16_t codes[SENSOR_COUNT][STATS_FIELD_COUNT] = {};
+};
+
+struct Result {
+    std::uint64_t frames = 0;
+    std::uint64_t samples = 0;
+    std::uint64_t sink = 0;
+    bool synced = false;
+    std::uint64_t lost = 0;
+    std::uint16_t codes[SENSOR_COUNT][STATS_FIELD_COUNT] = {};
+};
+
+/* Private variables ---------------------------------------------------------*/
+std::uint32_t bench_seed = 12345;
+
+// Function to read the monotonic clock in nanoseconds
+std::uint64_t bench_now_ns() {
+    timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<std::uint64_t>(now.tv_sec) * 1000000000u + static_cast<std::uint64_t>(now.tv_nsec);
+}
+
+// Function to draw a small step, deterministic between runs
+std::int32_t bench_step(std::int32_t range) {
+    bench_seed = bench_seed * 1664525u + 1013904223u;
+    return static_cast<std::int32_t>(bench_seed >> 16) % (2 * range + 1) - range;
+}
+
+// Function to append one frame as UART_FRAMING sends it
+void bench_frame(Capture &capture, const void *frame, std::size_t size) {
+    std::uint8_t framed[UART_TX_FRAME_MAX + 4];
+    std::uint8_t stuffed[COBS_ENCODED_MAX(UART_TX_FRAME_MAX + 4)];
+
+    std::memcpy(framed, frame, size);
+    std::uint32_t crc = decoder::crc32_mpeg2(framed, size);
+    wire_put_u32(&framed[size], crc);
+    std::uint32_t length = cobs_encode(framed, static_cast<std::uint32_t>(size + 4), stuffed);
+    capture.bytes.insert(capture.bytes.end(), stuffed, stuffed + length);
+    capture.bytes.push_back(0);
+    capture.frames++;
+}
+
+// Function to append the next statistics report
+void bench_report(Capture &capture, stats_delta_t &state, float (&values)[SENSOR_COUNT][STATS_FIELD_COUNT],
+                  std::uint32_t report) {
+    stats_report_t frame;
+
+    for (std::size_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        for (std::size_t field = 0; field < STATS_FIELD_COUNT; ++field) {
+            values[channel][field] += static_cast<float>(bench_step(12));
+        }
+    }
+    std::uint16_t size = stats_delta_encode(&state, &frame, report * 1000u, (1U << SENSOR_COUNT) - 1U, values);
+    if (size != 0) {
+        bench_frame(capture, &frame, size);
+    }
+    std::memcpy(capture.codes, state.codes, sizeof(capture.codes));
+}
+
+// Function to append the next replayed sample record
+void bench_record(Capture &capture, std::int16_t &code, std::uint32_t record) {
+    flash_log_frame_t frame = {};
+    flash_log_packed_t packed = {};
+    std::int16_t codes[FLASH_LOG_PACKED_MAX];
+    std::uint32_t used;
+
+    for (std::int16_t &next : codes) {
+        code = static_cast<std::int16_t>(code + bench_step(3));
+        next = code;
+    }
+    packed.channel = static_cast<std::uint8_t>(record % SENSOR_COUNT);
+    packed.interval_ms = 100;
+    packed.count = static_cast<std::uint8_t>(
+        sample_codec_encode(codes, FLASH_LOG_PACKED_MAX, packed.data, sizeof(packed.data), &used));
+    frame.type = FLASH_LOG_FRAME_TYPE;
+    frame.version = FLASH_LOG_FRAME_VERSION;
+    frame.record_type = FLASH_LOG_RECORD_SAMPLES_PACKED;
+    frame.sequence = record;
+    frame.timestamp = record * 100u;
+    std::memcpy(frame.payload, &packed, 4 + used);
+    bench_frame(capture, &frame, offsetof(flash_log_frame_t, payload) + 4 + used);
+    capture.samples += packed.count;
+}
+
+// Function to build the capture of one case
+Capture bench_capture(Case kind) {
+    Capture capture;
+    stats_delta_t state;
+    float values[SENSOR_COUNT][STATS_FIELD_COUNT];
+    std::int16_t code = 1000;
+
+    bench_seed = 12345;
+    stats_delta_reset(&state);
+    for (auto &channel : values) {
+        for (float &value : channel) {
+            value = 1000.0f;
+        }
+    }
+    if (kind != Case::log) {
+        for (std::uint32_t report = 0; report < bench_reports; ++report) {
+            bench_report(capture, state, values, report);
+            if (kind == Case::mixed && report % 2 == 0) {
+                bench_record(capture, code, report / 2);
+            }
+        }
+    } else {
+        for (std::uint32_t record = 0; record < bench_records; ++record) {
+            bench_record(capture, code, record);
+        }
+    }
+    return capture;
+}
+
+// Function to decode a capture in pieces, the way a gateway receives it
+Result bench_decode(std::uint8_t *bytes, std::size_t size) {
+    decoder::FrameSplitter splitter;
+    decoder::StatsTracker tracker;
+    std::int16_t codes[FLASH_LOG_PACKED_MAX];
+    Result result;
+
+    auto handler = [&](const decoder::Frame &frame) {
+        result.frames++;
+        if (frame.type() == FLASH_LOG_FRAME_TYPE) {
+            if (auto record = decoder::LogRecord::parse(frame.bytes)) {
+                if (auto block = record->samples(codes)) {
+                    result.samples += block->count;
+                    result.sink += static_cast<std::uint16_t>(codes[block->count - 1]);
+                }
+            }
+        } else if (tracker.apply(frame) != decoder::StatsTracker::Result::malformed) {
+            result.sink += tracker.code(0, 0);
+        }
+    };
+    for (std::size_t offset = 0; offset < size; offset += bench_piece) {
+        splitter.feed(bytes + offset, size - offset < bench_piece ? size - offset : bench_piece, handler);
+    }
+
+    result.synced = tracker.synced();
+    result.lost = tracker.lost();
+    for (std::size_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        for (std::size_t field = 0; field < STATS_FIELD_COUNT; ++field) {
+            result.codes[channel][field] = tracker.code(channel, field);
+        }
+    }
+    return result;
+}
+
+// Function to compare a decoded stream with its capture
+bool bench_check(const Capture &capture, const Result &result, bool stats) {
+    if (result.frames != capture.frames || result.samples != capture.samples || result.lost != 0) {
+        return false;
+    }
+    return !stats || (result.synced && std::memcmp(result.codes, capture.codes, sizeof(result.codes)) == 0);
+}
+
+} // namespace
+
+int main() {
+    static const char *const case_names[] = {"stats", "log_packed", "mixed"};
+    std::vector<std::uint8_t> work;
+    int status = EXIT_SUCCESS;
+
+    std::printf("case,frames,bytes,min_ns,avg_ns,max_ns,mb_per_s,links_per_core\n");
+    for (Case kind : {Case::stats, Case::log, Case::mixed}) {
+        Capture capture = bench_capture(kind);
+        double min = 0.0, max = 0.0, total = 0.0;
+
+        for (std::uint32_t batch = 0; batch < bench_batches; ++batch) {
+            work = capture.bytes;
+            std::uint64_t start = bench_now_ns();
+            Result result = bench_decode(work.data(), work.size());
+            double per_frame = static_cast<double>(bench_now_ns() - start) / capture.frames;
+
+            if (!bench_check(capture, result, kind != Case::log)) {
+                std::fprintf(stderr, "%s: decoded stream differs from the capture\n",
+                             case_names[static_cast<int>(kind)]);
+                status = EXIT_FAILURE;
+            }
+            min = batch == 0 || per_frame < min ? per_frame : min;
+            max = per_frame > max ? per_frame : max;
+            total += per_frame;
+        }
+
+        double bytes_per_s = static_cast<double>(capture.bytes.size()) / (min * capture.frames) * 1e9;
+        std::printf("%s,%u,%zu,%.1f,%.1f,%.1f,%.1f,%.0f\n", case_names[static_cast<int>(kind)], capture.frames,
+                    capture.bytes.size(), min, total / bench_batches, max, bytes_per_s / 1e6,
+                    bytes_per_s / bench_link_bytes_per_s);
+    }
+    return status;
+}
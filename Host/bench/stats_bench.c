@@ -0,0 +1,191 @@
+/**
+  ******************************************************************************
+  * @file    stats_bench.c
+  * @brief   Host benchmark of the statistics kernels and the sample ring.
+  *
+  *          Same cases as the on-target stats_benchmark: every kernel over
+  *          several window sizes and sorted, random and constant input. Each
+  *          measurement times a batch of calls with CLOCK_MONOTONIC and the
+  *          per-call time of the fastest, average and slowest batch is
+  *          printed as CSV in nanoseconds. The median reorders its input, so
+  *          its numbers include restoring the input with memcpy.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sample_ring.h"
+#include "sensor_stats.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define BENCH_BATCHES 20
+#define BENCH_CALLS_PER_BATCH 2000
+
+/* Private types -------------------------------------------------------------*/
+typedef enum {
+    BENCHMARK_STD_DEV,
+    BENCHMARK_MAX,
+    BENCHMARK_MIN,
+    BENCHMARK_MEDIAN,
+    BENCHMARK_BATCH_STATS,
+    BENCHMARK_WINDOW_SLIDE,
+    BENCHMARK_RING_PUSH_DISCARD,
+    BENCHMARK_BATCH_STATS_Q15,
+    BENCHMARK_BATCH_STATS_Q15_SCALAR,
+    BENCHMARK_KERNEL_COUNT
+} benchmark_kernel_t;
+
+typedef enum {
+    DISTRIBUTION_SORTED,
+    DISTRIBUTION_RANDOM,
+    DISTRIBUTION_CONSTANT,
+    DISTRIBUTION_COUNT
+} benchmark_distribution_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const char *const kernel_names[BENCHMARK_KERNEL_COUNT] = {
+    "std_dev", "max", "min", "median", "batch_stats", "window_slide", "ring_push_discard",
+    "batch_stats_q15", "batch_stats_q15_scalar"
+};
+static const char *const distribution_names[DISTRIBUTION_COUNT] = {
+    "sorted", "random", "constant"
+};
+static const uint32_t window_sizes[] = { 16, 32, 64, 100, STATS_WINDOW_CAPACITY };
+
+static float bench_input[STATS_WINDOW_CAPACITY + 1];
+static float bench_work[STATS_WINDOW_CAPACITY];
+static int16_t bench_input_q15[STATS_WINDOW_CAPACITY + 1];
+static window_stats_t bench_window;
+static sample_ring_t bench_ring;
+// Results are stored here so the timed calls cannot be optimized away
+static volatile float bench_sink;
+
+// Function to read the monotonic clock in nanoseconds
+static uint64_t bench_now_ns(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// Function to generate the input of one case, count + 1 values for the slide
+static void bench_fill(benchmark_distribution_t distribution, uint32_t count) {
+    uint32_t seed = 12345;
+
+    for (uint32_t i = 0; i <= count; ++i) {
+        switch (distribution) {
+        case DISTRIBUTION_SORTED:
+            bench_input[i] = (float)i;
+            break;
+        case DISTRIBUTION_RANDOM:
+            // 12-bit values like a sensor word, deterministic between runs
+            seed = seed * 1664525u + 1013904223u;
+            bench_input[i] = (float)(seed >> 20);
+            break;
+        default:
+            bench_input[i] = 1000.0f;
+            break;
+        }
+        bench_input_q15[i] = (int16_t)bench_input[i];
+    }
+}
+
+// Function to prepare the state a kernel needs before a batch
+static void bench_prepare(benchmark_kernel_t kernel, uint32_t count) {
+    memcpy(bench_work, bench_input, count * sizeof(float));
+    if (kernel == BENCHMARK_WINDOW_SLIDE) {
+        window_stats_reset(&bench_window);
+        for (uint32_t i = 0; i < count; ++i) {
+            window_stats_add(&bench_window, bench_input[i]);
+        }
+    } else if (kernel == BENCHMARK_RING_PUSH_DISCARD) {
+        sensor_data_t sample = {0};
+
+        sample_ring_init(&bench_ring);
+        for (uint32_t i = 0; i < count; ++i) {
+            sample.value = bench_input[i];
+            sample_ring_push(&bench_ring, &sample);
+        }
+    }
+}
+
+// Function to run one call of a kernel
+static float bench_call(benchmark_kernel_t kernel, uint32_t count, uint32_t call) {
+    batch_stats_t stats;
+    batch_stats_q15_t stats_q15;
+    sensor_data_t sample = {0};
+
+    switch (kernel) {
+    case BENCHMARK_STD_DEV:
+        return calculate_std_dev(bench_work, count);
+    case BENCHMARK_MAX:
+        return calculate_max(bench_work, count);
+    case BENCHMARK_MIN:
+        return calculate_min(bench_work, count);
+    case BENCHMARK_MEDIAN:
+        memcpy(bench_work, bench_input, count * sizeof(float));
+        return calculate_median(bench_work, count);
+    case BENCHMARK_BATCH_STATS:
+        batch_stats_reset(&stats);
+        batch_stats_accumulate(&stats, bench_work, count);
+        return batch_stats_std_dev(&stats) + stats.min + stats.max;
+    case BENCHMARK_WINDOW_SLIDE:
+        // The window keeps sliding over the same input, like the consumer per sample
+        window_stats_remove_oldest(&bench_window, bench_input[call % count]);
+        window_stats_add(&bench_window, bench_input[call % count]);
+#if STATS_HISTOGRAM_MEDIAN
+        return order_histogram_percentile(&bench_window.histogram, 0.5f, bench_input_q15, count, NULL, 0);
+#else
+        return median_window_median(&bench_window.median);
+#endif
+    case BENCHMARK_BATCH_STATS_Q15:
+        batch_stats_q15_reset(&stats_q15);
+        batch_stats_q15_accumulate(&stats_q15, bench_input_q15, count);
+        return (float)(stats_q15.sum + stats_q15.min + stats_q15.max);
+    case BENCHMARK_BATCH_STATS_Q15_SCALAR:
+        batch_stats_q15_reset(&stats_q15);
+        batch_stats_q15_accumulate_scalar(&stats_q15, bench_input_q15, count);
+        return (float)(stats_q15.sum + stats_q15.min + stats_q15.max);
+    default:
+        // Producer push plus consumer release of one sample on a window-sized ring
+        sample.value = bench_input[call % count];
+        sample_ring_push(&bench_ring, &sample);
+        sample_ring_discard(&bench_ring, SAMPLE_READER_STATS, 1);
+        return sample_ring_value(&bench_ring, SAMPLE_READER_STATS, 0);
+    }
+}
+
+int main(void) {
+    printf("kernel,size,distribution,min_ns,avg_ns,max_ns\n");
+
+    for (uint32_t kernel = 0; kernel < BENCHMARK_KERNEL_COUNT; ++kernel) {
+        for (uint32_t size = 0; size < sizeof(window_sizes) / sizeof(window_sizes[0]); ++size) {
+            for (uint32_t distribution = 0; distribution < DISTRIBUTION_COUNT; ++distribution) {
+                uint32_t count = window_sizes[size];
+                double min = 0.0, max = 0.0, total = 0.0;
+
+                bench_fill(distribution, count);
+                bench_prepare(kernel, count);
+                for (uint32_t batch = 0; batch < BENCH_BATCHES; ++batch) {
+                    uint64_t start = bench_now_ns();
+                    for (uint32_t call = 0; call < BENCH_CALLS_PER_BATCH; ++call) {
+                        bench_sink = bench_call(kernel, count, call);
+                    }
+                    double per_call = (double)(bench_now_ns() - start) / BENCH_CALLS_PER_BATCH;
+
+                    min = batch == 0 || per_call < min ? per_call : min;
+                    max = per_call > max ? per_call : max;
+                    total += per_call;
+                }
+
+                printf("%s,%u,%s,%.1f,%.1f,%.1f\n", kernel_names[kernel], (unsigned)count,
+                       distribution_names[distribution], min, total / BENCH_BATCHES, max);
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,226 @@
+/**
+  ******************************************************************************
+  * @file    aggregator.cpp
+  * @brief   Gateway aggregator: N node streams merged on the synchronized time line, site summaries.
+  *
+  *          Every consumer of a gateway used to poll and decode the nodes
+  *          on its own. The aggregator decodes each stream once and hands
+  *          out one stream of the whole site. With TIME_SYNC the nodes stamp
+  *          their samples with the gateway time in milliseconds since 2000,
+  *          so their reports can be put on one time line, and the sync
+  *          frames tell when a node got there.
+  *
+  *          The streams are merged the way an external sort merges its runs.
+  *          Within a node the items are in time order: a report older than
+  *          the last one queued for the node is dropped, and a summary takes
+  *          the time of its node at its arrival, since the firmware sends
+  *          a closed period with the next report. The heap keeps the earliest
+  *          head of the node queues on top. What may still come from a node
+  *          is never earlier than what it sent last, so every item up to the
+  *          time all nodes reached can go. A node that fell idle_ms behind
+  *          the most advanced one no longer holds the others back, and what
+  *          it sends later than the released items is dropped as late.
+  *
+  *          The rollup summaries are mergeable: the merge of rollup_summary.c,
+  *          the firmware source itself, combines the summaries of the nodes
+  *          for the same channel and period into the one of the site, with
+  *          its exact count, mean, variance, min and max and the summed
+  *          sketch. The periods of all nodes start on the same boundaries of
+  *          the shared time base, so the site summary of a minute is the
+  *          minute of every sample of the site.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "aggregator.hpp"
+
+namespace decoder {
+
+// Function to add a node stream
+std::uint32_t Aggregator::add_node() {
+    nodes_.emplace_back();
+    nodes_.back().synced = !config_.require_sync;
+    return static_cast<std::uint32_t>(nodes_.size() - 1);
+}
+
+// Function to decode a buffer of a node
+void Aggregator::feed(std::uint32_t node, std::uint8_t *data, std::size_t size) {
+    nodes_[node].splitter.feed(data, size, [this, node](const Frame &frame) { decode(node, frame); });
+}
+
+// Function to decode one frame of a node into its queue
+void Aggregator::decode(std::uint32_t node, const Frame &frame) {
+    Node &state = nodes_[node];
+    NodeEvent event;
+
+    if (frame.type() == TIME_SYNC_FRAME_TYPE) {
+        if (auto sync = SyncFrame::parse(frame.bytes)) {
+            bool synced = !config_.require_sync || sync->state() != TIME_SYNC_STATE_FREE;
+            if (!synced) {
+                // Rebooted, its next times count from the boot again
+                state.started = false;
+            }
+            state.synced = synced;
+        }
+        return;
+    }
+    if (frame.type() == ROLLUP_FRAME_TYPE) {
+        auto rollup = RollupFrame::parse(frame.bytes);
+        if (!rollup) {
+            return;
+        }
+        if (!state.synced) {
+            counters_.unsynced++;
+            return;
+        }
+        event.kind = NodeEvent::Kind::rollup;
+        event.node = node;
+        event.period_ms = rollup->period_ms();
+        event.time = rollup->start_ms() + event.period_ms;
+        if (state.started && time_before(event.time, state.reached)) {
+            event.time = state.reached;
+        }
+        if (releasing_ && time_before(event.time, released_)) {
+            event.time = released_;
+        }
+        event.channel = rollup->channel();
+        event.level = rollup->level();
+        event.start_ms = rollup->start_ms();
+        event.summary = rollup->summary();
+        queue(node, event);
+        return;
+    }
+
+    StatsTracker::Result result = state.tracker.apply(frame);
+    if (result != StatsTracker::Result::keyframe && result != StatsTracker::Result::delta) {
+        return;
+    }
+    if (!state.synced) {
+        counters_.unsynced++;
+        return;
+    }
+    event.kind = NodeEvent::Kind::report;
+    event.node = node;
+    event.time = state.tracker.timestamp();
+    if ((state.started && time_before(event.time, state.reached)) ||
+        (releasing_ && time_before(event.time, released_))) {
+        counters_.late++;
+        return;
+    }
+    event.channel_mask = state.tracker.channel_mask();
+    event.encoding = state.tracker.encoding();
+    for (std::size_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        for (std::size_t field = 0; field < STATS_FIELD_COUNT; ++field) {
+            event.codes[channel][field] = state.tracker.code(channel, field);
+        }
+    }
+    queue(node, event);
+}
+
+// Function to queue an item of a node, its queue enters the heap when it was empty
+void Aggregator::queue(std::uint32_t node, const NodeEvent &event) {
+    Node &state = nodes_[node];
+
+    if (state.events.empty()) {
+        heap_.push(Head{event.time, node});
+    }
+    state.events.push_back(event);
+    state.reached = event.time;
+    state.started = true;
+}
+
+// Function to find the watermark, the earliest time of the live nodes
+bool Aggregator::watermark(std::uint32_t &mark) const {
+    std::uint32_t front = 0;
+    bool started = false;
+
+    for (const Node &node : nodes_) {
+        if (node.started && (!started || time_before(front, node.reached))) {
+            front = node.reached;
+            started = true;
+        }
+    }
+    if (!started) {
+        return false;
+    }
+    mark = front;
+    for (const Node &node : nodes_) {
+        if (node.started && front - node.reached <= config_.idle_ms && time_before(node.reached, mark)) {
+            mark = node.reached;
+        }
+    }
+    return true;
+}
+
+// Function to take the earliest item up to mark out of the heap
+bool Aggregator::pop(std::uint32_t mark, bool all, NodeEvent &event) {
+    if (heap_.empty()) {
+        return false;
+    }
+    Head head = heap_.top();
+    if (!all && time_before(mark, head.time)) {
+        return false;
+    }
+    heap_.pop();
+    Node &node = nodes_[head.node];
+    event = node.events.front();
+    node.events.pop_front();
+    if (!node.events.empty()) {
+        heap_.push(Head{node.events.front().time, head.node});
+    }
+    released_ = head.time;
+    releasing_ = true;
+    counters_.events++;
+    if (event.kind == NodeEvent::Kind::rollup) {
+        merge(event);
+    }
+    return true;
+}
+
+// Function to merge a released summary into its site summary
+void Aggregator::merge(const NodeEvent &event) {
+    if (closed_[event.channel][event.level] && !time_before(closed_ms_[event.channel][event.level], event.start_ms)) {
+        counters_.late_rollups++;
+        return;
+    }
+    for (Bucket &bucket : buckets_) {
+        if (bucket.site.channel == event.channel && bucket.site.level == event.level &&
+            bucket.site.start_ms == event.start_ms) {
+            rollup_summary_merge(&bucket.site.summary, &event.summary);
+            bucket.site.nodes++;
+            return;
+        }
+    }
+    Bucket bucket;
+    bucket.site.channel = event.channel;
+    bucket.site.level = event.level;
+    bucket.site.start_ms = event.start_ms;
+    bucket.site.period_ms = event.period_ms;
+    bucket.site.nodes = 1;
+    bucket.site.summary = event.summary;
+    bucket.close_ms = event.start_ms + bucket.site.period_ms + config_.lateness_ms;
+    buckets_.push_back(bucket);
+}
+
+// Function to take the earliest site summary mark closed
+bool Aggregator::close(std::uint32_t mark, bool all, SiteSummary &site) {
+    auto earliest = buckets_.end();
+
+    for (auto bucket = buckets_.begin(); bucket != buckets_.end(); ++bucket) {
+        if ((all || !time_before(mark, bucket->close_ms)) &&
+            (earliest == buckets_.end() || time_before(bucket->close_ms, earliest->close_ms))) {
+            earliest = bucket;
+        }
+    }
+    if (earliest == buckets_.end()) {
+        return false;
+    }
+    site = earliest->site;
+    buckets_.erase(earliest);
+    closed_ms_[site.channel][site.level] = site.start_ms;
+    closed_[site.channel][site.level] = true;
+    counters_.sites++;
+    return true;
+}
+
+} // namespace decoder
@@ -0,0 +1,204 @@
+/**
+  ******************************************************************************
+  * @file    aggregator.hpp
+  * @brief   Gateway aggregator: N node streams merged on the synchronized time line, site summaries.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __AGGREGATOR_HPP
+#define __AGGREGATOR_HPP
+
+/* Includes ------------------------------------------------------------------*/
+#include <cstdint>
+#include <deque>
+#include <queue>
+#include <vector>
+#include "frame_decoder.hpp"
+
+namespace decoder {
+
+/* Time line -----------------------------------------------------------------*/
+// Order of two sample times, which wrap like every time of the firmware.
+// Holds while the times compared lie less than 24 days apart.
+constexpr bool time_before(std::uint32_t time, std::uint32_t other) {
+    return static_cast<std::int32_t>(time - other) < 0;
+}
+
+/* Events --------------------------------------------------------------------*/
+// One decoded item of a node, as the merge releases it
+struct NodeEvent {
+    enum class Kind {
+        report, // Statistics after a keyframe or a delta frame
+        rollup  // Summary of a closed period
+    };
+
+    Kind kind;
+    std::uint32_t node;
+    // Place on the merged time line: the timestamp of a report, and for a
+    // summary the time of the report the node sent it after, at least the
+    // end of its period
+    std::uint32_t time;
+    // Report
+    std::uint16_t channel_mask;
+    std::uint8_t encoding;
+    std::uint16_t codes[SENSOR_COUNT][STATS_FIELD_COUNT];
+    // Summary
+    std::uint8_t channel;
+    std::uint8_t level;
+    std::uint32_t start_ms;
+    std::uint32_t period_ms;
+    rollup_summary_t summary;
+
+    // Statistic of a report in sensor units
+    float value(std::size_t channel, std::size_t field) const {
+        return stats_code_value(codes[channel][field], channel, encoding);
+    }
+};
+
+// Summaries of one channel and period merged over the nodes of the site
+struct SiteSummary {
+    std::uint8_t channel;
+    std::uint8_t level;
+    std::uint32_t start_ms;
+    std::uint32_t period_ms;
+    std::uint32_t nodes; // Node summaries merged
+    rollup_summary_t summary;
+};
+
+struct AggregatorConfig {
+    // A node whose stream lags the most advanced one by more than this is
+    // left out of the watermark, so a silent node does not hold the site
+    std::uint32_t idle_ms = 60000;
+    // A site summary closes this long after the end of its period. A node
+    // sends a summary with its next report, so this covers a report period.
+    std::uint32_t lateness_ms = 15000;
+    // Drop the items of a node until a sync frame shows its clock on the
+    // gateway time, before that its times count from its boot
+    bool require_sync = true;
+};
+
+struct AggregatorCounters {
+    std::uint64_t events = 0;       // Released by the merge
+    std::uint64_t unsynced = 0;     // Dropped, the node clock was not synchronized
+    std::uint64_t late = 0;         // Reports behind their node or the merge, dropped
+    std::uint64_t late_rollups = 0; // Summaries of a site period already closed, dropped
+    std::uint64_t sites = 0;        // Site summaries closed
+};
+
+/* Aggregator ----------------------------------------------------------------*/
+// Decodes the streams of many nodes and merges them into one stream in time
+// order. Every node gets its own splitter and statistics tracker and a queue
+// of decoded items, in time order within the node. A binary heap holds the
+// head of every queue that is not empty, so releasing an item costs
+// O(log N) for N nodes and no queue is ever scanned. Items are released up
+// to the watermark, the time every live node reached, and the summaries
+// the merge releases are merged per channel, level and period into the
+// summary of the site, which closes once the watermark passed its end by
+// lateness_ms. One thread.
+class Aggregator {
+public:
+    explicit Aggregator(AggregatorConfig config = {}) : config_(config) {}
+
+    // Add a node stream, returns its index for feed
+    std::uint32_t add_node();
+
+    // Decode bytes received from a node. data is modified, as with
+    // FrameSplitter::feed. Nothing is released before drain.
+    void feed(std::uint32_t node, std::uint8_t *data, std::size_t size);
+
+    // Call on_event(const NodeEvent &) for every item up to the watermark in
+    // time order, then on_site(const SiteSummary &) for every site summary it
+    // closed. The watermark costs O(N), so drain once per round of feeds.
+    template <typename EventHandler, typename SiteHandler>
+    void drain(EventHandler &&on_event, SiteHandler &&on_site) {
+        std::uint32_t mark;
+
+        if (watermark(mark)) {
+            release(mark, false, on_event, on_site);
+        }
+    }
+
+    // drain at the end of the streams: every item and every open site summary
+    template <typename EventHandler, typename SiteHandler>
+    void finish(EventHandler &&on_event, SiteHandler &&on_site) {
+        release(0, true, on_event, on_site);
+    }
+
+    // Time every live node reached and no item after it was released.
+    // False until a node sent an item.
+    bool watermark(std::uint32_t &mark) const;
+
+    std::size_t node_count() const { return nodes_.size(); }
+    bool node_synced(std::uint32_t node) const { return nodes_[node].synced; }
+    // Reports the node tracker found missing
+    std::uint64_t node_lost(std::uint32_t node) const { return nodes_[node].tracker.lost(); }
+    const FrameCounters &node_counters(std::uint32_t node) const { return nodes_[node].splitter.counters(); }
+    const AggregatorCounters &counters() const { return counters_; }
+
+private:
+    struct Node {
+        FrameSplitter splitter;
+        StatsTracker tracker;
+        std::deque<NodeEvent> events;
+        // Time of the latest item queued, the node reached it
+        std::uint32_t reached = 0;
+        bool started = false;
+        bool synced = false;
+    };
+
+    // Head of a node queue in the heap, the earliest on top, the lower node on a tie
+    struct Head {
+        std::uint32_t time;
+        std::uint32_t node;
+        bool operator<(const Head &other) const {
+            return time != other.time ? time_before(other.time, time) : other.node < node;
+        }
+    };
+
+    // Site summary not closed yet
+    struct Bucket {
+        SiteSummary site;
+        std::uint32_t close_ms;
+    };
+
+    template <typename EventHandler, typename SiteHandler>
+    void release(std::uint32_t mark, bool all, EventHandler &&on_event, SiteHandler &&on_site) {
+        NodeEvent event;
+        SiteSummary site;
+
+        while (pop(mark, all, event)) {
+            on_event(event);
+        }
+        while (close(mark, all, site)) {
+            on_site(site);
+        }
+    }
+
+    // Function to decode one frame of a node into its queue
+    void decode(std::uint32_t node, const Frame &frame);
+    // Function to queue an item of a node
+    void queue(std::uint32_t node, const NodeEvent &event);
+    // Function to take the earliest item up to mark out of the heap
+    bool pop(std::uint32_t mark, bool all, NodeEvent &event);
+    // Function to merge a released summary into its site summary
+    void merge(const NodeEvent &event);
+    // Function to take the earliest site summary mark closed
+    bool close(std::uint32_t mark, bool all, SiteSummary &site);
+
+    AggregatorConfig config_;
+    std::vector<Node> nodes_;
+    std::priority_queue<Head> heap_;
+    std::vector<Bucket> buckets_;
+    // Start of the latest site summary closed per channel and level
+    std::uint32_t closed_ms_[SENSOR_COUNT][ROLLUP_LEVELS] = {};
+    bool closed_[SENSOR_COUNT][ROLLUP_LEVELS] = {};
+    // Time of the latest item released
+    std::uint32_t released_ = 0;
+    bool releasing_ = false;
+    AggregatorCounters counters_;
+};
+
+} // namespace decoder
+
+#endif /* __AGGREGATOR_HPP */
@@ -0,0 +1,327 @@
+/**
+  ******************************************************************************
+  * @file    frame_decoder.cpp
+  * @brief   Host decoder of the USART2 stream: framing, CRC, statistics reports and log records.
+  *
+  *          The layouts come from the firmware headers the library is built
+  *          against, stats_frame.h, stats_delta.h, stats_rollup.h,
+  *          time_sync.h and flash_log_frame.h, and the COBS and sample codec
+  *          are the firmware sources themselves, so a layout change breaks
+  *          the decoder build instead of the gateway. Build it with the same
+  *          STATS_* and SENSOR_* definitions as the firmware it receives
+  *          from. Every view checks the version and the size before a field
+  *          is read. Fields are read at the offsets of
+  *          the firmware structs, which wire_format.h pins, through its
+  *          little-endian accessors; no frame is cast to a struct.
+  *
+  *          The CRC is the hot loop of a gateway: a word at a time from four
+  *          tables, the unit on the target takes the same words.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "frame_decoder.hpp"
+#include <array>
+#include "sample_codec.h"
+#include "sensor_registry.h"
+
+namespace decoder {
+
+namespace {
+
+/* Private defines -----------------------------------------------------------*/
+constexpr std::uint32_t crc_polynomial = 0x04C11DB7U;
+constexpr std::size_t stats_header_size = offsetof(stats_frame_t, values);
+constexpr std::size_t delta_header_size = offsetof(stats_delta_frame_t, deltas);
+constexpr std::size_t log_header_size = offsetof(flash_log_frame_t, payload);
+// Both sample records share their header
+constexpr std::size_t sample_header_size = offsetof(flash_log_samples_t, codes);
+static_assert(offsetof(flash_log_packed_t, data) == sample_header_size, "sample record headers differ");
+
+// Four tables: tables[n][b] is byte b at bits 8n..8n+7 of the register
+// shifted through the 32 steps of one word
+using CrcTables = std::array<std::array<std::uint32_t, 256>, 4>;
+
+// Function to build the word-at-a-time CRC tables
+constexpr CrcTables crc_make_tables() {
+    CrcTables tables{};
+
+    // The low byte shifts up to the top without feedback, then takes 8 steps
+    for (std::uint32_t byte = 0; byte < 256; ++byte) {
+        std::uint32_t crc = byte << 24;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x80000000U) != 0 ? (crc << 1) ^ crc_polynomial : crc << 1;
+        }
+        tables[0][byte] = crc;
+    }
+    // Every byte further up takes 8 steps more
+    for (std::size_t table = 1; table < 4; ++table) {
+        for (std::uint32_t byte = 0; byte < 256; ++byte) {
+            std::uint32_t crc = tables[table - 1][byte];
+            tables[table][byte] = (crc << 8) ^ tables[0][crc >> 24];
+        }
+    }
+    return tables;
+}
+
+constexpr CrcTables crc_tables = crc_make_tables();
+
+// Function to run one word through the CRC
+inline std::uint32_t crc_word(std::uint32_t crc, std::uint32_t word) {
+    crc ^= word;
+    return crc_tables[0][crc & 0xFFU] ^ crc_tables[1][(crc >> 8) & 0xFFU] ^ crc_tables[2][(crc >> 16) & 0xFFU] ^
+           crc_tables[3][crc >> 24];
+}
+
+} // namespace
+
+// Function to compute the CRC of the target CRC unit
+std::uint32_t crc32_mpeg2(const std::uint8_t *data, std::size_t size) {
+    std::uint32_t crc = 0xFFFFFFFFU;
+    std::size_t index = 0;
+
+    for (; index + 4 <= size; index += 4) {
+        crc = crc_word(crc, wire_get_u32(data + index));
+    }
+    if (index < size) {
+        std::uint8_t tail[4] = {0, 0, 0, 0};
+        std::memcpy(tail, data + index, size - index);
+        crc = crc_word(crc, wire_get_u32(tail));
+    }
+    return crc;
+}
+
+// Function to expand a half to a float
+float half_to_float(std::uint16_t half) {
+    std::uint32_t sign = static_cast<std::uint32_t>(half & 0x8000U) << 16;
+    std::uint32_t exponent = (half >> 10) & 0x1FU;
+    std::uint32_t mantissa = half & 0x3FFU;
+    std::uint32_t bits;
+
+    if (exponent == 0x1FU) {
+        bits = sign | 0x7F800000U | mantissa << 13;
+    } else if (exponent != 0) {
+        bits = sign | (exponent + 112U) << 23 | mantissa << 13;
+    } else if (mantissa == 0) {
+        bits = sign;
+    } else {
+        // Subnormal, normalize the mantissa
+        exponent = 113U;
+        while ((mantissa & 0x400U) == 0) {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | exponent << 23 | (mantissa & 0x3FFU) << 13;
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Function to check a keyframe
+std::optional<StatsFrame> StatsFrame::parse(Bytes bytes) {
+    if (bytes.size() < stats_header_size || bytes[0] != STATS_FRAME_TYPE || bytes[1] != STATS_FRAME_VERSION) {
+        return std::nullopt;
+    }
+    StatsFrame frame(bytes);
+    std::uint32_t mask = frame.channel_mask();
+    // The delta frames that follow number their bits by this field count
+    std::size_t channels = static_cast<std::size_t>(__builtin_popcount(mask));
+    if (frame.field_count() != STATS_FIELD_COUNT || (mask >> SENSOR_COUNT) != 0 ||
+        bytes.size() != stats_header_size + 2U * STATS_FIELD_COUNT * channels) {
+        return std::nullopt;
+    }
+    return frame;
+}
+
+// Function to check a delta frame
+std::optional<DeltaFrame> DeltaFrame::parse(Bytes bytes) {
+    if (bytes.size() < delta_header_size || bytes[0] != STATS_DELTA_FRAME_TYPE ||
+        bytes[1] != STATS_DELTA_FRAME_VERSION) {
+        return std::nullopt;
+    }
+    return DeltaFrame(bytes);
+}
+
+// Function to count the reports between the last one and sequence
+void StatsTracker::track(std::uint16_t sequence) {
+    if (started_) {
+        lost_ += static_cast<std::uint16_t>(sequence - sequence_ - 1U);
+    }
+    started_ = true;
+    sequence_ = sequence;
+}
+
+// Function to apply one report
+StatsTracker::Result StatsTracker::apply(const Frame &frame) {
+    if (auto key = StatsFrame::parse(frame.bytes)) {
+        std::size_t index = 0;
+
+        for (std::size_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+            if ((key->channel_mask() & (1U << channel)) == 0) {
+                continue;
+            }
+            for (std::size_t field = 0; field < STATS_FIELD_COUNT; ++field) {
+                codes_[channel][field] = key->code(index++);
+            }
+        }
+        track(key->sequence());
+        timestamp_ = key->timestamp();
+        channel_mask_ = key->channel_mask();
+        encoding_ = key->encoding();
+#if SENSOR_OCCUPANCY
+        occupancy_ = key->occupancy();
+#endif
+        synced_ = true;
+        return Result::keyframe;
+    }
+
+    auto delta = DeltaFrame::parse(frame.bytes);
+    if (!delta) {
+        return Result::malformed;
+    }
+    std::uint16_t expected = static_cast<std::uint16_t>(sequence_ + 1U);
+    if (!synced_ || delta->sequence() != expected) {
+        track(delta->sequence());
+        synced_ = false;
+        return Result::out_of_sync;
+    }
+
+    // Decode into a copy, a truncated frame leaves the state as it was
+    std::uint16_t codes[SENSOR_COUNT][STATS_FIELD_COUNT];
+    std::memcpy(codes, codes_, sizeof(codes));
+    Bytes mask = delta->field_mask();
+    Bytes varints = delta->deltas();
+    std::size_t position = 0;
+    for (std::size_t bit = 0; bit < SENSOR_COUNT * STATS_FIELD_COUNT; ++bit) {
+        if ((mask[bit / 8] & (1U << (bit % 8))) == 0) {
+            continue;
+        }
+        std::uint32_t zigzag = 0;
+        for (std::uint32_t shift = 0;; shift += 7) {
+            if (position >= varints.size() || shift >= 7 * STATS_DELTA_VARINT_MAX) {
+                return Result::malformed;
+            }
+            std::uint8_t byte = varints[position++];
+            zigzag |= static_cast<std::uint32_t>(byte & 0x7FU) << shift;
+            if ((byte & 0x80U) == 0) {
+                break;
+            }
+        }
+        std::uint16_t step = static_cast<std::uint16_t>((zigzag >> 1) ^ (0U - (zigzag & 1U)));
+        std::uint16_t &code = codes[bit / STATS_FIELD_COUNT][bit % STATS_FIELD_COUNT];
+        code = static_cast<std::uint16_t>(code + step);
+    }
+    if (position != varints.size()) {
+        return Result::malformed;
+    }
+
+    std::memcpy(codes_, codes, sizeof(codes));
+    track(delta->sequence());
+    timestamp_ = delta->timestamp();
+    encoding_ = delta->encoding();
+#if SENSOR_OCCUPANCY
+    occupancy_ = delta->occupancy();
+#endif
+    return Result::delta;
+}
+
+// Function to convert a code back to sensor units
+float stats_code_value(std::uint16_t code, std::size_t channel, std::uint8_t encoding) {
+    if (encoding == STATS_ENCODING_FIXED16) {
+        return static_cast<float>(static_cast<std::int16_t>(code)) * sensor_registry[channel].fixed_scale;
+    }
+    return half_to_float(code);
+}
+
+// Function to convert a tracked code back to sensor units
+float StatsTracker::value(std::size_t channel, std::size_t field) const {
+    return stats_code_value(codes_[channel][field], channel, encoding_);
+}
+
+// Function to check a rollup frame
+std::optional<RollupFrame> RollupFrame::parse(Bytes bytes) {
+    if (bytes.size() != sizeof(rollup_frame_t) || bytes[0] != ROLLUP_FRAME_TYPE || bytes[1] != ROLLUP_FRAME_VERSION) {
+        return std::nullopt;
+    }
+    RollupFrame frame(bytes);
+    if (frame.channel() >= SENSOR_COUNT || frame.level() >= ROLLUP_LEVELS) {
+        return std::nullopt;
+    }
+    return frame;
+}
+
+// Function to give the length of the period of the level
+std::uint32_t RollupFrame::period_ms() const {
+    std::uint32_t period = ROLLUP_BASE_PERIOD_MS;
+
+    for (std::uint32_t level = 0; level < this->level(); ++level) {
+        period *= ROLLUP_FOLD;
+    }
+    return period;
+}
+
+// Function to read the summary field by field
+rollup_summary_t RollupFrame::summary() const {
+    const std::uint8_t *base = at(offsetof(rollup_frame_t, summary));
+    rollup_summary_t summary;
+    std::uint32_t bits;
+
+    summary.count = wire_get_u32(base + offsetof(rollup_summary_t, count));
+    bits = wire_get_u32(base + offsetof(rollup_summary_t, mean));
+    std::memcpy(&summary.mean, &bits, sizeof(summary.mean));
+    bits = wire_get_u32(base + offsetof(rollup_summary_t, m2));
+    std::memcpy(&summary.m2, &bits, sizeof(summary.m2));
+    summary.min = static_cast<std::int16_t>(wire_get_u16(base + offsetof(rollup_summary_t, min)));
+    summary.max = static_cast<std::int16_t>(wire_get_u16(base + offsetof(rollup_summary_t, max)));
+    for (std::size_t bin = 0; bin < ROLLUP_SKETCH_BINS; ++bin) {
+        summary.sketch[bin] = wire_get_u16(base + offsetof(rollup_summary_t, sketch) + sizeof(std::uint16_t) * bin);
+    }
+    return summary;
+}
+
+// Function to check a sync frame
+std::optional<SyncFrame> SyncFrame::parse(Bytes bytes) {
+    if (bytes.size() != sizeof(time_sync_frame_t) || bytes[0] != TIME_SYNC_FRAME_TYPE ||
+        bytes[1] != TIME_SYNC_FRAME_VERSION) {
+        return std::nullopt;
+    }
+    return SyncFrame(bytes);
+}
+
+// Function to check a replayed record
+std::optional<LogRecord> LogRecord::parse(Bytes bytes) {
+    if (bytes.size() < log_header_size || bytes[0] != FLASH_LOG_FRAME_TYPE || bytes[1] != FLASH_LOG_FRAME_VERSION ||
+        bytes.size() > log_header_size + FLASH_LOG_PAYLOAD_MAX) {
+        return std::nullopt;
+    }
+    return LogRecord(bytes);
+}
+
+// Function to decode the codes of a sample record
+std::optional<SampleBlock> LogRecord::samples(std::int16_t *codes) const {
+    Bytes data = payload();
+
+    if ((record_type() != FLASH_LOG_RECORD_SAMPLES && record_type() != FLASH_LOG_RECORD_SAMPLES_PACKED) ||
+        data.size() < sample_header_size) {
+        return std::nullopt;
+    }
+    SampleBlock block{data[offsetof(flash_log_samples_t, channel)],
+                      wire_get_u16(data.data() + offsetof(flash_log_samples_t, interval_ms)),
+                      data[offsetof(flash_log_samples_t, count)]};
+    Bytes body = data.subspan(sample_header_size);
+    if (record_type() == FLASH_LOG_RECORD_SAMPLES) {
+        if (body.size() < 2U * block.count) {
+            return std::nullopt;
+        }
+        for (std::uint32_t index = 0; index < block.count; ++index) {
+            codes[index] = static_cast<std::int16_t>(wire_get_u16(body.data() + sizeof(std::int16_t) * index));
+        }
+    } else if (sample_codec_decode(body.data(), static_cast<std::uint32_t>(body.size()), codes, block.count) !=
+               block.count) {
+        return std::nullopt;
+    }
+    return block;
+}
+
+} // namespace decoder
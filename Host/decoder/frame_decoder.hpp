@@ -0,0 +1,335 @@
+/**
+  ******************************************************************************
+  * @file    frame_decoder.hpp
+  * @brief   Host decoder of the USART2 stream: framing, CRC, statistics reports and log records.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __FRAME_DECODER_HPP
+#define __FRAME_DECODER_HPP
+
+/* Includes ------------------------------------------------------------------*/
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include "cobs.h"
+#include "flash_log_frame.h"
+#include "stats_delta.h"
+#include "stats_frame.h"
+#include "stats_rollup.h"
+#include "time_sync.h"
+#include "wire_format.h"
+
+namespace decoder {
+
+/* Bytes ---------------------------------------------------------------------*/
+// Bytes of a receive buffer, not owned. C++17 has no std::span.
+class Bytes {
+public:
+    constexpr Bytes() = default;
+    constexpr Bytes(const std::uint8_t *data, std::size_t size) : data_(data), size_(size) {}
+
+    constexpr const std::uint8_t *data() const { return data_; }
+    constexpr std::size_t size() const { return size_; }
+    constexpr bool empty() const { return size_ == 0; }
+    constexpr std::uint8_t operator[](std::size_t index) const { return data_[index]; }
+    // The bytes from offset on, at most count of them
+    constexpr Bytes subspan(std::size_t offset, std::size_t count = SIZE_MAX) const {
+        offset = offset < size_ ? offset : size_;
+        return Bytes(data_ + offset, count < size_ - offset ? count : size_ - offset);
+    }
+
+private:
+    const std::uint8_t *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// CRC-32/MPEG-2 of data the way crc_unit_calculate gives it on the target:
+// little-endian 32-bit words, the last one padded with zero bytes
+std::uint32_t crc32_mpeg2(const std::uint8_t *data, std::size_t size);
+
+// Value of an IEEE 754 half, as stats_frame_float_to_half sends it
+float half_to_float(std::uint16_t half);
+
+// Statistic of channel in sensor units from its code in a report of encoding
+float stats_code_value(std::uint16_t code, std::size_t channel, std::uint8_t encoding);
+
+/* Framing -------------------------------------------------------------------*/
+// One frame with its CRC checked and removed, type is bytes[0]. The bytes
+// live in the buffer given to FrameSplitter::feed and are valid until the
+// caller reuses it.
+struct Frame {
+    Bytes bytes;
+    std::uint8_t type() const { return bytes[0]; }
+};
+
+struct FrameCounters {
+    std::uint64_t bytes = 0;      // Received, delimiters included
+    std::uint64_t frames = 0;     // Passed to the handler
+    std::uint64_t malformed = 0;  // COBS error or shorter than a type byte and the CRC
+    std::uint64_t crc_errors = 0;
+    std::uint64_t oversized = 0;  // Ran past FrameSplitter::carry_max without a delimiter, dropped
+};
+
+// Splits the byte stream of a link at the 0x00 delimiters of UART_FRAMING.
+// Every frame that lies whole in the buffer passed to feed is unstuffed in
+// place, cobs_decode never overtakes its input, and handed out as a view
+// into that buffer, nothing is copied. Only the bytes of a frame cut at the
+// end of a buffer are kept, until the rest of it arrives. One splitter per
+// link.
+class FrameSplitter {
+public:
+    // Longest stuffed frame kept across two buffers, well above the
+    // UART_TX_FRAME_MAX of the firmware
+    static constexpr std::size_t carry_max = 1024;
+
+    // Call handler(const Frame &) for every complete frame in data. data is
+    // modified.
+    template <typename Handler>
+    void feed(std::uint8_t *data, std::size_t size, Handler &&handler) {
+        std::uint8_t *end = data + size;
+
+        counters_.bytes += size;
+        while (data < end) {
+            auto *delimiter = static_cast<std::uint8_t *>(std::memchr(data, 0, static_cast<std::size_t>(end - data)));
+            if (delimiter == nullptr) {
+                keep(data, static_cast<std::size_t>(end - data));
+                return;
+            }
+            std::size_t length = static_cast<std::size_t>(delimiter - data);
+            if (carry_size_ == 0 && !discarding_) {
+                unstuff(data, length, handler);
+            } else {
+                // The start of this frame came with an earlier buffer
+                keep(data, length);
+                if (!discarding_) {
+                    unstuff(carry_, carry_size_, handler);
+                }
+                carry_size_ = 0;
+                discarding_ = false;
+            }
+            data = delimiter + 1;
+        }
+    }
+
+    const FrameCounters &counters() const { return counters_; }
+
+private:
+    // Function to append to the cut frame, or drop it once it is too long
+    void keep(const std::uint8_t *data, std::size_t size) {
+        if (discarding_) {
+            return;
+        }
+        if (carry_size_ + size > carry_max) {
+            counters_.oversized++;
+            discarding_ = true;
+            carry_size_ = 0;
+            return;
+        }
+        std::memcpy(carry_ + carry_size_, data, size);
+        carry_size_ += size;
+    }
+
+    // Function to unstuff one frame in place and check its CRC
+    template <typename Handler>
+    void unstuff(std::uint8_t *data, std::size_t size, Handler &&handler) {
+        if (size == 0) {
+            // Back to back delimiters, a receiver may send one to resynchronize
+            return;
+        }
+        std::int32_t length = cobs_decode(data, static_cast<std::uint32_t>(size), data);
+        if (length < 1 + 4) {
+            counters_.malformed++;
+            return;
+        }
+        std::size_t frame_size = static_cast<std::size_t>(length) - 4;
+        if (crc32_mpeg2(data, frame_size) != wire_get_u32(data + frame_size)) {
+            counters_.crc_errors++;
+            return;
+        }
+        counters_.frames++;
+        handler(Frame{Bytes(data, frame_size)});
+    }
+
+    std::uint8_t carry_[carry_max];
+    std::size_t carry_size_ = 0;
+    bool discarding_ = false;
+    FrameCounters counters_;
+};
+
+/* Statistics reports --------------------------------------------------------*/
+// STATS_FRAME_TYPE keyframe, checked against the stats_frame_t layout
+class StatsFrame {
+public:
+    // The frame, or nothing when it is not a keyframe of this schema
+    static std::optional<StatsFrame> parse(Bytes bytes);
+
+    // The offsets are the ones of the firmware struct, wire_format.h pins them
+    std::uint16_t sequence() const { return wire_get_u16(at(offsetof(stats_frame_t, sequence))); }
+    std::uint32_t timestamp() const { return wire_get_u32(at(offsetof(stats_frame_t, timestamp))); }
+    std::uint16_t channel_mask() const { return wire_get_u16(at(offsetof(stats_frame_t, channel_mask))); }
+    std::uint8_t encoding() const { return *at(offsetof(stats_frame_t, encoding)); }
+    std::uint8_t field_count() const { return *at(offsetof(stats_frame_t, field_count)); }
+#if SENSOR_OCCUPANCY
+    std::uint8_t occupancy() const { return *at(offsetof(stats_frame_t, occupancy)); }
+#endif
+    // index-th code of values[], present channels only, lowest channel first
+    std::uint16_t code(std::size_t index) const {
+        return wire_get_u16(at(offsetof(stats_frame_t, values) + sizeof(std::uint16_t) * index));
+    }
+
+private:
+    explicit StatsFrame(Bytes bytes) : bytes_(bytes) {}
+    const std::uint8_t *at(std::size_t offset) const { return bytes_.data() + offset; }
+    Bytes bytes_;
+};
+
+// STATS_DELTA_FRAME_TYPE frame, checked against the stats_delta_frame_t layout
+class DeltaFrame {
+public:
+    static std::optional<DeltaFrame> parse(Bytes bytes);
+
+    std::uint16_t sequence() const { return wire_get_u16(at(offsetof(stats_delta_frame_t, sequence))); }
+    std::uint32_t timestamp() const { return wire_get_u32(at(offsetof(stats_delta_frame_t, timestamp))); }
+    Bytes field_mask() const {
+        return bytes_.subspan(offsetof(stats_delta_frame_t, field_mask), STATS_DELTA_MASK_BYTES);
+    }
+    std::uint8_t encoding() const { return *at(offsetof(stats_delta_frame_t, encoding)); }
+#if SENSOR_OCCUPANCY
+    std::uint8_t occupancy() const { return *at(offsetof(stats_delta_frame_t, occupancy)); }
+#endif
+    // Zig-zag varints of the changed codes, in field_mask order
+    Bytes deltas() const { return bytes_.subspan(offsetof(stats_delta_frame_t, deltas)); }
+
+private:
+    explicit DeltaFrame(Bytes bytes) : bytes_(bytes) {}
+    const std::uint8_t *at(std::size_t offset) const { return bytes_.data() + offset; }
+    Bytes bytes_;
+};
+
+// The statistics of one device as the receiver end of stats_delta sees
+// them: a keyframe sets every code of its channels, a delta frame moves the
+// changed ones. After a sequence gap the delta frames are ignored until the
+// next keyframe, as stats_delta.h asks.
+class StatsTracker {
+public:
+    enum class Result {
+        keyframe,     // Frame applied, every present channel set
+        delta,        // Frame applied, changed codes moved
+        out_of_sync,  // Delta frame after a gap, ignored until the next keyframe
+        malformed     // Not a report of this schema, the state is unchanged
+    };
+
+    // Apply a STATS_FRAME_TYPE or STATS_DELTA_FRAME_TYPE frame
+    Result apply(const Frame &frame);
+
+    bool synced() const { return synced_; }
+    std::uint16_t sequence() const { return sequence_; }
+    std::uint32_t timestamp() const { return timestamp_; }
+    std::uint16_t channel_mask() const { return channel_mask_; }
+    // STATS_ENCODING_* of the last report
+    std::uint8_t encoding() const { return encoding_; }
+#if SENSOR_OCCUPANCY
+    // Occupancy byte of the last report, OCCUPANCY_OCCUPIED and the confidence
+    std::uint8_t occupancy() const { return occupancy_; }
+#endif
+    // Reports missing between the ones received
+    std::uint64_t lost() const { return lost_; }
+    std::uint16_t code(std::size_t channel, std::size_t field) const { return codes_[channel][field]; }
+    // Statistic in sensor units, after the encoding of the last report
+    float value(std::size_t channel, std::size_t field) const;
+
+private:
+    // Function to count the reports missing before sequence
+    void track(std::uint16_t sequence);
+
+    std::uint16_t codes_[SENSOR_COUNT][STATS_FIELD_COUNT] = {};
+    std::uint16_t sequence_ = 0;
+    std::uint32_t timestamp_ = 0;
+    std::uint16_t channel_mask_ = 0;
+    std::uint8_t encoding_ = STATS_FRAME_ENCODING;
+#if SENSOR_OCCUPANCY
+    std::uint8_t occupancy_ = 0;
+#endif
+    bool synced_ = false;
+    bool started_ = false;
+    std::uint64_t lost_ = 0;
+};
+
+/* Rollup summaries and clock synchronization --------------------------------*/
+// ROLLUP_FRAME_TYPE summary of a closed period, checked against rollup_frame_t
+class RollupFrame {
+public:
+    static std::optional<RollupFrame> parse(Bytes bytes);
+
+    std::uint8_t channel() const { return *at(offsetof(rollup_frame_t, channel)); }
+    std::uint8_t level() const { return *at(offsetof(rollup_frame_t, level)); }
+    std::uint32_t start_ms() const { return wire_get_u32(at(offsetof(rollup_frame_t, start_ms))); }
+    // Length of the period, ROLLUP_FOLD periods of the level below
+    std::uint32_t period_ms() const;
+    // The summary, the floats bit for bit, for rollup_summary_merge
+    rollup_summary_t summary() const;
+
+private:
+    explicit RollupFrame(Bytes bytes) : bytes_(bytes) {}
+    const std::uint8_t *at(std::size_t offset) const { return bytes_.data() + offset; }
+    Bytes bytes_;
+};
+
+// TIME_SYNC_FRAME_TYPE answer to "sync", checked against time_sync_frame_t
+class SyncFrame {
+public:
+    static std::optional<SyncFrame> parse(Bytes bytes);
+
+    std::uint16_t exchange() const { return wire_get_u16(at(offsetof(time_sync_frame_t, exchange))); }
+    // time_sync_state_t, TIME_SYNC_STATE_FREE while the node counts from its boot
+    std::uint8_t state() const { return *at(offsetof(time_sync_frame_t, state)); }
+    std::int32_t error_us() const {
+        return static_cast<std::int32_t>(wire_get_u32(at(offsetof(time_sync_frame_t, error_us))));
+    }
+    std::uint32_t delay_us() const { return wire_get_u32(at(offsetof(time_sync_frame_t, delay_us))); }
+    std::int32_t drift_ppb() const {
+        return static_cast<std::int32_t>(wire_get_u32(at(offsetof(time_sync_frame_t, drift_ppb))));
+    }
+    std::uint32_t sample_ms() const { return wire_get_u32(at(offsetof(time_sync_frame_t, sample_ms))); }
+
+private:
+    explicit SyncFrame(Bytes bytes) : bytes_(bytes) {}
+    const std::uint8_t *at(std::size_t offset) const { return bytes_.data() + offset; }
+    Bytes bytes_;
+};
+
+/* Flash log records ---------------------------------------------------------*/
+// Raw samples of one FLASH_LOG_RECORD_SAMPLES or _PACKED record
+struct SampleBlock {
+    std::uint8_t channel;      // sensor_t
+    std::uint16_t interval_ms; // Nominal time between two codes, the first one at the record timestamp
+    std::uint32_t count;       // Codes decoded
+};
+
+// FLASH_LOG_FRAME_TYPE replayed record, checked against flash_log_frame_t
+class LogRecord {
+public:
+    static std::optional<LogRecord> parse(Bytes bytes);
+
+    std::uint8_t record_type() const { return *at(offsetof(flash_log_frame_t, record_type)); }
+    std::uint32_t sequence() const { return wire_get_u32(at(offsetof(flash_log_frame_t, sequence))); }
+    std::uint32_t timestamp() const { return wire_get_u32(at(offsetof(flash_log_frame_t, timestamp))); }
+    Bytes payload() const { return bytes_.subspan(offsetof(flash_log_frame_t, payload)); }
+
+    // Codes of a sample record, plain or run through sample_codec, into codes
+    // of FLASH_LOG_PACKED_MAX entries. Nothing for other records or when the
+    // payload ends before the count it gives.
+    std::optional<SampleBlock> samples(std::int16_t *codes) const;
+
+private:
+    explicit LogRecord(Bytes bytes) : bytes_(bytes) {}
+    const std::uint8_t *at(std::size_t offset) const { return bytes_.data() + offset; }
+    Bytes bytes_;
+};
+
+} // namespace decoder
+
+#endif /* __FRAME_DECODER_HPP */
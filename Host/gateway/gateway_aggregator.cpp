@@ -0,0 +1,152 @@
+/**
+  ******************************************************************************
+  * @file    gateway_aggregator.cpp
+  * @brief   Gateway service: reads N node links, writes their merged stream and the site summaries as CSV.
+  *
+  *          Every argument is the link of one node, a serial device set up
+  *          with stty beforehand, the FIFO of a BLE bridge or a capture
+  *          file. All of them are polled from one thread and every buffer
+  *          read goes to the aggregator, which decodes it in place; one round
+  *          of reads is followed by one drain. The CSV has two kinds of lines:
+  *
+  *            report,time_ms,node,channel,<the stats_field_t fields>
+  *            site,start_ms,channel,level,nodes,count,mean,std_dev,min,max
+  *
+  *          A report line per channel gives its time on the gateway clock
+  *          and the statistics in sensor units, a site line the moments of
+  *          a closed period merged over the nodes, in sensor_to_fixed codes
+  *          like rollup_decode.py. When every link has ended the rest is
+  *          released and the counters go to stderr.
+  *
+  *          build/gateway_aggregator /dev/ttyUSB0 /dev/ttyUSB1 > site.csv
+  *
+  *          --idle-ms and --lateness-ms set AggregatorConfig, --unsynced
+  *          merges nodes without TIME_SYNC on their own time bases.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include "aggregator.hpp"
+
+namespace {
+
+/* Private defines -----------------------------------------------------------*/
+// A read takes what one link has, a few BLE bursts at most
+constexpr std::size_t gateway_read_max = 4096;
+constexpr int gateway_poll_ms = 100;
+
+// Function to print one line per channel of a report
+void gateway_report(const decoder::NodeEvent &event) {
+    for (std::size_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        if ((event.channel_mask & (1U << channel)) == 0) {
+            continue;
+        }
+        std::printf("report,%u,%u,%zu", event.time, event.node, channel);
+        for (std::size_t field = 0; field < STATS_FIELD_COUNT; ++field) {
+            std::printf(",%g", static_cast<double>(event.value(channel, field)));
+        }
+        std::printf("\n");
+    }
+}
+
+// Function to print a closed site summary
+void gateway_site(const decoder::SiteSummary &site) {
+    double std_dev = 0.0;
+
+    if (site.summary.count != 0) {
+        std_dev = std::sqrt(static_cast<double>(site.summary.m2) / site.summary.count);
+    }
+    std::printf("site,%u,%u,%u,%u,%u,%.2f,%.2f,%d,%d\n", site.start_ms, site.channel, site.level, site.nodes,
+                site.summary.count, static_cast<double>(site.summary.mean), std_dev, site.summary.min,
+                site.summary.max);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    decoder::AggregatorConfig config;
+    std::vector<pollfd> links;
+    std::vector<std::uint32_t> nodes;
+    std::vector<const char *> names;
+    static std::uint8_t buffer[gateway_read_max];
+
+    for (int index = 1; index < argc; ++index) {
+        if (std::strcmp(argv[index], "--idle-ms") == 0 && index + 1 < argc) {
+            config.idle_ms = static_cast<std::uint32_t>(std::strtoul(argv[++index], nullptr, 0));
+        } else if (std::strcmp(argv[index], "--lateness-ms") == 0 && index + 1 < argc) {
+            config.lateness_ms = static_cast<std::uint32_t>(std::strtoul(argv[++index], nullptr, 0));
+        } else if (std::strcmp(argv[index], "--unsynced") == 0) {
+            config.require_sync = false;
+        } else {
+            names.push_back(argv[index]);
+        }
+    }
+    if (names.empty()) {
+        std::fprintf(stderr, "usage: %s [--idle-ms N] [--lateness-ms N] [--unsynced] link...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    decoder::Aggregator aggregator(config);
+    for (const char *name : names) {
+        int fd = open(name, O_RDONLY | O_NONBLOCK | O_NOCTTY);
+        if (fd < 0) {
+            std::fprintf(stderr, "%s: %s\n", name, std::strerror(errno));
+            return EXIT_FAILURE;
+        }
+        links.push_back(pollfd{fd, POLLIN, 0});
+        nodes.push_back(aggregator.add_node());
+    }
+
+    std::size_t open_links = links.size();
+    auto on_event = [](const decoder::NodeEvent &event) {
+        if (event.kind == decoder::NodeEvent::Kind::report) {
+            gateway_report(event);
+        }
+    };
+    while (open_links != 0) {
+        if (poll(links.data(), links.size(), gateway_poll_ms) < 0 && errno != EINTR) {
+            std::perror("poll");
+            return EXIT_FAILURE;
+        }
+        for (std::size_t link = 0; link < links.size(); ++link) {
+            if (links[link].fd < 0 || links[link].revents == 0) {
+                continue;
+            }
+            ssize_t size = read(links[link].fd, buffer, sizeof(buffer));
+            if (size > 0) {
+                aggregator.feed(nodes[link], buffer, static_cast<std::size_t>(size));
+            } else if (size == 0 || (errno != EAGAIN && errno != EINTR)) {
+                // End of a capture or a link gone, its node stays in the merge until idle
+                close(links[link].fd);
+                links[link].fd = -1;
+                open_links--;
+            }
+        }
+        aggregator.drain(on_event, gateway_site);
+    }
+    aggregator.finish(on_event, gateway_site);
+
+    const decoder::AggregatorCounters &counters = aggregator.counters();
+    for (std::size_t link = 0; link < links.size(); ++link) {
+        const decoder::FrameCounters &frames = aggregator.node_counters(nodes[link]);
+        std::fprintf(stderr, "%s: %llu frames, %llu crc errors, %llu malformed, %llu reports lost%s\n", names[link],
+                     static_cast<unsigned long long>(frames.frames), static_cast<unsigned long long>(frames.crc_errors),
+                     static_cast<unsigned long long>(frames.malformed),
+                     static_cast<unsigned long long>(aggregator.node_lost(nodes[link])),
+                     aggregator.node_synced(nodes[link]) ? "" : ", not synchronized");
+    }
+    std::fprintf(stderr, "%llu merged, %llu unsynced, %llu late, %llu late summaries, %llu site summaries\n",
+                 static_cast<unsigned long long>(counters.events), static_cast<unsigned long long>(counters.unsynced),
+                 static_cast<unsigned long long>(counters.late), static_cast<unsigned long long>(counters.late_rollups),
+                 static_cast<unsigned long long>(counters.sites));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,568 @@
+/**
+  ******************************************************************************
+  * @file    pipeline_sim.cpp
+  * @brief   Host simulation of the sampling pipeline for load tests and profiling.
+  *
+  *          The producer, the consumer and the USART2 link each run on a
+  *          thread of their own over the firmware sources of the host core:
+  *          the producer reads every channel of sensor_registry on its tick
+  *          count, an I2C row through a simulated device that answers with
+  *          the big-endian words and CRCs the driver converts and checks,
+  *          decimates the reads and publishes them to the sample rings. At
+  *          every batch the consumer trims each window, runs the fused batch
+  *          kernel and the median on the ring spans, and queues the report
+  *          of stats_delta_encode, with its CRC, COBS stuffed, into a queue
+  *          of UART_TX_QUEUE_LENGTH bursts that drops when full, like
+  *          uart_tx. The link thread empties it at the baud rate and feeds
+  *          the decoder of the gateway, which checks every frame.
+  *
+  *          The values come from a replayed trace, the CSV that
+  *          flash_log_decode.py prints, or from a generated sine with noise
+  *          for a channel the trace does not hold. Time runs --speedup times
+  *          faster than the target, the link included; with --speedup 0 the
+  *          producer does not wait for its ticks and the link sends at once,
+  *          so the run measures the host cost of the pipeline alone.
+  *
+  *          The CSV line gives the throughput of samples and frames, what
+  *          the rings and the transmit queue dropped, and percentiles of the
+  *          consumer time per batch and of the latency from the tick that
+  *          closed a batch to the last byte of its report on the link, in
+  *          host microseconds. A frame the decoder rejects fails the run.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "frame_decoder.hpp"
+#include "sample_decimator.h"
+#include "sample_ring.h"
+#include "sensor_registry.h"
+#include "sensor_stats.h"
+
+#if STATS_FIXED_POINT
+#error "pipeline_sim runs the float statistics, configure the host build without STATS_FIXED_POINT"
+#endif
+
+namespace {
+
+/* Private defines -----------------------------------------------------------*/
+// Defaults of main.c and uart_tx.h, which need the HAL to be included
+constexpr std::uint32_t sim_period_ms = 250;    // SAMPLE_PERIOD_MS
+constexpr std::uint32_t sim_window = 100;       // BUFFER_SIZE
+constexpr std::uint32_t sim_batch = 120;        // SAMPLES_PER_BATCH
+constexpr std::size_t sim_tx_queue_length = 4;  // UART_TX_QUEUE_LENGTH
+constexpr std::uint32_t sim_baud = 115200;      // UART_BAUD_RATE
+constexpr std::size_t sim_crc_size = 4;
+constexpr std::size_t sim_frame_max = sizeof(stats_report_t) + sim_crc_size;
+
+/* Private types -------------------------------------------------------------*/
+struct Config {
+    double speedup = 100.0;
+    std::uint32_t duration_s = 3600;  // Simulated
+    std::uint32_t window = sim_window;
+    std::uint32_t batch = sim_batch;
+    std::uint32_t baud = sim_baud;
+    std::uint32_t nack_ppm = 0;       // I2C reads that are not answered, per million
+    const char *trace = nullptr;
+};
+
+struct TracePoint {
+    std::uint32_t ms;
+    float value;
+};
+
+// Samples of one channel, replayed in a loop from the first one of the trace
+struct Trace {
+    std::vector<TracePoint> points;
+    std::size_t cursor = 0;
+};
+
+// One report on its way to the link
+struct Burst {
+    std::vector<std::uint8_t> bytes;
+    std::uint64_t origin_ns;  // Publication of the tick that closed the batch
+};
+
+/* Private variables ---------------------------------------------------------*/
+Config config;
+sample_ring_t rings[SENSOR_COUNT];
+sample_decimator_t decimators[SENSOR_COUNT];
+Trace traces[SENSOR_COUNT];
+std::uint32_t trace_start_ms = 0;
+std::uint32_t trace_length_ms = 0;
+std::uint32_t sim_seed = 12345;
+
+// Producer to consumer, the task notification of the firmware: batches
+// that close before the consumer wakes are handled as one
+std::mutex batch_lock;
+std::condition_variable batch_ready;
+std::uint32_t batches_pending = 0;
+std::uint32_t batch_ms = 0;
+std::uint64_t batch_origin_ns = 0;
+bool producer_done = false;
+
+// Consumer to link
+std::mutex tx_lock;
+std::condition_variable tx_ready;
+std::deque<Burst> tx_queue;
+bool consumer_done = false;
+
+// Written by one thread each, read once they are joined
+std::uint64_t samples_published = 0;
+std::uint32_t ring_peak = 0;
+std::uint32_t i2c_nacks = 0;
+std::uint32_t batches_handled = 0;
+std::uint32_t batches_merged = 0;
+std::uint32_t frames_queued = 0;
+std::uint32_t frames_dropped = 0;
+std::uint32_t tx_peak = 0;
+std::vector<double> batch_us;
+std::vector<double> latency_us;
+std::uint64_t link_bytes = 0;
+decoder::FrameCounters link_counters;
+
+// Function to read the monotonic clock in nanoseconds
+std::uint64_t sim_now_ns() {
+    timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<std::uint64_t>(now.tv_sec) * 1000000000u + static_cast<std::uint64_t>(now.tv_nsec);
+}
+
+// Function to sleep until a time of the monotonic clock
+void sim_sleep_until(std::uint64_t ns) {
+    timespec until;
+
+    until.tv_sec = static_cast<time_t>(ns / 1000000000u);
+    until.tv_nsec = static_cast<long>(ns % 1000000000u);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, nullptr) != 0) {
+    }
+}
+
+// Function to draw the next pseudo-random word, deterministic between runs
+std::uint32_t sim_random() {
+    sim_seed = sim_seed * 1664525u + 1013904223u;
+    return sim_seed;
+}
+
+// Function to load a trace printed by flash_log_decode.py, false when it cannot be read
+bool trace_load(const char *path) {
+    std::FILE *file = std::fopen(path, "r");
+    char line[128];
+    bool first = true;
+
+    if (file == nullptr) {
+        return false;
+    }
+    while (std::fgets(line, sizeof(line), file) != nullptr) {
+        unsigned long sequence, channel, ms;
+        long code;
+        // The header and malformed lines are skipped
+        if (std::sscanf(line, "%lu,%lu,%lu,%ld", &sequence, &channel, &ms, &code) != 4 || channel >= SENSOR_COUNT) {
+            continue;
+        }
+        float value = static_cast<float>(code) * sensor_registry[channel].fixed_scale;
+        traces[channel].points.push_back(TracePoint{static_cast<std::uint32_t>(ms), value});
+        trace_start_ms = first || ms < trace_start_ms ? static_cast<std::uint32_t>(ms) : trace_start_ms;
+        first = false;
+    }
+    std::fclose(file);
+
+    for (Trace &trace : traces) {
+        std::stable_sort(trace.points.begin(), trace.points.end(),
+                         [](const TracePoint &a, const TracePoint &b) { return a.ms < b.ms; });
+        for (TracePoint &point : trace.points) {
+            point.ms -= trace_start_ms;
+            trace_length_ms = std::max(trace_length_ms, point.ms + sim_period_ms);
+        }
+    }
+    return !first;
+}
+
+// Function to find the value of a channel at a simulated time: the newest
+// sample of its trace at or before it, or the generated signal
+float sim_value(std::uint32_t channel, std::uint32_t ms) {
+    Trace &trace = traces[channel];
+
+    if (!trace.points.empty()) {
+        std::uint32_t at = ms % trace_length_ms;
+        if (trace.cursor > 0 && trace.points[trace.cursor].ms > at) {
+            // The loop started over
+            trace.cursor = 0;
+        }
+        while (trace.cursor + 1 < trace.points.size() && trace.points[trace.cursor + 1].ms <= at) {
+            trace.cursor++;
+        }
+        return trace.points[trace.cursor].value;
+    }
+    // A slow sine of its own period per channel over 12-bit codes, and noise
+    double phase = 2.0 * M_PI * ms / (60000.0 * (channel + 1));
+    double code = 2048.0 + 1024.0 * std::sin(phase) + static_cast<double>(sim_random() >> 26) - 32.0;
+    return static_cast<float>(code) * sensor_registry[channel].fixed_scale;
+}
+
+// Function to compute the Sensirion CRC-8 the way the device appends it
+std::uint8_t sim_crc8(const std::uint8_t *data) {
+    std::uint8_t crc = 0xFF;
+
+    for (std::uint32_t index = 0; index < 2; ++index) {
+        crc ^= data[index];
+        for (std::uint32_t bit = 0; bit < 8; ++bit) {
+            crc = static_cast<std::uint8_t>(crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1);
+        }
+    }
+    return crc;
+}
+
+// Function to write one value as the big-endian word of the device
+void sim_word(std::uint8_t *raw, float value) {
+    long word = std::lround(value);
+
+    word = word < 0 ? 0 : (word > 0xFFFF ? 0xFFFF : word);
+    raw[0] = static_cast<std::uint8_t>(word >> 8);
+    raw[1] = static_cast<std::uint8_t>(word);
+}
+
+// Function to answer one read of an I2C row as its device does, false for a
+// NACK. A 6-byte read holds the word of the row and the one of the shared
+// row that takes it apart, each with its CRC.
+bool sim_i2c_read(std::uint32_t channel, std::uint32_t ms, std::uint8_t *raw) {
+    const sensor_driver_t *driver = &sensor_registry[channel];
+
+    if (config.nack_ppm != 0 && sim_random() % 1000000u < config.nack_ppm) {
+        return false;
+    }
+    std::memset(raw, 0, SENSOR_RAW_MAX);
+    sim_word(raw, sim_value(channel, ms));
+    if (driver->raw_size >= 6) {
+        raw[2] = sim_crc8(raw);
+        for (std::uint32_t shared = 0; shared < SENSOR_COUNT; ++shared) {
+            if (sensor_registry[shared].source == SENSOR_SOURCE_SHARED && sensor_registry[shared].parent == channel) {
+                sim_word(&raw[3], sim_value(shared, ms));
+            }
+        }
+        raw[5] = sim_crc8(&raw[3]);
+    }
+    return true;
+}
+
+// Function to read, decimate and publish every channel due at a tick
+void producer_tick(std::uint32_t tick, std::uint32_t ms, std::uint64_t now_ns) {
+    static std::uint8_t raw[SENSOR_COUNT][SENSOR_RAW_MAX];
+    float latest[SENSOR_COUNT] = {};
+    std::uint32_t fresh = 0;
+
+    for (std::uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        const sensor_driver_t *driver = &sensor_registry[channel];
+        if (tick % sensor_read_divider(driver) != 0) {
+            continue;
+        }
+        float value;
+        switch (driver->source) {
+        case SENSOR_SOURCE_I2C:
+            if (!sim_i2c_read(channel, ms, raw[channel])) {
+                i2c_nacks++;
+                continue;
+            }
+            if (driver->check != nullptr && !driver->check(raw[channel])) {
+                continue;
+            }
+            value = driver->convert(raw[channel]);
+            break;
+        case SENSOR_SOURCE_SHARED:
+            // The read of its parent, earlier in the loop
+            if ((fresh & (1U << driver->parent)) == 0 ||
+                (driver->check != nullptr && !driver->check(raw[driver->parent]))) {
+                continue;
+            }
+            value = driver->convert(raw[driver->parent]);
+            break;
+        case SENSOR_SOURCE_DERIVED:
+            if ((fresh & driver->input_mask) != driver->input_mask) {
+                continue;
+            }
+            value = driver->derive(latest);
+            break;
+        default:
+            // ADC, capture, hook and simulated rows deliver the value itself
+            value = sim_value(channel, ms);
+            break;
+        }
+        if (driver->calibrate != nullptr) {
+            value = driver->calibrate(value);
+        }
+        latest[channel] = value;
+        fresh |= 1U << channel;
+
+        if (!sample_decimator_push(&decimators[channel], value, &value)) {
+            continue;
+        }
+        sensor_data_t sample;
+        sample.timestamp = ms;
+        // Host microseconds in place of the DWT cycles
+        sample.acquired_cycles = static_cast<std::uint32_t>(now_ns / 1000u);
+        sample.value = sensor_sample_value(static_cast<sensor_t>(channel), value);
+        if (sample_ring_push(&rings[channel], &sample)) {
+            samples_published++;
+        }
+        ring_peak = std::max(ring_peak, sample_ring_count(&rings[channel], SAMPLE_READER_STATS));
+    }
+}
+
+// Function to run the sampling ticks of the whole simulated duration
+void producer_thread() {
+    std::uint32_t ticks = static_cast<std::uint32_t>(static_cast<std::uint64_t>(config.duration_s) * 1000u /
+                                                     sim_period_ms);
+    double tick_ns = config.speedup > 0.0 ? sim_period_ms * 1e6 / config.speedup : 0.0;
+    std::uint64_t start = sim_now_ns();
+
+    for (std::uint32_t tick = 0; tick < ticks; ++tick) {
+        if (tick_ns > 0.0) {
+            sim_sleep_until(start + static_cast<std::uint64_t>(tick * tick_ns));
+        }
+        std::uint64_t now = sim_now_ns();
+        std::uint32_t ms = tick * sim_period_ms;
+        producer_tick(tick, ms, now);
+        if ((tick + 1) % config.batch == 0) {
+            std::lock_guard<std::mutex> guard(batch_lock);
+            batches_pending++;
+            batch_ms = ms;
+            batch_origin_ns = now;
+            batch_ready.notify_one();
+        }
+    }
+    std::lock_guard<std::mutex> guard(batch_lock);
+    producer_done = true;
+    batch_ready.notify_one();
+}
+
+// Function to compute the window statistics of one channel the way the
+// consumer does, returns the samples in the window
+std::uint32_t consumer_channel(std::uint32_t channel, float *out) {
+    static float scratch[SAMPLE_RING_SIZE];
+    sample_ring_t *ring = &rings[channel];
+    const sample_value_t *first, *second;
+    std::uint32_t first_count, second_count;
+    batch_stats_t stats;
+
+    std::uint32_t count = sample_ring_count(ring, SAMPLE_READER_STATS);
+    if (count > config.window) {
+        sample_ring_discard(ring, SAMPLE_READER_STATS, count - config.window);
+        count = config.window;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    sample_ring_span(ring, SAMPLE_READER_STATS, 0, count, &first, &first_count, &second, &second_count);
+    std::memcpy(scratch, first, first_count * sizeof(sample_value_t));
+    std::memcpy(&scratch[first_count], second, second_count * sizeof(sample_value_t));
+    batch_stats_reset(&stats);
+    batch_stats_accumulate(&stats, first, first_count);
+    batch_stats_accumulate(&stats, second, second_count);
+    out[STATS_FIELD_STD_DEV] = batch_stats_std_dev(&stats);
+    out[STATS_FIELD_MAX] = stats.max;
+    out[STATS_FIELD_MIN] = stats.min;
+    out[STATS_FIELD_MEDIAN] = calculate_median(scratch, count);
+    return count;
+}
+
+// Function to append the CRC to a report, stuff it and queue it as one
+// burst, or drop it when every burst is taken
+bool consumer_send(const void *frame, std::size_t size, std::uint64_t origin_ns) {
+    std::uint8_t framed[sim_frame_max];
+    Burst burst;
+
+    std::memcpy(framed, frame, size);
+    wire_put_u32(&framed[size], decoder::crc32_mpeg2(framed, size));
+    burst.bytes.resize(COBS_ENCODED_MAX(sim_frame_max) + 1);
+    std::uint32_t length = cobs_encode(framed, static_cast<std::uint32_t>(size + sim_crc_size), burst.bytes.data());
+    burst.bytes[length] = 0;
+    burst.bytes.resize(length + 1);
+    burst.origin_ns = origin_ns;
+
+    std::lock_guard<std::mutex> guard(tx_lock);
+    if (tx_queue.size() >= sim_tx_queue_length) {
+        return false;
+    }
+    tx_queue.push_back(std::move(burst));
+    tx_peak = std::max(tx_peak, static_cast<std::uint32_t>(tx_queue.size()));
+    tx_ready.notify_one();
+    return true;
+}
+
+// Function to report every batch the producer closes
+void consumer_thread() {
+    stats_delta_t delta;
+    stats_report_t report;
+
+    stats_delta_reset(&delta);
+    for (;;) {
+        std::uint32_t pending, ms;
+        std::uint64_t origin;
+        {
+            std::unique_lock<std::mutex> guard(batch_lock);
+            batch_ready.wait(guard, [] { return batches_pending != 0 || producer_done; });
+            if (batches_pending == 0) {
+                break;
+            }
+            pending = batches_pending;
+            batches_pending = 0;
+            ms = batch_ms;
+            origin = batch_origin_ns;
+        }
+        batches_handled++;
+        batches_merged += pending - 1;
+
+        std::uint64_t start = sim_now_ns();
+        float values[SENSOR_COUNT][STATS_FIELD_COUNT] = {};
+        std::uint16_t channel_mask = 0;
+        for (std::uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+            if (consumer_channel(channel, values[channel]) != 0) {
+                channel_mask = static_cast<std::uint16_t>(channel_mask | (1U << channel));
+            }
+        }
+        std::uint16_t size = stats_delta_encode(&delta, &report, ms, channel_mask, values);
+        if (size != 0) {
+            if (consumer_send(&report, size, origin)) {
+                frames_queued++;
+            } else {
+                frames_dropped++;
+                stats_delta_lost(&delta);
+            }
+        }
+        batch_us.push_back(static_cast<double>(sim_now_ns() - start) / 1e3);
+    }
+    std::lock_guard<std::mutex> guard(tx_lock);
+    consumer_done = true;
+    tx_ready.notify_one();
+}
+
+// Function to send the bursts at the baud rate into the decoder of the gateway
+void link_thread() {
+    decoder::FrameSplitter splitter;
+    decoder::StatsTracker tracker;
+    double byte_ns = config.speedup > 0.0 ? 10.0 * 1e9 / (config.baud * config.speedup) : 0.0;
+    std::uint64_t line_free = sim_now_ns();
+
+    for (;;) {
+        Burst burst;
+        {
+            std::unique_lock<std::mutex> guard(tx_lock);
+            tx_ready.wait(guard, [] { return !tx_queue.empty() || consumer_done; });
+            if (tx_queue.empty()) {
+                break;
+            }
+            burst = std::move(tx_queue.front());
+        }
+        // The burst holds its slot until its last byte is out, like the DMA
+        if (byte_ns > 0.0) {
+            line_free = std::max(line_free, sim_now_ns()) + static_cast<std::uint64_t>(burst.bytes.size() * byte_ns);
+            sim_sleep_until(line_free);
+        }
+        {
+            std::lock_guard<std::mutex> guard(tx_lock);
+            tx_queue.pop_front();
+        }
+        link_bytes += burst.bytes.size();
+        splitter.feed(burst.bytes.data(), burst.bytes.size(),
+                      [&](const decoder::Frame &frame) { tracker.apply(frame); });
+        latency_us.push_back(static_cast<double>(sim_now_ns() - burst.origin_ns) / 1e3);
+    }
+    link_counters = splitter.counters();
+}
+
+// Function to read a percentile of sorted values, 0 when there are none
+double percentile(const std::vector<double> &sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    return sorted[static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5)];
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    bool usage = false;
+
+    for (int index = 1; index < argc; ++index) {
+        if (std::strcmp(argv[index], "--speedup") == 0 && index + 1 < argc) {
+            config.speedup = std::strtod(argv[++index], nullptr);
+        } else if (std::strcmp(argv[index], "--duration-s") == 0 && index + 1 < argc) {
+            config.duration_s = static_cast<std::uint32_t>(std::strtoul(argv[++index], nullptr, 0));
+        } else if (std::strcmp(argv[index], "--window") == 0 && index + 1 < argc) {
+            config.window = static_cast<std::uint32_t>(std::strtoul(argv[++index], nullptr, 0));
+        } else if (std::strcmp(argv[index], "--batch") == 0 && index + 1 < argc) {
+            config.batch = static_cast<std::uint32_t>(std::strtoul(argv[++index], nullptr, 0));
+        } else if (std::strcmp(argv[index], "--baud") == 0 && index + 1 < argc) {
+            config.baud = static_cast<std::uint32_t>(std::strtoul(argv[++index], nullptr, 0));
+        } else if (std::strcmp(argv[index], "--nack-ppm") == 0 && index + 1 < argc) {
+            config.nack_ppm = static_cast<std::uint32_t>(std::strtoul(argv[++index], nullptr, 0));
+        } else if (std::strcmp(argv[index], "--trace") == 0 && index + 1 < argc) {
+            config.trace = argv[++index];
+        } else {
+            usage = true;
+        }
+    }
+    // The window and a batch must fit in a ring, as pipeline_config_fits checks on the target
+    if (usage || config.batch == 0 || config.window == 0 || config.window > STATS_WINDOW_CAPACITY ||
+        config.window + 2 * config.batch > SAMPLE_RING_SIZE || config.baud == 0 || config.speedup < 0.0) {
+        std::fprintf(stderr, "usage: %s [--speedup N] [--duration-s N] [--window N] [--batch N] [--baud N] "
+                     "[--nack-ppm N] [--trace samples.csv]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (config.trace != nullptr && !trace_load(config.trace)) {
+        std::fprintf(stderr, "%s: no samples in %s\n", argv[0], config.trace);
+        return EXIT_FAILURE;
+    }
+    for (std::uint32_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        sample_ring_init(&rings[channel]);
+        sample_decimator_init(&decimators[channel], sensor_registry[channel].oversample);
+    }
+
+    std::uint64_t start = sim_now_ns();
+    std::thread link(link_thread);
+    std::thread consumer(consumer_thread);
+    std::thread producer(producer_thread);
+    producer.join();
+    consumer.join();
+    link.join();
+    double elapsed_s = static_cast<double>(sim_now_ns() - start) / 1e9;
+
+    std::uint32_t samples_dropped = 0;
+    for (const sample_ring_t &ring : rings) {
+        samples_dropped += ring.dropped;
+    }
+    std::sort(batch_us.begin(), batch_us.end());
+    std::sort(latency_us.begin(), latency_us.end());
+    // Of the line in simulated time, the same with any speedup
+    double link_bits = static_cast<double>(config.baud) * config.duration_s;
+
+    std::printf("elapsed_s,samples,samples_per_s,samples_dropped,ring_peak,i2c_nacks,batches,batches_merged,"
+                "frames,frames_per_s,frames_dropped,tx_peak,link_load_pct,batch_p50_us,batch_p99_us,"
+                "latency_p50_us,latency_p90_us,latency_p99_us,latency_max_us\n");
+    std::printf("%.3f,%llu,%.0f,%u,%u,%u,%u,%u,%u,%.1f,%u,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n", elapsed_s,
+                static_cast<unsigned long long>(samples_published), samples_published / elapsed_s, samples_dropped,
+                ring_peak, i2c_nacks, batches_handled, batches_merged, frames_queued, frames_queued / elapsed_s,
+                frames_dropped, tx_peak,
+                100.0 * static_cast<double>(link_bytes) * 10.0 / link_bits,
+                percentile(batch_us, 0.5), percentile(batch_us, 0.99), percentile(latency_us, 0.5),
+                percentile(latency_us, 0.9), percentile(latency_us, 0.99), percentile(latency_us, 1.0));
+
+    if (link_counters.frames != frames_queued || link_counters.crc_errors != 0 || link_counters.malformed != 0) {
+        std::fprintf(stderr, "%s: the link delivered %llu of %u frames, %llu with a bad CRC\n", argv[0],
+                     static_cast<unsigned long long>(link_counters.frames), frames_queued,
+                     static_cast<unsigned long long>(link_counters.crc_errors));
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
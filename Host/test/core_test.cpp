@@ -0,0 +1,368 @@
+/**
+  ******************************************************************************
+  * @file    core_test.cpp
+  * @brief   Checks of the sample ring, the framing and the report encoders.
+  *
+  *          Each case drives the firmware sources of sense_flow_core and the
+  *          gateway decoder the way the pipeline does and compares the result
+  *          with a reference: ring cursors with gating and non-gating readers,
+  *          COBS round trips, the CRC-32/MPEG-2 of the CRC unit against a
+  *          bit-at-a-time reference anchored on the catalogue check value,
+  *          the half conversion at its edges and over every half, and the
+  *          sample codec and stats_delta reports through their decoders. A
+  *          failed check prints what it was and fails the run.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "frame_decoder.hpp"
+#include "sample_codec.h"
+#include "sample_ring.h"
+
+namespace {
+
+/* Private variables ---------------------------------------------------------*/
+std::uint32_t failures = 0;
+sample_ring_t ring;
+
+// Function to count and report a failed check
+void check(bool passed, const char *what) {
+    if (!passed) {
+        std::printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+// Function to push value with its timestamp, the sample number
+bool ring_push(std::uint32_t value) {
+    sensor_data_t sample{};
+    sample.timestamp = value;
+    sample.value = static_cast<sample_value_t>(value);
+    return sample_ring_push(&ring, &sample);
+}
+
+/* Sample ring ---------------------------------------------------------------*/
+// Function to fill, drain and wrap a ring with the statistics reader alone
+void test_ring_push_discard() {
+    sample_ring_init(&ring);
+
+    bool pushed = true;
+    for (std::uint32_t i = 0; i < SAMPLE_RING_SIZE; ++i) {
+        pushed &= ring_push(i);
+    }
+    check(pushed, "ring takes SAMPLE_RING_SIZE samples");
+    check(!ring_push(SAMPLE_RING_SIZE) && ring.dropped == 1, "full ring drops and counts the push");
+    check(sample_ring_count(&ring, SAMPLE_READER_STATS) == SAMPLE_RING_SIZE, "full ring count");
+
+    // Release 10, the next 10 fit and the oldest is now sample 10
+    sample_ring_discard(&ring, SAMPLE_READER_STATS, 10);
+    pushed = true;
+    for (std::uint32_t i = 0; i < 10; ++i) {
+        pushed &= ring_push(SAMPLE_RING_SIZE + i);
+    }
+    check(pushed && !ring_push(0), "discarded slots are reused, no more");
+    check(sample_ring_timestamp(&ring, SAMPLE_READER_STATS, 0) == 10, "oldest after discard");
+
+    // The window wraps the storage, the two parts are the samples in order
+    const sample_value_t *first, *second;
+    std::uint32_t first_count, second_count;
+    std::uint32_t count = sample_ring_span(&ring, SAMPLE_READER_STATS, SAMPLE_RING_SIZE - 20, 20, &first,
+                                           &first_count, &second, &second_count);
+    bool in_order = count == 20 && first_count == 10 && second_count == 10;
+    for (std::uint32_t i = 0; in_order && i < 20; ++i) {
+        sample_value_t value = i < first_count ? first[i] : second[i - first_count];
+        in_order = value == static_cast<sample_value_t>(SAMPLE_RING_SIZE - 10 + i);
+    }
+    check(in_order, "span across the wrap");
+
+    sensor_data_t sample{};
+    check(sample_ring_pop(&ring, SAMPLE_READER_STATS, &sample) && sample.timestamp == 10, "pop oldest");
+    sample_ring_discard(&ring, SAMPLE_READER_STATS, UINT32_MAX);
+    check(sample_ring_count(&ring, SAMPLE_READER_STATS) == 0 && !sample_ring_pop(&ring, SAMPLE_READER_STATS, &sample),
+          "discard is clamped to what the reader holds");
+}
+
+// Function to lap a reader that does not gate and hold back the producer with one that does
+void test_ring_readers() {
+    sample_ring_init(&ring);
+    sample_ring_attach(&ring, SAMPLE_READER_LOG, false);
+
+    // The statistics reader keeps up, the log reader never reads
+    bool pushed = true;
+    for (std::uint32_t i = 0; i < 3 * SAMPLE_RING_SIZE; ++i) {
+        pushed &= ring_push(i);
+        sample_ring_discard(&ring, SAMPLE_READER_STATS, 1);
+    }
+    check(pushed && ring.dropped == 0, "a reader that does not gate never holds back the producer");
+    check(sample_ring_catch_up(&ring, SAMPLE_READER_LOG) == 2 * SAMPLE_RING_SIZE, "catch_up skips the overwritten");
+    check(sample_ring_count(&ring, SAMPLE_READER_LOG) == SAMPLE_RING_SIZE &&
+              sample_ring_timestamp(&ring, SAMPLE_READER_LOG, 0) == 2 * SAMPLE_RING_SIZE,
+          "lapped reader resumes at the oldest sample held");
+    check(sample_ring_catch_up(&ring, SAMPLE_READER_LOG) == 0, "catch_up of a reader in range");
+
+    // Gating now: the log reader holds its samples, the producer stops
+    sample_ring_attach(&ring, SAMPLE_READER_LOG, true);
+    std::uint32_t accepted = 0;
+    for (std::uint32_t i = 0; i < 2 * SAMPLE_RING_SIZE; ++i) {
+        accepted += ring_push(i) ? 1U : 0U;
+        sample_ring_discard(&ring, SAMPLE_READER_STATS, 1);
+    }
+    check(accepted == SAMPLE_RING_SIZE && ring.dropped == SAMPLE_RING_SIZE, "a gating reader holds back the producer");
+    sample_ring_discard(&ring, SAMPLE_READER_LOG, 1);
+    check(ring_push(0), "a release of the gating reader frees a slot");
+}
+
+/* COBS ----------------------------------------------------------------------*/
+// Function to round-trip frames of every length across the 254-byte blocks
+void test_cobs() {
+    std::vector<std::uint8_t> data(600), encoded(COBS_ENCODED_MAX(600)), decoded(COBS_ENCODED_MAX(600));
+
+    std::srand(1);
+    for (std::uint32_t density = 0; density < 3; ++density) {
+        for (std::uint32_t size = 0; size <= data.size(); ++size) {
+            for (std::uint32_t i = 0; i < size; ++i) {
+                // No zero, some zeros, mostly zeros
+                std::uint8_t byte = static_cast<std::uint8_t>(1 + std::rand() % 255);
+                data[i] = density == 0 ? byte : (std::rand() % (density == 1 ? 16 : 2)) == 0 ? 0 : byte;
+            }
+            std::uint32_t length = cobs_encode(data.data(), size, encoded.data());
+            bool passed = length <= COBS_ENCODED_MAX(size) &&
+                          std::memchr(encoded.data(), 0, length) == nullptr &&
+                          cobs_decode(encoded.data(), length, decoded.data()) == static_cast<std::int32_t>(size) &&
+                          std::memcmp(data.data(), decoded.data(), size) == 0;
+            if (!passed) {
+                std::printf("FAIL cobs round trip of %u bytes, density %u\n", static_cast<unsigned>(size),
+                            static_cast<unsigned>(density));
+                failures++;
+            }
+        }
+    }
+
+    // In place, the input as far into the buffer as cobs.h allows
+    std::uint32_t size = 300;
+    std::uint32_t offset = COBS_ENCODED_MAX(size) - size;
+    std::memcpy(&encoded[offset], data.data(), size);
+    std::uint32_t length = cobs_encode(&encoded[offset], size, encoded.data());
+    check(cobs_decode(encoded.data(), length, decoded.data()) == static_cast<std::int32_t>(size) &&
+              std::memcmp(data.data(), decoded.data(), size) == 0,
+          "cobs encode in place");
+
+    const std::uint8_t zero_code[] = {0x01, 0x00};
+    const std::uint8_t past_end[] = {0x05, 0x11, 0x22};
+    check(cobs_decode(zero_code, sizeof(zero_code), decoded.data()) == -1, "cobs rejects a 0x00 code");
+    check(cobs_decode(past_end, sizeof(past_end), decoded.data()) == -1, "cobs rejects a block past the end");
+}
+
+/* CRC -----------------------------------------------------------------------*/
+// Function to run bytes through the MPEG-2 register one bit at a time, most significant bit first
+std::uint32_t crc_reference(const std::uint8_t *data, std::size_t size) {
+    std::uint32_t crc = 0xFFFFFFFFU;
+
+    for (std::size_t i = 0; i < size; ++i) {
+        crc ^= static_cast<std::uint32_t>(data[i]) << 24;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x80000000U) != 0 ? (crc << 1) ^ 0x04C11DB7U : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// Function to check the word-at-a-time CRC of the decoder against the reference
+void test_crc() {
+    const char check_input[] = "123456789";
+    check(crc_reference(reinterpret_cast<const std::uint8_t *>(check_input), 9) == 0x0376E6E7U,
+          "crc reference gives the CRC-32/MPEG-2 check value");
+
+    // The unit takes little-endian words, 0x12345678 is the example of the reference manual
+    const std::uint8_t word[] = {0x78, 0x56, 0x34, 0x12};
+    check(decoder::crc32_mpeg2(word, sizeof(word)) == 0xDF8A8A2BU, "crc of the word 0x12345678");
+    check(decoder::crc32_mpeg2(nullptr, 0) == 0xFFFFFFFFU, "crc of nothing is the initial value");
+
+    // Every length, the last word padded with zero bytes
+    std::uint8_t data[67], swapped[68];
+    std::srand(2);
+    for (std::uint8_t &byte : data) {
+        byte = static_cast<std::uint8_t>(std::rand());
+    }
+    for (std::size_t size = 1; size <= sizeof(data); ++size) {
+        std::size_t padded = (size + 3U) & ~static_cast<std::size_t>(3U);
+        std::memset(swapped, 0, sizeof(swapped));
+        for (std::size_t i = 0; i < size; ++i) {
+            swapped[(i & ~static_cast<std::size_t>(3U)) + 3U - (i & 3U)] = data[i];
+        }
+        if (decoder::crc32_mpeg2(data, size) != crc_reference(swapped, padded)) {
+            std::printf("FAIL crc of %u bytes\n", static_cast<unsigned>(size));
+            failures++;
+        }
+    }
+}
+
+/* Half precision ------------------------------------------------------------*/
+// Function to check the rounding and the limits of stats_frame_float_to_half
+void test_float_to_half() {
+    struct Case {
+        float value;
+        std::uint16_t half;
+        const char *what;
+    };
+    const Case cases[] = {
+        {0.0f, 0x0000, "zero"},
+        {-0.0f, 0x8000, "negative zero"},
+        {1.0f, 0x3C00, "one"},
+        {-2.0f, 0xC000, "minus two"},
+        {65504.0f, 0x7BFF, "largest half"},
+        {65520.0f, 0x7BFF, "halfway past the largest half saturates"},
+        {1e9f, 0x7BFF, "far beyond the range saturates"},
+        {-1e9f, 0xFBFF, "far below the range saturates"},
+        {INFINITY, 0x7C00, "infinity"},
+        {-INFINITY, 0xFC00, "negative infinity"},
+        {std::ldexp(1.0f, -14), 0x0400, "smallest normal"},
+        {std::ldexp(1.0f, -24), 0x0001, "smallest subnormal"},
+        {std::ldexp(1.0f, -25), 0x0000, "half the smallest subnormal rounds to even zero"},
+        {std::ldexp(3.0f, -25), 0x0002, "1.5 subnormal steps round to even"},
+        {std::ldexp(1.0f, -26), 0x0000, "below half a subnormal step"},
+        {1.0f + std::ldexp(1.0f, -11), 0x3C00, "tie rounds down to even"},
+        {1.0f + std::ldexp(3.0f, -11), 0x3C02, "tie rounds up to even"},
+        {std::ldexp(2047.0f, -25), 0x0400, "subnormal rounds up into the normals"},
+    };
+    for (const Case &c : cases) {
+        if (stats_frame_float_to_half(c.value) != c.half) {
+            std::printf("FAIL half of %s: 0x%04X\n", c.what, stats_frame_float_to_half(c.value));
+            failures++;
+        }
+    }
+    std::uint16_t nan = stats_frame_float_to_half(NAN);
+    check((nan & 0x7C00U) == 0x7C00U && (nan & 0x3FFU) != 0, "NaN stays a NaN");
+
+    // Every finite half comes back as itself
+    std::uint32_t wrong = 0;
+    for (std::uint32_t half = 0; half < 0x10000U; ++half) {
+        if ((half & 0x7C00U) != 0x7C00U && stats_frame_float_to_half(decoder::half_to_float(half)) != half) {
+            wrong++;
+        }
+    }
+    check(wrong == 0, "every finite half round-trips");
+}
+
+/* Sample codec --------------------------------------------------------------*/
+// Function to round-trip codes with every width of the prefix code
+void test_sample_codec() {
+    constexpr std::uint32_t count = 1000;
+    std::int16_t codes[count], decoded[count];
+    std::uint8_t data[(count * SAMPLE_CODEC_BITS_MAX + 7) / 8];
+    const std::int32_t steps[] = {0, 8, 128, 2048, 32767};
+
+    std::srand(3);
+    std::int16_t code = 0;
+    for (std::uint32_t i = 0; i < count; ++i) {
+        std::int32_t step = steps[std::rand() % 5];
+        code = static_cast<std::int16_t>(code + (step == 0 ? 0 : std::rand() % (2 * step + 1) - step));
+        codes[i] = code;
+    }
+    codes[count - 1] = INT16_MIN;
+    codes[count - 2] = INT16_MAX;
+
+    std::uint32_t size = 0;
+    std::uint32_t encoded = sample_codec_encode(codes, count, data, sizeof(data), &size);
+    check(encoded == count && size <= sizeof(data), "codec encodes every code into the worst case");
+    check(sample_codec_decode(data, size, decoded, count) == count &&
+              std::memcmp(codes, decoded, sizeof(codes)) == 0,
+          "codec round trip");
+
+    // Short of room, the codes that fit decode as they were
+    encoded = sample_codec_encode(codes, count, data, 100, &size);
+    check(encoded > 0 && encoded < count && size <= 100, "codec stops at the capacity");
+    check(sample_codec_decode(data, size, decoded, encoded) == encoded &&
+              std::memcmp(codes, decoded, encoded * sizeof(codes[0])) == 0,
+          "codec round trip of a cut stream");
+}
+
+/* Statistics reports --------------------------------------------------------*/
+// Function to feed one report to the tracker
+decoder::StatsTracker::Result deliver(decoder::StatsTracker &tracker, const stats_report_t &report,
+                                      std::uint16_t size) {
+    return tracker.apply(decoder::Frame{decoder::Bytes(reinterpret_cast<const std::uint8_t *>(&report), size)});
+}
+
+// Function to check that the tracker holds the codes the encoder last sent
+bool tracker_matches(const decoder::StatsTracker &tracker, const stats_delta_t &state, std::uint16_t mask) {
+    for (std::size_t channel = 0; channel < SENSOR_COUNT; ++channel) {
+        for (std::size_t field = 0; (mask & (1U << channel)) != 0 && field < STATS_FIELD_COUNT; ++field) {
+            if (tracker.code(channel, field) != state.codes[channel][field]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Function to encode drifting statistics and decode them as the gateway does
+void test_stats_delta() {
+    static float values[SENSOR_COUNT][STATS_FIELD_COUNT];
+    static stats_delta_t state;
+    static stats_report_t report;
+    decoder::StatsTracker tracker;
+    const std::uint16_t mask = static_cast<std::uint16_t>((1U << SENSOR_COUNT) - 1U);
+    std::uint32_t keyframes = 0, deltas = 0, mismatches = 0;
+
+    stats_delta_reset(&state);
+    std::srand(4);
+    for (std::uint32_t n = 0; n < 200; ++n) {
+        for (auto &channel : values) {
+            for (float &value : channel) {
+                // Mostly within the deadbands, now and then a jump
+                value += static_cast<float>(std::rand() % 21 - 10) * (std::rand() % 8 == 0 ? 10.0f : 0.5f);
+            }
+        }
+        std::uint16_t size = stats_delta_encode(&state, &report, n * 1000U, mask, values);
+        if (size == 0) {
+            continue;
+        }
+        switch (deliver(tracker, report, size)) {
+        case decoder::StatsTracker::Result::keyframe:
+            keyframes++;
+            break;
+        case decoder::StatsTracker::Result::delta:
+            deltas++;
+            break;
+        default:
+            mismatches++;
+            break;
+        }
+        if (!tracker_matches(tracker, state, mask) ||
+            tracker.sequence() != static_cast<std::uint16_t>(state.sequence - 1U)) {
+            mismatches++;
+        }
+    }
+    check(keyframes > 0 && deltas > 0 && mismatches == 0, "every report decodes to the codes the encoder sent");
+    check(tracker.lost() == 0, "no report lost on a clean stream");
+
+    // A report that never left: the receiver skips deltas until the next keyframe
+    stats_delta_lost(&state);
+    values[0][0] += 1000.0f;
+    std::uint16_t size = stats_delta_encode(&state, &report, 300000U, mask, values);
+    check(report.type == STATS_FRAME_TYPE, "the report after a loss is a keyframe");
+    check(deliver(tracker, report, size) == decoder::StatsTracker::Result::keyframe && tracker.lost() == 1 &&
+              tracker_matches(tracker, state, mask),
+          "the keyframe after a loss resyncs the tracker");
+}
+
+} // namespace
+
+int main() {
+    test_ring_push_discard();
+    test_ring_readers();
+    test_cobs();
+    test_crc();
+    test_float_to_half();
+    test_sample_codec();
+    test_stats_delta();
+
+    std::printf("%s: %u failures\n", failures == 0 ? "PASS" : "FAIL", static_cast<unsigned>(failures));
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+/**
+  ******************************************************************************
+  * @file    window_replay_test.c
+  * @brief   Replay of the sliding window kernels against a brute-force window.
+  *
+  *          Every case slides a window_stats_t over a generated stream the
+  *          way the consumer does, the new sample first and then the oldest
+  *          one out, and compares median, maximum, minimum and standard
+  *          deviation after every slide with a sorted copy of the last
+  *          window_size samples. The sizes include STATS_WINDOW_CAPACITY,
+  *          where the window holds one sample more for a moment and needs
+  *          every one of the STATS_WINDOW_CAPACITY_SLOTS slots. The last case
+  *          is one sample beyond that and must count an overflow instead of
+  *          writing past the arrays.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "sensor_stats.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define REPLAY_SLIDES 2000U
+#define REPLAY_STREAM_MAX (STATS_WINDOW_CAPACITY + 1U + REPLAY_SLIDES)
+
+/* Private types -------------------------------------------------------------*/
+typedef enum {
+    STREAM_RANDOM,
+    STREAM_DECREASING, // Every sample a new minimum, the max deque keeps the whole window
+    STREAM_INCREASING, // Every sample a new maximum, the min deque keeps the whole window
+    STREAM_CONSTANT,
+    STREAM_COUNT
+} replay_stream_t;
+
+/* Private variables ---------------------------------------------------------*/
+static const char *const stream_names[STREAM_COUNT] = {
+    "random", "decreasing", "increasing", "constant"
+};
+static const uint32_t window_sizes[] = { 1, 2, 3, 16, 64, STATS_WINDOW_CAPACITY - 1, STATS_WINDOW_CAPACITY };
+
+static float stream[REPLAY_STREAM_MAX];
+static float stream_peak; // Largest magnitude of the stream
+static float sorted[STATS_WINDOW_CAPACITY + 1];
+static window_stats_t window;
+
+/* Private function prototypes -----------------------------------------------*/
+static void replay_fill(replay_stream_t kind, uint32_t count);
+static int replay_compare(const void *a, const void *b);
+static uint32_t replay_run(uint32_t window_size, uint32_t slides);
+
+// Function to generate the samples of one case
+static void replay_fill(replay_stream_t kind, uint32_t count) {
+    srand(1);
+    stream_peak = 0.0f;
+    for (uint32_t i = 0; i < count; ++i) {
+        switch (kind) {
+        case STREAM_RANDOM:
+            stream[i] = (float)(rand() % 1000);
+            break;
+        case STREAM_DECREASING:
+            stream[i] = (float)(REPLAY_STREAM_MAX - i);
+            break;
+        case STREAM_INCREASING:
+            stream[i] = (float)i;
+            break;
+        default:
+            stream[i] = 42.0f;
+            break;
+        }
+        stream_peak = fabsf(stream[i]) > stream_peak ? fabsf(stream[i]) : stream_peak;
+    }
+}
+
+// Function to order two floats for qsort
+static int replay_compare(const void *a, const void *b) {
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+// Function to slide the window over the stream and count the slides that
+// disagree with the brute-force window
+static uint32_t replay_run(uint32_t window_size, uint32_t slides) {
+    uint32_t held = 0;
+    uint32_t wrong = 0;
+
+    window_stats_reset(&window);
+    for (uint32_t i = 0; i < window_size + slides; ++i) {
+        window_stats_add(&window, stream[i]);
+        if (++held > window_size) {
+            window_stats_remove_oldest(&window, stream[i - window_size]);
+            held--;
+        }
+        if (held < window_size) {
+            continue;
+        }
+
+        double sum = 0.0, sum_sq = 0.0;
+        for (uint32_t k = 0; k < window_size; ++k) {
+            sorted[k] = stream[i + 1U - window_size + k];
+            sum += sorted[k];
+        }
+        qsort(sorted, window_size, sizeof(sorted[0]), replay_compare);
+        double mean = sum / window_size;
+        for (uint32_t k = 0; k < window_size; ++k) {
+            sum_sq += (sorted[k] - mean) * (sorted[k] - mean);
+        }
+        float median = (window_size % 2U) != 0 ? sorted[window_size / 2U]
+                                               : (sorted[window_size / 2U - 1U] + sorted[window_size / 2U]) * 0.5f;
+        double variance = sum_sq / window_size;
+        double std_dev = window_stats_std_dev(&window);
+
+        // The order statistics are exact. The float Welford drifts between
+        // resyncs by float steps of the largest square it has seen, which
+        // is the square of the stream and not of the window.
+        if (median_window_median(&window.median) != median || extremum_window_max(&window.extremum) !=
+            sorted[window_size - 1U] || extremum_window_min(&window.extremum) != sorted[0] ||
+            fabs(std_dev * std_dev - variance) > 1e-5 * ((double)stream_peak * stream_peak + 1.0)) {
+            wrong++;
+        }
+    }
+    return wrong;
+}
+
+int main(void) {
+    uint32_t failures = 0;
+
+    for (uint32_t kind = 0; kind < STREAM_COUNT; ++kind) {
+        replay_fill((replay_stream_t)kind, REPLAY_STREAM_MAX);
+        for (uint32_t size = 0; size < sizeof(window_sizes) / sizeof(window_sizes[0]); ++size) {
+            uint32_t wrong = replay_run(window_sizes[size], REPLAY_SLIDES);
+            if (wrong != 0) {
+                printf("FAIL %s window %u: %u of %u slides wrong\n", stream_names[kind],
+                       (unsigned)window_sizes[size], (unsigned)wrong, (unsigned)REPLAY_SLIDES);
+                failures++;
+            }
+        }
+    }
+    if (window_stats_overflows() != 0) {
+        printf("FAIL %u samples overflowed windows that fit\n", (unsigned)window_stats_overflows());
+        failures++;
+    }
+
+    // One sample beyond the slots, the add is refused and counted
+    replay_fill(STREAM_RANDOM, REPLAY_STREAM_MAX);
+    (void)replay_run(STATS_WINDOW_CAPACITY + 1U, 1);
+    if (window_stats_overflows() == 0) {
+        printf("FAIL a window beyond STATS_WINDOW_CAPACITY did not count an overflow\n");
+        failures++;
+    }
+
+    printf("%s: %u failures\n", failures == 0 ? "PASS" : "FAIL", (unsigned)failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""Samples of a flash log replay, read from a capture of the USART2 output.
+
+The capture is the byte stream the receiver got with UART_FRAMING set: COBS
+frames, each ending with its CRC-32/MPEG-2 and a 0x00 byte. Every replayed
+0xA6 frame that carries a sample record is decoded, plain codes as well as
+the bit-packed deltas of FLASH_LOG_COMPRESS (see sample_codec.h) and the
+level changes of SENSOR_EVENT_CODING, and each sample is printed as one CSV
+line: sequence, channel, timestamp in ms and its sensor_to_fixed code. The
+timestamp of a sample is the one of its record plus the nominal interval for
+each sample before it, or its own offset for a level change. Frames with a bad CRC
+are counted and skipped, the other frames of the capture are ignored.
+
+    replay 0 on the command channel, the output captured to replay.bin
+    Host/tools/flash_log_decode.py replay.bin > samples.csv
+"""
+
+import argparse
+import struct
+import sys
+
+FRAME_TYPE = 0xA6
+RECORD_SAMPLES = 2
+RECORD_SAMPLES_PACKED = 4
+RECORD_EVENTS = 6
+# type, version, record type, reserved, sequence, timestamp
+FRAME_HEADER = struct.Struct("<BBBBII")
+# channel, count, interval_ms
+SAMPLES_HEADER = struct.Struct("<BBH")
+# offset_ms, code of one level change
+EVENT = struct.Struct("<Hh")
+# Value bits after a prefix of that many 1 bits, sample_codec_classes
+VALUE_BITS = (0, 4, 8, 12, 16)
+
+
+def cobs_decode(data):
+    out = bytearray()
+    index = 0
+    while index < len(data):
+        code = data[index]
+        if code == 0 or index + code > len(data):
+            return None
+        out += data[index + 1:index + code]
+        index += code
+        if code < 0xFF and index < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def crc32_mpeg2(data):
+    data = data + bytes(-len(data) % 4)
+    crc = 0xFFFFFFFF
+    for (word,) in struct.iter_unpack("<I", data):
+        crc ^= word
+        for _ in range(32):
+            crc = ((crc << 1) ^ 0x04C11DB7 if crc & 0x80000000 else crc << 1) & 0xFFFFFFFF
+    return crc
+
+
+def unpack_codes(data, count):
+    bits = "".join(format(byte, "08b") for byte in data)
+    position = 0
+    previous = 0
+    codes = []
+    while len(codes) < count:
+        ones = 0
+        while ones < 4 and position + ones < len(bits) and bits[position + ones] == "1":
+            ones += 1
+        position += ones + (1 if ones < 4 else 0)
+        width = VALUE_BITS[ones]
+        if position + width > len(bits):
+            break
+        zigzag = int(bits[position:position + width] or "0", 2)
+        position += width
+        previous = (previous + ((zigzag >> 1) ^ -(zigzag & 1))) & 0xFFFF
+        codes.append(previous - 0x10000 if previous & 0x8000 else previous)
+    return codes
+
+
+def samples(frame):
+    _, _, record_type, _, sequence, timestamp = FRAME_HEADER.unpack_from(frame)
+    payload = frame[FRAME_HEADER.size:]
+    if record_type not in (RECORD_SAMPLES, RECORD_SAMPLES_PACKED, RECORD_EVENTS) or len(payload) < SAMPLES_HEADER.size:
+        return
+    channel, count, interval = SAMPLES_HEADER.unpack_from(payload)
+    data = payload[SAMPLES_HEADER.size:]
+    if record_type == RECORD_EVENTS:
+        for offset, code in EVENT.iter_unpack(data[:EVENT.size * count]):
+            yield sequence, channel, (timestamp + offset) & 0xFFFFFFFF, code
+        return
+    if record_type == RECORD_SAMPLES:
+        codes = [code for (code,) in struct.iter_unpack("<h", data[:2 * count])]
+    else:
+        codes = unpack_codes(data, count)
+    for index, code in enumerate(codes):
+        yield sequence, channel, (timestamp + index * interval) & 0xFFFFFFFF, code
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("capture", type=argparse.FileType("rb"), help="bytes received from USART2")
+    args = parser.parse_args()
+
+    bad = 0
+    print("sequence,channel,timestamp_ms,code")
+    for chunk in args.capture.read().split(b"\0"):
+        decoded = cobs_decode(chunk) if chunk else None
+        if decoded is None or len(decoded) < FRAME_HEADER.size + 4:
+            continue
+        frame, (crc,) = decoded[:-4], struct.unpack("<I", decoded[-4:])
+        if crc32_mpeg2(frame) != crc:
+            bad += 1
+            continue
+        if frame[0] == FRAME_TYPE:
+            for row in samples(frame):
+                print("%d,%d,%d,%d" % row)
+    if bad:
+        print("%d frames with a bad CRC" % bad, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""Hot spots of a PC_PROFILE dump, resolved against the linked image.
+
+The capture is the byte stream the receiver got with UART_FRAMING set: COBS
+frames, each ending with its CRC-32/MPEG-2 and a 0x00 byte. The 0xB7 frames
+of the last complete dump are read: the samples of each task, the count of
+every interrupted PC and the summary. Each PC is folded into the function
+symbol of the image that holds it, and the functions are printed with their
+share of the samples, the hottest first. Samples taken in the soft-float
+helpers of libgcc (__aeabi_*), in the HAL polling loops and in the
+statistics kernels show under their own names. --lines also lists the
+hottest PCs of each function, for objdump -d or addr2line.
+
+    profile 1 on the command channel, the output captured to profile.bin
+    Host/tools/pc_profile_report.py profile.bin build/secondtry.elf
+"""
+
+import argparse
+import bisect
+import collections
+import re
+import struct
+import subprocess
+import sys
+
+FRAME_TYPE = 0xB7
+KIND_TASKS, KIND_PCS, KIND_END = 0, 1, 2
+# type, version, kind, count
+FRAME_HEADER = struct.Struct("<BBBB")
+# index, name[7], samples
+TASK_ENTRY = struct.Struct("<B7sI")
+# pc, count
+PC_ENTRY = struct.Struct("<II")
+# samples, dropped, rate_hz
+SUMMARY = struct.Struct("<III")
+# objdump -t: address, 7 flag characters, section, tab, size, name
+SYMBOL_RE = re.compile(r'^([0-9a-f]+) (.{7}) (\S+)\t([0-9a-f]+) (?:\.hidden )?(\S+)$')
+
+
+def cobs_decode(data):
+    out = bytearray()
+    index = 0
+    while index < len(data):
+        code = data[index]
+        if code == 0 or index + code > len(data):
+            return None
+        out += data[index + 1:index + code]
+        index += code
+        if code < 0xFF and index < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def crc32_mpeg2(data):
+    data = data + bytes(-len(data) % 4)
+    crc = 0xFFFFFFFF
+    for (word,) in struct.iter_unpack("<I", data):
+        crc ^= word
+        for _ in range(32):
+            crc = ((crc << 1) ^ 0x04C11DB7 if crc & 0x80000000 else crc << 1) & 0xFFFFFFFF
+    return crc
+
+
+def frames(capture):
+    for chunk in capture.split(b"\0"):
+        decoded = cobs_decode(chunk) if chunk else None
+        if decoded is None or len(decoded) < FRAME_HEADER.size + 4:
+            continue
+        frame, (crc,) = decoded[:-4], struct.unpack("<I", decoded[-4:])
+        if crc32_mpeg2(frame) == crc and frame[0] == FRAME_TYPE:
+            yield frame
+
+
+def last_dump(capture):
+    """Tasks, PC counts and summary of the last dump that reached its end frame."""
+    tasks, pcs, dump = {}, collections.Counter(), None
+    for frame in frames(capture):
+        _, _, kind, count = FRAME_HEADER.unpack_from(frame)
+        body = frame[FRAME_HEADER.size:]
+        if kind == KIND_TASKS:
+            if pcs:
+                # A task frame after PC frames starts the next dump
+                tasks, pcs = {}, collections.Counter()
+            for index in range(count):
+                number, name, samples = TASK_ENTRY.unpack_from(body, index * TASK_ENTRY.size)
+                tasks[number] = (name.rstrip(b"\0").decode("ascii", "replace"), samples)
+        elif kind == KIND_PCS:
+            for index in range(count):
+                pc, hits = PC_ENTRY.unpack_from(body, index * PC_ENTRY.size)
+                pcs[pc] += hits
+        elif kind == KIND_END:
+            dump = (tasks, pcs, SUMMARY.unpack_from(body))
+            tasks, pcs = {}, collections.Counter()
+    return dump
+
+
+def functions(objdump, elf):
+    output = subprocess.run([objdump, "-t", elf], check=True, capture_output=True, text=True).stdout
+    table = []
+    for line in output.splitlines():
+        match = SYMBOL_RE.match(line)
+        if match and "F" in match.group(2):
+            table.append((int(match.group(1), 16) & ~1, int(match.group(4), 16), match.group(5)))
+    table.sort()
+    return table
+
+
+def resolve(table, starts, pc):
+    # The stacked PC is the next instruction, it may sit one past the end of a function
+    index = bisect.bisect_right(starts, pc) - 1
+    if index >= 0:
+        start, size, name = table[index]
+        if pc < start + max(size, 2):
+            return name
+    return "0x%08x" % pc
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("capture", type=argparse.FileType("rb"), help="bytes received from USART2")
+    parser.add_argument("elf", help="linked firmware image of the profiled build")
+    parser.add_argument("--objdump", default="arm-none-eabi-objdump", help="objdump of the cross toolchain")
+    parser.add_argument("--top", type=int, default=30, help="functions listed")
+    parser.add_argument("--lines", type=int, default=0, help="hottest PCs listed under each function")
+    args = parser.parse_args()
+
+    dump = last_dump(args.capture.read())
+    if dump is None:
+        sys.exit("no complete 0xB7 dump in the capture")
+    tasks, pcs, (samples, dropped, rate_hz) = dump
+    if samples == 0:
+        sys.exit("the dump holds no sample")
+
+    print("%d samples at %d Hz, %.1f s, %d not counted by PC" % (samples, rate_hz, samples / rate_hz, dropped))
+    print("\n%-8s %8s %7s" % ("task", "samples", "share"))
+    for number in sorted(tasks, key=lambda n: -tasks[n][1]):
+        name, count = tasks[number]
+        print("%-8s %8d %6.1f%%" % (name, count, 100.0 * count / samples))
+
+    table = functions(args.objdump, args.elf)
+    starts = [start for start, _, _ in table]
+    by_function = collections.defaultdict(collections.Counter)
+    for pc, hits in pcs.items():
+        by_function[resolve(table, starts, pc)][pc] += hits
+
+    ranked = sorted(by_function.items(), key=lambda item: -sum(item[1].values()))
+    print("\n%-40s %8s %7s" % ("function", "samples", "share"))
+    for name, hits in ranked[:args.top]:
+        total = sum(hits.values())
+        print("%-40s %8d %6.1f%%" % (name, total, 100.0 * total / samples))
+        for pc, count in hits.most_common(args.lines):
+            print("    0x%08x %8d" % (pc, count))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Cost of running the statistics kernels from flash, from two STATS_BENCHMARK runs.
+
+One capture comes from secondtry.elf built with STATS_BENCHMARK=ON, which runs
+from flash behind the wait states and the ART cache, and the other from
+secondtry_ram_bench.elf, the same code linked into SRAM and loaded over SWD.
+Both images must be configured with the same options. Each capture is the
+byte stream the receiver got, either framed (UART_FRAMING, COBS frames with
+their CRC-32/MPEG-2) or plain text. For every kernel, size and distribution
+the script prints the cycles from each image and the cost of flash, in
+cycles and as a share of the SRAM time. A summary line per kernel follows.
+
+    Host/tools/placement_compare.py flash.bin sram.bin
+"""
+
+import argparse
+import collections
+import struct
+import sys
+
+HEADER = "kernel,size,distribution,min,avg,max"
+
+
+def cobs_decode(data):
+    out = bytearray()
+    index = 0
+    while index < len(data):
+        code = data[index]
+        if code == 0 or index + code > len(data):
+            return None
+        out += data[index + 1:index + code]
+        index += code
+        if code < 0xFF and index < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def crc32_mpeg2(data):
+    data = data + bytes(-len(data) % 4)
+    crc = 0xFFFFFFFF
+    for (word,) in struct.iter_unpack("<I", data):
+        crc ^= word
+        for _ in range(32):
+            crc = ((crc << 1) ^ 0x04C11DB7 if crc & 0x80000000 else crc << 1) & 0xFFFFFFFF
+    return crc
+
+
+def lines(capture):
+    """Text lines of a capture, from its frames when it is framed."""
+    framed = []
+    for chunk in capture.split(b"\0"):
+        decoded = cobs_decode(chunk) if chunk else None
+        if decoded is None or len(decoded) < 5:
+            continue
+        frame, (crc,) = decoded[:-4], struct.unpack("<I", decoded[-4:])
+        if crc32_mpeg2(frame) == crc:
+            framed.append(frame.decode("ascii", "replace"))
+    text = "".join(framed) if framed else capture.decode("ascii", "replace")
+    return text.splitlines()
+
+
+def results(path):
+    """(kernel, size, distribution) -> (min, avg, max) of the last run in a capture."""
+    with open(path, "rb") as capture:
+        table = {}
+        for line in lines(capture.read()):
+            line = line.strip()
+            if line == HEADER:
+                table = {}
+                continue
+            fields = line.split(",")
+            if len(fields) != 6 or not fields[1].isdigit():
+                continue
+            try:
+                table[(fields[0], int(fields[1]), fields[2])] = tuple(int(field) for field in fields[3:])
+            except ValueError:
+                continue
+    if not table:
+        sys.exit("no benchmark lines in %s" % path)
+    return table
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("flash", help="capture of the flash image")
+    parser.add_argument("sram", help="capture of the SRAM image")
+    parser.add_argument("--column", choices=("min", "avg", "max"), default="min",
+                        help="figure compared, min by default as the least disturbed")
+    args = parser.parse_args()
+
+    column = ("min", "avg", "max").index(args.column)
+    flash, sram = results(args.flash), results(args.sram)
+    common = [key for key in flash if key in sram]
+    if not common:
+        sys.exit("the captures have no case in common")
+
+    print("%-24s %5s %-9s %9s %9s %9s %7s" % ("kernel", "size", "input", "flash", "sram", "cost", "share"))
+    shares = collections.defaultdict(list)
+    for key in common:
+        kernel, size, distribution = key
+        in_flash, in_sram = flash[key][column], sram[key][column]
+        share = (in_flash - in_sram) / in_sram if in_sram else 0.0
+        shares[kernel].append(share)
+        print("%-24s %5d %-9s %9d %9d %9d %6.1f%%" % (kernel, size, distribution, in_flash, in_sram,
+                                                       in_flash - in_sram, 100.0 * share))
+
+    print("\nmean cost of flash per kernel")
+    for kernel, values in shares.items():
+        print("%-24s %6.1f%%" % (kernel, 100.0 * sum(values) / len(values)))
+    missing = len(flash) + len(sram) - 2 * len(common)
+    if missing:
+        print("%d cases in only one capture" % missing)
+
+
+if __name__ == "__main__":
+    main()
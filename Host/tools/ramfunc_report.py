@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""Functions a RAM_FUNCTIONS build placed in SRAM, read from the linked image.
+
+Every function marked RAMFUNC goes to .RamFunc, which the linker script
+places inside .data between _sramfunc and _eramfunc. This script lists them
+with their address and size, the SRAM they take (the same bytes again in
+flash as the load image) and the long branch veneers the linker added.
+A veneer to a function in SRAM is a call from flash into it. A veneer to
+anything else is a call from SRAM back into flash, where the callee can
+still stall on a cache miss, and is worth a look.
+
+The firmware build runs it after the link when RAM_FUNCTIONS is on:
+
+    cmake -S . -B build -DRAM_FUNCTIONS=ON && cmake --build build
+    Host/tools/ramfunc_report.py build/secondtry.elf
+"""
+
+import argparse
+import re
+import subprocess
+import sys
+
+# objdump -t: address, 7 flag characters, section, tab, size, name
+SYMBOL_RE = re.compile(r'^([0-9a-f]+) (.{7}) (\S+)\t([0-9a-f]+) (?:\.hidden )?(\S+)$')
+VENEER_RE = re.compile(r'^__(\w+)_veneer$')
+
+
+def symbols(objdump, elf):
+    output = subprocess.run([objdump, "-t", elf], check=True, capture_output=True, text=True).stdout
+    for line in output.splitlines():
+        match = SYMBOL_RE.match(line)
+        if match:
+            address, flags, section, size, name = match.groups()
+            yield int(address, 16), flags, section, int(size, 16), name
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("elf", help="linked firmware image")
+    parser.add_argument("--objdump", default="arm-none-eabi-objdump", help="objdump of the cross toolchain")
+    args = parser.parse_args()
+
+    table = list(symbols(args.objdump, args.elf))
+    bounds = {name: address for address, _, _, _, name in table if name in ("_sramfunc", "_eramfunc")}
+    if len(bounds) != 2:
+        sys.exit("no _sramfunc/_eramfunc in %s, is it linked with STM32F407VGTX_FLASH.ld?" % args.elf)
+    start, end = bounds["_sramfunc"], bounds["_eramfunc"]
+
+    placed = sorted((address, size, name) for address, flags, _, size, name in table
+                    if "F" in flags and start <= address < end)
+    in_sram = {name for _, _, name in placed}
+    print("%-40s %10s %6s" % ("function", "address", "bytes"))
+    for address, size, name in placed:
+        print("%-40s 0x%08x %6d" % (name, address, size))
+    print("%d functions, %d bytes of SRAM, 0x%08x-0x%08x" % (len(placed), end - start, start, end))
+
+    veneers = sorted(set(VENEER_RE.match(name).group(1) for _, _, _, _, name in table if VENEER_RE.match(name)))
+    if veneers:
+        print("\nlong branch veneers")
+        for target in veneers:
+            print("  %-40s %s" % (target, "flash to SRAM" if target in in_sram else "SRAM to flash"))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Rollup summaries in a capture of the USART2 output, as CSV.
+
+The capture is the byte stream the receiver got with UART_FRAMING set, like
+the one flash_log_decode.py reads. Every live 0xB1 frame and every replayed
+0xA6 frame with a rollup record (see stats_rollup.h) gives one CSV line:
+channel, level (0 second, 1 minute, 2 hour), start of the period in ms, the
+sample count, mean, standard deviation, min and max and the median and 90th
+percentile estimated from the sketch, all in sensor_to_fixed codes. A
+percentile is interpolated within its 4096-code slice and kept between min
+and max, so it is only as fine as the slice. The answer to a query, a 0xB2
+frame, is a line of level "query" from the start of its first period, with
+the end of its last period and the number of summaries merged on stderr.
+Frames with a bad CRC are counted and skipped.
+
+    rollup 2 on the command channel, the output captured to hours.bin
+    Host/tools/rollup_decode.py hours.bin > hours.csv
+"""
+
+import argparse
+import math
+import struct
+import sys
+
+from flash_log_decode import FRAME_HEADER, cobs_decode, crc32_mpeg2
+
+ROLLUP_FRAME_TYPE = 0xB1
+QUERY_FRAME_TYPE = 0xB2
+LOG_FRAME_TYPE = 0xA6
+RECORD_ROLLUP = 5
+# type, version, channel, level, start_ms
+ROLLUP_HEADER = struct.Struct("<BBBBI")
+# type, version, channel, records, first_ms, end_ms
+QUERY_HEADER = struct.Struct("<BBBBII")
+# channel, level, age of the period in s at the record timestamp
+RECORD_HEADER = struct.Struct("<BBH")
+# count, mean, m2, min, max, 16 sketch weights
+SUMMARY = struct.Struct("<Iffhh16H")
+SLICE = 4096
+
+
+def percentile(sketch, low, high, p):
+    total = sum(sketch)
+    if total == 0:
+        return low
+    target = p * total
+    for index, weight in enumerate(sketch):
+        if weight and target <= weight:
+            value = index * SLICE - 0x8000 + SLICE * target / weight
+            return min(max(value, low), high)
+        target -= weight
+    return high
+
+
+def row(channel, level, start, summary):
+    count, mean, m2, low, high = summary[:5]
+    sketch = summary[5:]
+    std_dev = math.sqrt(m2 / count) if count else 0.0
+    return "%s,%s,%d,%d,%.2f,%.2f,%d,%d,%.0f,%.0f" % (
+        channel, level, start, count, mean, std_dev, low, high,
+        percentile(sketch, low, high, 0.5), percentile(sketch, low, high, 0.9))
+
+
+def rollups(frame):
+    if frame[0] == ROLLUP_FRAME_TYPE and len(frame) >= ROLLUP_HEADER.size + SUMMARY.size:
+        _, _, channel, level, start = ROLLUP_HEADER.unpack_from(frame)
+        yield row(channel, level, start, SUMMARY.unpack_from(frame, ROLLUP_HEADER.size))
+    elif frame[0] == QUERY_FRAME_TYPE and len(frame) >= QUERY_HEADER.size + SUMMARY.size:
+        _, _, channel, records, first, end = QUERY_HEADER.unpack_from(frame)
+        print("query of channel %d: %d summaries, %d to %d ms" % (channel, records, first, end), file=sys.stderr)
+        yield row(channel, "query", first, SUMMARY.unpack_from(frame, QUERY_HEADER.size))
+    elif frame[0] == LOG_FRAME_TYPE and len(frame) >= FRAME_HEADER.size + RECORD_HEADER.size + SUMMARY.size:
+        _, _, record_type, _, _, timestamp = FRAME_HEADER.unpack_from(frame)
+        if record_type == RECORD_ROLLUP:
+            channel, level, age = RECORD_HEADER.unpack_from(frame, FRAME_HEADER.size)
+            start = (timestamp - age * 1000) & 0xFFFFFFFF
+            yield row(channel, level, start, SUMMARY.unpack_from(frame, FRAME_HEADER.size + RECORD_HEADER.size))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("capture", type=argparse.FileType("rb"), help="bytes received from USART2")
+    args = parser.parse_args()
+
+    bad = 0
+    print("channel,level,start_ms,count,mean,std_dev,min,max,p50,p90")
+    for chunk in args.capture.read().split(b"\0"):
+        decoded = cobs_decode(chunk) if chunk else None
+        if decoded is None or len(decoded) < 5:
+            continue
+        frame, (crc,) = decoded[:-4], struct.unpack("<I", decoded[-4:])
+        if crc32_mpeg2(frame) != crc:
+            bad += 1
+            continue
+        for line in rollups(frame):
+            print(line)
+    if bad:
+        print("%d frames with a bad CRC" % bad, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""Memory use of a firmware image per region, against a reference build.
+
+Adds up the allocated sections of the image per memory region the way the
+--print-memory-usage line of the link does, a section with its load address
+in another region (.data, .ccmram) counting in both, and prints the same
+table with the change since the reference. The regions come from the
+"Memory Configuration" of the map file, so FLASH is the 720 KB left next to
+the vectors, the config store and the flash log, not the whole device. The largest functions follow, which
+is where inlining and LTO show.
+
+The size of the build is saved with --save, the next build compares with it.
+With --max-growth the report fails when FLASH grew by more than that many
+percent over --baseline, and it always fails when a region is over 100 %.
+Speed is measured on the target, by the stats benchmark and secondtry_bench.elf.
+
+    cmake -S . -B build -DFIRMWARE_PROFILE=speed && cmake --build build
+    Host/tools/size_report.py --map build/secondtry.map build/secondtry.elf
+"""
+
+import argparse
+import json
+import pathlib
+import re
+import subprocess
+import sys
+
+REGION_RE = re.compile(r'^(\w+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+\S+)?$')
+# objdump -h: index, name, size, VMA, LMA, file offset, alignment
+SECTION_RE = re.compile(r'^\s*\d+\s+(\S+)\s+([0-9a-f]+)\s+([0-9a-f]+)\s+([0-9a-f]+)\s+[0-9a-f]+\s+\S+$')
+# objdump -t: address, 7 flag characters, section, tab, size, name
+SYMBOL_RE = re.compile(r'^([0-9a-f]+) (.{7}) (\S+)\t([0-9a-f]+) (?:\.hidden )?(\S+)$')
+
+
+def regions(map_path):
+    found = {}
+    lines = iter(map_path.read_text().splitlines())
+    for line in lines:
+        if line.startswith("Memory Configuration"):
+            break
+    for line in lines:
+        if line.startswith("Linker script and memory map"):
+            break
+        match = REGION_RE.match(line.strip())
+        if match and match.group(1) not in ("Name", "*default*"):
+            found[match.group(1)] = (int(match.group(2), 16), int(match.group(3), 16))
+    return found
+
+
+def region_of(table, address):
+    for name, (origin, length) in table.items():
+        if origin <= address < origin + length:
+            return name
+    return None
+
+
+def usage(objdump, elf, table):
+    used = dict.fromkeys(table, 0)
+    lines = subprocess.run([objdump, "-h", elf], check=True, capture_output=True, text=True).stdout.splitlines()
+    for line, flags in zip(lines, lines[1:]):
+        match = SECTION_RE.match(line)
+        if not match or "ALLOC" not in flags:
+            continue
+        size, vma, lma = (int(value, 16) for value in match.groups()[1:])
+        where = {region_of(table, vma)}
+        if "LOAD" in flags:
+            where.add(region_of(table, lma))
+        for name in where - {None}:
+            used[name] += size
+    return used
+
+
+def largest(objdump, elf, count):
+    output = subprocess.run([objdump, "-t", elf], check=True, capture_output=True, text=True).stdout
+    functions = []
+    for line in output.splitlines():
+        match = SYMBOL_RE.match(line)
+        if match and "F" in match.group(2):
+            functions.append((int(match.group(4), 16), match.group(5)))
+    return sorted(functions, reverse=True)[:count]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("elf", help="linked firmware image")
+    parser.add_argument("--map", type=pathlib.Path, required=True, help="map file of the same link")
+    parser.add_argument("--objdump", default="arm-none-eabi-objdump", help="objdump of the cross toolchain")
+    parser.add_argument("--profile", default="", help="name of the build profile, stored with the sizes")
+    parser.add_argument("--baseline", type=pathlib.Path, help="size report saved by a reference build")
+    parser.add_argument("--save", type=pathlib.Path, help="write the sizes of this build to this file")
+    parser.add_argument("--max-growth", type=float, help="fail when FLASH grew by more percent over the baseline")
+    parser.add_argument("--top", type=int, default=10, help="largest functions listed, default 10")
+    args = parser.parse_args()
+
+    table = regions(args.map)
+    if not table:
+        sys.exit("no memory configuration in %s" % args.map)
+    used = usage(args.objdump, args.elf, table)
+    reference = {}
+    if args.baseline and args.baseline.exists():
+        reference = json.loads(args.baseline.read_text())
+
+    failed = False
+    print("profile %s%s" % (args.profile or "-", ", against %s" % reference.get("profile", "-") if reference else ""))
+    print("%-10s %10s %10s %8s %10s" % ("region", "used", "size", "used %", "change"))
+    for name, (_, length) in table.items():
+        change = ""
+        if name in reference.get("regions", {}):
+            change = "%+d" % (used[name] - reference["regions"][name])
+        percent = 100.0 * used[name] / length if length else 0.0
+        print("%-10s %10d %10d %7.2f%% %10s" % (name, used[name], length, percent, change))
+        if used[name] > length:
+            print("%s is over its size" % name)
+            failed = True
+
+    old_flash = reference.get("regions", {}).get("FLASH")
+    if args.max_growth is not None and old_flash:
+        growth = 100.0 * (used["FLASH"] - old_flash) / old_flash
+        if growth > args.max_growth:
+            print("FLASH grew by %.2f %%, more than the %.2f %% allowed" % (growth, args.max_growth))
+            failed = True
+
+    print("\n%-40s %8s" % ("largest functions", "bytes"))
+    for size, name in largest(args.objdump, args.elf, args.top):
+        print("%-40s %8d" % (name, size))
+
+    if args.save:
+        args.save.write_text(json.dumps({"profile": args.profile, "regions": used}, indent=2) + "\n")
+    if failed:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""Worst-case stack depth of the firmware tasks from a STACK_PROFILE build.
+
+A STACK_PROFILE build compiles every object with -fstack-usage and
+-fcallgraph-info=su, which leaves a .ci call graph next to each object with
+the frame size of every function. This script joins the graphs, walks them
+from the entry function of each task and adds the context the port pushes on
+the task stack, then suggests the -D<NAME>_STACK_SIZE to build with.
+
+Interrupts run on the main stack and are reported on their own, the
+deepest handler without nesting. Indirect calls are resolved for the two
+places that make them: the producer calls the hooks of sensor_registry.c
+and the timer task calls the timer callbacks. Anything else the graph cannot
+bound (recursion, alloca, an unresolved indirect call) is listed, the figure
+of that task is then a lower bound.
+
+    cmake -S . -B build -DSTACK_PROFILE=ON && cmake --build build
+    Host/tools/stack_report.py build
+"""
+
+import argparse
+import math
+import pathlib
+import re
+import sys
+
+# Exception frame with the FPU state (26 words) plus what PendSV saves on
+# top: r4-r11, the EXC_RETURN and s16-s31 (25 words)
+CONTEXT_BYTES = 204
+WORD_BYTES = 4
+
+REPO_DIR = pathlib.Path(__file__).resolve().parents[2]
+
+# Entry function, stack size macro, size in words when the macro is not set
+TASKS = [
+    ("producer_task", "PRODUCER_STACK_SIZE", 128),
+    ("consumer_task", "CONSUMER_STACK_SIZE", 256),
+    ("flash_log_task", "FLASH_LOG_STACK_SIZE", 256),
+    ("link_backlog_task", "LINK_BACKLOG_STACK_SIZE", 256),
+    ("stats_benchmark_task", "STATS_BENCHMARK_STACK_SIZE", 384),
+    ("command_channel_task", "COMMAND_CHANNEL_STACK_SIZE", 256),
+    ("reliable_link_task", "RELIABLE_LINK_STACK_SIZE", 192),
+    ("watchdog_task", "WATCHDOG_STACK_SIZE", 128),
+    ("kernel_trace_task", "KERNEL_TRACE_STACK_SIZE", 192),
+    ("sensor_sim_task", "SENSOR_SIM_STACK_SIZE", 192),
+    ("throughput_bench_task", "THROUGHPUT_BENCH_STACK_SIZE", 256),
+    ("prvTimerTask", "configTIMER_TASK_STACK_DEPTH", 256),
+    ("prvIdleTask", "configMINIMAL_STACK_SIZE", 128),
+]
+
+# Callbacks run by the timer task
+TIMER_CALLBACKS = ["uart_tx_flush_expired"]
+
+NODE_RE = re.compile(r'node: \{ title: "([^"]+)" label: "([^"]*)"')
+EDGE_RE = re.compile(r'edge: \{ sourcename: "([^"]+)" targetname: "([^"]+)"')
+USAGE_RE = re.compile(r'\\n(\d+) bytes \(([a-z,]+)\)')
+HOOK_RE = re.compile(r'\.(?:convert|sample|calibrate)\s*=\s*([A-Za-z_]\w*)')
+
+INDIRECT = "__indirect_call"
+
+
+class Graph:
+    def __init__(self):
+        # (unit, name) -> (frame bytes, qualifier, source location), unit is the
+        # .ci file the function is defined in
+        self.local = {}
+        # name -> first unit defining it, calls into another unit go there
+        self.units = {}
+        # (unit, name) -> set of callees
+        self.calls = {}
+
+    def load(self, path):
+        unit = path.name
+        for line in path.read_text().splitlines():
+            node = NODE_RE.search(line)
+            if node:
+                name, label = node.groups()
+                usage = USAGE_RE.search(label)
+                if usage:
+                    entry = (int(usage.group(1)), usage.group(2), label.split("\\n")[1])
+                    self.local[(unit, name)] = entry
+                    self.units.setdefault(name, unit)
+                continue
+            edge = EDGE_RE.search(line)
+            if edge:
+                source, target = edge.groups()
+                self.calls.setdefault((unit, source), set()).add(target)
+
+    def unit_of(self, name, unit=None):
+        if unit is not None and (unit, name) in self.local:
+            return unit
+        return self.units.get(name)
+
+
+def registry_hooks():
+    source = REPO_DIR / "Core" / "Src" / "sensor_registry.c"
+    return sorted(set(HOOK_RE.findall(source.read_text())))
+
+
+def worst_path(graph, entry, indirect_targets, problems):
+    """Deepest stack from entry, in bytes, and the call chain that reaches it."""
+    memo = {}
+
+    def visit(name, unit, active):
+        unit = graph.unit_of(name, unit)
+        if unit is None:
+            if name != INDIRECT:
+                problems.add("no stack usage for %s" % name)
+            return 0, [name]
+        key = (unit, name)
+        if key in memo:
+            return memo[key]
+        if key in active:
+            problems.add("recursion through %s" % name)
+            return 0, [name]
+        frame, qualifier, _ = graph.local[key]
+        if qualifier != "static":
+            problems.add("%s has a %s frame" % (name, qualifier))
+
+        active.add(key)
+        deepest, chain = 0, []
+        for callee in sorted(graph.calls.get(key, ())):
+            if callee == INDIRECT:
+                if not indirect_targets:
+                    problems.add("unresolved indirect call in %s" % name)
+                callees = [(target, None) for target in indirect_targets]
+            else:
+                callees = [(callee, unit)]
+            for target, target_unit in callees:
+                depth, sub_chain = visit(target, target_unit, active)
+                if depth > deepest:
+                    deepest, chain = depth, sub_chain
+        active.discard(key)
+
+        memo[key] = (frame + deepest, [name] + chain)
+        return memo[key]
+
+    return visit(entry, None, set())
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("build_dir", type=pathlib.Path, help="build directory of a STACK_PROFILE build")
+    parser.add_argument("--margin", type=float, default=25.0,
+                        help="percent added on top of the worst case before rounding, default 25")
+    parser.add_argument("--context", type=int, default=CONTEXT_BYTES,
+                        help="bytes the port pushes on a task stack at a switch, default %d" % CONTEXT_BYTES)
+    parser.add_argument("-v", "--verbose", action="store_true", help="print the deepest call chain of each task")
+    args = parser.parse_args()
+
+    graph = Graph()
+    files = sorted(args.build_dir.rglob("*.ci"))
+    if not files:
+        sys.exit("no .ci files under %s, configure with -DSTACK_PROFILE=ON" % args.build_dir)
+    for path in files:
+        graph.load(path)
+
+    hooks = registry_hooks()
+    indirect = {"producer_task": hooks, "prvTimerTask": TIMER_CALLBACKS}
+
+    print("%-22s %8s %8s %8s %8s" % ("task", "bytes", "words", "suggest", "current"))
+    suggestions = []
+    for entry, macro, current in TASKS:
+        if graph.unit_of(entry) is None:
+            continue
+        problems = set()
+        depth, chain = worst_path(graph, entry, indirect.get(entry, []), problems)
+        words = math.ceil((depth + args.context) / WORD_BYTES)
+        suggest = int(math.ceil(words * (1.0 + args.margin / 100.0) / 8.0) * 8)
+        flag = " !" if problems else ""
+        print("%-22s %8d %8d %8d %8d%s" % (entry, depth + args.context, words, suggest, current, flag))
+        if args.verbose:
+            print("    " + " > ".join(chain))
+        for problem in sorted(problems):
+            print("    lower bound: " + problem)
+        if entry != "prvIdleTask" and entry != "prvTimerTask":
+            suggestions.append("-D%s=%d" % (macro, suggest))
+
+    deepest_isr, isr_name = 0, None
+    for name in graph.units:
+        if name.endswith("Handler"):
+            depth, _ = worst_path(graph, name, [], set())
+            if depth > deepest_isr:
+                deepest_isr, isr_name = depth, name
+    if isr_name is not None:
+        print("%-22s %8d  deepest handler %s, hardware frame and nesting not included"
+              % ("interrupts", deepest_isr, isr_name))
+
+    if suggestions:
+        print("\nbuild with: " + " ".join(suggestions))
+
+
+if __name__ == "__main__":
+    main()